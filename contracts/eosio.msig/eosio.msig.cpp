@@ -28,7 +28,11 @@ void multisig::propose() {
    transaction_header trx_header;
 
    datastream<const char*> ds( buffer, size );
-   ds >> proposer >> proposal_name >> requested;
+   ds >> proposer >> proposal_name;
+
+   // the requested permissions are passed to the authorization check as they were packed in the action
+   size_t requested_pos = ds.tellp();
+   ds >> requested;
 
    size_t trx_pos = ds.tellp();
    ds >> trx_header;
@@ -40,10 +44,9 @@ void multisig::propose() {
    proposals proptable( _self, proposer );
    eosio_assert( proptable.find( proposal_name ) == proptable.end(), "proposal with the same name exists" );
 
-   bytes packed_requested = pack(requested);
    auto res = ::check_transaction_authorization( buffer+trx_pos, size-trx_pos,
                                                  (const char*)0, 0,
-                                                 packed_requested.data(), packed_requested.size()
+                                                 buffer+requested_pos, trx_pos-requested_pos
                                                );
    eosio_assert( res > 0, "transaction authorization failed" );
 
@@ -82,13 +82,33 @@ namespace eosiosystem {
 
 
 
+   /**
+    *  Trades on the RAM market with the integer constant product once `setrammath` enabled it, and through the
+    *  exchange token otherwise
+    */
+   asset system_contract::convert_ram( exchange_state& market, asset from, symbol_type to ) {
+      if( ram_math_singleton( _self, _self ).get_or_default().integer_bancor && market.can_convert_direct( from, to ) )
+         return market.convert_direct( from, to );
+      return market.convert( from, to );
+   }
+
+   /**
+    *  Switches the RAM market to integer arithmetic, which prices trades slightly differently from the double
+    *  precision powers, so it takes the authority of the system account
+    */
+   void system_contract::setrammath( bool integer_bancor ) {
+      require_auth( _self );
+
+      ram_math_singleton( _self, _self ).set( ram_math_state{ integer_bancor }, _self );
+   }
+
    /**
     *  This action will buy an exact amount of ram and bill the payer the current market price.
     */
    void system_contract::buyrambytes( account_name payer, account_name receiver, uint32_t bytes ) {
       auto itr = _rammarket.find(S(4,RAMCORE));
       auto tmp = *itr;
-      auto eosout = tmp.convert( asset(bytes,S(0,RAM)), core_symbol() );
+      auto eosout = convert_ram( tmp, asset(bytes,S(0,RAM)), core_symbol() );
 
       buyram( payer, receiver, eosout );
    }
@@ -129,7 +149,7 @@ namespace eosiosystem {
 
       const auto& market = _rammarket.get(S(4,RAMCORE), "ram market does not exist");
       _rammarket.modify( market, 0, [&]( auto& es ) {
-          bytes_out = es.convert( quant_after_fee,  S(0,RAM) ).amount;
+          bytes_out = convert_ram( es, quant_after_fee,  S(0,RAM) ).amount;
       });
 
       eosio_assert( bytes_out > 0, "must reserve a positive amount" );
@@ -172,7 +192,7 @@ namespace eosiosystem {
       auto itr = _rammarket.find(S(4,RAMCORE));
       _rammarket.modify( itr, 0, [&]( auto& es ) {
           /// the cast to int64_t of bytes is safe because we certify bytes is <= quota which is limited by prior purchases
-          tokens_out = es.convert( asset(bytes,S(0,RAM)), core_symbol());
+          tokens_out = convert_ram( es, asset(bytes,S(0,RAM)), core_symbol());
       });
 
       eosio_assert( tokens_out.amount > 1, "token amount received from selling ram is too low" );
@@ -12,6 +12,7 @@
 #include <eosiolib/symbol.h>
 #include <eosio.system/exchange_state.hpp>
 
+#include <limits>
 #include <string>
 
 namespace eosiosystem {
@@ -84,10 +85,13 @@ namespace eosiosystem {
       uint16_t              location = 0;
 
       uint64_t primary_key()const { return owner;                                   }
-      double   by_votes()const    { return is_active ? -total_votes : total_votes;  }
+      /// inactive producers all rank last, so their vote changes leave the ranking index alone
+      double   by_votes()const    { return is_active ? -total_votes : inactive_rank; }
       bool     active()const      { return is_active;                               }
       void     deactivate()       { producer_key = public_key(); is_active = false; }
 
+      static constexpr double inactive_rank = std::numeric_limits<double>::max();
+
       // explicit serialization macro is not necessary, used here only to improve compilation time
       EOSLIB_SERIALIZE( producer_info, (owner)(total_votes)(producer_key)(is_active)(url)
                         (unpaid_blocks)(last_claim_time)(location) )
@@ -133,6 +137,19 @@ namespace eosiosystem {
 
    typedef eosio::singleton<N(global), eosio_global_state> global_state_singleton;
 
+   /**
+    *  The vote weight multiplier of the current week, kept so that only the first vote of a week pays for std::pow
+    */
+   struct vote_weight_state {
+      int64_t              week = 0;        /// weeks since the block timestamp epoch
+      double               multiplier = 0;  /// 2 ^ (week / 52), 0 until computed
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( vote_weight_state, (week)(multiplier) )
+   };
+
+   typedef eosio::singleton<N(voteweight), vote_weight_state> vote_weight_singleton;
+
    //   static constexpr uint32_t     max_inflation_rate = 5;  // 5% annual inflation
    static constexpr uint32_t     seconds_per_day = 24 * 3600;
    uint64_t system_token_symbol();
@@ -145,6 +162,7 @@ namespace eosiosystem {
 
          eosio_global_state     _gstate;
          rammarket              _rammarket;
+         vote_weight_state      _vote_weight;
 
       public:
          system_contract( account_name s );
@@ -230,6 +248,8 @@ namespace eosiosystem {
 
          void setglobal( std::string name, std::string value );
 
+         void setrammath( bool integer_bancor );
+
       private:
          void update_elected_producers( block_timestamp timestamp );
 
@@ -246,6 +266,10 @@ namespace eosiosystem {
 
          // defined in voting.cpp
          void propagate_weight_change( const voter_info& voter );
+         double stake2vote( int64_t staked );
+
+         // defined in delegate_bandwidth.cpp
+         asset convert_ram( exchange_state& market, asset from, symbol_type to );
    };
 
 } /// eosiosystem
@@ -80,6 +80,32 @@ namespace eosiosystem {
       return from;
    }
 
+   bool exchange_state::can_convert_direct( const asset& from, const symbol_type& to )const {
+      if( base.weight != quote.weight )
+         return false;
+      return ( from.symbol == base.balance.symbol && to == quote.balance.symbol )
+          || ( from.symbol == quote.balance.symbol && to == base.balance.symbol );
+   }
+
+   asset exchange_state::convert_direct( asset from, symbol_type to ) {
+      eosio_assert( can_convert_direct( from, to ), "invalid conversion" );
+      eosio_assert( from.amount > 0, "must convert a positive amount" );
+
+      auto& in_c  = from.symbol == base.balance.symbol ? base : quote;
+      auto& out_c = from.symbol == base.balance.symbol ? quote : base;
+      eosio_assert( in_c.balance.amount > 0 && out_c.balance.amount > 0, "insufficient market balance" );
+
+      // both balances and the input are below 2^63, so the product fits 128 bits and the quotient is below out_balance
+      unsigned __int128 num = (unsigned __int128)(uint64_t)from.amount * (uint64_t)out_c.balance.amount;
+      unsigned __int128 den = (unsigned __int128)(uint64_t)in_c.balance.amount + (uint64_t)from.amount;
+      int64_t out = int64_t( num / den );
+
+      in_c.balance.amount  += from.amount;
+      out_c.balance.amount -= out;
+
+      return asset( out, to );
+   }
+
 
 
 } /// namespace eosiosystem
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <eosiolib/asset.hpp>
+#include <eosiolib/multi_index.hpp>
+#include <eosiolib/singleton.hpp>
 
 namespace eosiosystem {
    using eosio::asset;
@@ -32,9 +34,31 @@ namespace eosiosystem {
       asset convert_from_exchange( connector& c, asset in );
       asset convert( asset from, symbol_type to );
 
+      /**
+       *  With equal connector weights, converting one connector to the other through the supply is the constant
+       *  product trade out = in * out_balance / (in_balance + in), which this computes in 128-bit integers, rounding
+       *  down, instead of through two double precision powers. The supply is left as it is, where `convert` moves it
+       *  out and back.
+       */
+      bool  can_convert_direct( const asset& from, const symbol_type& to )const;
+      asset convert_direct( asset from, symbol_type to );
+
       EOSLIB_SERIALIZE( exchange_state, (supply)(base)(quote) )
    };
 
    typedef eosio::multi_index<N(rammarket), exchange_state> rammarket;
 
+   /**
+    *  Whether the RAM market trades with `exchange_state::convert_direct`; until set, the double precision results of
+    *  `convert` are reproduced
+    */
+   struct ram_math_state {
+      bool                 integer_bancor = false;
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( ram_math_state, (integer_bancor) )
+   };
+
+   typedef eosio::singleton<N(rammath), ram_math_state> ram_math_singleton;
+
 } /// namespace eosiosystem
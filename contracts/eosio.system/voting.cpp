@@ -78,6 +78,7 @@ namespace eosiosystem {
       std::vector< std::pair<eosio::producer_key,uint16_t> > top_producers;
       top_producers.reserve(_gstate.max_producer_schedule_size);
 
+      /// active producers rank first by votes, so the walk ends at the last one elected rather than scanning the table
       for ( auto it = idx.cbegin(); it != idx.cend() && top_producers.size() < _gstate.max_producer_schedule_size && 0 < it->total_votes && it->active(); ++it ) {
          top_producers.emplace_back( std::pair<eosio::producer_key,uint16_t>({{it->owner, it->producer_key}, it->location}) );
       }
@@ -102,10 +103,23 @@ namespace eosiosystem {
       }
    }
 
-   double stake2vote( int64_t staked ) {
+   /**
+    *  The multiplier only changes once a week, so it is computed by the first vote of the week and read back from
+    *  the voteweight singleton by the others, which gives the same weights as computing it every time
+    */
+   double system_contract::stake2vote( int64_t staked ) {
       /// TODO subtract 2080 brings the large numbers closer to this decade
-      double weight = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) )  / double( 52 );
-      return double(staked) * std::pow( 2, weight );
+      const int64_t week = int64_t( (now() - (block_timestamp::block_timestamp_epoch / 1000)) / (seconds_per_day * 7) );
+      if( _vote_weight.multiplier == 0 || _vote_weight.week != week ) {
+         vote_weight_singleton cached( _self, _self );
+         _vote_weight = cached.get_or_default();
+         if( _vote_weight.multiplier == 0 || _vote_weight.week != week ) {
+            _vote_weight.week       = week;
+            _vote_weight.multiplier = std::pow( 2, week / double( 52 ) );
+            cached.set( _vote_weight, _self );
+         }
+      }
+      return double(staked) * _vote_weight.multiplier;
    }
    /**
     *  @pre producers must be sorted from lowest to highest and must be registered and active
@@ -204,6 +218,10 @@ namespace eosiosystem {
          auto pitr = _producers.find( pd.first );
          if( pitr != _producers.end() ) {
             eosio_assert( !voting || pitr->active() || !pd.second.second /* not from new set */, "producer is not currently registered" );
+            /// producers kept in the new set with an unchanged weight, the usual case when a voter edits their list
+            if( pd.second.first == 0 ) {
+               continue;
+            }
             _producers.modify( pitr, 0, [&]( auto& p ) {
                p.total_votes += pd.second.first;
                if ( p.total_votes < 0 ) { // floating point arithmetics can give small negative numbers
@@ -0,0 +1,9 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  eosio.token with the arena allocator of eosiolib, to compare the CPU of both allocators in chain_bench
+ */
+#include <eosiolib/arena_allocator.hpp>
+
+#include "eosio.token.cpp"
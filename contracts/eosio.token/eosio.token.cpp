@@ -5,6 +5,8 @@
 
 #include "eosio.token.hpp"
 
+#include <algorithm>
+
 namespace eosio {
 
 void token::create( account_name issuer,
@@ -92,6 +94,45 @@ void token::transfer( account_name from,
     add_balance( to, quantity, from );
 }
 
+void token::transfers( account_name           from,
+                       const vector<payout>&  payouts )
+{
+    require_auth( from );
+    eosio_assert( !payouts.empty(), "no payouts" );
+
+    require_recipient( from );
+
+    // the amount paid in each symbol, taken from the balance of from at once after the payouts are checked
+    vector<asset> totals;
+    for( const auto& p : payouts ) {
+       eosio_assert( from != p.to, "cannot transfer to self" );
+       eosio_assert( is_account( p.to ), "to account does not exist");
+       require_recipient( p.to );
+
+       eosio_assert( p.quantity.is_valid(), "invalid quantity" );
+       eosio_assert( p.quantity.amount > 0, "must transfer positive quantity" );
+       eosio_assert( p.memo.size() <= 256, "memo has more than 256 bytes" );
+
+       auto sym = p.quantity.symbol.name();
+       auto total = std::find_if( totals.begin(), totals.end(), [&]( const asset& t ) { return t.symbol.name() == sym; } );
+       if( total == totals.end() ) {
+          stats statstable( _self, sym );
+          const auto& st = statstable.get( sym );
+          eosio_assert( p.quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
+          totals.push_back( p.quantity );
+       } else {
+          eosio_assert( p.quantity.symbol == total->symbol, "symbol precision mismatch" );
+          *total += p.quantity;
+       }
+
+       add_balance( p.to, p.quantity, from );
+    }
+
+    for( const auto& total : totals ) {
+       sub_balance( from, total );
+    }
+}
+
 void token::sub_balance( account_name owner, asset value ) {
    accounts from_acnts( _self, owner );
 
@@ -125,4 +166,4 @@ void token::add_balance( account_name owner, asset value, account_name ram_payer
 
 } /// namespace eosio
 
-EOSIO_ABI( eosio::token, (create)(issue)(transfer) )
+EOSIO_ABI( eosio::token, (create)(issue)(transfer)(transfers) )
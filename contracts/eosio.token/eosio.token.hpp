@@ -8,6 +8,7 @@
 #include <eosiolib/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -16,9 +17,18 @@ namespace eosiosystem {
 namespace eosio {
 
    using std::string;
+   using std::vector;
 
    class token : public contract {
       public:
+         struct payout {
+            account_name  to;
+            asset         quantity;
+            string        memo;
+
+            EOSLIB_SERIALIZE( payout, (to)(quantity)(memo) )
+         };
+
          token( account_name self ):contract(self){}
 
          void create( account_name issuer,
@@ -30,6 +40,13 @@ namespace eosio {
                         account_name to,
                         asset        quantity,
                         string       memo );
+
+         /**
+          *  Pays every payout out of the balance of from, as that many transfers would, while loading the stats row
+          *  of each symbol and the balance of from only once. Receivers are notified of this action, not of a transfer.
+          */
+         void transfers( account_name           from,
+                         const vector<payout>&  payouts );
       
       
          inline asset get_supply( symbol_name sym )const;
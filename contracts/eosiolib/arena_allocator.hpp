@@ -0,0 +1,148 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosiolib/memory.hpp>
+#include <eosiolib/system.h>
+
+/**
+ *  @defgroup arenaallocator Arena Allocator
+ *  @brief Bump pointer replacement for the malloc, calloc, realloc and free of eosiolib
+ *  @ingroup memoryapi
+ *
+ *  The memory of a contract is thrown away once its action is done, so keeping free lists for memory that is
+ *  about to be discarded anyway is wasted CPU. With this header included, allocations are carved one after
+ *  the other out of an initial static block and then out of memory taken with sbrk, `free` does nothing and
+ *  `realloc` grows the most recent allocation in place.
+ *
+ *  Include it in exactly one translation unit of a contract, before or after the rest of its code. Its
+ *  definitions take the place of those of eosiolib when the contract is linked. A contract that allocates and
+ *  frees a lot of memory within one action, more than it keeps at once, may run out of memory with it.
+ *
+ *  @code
+ *  #include <eosiolib/arena_allocator.hpp>
+ *  #include <eosiolib/eosio.hpp>
+ *  @endcode
+ *
+ *  @{
+ */
+
+namespace eosio { namespace _arena_detail {
+
+   class arena {
+      public:
+         void* allocate( size_t size ) {
+            const uint32_t needed = round_up( size ) + header_size;
+            if( uint32_t(_end - _next) < needed && !extend( needed ) )
+               return nullptr;
+
+            char* block = _next;
+            _next += needed;
+            *reinterpret_cast<uint32_t*>(block) = needed - header_size;
+            _last = block + header_size;
+            return _last;
+         }
+
+         void* reallocate( void* ptr, size_t size ) {
+            if( ptr == nullptr )
+               return allocate( size );
+
+            char* p = static_cast<char*>(ptr);
+            uint32_t& current = *reinterpret_cast<uint32_t*>(p - header_size);
+            const uint32_t wanted = round_up( size );
+            if( wanted <= current )
+               return ptr;
+
+            // the most recent allocation grows over the memory right after it
+            if( p == _last ) {
+               const uint32_t more = wanted - current;
+               const uint32_t room = uint32_t(_end - _next);
+               if( room >= more || (_end == sbrk_end() && grow( more - room )) ) {
+                  _next += more;
+                  current = wanted;
+                  return ptr;
+               }
+            }
+
+            void* moved = allocate( size );
+            if( moved )
+               memcpy( moved, ptr, current );
+            return moved;
+         }
+
+      private:
+         static constexpr uint32_t header_size       = 8;     ///< the size of the block, keeping the block 8 byte aligned
+         static constexpr uint32_t initial_size      = 8192;
+         static constexpr uint32_t min_sbrk_increase = 16384;
+
+         static uint32_t round_up( size_t size ) {
+            eosio_assert( size <= 0x7fffffff - header_size, "allocation too large" );
+            return (uint32_t(size) + 7U) & ~7U;
+         }
+
+         static char* sbrk_end() { return static_cast<char*>(sbrk(0)); }
+
+         /// takes at least n more bytes right after _end, only possible while nothing else calls sbrk
+         bool grow( uint32_t n ) {
+            const uint32_t increase = n > min_sbrk_increase ? n : min_sbrk_increase;
+            char* start = static_cast<char*>(sbrk( increase ));
+            if( reinterpret_cast<int32_t>(start) == -1 )
+               return false;
+            if( start != _end ) {
+               _next = start;
+            }
+            _end = start + increase;
+            return true;
+         }
+
+         /// makes room for n bytes at _next, leaving the rest of the current block unused if it is too small
+         bool extend( uint32_t n ) {
+            if( _end == nullptr ) {
+               _next = _initial;
+               _end = _initial + initial_size;
+               if( uint32_t(_end - _next) >= n )
+                  return true;
+            }
+            if( _end == sbrk_end() )
+               return grow( n - uint32_t(_end - _next) );
+            return grow( n );
+         }
+
+         alignas(8) char _initial[initial_size];
+         char*           _next = nullptr;
+         char*           _end  = nullptr;
+         char*           _last = nullptr;  ///< the most recent allocation, which realloc can grow in place
+   };
+
+   inline arena& get_arena() {
+      static arena a;
+      return a;
+   }
+
+} } /// namespace eosio::_arena_detail
+
+extern "C" {
+
+void* malloc( size_t size ) {
+   return eosio::_arena_detail::get_arena().allocate( size );
+}
+
+void* calloc( size_t count, size_t size ) {
+   eosio_assert( size == 0 || count <= 0x7fffffff / size, "allocation too large" );
+   void* ptr = malloc( count * size );
+   if( ptr )
+      memset( ptr, 0, count * size );
+   return ptr;
+}
+
+void* realloc( void* ptr, size_t size ) {
+   return eosio::_arena_detail::get_arena().reallocate( ptr, size );
+}
+
+void free( void* ) {}
+
+}
+
+/// @} arenaallocator
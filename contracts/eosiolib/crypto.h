@@ -235,6 +235,38 @@ int recover_key( const checksum256* digest, const char* sig, size_t siglen, char
  */
 void assert_recover_key( const checksum256* digest, const char* sig, size_t siglen, const char* pub, size_t publen );
 
+/**
+ *  Calculates the merkle root of a list of digests, the same as the chain does for action and transaction merkle roots.
+ *  @brief Calculates the merkle root of a list of digests.
+ *
+ *  @param digests - Pointer to the array of digests
+ *  @param count - Number of digests
+ *  @param root - Pointer to the calculated merkle root
+ *
+ *  Example:
+*
+ *  @code
+ *  checksum256 root;
+ *  merkle_root( digests.data(), digests.size(), &root );
+ *  eosio_assert( root == action_mroot, "invalid merkle root" );
+ *  @endcode
+ */
+void merkle_root( const checksum256* digests, uint32_t count, checksum256* root );
+
+/**
+ *  Tests if a merkle branch links the leaf to the provided root.
+ *  @brief Tests if a merkle branch links the leaf to the provided root.
+ *
+ *  @param leaf - Digest of the leaf
+ *  @param branch - Pointer to the array of sibling digests, from the bottom up, each one marked as canonical left or right
+ *  @param branch_len - Number of sibling digests
+ *  @param root - Merkle root to compare to
+ *
+ *  @pre the root computed from `leaf` and `branch` equals provided `root` parameter.
+ *  @post Executes next statement. If was not `true`, hard return.
+ */
+void assert_merkle_branch( const checksum256* leaf, const checksum256* branch, uint32_t branch_len, const checksum256* root );
+
 /// }@cryptocapi
 
 }
@@ -9,6 +9,7 @@
 #include <boost/container/flat_set.hpp>
 #include <boost/container/flat_map.hpp>
 #include <eosiolib/varint.hpp>
+#include <eosiolib/serialize.hpp>
 #include <array>
 #include <set>
 #include <map>
@@ -1027,5 +1028,12 @@ inline datastream<Stream>& operator>>(datastream<Stream>& ds, checksum512& cs) {
    ds.read((char*)&cs.hash[0], sizeof(cs.hash));
    return ds;
 }
+
+namespace _serialize_detail {
+   /// serialized as their bytes above; checksum160 is padded to 32 bytes so it is left out
+   template<> struct is_raw_layout<::public_key>  : std::true_type {};
+   template<> struct is_raw_layout<::checksum256> : std::true_type {};
+   template<> struct is_raw_layout<::checksum512> : std::true_type {};
+}
 /// @} datastream
 }
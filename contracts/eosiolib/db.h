@@ -144,6 +144,31 @@ int32_t db_get_i64(int32_t iterator, const void* data, uint32_t len);
   */
 int32_t db_next_i64(int32_t iterator, uint64_t* primary);
 
+/**
+  *
+  *  Read the table rows following the referenced table row in a primary 64-bit integer index table
+  *
+  *  @brief Read the table rows following the referenced table row in a primary 64-bit integer index table
+  *  @param iterator - The iterator to the referenced table row
+  *  @param data - Pointer to the buffer which will be filled with the rows
+  *  @param len - Size of the buffer
+  *  @param max_rows - Maximum number of rows to read
+  *  @param next - Pointer to an `int32_t` variable which will be set to the iterator to the row following the last row read (or the end iterator of the table if there is none)
+  *  @return number of rows written to the buffer, which stops early at the end of the table or when the buffer cannot hold the next row
+  *  @pre `iterator` points to an existing table row in the table
+  *  @pre `data` is a valid pointer to a range of memory at least `len` bytes long
+  *  @post `data` holds, for each row in order, its iterator (`int32_t`), its primary key (`uint64_t`), the size of its record (`uint32_t`) and the record itself, without padding
+  *
+  *  Example:
+  *
+  *  @code
+  *  char rows[512];
+  *  int32_t next;
+  *  int32_t count = db_next_many_i64(itr, rows, sizeof(rows), 16, &next);
+  *  @endcode
+  */
+int32_t db_next_many_i64(int32_t iterator, void* data, uint32_t len, uint32_t max_rows, int32_t* next);
+
 /**
   *
   *  Find the table row preceding the referenced table row in a primary 64-bit integer index table
@@ -21,6 +21,7 @@
 #include <eosiolib/types.hpp>
 #include <eosiolib/serialize.hpp>
 #include <eosiolib/datastream.hpp>
+#include <eosiolib/view.hpp>
 #include <eosiolib/db.h>
 #include <eosiolib/fixed_key.hpp>
 
@@ -92,6 +93,88 @@ namespace _multi_index_detail {
 
    namespace hana = boost::hana;
 
+   /**
+    *  Bumped by every emplace and erase through any multi_index of the contract. Rows read ahead while iterating are
+    *  only linked to each other for the generation they were read in, so a row stored or removed afterwards is never
+    *  stepped over.
+    */
+   inline uint32_t& table_write_generation() {
+      static uint32_t generation = 1;
+      return generation;
+   }
+
+   /**
+    *  Position of each cached row in a multi_index, by primary key or by primary iterator. Open addressing with
+    *  linear probing, so a lookup is a hash and, at most half full, one or two compares instead of a scan of the
+    *  cache; removal shifts the following entries back rather than leaving tombstones.
+    */
+   class loaded_object_index {
+      public:
+         static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+         uint32_t find( uint64_t key )const {
+            if( _slots.empty() ) return npos;
+            for( uint32_t i = home( key ); ; i = (i + 1) & mask() ) {
+               const auto& s = _slots[i];
+               if( s.pos == npos || s.key == key ) return s.pos;
+            }
+         }
+
+         /// replaces the position of a key already present
+         void insert( uint64_t key, uint32_t pos ) {
+            if( (_size + 1) * 2 > _slots.size() ) grow();
+            uint32_t i = home( key );
+            while( _slots[i].pos != npos && _slots[i].key != key ) i = (i + 1) & mask();
+            if( _slots[i].pos == npos ) ++_size;
+            _slots[i] = slot{ key, pos };
+         }
+
+         void erase( uint64_t key ) {
+            if( _slots.empty() ) return;
+            uint32_t i = home( key );
+            for( ; _slots[i].key != key || _slots[i].pos == npos; i = (i + 1) & mask() )
+               if( _slots[i].pos == npos ) return;
+
+            // move back every following entry of the run whose home is not between the hole and itself
+            for( uint32_t j = (i + 1) & mask(); _slots[j].pos != npos; j = (j + 1) & mask() ) {
+               uint32_t h = home( _slots[j].key );
+               bool stays = i <= j ? (i < h && h <= j) : (i < h || h <= j);
+               if( stays ) continue;
+               _slots[i] = _slots[j];
+               i = j;
+            }
+            _slots[i].pos = npos;
+            --_size;
+         }
+
+      private:
+         struct slot {
+            uint64_t key = 0;
+            uint32_t pos = npos;
+         };
+
+         uint32_t mask()const { return _slots.size() - 1; }
+
+         uint32_t home( uint64_t key )const {
+            // the finalizer of MurmurHash3, primary keys are often sequential or account names sharing a prefix
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return uint32_t(key) & mask();
+         }
+
+         void grow() {
+            std::vector<slot> old( _slots.empty() ? 16 : _slots.size() * 2 );
+            old.swap( _slots );
+            _size = 0;
+            for( const auto& s : old )
+               if( s.pos != npos ) insert( s.key, s.pos );
+         }
+
+         std::vector<slot> _slots;
+         uint32_t          _size = 0;
+   };
+
    template<typename T>
    struct secondary_index_db_functions;
 
@@ -232,6 +315,10 @@ class multi_index
 
       constexpr static size_t max_stack_buffer_size = 512;
 
+      /// rows read by a single db_next_many_i64 call when iterating forward by primary key
+      constexpr static uint32_t read_ahead_rows = 16;
+      constexpr static size_t   read_ahead_buffer_size = 4096;
+
       static_assert( validate_table_name(TableName), "multi_index does not support table names with a length greater than 12");
 
       uint64_t _code;
@@ -255,6 +342,8 @@ class multi_index
          const multi_index* __idx;
          int32_t            __primary_itr;
          int32_t            __iters[sizeof...(Indices)+(sizeof...(Indices)==0)];
+         mutable const item* __next = nullptr;         ///< following row by primary key, nullptr at the end of the table
+         mutable uint32_t    __next_generation = 0;    ///< table_write_generation() for which __next is valid
       };
 
       struct item_ptr
@@ -268,6 +357,33 @@ class multi_index
       };
 
       mutable std::vector<item_ptr> _items_vector;
+      mutable _multi_index_detail::loaded_object_index _items_by_primary_key;   ///< positions in _items_vector
+      mutable _multi_index_detail::loaded_object_index _items_by_primary_itr;
+
+      void cache_object( std::unique_ptr<item>&& itm, uint64_t pk, int32_t pitr )const {
+         uint32_t pos = _items_vector.size();
+         _items_vector.emplace_back( std::move(itm), pk, pitr );
+         _items_by_primary_key.insert( pk, pos );
+         _items_by_primary_itr.insert( uint32_t(pitr), pos );
+      }
+
+      /// drops the cached row at pos, moving the last one into its place
+      void uncache_object( uint32_t pos ) {
+         auto& removed = _items_vector[pos];
+         _items_by_primary_key.erase( removed._primary_key );
+         _items_by_primary_itr.erase( uint32_t(removed._primary_itr) );
+         if( pos + 1 != _items_vector.size() ) {
+            removed = std::move( _items_vector.back() );
+            _items_by_primary_key.insert( removed._primary_key, pos );
+            _items_by_primary_itr.insert( uint32_t(removed._primary_itr), pos );
+         }
+         _items_vector.pop_back();
+      }
+
+      const item* find_cached_object( uint64_t primary )const {
+         auto pos = _items_by_primary_key.find( primary );
+         return pos != _multi_index_detail::loaded_object_index::npos ? _items_vector[pos]._item.get() : nullptr;
+      }
 
       template<uint64_t IndexName, typename Extractor, uint64_t Number, bool IsConst>
       struct index {
@@ -548,28 +664,15 @@ class multi_index
 
       indices_type _indices;
 
-      const item& load_object_by_primary_iterator( int32_t itr )const {
-         using namespace _multi_index_detail;
-
-         auto itr2 = std::find_if(_items_vector.rbegin(), _items_vector.rend(), [&](const item_ptr& ptr) {
-            return ptr._primary_itr == itr;
-         });
-         if( itr2 != _items_vector.rend() )
-            return *itr2->_item;
-
-         auto size = db_get_i64( itr, nullptr, 0 );
-         eosio_assert( size >= 0, "error reading iterator" );
-
-         //using malloc/free here potentially is not exception-safe, although WASM doesn't support exceptions
-         void* buffer = max_stack_buffer_size < size_t(size) ? malloc(size_t(size)) : alloca(size_t(size));
+      const item* find_loaded_object( int32_t itr )const {
+         auto pos = _items_by_primary_itr.find( uint32_t(itr) );
+         return pos != _multi_index_detail::loaded_object_index::npos ? _items_vector[pos]._item.get() : nullptr;
+      }
 
-         db_get_i64( itr, buffer, uint32_t(size) );
+      const item& load_object( int32_t itr, const char* data, uint32_t size )const {
+         using namespace _multi_index_detail;
 
-         datastream<const char*> ds( (char*)buffer, uint32_t(size) );
-
-         if ( max_stack_buffer_size < size_t(size) ) {
-            free(buffer);
-         }
+         datastream<const char*> ds( data, size );
 
          auto itm = std::make_unique<item>( this, [&]( auto& i ) {
             T& val = static_cast<T&>(i);
@@ -587,11 +690,78 @@ class multi_index
          auto pk   = itm->primary_key();
          auto pitr = itm->__primary_itr;
 
-         _items_vector.emplace_back( std::move(itm), pk, pitr );
+         cache_object( std::move(itm), pk, pitr );
 
          return *ptr;
+      }
+
+      const item& load_object_by_primary_iterator( int32_t itr )const {
+         if( const item* loaded = find_loaded_object( itr ) )
+            return *loaded;
+
+         auto size = db_get_i64( itr, nullptr, 0 );
+         eosio_assert( size >= 0, "error reading iterator" );
+
+         //using malloc/free here potentially is not exception-safe, although WASM doesn't support exceptions
+         void* buffer = max_stack_buffer_size < size_t(size) ? malloc(size_t(size)) : alloca(size_t(size));
+
+         db_get_i64( itr, buffer, uint32_t(size) );
+
+         const item& obj = load_object( itr, (const char*)buffer, uint32_t(size) );
+
+         if ( max_stack_buffer_size < size_t(size) ) {
+            free(buffer);
+         }
+
+         return obj;
       } /// load_object_by_primary_iterator
 
+      /**
+       *  The object following obj by primary key, or nullptr at the end of the table. Up to read_ahead_rows rows are
+       *  read in one host call and linked to each other, so iterating forward costs a call per batch instead of two
+       *  per row.
+       */
+      const item* load_next_object( const item& obj )const {
+         using namespace _multi_index_detail;
+
+         const auto generation = table_write_generation();
+         if( obj.__next_generation == generation )
+            return obj.__next;
+
+         void* buffer = malloc( read_ahead_buffer_size );
+         int32_t next_itr = -1;
+         auto rows = db_next_many_i64( obj.__primary_itr, buffer, read_ahead_buffer_size, read_ahead_rows, &next_itr );
+
+         const char* pos = (const char*)buffer;
+         const item* prev = &obj;
+         for( int32_t r = 0; r < rows; ++r ) {
+            int32_t  row_itr;
+            uint32_t size;
+            memcpy( &row_itr, pos, sizeof(row_itr) );
+            memcpy( &size, pos + sizeof(int32_t) + sizeof(uint64_t), sizeof(size) );
+            pos += sizeof(int32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+            const item* cur = find_loaded_object( row_itr );
+            if( !cur )
+               cur = &load_object( row_itr, pos, size );
+            pos += size;
+
+            prev->__next = cur;
+            prev->__next_generation = generation;
+            prev = cur;
+         }
+         free( buffer );
+
+         if( next_itr < 0 ) {
+            prev->__next = nullptr;
+            prev->__next_generation = generation;
+         } else if( rows == 0 ) {
+            // the following row does not fit in the read ahead buffer
+            return &load_object_by_primary_iterator( next_itr );
+         }
+         return obj.__next;
+      }
+
    public:
       /**
        *  Constructs an instance of a Multi-Index table.
@@ -743,12 +913,7 @@ class multi_index
          const_iterator& operator++() {
             eosio_assert( _item != nullptr, "cannot increment end iterator" );
 
-            uint64_t next_pk;
-            auto next_itr = db_next_i64( _item->__primary_itr, &next_pk );
-            if( next_itr < 0 )
-               _item = nullptr;
-            else
-               _item = &_multidx->load_object_by_primary_iterator( next_itr );
+            _item = _multidx->load_next_object( *_item );
             return *this;
          }
          const_iterator& operator--() {
@@ -1693,7 +1858,8 @@ class multi_index
          auto pk   = itm->primary_key();
          auto pitr = itm->__primary_itr;
 
-         _items_vector.emplace_back( std::move(itm), pk, pitr );
+         cache_object( std::move(itm), pk, pitr );
+         ++table_write_generation();
 
          return {this, ptr};
       }
@@ -1985,11 +2151,8 @@ class multi_index
        *  @endcode
        */
       const_iterator find( uint64_t primary )const {
-         auto itr2 = std::find_if(_items_vector.rbegin(), _items_vector.rend(), [&](const item_ptr& ptr) {
-            return ptr._item->primary_key() == primary;
-         });
-         if( itr2 != _items_vector.rend() )
-            return iterator_to(*(itr2->_item));
+         if( const item* cached = find_cached_object( primary ) )
+            return iterator_to(*cached);
 
          auto itr = db_find_i64( _code, _scope, TableName, primary );
          if( itr < 0 ) return end();
@@ -1998,6 +2161,35 @@ class multi_index
          return iterator_to(static_cast<const T&>(i));
       }
 
+      /**
+       *  Reads the serialized row with a primary key straight from the database, without deserializing it into T or
+       *  adding it to the object cache. For reading a field or two of a row, as views unpacked from the buffer.
+       *  @brief Reads the serialized row with a primary key, for views into it.
+       *
+       *  @param primary - Primary key value of the object
+       *  @param buffer - Receives the serialized row, and has to outlive the views unpacked from it
+       *  @return true if the row exists, false otherwise
+       *
+       *  Example:
+       *
+       *  @code
+       *  packed_buffer buffer;
+       *  if( addresses.read_packed( N(dan), buffer ) ) {
+       *     // account_name, then first_name without copying it
+       *     auto first_name = buffer.unpack<struct_view<account_name, string_view>>().get<1>();
+       *  }
+       *  @endcode
+       */
+      bool read_packed( uint64_t primary, packed_buffer& buffer )const {
+         auto itr = db_find_i64( _code, _scope, TableName, primary );
+         if( itr < 0 ) return false;
+
+         auto size = db_get_i64( itr, nullptr, 0 );
+         eosio_assert( size >= 0, "error reading iterator" );
+         db_get_i64( itr, buffer.resize( size_t(size) ), uint32_t(size) );
+         return true;
+      }
+
       /**
        *  Search for an existing object in a table using its primary key.
        *  @brief Search for an existing object in a table using its primary key.
@@ -2008,11 +2200,8 @@ class multi_index
        */
 
       const_iterator require_find( uint64_t primary, const char* error_msg = "unable to find key" )const {
-         auto itr2 = std::find_if(_items_vector.rbegin(), _items_vector.rend(), [&](const item_ptr& ptr) {
-               return ptr._item->primary_key() == primary;
-            });
-         if( itr2 != _items_vector.rend() )
-            return iterator_to(*(itr2->_item));
+         if( const item* cached = find_cached_object( primary ) )
+            return iterator_to(*cached);
 
          auto itr = db_find_i64( _code, _scope, TableName, primary );
          eosio_assert( itr >= 0,  error_msg );
@@ -2154,14 +2343,8 @@ class multi_index
          eosio_assert( objitem.__idx == this, "object passed to erase is not in multi_index" );
          eosio_assert( _code == current_receiver(), "cannot erase objects in table of another contract" ); // Quick fix for mutating db using multi_index that shouldn't allow mutation. Real fix can come in RC2.
 
-         auto pk = objitem.primary_key();
-         auto itr2 = std::find_if(_items_vector.rbegin(), _items_vector.rend(), [&](const item_ptr& ptr) {
-            return ptr._item->primary_key() == pk;
-         });
-
-         eosio_assert( itr2 != _items_vector.rend(), "attempt to remove object that was not in multi_index" );
-
-         _items_vector.erase(--(itr2.base()));
+         auto pos = _items_by_primary_key.find( objitem.primary_key() );
+         eosio_assert( pos != loaded_object_index::npos, "attempt to remove object that was not in multi_index" );
 
          db_remove_i64( objitem.__primary_itr );
 
@@ -2176,6 +2359,10 @@ class multi_index
             if( i >= 0 )
                secondary_index_db_functions<typename index_type::secondary_key_type>::db_idx_remove( i );
          });
+
+         // last, objitem is destroyed with its cache entry
+         uncache_object( pos );
+         ++table_write_generation();
       }
 
 };
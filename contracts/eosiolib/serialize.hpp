@@ -4,9 +4,90 @@
 #include <boost/preprocessor/seq/seq.hpp>
 #include <boost/preprocessor/stringize.hpp>
 
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
 #define EOSLIB_REFLECT_MEMBER_OP( r, OP, elem ) \
   OP t.elem 
 
+#define EOSLIB_REFLECT_MEMBER_SIZE( r, TYPE, elem ) \
+  + sizeof(TYPE::elem)
+
+#define EOSLIB_REFLECT_MEMBER_PACKED( r, TYPE, elem ) \
+  && eosio::_serialize_detail::is_packed<std::remove_cv_t<decltype(TYPE::elem)>>()
+
+#define EOSLIB_REFLECT_MEMBER_NEXT( r, TYPE, elem ) \
+  .next( offsetof(TYPE, elem), sizeof(TYPE::elem) )
+
+// offsetof is only meaningful for the trivially copyable structs packed_candidate lets through
+#ifdef __clang__
+#define EOSLIB_OFFSETOF_BEGIN _Pragma("clang diagnostic push") _Pragma("clang diagnostic ignored \"-Winvalid-offsetof\"")
+#define EOSLIB_OFFSETOF_END _Pragma("clang diagnostic pop")
+#else
+#define EOSLIB_OFFSETOF_BEGIN
+#define EOSLIB_OFFSETOF_END
+#endif
+
+namespace eosio { namespace _serialize_detail {
+
+   /**
+    * Types whose serialized form is their memory image, other than primitives and EOSLIB_SERIALIZE structs made
+    * only of such types. Specialized by datastream.hpp for the checksums and public keys it writes as raw bytes.
+    */
+   template<typename T>
+   struct is_raw_layout : std::false_type {};
+
+   /// gives access to the layout of structs declaring EOSLIB_SERIALIZE in a private section
+   struct packed_access {
+      template<typename T>
+      static constexpr auto packed_layout( int ) -> decltype( std::is_same<typename T::_eoslib_packed_type, T>::value ) {
+         // a struct inheriting the macro of its base is not covered by it
+         return std::is_same<typename T::_eoslib_packed_type, T>::value && T::_eoslib_packed_layout();
+      }
+      template<typename T>
+      static constexpr bool packed_layout( long ) { return false; }
+   };
+
+   /**
+    * Whether T is serialized as the sizeof(T) bytes of its memory image. A bool is read back as any non zero byte,
+    * so it is not.
+    */
+   template<typename T>
+   constexpr bool is_packed() {
+      return (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value ||
+             is_raw_layout<T>::value || packed_access::packed_layout<T>( 0 );
+   }
+
+   /// a std::array is serialized element by element, without a size
+   template<typename T, size_t N>
+   struct is_raw_layout<std::array<T,N>> : std::integral_constant<bool, is_packed<T>() && sizeof(std::array<T,N>) == N * sizeof(T)> {};
+
+   /**
+    * First part of the check for an EOSLIB_SERIALIZE struct: its members, together, take all of its bytes
+    */
+   template<typename T>
+   constexpr bool packed_candidate( size_t member_sizes ) {
+      return std::is_trivially_copyable<T>::value && member_sizes == sizeof(T);
+   }
+
+   /**
+    * Second part: the members are listed in the order they are laid out, each starting where the one before ends.
+    * Together with packed_candidate that means there is no padding and nothing that is not serialized. It is part
+    * of the layout of the struct, so a struct listing its members out of order is not packed as a member either.
+    */
+   struct layout_cursor {
+      size_t pos;
+      bool   in_order;
+
+      constexpr layout_cursor next( size_t offset, size_t size )const {
+         return { offset + size, in_order && offset == pos };
+      }
+      constexpr bool ends_at( size_t end )const { return in_order && pos == end; }
+   };
+
+} } /// namespace eosio::_serialize_detail
+
 /**
  * @defgroup serialize Serialize API
  * @brief Defines functions to serialize and deserialize object
@@ -23,18 +104,40 @@
 /**
  *  Defines serialization and deserialization for a class
  *
+ *  A class whose members are all primitives or such classes, listed in the order they are declared and without
+ *  padding between them, such as asset and symbol_type, is serialized with a single copy of its bytes rather than
+ *  member by member.
+ *
  *  @brief Defines serialization and deserialization for a class
  *
  *  @param TYPE - the class to have its serialization and deserialization defined
  *  @param MEMBERS - a sequence of member names.  (field1)(field2)(field3)
  */
 #define EOSLIB_SERIALIZE( TYPE,  MEMBERS ) \
+ friend struct eosio::_serialize_detail::packed_access; \
+ typedef TYPE _eoslib_packed_type; \
+ EOSLIB_OFFSETOF_BEGIN \
+ static constexpr bool _eoslib_packed_layout() { \
+    return eosio::_serialize_detail::packed_candidate<TYPE>( 0 BOOST_PP_SEQ_FOR_EACH( EOSLIB_REFLECT_MEMBER_SIZE, TYPE, MEMBERS ) ) \
+           && eosio::_serialize_detail::layout_cursor{ 0, true } \
+                 BOOST_PP_SEQ_FOR_EACH( EOSLIB_REFLECT_MEMBER_NEXT, TYPE, MEMBERS ).ends_at( sizeof(TYPE) ) \
+           BOOST_PP_SEQ_FOR_EACH( EOSLIB_REFLECT_MEMBER_PACKED, TYPE, MEMBERS ); \
+ } \
+ EOSLIB_OFFSETOF_END \
  template<typename DataStream> \
  friend DataStream& operator << ( DataStream& ds, const TYPE& t ){ \
+    if( TYPE::_eoslib_packed_layout() ) { \
+       ds.write( (const char*)&t, sizeof(TYPE) ); \
+       return ds; \
+    } \
     return ds BOOST_PP_SEQ_FOR_EACH( EOSLIB_REFLECT_MEMBER_OP, <<, MEMBERS );\
  }\
  template<typename DataStream> \
  friend DataStream& operator >> ( DataStream& ds, TYPE& t ){ \
+    if( TYPE::_eoslib_packed_layout() ) { \
+       ds.read( (char*)&t, sizeof(TYPE) ); \
+       return ds; \
+    } \
     return ds BOOST_PP_SEQ_FOR_EACH( EOSLIB_REFLECT_MEMBER_OP, >>, MEMBERS );\
  } 
 
@@ -0,0 +1,300 @@
+/**
+ *  @file view.hpp
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosiolib/action.h>
+#include <eosiolib/datastream.hpp>
+
+#include <tuple>
+#include <utility>
+
+namespace eosio {
+
+/**
+ * @defgroup view Views
+ * @brief Read-only access to serialized data without deserializing it into owning types
+ * @ingroup serialize
+ *
+ * A view points into the buffer it was unpacked from and is only valid while that buffer is. Views are unpacked
+ * from a `datastream<const char*>` only, and packed the same way as the owning type they stand for, so a
+ * `bytes_view` reads a `bytes` field and a `string_view` reads a `std::string` field.
+ * @{
+ */
+
+/**
+ *  Bytes of a serialized `bytes` (`std::vector<char>`) field, left in place
+ *
+ *  @brief Bytes of a serialized bytes field, left in place
+ */
+class bytes_view {
+   public:
+      bytes_view() = default;
+      bytes_view( const char* d, size_t s ) : _data(d), _size(s) {}
+
+      const char* data()const  { return _data; }
+      size_t      size()const  { return _size; }
+      bool        empty()const { return _size == 0; }
+
+      const char* begin()const { return _data; }
+      const char* end()const   { return _data + _size; }
+      char operator[]( size_t i )const { return _data[i]; }
+
+      /**
+       * Copies the bytes into an owning vector
+       *
+       * @brief Copies the bytes into an owning vector
+       * @return bytes - The copy
+       */
+      bytes to_bytes()const { return bytes( _data, _data + _size ); }
+
+      friend bool operator==( const bytes_view& a, const bytes_view& b ) {
+         return a._size == b._size && (a._size == 0 || memcmp( a._data, b._data, a._size ) == 0);
+      }
+      friend bool operator!=( const bytes_view& a, const bytes_view& b ) { return !(a == b); }
+
+   private:
+      const char* _data = nullptr;
+      size_t      _size = 0;
+};
+
+/**
+ *  Characters of a serialized `std::string` field, left in place. Not null terminated.
+ *
+ *  @brief Characters of a serialized string field, left in place
+ */
+class string_view : public bytes_view {
+   public:
+      using bytes_view::bytes_view;
+
+      /**
+       * Copies the characters into an owning string
+       *
+       * @brief Copies the characters into an owning string
+       * @return std::string - The copy
+       */
+      std::string to_string()const { return std::string( data(), size() ); }
+
+      friend bool operator==( const string_view& a, const char* s ) {
+         return a == string_view( s, strlen( s ) );
+      }
+};
+
+/**
+ *  Deserialize a bytes_view, pointing it at the bytes in the stream
+ *
+ *  @brief Deserialize a bytes_view
+ *  @param ds - The stream to read
+ *  @param v - The destination for deserialized value
+ *  @return datastream<const char*>& - Reference to the datastream
+ */
+inline datastream<const char*>& operator>>( datastream<const char*>& ds, bytes_view& v ) {
+   unsigned_int s;
+   ds >> s;
+   eosio_assert( ds.remaining() >= s.value, "read" );
+   v = bytes_view( ds.pos(), s.value );
+   ds.skip( s.value );
+   return ds;
+}
+
+/**
+ *  Serialize a bytes_view, the same as the bytes it points at
+ *
+ *  @brief Serialize a bytes_view
+ *  @param ds - The stream to write
+ *  @param v - The value to serialize
+ *  @tparam DataStream - Type of datastream
+ *  @return DataStream& - Reference to the datastream
+ */
+template<typename DataStream>
+DataStream& operator<<( DataStream& ds, const bytes_view& v ) {
+   ds << unsigned_int( v.size() );
+   if( v.size() )
+      ds.write( v.data(), v.size() );
+   return ds;
+}
+
+inline datastream<const char*>& operator>>( datastream<const char*>& ds, string_view& v ) {
+   return ds >> static_cast<bytes_view&>(v);
+}
+
+template<typename DataStream>
+DataStream& operator<<( DataStream& ds, const string_view& v ) {
+   return ds << static_cast<const bytes_view&>(v);
+}
+
+namespace _view_detail {
+   template<typename T, std::enable_if_t<_datastream_detail::is_primitive<T>()>* = nullptr>
+   void skip( datastream<const char*>& ds ) {
+      eosio_assert( ds.remaining() >= sizeof(T), "read" );
+      ds.skip( sizeof(T) );
+   }
+
+   /// anything else is read and dropped; declare such fields as views to skip them without copying
+   template<typename T, std::enable_if_t<!_datastream_detail::is_primitive<T>()>* = nullptr>
+   void skip( datastream<const char*>& ds ) {
+      T v;
+      ds >> v;
+   }
+}
+
+/**
+ *  A serialized struct of the given leading fields, decoded one field at a time as it is asked for
+ *
+ *  Fields are listed in the order they are serialized. Only the fields up to the last one read need to be listed,
+ *  and fields listed as `bytes_view` or `string_view` are skipped without copying them. Reading a field decodes the
+ *  fields before it again, so fields read often are better copied out once.
+ *
+ *  @code
+ *  // the sender and the amount of a transfer, without copying its memo
+ *  auto v = unpack_action_data_view<struct_view<account_name, account_name, asset>>( buffer );
+ *  account_name from = v.get<0>();
+ *  asset quantity = v.get<2>();
+ *  @endcode
+ *
+ *  @brief A serialized struct, decoded one field at a time
+ *  @tparam Fields - Types of the leading fields, in serialization order
+ */
+template<typename... Fields>
+class struct_view {
+   public:
+      template<size_t I>
+      using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+      struct_view() = default;
+      struct_view( const char* d, size_t s ) : _data(d), _size(s) {}
+
+      /**
+       * Decodes field I
+       *
+       * @brief Decodes field I
+       * @tparam I - Index of the field in Fields
+       * @return field_type<I> - The field
+       */
+      template<size_t I>
+      field_type<I> get()const {
+         datastream<const char*> ds( _data, _size );
+         skip_fields( ds, std::make_index_sequence<I>() );
+         field_type<I> v;
+         ds >> v;
+         return v;
+      }
+
+      /**
+       * The serialized struct and whatever followed it in the stream it was read from
+       *
+       * @brief The serialized struct
+       * @return bytes_view - The bytes the fields are read from
+       */
+      bytes_view packed()const { return bytes_view( _data, _size ); }
+
+   private:
+      template<size_t... Is>
+      static void skip_fields( datastream<const char*>& ds, std::index_sequence<Is...> ) {
+         // a braced list is evaluated in order
+         int unused[] = { 0, (_view_detail::skip<field_type<Is>>( ds ), 0)... };
+         (void)unused;
+      }
+
+      const char* _data = nullptr;
+      size_t      _size = 0;
+};
+
+/**
+ *  Deserialize a struct_view. Its size is not known without decoding every field, so it takes the rest of the
+ *  stream and has to be the last value read from it.
+ *
+ *  @brief Deserialize a struct_view
+ *  @param ds - The stream to read
+ *  @param v - The destination for deserialized value
+ *  @return datastream<const char*>& - Reference to the datastream
+ */
+template<typename... Fields>
+datastream<const char*>& operator>>( datastream<const char*>& ds, struct_view<Fields...>& v ) {
+   v = struct_view<Fields...>( ds.pos(), ds.remaining() );
+   ds.skip( ds.remaining() );
+   return ds;
+}
+
+/**
+ *  Owner of serialized data that views are unpacked from, on the stack up to inline_size bytes and on the heap
+ *  beyond. Not copyable, so that views into it are not left pointing at a copy that went away.
+ *
+ *  @brief Owner of serialized data that views point into
+ */
+class packed_buffer {
+   public:
+      static constexpr size_t inline_size = 512;
+
+      packed_buffer() = default;
+      ~packed_buffer() { if( _heap ) free( _heap ); }
+
+      packed_buffer( const packed_buffer& ) = delete;
+      packed_buffer& operator=( const packed_buffer& ) = delete;
+
+      /// moving a buffer that fits inline copies it, so views into the moved from buffer are not valid for the new one
+      packed_buffer( packed_buffer&& o ) : _heap(o._heap), _capacity(o._capacity), _size(o._size) {
+         if( !_heap ) memcpy( _inline, o._inline, _size );
+         o._heap = nullptr;
+         o._capacity = inline_size;
+         o._size = 0;
+      }
+
+      /**
+       * Makes room for s bytes, dropping the current contents
+       *
+       * @brief Makes room for s bytes
+       * @param s - The new size
+       * @return char* - The start of the buffer
+       */
+      char* resize( size_t s ) {
+         if( s > _capacity ) {
+            if( _heap ) free( _heap );
+            _heap = (char*)malloc( s );
+            _capacity = s;
+         }
+         _size = s;
+         return data();
+      }
+
+      char*       data()       { return _heap ? _heap : _inline; }
+      const char* data()const  { return _heap ? _heap : _inline; }
+      size_t      size()const  { return _size; }
+
+      datastream<const char*> stream()const { return datastream<const char*>( data(), _size ); }
+
+      /**
+       * Unpacks T, typically a view or a struct of views, from the start of the buffer
+       *
+       * @brief Unpacks T from the start of the buffer
+       * @tparam T - Type of the unpacked data
+       * @return T - The unpacked data
+       */
+      template<typename T>
+      T unpack()const { return eosio::unpack<T>( data(), _size ); }
+
+   private:
+      char   _inline[inline_size];
+      char*  _heap = nullptr;
+      size_t _capacity = inline_size;
+      size_t _size = 0;
+};
+
+/**
+ *  Reads the data of the current action into buffer and unpacks T from it. Unlike unpack_action_data, views in T
+ *  point into buffer rather than being copied out.
+ *
+ *  @brief Unpacks the data of the current action as views into buffer
+ *  @tparam T - Type of the unpacked data
+ *  @param buffer - Receives the action data, and has to outlive the views unpacked from it
+ *  @return T - The unpacked data
+ */
+template<typename T>
+T unpack_action_data_view( packed_buffer& buffer ) {
+   auto size = action_data_size();
+   read_action_data( buffer.resize( size ), size );
+   return buffer.unpack<T>();
+}
+
+/// @} view
+}
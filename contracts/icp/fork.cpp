@@ -8,22 +8,45 @@ fork_store::fork_store(account_name code)
       _blocks(code, code),
       _active_schedule(code, code),
       _pending_schedule(code, code),
-      _store_meter(code, code)
+      _store_meter(code, code),
+      _store_mode(code, code),
+      _ring_blocks(code, code),
+      _ring_head(code, code),
+      _merkle_bases(code, code),
+      _merkle_base_refs(code, code)
 {
     if (!_store_meter.exists()) {
         set_max_blocks(2 * 60 * 60 + 120); // default store blocks max one hour, and add some for fork branches
     }
+    _ring = _store_mode.get_or_default(store_mode{}).ring_slots;
 }
 
 void fork_store::set_max_blocks(uint32_t max) {
+    eosio_assert(!_ring || is_empty(), "cannot change max blocks of ring slots in use");
+    eosio_assert(!_ring || max > 0, "invalid max blocks");
     _store_meter.set(store_meter{max, 0}, _code);
 }
 
+void fork_store::set_ring_mode(bool ring) {
+    eosio_assert(is_empty(), "cannot change store mode of seeded store");
+    eosio_assert(!ring || _store_meter.get().max_blocks > 0, "invalid max blocks");
+    _store_mode.set(store_mode{ring}, _code);
+    _ring = ring;
+}
+
+bool fork_store::is_empty() {
+    return _block_states.begin() == _block_states.end() && !_ring_head.exists();
+}
+
 void fork_store::validate_block_state(const block_header_state& h) {
     h.validate();
 
-    auto by_blockid = _block_states.get_index<N(blockid)>();
-    eosio_assert(by_blockid.find(to_key256(h.id)) == by_blockid.end(), "already existing block");
+    if (_ring) {
+        eosio_assert(!ring_contains(h.id) || !ring_get(h.id).has_state, "already existing block");
+    } else {
+        auto by_blockid = _block_states.get_index<N(blockid)>();
+        eosio_assert(by_blockid.find(to_key256(h.id)) == by_blockid.end(), "already existing block");
+    }
     eosio_assert(is_producer(h.header.producer, h.block_signing_key), "invalid producer");
     auto previous_block_num = block_header::num_from_id(h.header.previous);
     eosio_assert(previous_block_num + 1 == h.block_num, "unlinkable block");
@@ -50,7 +73,7 @@ void fork_store::validate_block_state(const block_header_state& h) {
 }
 
 void fork_store::init_seed_block(const block_header_state& block_state) {
-    eosio_assert(_block_states.begin() == _block_states.end(), "already seeded");
+    eosio_assert(is_empty(), "already seeded");
 
     update_active_schedule(block_state.active_schedule, false);
     validate_block_state(block_state);
@@ -64,6 +87,16 @@ void fork_store::reset() {
     for (auto it = _blocks.begin(); it != _blocks.end();) {
         it = _blocks.erase(it);
     }
+    for (auto it = _ring_blocks.begin(); it != _ring_blocks.end();) {
+        it = _ring_blocks.erase(it);
+    }
+    for (auto it = _merkle_bases.begin(); it != _merkle_bases.end();) {
+        it = _merkle_bases.erase(it);
+    }
+    for (auto it = _merkle_base_refs.begin(); it != _merkle_base_refs.end();) {
+        it = _merkle_base_refs.erase(it);
+    }
+    _ring_head.remove();
     _active_schedule.remove();
     _pending_schedule.remove();
     meter_remove_blocks();
@@ -89,35 +122,42 @@ void fork_store::add_block_header_with_merkle_path(const block_header_state& h,
 
     // To allow following block headers discontinuously, the skipped block ids should be used to compose the merkle proof
     block_id_type prev_id = merkle_path.empty() ? h.header.previous : merkle_path.front();
-    auto mroot = get_block_mroot(prev_id); // first
+    optional<uint64_t> mroot_base;
+    auto mroot = get_block_mroot(prev_id, &mroot_base); // first
     if (!merkle_path.empty()) {
         for (auto it = merkle_path.cbegin() + 1, pit = merkle_path.cbegin(); it != merkle_path.cend(); pit = it++) {
             mroot.append(*it); // intermediate
 
             add_block_id(*it, *pit);
         }
-        meter_add_blocks(merkle_path.size() - 1);
+        if (!_ring) meter_add_blocks(merkle_path.size() - 1);
     }
     mroot.append(h.id); // last
     eosio_assert(h.blockroot_merkle.get_root() == mroot.get_root(), "unlinkable block");
 
-    add_block_state(h);
+    add_block_state(h, mroot_base); // most active nodes are those of the block appended to
 }
 
-void fork_store::add_block_state(const block_header_state& block_state) {
+void fork_store::add_block_state(const block_header_state& block_state, const optional<uint64_t>& mroot_base) {
+    if (_ring) return ring_add_block_state(block_state);
+
     auto by_blockid = _block_states.get_index<N(blockid)>();
     eosio_assert(by_blockid.find(to_key256(block_state.id)) == by_blockid.end(), "already existing block");
 
     meter_add_blocks(1);
 
+    stored_block_header_state s;
+    s.id = block_state.id;
+    s.block_num = block_state.block_num;
+    s.previous = block_state.header.previous;
+    s.dpos_irreversible_blocknum = block_state.dpos_irreversible_blocknum;
+    s.bft_irreversible_blocknum = block_state.bft_irreversible_blocknum;
+    s.blockroot_merkle = block_state.blockroot_merkle;
+    compact_blockroot_merkle(s, mroot_base);
+
     _block_states.emplace(_code, [&](auto& b) {
+       b = s;
        b.pk = _block_states.available_primary_key();
-       b.id = block_state.id;
-       b.block_num = block_state.block_num;
-       b.previous = block_state.header.previous;
-       b.dpos_irreversible_blocknum = block_state.dpos_irreversible_blocknum;
-       b.bft_irreversible_blocknum = block_state.bft_irreversible_blocknum;
-       b.blockroot_merkle = block_state.blockroot_merkle;
     });
 
     _blocks.emplace(_code, [&](auto& b) {
@@ -163,6 +203,12 @@ void fork_store::prune(const stored_block_header_state& block_state) {
 }
 
 void fork_store::cutdown(uint32_t block_num) {
+    if (_ring) {
+        // slots are pruned by being overwritten
+        eosio_assert(block_num <= _ring_head.get().last_irreversible_block_num, "block number not irreversible");
+        return;
+    }
+
     auto head = *_block_states.get_index<N(libblocknum)>().begin();
     auto lib = head.last_irreversible_blocknum();
     eosio_assert(block_num <= lib, "block number not irreversible");
@@ -171,6 +217,7 @@ void fork_store::cutdown(uint32_t block_num) {
     {
         auto by_blocknum = _block_states.get_index<N(blocknum)>();
         for (auto it = by_blocknum.begin(); it != by_blocknum.end() && it->block_num <= block_num;) {
+            if (it->compact) release_merkle_base(it->mroot_base);
             by_blocknum.erase(it);
             it = by_blocknum.begin();
         }
@@ -197,6 +244,7 @@ void fork_store::remove(const block_id_type& id) {
             auto by_blockid = _block_states.get_index<N(blockid)>();
             auto it = by_blockid.find(remove_queue[i]);
             if (it != by_blockid.end()) {
+                if (it->compact) release_merkle_base(it->mroot_base);
                 by_blockid.erase(it);
             }
         }
@@ -229,6 +277,17 @@ void fork_store::remove(const block_id_type& id) {
 }
 
 void fork_store::add_block_header(const block_header& h) {
+    if (_ring) {
+        auto id = h.id();
+        eosio_assert(ring_contains(id), "missing block");
+        auto it = _ring_blocks.find(h.block_num() % _store_meter.get().max_blocks);
+        eosio_assert(!it->has_action_mroot(), "already complete block");
+        _ring_blocks.modify(it, 0, [&](auto& o) {
+            o.action_mroot = h.action_mroot;
+        });
+        return;
+    }
+
     auto by_blockid = _blocks.get_index<N(blockid)>();
     auto b = by_blockid.find(to_key256(h.id()));
     eosio_assert(b != by_blockid.end(), "missing block");
@@ -239,6 +298,12 @@ void fork_store::add_block_header(const block_header& h) {
 }
 
 void fork_store::add_block_id(const block_id_type& block_id, const block_id_type& previous) {
+    if (_ring) {
+        eosio_assert(!ring_contains(block_id), "already existing block");
+        ring_put(block_id, previous, [](auto&) {}); // absent `action_mroot` and state
+        return;
+    }
+
     auto by_blockid = _blocks.get_index<N(blockid)>();
     eosio_assert(by_blockid.find(to_key256(block_id)) == by_blockid.end(), "already existing block");
 
@@ -280,13 +345,112 @@ void fork_store::set_pending_schedule(uint32_t lib_num, const digest_type& hash,
     _pending_schedule.set(s, _code);
 }
 
-incremental_merkle fork_store::get_block_mroot(const block_id_type& block_id) {
+incremental_merkle fork_store::get_block_mroot(const block_id_type& block_id, optional<uint64_t>* mroot_base) {
+    if (_ring) {
+        auto& b = ring_get(block_id);
+        eosio_assert(b.has_state, "missing block state");
+        return b.blockroot_merkle;
+    }
+
     auto by_blockid = _block_states.get_index<N(blockid)>();
     auto b = by_blockid.get(to_key256(block_id));
-    return b.blockroot_merkle;
+    if (mroot_base && b.compact) *mroot_base = b.mroot_base;
+    return blockroot_merkle(b);
+}
+
+// Whole `blockroot_merkle` of a stored block state
+incremental_merkle fork_store::blockroot_merkle(const stored_block_header_state& b) {
+    if (!b.compact) return b.blockroot_merkle;
+
+    const auto& own = b.blockroot_merkle._active_nodes;
+    const auto& shared = _merkle_bases.get(b.mroot_base, "missing merkle base").merkle._active_nodes;
+    eosio_assert(!own.empty() && b.base_shared_from < shared.size(), "invalid compact merkle");
+
+    incremental_merkle m;
+    m._node_count = b.blockroot_merkle._node_count;
+    m._active_nodes.reserve(own.size() + shared.size() - b.base_shared_from - 1);
+    m._active_nodes.insert(m._active_nodes.end(), own.cbegin(), own.cend() - 1);
+    m._active_nodes.insert(m._active_nodes.end(), shared.cbegin() + b.base_shared_from, shared.cend() - 1);
+    m._active_nodes.push_back(own.back());
+    return m;
+}
+
+/**
+ * Appending to an incremental merkle only changes its lowest active nodes and its root, so the ones above are
+ * shared with the merkle base of the block the state was appended to, as long as that base still has most of
+ * them. Otherwise the merkle of the state becomes a new base.
+ */
+void fork_store::compact_blockroot_merkle(stored_block_header_state& b, const optional<uint64_t>& mroot_base) {
+    auto& nodes = b.blockroot_merkle._active_nodes;
+    if (nodes.size() < 2) return; // nothing to share, kept whole in the old format
+
+    if (mroot_base) {
+        const auto& shared = _merkle_bases.get(*mroot_base, "missing merkle base").merkle._active_nodes;
+
+        // the shared nodes are the tail of both, before their roots
+        size_t n = 0;
+        while (n + 1 < nodes.size() && n + 1 < shared.size() && nodes[nodes.size() - 2 - n] == shared[shared.size() - 2 - n]) ++n;
+
+        auto own = nodes.size() - 1 - n;
+        if (own <= std::max<size_t>(n, 4)) {
+            take_merkle_base(*mroot_base);
+            b.compact = true;
+            b.mroot_base = *mroot_base;
+            b.base_shared_from = static_cast<uint32_t>(shared.size() - 1 - n);
+            nodes.erase(nodes.end() - 1 - n, nodes.end() - 1);
+            return;
+        }
+    }
+
+    auto pk = _merkle_bases.available_primary_key();
+    _merkle_bases.emplace(_code, [&](auto& o) {
+        o.pk = pk;
+        o.merkle = b.blockroot_merkle;
+    });
+    take_merkle_base(pk);
+    b.compact = true;
+    b.mroot_base = pk;
+    b.base_shared_from = 0;
+    nodes.erase(nodes.begin(), nodes.end() - 1); // only the root is its own
+}
+
+void fork_store::take_merkle_base(uint64_t base) {
+    auto it = _merkle_base_refs.find(base);
+    if (it == _merkle_base_refs.end()) {
+        _merkle_base_refs.emplace(_code, [&](auto& o) {
+            o.base = base;
+            o.refs = 1;
+        });
+    } else {
+        _merkle_base_refs.modify(it, 0, [&](auto& o) {
+            ++o.refs;
+        });
+    }
+}
+
+void fork_store::release_merkle_base(uint64_t base) {
+    auto it = _merkle_base_refs.find(base);
+    if (it == _merkle_base_refs.end()) return;
+
+    if (it->refs > 1) {
+        _merkle_base_refs.modify(it, 0, [&](auto& o) {
+            --o.refs;
+        });
+        return;
+    }
+
+    _merkle_base_refs.erase(it);
+    auto bit = _merkle_bases.find(base);
+    if (bit != _merkle_bases.end()) _merkle_bases.erase(bit);
 }
 
 checksum256 fork_store::get_action_mroot(const block_id_type& block_id) {
+    if (_ring) {
+        auto& b = ring_get(block_id);
+        eosio_assert(b.block_num <= _ring_head.get().last_irreversible_block_num, "block number not irreversible");
+        return b.action_mroot;
+    }
+
     auto by_blockid = _blocks.get_index<N(blockid)>();
     auto b = by_blockid.get(to_key256(block_id));
 
@@ -296,6 +460,95 @@ checksum256 fork_store::get_action_mroot(const block_id_type& block_id) {
     return b.action_mroot;
 }
 
+bool fork_store::ring_contains(const block_id_type& id) {
+    auto it = _ring_blocks.find(block_header::num_from_id(id) % _store_meter.get().max_blocks);
+    return it != _ring_blocks.end() && it->id == id;
+}
+
+const ring_block_slot& fork_store::ring_get(const block_id_type& id) {
+    auto& b = _ring_blocks.get(block_header::num_from_id(id) % _store_meter.get().max_blocks, "missing block");
+    eosio_assert(b.id == id, "missing block");
+    return b;
+}
+
+/**
+ * Overwrite the slot of the block with it, if it extends the chain held by the slots and the slot only holds an
+ * older irreversible block. Fork blocks are refused, as they would overwrite a block of the chain, so that the
+ * slots always hold one linked chain whose blocks from the last irreversible one on are never overwritten.
+ */
+template <typename Lambda>
+void fork_store::ring_put(const block_id_type& id, const block_id_type& previous, Lambda&& updater) {
+    auto num = block_header::num_from_id(id);
+    auto slot = num % _store_meter.get().max_blocks;
+
+    auto it = _ring_blocks.find(slot);
+    if (it != _ring_blocks.end()) {
+        eosio_assert(it->block_num < num, "fork block refused by ring slots");
+        eosio_assert(it->block_num < _ring_head.get_or_default(ring_head{}).last_irreversible_block_num, "ring slots full of reversible blocks");
+    }
+    if (_ring_head.exists()) { // but the seed block
+        eosio_assert(block_header::num_from_id(previous) + 1 == num && ring_contains(previous), "unlinkable block");
+    }
+
+    auto reset = [&](auto& o) {
+        o.slot = slot;
+        o.id = id;
+        o.block_num = num;
+        o.previous = previous;
+        o.action_mroot = checksum256{};
+        o.has_state = false;
+        o.dpos_irreversible_blocknum = 0;
+        o.bft_irreversible_blocknum = 0;
+        o.blockroot_merkle = incremental_merkle();
+        updater(o);
+    };
+
+    if (it == _ring_blocks.end()) {
+        meter_add_blocks(1);
+        _ring_blocks.emplace(_code, reset);
+    } else {
+        _ring_blocks.modify(it, 0, reset);
+    }
+}
+
+void fork_store::ring_add_block_state(const block_header_state& block_state) {
+    if (ring_contains(block_state.id)) {
+        // already added as a part of merkle path, keep its `action_mroot` if any
+        auto it = _ring_blocks.find(block_state.block_num % _store_meter.get().max_blocks);
+        eosio_assert(it->previous == block_state.header.previous, "unlinkable block");
+        _ring_blocks.modify(it, 0, [&](auto& o) {
+            o.has_state = true;
+            o.dpos_irreversible_blocknum = block_state.dpos_irreversible_blocknum;
+            o.bft_irreversible_blocknum = block_state.bft_irreversible_blocknum;
+            o.blockroot_merkle = block_state.blockroot_merkle;
+        });
+    } else {
+        ring_put(block_state.id, block_state.header.previous, [&](auto& o) {
+            o.action_mroot = block_state.header.action_mroot;
+            o.has_state = true;
+            o.dpos_irreversible_blocknum = block_state.dpos_irreversible_blocknum;
+            o.bft_irreversible_blocknum = block_state.bft_irreversible_blocknum;
+            o.blockroot_merkle = block_state.blockroot_merkle;
+        });
+    }
+
+    auto head = _ring_head.get_or_default(ring_head{});
+    head.head_block_num = block_state.block_num;
+    head.head_block_id = block_state.id;
+
+    // The slots from the last irreversible block to the head are never overwritten, so a newer irreversible block
+    // is in its slot, unless it precedes the seed block. Its number and id only ever change together.
+    auto lib = std::max(block_state.dpos_irreversible_blocknum, block_state.bft_irreversible_blocknum);
+    if (lib > head.last_irreversible_block_num) {
+        auto it = _ring_blocks.find(lib % _store_meter.get().max_blocks);
+        if (it != _ring_blocks.end() && it->block_num == lib) {
+            head.last_irreversible_block_num = lib;
+            head.last_irreversible_block_id = it->id;
+        }
+    }
+    _ring_head.set(head, _code);
+}
+
 void fork_store::meter_add_blocks(uint32_t num) {
     if (num <= 0) return;
     auto meter = _store_meter.get();
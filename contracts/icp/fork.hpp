@@ -61,12 +61,40 @@ struct [[eosio::table]] stored_block_header_state {
     uint32_t dpos_irreversible_blocknum;
     uint32_t bft_irreversible_blocknum;
 
-    incremental_merkle blockroot_merkle; // merkle root of block ids
+    incremental_merkle blockroot_merkle; // merkle root of block ids, see `compact`
+
+    // In a compact row `blockroot_merkle` keeps only its lowest active nodes and its root, the active nodes in
+    // between are those of the `mrootbase` row `mroot_base` from `base_shared_from` on, excluding the root there.
+    // Rows of the old format end with a whole `blockroot_merkle`, compact ones go on with `compact_format`.
+    static constexpr uint8_t compact_format = 1;
+    bool compact = false;
+    uint64_t mroot_base = 0;
+    uint32_t base_shared_from = 0;
 
     uint32_t last_irreversible_blocknum() {
        return std::max(dpos_irreversible_blocknum, bft_irreversible_blocknum);
     }
 
+    template<typename DataStream>
+    friend DataStream& operator<<(DataStream& ds, const stored_block_header_state& s) {
+        ds << s.pk << s.id << s.block_num << s.previous << s.dpos_irreversible_blocknum << s.bft_irreversible_blocknum << s.blockroot_merkle;
+        if (s.compact) ds << compact_format << s.mroot_base << s.base_shared_from;
+        return ds;
+    }
+
+    template<typename DataStream>
+    friend DataStream& operator>>(DataStream& ds, stored_block_header_state& s) {
+        ds >> s.pk >> s.id >> s.block_num >> s.previous >> s.dpos_irreversible_blocknum >> s.bft_irreversible_blocknum >> s.blockroot_merkle;
+        s.compact = ds.remaining() > 0; // rows stored before compaction end with `blockroot_merkle`
+        if (s.compact) {
+            uint8_t format = 0;
+            ds >> format;
+            eosio_assert(format == compact_format, "unknown block state format");
+            ds >> s.mroot_base >> s.base_shared_from;
+        }
+        return ds;
+    }
+
     auto primary_key() const { return pk; }
     key256 by_blockid() const { return to_key256(id); }
     key256 by_prev() const { return to_key256(previous); }
@@ -83,6 +111,68 @@ typedef multi_index<N(blockstate), stored_block_header_state,
         indexed_by<N(libblocknum), const_mem_fun<stored_block_header_state, uint128_t, &stored_block_header_state::by_lib_block_num>>
 > stored_block_header_state_table;
 
+/* Active nodes shared by the blockroot merkles of compact block states */
+struct [[eosio::table]] merkle_base {
+    uint64_t pk;
+
+    incremental_merkle merkle; // of the block state it was taken from
+
+    auto primary_key() const { return pk; }
+};
+
+typedef multi_index<N(mrootbase), merkle_base> merkle_base_table;
+
+/* Number of block states sharing a merkle base, kept apart so that counting does not rewrite the nodes */
+struct [[eosio::table]] merkle_base_refs {
+    uint64_t base;
+    uint32_t refs = 0;
+
+    auto primary_key() const { return base; }
+};
+
+typedef multi_index<N(mrootrefs), merkle_base_refs> merkle_base_refs_table;
+
+/* Block header in the ring slot table, only used in ring store mode */
+struct [[eosio::table]] ring_block_slot {
+    uint64_t slot; // block_num % max_blocks
+
+    block_id_type id;
+    uint32_t block_num;
+    block_id_type previous; // in the slot before, the slots only hold one linked chain
+
+    checksum256 action_mroot = checksum256{};
+
+    // Block header state, absent if the block id is only added as a part of merkle path
+    bool has_state = false;
+    uint32_t dpos_irreversible_blocknum = 0;
+    uint32_t bft_irreversible_blocknum = 0;
+    incremental_merkle blockroot_merkle;
+
+    bool has_action_mroot() const {
+        uint8_t zero[32] = {};
+        return !std::equal(std::cbegin(action_mroot.hash), std::cend(action_mroot.hash), std::cbegin(zero), std::cend(zero));
+    }
+
+    auto primary_key() const { return slot; }
+};
+
+typedef multi_index<N(ringblock), ring_block_slot> ring_block_table;
+
+struct [[eosio::table]] ring_head {
+    uint32_t head_block_num;
+    block_id_type head_block_id;
+    uint32_t last_irreversible_block_num;
+    block_id_type last_irreversible_block_id;
+};
+typedef singleton<N(ringhead), ring_head> ring_head_singleton;
+
+struct [[eosio::table]] store_mode {
+    // Key block headers by `block_num % max_blocks` and prune by overwriting slots,
+    // instead of keeping all fork branches with block id and previous id indices
+    bool ring_slots = false;
+};
+typedef singleton<N(storemode), store_mode> store_mode_singleton;
+
 typedef singleton<N(activesched), producer_schedule> producer_schedule_singleton;
 
 struct [[eosio::table]] pending_schedule {
@@ -107,6 +197,7 @@ public:
     void init_seed_block(const block_header_state& block_state);
     void reset();
     void set_max_blocks(uint32_t max);
+    void set_ring_mode(bool ring);
     void add_block_header_with_merkle_path(const block_header_state& h, const vector<block_id_type>& merkle_path);
     void add_block_header(const block_header& h);
     void cutdown(uint32_t block_num);
@@ -115,15 +206,27 @@ public:
 private:
     bool is_producer(account_name name, const ::public_key& key);
     producer_schedule get_producer_schedule();
-    incremental_merkle get_block_mroot(const block_id_type& block_id);
+    incremental_merkle get_block_mroot(const block_id_type& block_id, optional<uint64_t>* mroot_base = nullptr);
     void validate_block_state(const block_header_state& block_state);
-    void add_block_state(const block_header_state& block_state);
+    void add_block_state(const block_header_state& block_state, const optional<uint64_t>& mroot_base = optional<uint64_t>());
     void add_block_id(const block_id_type& block_id, const block_id_type& previous);
     void update_active_schedule(const producer_schedule &schedule, bool clear_pending = true);
     void set_pending_schedule(uint32_t lib_num, const digest_type& hash, const producer_schedule& schedule);
     void prune(const stored_block_header_state& block_state);
     void remove(const block_id_type& id);
 
+    incremental_merkle blockroot_merkle(const stored_block_header_state& b);
+    void compact_blockroot_merkle(stored_block_header_state& b, const optional<uint64_t>& mroot_base);
+    void take_merkle_base(uint64_t base);
+    void release_merkle_base(uint64_t base);
+
+    bool is_empty();
+    bool ring_contains(const block_id_type& id);
+    const ring_block_slot& ring_get(const block_id_type& id);
+    template <typename Lambda>
+    void ring_put(const block_id_type& id, const block_id_type& previous, Lambda&& updater);
+    void ring_add_block_state(const block_header_state& block_state);
+
     void meter_add_blocks(uint32_t num);
     void meter_remove_blocks(uint32_t num = std::numeric_limits<uint32_t>::max());
 
@@ -133,6 +236,12 @@ private:
     producer_schedule_singleton _active_schedule;
     pending_schedule_singleton _pending_schedule;
     store_meter_singleton _store_meter;
+    store_mode_singleton _store_mode;
+    ring_block_table _ring_blocks;
+    ring_head_singleton _ring_head;
+    merkle_base_table _merkle_bases;
+    merkle_base_refs_table _merkle_base_refs;
+    bool _ring = false;
 };
 
 }
@@ -18,6 +18,9 @@ icp::icp(account_name self)
 {
     peer_singleton peer(_self, _self);
     _peer = peer.get_or_default(peer_contract{});
+
+    window_singleton window(_self, _self);
+    _window = window.get_or_default(packet_window{});
 }
 
 void icp::setpeer(account_name peer) {
@@ -41,6 +44,23 @@ void icp::setmaxblocks(uint32_t maxblocks) {
     store->set_max_blocks(maxblocks);
 }
 
+void icp::setstoremode(bool ring) {
+    require_auth(_self);
+
+    store->set_ring_mode(ring);
+}
+
+void icp::setwindow(uint32_t window) {
+    require_auth(_self);
+
+    eosio_assert(window >= 1 && window <= max_packet_window, "invalid packet window");
+    // packets already received ahead must stay inside the window
+    eosio_assert(window >= 64 || (_window.received >> window) == 0, "packets received beyond the window");
+
+    _window.window = window;
+    update_window();
+}
+
 void icp::openchannel(const bytes &data) {
     require_auth(_self);
 
@@ -72,41 +92,101 @@ bytes icp::extract_action(const icp_action& ia) {
 
     auto action_mroot = store->get_action_mroot(ia.block_id);
 
-    auto mroot = merkle(ia.merkle_path); // TODO: merkle path computation optimization
-    eosio_assert(mroot == action_mroot, "invalid actions merkle root");
-
     auto receipt = unpack<action_receipt>(ia.action_receipt);
     auto receipt_digest = receipt.digest();
 
     auto action_digest = sha256(ia.action);
     eosio_assert(action_digest == receipt.act_digest, "invalid action digest");
 
-    bool exists = false;
-    for (const auto &d: ia.merkle_path) {
-        if (d == receipt_digest) {
-            exists = true;
-            break;
+    if (ia.compact) {
+        eosio_assert(ia.merkle_path.size() <= 64, "too long merkle branch");
+        for (size_t i = 0; i < ia.merkle_path.size(); ++i) {
+            bool is_right = (ia.index_bitmap >> i) & 1;
+            eosio_assert(is_right == is_canonical_left(ia.merkle_path[i]), "invalid merkle branch index");
         }
+        ::assert_merkle_branch(&receipt_digest, ia.merkle_path.data(), static_cast<uint32_t>(ia.merkle_path.size()), &action_mroot);
+    } else {
+        checksum256 mroot;
+        ::merkle_root(ia.merkle_path.data(), static_cast<uint32_t>(ia.merkle_path.size()), &mroot);
+        eosio_assert(mroot == action_mroot, "invalid actions merkle root");
+
+        bool exists = false;
+        for (const auto &d: ia.merkle_path) {
+            if (d == receipt_digest) {
+                exists = true;
+                break;
+            }
+        }
+        eosio_assert(exists, "invalid action receipt digest");
     }
-    eosio_assert(exists, "invalid action receipt digest");
 
     store->cutdown(block_header::num_from_id(ia.block_id));
 
-    auto a = unpack<action>(ia.action);
+    return peer_action_data(ia.action);
+}
+
+vector<bytes> icp::extract_actions(const icp_packets_action& pa) {
+    eosio_assert(_peer.peer, "empty peer icp contract");
+    eosio_assert(!pa.actions.empty(), "empty packets");
+    eosio_assert(pa.actions.size() == pa.action_receipts.size() && pa.actions.size() == pa.leaf_indices.size(), "malformed packets");
+
+    auto action_mroot = store->get_action_mroot(pa.block_id);
+
+    vector<std::pair<uint64_t, digest_type>> leaves;
+    leaves.reserve(pa.actions.size());
+    for (size_t i = 0; i < pa.actions.size(); ++i) {
+        auto receipt = unpack<action_receipt>(pa.action_receipts[i]);
+        eosio_assert(sha256(pa.actions[i]) == receipt.act_digest, "invalid action digest");
+        leaves.emplace_back(pa.leaf_indices[i], receipt.digest());
+    }
+    eosio_assert(merkle_multiproof_root(std::move(leaves), pa.leaf_count, pa.merkle_proof) == action_mroot, "invalid actions merkle proof");
+
+    store->cutdown(block_header::num_from_id(pa.block_id));
+
+    vector<bytes> data;
+    data.reserve(pa.actions.size());
+    for (const auto& a: pa.actions) {
+        data.push_back(peer_action_data(a));
+    }
+    return data;
+}
+
+bytes icp::peer_action_data(const bytes& packed_action) const {
+    auto a = unpack<action>(packed_action);
     eosio_assert(a.account == _peer.peer, "invalid peer icp contract");
     eosio_assert(a.name == N(null), "invalid peer icp contract action");
     return a.data;
 }
 
 void icp::onpacket(const icp_action& ia) {
-    auto action_data = extract_action(ia);
+    receive_packet(extract_action(ia));
+    update_peer(); // update `last_outgoing_receipt_seq`
+    update_window();
+}
+
+void icp::onpackets(const icp_packets_action& pa) {
+    // each packet is checked against the window as it is received
+    for (const auto& action_data: extract_actions(pa)) {
+        receive_packet(action_data);
+    }
+    update_peer(); // once for the whole run
+    update_window();
+}
 
+void icp::receive_packet(const bytes& action_data) {
     auto packet = unpack<icp_packet>(action_data);
-    eosio_assert(packet.seq == _peer.last_incoming_packet_seq + 1, "invalid packet sequence");
+    eosio_assert(packet.seq > _peer.last_incoming_packet_seq && packet.seq - _peer.last_incoming_packet_seq <= _window.window, "invalid packet sequence");
+
+    auto bit = uint64_t(1) << (packet.seq - _peer.last_incoming_packet_seq - 1);
+    eosio_assert(!(_window.received & bit), "packet already received");
+    _window.received |= bit;
+    while (_window.received & 1) {
+        _window.received >>= 1;
+        ++_peer.last_incoming_packet_seq;
+    }
 
-    ++_peer.last_incoming_packet_seq;
+    // receipts are numbered in the order packets are received, each naming its packet
     ++_peer.last_outgoing_receipt_seq;
-    update_peer(); // update `last_outgoing_receipt_seq`
 
     if (packet.expiration <= now()) {
         print_f("icp action has expired: % <= now %", uint64_t(packet.expiration), uint64_t(now));
@@ -275,6 +355,11 @@ void icp::update_peer() {
     peer.set(_peer, _self);
 }
 
+void icp::update_window() {
+    window_singleton window(_self, _self);
+    window.set(_window, _self);
+}
+
 void icp::meter_add_packets(uint32_t num) {
     if (num <= 0) return;
     meter_singleton icp_meter(_self, _self);
@@ -294,5 +379,5 @@ void icp::meter_remove_packets(uint32_t num) {
 
 }
 
-EOSIO_ABI(eosio::icp, (setpeer)(setmaxpackes)(setmaxblocks)(openchannel)(closechannel)
-                      (addblocks)(addblock)(onpacket)(onreceipt)(oncleanup)(cleanup)(sendaction)(genproof)(prune))
+EOSIO_ABI(eosio::icp, (setpeer)(setmaxpackes)(setmaxblocks)(setstoremode)(setwindow)(openchannel)(closechannel)
+                      (addblocks)(addblock)(onpacket)(onpackets)(onreceipt)(oncleanup)(cleanup)(sendaction)(genproof)(prune))
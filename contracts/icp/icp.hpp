@@ -20,6 +20,10 @@ struct icp : public contract {
     void setmaxpackes(uint32_t maxpackets); // limit the maximum stored packets, to support icp rate limiting
     [[eosio::action]]
     void setmaxblocks(uint32_t maxblocks);
+    [[eosio::action]]
+    void setstoremode(bool ring); // must be set before `openchannel`
+    [[eosio::action]]
+    void setwindow(uint32_t window); // packets accepted ahead of the next expected one, 1 for strict sequence
 
     [[eosio::action]]
     void openchannel(const bytes& data); // initialize with a block_header_state as trust seed
@@ -33,6 +37,8 @@ struct icp : public contract {
     [[eosio::action]]
     void onpacket(const icp_action& ia);
     [[eosio::action]]
+    void onpackets(const icp_packets_action& pa); // packets of one block with one proof, same as `onpacket` for each
+    [[eosio::action]]
     void onreceipt(const icp_action& ia);
     [[eosio::action]]
     void oncleanup(const icp_action& ia);
@@ -49,7 +55,11 @@ struct icp : public contract {
 
 private:
     bytes extract_action(const icp_action& ia);
+    vector<bytes> extract_actions(const icp_packets_action& pa);
+    bytes peer_action_data(const bytes& packed_action) const;
+    void receive_packet(const bytes& action_data);
     void update_peer();
+    void update_window();
 
     void meter_add_packets(uint32_t num);
     void meter_remove_packets(uint32_t num = std::numeric_limits<uint32_t>::max());
@@ -67,10 +77,24 @@ private:
         uint32_t current_packets;
     };
 
+    static constexpr uint32_t max_packet_window = 64;
+
+    /**
+     * The packets received out of order, ahead of `peer_contract::last_incoming_packet_seq`, so that one delayed
+     * packet does not block the later ones. Bit `i` of `received` stands for packet `last_incoming_packet_seq + 1 + i`;
+     * the incoming sequence advances over the packets received once the gap before them is filled.
+     */
+    struct [[eosio::table]] packet_window {
+        uint32_t window = 1;
+        uint64_t received = 0;
+    };
+
     typedef eosio::singleton<N(peer), peer_contract> peer_singleton;
     typedef eosio::singleton<N(icpmeter), icp_meter> meter_singleton;
+    typedef eosio::singleton<N(pktwindow), packet_window> window_singleton;
 
     peer_contract _peer;
+    packet_window _window;
     std::unique_ptr<fork_store> store;
 };
 
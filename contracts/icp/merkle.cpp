@@ -47,4 +47,36 @@ digest_type merkle(vector<digest_type> ids) {
     return ids.front();
 }
 
+digest_type merkle_multiproof_root(vector<std::pair<uint64_t, digest_type>> leaves, uint64_t count, const vector<digest_type>& proof) {
+    eosio_assert(!leaves.empty() && leaves.back().first < count, "invalid merkle proof leaves");
+    for (size_t k = 1; k < leaves.size(); ++k) {
+        eosio_assert(leaves[k - 1].first < leaves[k].first, "merkle proof leaves not ascending");
+    }
+
+    size_t p = 0;
+    while (count > 1) {
+        size_t n = 0;
+        for (size_t k = 0; k < leaves.size(); ++k) {
+            auto index = leaves[k].first;
+            auto sibling = index ^ 1;
+            digest_type parent;
+            if (k + 1 < leaves.size() && leaves[k + 1].first == sibling) {
+                parent = sha256(make_canonical_pair(leaves[k].second, leaves[k + 1].second));
+                ++k;
+            } else {
+                eosio_assert(sibling >= count || p < proof.size(), "too short merkle proof");
+                const auto& other = sibling < count ? proof[p++] : leaves[k].second; // an odd last node pairs with itself
+                parent = index & 1 ? sha256(make_canonical_pair(other, leaves[k].second))
+                                   : sha256(make_canonical_pair(leaves[k].second, other));
+            }
+            leaves[n++] = std::make_pair(index >> 1, parent);
+        }
+        leaves.resize(n);
+        count = (count + 1) / 2;
+    }
+
+    eosio_assert(p == proof.size(), "too long merkle proof");
+    return leaves.front().second;
+}
+
 }
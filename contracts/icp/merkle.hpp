@@ -21,6 +21,14 @@ inline auto make_canonical_pair(const digest_type& l, const digest_type& r) {
  */
 digest_type merkle( vector<digest_type> ids );
 
+/**
+ *  Calculates the merkle root of a tree of `count` digests from some of its leaves, as (index, digest) strictly
+ *  ascending by index, and the other nodes needed to get to the root. At each level, the nodes of the proof are
+ *  the siblings of the nodes known so far which are neither known themselves nor the duplicate of an odd last
+ *  node, in ascending order, and every node of the proof has to be consumed.
+ */
+digest_type merkle_multiproof_root( vector<std::pair<uint64_t, digest_type>> leaves, uint64_t count, const vector<digest_type>& proof );
+
 namespace detail {
 
 /**
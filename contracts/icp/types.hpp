@@ -158,15 +158,55 @@ struct action_receipt {
    EOSLIB_SERIALIZE(action_receipt, (receiver)(act_digest)(global_sequence)(recv_sequence)(auth_sequence)(code_sequence)(abi_sequence))
 };
 
+// Tags the fields which follow `merkle_path` in a compact `icp_action`
+const uint8_t icp_action_compact_format = 1;
+
 // @abi table icp_action i64
 struct icp_action {
    bytes action;
    bytes action_receipt;
    block_id_type block_id;
+   // Either all action digests of the block, or for a compact proof only the sibling branch of the action receipt digest
    vector<checksum256> merkle_path;
 
-   // explicit serialization macro is not necessary, used here only to improve compilation time
-   EOSLIB_SERIALIZE(icp_action, (action)(action_receipt)(block_id)(merkle_path))
+   // Only present in a compact proof, bit `i` is set if the node at level `i` of the branch is a right child
+   bool compact = false;
+   uint64_t index_bitmap = 0;
+
+   template<typename DataStream>
+   friend DataStream& operator<<(DataStream& ds, const icp_action& a) {
+      ds << a.action << a.action_receipt << a.block_id << a.merkle_path;
+      if (a.compact) ds << icp_action_compact_format << a.index_bitmap;
+      return ds;
+   }
+
+   template<typename DataStream>
+   friend DataStream& operator>>(DataStream& ds, icp_action& a) {
+      ds >> a.action >> a.action_receipt >> a.block_id >> a.merkle_path;
+      a.compact = ds.remaining() > 0; // the old format ends with `merkle_path`
+      if (a.compact) {
+         uint8_t format = 0;
+         ds >> format;
+         eosio_assert(format == icp_action_compact_format, "unknown icp action format");
+         ds >> a.index_bitmap;
+         eosio_assert(ds.remaining() == 0, "trailing data after icp action");
+      }
+      return ds;
+   }
+};
+
+// A run of packets of one block, proved against its `action_mroot` at once
+struct icp_packets_action {
+   vector<bytes> actions;
+   vector<bytes> action_receipts;
+   block_id_type block_id;
+   // Number of action receipts of the block, and the leaf indices of these ones, strictly ascending
+   uint64_t leaf_count = 0;
+   vector<uint64_t> leaf_indices;
+   // Sibling nodes which are not computable from the leaves, from the bottom up, see `merkle_multiproof_root`
+   vector<checksum256> merkle_proof;
+
+   EOSLIB_SERIALIZE(icp_packets_action, (actions)(action_receipts)(block_id)(leaf_count)(leaf_indices)(merkle_proof))
 };
 
 struct [[eosio::table]] icp_packet {
@@ -0,0 +1,36 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Fixed point arithmetic on 128 bit integers, the way price and share computations do it, to time the compiler
+ *  builtins that WASM contracts call for 128 bit multiplication, division and shifts.
+ */
+#include <eosiolib/eosio.hpp>
+#include <eosiolib/contract.hpp>
+
+class int128_bench : public eosio::contract {
+   public:
+      int128_bench(account_name self)
+      :eosio::contract(self)
+      {}
+
+      /// rounds of a 64.64 fixed point multiply and divide, with operands that fit in 64 bits and ones that do not
+      //@abi action
+      void mix(uint64_t rounds) {
+         unsigned __int128 price  = (unsigned __int128)3 << 64 | 0x9e3779b97f4a7c15ULL;
+         __int128          amount = 1000000;
+         uint64_t          check  = 0;
+         for (uint64_t r = 0; r < rounds; ++r) {
+            unsigned __int128 value = (price * uint64_t(amount)) >> 64;   // __multi3, __lshrti3
+            unsigned __int128 back  = (value << 64) / price;              // __ashlti3, __udivti3 on wide values
+            __int128 share = __int128(value) * 7 / (amount + 13);          // __divti3 on values of 64 bits
+            __int128 dust  = (__int128(back) - amount) % 1000;            // __modti3
+            check += uint64_t(share) ^ uint64_t(dust);
+            amount += 1 + (r & 0xff);
+            price  += amount;
+         }
+         eosio_assert(rounds == 0 || check != 0, "no result");
+      }
+};
+
+EOSIO_ABI( int128_bench, (mix) )
@@ -0,0 +1,73 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Loads many rows of one table in a single action, the way order book matching and voting do, to time the object
+ *  cache of multi_index. Every lookup after the first of a row is answered by the cache.
+ */
+#include <eosiolib/eosio.hpp>
+#include <eosiolib/contract.hpp>
+
+class multi_index_bench : public eosio::contract {
+   public:
+      multi_index_bench(account_name self)
+      :eosio::contract(self)
+      {}
+
+      /// stores orders 0 to count - 1, at prices that interleave them by primary key
+      //@abi action
+      void fill(account_name payer, uint64_t count) {
+         order_table orders(_self, _self);
+         for (uint64_t id = 0; id < count; ++id) {
+            orders.emplace(payer, [&](order& o) {
+               o.id = id;
+               o.price = (id * 7919) % count;
+               o.quantity = id + 1;
+            });
+         }
+      }
+
+      /// walks the orders by price and looks up the counterpart of each by primary key, rounds times over
+      //@abi action
+      void match(uint64_t rounds) {
+         order_table orders(_self, _self);
+         auto by_price = orders.get_index<N(byprice)>();
+         uint64_t matched = 0;
+         for (uint64_t r = 0; r < rounds; ++r) {
+            for (const auto& o : by_price) {
+               auto counterpart = orders.find(o.id ^ 1);
+               if (counterpart != orders.end() && counterpart->quantity <= o.quantity)
+                  ++matched;
+            }
+         }
+         eosio_assert(matched > 0 || orders.begin() == orders.end(), "no orders matched");
+      }
+
+      /// looks up orders 0 to count - 1 by primary key, rounds times over
+      //@abi action
+      void lookup(uint64_t count, uint64_t rounds) {
+         order_table orders(_self, _self);
+         for (uint64_t r = 0; r < rounds; ++r) {
+            for (uint64_t id = 0; id < count; ++id)
+               eosio_assert(orders.find(id) != orders.end(), "order not found");
+         }
+      }
+
+   private:
+      //@abi table orders i64
+      struct order {
+         uint64_t id;
+         uint64_t price;
+         uint64_t quantity;
+
+         uint64_t primary_key()const { return id; }
+         uint64_t by_price()const { return price; }
+
+         EOSLIB_SERIALIZE( order, (id)(price)(quantity) )
+      };
+      typedef eosio::multi_index< N(orders), order,
+         eosio::indexed_by< N(byprice), eosio::const_mem_fun<order, uint64_t, &order::by_price> >
+      > order_table;
+};
+
+EOSIO_ABI( multi_index_bench, (fill)(match)(lookup) )
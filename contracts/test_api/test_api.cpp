@@ -121,6 +121,9 @@ extern "C" {
       WASM_TEST_HANDLER(test_crypto, assert_sha512_true);
       WASM_TEST_HANDLER(test_crypto, assert_ripemd160_false);
       WASM_TEST_HANDLER(test_crypto, assert_ripemd160_true);
+      WASM_TEST_HANDLER(test_crypto, test_merkle_root);
+      WASM_TEST_HANDLER(test_crypto, assert_merkle_branch_true);
+      WASM_TEST_HANDLER(test_crypto, assert_merkle_branch_false);
 
       //test transaction
       WASM_TEST_HANDLER(test_transaction, test_tapos_block_num);
@@ -176,6 +179,8 @@ extern "C" {
 
       // test datastream
       WASM_TEST_HANDLER(test_datastream, test_basic);
+      WASM_TEST_HANDLER(test_datastream, test_views);
+      WASM_TEST_HANDLER(test_datastream, test_packed);
 
       // test permission
       WASM_TEST_HANDLER_EX(test_permission, check_authorization);
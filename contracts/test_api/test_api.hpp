@@ -80,6 +80,7 @@ struct test_db {
    static void primary_i64_general(uint64_t receiver, uint64_t code, uint64_t action);
    static void primary_i64_lowerbound(uint64_t receiver, uint64_t code, uint64_t action);
    static void primary_i64_upperbound(uint64_t receiver, uint64_t code, uint64_t action);
+   static void primary_i64_next_many(uint64_t receiver, uint64_t code, uint64_t action);
 
    static void idx64_general(uint64_t receiver, uint64_t code, uint64_t action);
    static void idx64_lowerbound(uint64_t receiver, uint64_t code, uint64_t action);
@@ -127,6 +128,8 @@ struct test_multi_index {
    static void idx64_run_out_of_avl_pk(uint64_t receiver, uint64_t code, uint64_t action);
    static void idx64_sk_cache_pk_lookup(uint64_t receiver, uint64_t code, uint64_t action);
    static void idx64_pk_cache_sk_lookup(uint64_t receiver, uint64_t code, uint64_t action);
+   static void idx64_cache_many_rows(uint64_t receiver, uint64_t code, uint64_t action);
+   static void idx64_read_packed(uint64_t receiver, uint64_t code, uint64_t action);
 };
 
 struct test_crypto {
@@ -150,6 +153,9 @@ struct test_crypto {
    static void assert_sha1_true();
    static void assert_sha512_true();
    static void assert_ripemd160_true();
+   static void test_merkle_root();
+   static void assert_merkle_branch_true();
+   static void assert_merkle_branch_false();
 };
 
 struct test_transaction {
@@ -276,4 +282,6 @@ struct test_permission {
 
 struct test_datastream {
   static void test_basic();
+  static void test_views();
+  static void test_packed();
 };
@@ -136,6 +136,18 @@ void test_compiler_builtins::test_divti3() {
 
    __divti3( res, uint64_t(lhs_a), uint64_t( lhs_a >> 64 ), 1, 0 );
    eosio_assert( res == -30, "__divti3 result should be -30" ); 
+
+   /*
+    * test values on both sides of 64 bits
+    */
+   __int128 min64 = -9223372036854775807LL - 1;
+   __int128 minus_one = -1;
+   __divti3( res, uint64_t(min64), uint64_t( min64 >> 64 ), uint64_t(minus_one), uint64_t( minus_one >> 64 ) );
+   eosio_assert( res == 9223372036854775808_LLL, "__divti3 result should be 9223372036854775808" );
+
+   __int128 wide = 100000000000000000000_LLL;
+   __divti3( res, uint64_t(wide), uint64_t( wide >> 64 ), uint64_t(rhs_b), uint64_t( rhs_b >> 64 ) );
+   eosio_assert( res == -3333333333333333333_LLL, "__divti3 result should be -3333333333333333333" );
 }
 
 void test_compiler_builtins::test_divti3_by_0() {
@@ -348,6 +360,15 @@ void test_compiler_builtins::test_modti3() {
 
    __modti3( res, 0, 0, uint64_t(rhs_a), uint64_t(rhs_a >> 64) );
    eosio_assert( res ==  0, "__modti3 result should be 0" );
+
+   __int128 min64 = -9223372036854775807LL - 1;
+   __int128 minus_one = -1;
+   __modti3( res, uint64_t(min64), uint64_t(min64 >> 64), uint64_t(minus_one), uint64_t(minus_one >> 64) );
+   eosio_assert( res ==  0, "__modti3 result should be 0" );
+
+   __int128 wide = -100000000000000000000_LLL;
+   __modti3( res, uint64_t(wide), uint64_t(wide >> 64), 7, 0 );
+   eosio_assert( res ==  -2, "__modti3 result should be -2" );
 }
 
 void test_compiler_builtins::test_modti3_by_0() {
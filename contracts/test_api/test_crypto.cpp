@@ -434,3 +434,76 @@ void test_crypto::assert_ripemd160_true() {
   ripemd160( (char *)test5, my_strlen(test5), &tmp );
   assert_ripemd160( (char *)test5, my_strlen(test5), &tmp);
 }
+
+static checksum256 hash_canonical_pair( checksum256 l, checksum256 r ) {
+  char buf[2 * sizeof(checksum256)];
+  l.hash[0] &= 0x7f; // canonical left
+  r.hash[0] |= 0x80; // canonical right
+  memcpy( buf, &l, sizeof(checksum256) );
+  memcpy( buf + sizeof(checksum256), &r, sizeof(checksum256) );
+
+  checksum256 res;
+  sha256( buf, sizeof(buf), &res );
+  return res;
+}
+
+static void calc_merkle_leaves( checksum256* leaves ) {
+  sha256( (char *)test1, my_strlen(test1), &leaves[0] );
+  sha256( (char *)test3, my_strlen(test3), &leaves[1] );
+  sha256( (char *)test4, my_strlen(test4), &leaves[2] );
+}
+
+void test_crypto::test_merkle_root() {
+
+  checksum256 leaves[3];
+  calc_merkle_leaves( leaves );
+
+  // the odd leaf is paired with itself
+  auto expected = hash_canonical_pair( hash_canonical_pair( leaves[0], leaves[1] ), hash_canonical_pair( leaves[2], leaves[2] ) );
+
+  checksum256 root;
+  merkle_root( leaves, 3, &root );
+  eosio_assert( my_memcmp((void *)&expected, &root, sizeof(checksum256)), "merkle root of 3 leaves" );
+
+  merkle_root( leaves, 1, &root );
+  eosio_assert( my_memcmp((void *)&leaves[0], &root, sizeof(checksum256)), "merkle root of 1 leaf" );
+}
+
+void test_crypto::assert_merkle_branch_true() {
+
+  checksum256 leaves[3];
+  calc_merkle_leaves( leaves );
+
+  checksum256 root;
+  merkle_root( leaves, 3, &root );
+
+  // branch of the second leaf: the first leaf on the left, then the node of the third leaf on the right
+  checksum256 branch[2] = { leaves[0], hash_canonical_pair( leaves[2], leaves[2] ) };
+  branch[0].hash[0] &= 0x7f;
+  branch[1].hash[0] |= 0x80;
+  assert_merkle_branch( &leaves[1], branch, 2, &root );
+
+  // branch of the third leaf: itself on the right, then the node of the first two leaves on the left
+  branch[0] = leaves[2];
+  branch[0].hash[0] |= 0x80;
+  branch[1] = hash_canonical_pair( leaves[0], leaves[1] );
+  branch[1].hash[0] &= 0x7f;
+  assert_merkle_branch( &leaves[2], branch, 2, &root );
+}
+
+void test_crypto::assert_merkle_branch_false() {
+
+  checksum256 leaves[3];
+  calc_merkle_leaves( leaves );
+
+  checksum256 root;
+  merkle_root( leaves, 3, &root );
+
+  // the first leaf marked as the right sibling
+  checksum256 branch[2] = { leaves[0], hash_canonical_pair( leaves[2], leaves[2] ) };
+  branch[0].hash[0] |= 0x80;
+  branch[1].hash[0] |= 0x80;
+  assert_merkle_branch( &leaves[1], branch, 2, &root );
+
+  eosio_assert(false, "should have failed");
+}
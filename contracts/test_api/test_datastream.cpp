@@ -1,6 +1,8 @@
 
 #include <eosiolib/eosio.hpp>
 #include <eosiolib/datastream.hpp>
+#include <eosiolib/view.hpp>
+#include <eosiolib/asset.hpp>
 #include <cmath>
 
 #include "test_api.hpp"
@@ -44,6 +46,74 @@ struct testtype<float> {
    }
 };
 
+namespace {
+    /// listed out of order, so serialized field by field
+    struct swapped {
+        uint64_t a;
+        uint64_t b;
+        EOSLIB_SERIALIZE(swapped, (b)(a))
+    };
+
+    /// in order, but holding a struct which is not packed
+    struct holds_swapped {
+        swapped s;
+        uint64_t c;
+        EOSLIB_SERIALIZE(holds_swapped, (s)(c))
+    };
+
+    /// padded after a, so serialized field by field
+    struct padded {
+        uint32_t a;
+        uint64_t b;
+        EOSLIB_SERIALIZE(padded, (a)(b))
+    };
+
+    struct hashed {
+        uint64_t id;
+        uint64_t id2;
+        checksum256 hash;
+        std::array<uint32_t, 3> parts;
+        uint32_t tail;
+        EOSLIB_SERIALIZE(hashed, (id)(id2)(hash)(parts)(tail))
+    };
+
+    template<typename T>
+    void require_packed_bytes(const T& v, std::initializer_list<std::vector<char>> fields, const char* errmsg) {
+        std::vector<char> expected;
+        for (const auto& f : fields)
+            expected.insert(expected.end(), f.begin(), f.end());
+        eosio_assert(eosio::pack(v) == expected, errmsg);
+        eosio_assert(eosio::pack_size(v) == expected.size(), errmsg);
+        eosio_assert(eosio::pack(eosio::unpack<T>(expected)) == expected, errmsg);
+    }
+}
+
+void test_datastream::test_packed()
+{
+    using eosio::_serialize_detail::is_packed;
+    static_assert(is_packed<eosio::symbol_type>() && is_packed<eosio::asset>() && is_packed<eosio::extended_asset>(),
+                  "assets are copied whole");
+    static_assert(is_packed<hashed>(), "members in order without padding");
+    static_assert(!is_packed<swapped>() && !is_packed<holds_swapped>(), "members out of order are serialized as listed");
+    static_assert(is_packed<eosio::permission_level>(), "names are copied whole");
+    static_assert(!is_packed<padded>(), "padding is not serialized");
+
+    eosio::extended_asset ea(eosio::asset(-42, S(4,SYS)), N(eosio.token));
+    require_packed_bytes(ea, {eosio::pack(ea.amount), eosio::pack(ea.symbol.value), eosio::pack(ea.contract)},
+                         "extended_asset");
+
+    require_packed_bytes(swapped{1, 2}, {eosio::pack(uint64_t(2)), eosio::pack(uint64_t(1))}, "swapped");
+    require_packed_bytes(holds_swapped{{1, 2}, 3}, {eosio::pack(uint64_t(2)), eosio::pack(uint64_t(1)), eosio::pack(uint64_t(3))},
+                         "holds_swapped");
+    require_packed_bytes(padded{1, 2}, {eosio::pack(uint32_t(1)), eosio::pack(uint64_t(2))}, "padded");
+
+    hashed h{7, 8, {}, {{1, 2, 3}}, 9};
+    for (int i = 0; i < 32; ++i)
+        h.hash.hash[i] = i;
+    require_packed_bytes(h, {eosio::pack(h.id), eosio::pack(h.id2), eosio::pack(h.hash), eosio::pack(h.parts),
+                             eosio::pack(h.tail)}, "hashed");
+}
+
 void test_datastream::test_basic()
 {
 
@@ -85,3 +155,40 @@ void test_datastream::test_basic()
     testtype<std::tuple<int, std::string, double> >::run({1, "abc", 3.3333}, "tuple");
 }
 
+void test_datastream::test_views()
+{
+    struct Row {
+        uint64_t id;
+        std::string name;
+        std::vector<char> blob;
+        uint32_t tail;
+    };
+    Row row{42, "hello", {1, 2, 3}, 7};
+    auto packed = eosio::pack(row);
+
+    auto v = eosio::unpack<eosio::struct_view<uint64_t, eosio::string_view, eosio::bytes_view, uint32_t>>(packed);
+    eosio_assert(v.get<0>() == 42, "struct_view first field");
+    eosio_assert(v.get<1>() == "hello", "string_view field");
+    eosio_assert(v.get<1>().data() == packed.data() + sizeof(uint64_t) + 1, "string_view points into the buffer");
+    eosio_assert(v.get<2>().to_bytes() == row.blob, "bytes_view field");
+    eosio_assert(v.get<3>() == 7, "field after views");
+
+    // only the leading fields have to be listed, and owning types still work in a view
+    auto name = eosio::unpack<eosio::struct_view<uint64_t, std::string>>(packed).get<1>();
+    eosio_assert(name == "hello", "struct_view of leading fields");
+
+    // views pack the same as the owning types they stand for
+    eosio_assert(eosio::pack(v.get<1>()) == eosio::pack(row.name), "string_view packs as std::string");
+    eosio_assert(eosio::pack(v.get<2>()) == eosio::pack(row.blob), "bytes_view packs as bytes");
+
+    // fields are only decoded when asked for, so a leading field reads fine from a prefix of the row
+    eosio::packed_buffer buffer;
+    memcpy(buffer.resize(sizeof(uint64_t) + 1), packed.data(), sizeof(uint64_t) + 1);
+    eosio_assert(buffer.unpack<eosio::struct_view<uint64_t, eosio::string_view>>().get<0>() == 42, "packed_buffer unpack");
+
+    std::vector<char> large(2 * eosio::packed_buffer::inline_size, 'x');
+    auto packed_large = eosio::pack(large);
+    memcpy(buffer.resize(packed_large.size()), packed_large.data(), packed_large.size());
+    auto moved = std::move(buffer);
+    eosio_assert(moved.unpack<eosio::bytes_view>().size() == large.size(), "packed_buffer beyond inline_size");
+}
@@ -242,6 +242,46 @@ void test_db::primary_i64_upperbound(uint64_t receiver, uint64_t code, uint64_t
    }
 }
 
+void test_db::primary_i64_next_many(uint64_t receiver, uint64_t code, uint64_t action)
+{
+   (void)code;(void)action;
+   auto table = N(mytable);
+   const std::string err = "primary_i64_next_many";
+   const size_t header_size = sizeof(int32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+
+   int alice_itr = db_find_i64(receiver, receiver, table, N(alice));
+   char rows[256];
+   int32_t next = -1;
+   {
+      int32_t count = db_next_many_i64(alice_itr, rows, sizeof(rows), 2, &next);
+      eosio_assert(count == 2, err.c_str());
+      eosio_assert(next == db_find_i64(receiver, receiver, table, N(charlie)), err.c_str());
+
+      int32_t itr; uint64_t pk; uint32_t size;
+      memcpy(&itr, rows, sizeof(itr));
+      memcpy(&pk, rows + sizeof(itr), sizeof(pk));
+      memcpy(&size, rows + sizeof(itr) + sizeof(pk), sizeof(size));
+      eosio_assert(itr == db_find_i64(receiver, receiver, table, N(allyson)) && pk == N(allyson), err.c_str());
+      eosio_assert(size == strlen("allyson's info") && my_memcmp(rows + header_size, (void*)"allyson's info", size), err.c_str());
+
+      const char* second = rows + header_size + size;
+      memcpy(&pk, second + sizeof(itr), sizeof(pk));
+      eosio_assert(pk == N(bob), err.c_str());
+   }
+   {
+      // reading stops at the end of the table
+      int32_t count = db_next_many_i64(alice_itr, rows, sizeof(rows), 100, &next);
+      eosio_assert(count == 5, err.c_str());
+      eosio_assert(next == db_end_i64(receiver, receiver, table), err.c_str());
+   }
+   {
+      // and before a row that does not fit in the buffer
+      int32_t count = db_next_many_i64(alice_itr, rows, header_size + 1, 100, &next);
+      eosio_assert(count == 0, err.c_str());
+      eosio_assert(next == db_find_i64(receiver, receiver, table, N(allyson)), err.c_str());
+   }
+}
+
 void test_db::idx64_general(uint64_t receiver, uint64_t code, uint64_t action)
 {
    (void)code;(void)action;
@@ -43,6 +43,8 @@ extern "C" {
       WASM_TEST_HANDLER_EX(test_multi_index, idx64_run_out_of_avl_pk);
       WASM_TEST_HANDLER_EX(test_multi_index, idx64_sk_cache_pk_lookup);
       WASM_TEST_HANDLER_EX(test_multi_index, idx64_pk_cache_sk_lookup);
+      WASM_TEST_HANDLER_EX(test_multi_index, idx64_cache_many_rows);
+      WASM_TEST_HANDLER_EX(test_multi_index, idx64_read_packed);
 
       //unhandled test call
       eosio_assert(false, "Unknown Test");
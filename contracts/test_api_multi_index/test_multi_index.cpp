@@ -950,4 +950,64 @@ void test_multi_index::idx64_pk_cache_sk_lookup(uint64_t receiver, uint64_t code
    eosio_assert(next_itr->id == 781 && next_itr->sec == N(bob), "idx64_pk_cache_sk_lookup - next record");
 }
 
+void test_multi_index::idx64_cache_many_rows(uint64_t receiver, uint64_t code, uint64_t action)
+{
+   // enough rows for the object cache to grow several times, with keys far apart and close together
+   const uint64_t rows = 300;
+   auto key = [](uint64_t i) { return (i % 2) ? i : (i << 40); };
+   auto payer = receiver;
+   {
+      auto table = _test_multi_index::idx64_table<N(indextable9), N(bysecondary)>(receiver);
+      for( uint64_t i = 0; i < rows; ++i ) {
+         table.emplace( payer, [&]( auto& r ) {
+            r.id = key(i);
+            r.sec = i;
+         });
+      }
+      for( uint64_t i = 0; i < rows; ++i ) {
+         auto itr = table.find(key(i));
+         eosio_assert(itr != table.end() && itr->sec == i, "idx64_cache_many_rows - find of emplaced row");
+      }
+      // erasing moves other rows within the cache
+      for( uint64_t i = 0; i < rows; i += 3 )
+         table.erase(table.get(key(i)));
+      for( uint64_t i = 0; i < rows; ++i ) {
+         auto itr = table.find(key(i));
+         eosio_assert((itr == table.end()) == (i % 3 == 0), "idx64_cache_many_rows - find after erase");
+         eosio_assert(itr == table.end() || (itr->id == key(i) && itr->sec == i), "idx64_cache_many_rows - row after erase");
+      }
+   }
+
+   // a fresh table loads the rows while iterating, by primary iterator, and finds them again by primary key
+   auto table = _test_multi_index::idx64_table<N(indextable9), N(bysecondary)>(receiver);
+   uint64_t count = 0;
+   for( const auto& r : table ) {
+      ++count;
+      eosio_assert(&*table.find(r.id) == &r, "idx64_cache_many_rows - find of an iterated row returns the cached row");
+   }
+   eosio_assert(count == rows - (rows + 2) / 3, "idx64_cache_many_rows - rows left");
+
+   auto sec_index = table.get_index<N(bysecondary)>();
+   auto sk_itr = sec_index.find(1);
+   eosio_assert(sk_itr != sec_index.end() && &*table.find(key(1)) == &*sk_itr, "idx64_cache_many_rows - secondary lookup shares the cache");
+}
+
+void test_multi_index::idx64_read_packed(uint64_t receiver, uint64_t code, uint64_t action)
+{
+   // rows stored by idx64_store_only
+   auto table = _test_multi_index::idx64_table<N(indextable1), N(bysecondary)>(receiver);
+
+   eosio::packed_buffer buffer;
+   eosio_assert(table.read_packed(265, buffer), "idx64_read_packed - read_packed of existing primary key");
+   auto row = buffer.unpack<eosio::struct_view<uint64_t, uint64_t>>();
+   eosio_assert(row.get<0>() == 265 && row.get<1>() == N(alice), "idx64_read_packed - fields of the row");
+   eosio_assert(!table.read_packed(266, buffer), "idx64_read_packed - read_packed of missing primary key");
+
+   // the row read is the one multi_index deserializes
+   auto itr = table.find(265);
+   eosio_assert(itr != table.end(), "idx64_read_packed - table.find() of existing primary key");
+   auto expected = eosio::pack(*itr);
+   eosio_assert(row.packed() == eosio::bytes_view(expected.data(), expected.size()), "idx64_read_packed - serialized row");
+}
+
 #pragma GCC diagnostic pop
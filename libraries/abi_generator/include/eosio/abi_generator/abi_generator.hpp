@@ -11,6 +11,7 @@
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/contract_types.hpp>
 #include <fc/io/json.hpp>
+#include <fc/crypto/sha256.hpp>
 
 //clashes with something deep in the AST includes in clang 6 and possibly other versions of clang
 #pragma push_macro("N")
@@ -324,15 +325,22 @@ namespace eosio {
       }
    };
 
+   /**
+    *  Finds the contract and actions of the EOSIO_ABI macro. Given an encoder, it also hashes the preprocessed
+    *  tokens of the translation unit, comments included since the @abi annotations are in them, which is all the
+    *  ABI generated from it depends on besides the ricardian files.
+    */
    struct find_eosio_abi_macro_action : public PreprocessOnlyAction {
 
          string& contract;
          vector<string>& actions;
          const string& abi_context;
+         fc::sha256::encoder* source_hash = nullptr;
 
-         find_eosio_abi_macro_action(string& contract, vector<string>& actions, const string& abi_context
+         find_eosio_abi_macro_action(string& contract, vector<string>& actions, const string& abi_context,
+                                     fc::sha256::encoder* source_hash = nullptr
             ): contract(contract),
-            actions(actions), abi_context(abi_context) {
+            actions(actions), abi_context(abi_context), source_hash(source_hash) {
          }
 
          struct callback_handler : public PPCallbacks {
@@ -398,10 +406,24 @@ namespace eosio {
          };
 
          void ExecuteAction() override {
-            getCompilerInstance().getPreprocessor().addPPCallbacks(
+            auto& pp = getCompilerInstance().getPreprocessor();
+            pp.addPPCallbacks(
                llvm::make_unique<callback_handler>(getCompilerInstance(), *this)
             );
-            PreprocessOnlyAction::ExecuteAction();
+            if( !source_hash ) {
+               PreprocessOnlyAction::ExecuteAction();
+               return;
+            }
+
+            pp.SetCommentRetentionState(true, true);
+            pp.EnterMainSourceFile();
+            Token tok;
+            do {
+               pp.Lex(tok);
+               const auto spelling = pp.getSpelling(tok);
+               source_hash->write(spelling.data(), spelling.size());
+               source_hash->put(' ');
+            } while( tok.isNot(tok::eof) );
          };
 
    };
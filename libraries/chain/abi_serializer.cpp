@@ -10,6 +10,7 @@
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/io/json.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
 
@@ -55,9 +56,37 @@ namespace eosio { namespace chain {
       set_abi(abi, max_serialization_time);
    }
 
+   abi_serializer::abi_serializer( const abi_serializer& other )
+   :typedefs(other.typedefs)
+   ,structs(other.structs)
+   ,actions(other.actions)
+   ,tables(other.tables)
+   ,error_messages(other.error_messages)
+   ,variants(other.variants)
+   ,built_in_types(other.built_in_types)
+   {
+      build_type_plans();
+   }
+
+   abi_serializer& abi_serializer::operator=( const abi_serializer& other ) {
+      if( this != &other ) {
+         typedefs       = other.typedefs;
+         structs        = other.structs;
+         actions        = other.actions;
+         tables         = other.tables;
+         error_messages = other.error_messages;
+         variants       = other.variants;
+         built_in_types = other.built_in_types;
+         build_type_plans();
+      }
+      return *this;
+   }
+
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      if( !plans.empty() )
+         build_type_plans();
    }
 
    void abi_serializer::configure_built_in_types() {
@@ -148,6 +177,98 @@ namespace eosio { namespace chain {
       EOS_ASSERT( variants.size() == abi.variants.value.size(), duplicate_abi_variant_def_exception, "duplicate variant definition detected" );
 
       validate(ctx);
+      build_type_plans();
+   }
+
+   uint32_t abi_serializer::add_type_plan( const type_name& type, vector<uint32_t>& pending ) {
+      auto itr = plan_ids.find(type);
+      if( itr != plan_ids.end() )
+         return itr->second;
+
+      uint32_t id = plans.size();
+      plan_ids.emplace( type, id );
+      plans.emplace_back();
+      plans.back().name = type;
+      pending.push_back( id );
+      return id;
+   }
+
+   void abi_serializer::build_type_plans() {
+      plans.clear();
+      plan_ids.clear();
+
+      vector<uint32_t> pending;
+      for( const auto& t : typedefs )
+         add_type_plan( t.first, pending );
+      for( const auto& s : structs )
+         add_type_plan( s.first, pending );
+      for( const auto& v : variants )
+         add_type_plan( v.first, pending );
+      for( const auto& a : actions )
+         add_type_plan( a.second, pending );
+      for( const auto& t : tables )
+         add_type_plan( t.second, pending );
+
+      // worked off iteratively rather than recursively so that a deeply nested ABI cannot exhaust the stack;
+      // the checks mirror the order in which _binary_to_variant and _variant_to_binary try them
+      while( !pending.empty() ) {
+         auto id = pending.back();
+         pending.pop_back();
+
+         type_plan plan;
+         plan.name = plans[id].name;
+         plan.resolved = resolve_type( plan.name );
+         auto ftype = fundamental_type( plan.resolved );
+
+         auto btype = built_in_types.find( ftype );
+         if( btype != built_in_types.end() ) {
+            plan.kind          = type_plan::built_in;
+            plan.built_in_type = &btype->second;
+            plan.is_array      = is_array( plan.resolved );
+            plan.is_optional   = is_optional( plan.resolved );
+         } else if( is_array( plan.resolved ) ) {
+            plan.kind    = type_plan::array;
+            plan.element = add_type_plan( ftype, pending );
+         } else if( is_optional( plan.resolved ) ) {
+            plan.kind    = type_plan::optional;
+            plan.element = add_type_plan( ftype, pending );
+         } else if( (plan.variant_itr = variants.find( plan.resolved )) != variants.end() ) {
+            plan.kind = type_plan::variant;
+            for( const auto& t : plan.variant_itr->second.types ) {
+               plan.members.push_back( add_type_plan( t, pending ) );
+               plan.json_names.push_back( fc::json::to_string( fc::variant(t) ) );
+            }
+         } else if( (plan.struct_itr = structs.find( plan.resolved )) != structs.end() ) {
+            plan.kind = type_plan::structure;
+            const auto& st = plan.struct_itr->second;
+            if( st.base != type_name() ) {
+               plan.has_base = true;
+               plan.base     = add_type_plan( resolve_type( st.base ), pending );
+            }
+            for( const auto& field : st.fields ) {
+               plan.members.push_back( add_type_plan( _remove_bin_extension( field.type ), pending ) );
+               plan.extensions.push_back( ends_with( field.type, "$" ) );
+               plan.json_names.push_back( fc::json::to_string( fc::variant(field.name) ) + ":" );
+            }
+         }
+
+         plans[id] = std::move( plan );
+      }
+
+      // a field that repeats a name of a base replaces it in the variant object, which streamed JSON cannot do
+      for( auto& plan : plans ) {
+         if( plan.kind != type_plan::structure )
+            continue;
+         set<field_name> names;
+         const type_plan* p = &plan;
+         for( size_t depth = 0; plan.unique_fields && depth < plans.size(); ++depth ) {
+            for( const auto& field : p->struct_itr->second.fields )
+               plan.unique_fields &= names.insert( field.name ).second;
+            if( !p->has_base || plans[p->base].kind != type_plan::structure )
+               break;
+            p = &plans[p->base];
+         }
+      }
    }
 
    bool abi_serializer::is_builtin_type(const type_name& type)const {
@@ -315,6 +436,10 @@ namespace eosio { namespace chain {
    fc::variant abi_serializer::_binary_to_variant( const type_name& type, fc::datastream<const char *>& stream,
                                                    impl::binary_to_variant_context& ctx )const
    {
+      auto plan = plan_ids.find(type);
+      if( plan != plan_ids.end() )
+         return _binary_to_variant( plans[plan->second], stream, ctx );
+
       auto h = ctx.enter_scope();
       type_name rtype = resolve_type(type);
       auto ftype = fundamental_type(rtype);
@@ -377,6 +502,94 @@ namespace eosio { namespace chain {
       return fc::variant( std::move(mvo) );
    }
 
+   void abi_serializer::_binary_to_variant( const type_plan& plan, fc::datastream<const char *>& stream,
+                                            fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      EOS_ASSERT( plan.kind == type_plan::structure, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(plan.resolved)) );
+      ctx.hint_struct_type_if_in_array( plan.struct_itr );
+      const auto& st = plan.struct_itr->second;
+      if( plan.has_base ) {
+         _binary_to_variant(plans[plan.base], stream, obj, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         bool extension = plan.extensions[i];
+         encountered_extension |= extension;
+         if( !stream.remaining() ) {
+            if( extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = plan.struct_itr, .field_ordinal = i } );
+         obj( field.name, _binary_to_variant(plans[plan.members[i]], stream, ctx) );
+      }
+   }
+
+   fc::variant abi_serializer::_binary_to_variant( const type_plan& plan, fc::datastream<const char *>& stream,
+                                                   impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      if( plan.kind == type_plan::built_in ) {
+         try {
+            return plan.built_in_type->first(stream, plan.is_array, plan.is_optional);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                   ("class", plan.is_array ? "array of built-in" : plan.is_optional ? "optional of built-in" : "built-in")
+                                   ("type", fundamental_type(plan.resolved))("p", ctx.get_path_string()) )
+      }
+      if( plan.kind == type_plan::array ) {
+         ctx.hint_array_type_if_in_array();
+         fc::unsigned_int size;
+         try {
+            fc::raw::unpack(stream, size);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+         const auto& element = plans[plan.element];
+         vector<fc::variant> vars;
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            ctx.set_array_index_of_path_back(i);
+            auto v = _binary_to_variant(element, stream, ctx);
+            EOS_ASSERT( !v.is_null(), unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+            vars.emplace_back(std::move(v));
+         }
+         EOS_ASSERT( vars.size() == size.value,
+                     unpack_exception,
+                     "packed size does not match unpacked array size, packed size ${p} actual size ${a}",
+                     ("p", size)("a", vars.size()) );
+         return fc::variant( std::move(vars) );
+      } else if( plan.kind == type_plan::optional ) {
+         char flag;
+         try {
+            fc::raw::unpack(stream, flag);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+         return flag ? _binary_to_variant(plans[plan.element], stream, ctx) : fc::variant();
+      } else if( plan.kind == type_plan::variant ) {
+         const auto& v_itr = plan.variant_itr;
+         ctx.hint_variant_type_if_in_array( v_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         return vector<fc::variant>{v_itr->second.types[select], _binary_to_variant(plans[plan.members[select]], stream, ctx)};
+      }
+
+      fc::mutable_variant_object mvo;
+      _binary_to_variant(plan, stream, mvo, ctx);
+      EOS_ASSERT( mvo.size() > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      return fc::variant( std::move(mvo) );
+   }
+
    fc::variant abi_serializer::_binary_to_variant( const type_name& type, const bytes& binary, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
@@ -396,8 +609,148 @@ namespace eosio { namespace chain {
       return _binary_to_variant(type, binary, ctx);
    }
 
+   size_t abi_serializer::_binary_to_json_fields( const type_plan& plan, fc::datastream<const char *>& stream,
+                                                  string& out, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      EOS_ASSERT( plan.kind == type_plan::structure, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(plan.resolved)) );
+      ctx.hint_struct_type_if_in_array( plan.struct_itr );
+      const auto& st = plan.struct_itr->second;
+      size_t written = 0;
+      if( plan.has_base ) {
+         written += _binary_to_json_fields(plans[plan.base], stream, out, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         bool extension = plan.extensions[i];
+         encountered_extension |= extension;
+         if( !stream.remaining() ) {
+            if( extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = plan.struct_itr, .field_ordinal = i } );
+         if( written++ )
+            out += ',';
+         out += plan.json_names[i];
+         _binary_to_json(plans[plan.members[i]], stream, out, ctx);
+      }
+      return written;
+   }
+
+   bool abi_serializer::_binary_to_json( const type_plan& plan, fc::datastream<const char *>& stream,
+                                         string& out, impl::binary_to_variant_context& ctx )const
+   {
+      if( plan.kind == type_plan::structure && !plan.unique_fields ) {
+         out += fc::json::to_string( _binary_to_variant(plan, stream, ctx) );
+         return false;
+      }
+
+      auto h = ctx.enter_scope();
+      if( plan.kind == type_plan::built_in ) {
+         try {
+            auto v = plan.built_in_type->first(stream, plan.is_array, plan.is_optional);
+            out += fc::json::to_string( v );
+            return v.is_null();
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                   ("class", plan.is_array ? "array of built-in" : plan.is_optional ? "optional of built-in" : "built-in")
+                                   ("type", fundamental_type(plan.resolved))("p", ctx.get_path_string()) )
+      }
+      if( plan.kind == type_plan::array ) {
+         ctx.hint_array_type_if_in_array();
+         fc::unsigned_int size;
+         try {
+            fc::raw::unpack(stream, size);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+         const auto& element = plans[plan.element];
+         out += '[';
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            ctx.set_array_index_of_path_back(i);
+            if( i )
+               out += ',';
+            bool is_null = _binary_to_json(element, stream, out, ctx);
+            EOS_ASSERT( !is_null, unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+         }
+         out += ']';
+         return false;
+      } else if( plan.kind == type_plan::optional ) {
+         char flag;
+         try {
+            fc::raw::unpack(stream, flag);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+         if( !flag ) {
+            out += "null";
+            return true;
+         }
+         return _binary_to_json(plans[plan.element], stream, out, ctx);
+      } else if( plan.kind == type_plan::variant ) {
+         const auto& v_itr = plan.variant_itr;
+         ctx.hint_variant_type_if_in_array( v_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         out += '[';
+         out += plan.json_names[select];
+         out += ',';
+         _binary_to_json(plans[plan.members[select]], stream, out, ctx);
+         out += ']';
+         return false;
+      }
+
+      out += '{';
+      auto written = _binary_to_json_fields(plan, stream, out, ctx);
+      EOS_ASSERT( written > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      out += '}';
+      return false;
+   }
+
+   void abi_serializer::_binary_to_json( const type_name& type, fc::datastream<const char *>& stream,
+                                         string& out, impl::binary_to_variant_context& ctx )const
+   {
+      auto plan = plan_ids.find(type);
+      if( plan != plan_ids.end() )
+         _binary_to_json( plans[plan->second], stream, out, ctx );
+      else
+         out += fc::json::to_string( _binary_to_variant(type, stream, ctx) );
+   }
+
+   string abi_serializer::binary_to_json( const type_name& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
+      auto h = ctx.enter_scope();
+      fc::datastream<const char*> ds( binary.data(), binary.size() );
+      string out;
+      _binary_to_json(type, ds, out, ctx);
+      return out;
+   }
+
+   void abi_serializer::binary_to_json( const type_name& type, fc::datastream<const char*>& binary, string& out,
+                                        const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
+      _binary_to_json(type, binary, out, ctx);
+   }
+
    void abi_serializer::_variant_to_binary( const type_name& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
-   { try {
+   {
+      auto plan = plan_ids.find(type);
+      if( plan != plan_ids.end() )
+         return _variant_to_binary( plans[plan->second], var, ds, ctx );
+
+      try {
       auto h = ctx.enter_scope();
       auto rtype = resolve_type(type);
 
@@ -493,7 +846,109 @@ namespace eosio { namespace chain {
       } else {
          EOS_THROW( invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
       }
-   } FC_CAPTURE_AND_RETHROW( (type)(var) ) }
+      } FC_CAPTURE_AND_RETHROW( (type)(var) )
+   }
+
+   void abi_serializer::_variant_to_binary( const type_plan& plan, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
+   {
+      const auto& type = plan.name;
+      try {
+      auto h = ctx.enter_scope();
+
+      if( plan.kind == type_plan::built_in ) {
+         plan.built_in_type->second(var, ds, plan.is_array, plan.is_optional);
+      } else if ( plan.kind == type_plan::array ) {
+         ctx.hint_array_type_if_in_array();
+         vector<fc::variant> vars = var.get_array();
+         fc::raw::pack(ds, (fc::unsigned_int)vars.size());
+
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         auto h2 = ctx.disallow_extensions_unless(false);
+
+         const auto& element = plans[plan.element];
+         int64_t i = 0;
+         for (const auto& var : vars) {
+            ctx.set_array_index_of_path_back(i);
+            _variant_to_binary(element, var, ds, ctx);
+            ++i;
+         }
+      } else if( plan.kind == type_plan::variant ) {
+         const auto& v_itr = plan.variant_itr;
+         ctx.hint_variant_type_if_in_array( v_itr );
+         auto& v = v_itr->second;
+         EOS_ASSERT( var.is_array() && var.size() == 2, pack_exception,
+                    "Expected input to be an array of two items while processing variant '${p}'", ("p", ctx.get_path_string()) );
+         EOS_ASSERT( var[size_t(0)].is_string(), pack_exception,
+                    "Encountered non-string as first item of input array while processing variant '${p}'", ("p", ctx.get_path_string()) );
+         auto variant_type_str = var[size_t(0)].get_string();
+         auto it = find(v.types.begin(), v.types.end(), variant_type_str);
+         EOS_ASSERT( it != v.types.end(), pack_exception,
+                     "Specified type '${t}' in input array is not valid within the variant '${p}'",
+                     ("t", ctx.maybe_shorten(variant_type_str))("p", ctx.get_path_string()) );
+         uint32_t ordinal = it - v.types.begin();
+         fc::raw::pack(ds, fc::unsigned_int(ordinal));
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = ordinal } );
+         _variant_to_binary( plans[plan.members[ordinal]], var[size_t(1)], ds, ctx );
+      } else if( plan.kind == type_plan::structure ) {
+         const auto& s_itr = plan.struct_itr;
+         ctx.hint_struct_type_if_in_array( s_itr );
+         const auto& st = s_itr->second;
+
+         if( var.is_object() ) {
+            const auto& vo = var.get_object();
+
+            if( plan.has_base ) {
+               auto h2 = ctx.disallow_extensions_unless(false);
+               _variant_to_binary(plans[plan.base], var, ds, ctx);
+            }
+            bool disallow_additional_fields = false;
+            for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+               const auto& field = st.fields[i];
+               if( vo.contains( string(field.name).c_str() ) ) {
+                  if( disallow_additional_fields )
+                     EOS_THROW( pack_exception, "Unexpected field '${f}' found in input object while processing struct '${p}'",
+                                ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+                  {
+                     auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+                     auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
+                     _variant_to_binary(plans[plan.members[i]], vo[field.name], ds, ctx);
+                  }
+               } else if( plan.extensions[i] && ctx.extensions_allowed() ) {
+                  disallow_additional_fields = true;
+               } else if( disallow_additional_fields ) {
+                  EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                             ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+               } else {
+                  EOS_THROW( pack_exception, "Missing field '${f}' in input object while processing struct '${p}'",
+                             ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+               }
+            }
+         } else if( var.is_array() ) {
+            const auto& va = var.get_array();
+            EOS_ASSERT( !plan.has_base, invalid_type_inside_abi,
+                        "Using input array to specify the fields of the derived struct '${p}'; input arrays are currently only allowed for structs without a base",
+                        ("p",ctx.get_path_string()) );
+            for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+               const auto& field = st.fields[i];
+               if( va.size() > i ) {
+                  auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+                  auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
+                  _variant_to_binary(plans[plan.members[i]], va[i], ds, ctx);
+               } else if( plan.extensions[i] && ctx.extensions_allowed() ) {
+                  break;
+               } else {
+                  EOS_THROW( pack_exception, "Early end to input array specifying the fields of struct '${p}'; require input for field '${f}'",
+                             ("p", ctx.get_path_string())("f", ctx.maybe_shorten(field.name)) );
+               }
+            }
+         } else {
+            EOS_THROW( pack_exception, "Unexpected input encountered while processing struct '${p}'", ("p",ctx.get_path_string()) );
+         }
+      } else {
+         EOS_THROW( invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
+      }
+      } FC_CAPTURE_AND_RETHROW( (type)(var) )
+   }
 
    bytes abi_serializer::_variant_to_binary( const type_name& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const
    { try {
@@ -0,0 +1,70 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/account_object.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace eosio { namespace chain {
+
+   abi_serializer_cache::abi_serializer_cache( size_t max_entries )
+   :max_entries( std::max<size_t>( max_entries, 1 ) )
+   {}
+
+   std::shared_ptr<const abi_serializer> abi_serializer_cache::get( const chainbase::database& db, account_name account,
+                                                                    const fc::microseconds& max_serialization_time ) {
+      const auto* accnt = db.find<account_object, by_name>( account );
+      if( accnt == nullptr || abi_serializer::is_empty_abi( accnt->abi ) )
+         return nullptr;
+      const auto* seq = db.find<account_sequence_object, by_name>( account );
+      uint64_t abi_sequence = seq ? seq->abi_sequence : 0;
+
+      auto matches = [&]( const entry& e ) {
+         return e.abi_sequence == abi_sequence && e.abi.size() == accnt->abi.size() &&
+                memcmp( e.abi.data(), accnt->abi.data(), e.abi.size() ) == 0;
+      };
+
+      {
+         std::lock_guard<std::mutex> g( mtx );
+         auto itr = entries.find( account );
+         if( itr != entries.end() && matches( itr->second ) ) {
+            itr->second.last_used = ++use_count;
+            return itr->second.serializer;
+         }
+      }
+
+      // parse outside of the lock, another thread may get there first in which case either result will do
+      entry e;
+      e.abi_sequence = abi_sequence;
+      e.abi.assign( accnt->abi.begin(), accnt->abi.end() );
+      abi_def abi;
+      abi_serializer::to_abi( e.abi, abi );
+      e.serializer = std::make_shared<const abi_serializer>( abi, max_serialization_time );
+      auto result = e.serializer;
+
+      std::lock_guard<std::mutex> g( mtx );
+      if( entries.size() >= max_entries && entries.find( account ) == entries.end() ) {
+         auto lru = std::min_element( entries.begin(), entries.end(), []( const auto& l, const auto& r ) {
+            return l.second.last_used < r.second.last_used;
+         });
+         entries.erase( lru );
+      }
+      e.last_used = ++use_count;
+      entries[account] = std::move( e );
+      return result;
+   }
+
+   size_t abi_serializer_cache::size()const {
+      std::lock_guard<std::mutex> g( mtx );
+      return entries.size();
+   }
+
+   void abi_serializer_cache::clear() {
+      std::lock_guard<std::mutex> g( mtx );
+      entries.clear();
+   }
+
+} } /// eosio::chain
@@ -4,11 +4,13 @@
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/execution_profiler.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/hot_state_cache.hpp>
 #include <boost/container/flat_set.hpp>
 
 using boost::container::flat_set;
@@ -29,9 +31,24 @@ static inline void print_debug(account_name receiver, const action_trace& ar) {
    }
 }
 
+void apply_context::check_contract_and_action_lists()const {
+   if( !control.checks_contract_lists() )
+      return;
+   // the lists do not change within a transaction, and its actions mostly repeat a few contracts and notifications
+   auto checked = std::make_tuple( receiver, act.account, act.name );
+   auto& passed = trx_context.list_checked_actions;
+   if( std::find( passed.begin(), passed.end(), checked ) != passed.end() )
+      return;
+   control.check_contract_list( receiver );
+   control.check_action_list( act.account, act.name );
+   if( passed.size() < 16 )
+      passed.push_back( checked );
+}
+
 void apply_context::exec_one( action_trace& trace )
 {
    auto start = fc::time_point::now();
+   execution_profiler::action_scope profile( profiler, receiver, act.name );
 
    action_receipt r;
    r.receiver         = receiver;
@@ -41,7 +58,8 @@ void apply_context::exec_one( action_trace& trace )
    trace.block_num = control.pending_block_state()->block_num;
    trace.block_time = control.pending_block_time();
    trace.producer_block_id = control.pending_producer_block_id();
-   trace.act = act;
+   if( !trim_traces )
+      trace.act = act;
    trace.context_free = context_free;
 
    const auto& cfg = control.get_global_properties().configuration;
@@ -52,9 +70,9 @@ void apply_context::exec_one( action_trace& trace )
          auto native = control.find_apply_handler( receiver, act.account, act.name );
          if( native ) {
             if( trx_context.can_subjectively_fail && control.is_producing_block() ) {
-               control.check_contract_list( receiver );
-               control.check_action_list( act.account, act.name );
+               check_contract_and_action_lists();
             }
+            transaction_phase_timer::scope phase( phase_timer, transaction_phase::native );
             (*native)( *this );
          }
 
@@ -62,10 +80,10 @@ void apply_context::exec_one( action_trace& trace )
              && !(act.account == config::system_account_name && act.name == N( setcode ) &&
                   receiver == config::system_account_name) ) {
             if( trx_context.can_subjectively_fail && control.is_producing_block() ) {
-               control.check_contract_list( receiver );
-               control.check_action_list( act.account, act.name );
+               check_contract_and_action_lists();
             }
             try {
+               transaction_phase_timer::scope phase( phase_timer, transaction_phase::wasm );
                control.get_wasm_interface().apply( a.code_version, a.code, *this );
             } catch( const wasm_exit& ) {}
          }
@@ -104,7 +122,8 @@ void apply_context::finalize_trace( action_trace& trace, const fc::time_point& s
    trace.account_ram_deltas = std::move( _account_ram_deltas );
    _account_ram_deltas.clear();
 
-   trace.console = _pending_console_output.str();
+   if( !trim_traces )
+      trace.console = _pending_console_output.str();
    reset_console();
 
    trace.elapsed = fc::time_point::now() - start;
@@ -112,12 +131,27 @@ void apply_context::finalize_trace( action_trace& trace, const fc::time_point& s
 
 void apply_context::exec( action_trace& trace )
 {
+   phase_timer = trx_context.phase_timer();
+   transaction_phase_timer::scope phase( phase_timer, transaction_phase::dispatch );
+
+   trim_traces = control.trims_action_traces();
+
+   // the inline traces of trimmed traces go to a scratch trace that is dropped
+   action_trace scratch;
+   auto inline_trace = [&]() -> action_trace& {
+      if( trim_traces ) {
+         scratch = action_trace();
+         return scratch;
+      }
+      trace.inline_traces.emplace_back();
+      return trace.inline_traces.back();
+   };
+
    _notified.push_back(receiver);
    exec_one( trace );
    for( uint32_t i = 1; i < _notified.size(); ++i ) {
       receiver = _notified[i];
-      trace.inline_traces.emplace_back( );
-      exec_one( trace.inline_traces.back() );
+      exec_one( inline_trace() );
    }
 
    if( _cfa_inline_actions.size() > 0 || _inline_actions.size() > 0 ) {
@@ -125,14 +159,15 @@ void apply_context::exec( action_trace& trace )
                   transaction_exception, "max inline action depth per transaction reached" );
    }
 
+   if( !trim_traces )
+      trace.inline_traces.reserve( trace.inline_traces.size() + _cfa_inline_actions.size() + _inline_actions.size() );
+
    for( const auto& inline_action : _cfa_inline_actions ) {
-      trace.inline_traces.emplace_back();
-      trx_context.dispatch_action( trace.inline_traces.back(), inline_action, inline_action.account, true, recurse_depth + 1 );
+      trx_context.dispatch_action( inline_trace(), inline_action, inline_action.account, true, recurse_depth + 1 );
    }
 
    for( const auto& inline_action : _inline_actions ) {
-      trace.inline_traces.emplace_back();
-      trx_context.dispatch_action( trace.inline_traces.back(), inline_action, inline_action.account, false, recurse_depth + 1 );
+      trx_context.dispatch_action( inline_trace(), inline_action, inline_action.account, false, recurse_depth + 1 );
    }
 
 } /// exec()
@@ -246,6 +281,7 @@ void apply_context::execute_context_free_inline( action&& a ) {
 
 
 void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, account_name payer, transaction&& trx, bool replace_existing ) {
+   transaction_phase_timer::scope phase( phase_timer, transaction_phase::deferred );
    EOS_ASSERT( trx.context_free_actions.size() == 0, cfa_inside_generated_tx, "context free actions are not currently allowed in generated transactions" );
    trx.expiration = control.pending_block_time() + fc::microseconds(999'999); // Rounds up to nearest second (makes expiration check unnecessary)
    trx.set_reference_block(control.head_block_id()); // No TaPoS check necessary
@@ -294,8 +330,10 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
                   "Replacing a deferred transaction is temporarily disabled." );
 
       // TODO: The logic of the next line needs to be incorporated into the next hard fork.
-      // add_ram_usage( ptr->payer, -(config::billable_size_v<generated_transaction_object> + ptr->packed_trx.size()) );
+      // add_ram_usage( ptr->payer, -(config::billable_size_v<generated_transaction_object> + ptr->packed_trx_size) );
 
+      const auto& payload = generated_transaction_object::create_payload( db, trx );
+      db.remove( db.get<generated_transaction_payload_object>( ptr->payload ) );
       db.modify<generated_transaction_object>( *ptr, [&]( auto& gtx ) {
             gtx.sender      = receiver;
             gtx.sender_id   = sender_id;
@@ -304,9 +342,11 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
             gtx.delay_until = gtx.published + delay;
             gtx.expiration  = gtx.delay_until + fc::seconds(control.get_global_properties().configuration.deferred_trx_expiration_window);
 
-            trx_size = gtx.set( trx );
+            gtx.set_payload( payload );
+            trx_size = gtx.packed_trx_size;
          });
    } else {
+      const auto& payload = generated_transaction_object::create_payload( db, trx );
       db.create<generated_transaction_object>( [&]( auto& gtx ) {
             gtx.trx_id      = trx.id();
             gtx.sender      = receiver;
@@ -316,7 +356,8 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
             gtx.delay_until = gtx.published + delay;
             gtx.expiration  = gtx.delay_until + fc::seconds(control.get_global_properties().configuration.deferred_trx_expiration_window);
 
-            trx_size = gtx.set( trx );
+            gtx.set_payload( payload );
+            trx_size = gtx.packed_trx_size;
          });
    }
 
@@ -326,37 +367,46 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
 }
 
 bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, account_name sender ) {
-   auto& generated_transaction_idx = db.get_mutable_index<generated_transaction_multi_index>();
+   transaction_phase_timer::scope phase( phase_timer, transaction_phase::deferred );
    const auto* gto = db.find<generated_transaction_object,by_sender_id>(boost::make_tuple(sender, sender_id));
    if ( gto ) {
-      add_ram_usage( gto->payer, -(config::billable_size_v<generated_transaction_object> + gto->packed_trx.size()) );
-      generated_transaction_idx.remove(*gto);
+      add_ram_usage( gto->payer, -(config::billable_size_v<generated_transaction_object> + gto->packed_trx_size) );
+      remove_generated_transaction( db, *gto );
    }
    return gto;
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
-   return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   const auto key = std::make_tuple( code.value, scope.value, table.value );
+   const table_id_object* tid = nullptr;
+   if( !table_ids.find( key, tid ) ) {
+      tid = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+      table_ids.set( key, tid );
+   }
+   return tid;
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
-   const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   const auto* existing_tid = find_table( code, scope, table );
    if (existing_tid != nullptr) {
       return *existing_tid;
    }
 
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-   return db.create<table_id_object>([&](table_id_object &t_id){
+   const auto& tid = db.create<table_id_object>([&](table_id_object &t_id){
       t_id.code = code;
       t_id.scope = scope;
       t_id.table = table;
       t_id.payer = payer;
    });
+   table_ids.set( std::make_tuple( code.value, scope.value, table.value ), &tid );
+   return tid;
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
+   table_ids.set( std::make_tuple( tid.code.value, tid.scope.value, tid.table.value ), nullptr );
    db.remove(tid);
 }
 
@@ -420,15 +470,15 @@ int apply_context::get_action( uint32_t type, uint32_t index, char* buffer, size
 
 int apply_context::get_context_free_data( uint32_t index, char* buffer, size_t buffer_size )const
 {
-   const auto& trx = trx_context.trx;
+   const auto& cfd = trx_context.context_free_data();
 
-   if( index >= trx.context_free_data.size() ) return -1;
+   if( index >= cfd.size() ) return -1;
 
-   auto s = trx.context_free_data[index].size();
+   auto s = cfd[index].size();
    if( buffer_size == 0 ) return s;
 
    auto copy_size = std::min( buffer_size, s );
-   memcpy( buffer, trx.context_free_data[index].data(), copy_size );
+   memcpy( buffer, cfd[index].data(), copy_size );
 
    return copy_size;
 }
@@ -451,6 +501,8 @@ int apply_context::db_store_i64( uint64_t code, uint64_t scope, uint64_t table,
       o.payer       = payer;
       memcpy( o.value.data(), buffer, buffer_size );
    });
+   control.record_written_row( tab, id );
+   control.get_mutable_hot_state_cache().add( obj );
 
    db.modify( tab, [&]( auto& t ) {
      ++t.count;
@@ -492,6 +544,7 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
      memcpy( o.value.data(), buffer, buffer_size );
      o.payer = payer;
    });
+   control.record_written_row( table_obj, obj.primary_key );
 }
 
 void apply_context::db_remove_i64( int iterator ) {
@@ -507,6 +560,8 @@ void apply_context::db_remove_i64( int iterator ) {
    db.modify( table_obj, [&]( auto& t ) {
       --t.count;
    });
+   control.record_written_row( table_obj, obj.primary_key );
+   control.get_mutable_hot_state_cache().remove( obj );
    db.remove( obj );
 
    if (table_obj.count == 0) {
@@ -543,6 +598,43 @@ int apply_context::db_next_i64( int iterator, uint64_t& primary ) {
    return keyval_cache.add( *itr );
 }
 
+int apply_context::db_next_many_i64( int iterator, char* buffer, size_t buffer_size, uint32_t max_rows, int& next ) {
+   next = -1;
+   if( iterator < -1 ) return 0; // cannot increment past end iterator of table
+
+   const auto& obj = keyval_cache.get( iterator ); // Check for iterator != -1 happens in this call
+   const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+
+   auto itr = idx.iterator_to( obj );
+   ++itr;
+
+   // every row is written as its iterator, primary key, size and value
+   const size_t header_size = sizeof(int32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+   uint32_t rows = 0;
+   size_t   pos = 0;
+   for( ; rows < max_rows && itr != idx.end() && itr->t_id == obj.t_id; ++itr, ++rows ) {
+      // one call may walk a whole table, so it is held to the deadline as it goes
+      if( rows % 32 == 31 )
+         trx_context.checktime();
+      const uint32_t size = itr->value.size();
+      if( buffer_size - pos < header_size + size ) break;
+
+      const int32_t  row_itr = keyval_cache.add( *itr );
+      const uint64_t primary = itr->primary_key;
+      memcpy( buffer + pos, &row_itr, sizeof(row_itr) );
+      memcpy( buffer + pos + sizeof(row_itr), &primary, sizeof(primary) );
+      memcpy( buffer + pos + sizeof(row_itr) + sizeof(primary), &size, sizeof(size) );
+      memcpy( buffer + pos + header_size, itr->value.data(), size );
+      pos += header_size + size;
+   }
+
+   if( itr == idx.end() || itr->t_id != obj.t_id )
+      next = keyval_cache.get_end_iterator_by_table_id(obj.t_id);
+   else
+      next = keyval_cache.add( *itr );
+   return rows;
+}
+
 int apply_context::db_previous_i64( int iterator, uint64_t& primary ) {
    const auto& idx = db.get_index<key_value_index, by_scope_primary>();
 
@@ -583,8 +675,13 @@ int apply_context::db_find_i64( uint64_t code, uint64_t scope, uint64_t table, u
 
    auto table_end_itr = keyval_cache.cache_table( *tab );
 
-   const key_value_object* obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
-   if( !obj ) return table_end_itr;
+   auto& hot_state = control.get_mutable_hot_state_cache();
+   const key_value_object* obj = hot_state.find( tab->id, id );
+   if( !obj ) {
+      obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
+      if( !obj ) return table_end_itr;
+      hot_state.add( *obj );
+   }
 
    return keyval_cache.add( *obj );
 }
@@ -656,6 +753,9 @@ uint64_t apply_context::next_auth_sequence( account_name actor ) {
 void apply_context::add_ram_usage( account_name account, int64_t ram_delta ) {
    trx_context.add_ram_usage( account, ram_delta );
 
+   if( trim_traces )
+      return;
+
    auto p = _account_ram_deltas.emplace( account, ram_delta );
    if( !p.second ) {
       p.first->delta += ram_delta;
@@ -114,6 +114,8 @@ namespace eosio { namespace chain {
    }
 
    void authorization_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+      _authority_cache.clear();
+
       authorization_index_set::walk_indices([this, &snapshot]( auto utils ){
          using section_t = typename decltype(utils)::index_t::value_type;
 
@@ -157,6 +159,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = auth;
       });
+      update_authority_revision();
       return perm;
    }
 
@@ -184,6 +187,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = std::move(auth);
       });
+      update_authority_revision();
       return perm;
    }
 
@@ -192,6 +196,7 @@ namespace eosio { namespace chain {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
       });
+      update_authority_revision();
    }
 
    void authorization_manager::remove_permission( const permission_object& permission ) {
@@ -202,6 +207,17 @@ namespace eosio { namespace chain {
 
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
+      update_authority_revision();
+   }
+
+   void authorization_manager::update_authority_revision() {
+      // Never hand out a tag twice, even after the session that took it was undone, so that equal tags always
+      // describe the same permissions. Tags restored from an earlier run are all below the one in the database.
+      const auto& dgpo = _db.get<dynamic_global_property_object>();
+      _last_authority_revision = std::max( _last_authority_revision, dgpo.authority_revision ) + 1;
+      _db.modify( dgpo, [&]( auto& p ) {
+         p.authority_revision = _last_authority_revision;
+      });
    }
 
    void authorization_manager::update_permission_usage( const permission_object& permission ) {
@@ -403,7 +419,8 @@ namespace eosio { namespace chain {
                  "cannot cancel trx_id=${tid}, there is no deferred transaction with that transaction id",
                  ("tid", trx_id) );
 
-      auto trx = fc::raw::unpack<transaction>(itr->packed_trx.data(), itr->packed_trx.size());
+      const auto& packed_trx = itr->packed_trx( _control.db() );
+      auto trx = fc::raw::unpack<transaction>(packed_trx.data(), packed_trx.size());
       bool found = false;
       for( const auto& act : trx.actions ) {
          for( const auto& auth : act.authorization ) {
@@ -423,6 +440,8 @@ namespace eosio { namespace chain {
 
    void noop_checktime() {}
 
+   static const size_t max_authority_cache_entries = 64*1024;
+
    std::function<void()> authorization_manager::_noop_checktime{&noop_checktime};
 
    void
@@ -440,7 +459,7 @@ namespace eosio { namespace chain {
 
       auto effective_provided_delay =  (provided_delay >= delay_max_limit) ? fc::microseconds::maximum() : provided_delay;
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -497,6 +516,26 @@ namespace eosio { namespace chain {
 
       // Now verify that all the declared authorizations are satisfied:
 
+      // Satisfaction only depends on the permissions, the provided factors and the max depth, so a combination seen
+      // earlier in the block under the same authority revision is known to pass. Failures are never cached so that
+      // they are always reported with a full evaluation.
+      const auto& dgpo = _control.get_dynamic_global_properties();
+      if( _authority_cache_revision != dgpo.authority_revision || _authority_cache_block != _control.head_block_num()
+          || _authority_cache.size() >= max_authority_cache_entries ) {
+         _authority_cache.clear();
+         _authority_cache_revision = dgpo.authority_revision;
+         _authority_cache_block = _control.head_block_num();
+      }
+
+      authority_cache_key cache_key( vector<std::pair<permission_level, fc::microseconds>>( permissions_to_satisfy.begin(),
+                                                                                          permissions_to_satisfy.end() ),
+                                     provided_keys,
+                                     provided_permissions,
+                                     _control.get_global_properties().configuration.max_authority_depth );
+      auto cached = _authority_cache.find( cache_key );
+      if( cached != _authority_cache.end() && (cached->second || allow_unused_keys) )
+         return;
+
       // Although this can be made parallel (especially for input transactions) with the optimistic assumption that the
       // CPU limit is not reached, because of the CPU limit the protocol must officially specify a sequential algorithm
       // for checking the set of declared authorizations.
@@ -518,8 +557,11 @@ namespace eosio { namespace chain {
 
       }
 
+      bool all_keys_used = checker.all_keys_used();
+      _authority_cache.emplace( std::move(cache_key), all_keys_used );
+
       if( !allow_unused_keys ) {
-         EOS_ASSERT( checker.all_keys_used(), tx_irrelevant_sig,
+         EOS_ASSERT( all_keys_used, tx_irrelevant_sig,
                      "transaction bears irrelevant signatures from these keys: ${keys}",
                      ("keys", checker.unused_keys()) );
       }
@@ -539,7 +581,7 @@ namespace eosio { namespace chain {
 
       auto delay_max_limit = fc::seconds( _control.get_global_properties().configuration.max_transaction_delay );
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -570,7 +612,7 @@ namespace eosio { namespace chain {
                                                                        fc::microseconds provided_delay
                                                                      )const
    {
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         candidate_keys,
                                         {},
@@ -1,5 +1,7 @@
 #include <eosio/chain/block_header_state.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <algorithm>
 #include <limits>
 
 namespace eosio { namespace chain {
@@ -16,16 +18,25 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_header_state::calc_dpos_last_irreversible()const {
-      vector<uint32_t> blocknums; blocknums.reserve( producer_to_last_implied_irb.size() );
+      const auto count = producer_to_last_implied_irb.size();
+      if( count == 0 ) return 0;
+
+      // runs for every block, so the block numbers go on the stack whenever the schedule fits there
+      uint32_t on_stack[config::max_producers];
+      vector<uint32_t> on_heap;
+      uint32_t* blocknums = on_stack;
+      if( count > config::max_producers ) {
+         on_heap.resize( count );
+         blocknums = on_heap.data();
+      }
+      auto* end = blocknums;
       for( auto& i : producer_to_last_implied_irb ) {
-         blocknums.push_back(i.second);
+         *end++ = i.second;
       }
       /// 2/3 must be greater, so if I go 1/3 into the list sorted from low to high, then 2/3 are greater
-
-      if( blocknums.size() == 0 ) return 0;
-      /// TODO: update to nth_element 
-      std::sort( blocknums.begin(), blocknums.end() );
-      return blocknums[ (blocknums.size()-1) / 3 ];
+      auto* nth = blocknums + (count - 1) / 3;
+      std::nth_element( blocknums, nth, end );
+      return *nth;
    }
 
   /**
@@ -233,7 +244,7 @@ namespace eosio { namespace chain {
   }
 
   public_key_type block_header_state::signee()const {
-    return fc::crypto::public_key( header.producer_signature, sig_digest(), true );
+    return signature_recovery_cache::instance().recover( header.producer_signature, sig_digest() );
   }
 
   void block_header_state::add_confirmation( const header_confirmation& conf ) {
@@ -242,7 +253,7 @@ namespace eosio { namespace chain {
 
      auto key = active_schedule.get_producer_key( conf.producer );
      EOS_ASSERT( key != public_key_type(), producer_not_in_schedule, "producer not in current schedule" );
-     auto signer = fc::crypto::public_key( conf.producer_signature, sig_digest(), true );
+     auto signer = signature_recovery_cache::instance().recover( conf.producer_signature, sig_digest() );
      EOS_ASSERT( signer == key, wrong_signing_key, "confirmation not signed by expected key" );
 
      confirmations.emplace_back( conf );
@@ -4,9 +4,19 @@
  */
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <future>
+#include <list>
+#include <mutex>
+#include <thread>
 #include <fc/io/raw.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
@@ -23,6 +33,104 @@ namespace eosio { namespace chain {
    const uint32_t block_log::max_supported_version = 2;
 
    namespace detail {
+      /**
+       * Read-only mapping of a file that is only ever appended to. Readers take a reference to the current mapping,
+       * so lookups need neither a stream position nor a lock held while reading; the file is mapped again once it
+       * has grown past what the current mapping covers.
+       */
+      class mapped_log_file {
+         public:
+            struct mapping {
+               boost::interprocess::file_mapping   file;
+               boost::interprocess::mapped_region  region;
+
+               const char* data()const { return static_cast<const char*>(region.get_address()); }
+               uint64_t    size()const { return region.get_size(); }
+            };
+            typedef std::shared_ptr<const mapping> mapping_ptr;
+
+            void open( const fc::path& p ) {
+               std::lock_guard<std::mutex> g(mtx);
+               path = p;
+               current.reset();
+            }
+
+            void close() {
+               std::lock_guard<std::mutex> g(mtx);
+               current.reset();
+            }
+
+            /// a mapping covering at least the first end bytes of the file
+            mapping_ptr get( uint64_t end ) {
+               std::lock_guard<std::mutex> g(mtx);
+               if( !current || current->size() < end ) {
+                  auto size = fc::file_size( path );
+                  EOS_ASSERT( size >= end, block_log_exception, "Read past the end of ${file}", ("file", path.generic_string()) );
+                  auto m = std::make_shared<mapping>();
+                  m->file = boost::interprocess::file_mapping( path.generic_string().c_str(), boost::interprocess::read_only );
+                  m->region = boost::interprocess::mapped_region( m->file, boost::interprocess::read_only, 0, size );
+                  current = std::move(m);
+               }
+               return current;
+            }
+
+         private:
+            std::mutex   mtx;
+            fc::path     path;
+            mapping_ptr  current;
+      };
+
+      /**
+       * Recently read blocks, sharded by block number so concurrent readers of different blocks rarely contend.
+       * Blocks in the log are irreversible, so a cached block never goes stale until the log is reset. Readers get
+       * their own copy, as a signed_block_ptr lets them modify the block.
+       */
+      class block_cache {
+         public:
+            static const uint32_t shard_count = 8;
+            using cached_block_ptr = std::shared_ptr<const signed_block>;
+
+            cached_block_ptr find( uint32_t block_num ) {
+               auto& s = shards[block_num % shard_count];
+               std::lock_guard<std::mutex> g(s.mtx);
+               auto itr = s.index.find( block_num );
+               if( itr == s.index.end() )
+                  return cached_block_ptr();
+               s.blocks.splice( s.blocks.begin(), s.blocks, itr->second );
+               return itr->second->second;
+            }
+
+            void insert( uint32_t block_num, cached_block_ptr b ) {
+               auto& s = shards[block_num % shard_count];
+               std::lock_guard<std::mutex> g(s.mtx);
+               if( s.index.count( block_num ) )
+                  return;
+               s.blocks.emplace_front( block_num, std::move( b ) );
+               s.index.emplace( block_num, s.blocks.begin() );
+               if( s.blocks.size() > config::block_log_cache_size / shard_count ) {
+                  s.index.erase( s.blocks.back().first );
+                  s.blocks.pop_back();
+               }
+            }
+
+            void clear() {
+               for( auto& s : shards ) {
+                  std::lock_guard<std::mutex> g(s.mtx);
+                  s.index.clear();
+                  s.blocks.clear();
+               }
+            }
+
+         private:
+            typedef std::list<std::pair<uint32_t, cached_block_ptr>> block_list;
+            struct shard {
+               std::mutex                                        mtx;
+               block_list                                        blocks;   ///< most recently used first
+               std::map<uint32_t, block_list::iterator>          index;
+            };
+            shard shards[shard_count];
+      };
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
@@ -36,6 +144,16 @@ namespace eosio { namespace chain {
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
+            std::atomic<uint32_t>    head_num{0};   ///< last block readers may look up
+            mapped_log_file          mapped_blocks;
+            mapped_log_file          mapped_index;
+            block_cache              cache;
+
+            void set_head( const signed_block_ptr& b ) {
+               head = b;
+               head_id = b ? b->id() : block_id_type();
+               head_num = b ? b->block_num() : 0;
+            }
 
             inline void check_block_read() {
                if (block_write) {
@@ -102,6 +220,9 @@ namespace eosio { namespace chain {
          fc::create_directories(data_dir);
       my->block_file = data_dir / "blocks.log";
       my->index_file = data_dir / "blocks.index";
+      my->mapped_blocks.open(my->block_file);
+      my->mapped_index.open(my->index_file);
+      my->cache.clear();
 
       //ilog("Opening block log at ${path}", ("path", my->block_file.generic_string()));
       my->block_stream.open(my->block_file.generic_string().c_str(), LOG_WRITE);
@@ -151,8 +272,7 @@ namespace eosio { namespace chain {
             my->first_block_num = 1;
          }
 
-         my->head = read_head();
-         my->head_id = my->head->id();
+         my->set_head( read_head() );
 
          if (index_size) {
             my->check_block_read();
@@ -188,6 +308,10 @@ namespace eosio { namespace chain {
    }
 
    uint64_t block_log::append(const signed_block_ptr& b) {
+      return append(b, fc::raw::pack(*b));
+   }
+
+   uint64_t block_log::append(const signed_block_ptr& b, const vector<char>& data) {
       try {
          EOS_ASSERT( my->genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
@@ -200,14 +324,13 @@ namespace eosio { namespace chain {
                    "Append to index file occuring at wrong position.",
                    ("position", (uint64_t) my->index_stream.tellp())
                    ("expected", (b->block_num() - my->first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
          my->block_stream.write(data.data(), data.size());
          my->block_stream.write((char*)&pos, sizeof(pos));
+         // a reader that finds the index entry must find the whole block in the log
+         my->block_stream.flush();
          my->index_stream.write((char*)&pos, sizeof(pos));
-         my->head = b;
-         my->head_id = b->id();
-
-         flush();
+         my->index_stream.flush();
+         my->set_head( b );
 
          return pos;
       }
@@ -225,6 +348,11 @@ namespace eosio { namespace chain {
       if (my->index_stream.is_open())
          my->index_stream.close();
 
+      my->mapped_blocks.close();
+      my->mapped_index.close();
+      my->cache.clear();
+      my->set_head( signed_block_ptr() );
+
       fc::remove_all(my->block_file);
       fc::remove_all(my->index_file);
 
@@ -266,36 +394,74 @@ namespace eosio { namespace chain {
    }
 
    std::pair<signed_block_ptr, uint64_t> block_log::read_block(uint64_t pos)const {
-      my->check_block_read();
-
-      my->block_stream.seekg(pos);
       std::pair<signed_block_ptr,uint64_t> result;
-      result.first = std::make_shared<signed_block>();
-      fc::raw::unpack(my->block_stream, *result.first);
-      result.second = uint64_t(my->block_stream.tellg()) + 8;
+      auto m = my->mapped_blocks.get(pos + 1);
+      try {
+         fc::datastream<const char*> ds(m->data() + pos, m->size() - pos);
+         result.first = std::make_shared<signed_block>();
+         fc::raw::unpack(ds, *result.first);
+         result.second = pos + ds.tellp() + 8;
+      } catch( const fc::out_of_range_exception& ) {
+         // the mapping predates the end of this block being written; map the file as it is now
+         m = my->mapped_blocks.get(m->size() + 1);
+         fc::datastream<const char*> ds(m->data() + pos, m->size() - pos);
+         result.first = std::make_shared<signed_block>();
+         fc::raw::unpack(ds, *result.first);
+         result.second = pos + ds.tellp() + 8;
+      }
       return result;
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
+         if (auto cached = my->cache.find(block_num))
+            return std::make_shared<signed_block>(*cached);
          signed_block_ptr b;
          uint64_t pos = get_block_pos(block_num);
          if (pos != npos) {
             b = read_block(pos).first;
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
+            my->cache.insert(block_num, std::make_shared<const signed_block>(*b));
          }
          return b;
       } FC_LOG_AND_RETHROW()
    }
 
+   block_id_type block_log::read_block_id_by_num(uint32_t block_num)const {
+      try {
+         if (auto cached = my->cache.find(block_num))
+            return cached->id();
+         uint64_t pos = get_block_pos(block_num);
+         if (pos == npos)
+            return block_id_type();
+
+         // the header leads the block, and the id only covers the header without the producer signature
+         block_header h;
+         auto m = my->mapped_blocks.get(pos + 1);
+         try {
+            fc::datastream<const char*> ds(m->data() + pos, m->size() - pos);
+            fc::raw::unpack(ds, h);
+         } catch( const fc::out_of_range_exception& ) {
+            m = my->mapped_blocks.get(m->size() + 1);
+            fc::datastream<const char*> ds(m->data() + pos, m->size() - pos);
+            fc::raw::unpack(ds, h);
+         }
+         auto id = h.id();
+         EOS_ASSERT(block_header::num_from_id(id) == block_num, reversible_blocks_exception,
+                    "Wrong block was read from block log.", ("returned", block_header::num_from_id(id))("expected", block_num));
+         return id;
+      } FC_LOG_AND_RETHROW()
+   }
+
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_index_read();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
+      uint32_t head_num = my->head_num;
+      if (!(head_num && block_num <= head_num && block_num >= my->first_block_num))
          return npos;
-      my->index_stream.seekg(sizeof(uint64_t) * (block_num - my->first_block_num));
+      uint64_t offset = sizeof(uint64_t) * (block_num - my->first_block_num);
+      auto m = my->mapped_index.get(offset + sizeof(uint64_t));
       uint64_t pos;
-      my->index_stream.read((char*)&pos, sizeof(pos));
+      memcpy(&pos, m->data() + offset, sizeof(pos));
       return pos;
    }
 
@@ -326,42 +492,79 @@ namespace eosio { namespace chain {
       return my->first_block_num;
    }
 
+   /**
+    * Every block in the log is followed by its own position, so the positions of all blocks can be collected by
+    * following those markers backwards from the end of the file without deserializing anything. The blocks are then
+    * checked against the positions on all cores, each thread taking a contiguous range, before the index is written.
+    */
    void block_log::construct_index() {
       ilog("Reconstructing Block Log Index...");
+      my->mapped_index.close();
       my->index_stream.close();
       fc::remove_all(my->index_file);
       my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
       my->index_write = true;
 
-      uint64_t end_pos;
-      my->check_block_read();
-
-      my->block_stream.seekg(-sizeof( uint64_t), std::ios::end);
-      my->block_stream.read((char*)&end_pos, sizeof(end_pos));
-      signed_block tmp;
+      auto m = my->mapped_blocks.get(sizeof(uint64_t));
+      const char* const data = m->data();
+      const uint64_t size = m->size();
+      auto read_pos = [&]( uint64_t at ) {
+         EOS_ASSERT( at + sizeof(uint64_t) <= size, block_log_exception, "Block log is malformed, position marker outside of the file" );
+         uint64_t pos;
+         memcpy( &pos, data + at, sizeof(pos) );
+         return pos;
+      };
 
-      uint64_t pos = 0;
-      if (my->version == 1) {
-         pos = 4; // Skip version which should have already been checked.
-      } else {
-         pos = 8; // Skip version and first block offset which should have already been checked
+      // Skip the version (and first block number), the genesis state and the totem to find the first block
+      uint64_t first_pos = my->version == 1 ? 4 : 8;
+      {
+         fc::datastream<const char*> ds( data + first_pos, size - first_pos );
+         genesis_state gs;
+         fc::raw::unpack( ds, gs );
+         first_pos += ds.tellp();
+         if (my->version > 1)
+            first_pos += sizeof(uint64_t);
       }
-      my->block_stream.seekg(pos);
 
-      genesis_state gs;
-      fc::raw::unpack(my->block_stream, gs);
+      const uint64_t end_pos = read_pos( size - sizeof(uint64_t) );
+      if( end_pos == npos || end_pos < first_pos )
+         return; // genesis only
 
-      // skip the totem
-      if (my->version > 1) {
-         uint64_t totem;
-         my->block_stream.read((char*) &totem, sizeof(totem));
+      vector<uint64_t> positions;
+      for( uint64_t pos = end_pos; ; ) {
+         positions.push_back( pos );
+         if( pos == first_pos )
+            break;
+         EOS_ASSERT( pos >= first_pos + sizeof(uint64_t), block_log_exception, "Block log is malformed, position markers do not lead to the first block" );
+         auto prev = read_pos( pos - sizeof(uint64_t) );
+         EOS_ASSERT( prev < pos, block_log_exception, "Block log is malformed, position markers do not lead to the first block" );
+         pos = prev;
       }
+      std::reverse( positions.begin(), positions.end() );
 
-      while( pos < end_pos ) {
-         fc::raw::unpack(my->block_stream, tmp);
-         my->block_stream.read((char*)&pos, sizeof(pos));
-         my->index_stream.write((char*)&pos, sizeof(pos));
-      }
+      auto validate = [&]( size_t begin, size_t end ) {
+         signed_block tmp;
+         for( size_t i = begin; i < end; ++i ) {
+            const uint64_t block_end = i + 1 < positions.size() ? positions[i + 1] - sizeof(uint64_t) : size - sizeof(uint64_t);
+            fc::datastream<const char*> ds( data + positions[i], block_end - positions[i] );
+            fc::raw::unpack( ds, tmp );
+            EOS_ASSERT( ds.remaining() == 0 && read_pos( block_end ) == positions[i], block_log_exception,
+                        "Block log is malformed, block at position ${pos} does not end at its position marker", ("pos", positions[i]) );
+            EOS_ASSERT( tmp.block_num() == my->first_block_num + i, block_log_exception,
+                        "Block log is malformed, found block ${n} where block ${e} was expected",
+                        ("n", tmp.block_num())("e", my->first_block_num + i) );
+         }
+      };
+
+      const size_t thread_count = std::max( 1u, std::thread::hardware_concurrency() );
+      const size_t per_thread = (positions.size() + thread_count - 1) / thread_count;
+      vector<std::future<void>> done;
+      for( size_t begin = 0; begin < positions.size(); begin += per_thread )
+         done.emplace_back( std::async( std::launch::async, validate, begin, std::min( positions.size(), begin + per_thread ) ) );
+      for( auto& f : done )
+         f.get();
+
+      my->index_stream.write( (const char*)positions.data(), positions.size() * sizeof(uint64_t) );
    } // construct_index
 
    fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block ) {
@@ -549,4 +752,246 @@ namespace eosio { namespace chain {
       return gs;
    }
 
+   fc::sha256 block_log::checksum( const fc::path& data_dir ) {
+      EOS_ASSERT( fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
+                 "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir)          );
+
+      std::fstream  block_stream;
+      block_stream.open( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
+
+      fc::sha256::encoder enc;
+      vector<char> buffer( 1024*1024 );
+      while( block_stream ) {
+         block_stream.read( buffer.data(), buffer.size() );
+         enc.write( buffer.data(), block_stream.gcount() );
+      }
+      return enc.result();
+   }
+
+   namespace detail {
+      /**
+       * Read-only view of a block log and its index for copying blocks as they are serialized. Nothing but the
+       * genesis state and, where a merge checks that logs link up, block headers is deserialized; block boundaries
+       * come from the index, which has to match the log.
+       */
+      struct raw_block_log {
+         boost::interprocess::file_mapping   log_file;
+         boost::interprocess::mapped_region  log;
+         boost::interprocess::file_mapping   index_file;
+         boost::interprocess::mapped_region  index;
+         uint32_t                            first_block_num = 1;
+         uint32_t                            last_block_num = 0; ///< below first_block_num if the log has no blocks
+         const char*                         genesis = nullptr;  ///< packed genesis state
+         size_t                              genesis_size = 0;
+
+         explicit raw_block_log( const fc::path& data_dir ) {
+            auto log_path = data_dir / "blocks.log";
+            auto index_path = data_dir / "blocks.index";
+            EOS_ASSERT( fc::is_regular_file(log_path) && fc::is_regular_file(index_path), block_log_not_found,
+                        "Block log and index not found in '${blocks_dir}'", ("blocks_dir", data_dir) );
+            EOS_ASSERT( fc::file_size(log_path) > sizeof(uint32_t), block_log_exception, "Block log was not setup properly" );
+            log_file = boost::interprocess::file_mapping( log_path.generic_string().c_str(), boost::interprocess::read_only );
+            log = boost::interprocess::mapped_region( log_file, boost::interprocess::read_only );
+            const uint64_t index_size = fc::file_size( index_path );
+            if( index_size ) {
+               index_file = boost::interprocess::file_mapping( index_path.generic_string().c_str(), boost::interprocess::read_only );
+               index = boost::interprocess::mapped_region( index_file, boost::interprocess::read_only );
+            }
+
+            uint32_t version = 0;
+            memcpy( &version, data(), sizeof(version) );
+            EOS_ASSERT( version >= block_log::min_supported_version && version <= block_log::max_supported_version, block_log_unsupported_version,
+                        "Unsupported version of block log. Block log version is ${version} while code supports version(s) [${min},${max}]",
+                        ("version", version)("min", block_log::min_supported_version)("max", block_log::max_supported_version) );
+            uint64_t pos = sizeof(version);
+            if( version != 1 ) {
+               memcpy( &first_block_num, data() + pos, sizeof(first_block_num) );
+               pos += sizeof(first_block_num);
+            }
+            fc::datastream<const char*> ds( data() + pos, size() - pos );
+            genesis_state gs;
+            fc::raw::unpack( ds, gs );
+            genesis = data() + pos;
+            genesis_size = ds.tellp();
+
+            EOS_ASSERT( index_size % sizeof(uint64_t) == 0, block_log_exception, "Block log index of '${blocks_dir}' is malformed", ("blocks_dir", data_dir) );
+            last_block_num = first_block_num + index_size / sizeof(uint64_t) - 1;
+            if( has_blocks() ) {
+               uint64_t last_pos;
+               memcpy( &last_pos, data() + size() - sizeof(last_pos), sizeof(last_pos) );
+               EOS_ASSERT( last_pos == pos_of( last_block_num ), block_log_exception,
+                           "Block log index of '${blocks_dir}' does not match the block log; start nodeos on it once to rebuild the index",
+                           ("blocks_dir", data_dir) );
+            }
+         }
+
+         const char* data()const { return static_cast<const char*>(log.get_address()); }
+         uint64_t    size()const { return log.get_size(); }
+         bool        has_blocks()const { return last_block_num >= first_block_num; }
+
+         uint64_t pos_of( uint32_t block_num )const {
+            uint64_t pos;
+            memcpy( &pos, static_cast<const char*>(index.get_address()) + sizeof(uint64_t) * (block_num - first_block_num), sizeof(pos) );
+            return pos;
+         }
+
+         /// end of the position marker following the block
+         uint64_t end_of( uint32_t block_num )const {
+            return block_num < last_block_num ? pos_of( block_num + 1 ) : size();
+         }
+
+         signed_block_header header_of( uint32_t block_num )const {
+            fc::datastream<const char*> ds( data() + pos_of( block_num ), end_of( block_num ) - pos_of( block_num ) );
+            signed_block_header h;
+            fc::raw::unpack( ds, h );
+            return h;
+         }
+      };
+
+      /**
+       * Writes a new version 2 block log and its index in one pass, from byte ranges of other logs. The position
+       * marker after every block is rewritten for where the block lands in the new log.
+       */
+      class raw_block_log_writer {
+         public:
+            raw_block_log_writer( const fc::path& data_dir, uint32_t first_block_num, const char* genesis, size_t genesis_size )
+            :next_block_num(first_block_num) {
+               auto log_path = data_dir / "blocks.log";
+               auto index_path = data_dir / "blocks.index";
+               EOS_ASSERT( !fc::exists(log_path) && !fc::exists(index_path), block_log_exception,
+                           "'${blocks_dir}' already contains a block log", ("blocks_dir", data_dir) );
+               fc::create_directories( data_dir );
+               log.exceptions( std::fstream::failbit | std::fstream::badbit );
+               index.exceptions( std::fstream::failbit | std::fstream::badbit );
+               log.open( log_path.generic_string().c_str(), LOG_WRITE );
+               index.open( index_path.generic_string().c_str(), LOG_WRITE );
+
+               const uint32_t version = block_log::max_supported_version;
+               const uint64_t totem = block_log::npos;
+               log.write( (const char*)&version, sizeof(version) );
+               log.write( (const char*)&first_block_num, sizeof(first_block_num) );
+               log.write( genesis, genesis_size );
+               log.write( (const char*)&totem, sizeof(totem) );
+               pos = sizeof(version) + sizeof(first_block_num) + genesis_size + sizeof(totem);
+            }
+
+            uint32_t next_block() const { return next_block_num; }
+
+            /// appends blocks first through last of src, which must continue the blocks written so far
+            void append( const raw_block_log& src, uint32_t first, uint32_t last ) {
+               EOS_ASSERT( first == next_block_num, block_log_exception, "Expected block ${e} next, not block ${n}",
+                           ("e", next_block_num)("n", first) );
+               EOS_ASSERT( src.first_block_num <= first && last <= src.last_block_num, block_log_exception,
+                           "Blocks ${f} through ${l} are not all in the block log", ("f", first)("l", last) );
+               vector<uint64_t> positions;
+               for( uint32_t n = first; n <= last; ) {
+                  // as many blocks as fit in a buffer, but at least one
+                  const uint64_t begin = src.pos_of( n );
+                  uint32_t end_block = n;
+                  while( end_block < last && src.end_of( end_block + 1 ) - begin <= buffer_size )
+                     ++end_block;
+                  const uint64_t end = src.end_of( end_block );
+
+                  buffer.assign( src.data() + begin, src.data() + end );
+                  positions.clear();
+                  for( uint32_t b = n; b <= end_block; ++b ) {
+                     uint64_t new_pos = pos + (src.pos_of( b ) - begin);
+                     memcpy( buffer.data() + (src.end_of( b ) - sizeof(uint64_t) - begin), &new_pos, sizeof(new_pos) );
+                     positions.push_back( new_pos );
+                  }
+                  log.write( buffer.data(), buffer.size() );
+                  index.write( (const char*)positions.data(), positions.size() * sizeof(uint64_t) );
+                  pos += end - begin;
+                  n = end_block + 1;
+               }
+               next_block_num = last + 1;
+            }
+
+            void close() {
+               log.close();
+               index.close();
+            }
+
+         private:
+            static const uint64_t buffer_size = 64*1024*1024;
+
+            std::fstream   log;
+            std::fstream   index;
+            uint64_t       pos = 0;
+            uint32_t       next_block_num;
+            vector<char>   buffer;
+      };
+   }
+
+   void block_log::extract_blocks( const fc::path& src_dir, const fc::path& dst_dir, uint32_t first, uint32_t last ) {
+      detail::raw_block_log src( src_dir );
+      EOS_ASSERT( src.has_blocks() && first <= last && src.first_block_num <= first && last <= src.last_block_num, block_log_exception,
+                  "Blocks ${f} through ${l} are not all in the block log, which has blocks ${sf} through ${sl}",
+                  ("f", first)("l", last)("sf", src.first_block_num)("sl", src.last_block_num) );
+      detail::raw_block_log_writer dst( dst_dir, first, src.genesis, src.genesis_size );
+      dst.append( src, first, last );
+      dst.close();
+   }
+
+   void block_log::merge_logs( const vector<fc::path>& src_dirs, const fc::path& dst_dir ) {
+      EOS_ASSERT( !src_dirs.empty(), block_log_exception, "No block logs to merge" );
+      optional<detail::raw_block_log_writer> dst;
+      optional<block_id_type> last_id;
+      vector<char> genesis;
+      for( const auto& dir : src_dirs ) {
+         detail::raw_block_log src( dir );
+         if( !src.has_blocks() )
+            continue;
+         if( !dst ) {
+            genesis.assign( src.genesis, src.genesis + src.genesis_size );
+            dst.emplace( dst_dir, src.first_block_num, src.genesis, src.genesis_size );
+         } else {
+            EOS_ASSERT( vector<char>( src.genesis, src.genesis + src.genesis_size ) == genesis, block_log_exception,
+                        "The block log in '${d}' has a different genesis state", ("d", dir) );
+            EOS_ASSERT( src.first_block_num == dst->next_block(), block_log_exception,
+                        "The block log in '${d}' starts at block ${n}, not at block ${e}",
+                        ("d", dir)("n", src.first_block_num)("e", dst->next_block()) );
+            EOS_ASSERT( src.header_of( src.first_block_num ).previous == *last_id, block_log_exception,
+                        "The first block of the block log in '${d}' does not link to the last block merged before it", ("d", dir) );
+         }
+         dst->append( src, src.first_block_num, src.last_block_num );
+         last_id = src.header_of( src.last_block_num ).id();
+      }
+      EOS_ASSERT( dst, block_log_exception, "None of the block logs to merge has any blocks" );
+      dst->close();
+   }
+
+   void block_log::trim_front( const fc::path& data_dir, uint32_t first ) {
+      auto tmp_dir = data_dir / "trim-front.tmp";
+      EOS_ASSERT( !fc::exists(tmp_dir), block_log_exception, "'${d}' already exists", ("d", tmp_dir) );
+      {
+         detail::raw_block_log src( data_dir );
+         EOS_ASSERT( src.has_blocks() && src.first_block_num <= first && first <= src.last_block_num, block_log_exception,
+                     "Block ${f} is not in the block log, which has blocks ${sf} through ${sl}",
+                     ("f", first)("sf", src.first_block_num)("sl", src.last_block_num) );
+         if( first == src.first_block_num )
+            return;
+         detail::raw_block_log_writer dst( tmp_dir, first, src.genesis, src.genesis_size );
+         dst.append( src, first, src.last_block_num );
+         dst.close();
+      }
+      fc::rename( tmp_dir / "blocks.log", data_dir / "blocks.log" );
+      fc::rename( tmp_dir / "blocks.index", data_dir / "blocks.index" );
+      fc::remove_all( tmp_dir );
+   }
+
+   void block_log::trim_end( const fc::path& data_dir, uint32_t last ) {
+      uint64_t log_size, index_size;
+      {
+         detail::raw_block_log src( data_dir );
+         EOS_ASSERT( src.has_blocks() && src.first_block_num <= last && last <= src.last_block_num, block_log_exception,
+                     "Block ${l} is not in the block log, which has blocks ${sf} through ${sl}",
+                     ("l", last)("sf", src.first_block_num)("sl", src.last_block_num) );
+         log_size = src.end_of( last );
+         index_size = sizeof(uint64_t) * (last - src.first_block_num + 1);
+      }
+      fc::resize_file( data_dir / "blocks.index", index_size );
+      fc::resize_file( data_dir / "blocks.log", log_size );
+   }
+
 } } /// eosio::chain
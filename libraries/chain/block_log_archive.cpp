@@ -0,0 +1,309 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/block_log_archive.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fstream>
+#include <mutex>
+#include <fc/io/raw.hpp>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace bio = boost::iostreams;
+
+   namespace detail {
+      struct archive_segment {
+         fc::path                   path;
+         uint32_t                   first_block_num = 0;
+         uint32_t                   block_count = 0;
+         uint32_t                   blocks_per_chunk = 0;
+         mutable vector<uint64_t>   chunk_positions;   ///< loaded on first use
+
+         uint32_t last_block_num()const { return first_block_num + block_count - 1; }
+      };
+
+      class block_log_archive_impl {
+         public:
+            map<uint32_t, archive_segment>   segments;   ///< by first block number
+            genesis_state                    genesis;
+
+            std::mutex                       mtx;
+            uint32_t                         cached_segment = 0;
+            uint32_t                         cached_chunk = 0;
+            vector<signed_block_ptr>         cached_blocks;   ///< the blocks of the most recently read chunk
+      };
+
+      static bytes zlib_compress( const bytes& data ) {
+         bytes out;
+         bio::filtering_ostream comp;
+         comp.push(bio::zlib_compressor(bio::zlib::best_compression));
+         comp.push(bio::back_inserter(out));
+         bio::write(comp, data.data(), data.size());
+         bio::close(comp);
+         return out;
+      }
+
+      static bytes zlib_decompress( const bytes& data ) {
+         try {
+            bytes out;
+            bio::filtering_ostream decomp;
+            decomp.push(bio::zlib_decompressor());
+            decomp.push(bio::back_inserter(out));
+            bio::write(decomp, data.data(), data.size());
+            bio::close(decomp);
+            return out;
+         } catch( fc::exception& er ) {
+            throw;
+         } catch( ... ) {
+            fc::unhandled_exception er( FC_LOG_MESSAGE( warn, "internal decompression error"), std::current_exception() );
+            throw er;
+         }
+      }
+
+      static fc::path segment_path( const fc::path& archive_dir, uint32_t first, uint32_t last ) {
+         char name[64];
+         snprintf( name, sizeof(name), "blocks-%010u-%010u.log3", first, last );
+         return archive_dir / name;
+      }
+
+      static archive_segment read_segment_header( const fc::path& p, genesis_state& gs ) {
+         std::fstream stream;
+         stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+         stream.open( p.generic_string().c_str(), std::ios::in | std::ios::binary );
+
+         uint32_t version = 0;
+         stream.read( (char*)&version, sizeof(version) );
+         EOS_ASSERT( version == block_log_archive::version, block_log_unsupported_version,
+                     "Unsupported version ${version} of block log archive segment ${file}",
+                     ("version", version)("file", p.generic_string()) );
+
+         archive_segment seg;
+         seg.path = p;
+         stream.read( (char*)&seg.first_block_num, sizeof(seg.first_block_num) );
+         stream.read( (char*)&seg.block_count, sizeof(seg.block_count) );
+         stream.read( (char*)&seg.blocks_per_chunk, sizeof(seg.blocks_per_chunk) );
+         EOS_ASSERT( seg.first_block_num > 0 && seg.block_count > 0 && seg.blocks_per_chunk > 0, block_log_exception,
+                     "Block log archive segment ${file} is malformed", ("file", p.generic_string()) );
+         fc::raw::unpack( stream, gs );
+         return seg;
+      }
+
+      static map<uint32_t, archive_segment> find_segments( const fc::path& archive_dir, genesis_state& gs ) {
+         map<uint32_t, archive_segment> segments;
+         if( !fc::is_directory( archive_dir ) )
+            return segments;
+
+         optional<chain_id_type> chain_id;
+         for( fc::directory_iterator itr( archive_dir ), end; itr != end; ++itr ) {
+            if( !fc::is_regular_file( *itr ) || itr->extension().generic_string() != ".log3" )
+               continue;
+            genesis_state seg_gs;
+            auto seg = read_segment_header( *itr, seg_gs );
+            auto seg_chain_id = seg_gs.compute_chain_id();
+            EOS_ASSERT( !chain_id || *chain_id == seg_chain_id, block_log_exception,
+                        "Block log archive segment ${file} belongs to another chain", ("file", itr->generic_string()) );
+            if( !chain_id ) {
+               chain_id = seg_chain_id;
+               gs = seg_gs;
+            }
+            segments.emplace( seg.first_block_num, std::move(seg) );
+         }
+         return segments;
+      }
+
+      static void write_segment( const block_log& log, const genesis_state& gs, const fc::path& archive_dir,
+                                 uint32_t first, uint32_t last, uint32_t blocks_per_chunk ) {
+         auto final_path = segment_path( archive_dir, first, last );
+         auto tmp_path = final_path;
+         tmp_path.replace_extension( ".tmp" );
+
+         std::fstream out;
+         out.exceptions(std::fstream::failbit | std::fstream::badbit);
+         out.open( tmp_path.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+
+         const uint32_t count = last - first + 1;
+         out.write( (const char*)&block_log_archive::version, sizeof(block_log_archive::version) );
+         out.write( (const char*)&first, sizeof(first) );
+         out.write( (const char*)&count, sizeof(count) );
+         out.write( (const char*)&blocks_per_chunk, sizeof(blocks_per_chunk) );
+         auto data = fc::raw::pack( gs );
+         out.write( data.data(), data.size() );
+
+         vector<uint64_t> chunk_positions;
+         for( uint32_t chunk_first = first; chunk_first <= last; chunk_first += blocks_per_chunk ) {
+            const uint32_t chunk_last = std::min<uint64_t>( last, uint64_t(chunk_first) + blocks_per_chunk - 1 );
+            bytes raw;
+            for( uint32_t n = chunk_first; n <= chunk_last; ++n ) {
+               auto b = log.read_block_by_num( n );
+               EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from the block log", ("n", n) );
+               auto packed = fc::raw::pack( *b );
+               raw.insert( raw.end(), packed.begin(), packed.end() );
+            }
+            chunk_positions.push_back( out.tellp() );
+            data = fc::raw::pack( zlib_compress( raw ) );
+            out.write( data.data(), data.size() );
+         }
+
+         uint64_t index_pos = out.tellp();
+         data = fc::raw::pack( chunk_positions );
+         out.write( data.data(), data.size() );
+         out.write( (const char*)&index_pos, sizeof(index_pos) );
+         out.close();
+
+         fc::rename( tmp_path, final_path );
+         ilog( "Wrote block log archive segment ${file}", ("file", final_path.generic_string()) );
+      }
+   }
+
+   block_log_archive::block_log_archive( const fc::path& archive_dir )
+   :my(new detail::block_log_archive_impl()) {
+      my->segments = detail::find_segments( archive_dir, my->genesis );
+   }
+
+   block_log_archive::block_log_archive( block_log_archive&& other ) {
+      my = std::move(other.my);
+   }
+
+   block_log_archive::~block_log_archive() {}
+
+   uint32_t block_log_archive::first_block_num()const {
+      return my->segments.empty() ? 0 : my->segments.begin()->first;
+   }
+
+   uint32_t block_log_archive::last_block_num()const {
+      return my->segments.empty() ? 0 : my->segments.rbegin()->second.last_block_num();
+   }
+
+   bool block_log_archive::is_contiguous()const {
+      uint32_t next = first_block_num();
+      for( const auto& s : my->segments ) {
+         if( s.first != next )
+            return false;
+         next = s.second.last_block_num() + 1;
+      }
+      return true;
+   }
+
+   const genesis_state& block_log_archive::genesis()const {
+      return my->genesis;
+   }
+
+   signed_block_ptr block_log_archive::read_block_by_num( uint32_t block_num )const {
+      try {
+         auto itr = my->segments.upper_bound( block_num );
+         if( itr == my->segments.begin() )
+            return signed_block_ptr();
+         const auto& seg = (--itr)->second;
+         if( block_num > seg.last_block_num() )
+            return signed_block_ptr();
+
+         const uint32_t chunk = (block_num - seg.first_block_num) / seg.blocks_per_chunk;
+         const uint32_t offset = (block_num - seg.first_block_num) % seg.blocks_per_chunk;
+
+         std::lock_guard<std::mutex> g( my->mtx );
+         if( my->cached_blocks.empty() || my->cached_segment != seg.first_block_num || my->cached_chunk != chunk ) {
+            std::fstream stream;
+            stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+            stream.open( seg.path.generic_string().c_str(), std::ios::in | std::ios::binary );
+
+            if( seg.chunk_positions.empty() ) {
+               uint64_t index_pos;
+               stream.seekg( -sizeof(index_pos), std::ios::end );
+               stream.read( (char*)&index_pos, sizeof(index_pos) );
+               stream.seekg( index_pos );
+               fc::raw::unpack( stream, seg.chunk_positions );
+            }
+            EOS_ASSERT( chunk < seg.chunk_positions.size(), block_log_exception,
+                        "Block log archive segment ${file} is missing chunk ${c}", ("file", seg.path.generic_string())("c", chunk) );
+
+            stream.seekg( seg.chunk_positions[chunk] );
+            bytes compressed;
+            fc::raw::unpack( stream, compressed );
+            auto raw = detail::zlib_decompress( compressed );
+
+            my->cached_blocks.clear();
+            fc::datastream<const char*> ds( raw.data(), raw.size() );
+            while( ds.remaining() ) {
+               auto b = std::make_shared<signed_block>();
+               fc::raw::unpack( ds, *b );
+               my->cached_blocks.emplace_back( std::move(b) );
+            }
+            my->cached_segment = seg.first_block_num;
+            my->cached_chunk = chunk;
+         }
+
+         EOS_ASSERT( offset < my->cached_blocks.size(), block_log_exception,
+                     "Block ${n} is missing from block log archive segment ${file}", ("n", block_num)("file", seg.path.generic_string()) );
+         auto b = my->cached_blocks[offset];
+         EOS_ASSERT( b->block_num() == block_num, block_log_exception,
+                     "Wrong block was read from block log archive.", ("returned", b->block_num())("expected", block_num) );
+         return b;
+      } FC_LOG_AND_RETHROW()
+   }
+
+   void block_log_archive::create( const fc::path& blocks_dir, const fc::path& archive_dir, const options& opts,
+                                   uint32_t first_block_num ) {
+      EOS_ASSERT( opts.blocks_per_chunk > 0 && opts.blocks_per_segment >= opts.blocks_per_chunk, block_log_exception,
+                  "A segment must hold at least one chunk of at least one block" );
+      EOS_ASSERT( fc::is_directory(blocks_dir) && fc::is_regular_file(blocks_dir / "blocks.log"), block_log_not_found,
+                  "Block log not found in '${blocks_dir}'", ("blocks_dir", blocks_dir) );
+
+      auto gs = block_log::extract_genesis_state( blocks_dir );
+      block_log log( blocks_dir );
+      EOS_ASSERT( log.head(), block_log_exception, "No blocks found in block log" );
+      const uint32_t head_num = log.head()->block_num();
+
+      if( !fc::is_directory( archive_dir ) )
+         fc::create_directories( archive_dir );
+
+      genesis_state archive_gs;
+      auto existing = detail::find_segments( archive_dir, archive_gs );
+      EOS_ASSERT( existing.empty() || archive_gs.compute_chain_id() == gs.compute_chain_id(), block_log_exception,
+                  "Block log archive in '${dir}' belongs to another chain", ("dir", archive_dir) );
+
+      // segments cover fixed ranges of block numbers so that archives made from different nodes line up
+      auto segment_end = [&]( uint32_t n ) {
+         return uint32_t( std::min<uint64_t>( head_num, ((uint64_t(n) - 1) / opts.blocks_per_segment + 1) * opts.blocks_per_segment ) );
+      };
+
+      uint32_t next = std::max( first_block_num, log.first_block_num() );
+      if( !first_block_num && !existing.empty() ) {
+         const auto& last = existing.rbegin()->second;
+         if( last.last_block_num() == segment_end( last.first_block_num ) || last.last_block_num() >= head_num ) {
+            next = last.last_block_num() + 1;
+         } else {
+            fc::remove( last.path );
+            next = last.first_block_num;
+         }
+      }
+
+      while( next <= head_num ) {
+         const uint32_t end = segment_end( next );
+         detail::write_segment( log, gs, archive_dir, next, end, opts.blocks_per_chunk );
+         next = end + 1;
+      }
+   }
+
+   void block_log_archive::extract( const fc::path& archive_dir, const fc::path& blocks_dir ) {
+      block_log_archive archive( archive_dir );
+      const uint32_t first = archive.first_block_num();
+      EOS_ASSERT( first > 0, block_log_not_found, "No block log archive segments found in '${dir}'", ("dir", archive_dir) );
+      EOS_ASSERT( archive.is_contiguous(), block_log_exception, "Block log archive in '${dir}' is missing segments", ("dir", archive_dir) );
+      EOS_ASSERT( !fc::exists( blocks_dir / "blocks.log" ), block_log_exception,
+                  "Block log already exists in '${blocks_dir}'", ("blocks_dir", blocks_dir) );
+
+      block_log log( blocks_dir );
+      log.reset( archive.genesis(), archive.read_block_by_num( first ), first );
+      for( uint32_t n = first + 1; n <= archive.last_block_num(); ++n )
+         log.append( archive.read_block_by_num( n ) );
+      ilog( "Extracted blocks ${first} through ${last} into '${blocks_dir}'",
+            ("first", first)("last", archive.last_block_num())("blocks_dir", blocks_dir) );
+   }
+
+} } /// eosio::chain
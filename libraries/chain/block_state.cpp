@@ -14,6 +14,16 @@ namespace eosio { namespace chain {
    :block_header_state( prev.next( *b, trust )), block( move(b) )
    { } 
 
+   std::shared_ptr<const vector<char>> block_state::packed_block()const {
+      auto packed = std::atomic_load( &_packed_block );
+      if( !packed ) {
+         // threads packing it at once all get the same bytes, whichever is stored
+         packed = std::make_shared<const vector<char>>( fc::raw::pack( *block ) );
+         std::atomic_store( &_packed_block, packed );
+      }
+      return packed;
+   }
+
 
 
 } } /// eosio::chain
@@ -14,17 +14,42 @@
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
+#include <eosio/chain/transaction_id_filter.hpp>
+#include <eosio/chain/hot_state_cache.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/signal_dispatcher.hpp>
+#include <eosio/chain/thread_registry.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <eosio/chain/permission_link_object.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
+#include <eosio/chain/execution_profiler.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/read_replica.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
 #include <fc/scoped_exit.hpp>
 
 #include <fc/variant_object.hpp>
+#include <fc/io/fstream.hpp>
+#include <fstream>
+#include <atomic>
+#include <future>
+#include <unordered_set>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <eosio/chain/eosio_contract.hpp>
 
@@ -41,6 +66,7 @@ using controller_index_set = index_set<
    block_summary_multi_index,
    transaction_multi_index,
    generated_transaction_multi_index,
+   generated_transaction_payload_index,
    table_id_multi_index
 >;
 
@@ -53,49 +79,131 @@ using contract_database_index_set = index_set<
    index_long_double_index
 >;
 
+/// every index of the state database, whose undo states update_undo_metrics accounts for
+using undo_accounted_index_set = index_set<
+   account_index,
+   account_sequence_index,
+   global_property_multi_index,
+   dynamic_global_property_multi_index,
+   core_symbol_multi_index,
+   block_summary_multi_index,
+   transaction_multi_index,
+   generated_transaction_multi_index,
+   generated_transaction_payload_index,
+   table_id_multi_index,
+   key_value_index,
+   index64_index,
+   index128_index,
+   index256_index,
+   index_double_index,
+   index_long_double_index,
+   permission_index,
+   permission_usage_index,
+   permission_link_index,
+   resource_limits::resource_limits_index,
+   resource_limits::resource_usage_index,
+   resource_limits::resource_limits_state_index,
+   resource_limits::resource_limits_config_index
+>;
+
+namespace detail {
+   template<>
+   struct snapshot_row_traits<generated_transaction_object> {
+      using value_type = generated_transaction_object;
+      using snapshot_type = snapshot_generated_transaction_object;
+
+      static snapshot_generated_transaction_object to_snapshot_row( const generated_transaction_object& value, const chainbase::database& db ) {
+         snapshot_generated_transaction_object res;
+         res.trx_id      = value.trx_id;
+         res.sender      = value.sender;
+         res.sender_id   = value.sender_id;
+         res.payer       = value.payer;
+         res.delay_until = value.delay_until;
+         res.expiration  = value.expiration;
+         res.published   = value.published;
+         const auto& packed_trx = value.packed_trx( db );
+         res.packed_trx.assign( packed_trx.begin(), packed_trx.end() );
+         return res;
+      }
+
+      static void from_snapshot_row( snapshot_generated_transaction_object&& row, generated_transaction_object& value, chainbase::database& db ) {
+         value.trx_id      = row.trx_id;
+         value.sender      = row.sender;
+         value.sender_id   = row.sender_id;
+         value.payer       = row.payer;
+         value.delay_until = row.delay_until;
+         value.expiration  = row.expiration;
+         value.published   = row.published;
+         const auto& payload = db.create<generated_transaction_payload_object>( [&]( auto& p ) {
+            p.packed_trx.assign( row.packed_trx.data(), row.packed_trx.size() );
+         });
+         value.set_payload( payload );
+      }
+   };
+}
+
+/// clears the hot_state_cache whenever its session undoes changes, as the rows they created are gone then
 class maybe_session {
    public:
       maybe_session() = default;
 
       maybe_session( maybe_session&& other)
-      :_session(move(other._session))
+      :_session(move(other._session)), _hot_state(other._hot_state)
       {
+         other._session.reset();
       }
 
-      explicit maybe_session(database& db) {
+      maybe_session(database& db, hot_state_cache& hot_state)
+      :_hot_state(&hot_state) {
          _session = db.start_undo_session(true);
       }
 
       maybe_session(const maybe_session&) = delete;
 
-      void squash() {
+      ~maybe_session() {
          if (_session)
+            _hot_state->clear();
+      }
+
+      void squash() {
+         if (_session) {
             _session->squash();
+            _session.reset();
+         }
       }
 
       void undo() {
-         if (_session)
+         if (_session) {
             _session->undo();
+            _session.reset();
+            _hot_state->clear();
+         }
       }
 
       void push() {
-         if (_session)
+         if (_session) {
             _session->push();
+            _session.reset();
+         }
       }
 
       maybe_session& operator = ( maybe_session&& mv ) {
+         if (_session)
+            _hot_state->clear(); // undone as it is replaced
          if (mv._session) {
             _session = move(*mv._session);
             mv._session.reset();
          } else {
             _session.reset();
          }
+         _hot_state = mv._hot_state;
 
          return *this;
       };
 
    private:
       optional<database::session>     _session;
+      hot_state_cache*                _hot_state = nullptr;
 };
 
 struct pending_state {
@@ -108,7 +216,11 @@ struct pending_state {
 
    vector<action_receipt>             _actions;
 
-   vector<digest_type>                _action_digests;
+   /// only kept when someone listens to accepted_block_with_action_digests
+   std::shared_ptr<const vector<digest_type>>  _action_digests;
+
+   /// only kept when someone listens to accepted_block_state_deltas, failed transactions included
+   optional<vector<table_row_key>>    _written_rows;
 
    controller::block_status           _block_status = controller::block_status::incomplete;
 
@@ -119,26 +231,101 @@ struct pending_state {
    }
 };
 
+static const uint32_t wasm_cache_manifest_version = 1;
+
+/**
+ *  Bumped whenever an object of the state database changes its layout, since the database maps them as they are:
+ *  1 - resource_limits_state_object::pending_usage_entries
+ *  2 - dynamic_global_property_object::authority_revision
+ *  3 - generated_transaction_payload_object, which holds the packed_trx of generated_transaction_object, and
+ *      shared_authority::weight_order
+ */
+static const uint32_t state_layout_version = 3;
+
+/**
+ *  The access lists of controller::config in hashed sets, so that checking an action or the actors of a transaction
+ *  costs a probe per name however long the lists loaded from governance are. Rebuilt whenever a list is set; the
+ *  flat sets of the config stay what the lists are read back as.
+ */
+struct hashed_access_lists {
+   struct action_hash {
+      size_t operator()( const pair<uint64_t, uint64_t>& a )const {
+         return std::hash<uint64_t>()( a.first ) ^ ( std::hash<uint64_t>()( a.second ) * 0x9e3779b97f4a7c15ull );
+      }
+   };
+
+   std::unordered_set<uint64_t>                                actor_whitelist;
+   std::unordered_set<uint64_t>                                actor_blacklist;
+   std::unordered_set<uint64_t>                                contract_whitelist;
+   std::unordered_set<uint64_t>                                contract_blacklist;
+   std::unordered_set<pair<uint64_t, uint64_t>, action_hash>   action_blacklist;
+   std::unordered_set<string>                                  key_blacklist; ///< packed keys
+
+   static std::unordered_set<uint64_t> hash_names( const flat_set<account_name>& names ) {
+      std::unordered_set<uint64_t> hashed( names.size() );
+      for( const auto& n : names )
+         hashed.insert( n.value );
+      return hashed;
+   }
+
+   static string key_of( const public_key_type& key ) {
+      auto packed = fc::raw::pack( key );
+      return string( packed.begin(), packed.end() );
+   }
+
+   void build( const controller::config& conf ) {
+      actor_whitelist    = hash_names( conf.actor_whitelist );
+      actor_blacklist    = hash_names( conf.actor_blacklist );
+      contract_whitelist = hash_names( conf.contract_whitelist );
+      contract_blacklist = hash_names( conf.contract_blacklist );
+
+      action_blacklist.clear();
+      action_blacklist.reserve( conf.action_blacklist.size() );
+      for( const auto& a : conf.action_blacklist )
+         action_blacklist.emplace( a.first.value, a.second.value );
+
+      key_blacklist.clear();
+      key_blacklist.reserve( conf.key_blacklist.size() );
+      for( const auto& k : conf.key_blacklist )
+         key_blacklist.insert( key_of( k ) );
+   }
+
+   /// whether an action can fail the contract or action list checks at all
+   bool checks_actions()const {
+      return !contract_whitelist.empty() || !contract_blacklist.empty() || !action_blacklist.empty();
+   }
+};
+
 struct controller_impl {
    controller&                    self;
    chainbase::database            db;
    chainbase::database            reversible_blocks; ///< a special database to persist blocks that have successfully been applied but are still reversible
    block_log                      blog;
+   hot_state_cache                hot_state; ///< before pending, whose session clears it
+   signal_dispatcher              dispatcher;
    optional<pending_state>        pending;
    block_state_ptr                head;
    fork_database                  fork_db;
    wasm_interface                 wasmif;
+   optional<execution_profiler>   profiler;
    resource_limits_manager        resource_limits;
    authorization_manager          authorization;
    controller::config             conf;
    chain_id_type                  chain_id;
    bool                           replaying= false;
    optional<fc::time_point>       replay_head_time;
+   bool                           trusted_replay = false;   ///< blocks.log matched conf.trusted_replay_checksum
    db_read_mode                   read_mode = db_read_mode::SPECULATIVE;
    bool                           in_trx_requiring_checks = false; ///< if true, checks that are normally skipped on replay (e.g. auth checks) cannot be skipped
+   bool                           in_block_input_trx = false; ///< if true, an input transaction of a block being applied is executing; it cannot fail without failing the block
    optional<fc::microseconds>     subjective_cpu_leeway;
+   bool                           trim_action_traces = false;
    bool                           trusted_producer_light_validation = false;
    uint32_t                       snapshot_head_block = 0;
+   std::unique_ptr<read_replica_segment> read_replica;           ///< of this node, or of the node followed by a read replica
+   uint32_t                       read_replica_write_depth = 0;
+   block_id_type                  published_replica_head;
+   uint64_t                       followed_replica_revision = 0;
 
    typedef pair<scope_name,action_name>                   handler_key;
    map< account_name, map<handler_key, apply_handler> >   apply_handlers;
@@ -150,6 +337,18 @@ struct controller_impl {
     */
    map<digest_type, transaction_metadata_ptr>     unapplied_transactions;
 
+   /**
+    *  In front of the deduplication index: every id recorded in it since startup is in the filter. Undone records
+    *  are left in the filter, which only costs an index lookup.
+    */
+   transaction_id_filter                          known_trx_filter;
+
+   hashed_access_lists                            access_lists; ///< of conf
+
+   boost::asio::io_service                           recovery_ios;
+   std::unique_ptr<boost::asio::io_service::work>    recovery_work;
+   std::vector<std::thread>                          recovery_threads;
+
    void pop_block() {
       auto prev = fork_db.get_block( head->header.previous );
       EOS_ASSERT( prev, block_validate_exception, "attempt to pop beyond last irreversible block" );
@@ -166,31 +365,105 @@ struct controller_impl {
       }
       head = prev;
       db.undo();
+      hot_state.clear();
 
    }
 
 
+   /**
+    *  Faults the whole state database in, in one sequential pass, and locks it in memory so that block application
+    *  never waits on a page fault. The kernel still writes dirty pages back to the state file in the background.
+    */
+   /// a read replica has no fork database, its head is the one the node followed published
+   block_state_ptr fork_db_head()const {
+      return conf.read_replica_of.empty() ? fork_db.head() : head;
+   }
+
+   /// with the exclusive lock of the read replica segment held
+   void publish_replica_head() {
+      if( !head || head->id == published_replica_head )
+         return;
+      try {
+         read_replica->publish_head( chain_id, *head );
+         published_replica_head = head->id;
+      } FC_LOG_AND_DROP()
+   }
+
+   void apply_state_map_mode() {
+      if( conf.state_map_mode == db_map_mode::MAPPED ) return;
+
+      auto* segment = db.get_segment_manager();
+      const uintptr_t page_size = sysconf( _SC_PAGESIZE );
+      char* begin = reinterpret_cast<char*>( reinterpret_cast<uintptr_t>( segment ) & ~(page_size - 1) );
+      size_t size = reinterpret_cast<char*>( segment ) + segment->get_size() - begin;
+
+      if( conf.state_map_mode == db_map_mode::HUGEPAGES ) {
+#ifdef MADV_HUGEPAGE
+         // only honoured for mappings the kernel can back with huge pages, e.g. a state dir on tmpfs mounted with huge=always
+         if( madvise( begin, size, MADV_HUGEPAGE ) != 0 )
+            wlog( "unable to use huge pages for the chain state database: ${e}", ("e", strerror(errno)) );
+#else
+         EOS_THROW( database_exception, "huge pages for the chain state database are only supported on Linux" );
+#endif
+      }
+
+      ilog( "loading ${n} MiB of chain state database into memory", ("n", size / (1024 * 1024)) );
+      madvise( begin, size, MADV_WILLNEED );
+      EOS_ASSERT( mlock( begin, size ) == 0, database_exception,
+                  "unable to lock ${n} MiB of chain state database in memory: ${e}; raise the locked memory limit (ulimit -l) "
+                  "or use database-map-mode = mapped", ("n", size / (1024 * 1024))("e", strerror(errno)) );
+   }
+
    void set_apply_handler( account_name receiver, account_name contract, action_name action, apply_handler v ) {
       apply_handlers[receiver][make_pair(contract,action)] = v;
    }
 
    controller_impl( const controller::config& cfg, controller& s  )
    :self(s),
-    db( cfg.state_dir,
-        cfg.read_only ? database::read_only : database::read_write,
+    db( cfg.read_replica_of.empty() ? cfg.state_dir : cfg.read_replica_of,
+        cfg.read_only || !cfg.read_replica_of.empty() ? database::read_only : database::read_write,
         cfg.state_size ),
     reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.reversible_cache_size ),
     blog( cfg.blocks_dir ),
+    // a read replica does not apply transactions, and the rows of the node it follows move under it
+    hot_state( cfg.read_replica_of.empty() ? cfg.hot_state_cache_rows : 0 ),
+    dispatcher( cfg.signal_dispatch_threads, config::signal_dispatch_max_pending ),
     fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime ),
-    resource_limits( db ),
+    wasmif( cfg.wasm_runtime, wasm_cache_config{ cfg.wasm_cache_size, cfg.wasm_cache_max_entries, cfg.wasm_cache_pinned_accounts,
+                                         cfg.wasm_compile_threads, cfg.wasm_tier_up_threshold,
+                                         cfg.wasm_jit_fast_compile_size } ),
+    resource_limits( db, !cfg.read_replica_of.empty() ),
     authorization( s, db ),
     conf( cfg ),
     chain_id( cfg.genesis.compute_chain_id() ),
     read_mode( cfg.read_mode )
    {
+   if( !cfg.read_replica_of.empty() ) {
+      read_replica.reset( new read_replica_segment( cfg.read_replica_of, false ) );
+      std::shared_lock<read_replica_segment> g( *read_replica );
+      EOS_ASSERT( read_replica->revision() > 0, database_exception, "the node followed has not published a head yet" );
+      chain_id = read_replica->chain_id();
+   } else if( cfg.enable_read_replicas ) {
+      read_replica.reset( new read_replica_segment( cfg.state_dir, true ) );
+   }
+
+   apply_state_map_mode();
+   access_lists.build( conf );
+   signature_recovery_cache::instance().set_capacity( cfg.signature_recovery_cache_size );
+
+   if( cfg.profile_execution )
+      profiler.emplace();
+
+   if( cfg.signature_recovery_threads ) {
+      recovery_work.reset( new boost::asio::io_service::work( recovery_ios ) );
+      for( uint32_t i = 0; i < cfg.signature_recovery_threads; ++i )
+         recovery_threads.emplace_back( [this, i]() {
+            thread_registry::instance().register_current_thread( "chain-recovery-" + std::to_string( i ) );
+            recovery_ios.run();
+         } );
+   }
 
 #define SET_APP_HANDLER( receiver, contract, action) \
    set_apply_handler( #receiver, #contract, #action, &BOOST_PP_CAT(apply_, BOOST_PP_CAT(contract, BOOST_PP_CAT(_,action) ) ) )
@@ -269,7 +542,7 @@ struct controller_impl {
       db.commit( s->block_num );
 
       if( append_to_blog ) {
-         blog.append(s->block);
+         blog.append(s->block, *s->packed_block());
       }
 
       const auto& ubi = reversible_blocks.get_index<reversible_block_index,by_num>();
@@ -309,11 +582,36 @@ struct controller_impl {
       replay_head_time = blog_head_time;
       ilog( "existing block log, attempting to replay ${n} blocks", ("n",blog_head->block_num()) );
 
+      if( conf.trusted_replay_checksum ) {
+         auto checksum = block_log::checksum( conf.blocks_dir );
+         EOS_ASSERT( checksum == *conf.trusted_replay_checksum, block_log_exception,
+                     "block log checksum ${c} does not match the trusted replay checksum ${t}",
+                     ("c", checksum)("t", *conf.trusted_replay_checksum) );
+         ilog( "block log matches the trusted replay checksum, merkle roots of its blocks will not be recomputed" );
+         trusted_replay = true;
+      }
+      auto reset_trusted_replay = fc::make_scoped_exit([this]() {
+         trusted_replay = false;
+      });
+
+      // replayed blocks become irreversible as soon as they are applied, journaling them is wasted work
+      fork_db.pause_journal();
+
       auto start = fc::time_point::now();
+      auto last_report = start;
+      uint32_t last_report_num = head->block_num;
       while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
          self.push_block( next, controller::block_status::irreversible );
          if( next->block_num() % 100 == 0 ) {
             std::cerr << std::setw(10) << next->block_num() << " of " << blog_head->block_num() <<"\r";
+            auto now = fc::time_point::now();
+            if( now - last_report >= fc::seconds(60) ) {
+               ilog( "replayed ${n} of ${h} blocks, ${bps} blocks/s",
+                     ("n", next->block_num())("h", blog_head->block_num())
+                     ("bps", (next->block_num() - last_report_num) * 1000000 / (now - last_report).count()) );
+               last_report = now;
+               last_report_num = next->block_num();
+            }
          }
       }
       std::cerr<< "\n";
@@ -331,15 +629,19 @@ struct controller_impl {
       }
 
       ilog( "${n} reversible blocks replayed", ("n",rev) );
+      fork_db.resume_journal();
+
       auto end = fc::time_point::now();
-      ilog( "replayed ${n} blocks in ${duration} seconds, ${mspb} ms/block",
+      ilog( "replayed ${n} blocks in ${duration} seconds, ${mspb} ms/block, ${bps} blocks/s",
             ("n", head->block_num)("duration", (end-start).count()/1000000)
-            ("mspb", ((end-start).count()/1000.0)/head->block_num)        );
+            ("mspb", ((end-start).count()/1000.0)/head->block_num)
+            ("bps", head->block_num * 1000000.0 / std::max<int64_t>( (end-start).count(), 1 )) );
       replaying = false;
       replay_head_time.reset();
    }
 
    void init(const snapshot_reader_ptr& snapshot) {
+      check_state_layout( conf.state_dir, snapshot || !head );
 
       if (snapshot) {
          EOS_ASSERT(!head, fork_database_exception, "");
@@ -392,17 +694,116 @@ struct controller_impl {
          db.undo();
       }
 
+      known_trx_filter.clear();
+      for( const auto& t : db.get_index<transaction_multi_index,by_expiration>() )
+         known_trx_filter.add( t.trx_id, t.expiration );
+
+      // warm up the contracts that are kept permanently in the instantiation cache
+      for( const auto& name : conf.wasm_cache_pinned_accounts ) {
+         const auto* account = db.find<account_object,by_name>( name );
+         if( account && account->code.size() > 0 )
+            wasmif.precompile( account->code_version, account->code.data(), account->code.size() );
+      }
+      load_wasm_cache_manifest();
+
       ilog( "database initialized with hash: ${hash}", ("hash", calculate_integrity_hash()));
 
    }
 
    ~controller_impl() {
+      dispatcher.stop(); // the handlers still pending may read the blocks being torn down
+
+      for( auto& p : prevalidated_blocks )
+         p.second->wait();
+      prevalidated_blocks.clear();
+
+      recovery_work.reset();
+      recovery_ios.stop();
+      for( auto& t : recovery_threads )
+         t.join();
+
       pending.reset();
 
+      save_wasm_cache_manifest();
+
       db.flush();
       reversible_blocks.flush();
    }
 
+   /**
+    *  The compiled code itself cannot be kept across restarts: WAVM bakes the addresses of this process' memory,
+    *  tables and intrinsics into it. Instead the set of contracts that were in the instantiation cache is saved on
+    *  shutdown and recompiled on the background compile threads at startup, before the first actions need them.
+    */
+   void save_wasm_cache_manifest() {
+      if( conf.read_only ) return;
+      try {
+         auto manifest = conf.state_dir / config::wasm_cache_filename;
+         std::ofstream out( manifest.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+         fc::raw::pack( out, wasm_cache_manifest_version );
+         fc::raw::pack( out, static_cast<uint8_t>(conf.wasm_runtime) );
+         fc::raw::pack( out, wasmif.cached_code() );
+      } FC_LOG_AND_DROP()
+   }
+
+   /**
+    *  A state database written by a build laying out its objects differently would be misread, so the layout
+    *  version is saved next to it when it is created and a reopened state without the current one is refused.
+    */
+   void check_state_layout( const path& state_dir, bool created ) {
+      auto file = state_dir / config::state_layout_filename;
+      if( created ) {
+         if( conf.read_only ) return;
+         std::ofstream out( file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+         fc::raw::pack( out, state_layout_version );
+         EOS_ASSERT( out.good(), database_exception, "unable to write ${f}", ("f", file.generic_string()) );
+         return;
+      }
+
+      uint32_t version = 0;
+      if( fc::exists( file ) ) {
+         string content;
+         fc::read_file_contents( file, content );
+         fc::datastream<const char*> ds( content.data(), content.size() );
+         fc::raw::unpack( ds, version );
+      }
+      EOS_ASSERT( version == state_layout_version, database_exception,
+                  "state database in ${d} has layout version ${v} but this build requires ${r}, "
+                  "replay the blockchain or start from a snapshot",
+                  ("d", state_dir.generic_string())("v", version)("r", state_layout_version) );
+   }
+
+   void load_wasm_cache_manifest() {
+      auto manifest = conf.state_dir / config::wasm_cache_filename;
+      if( !fc::exists( manifest ) ) return;
+      try {
+         string content;
+         fc::read_file_contents( manifest, content );
+         fc::remove( manifest );
+
+         fc::datastream<const char*> ds( content.data(), content.size() );
+         uint32_t version = 0;
+         uint8_t  runtime = 0;
+         fc::raw::unpack( ds, version );
+         fc::raw::unpack( ds, runtime );
+         if( version != wasm_cache_manifest_version || runtime != static_cast<uint8_t>(conf.wasm_runtime) )
+            return;
+
+         vector<pair<account_name, digest_type>> code;
+         fc::raw::unpack( ds, code );
+         uint32_t queued = 0;
+         for( const auto& c : code ) {
+            // only code still installed on the account it last ran for is worth compiling
+            const auto* account = db.find<account_object,by_name>( c.first );
+            if( !account || account->code_version != c.second || account->code.size() == 0 )
+               continue;
+            wasmif.precompile( account->code_version, account->code.data(), account->code.size() );
+            ++queued;
+         }
+         ilog( "queued ${n} of ${t} previously cached contracts for compilation", ("n", queued)("t", code.size()) );
+      } FC_LOG_AND_DROP()
+   }
+
    void add_indices() {
       reversible_blocks.add_index<reversible_block_index>();
 
@@ -417,6 +818,7 @@ struct controller_impl {
       // Rewind the database to the last irreversible block
       db.with_write_lock([&] {
          db.undo_all();
+         hot_state.clear();
          /*
          FC_ASSERT(db.revision() == self.head_block_num(),
                    "Chainbase revision does not match head block num",
@@ -426,29 +828,48 @@ struct controller_impl {
    }
 
    void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section("contract_tables", [this]( auto& section ) {
-         index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
-            // add a row for the table
-            section.add_row(table_row, db);
-
-            // followed by a size row and then N data rows for each type of table
-            contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
-               using utils_t = decltype(utils);
-               using value_t = typename decltype(utils)::index_t::value_type;
-               using by_table_id = object_to_table_id_tag_t<value_t>;
-
-               auto tid_key = boost::make_tuple(table_row.id);
-               auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
-
-               unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
-               section.add_row(size, db);
-
-               utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
-                  section.add_row(row, db);
+      // the tables are written in parts that can be serialized in parallel, which make up a single section
+      const auto& tables = db.get_index<table_id_multi_index>().indices();
+      auto itr = tables.begin();
+      do {
+         optional<table_id_object::id_type> first;
+         if( itr != tables.end() )
+            first = itr->id;
+         for( uint32_t n = 0; n < config::snapshot_tables_per_part && itr != tables.end(); ++n )
+            ++itr;
+         optional<table_id_object::id_type> last;
+         if( itr != tables.end() )
+            last = itr->id;
+
+         snapshot->write_section("contract_tables", [this, first, last]( auto& section ) {
+            if( !first ) return;
+            const auto& tables = db.get_index<table_id_multi_index>().indices();
+            auto end = last ? tables.lower_bound( *last ) : tables.end();
+            for( auto table_itr = tables.lower_bound( *first ); table_itr != end; ++table_itr ) {
+               const auto& table_row = *table_itr;
+
+               // add a row for the table
+               section.add_row(table_row, db);
+
+               // followed by a size row and then N data rows for each type of table
+               contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
+                  using utils_t = decltype(utils);
+                  using value_t = typename decltype(utils)::index_t::value_type;
+                  using by_table_id = object_to_table_id_tag_t<value_t>;
+
+                  auto tid_key = boost::make_tuple(table_row.id);
+                  auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+
+                  unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
+                  section.add_row(size, db);
+
+                  utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
+                     section.add_row(row, db);
+                  });
                });
-            });
+            }
          });
-      });
+      } while( itr != tables.end() );
    }
 
    void read_contract_tables_from_snapshot( const snapshot_reader_ptr& snapshot ) {
@@ -481,37 +902,41 @@ struct controller_impl {
    }
 
    void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section<chain_snapshot_header>([this]( auto &section ){
-         section.add_row(chain_snapshot_header(), db);
-      });
+      // every section only reads the database, so all of them can be serialized at once
+      snapshot->write_sections( conf.snapshot_threads, [this, &snapshot]() {
+         snapshot->write_section<chain_snapshot_header>([this]( auto &section ){
+            section.add_row(chain_snapshot_header(), db);
+         });
 
-      snapshot->write_section<genesis_state>([this]( auto &section ){
-         section.add_row(conf.genesis, db);
-      });
+         snapshot->write_section<genesis_state>([this]( auto &section ){
+            section.add_row(conf.genesis, db);
+         });
 
-      snapshot->write_section<block_state>([this]( auto &section ){
-         section.template add_row<block_header_state>(*fork_db.head(), db);
-      });
+         snapshot->write_section<block_state>([this]( auto &section ){
+            section.template add_row<block_header_state>(*fork_db.head(), db);
+         });
 
-      controller_index_set::walk_indices([this, &snapshot]( auto utils ){
-         using value_t = typename decltype(utils)::index_t::value_type;
+         controller_index_set::walk_indices([this, &snapshot]( auto utils ){
+            using value_t = typename decltype(utils)::index_t::value_type;
 
-         // skip the table_id_object as its inlined with contract tables section
-         if (std::is_same<value_t, table_id_object>::value) {
-            return;
-         }
+            // skip the table_id_object as its inlined with contract tables section, and the payloads of the
+            // generated transactions which are inlined with theirs
+            if (std::is_same<value_t, table_id_object>::value || std::is_same<value_t, generated_transaction_payload_object>::value) {
+               return;
+            }
 
-         snapshot->write_section<value_t>([this]( auto& section ){
-            decltype(utils)::walk(db, [this, &section]( const auto &row ) {
-               section.add_row(row, db);
+            snapshot->write_section<value_t>([this]( auto& section ){
+               decltype(utils)::walk(db, [this, &section]( const auto &row ) {
+                  section.add_row(row, db);
+               });
             });
          });
-      });
 
-      add_contract_tables_to_snapshot(snapshot);
+         add_contract_tables_to_snapshot(snapshot);
 
-      authorization.add_to_snapshot(snapshot);
-      resource_limits.add_to_snapshot(snapshot);
+         authorization.add_to_snapshot(snapshot);
+         resource_limits.add_to_snapshot(snapshot);
+      });
    }
 
    void read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
@@ -534,28 +959,32 @@ struct controller_impl {
          snapshot_head_block = head->block_num;
       });
 
-      controller_index_set::walk_indices([this, &snapshot]( auto utils ){
-         using value_t = typename decltype(utils)::index_t::value_type;
+      // each of the remaining sections fills indices of its own, so they can be loaded at once
+      snapshot->read_sections( conf.snapshot_threads, [this, &snapshot]() {
+         controller_index_set::walk_indices([this, &snapshot]( auto utils ){
+            using value_t = typename decltype(utils)::index_t::value_type;
 
-         // skip the table_id_object as its inlined with contract tables section
-         if (std::is_same<value_t, table_id_object>::value) {
-            return;
-         }
-
-         snapshot->read_section<value_t>([this]( auto& section ) {
-            bool more = !section.empty();
-            while(more) {
-               decltype(utils)::create(db, [this, &section, &more]( auto &row ) {
-                  more = section.read_row(row, db);
-               });
+            // skip the table_id_object as its inlined with contract tables section, and the payloads of the
+            // generated transactions which are inlined with theirs
+            if (std::is_same<value_t, table_id_object>::value || std::is_same<value_t, generated_transaction_payload_object>::value) {
+               return;
             }
+
+            snapshot->read_section<value_t>([this]( auto& section ) {
+               bool more = !section.empty();
+               while(more) {
+                  decltype(utils)::create(db, [this, &section, &more]( auto &row ) {
+                     more = section.read_row(row, db);
+                  });
+               }
+            });
          });
-      });
 
-      read_contract_tables_from_snapshot(snapshot);
+         read_contract_tables_from_snapshot(snapshot);
 
-      authorization.read_from_snapshot(snapshot);
-      resource_limits.read_from_snapshot(snapshot);
+         authorization.read_from_snapshot(snapshot);
+         resource_limits.read_from_snapshot(snapshot);
+      });
 
       db.set_revision( head->block_num );
    }
@@ -696,8 +1125,11 @@ struct controller_impl {
          }
 
          emit( self.accepted_block, pending->_pending_block_state );
-         emit( self.accepted_block_with_action_digests,
-            std::make_shared<block_state_with_action_digests>(pending->_pending_block_state, pending->_action_digests) );
+         if( pending->_action_digests )
+            emit( self.accepted_block_with_action_digests,
+               std::make_shared<block_state_with_action_digests>(pending->_pending_block_state, pending->_action_digests) );
+         if( pending->_written_rows )
+            emit( self.accepted_block_state_deltas, make_state_deltas() );
       } catch (...) {
          // dont bother resetting pending, instead abort the block
          reset_pending_on_exit.cancel();
@@ -707,6 +1139,91 @@ struct controller_impl {
 
       // push the state for pending.
       pending->push();
+      update_undo_metrics();
+   }
+
+   /**
+    *  Accounts for what the undo states of the reversible blocks hold in the state database: a copy of every row a
+    *  revision modified or removed, as it was before, and the id of every row it created. A revision keeps one copy
+    *  of a row however often it is modified, so the copies grow with the rows touched per block times the blocks
+    *  that are not irreversible yet; a stalled last irreversible block shows here long before the state database
+    *  runs into its guard size.
+    */
+   void update_undo_metrics() {
+      auto& registry = metrics_registry::instance();
+      static auto& revisions = registry.gauge( "eosio_chain_undo_revisions", "revisions of the state database that can still be undone" );
+      static auto& modified = registry.gauge( "eosio_chain_undo_rows", "rows held by the undo states of the state database",
+                                              { {"kind", "modified"} } );
+      static auto& removed = registry.gauge( "eosio_chain_undo_rows", "rows held by the undo states of the state database",
+                                             { {"kind", "removed"} } );
+      static auto& created = registry.gauge( "eosio_chain_undo_rows", "rows held by the undo states of the state database",
+                                             { {"kind", "created"} } );
+      static auto& bytes = registry.gauge( "eosio_chain_undo_bytes",
+                                           "estimated bytes of the rows copied into the undo states, without their variable length fields" );
+
+      uint64_t revs = 0, mods = 0, rems = 0, news = 0, size = 0;
+      undo_accounted_index_set::walk_indices( [&]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         using value_t = typename index_t::value_type;
+         const auto& stack = db.get_index<index_t>().stack();
+         revs = std::max<uint64_t>( revs, stack.size() );
+         for( const auto& state : stack ) {
+            mods += state.old_values.size();
+            rems += state.removed_values.size();
+            news += state.new_ids.size();
+            size += ( state.old_values.size() + state.removed_values.size() ) * sizeof(value_t);
+         }
+      });
+      revisions.set( revs );
+      modified.set( mods );
+      removed.set( rems );
+      created.set( news );
+      bytes.set( size );
+   }
+
+   /// reads the tables and rows the pending block wrote back from the state it left
+   block_state_deltas_ptr make_state_deltas() {
+      auto& rows = *pending->_written_rows;
+      std::sort( rows.begin(), rows.end() );
+      rows.erase( std::unique( rows.begin(), rows.end() ), rows.end() );
+
+      auto deltas = std::make_shared<block_state_deltas>();
+      deltas->block_num = pending->_pending_block_state->block_num;
+      deltas->block_id  = pending->_pending_block_state->id;
+      deltas->rows.reserve( rows.size() );
+
+      const table_id_object* t = nullptr;
+      for( size_t i = 0; i < rows.size(); ++i ) {
+         const auto& k = rows[i];
+         if( i == 0 || k.code != rows[i-1].code || k.scope != rows[i-1].scope || k.table != rows[i-1].table ) {
+            t = db.find<table_id_object, by_code_scope_table>( boost::make_tuple( k.code, k.scope, k.table ) );
+            table_delta td;
+            td.code    = k.code;
+            td.scope   = k.scope;
+            td.table   = k.table;
+            td.present = t != nullptr;
+            if( t ) {
+               td.payer = t->payer;
+               td.count = t->count;
+            }
+            deltas->tables.emplace_back( std::move(td) );
+         }
+
+         table_row_delta rd;
+         rd.code        = k.code;
+         rd.scope       = k.scope;
+         rd.table       = k.table;
+         rd.primary_key = k.primary_key;
+         if( t ) {
+            if( const auto* kv = db.find<key_value_object, by_scope_primary>( boost::make_tuple( t->id, k.primary_key ) ) ) {
+               rd.present = true;
+               rd.payer   = kv->payer;
+               rd.value.assign( kv->value.begin(), kv->value.end() );
+            }
+         }
+         deltas->rows.emplace_back( std::move(rd) );
+      }
+      return deltas;
    }
 
    // The returned scoped_exit should not exceed the lifetime of the pending which existed when make_block_restore_point was called.
@@ -752,6 +1269,7 @@ struct controller_impl {
          trx_context.trace->action_traces.emplace_back();
          trx_context.dispatch_action( trx_context.trace->action_traces.back(), etrx.actions.back(), gtrx.sender );
          trx_context.finalize(); // Automatically rounds up network and CPU usage in trace and bills payers if successful
+         trx_context.record_phase_times();
 
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
@@ -765,6 +1283,7 @@ struct controller_impl {
          cpu_time_to_bill_us = trx_context.update_billed_cpu_time( fc::time_point::now() );
          trace->except = e;
          trace->except_ptr = std::current_exception();
+         trx_context.record_phase_times();
       }
       return trace;
    }
@@ -772,11 +1291,11 @@ struct controller_impl {
    void remove_scheduled_transaction( const generated_transaction_object& gto ) {
       resource_limits.add_pending_ram_usage(
          gto.payer,
-         -(config::billable_size_v<generated_transaction_object> + gto.packed_trx.size())
+         -(config::billable_size_v<generated_transaction_object> + gto.packed_trx_size)
       );
       // No need to verify_account_ram_usage since we are only reducing memory
 
-      db.remove( gto );
+      remove_generated_transaction( db, gto );
    }
 
    bool failure_is_subjective( const fc::exception& e ) const {
@@ -813,9 +1332,9 @@ struct controller_impl {
    { try {
       maybe_session undo_session;
       if ( !self.skip_db_sessions() )
-         undo_session = maybe_session(db);
+         undo_session = maybe_session(db, hot_state);
 
-      auto gtrx = generated_transaction(gto);
+      auto gtrx = generated_transaction(gto, db);
 
       // remove the generated transaction object after making a copy
       // this will ensure that anything which affects the GTO multi-index-container will not invalidate
@@ -838,7 +1357,7 @@ struct controller_impl {
 
       transaction_trace_ptr trace;
       if( gtrx.expiration < self.pending_block_time() ) {
-         trace = std::make_shared<transaction_trace>();
+         trace = make_transaction_trace();
          trace->id = gtrx.trx_id;
          trace->block_num = self.pending_block_state()->block_num;
          trace->block_time = self.pending_block_time();
@@ -868,6 +1387,7 @@ struct controller_impl {
          trx_context.init_for_deferred_trx( gtrx.published );
          trx_context.exec();
          trx_context.finalize(); // Automatically rounds up network and CPU usage in trace and bills payers if successful
+         trx_context.record_phase_times();
 
          auto restore = make_block_restore_point();
 
@@ -892,6 +1412,7 @@ struct controller_impl {
          trace->except = e;
          trace->except_ptr = std::current_exception();
          trace->elapsed = fc::time_point::now() - trx_context.start;
+         trx_context.record_phase_times();
       }
       trx_context.undo();
 
@@ -978,13 +1499,19 @@ struct controller_impl {
    transaction_trace_ptr push_transaction( const transaction_metadata_ptr& trx,
                                            fc::time_point deadline,
                                            uint32_t billed_cpu_time_us,
-                                           bool explicit_billed_cpu_time = false )
+                                           bool explicit_billed_cpu_time = false,
+                                           bool dry_run = false )
    {
       EOS_ASSERT(deadline != fc::time_point(), transaction_exception, "deadline cannot be uninitialized");
 
+      static auto& apply_time = metrics_registry::instance().histogram( "eosio_chain_transaction_apply_seconds",
+                                                                         "time to apply a transaction, including failed ones" );
+      scoped_metric_timer timer( apply_time );
+
       transaction_trace_ptr trace;
       try {
          transaction_context trx_context(self, trx->trx, trx->id);
+         trx_context.trx_meta = trx.get();
          if ((bool)subjective_cpu_leeway && pending->_block_status == controller::block_status::incomplete) {
             trx_context.leeway = *subjective_cpu_leeway;
          }
@@ -1012,6 +1539,7 @@ struct controller_impl {
             trx_context.delay = fc::seconds(trx->trx.delay_sec);
 
             if( !self.skip_auth_check() && !trx->implicit ) {
+               transaction_phase_timer::scope phase( trx_context.phase_timer(), transaction_phase::authorization );
                authorization.check_authorization(
                        trx->trx.actions,
                        trx->recover_keys( chain_id ),
@@ -1025,6 +1553,18 @@ struct controller_impl {
             }
             trx_context.exec();
             trx_context.finalize(); // Automatically rounds up network and CPU usage in trace and bills payers if successful
+            trx_context.record_phase_times();
+
+            if( dry_run ) {
+               // the receipt the transaction would get, without it or its writes ever reaching the pending block
+               transaction_receipt_header r;
+               r.status = (trx_context.delay == fc::seconds(0)) ? transaction_receipt::executed : transaction_receipt::delayed;
+               r.cpu_usage_us = trx_context.billed_cpu_time_us;
+               r.net_usage_words = trace->net_usage / 8;
+               trace->receipt = r;
+               trx_context.undo();
+               return trace;
+            }
 
             auto restore = make_block_restore_point();
 
@@ -1068,8 +1608,11 @@ struct controller_impl {
          } catch (const fc::exception& e) {
             trace->except = e;
             trace->except_ptr = std::current_exception();
+            trx_context.record_phase_times();
          }
 
+         if( dry_run ) return trace;
+
          if (!failure_is_subjective(*trace->except)) {
             unapplied_transactions.erase( trx->signed_id );
          }
@@ -1087,6 +1630,9 @@ struct controller_impl {
    {
       EOS_ASSERT( !pending, block_validate_exception, "pending block already exists" );
 
+      // finishing compiles instantiates WAVM modules, which no transaction should be billed for
+      wasmif.collect_compiles();
+
       auto guard_pending = fc::make_scoped_exit([this](){
          pending.reset();
       });
@@ -1095,13 +1641,15 @@ struct controller_impl {
          EOS_ASSERT( db.revision() == head->block_num, database_exception, "db revision is not on par with head block",
                      ("db.revision()", db.revision())("controller_head_block", head->block_num)("fork_db_head_block", fork_db.head()->block_num) );
 
-         pending.emplace(maybe_session(db));
+         pending.emplace(maybe_session(db, hot_state));
       } else {
          pending.emplace(maybe_session());
       }
 
       pending->_block_status = s;
       pending->_producer_block_id = producer_block_id;
+      if( !self.accepted_block_state_deltas.empty() )
+         pending->_written_rows.emplace();
       pending->_pending_block_state = std::make_shared<block_state>( *head, when ); // promotes pending schedule (if any) to active
       pending->_pending_block_state->in_current_chain = true;
 
@@ -1167,7 +1715,248 @@ struct controller_impl {
       static_cast<signed_block_header&>(*p->block) = p->header;
    } /// sign_block
 
+   /// input transactions of a block being unpacked and having their signing keys recovered on the recovery threads
+   struct prepared_block {
+      vector<transaction_metadata_ptr>  mtrxs;   ///< indexed like the block's receipts, null where not prepared
+      vector<std::future<void>>         done;
+      /// the header state of the block, validated on the recovery threads; not valid() until the block it builds on is
+      std::shared_future<block_state_ptr>  header;
+      uint64_t                          arrival = 0;   ///< order prevalidate_block received the block in
+
+      void wait() {
+         for( auto& f : done )
+            f.wait();
+         done.clear();
+      }
+   };
+   typedef std::shared_ptr<prepared_block> prepared_block_ptr;
+
+   /**
+    *  Blocks received from the network whose preparation was started before they reached push_block, so that it runs
+    *  while the blocks ahead of them are applied.
+    */
+   map<block_id_type, prepared_block_ptr>   prevalidated_blocks;
+   uint64_t                                 prevalidated_arrivals = 0;
+   /// prevalidated blocks whose headers wait for that of the block they build on, by the id of that block
+   std::multimap<block_id_type, signed_block_ptr>  unlinked_headers;
+
+   /**
+    *  The input transactions of the block that this node already executed speculatively, in the pending block or
+    *  before it was aborted, are taken unpacked and with their keys recovered from there: a node that does not
+    *  produce executes most transactions of a block before it receives the block. Identical packed bytes are the
+    *  same transaction, so only metadata is shared; the block is still applied from scratch, with the cpu usage that
+    *  its receipts bill. The speculative execution was accepted already, so accepted_transaction is not emitted for
+    *  it again, as for the transactions a producer puts in its own blocks.
+    */
+   void reuse_speculative_transactions( const signed_block_ptr& b, prepared_block& prepared ) {
+      const bool in_pending = pending && !pending->_pending_block_state->trxs.empty();
+      if( unapplied_transactions.empty() && !in_pending )
+         return;
+
+      map<digest_type, transaction_metadata_ptr> pending_trxs;
+      if( in_pending ) {
+         for( const auto& t : pending->_pending_block_state->trxs )
+            pending_trxs.emplace( t->signed_id, t );
+      }
+      for( size_t i = 0; i < b->transactions.size(); ++i ) {
+         if( !b->transactions[i].trx.contains<packed_transaction>() )
+            continue;
+         auto signed_id = digest_type::hash( b->transactions[i].trx.get<packed_transaction>() );
+         auto itr = unapplied_transactions.find( signed_id );
+         if( itr != unapplied_transactions.end() ) {
+            prepared.mtrxs[i] = itr->second;
+         } else if( ( itr = pending_trxs.find( signed_id ) ) != pending_trxs.end() ) {
+            prepared.mtrxs[i] = itr->second;
+         }
+      }
+   }
+
+   /**
+    *  Starts unpacking the input transactions of a block and recovering their signing keys on the recovery threads.
+    *  A transaction that fails here is left null and unpacked again in order by apply_block, where its error is
+    *  reported as before. The tasks work on copies of the packed transactions: unpacking one fills its caches, and
+    *  the block's own are read on this thread, by net_plugin among others, while a block that is not applied is
+    *  never waited for.
+    */
+   prepared_block_ptr start_block_preparation( const signed_block_ptr& b ) {
+      auto prepared = std::make_shared<prepared_block>();
+      prepared->mtrxs.resize( b->transactions.size() );
+      reuse_speculative_transactions( b, *prepared );
+      if( recovery_threads.empty() )
+         return prepared;
+
+      const bool recover = !self.skip_auth_check();
+      prepared->done.reserve( b->transactions.size() );
+      for( size_t i = 0; i < b->transactions.size(); ++i ) {
+         if( !b->transactions[i].trx.contains<packed_transaction>() || prepared->mtrxs[i] )
+            continue;
+         auto task = std::make_shared<std::packaged_task<void()>>(
+               [this, trx = b->transactions[i].trx.get<packed_transaction>(), i, recover, p = prepared.get()]() {
+            try {
+               auto mtrx = std::make_shared<transaction_metadata>( trx );
+               if( recover )
+                  mtrx->recover_keys( chain_id );
+               p->mtrxs[i] = std::move( mtrx );
+            } catch( ... ) {
+            }
+         });
+         prepared->done.emplace_back( task->get_future() );
+         recovery_ios.post( [task]() { (*task)(); } );
+      }
+      return prepared;
+   }
+
+   /**
+    *  Only blocks that can be applied within the next max_prevalidated_blocks are taken, and once there are that many
+    *  the one received first makes room; a peer sending blocks that are never applied cannot keep the others out.
+    */
+   void prevalidate_block( const signed_block_ptr& b ) {
+      if( recovery_threads.empty() )
+         return;
+      if( b->block_num() <= head->block_num || b->block_num() > head->block_num + config::max_prevalidated_blocks )
+         return;
+      auto id = b->id();
+      if( prevalidated_blocks.count( id ) )
+         return;
+      if( prevalidated_blocks.size() >= config::max_prevalidated_blocks ) {
+         auto oldest = std::min_element( prevalidated_blocks.begin(), prevalidated_blocks.end(), []( const auto& l, const auto& r ) {
+            return l.second->arrival < r.second->arrival;
+         });
+         oldest->second->wait(); // its tasks reference it
+         prevalidated_blocks.erase( oldest );
+      }
+      auto& prepared = prevalidated_blocks.emplace( id, start_block_preparation( b ) ).first->second;
+      prepared->arrival = prevalidated_arrivals++;
+      start_header_validation( b, *prepared );
+   }
+
+   /**
+    *  Validates the header of a block ahead of head on the recovery threads, as fork_db.add would when it is pushed:
+    *  its producer, schedule and signature through block_header_state::next, and its transaction_mroot against its
+    *  receipts. A header is validated once the header state of the block it builds on is known, so the headers of the
+    *  blocks received ahead of the next one to apply are chained as they arrive, and validated while the blocks before
+    *  them are applied. Blocks received before the one they build on wait in unlinked_headers.
+    */
+   void start_header_validation( const signed_block_ptr& first, prepared_block& first_prepared ) {
+      vector<std::pair<signed_block_ptr, prepared_block*>> linked{ { first, &first_prepared } };
+      while( !linked.empty() ) {
+         auto b = linked.back().first;
+         auto& prepared = *linked.back().second;
+         linked.pop_back();
+
+         std::shared_future<block_state_ptr> prev;
+         auto itr = prevalidated_blocks.find( b->previous );
+         if( itr != prevalidated_blocks.end() && itr->second->header.valid() ) {
+            prev = itr->second->header;
+         } else if( auto prev_state = fork_db.get_block( b->previous ) ) {
+            std::promise<block_state_ptr> known;
+            known.set_value( prev_state );
+            prev = known.get_future().share();
+         } else {
+            unlinked_headers.emplace( b->previous, b );
+            continue;
+         }
+
+         // tasks run in the order they are posted, so the one of the block built on is running or done by then
+         auto task = std::make_shared<std::packaged_task<block_state_ptr()>>( [b, prev]() {
+            auto result = std::make_shared<block_state>( *prev.get(), b, false );
+            vector<digest_type> trx_digests;
+            trx_digests.reserve( b->transactions.size() );
+            for( const auto& r : b->transactions )
+               trx_digests.emplace_back( r.digest() );
+            EOS_ASSERT( merkle( move(trx_digests) ) == b->transaction_mroot, block_validate_exception,
+                        "transaction_mroot does not match the receipts of block ${id}", ("id", result->id) );
+            return result;
+         });
+         prepared.header = task->get_future().share();
+         recovery_ios.post( [task]() { (*task)(); } );
+
+         auto id = b->id();
+         auto waiting = unlinked_headers.equal_range( id );
+         for( auto w = waiting.first; w != waiting.second; ++w ) {
+            auto next = prevalidated_blocks.find( w->second->id() );
+            if( next != prevalidated_blocks.end() )
+               linked.emplace_back( w->second, next->second.get() );
+         }
+         unlinked_headers.erase( waiting.first, waiting.second );
+      }
+   }
+
+   /**
+    *  The header state prevalidate_block validated for a block, null if it did not. A block that failed there, or
+    *  builds on one that did, is dropped and validated again as it is pushed, so that a peer sending a bad body does
+    *  not get the block rejected when another peer sends it right.
+    */
+   block_state_ptr prevalidated_header( const block_id_type& id ) {
+      auto itr = prevalidated_blocks.find( id );
+      if( itr == prevalidated_blocks.end() || !itr->second->header.valid() )
+         return block_state_ptr();
+      try {
+         return itr->second->header.get();
+      } catch( ... ) {
+         itr->second->wait();
+         prevalidated_blocks.erase( itr );
+         return block_state_ptr();
+      }
+   }
+
+   /// prepared input transactions of a block, reusing the work of prevalidate_block when it saw the block
+   vector<transaction_metadata_ptr> prepare_block_transactions( const signed_block_ptr& b, const block_id_type& id ) {
+      prepared_block_ptr prepared;
+      auto itr = prevalidated_blocks.find( id );
+      if( itr != prevalidated_blocks.end() ) {
+         prepared = std::move( itr->second );
+         prevalidated_blocks.erase( itr );
+      } else {
+         prepared = start_block_preparation( b );
+      }
+      prepared->wait();
+      return std::move( prepared->mtrxs );
+   }
+
+   /// drops prepared blocks that can no longer be applied; their tasks are waited for since they reference them
+   void prune_prevalidated_blocks() {
+      for( auto itr = prevalidated_blocks.begin(); itr != prevalidated_blocks.end(); ) {
+         if( block_header::num_from_id( itr->first ) <= head->block_num ) {
+            itr->second->wait();
+            itr = prevalidated_blocks.erase( itr );
+         } else {
+            ++itr;
+         }
+      }
+      for( auto itr = unlinked_headers.begin(); itr != unlinked_headers.end(); ) {
+         if( itr->second->block_num() <= head->block_num )
+            itr = unlinked_headers.erase( itr );
+         else
+            ++itr;
+      }
+   }
+
+   /**
+    *  Starts compiling on the background compile threads the contracts that the input transactions of a block call
+    *  and that are not in the instantiation cache yet, so that the contracts of later transactions compile while
+    *  the earlier ones execute. Deferred transactions are left alone; unpacking them here would only be repeated
+    *  when they are applied.
+    */
+   void prefetch_block( const signed_block_ptr& b, const vector<transaction_metadata_ptr>& mtrxs ) {
+      flat_set<account_name> accounts;
+      for( size_t i = 0; i < b->transactions.size() && i < mtrxs.size(); ++i ) {
+         if( !mtrxs[i] ) continue;
+         for( const auto& act : mtrxs[i]->trx.actions )
+            accounts.insert( act.account );
+      }
+
+      for( const auto& name : accounts ) {
+         const auto* account = db.find<account_object,by_name>( name );
+         if( account && account->code.size() > 0 )
+            wasmif.precompile( account->code_version, account->code.data(), account->code.size() );
+      }
+   }
+
    void apply_block( const signed_block_ptr& b, controller::block_status s ) { try {
+      static auto& apply_time = metrics_registry::instance().histogram( "eosio_chain_block_apply_seconds",
+                                                                         "time to apply a block received from the network or replayed" );
+      scoped_metric_timer timer( apply_time );
       try {
          EOS_ASSERT( b->block_extensions.size() == 0, block_validate_exception, "no supported extensions" );
          auto producer_block_id = b->id();
@@ -1175,11 +1964,23 @@ struct controller_impl {
 
          transaction_trace_ptr trace;
 
-         for( const auto& receipt : b->transactions ) {
+         auto mtrxs = prepare_block_transactions( b, producer_block_id );
+         try {
+            prefetch_block( b, mtrxs );
+         } FC_LOG_AND_DROP()
+
+         for( size_t i = 0; i < b->transactions.size(); ++i ) {
+            const auto& receipt = b->transactions[i];
             auto num_pending_receipts = pending->_pending_block_state->block->transactions.size();
             if( receipt.trx.contains<packed_transaction>() ) {
                auto& pt = receipt.trx.get<packed_transaction>();
-               auto mtrx = std::make_shared<transaction_metadata>(pt);
+               auto mtrx = mtrxs[i] ? mtrxs[i] : std::make_shared<transaction_metadata>(pt);
+               // the block's undo session already rolls back a failed input transaction along with the whole block,
+               // so it runs without a session of its own and has nothing to squash when it succeeds
+               auto reset_in_block_input_trx = fc::make_scoped_exit([old_value=in_block_input_trx,this](){
+                  in_block_input_trx = old_value;
+               });
+               in_block_input_trx = true;
                trace = push_transaction( mtrx, fc::time_point::maximum(), receipt.cpu_usage_us, true );
             } else if( receipt.trx.contains<transaction_id_type>() ) {
                trace = push_scheduled_transaction( receipt.trx.get<transaction_id_type>(), fc::time_point::maximum(), receipt.cpu_usage_us, true );
@@ -1208,7 +2009,15 @@ struct controller_impl {
                         ("producer_receipt", receipt)("validator_receipt", pending->_pending_block_state->block->transactions.back()) );
          }
 
-         finalize_block();
+         // a block log that matched the trusted replay checksum is the one this node applied before, so the
+         // roots it carries are the ones the receipts and actions above would produce
+         const bool trusted_roots = trusted_replay && s == controller::block_status::irreversible
+                                    && self.accepted_block_with_action_digests.empty();
+         if( trusted_roots ) {
+            pending->_pending_block_state->header.action_mroot = b->action_mroot;
+            pending->_pending_block_state->header.transaction_mroot = b->transaction_mroot;
+         }
+         finalize_block( !trusted_roots );
 
          // this implicitly asserts that all header fields (less the signature) are identical
          EOS_ASSERT(producer_block_id == pending->_pending_block_state->header.id(),
@@ -1246,7 +2055,16 @@ struct controller_impl {
          EOS_ASSERT( s != controller::block_status::incomplete, block_validate_exception, "invalid block status for a completed block" );
          emit( self.pre_accepted_block, b );
          bool trust = !conf.force_all_checks && (s == controller::block_status::irreversible || s == controller::block_status::validated);
-         auto new_header_state = fork_db.add( b, trust );
+         block_state_ptr new_header_state;
+         auto id = b->id();
+         if( auto validated = prevalidated_header( id ) ) {
+            EOS_ASSERT( !fork_db.get_block( id ), fork_database_exception, "we already know about this block" );
+            EOS_ASSERT( fork_db.get_block( b->previous ), unlinkable_block_exception, "unlinkable block",
+                        ("id", string(id))("previous", string(b->previous)) );
+            new_header_state = fork_db.add( validated );
+         } else {
+            new_header_state = fork_db.add( b, trust );
+         }
          if (conf.trusted_producers.count(b->producer)) {
             trusted_producer_light_validation = true;
          };
@@ -1260,6 +2078,9 @@ struct controller_impl {
          if( s == controller::block_status::irreversible )
             emit( self.irreversible_block, new_header_state );
 
+         if( !prevalidated_blocks.empty() )
+            prune_prevalidated_blocks();
+
       } FC_LOG_AND_RETHROW( )
    }
 
@@ -1351,29 +2172,83 @@ struct controller_impl {
       return false;
    }
 
+   /**
+    *  Calls f(i) for every i < n, in chunks shared between this thread and the recovery threads. Chunks are claimed
+    *  as they go, so this thread never waits behind block preparations queued on the recovery threads: it works
+    *  through whatever is left itself and then only waits for the chunks already being worked on.
+    */
+   template<typename F>
+   void parallel_for( size_t n, F&& f ) {
+      static const size_t chunk_size = 256;
+      const size_t chunks = (n + chunk_size - 1) / chunk_size;
+      if( recovery_threads.empty() || chunks < 2 ) {
+         for( size_t i = 0; i < n; ++i )
+            f( i );
+         return;
+      }
+
+      struct shared_state {
+         std::atomic<size_t> next{0};
+         std::atomic<size_t> remaining{0};
+         std::atomic<bool>   failed{false};
+         std::mutex          error_mtx;
+         std::exception_ptr  error; // the first one thrown by f, rethrown on this thread
+      };
+      auto state = std::make_shared<shared_state>();
+      state->remaining = chunks;
+      // a helper that starts after all chunks were claimed returns without touching f, and once f threw the
+      // chunks still claimed are only counted off
+      auto work = [state, chunks, n, &f]() {
+         for( size_t c = state->next++; c < chunks; c = state->next++ ) {
+            if( !state->failed.load() ) {
+               try {
+                  for( size_t i = c * chunk_size, end = std::min( n, i + chunk_size ); i < end; ++i )
+                     f( i );
+               } catch( ... ) {
+                  std::lock_guard<std::mutex> g( state->error_mtx );
+                  if( !state->error )
+                     state->error = std::current_exception();
+                  state->failed = true;
+               }
+            }
+            --state->remaining;
+         }
+      };
+      const size_t helpers = std::min( recovery_threads.size(), chunks - 1 );
+      for( size_t h = 0; h < helpers; ++h )
+         recovery_ios.post( work );
+      work();
+      while( state->remaining.load() )
+         std::this_thread::yield();
+      if( state->error )
+         std::rethrow_exception( state->error );
+   }
+
    void set_action_merkle() {
-      vector<digest_type> action_digests;
-      action_digests.reserve( pending->_actions.size() );
-      for( const auto& a : pending->_actions )
-         action_digests.emplace_back( a.digest() );
+      const auto& actions = pending->_actions;
+      vector<digest_type> action_digests( actions.size() );
+      parallel_for( actions.size(), [&]( size_t i ) {
+         action_digests[i] = actions[i].digest();
+      });
 
-      pending->_action_digests = action_digests;
+      if( !self.accepted_block_with_action_digests.empty() )
+         pending->_action_digests = std::make_shared<const vector<digest_type>>( action_digests );
 
       pending->_pending_block_state->header.action_mroot = merkle( move(action_digests) );
    }
 
    void set_trx_merkle() {
-      vector<digest_type> trx_digests;
       const auto& trxs = pending->_pending_block_state->block->transactions;
-      trx_digests.reserve( trxs.size() );
-      for( const auto& a : trxs )
-         trx_digests.emplace_back( a.digest() );
+      vector<digest_type> trx_digests( trxs.size() );
+      parallel_for( trxs.size(), [&]( size_t i ) {
+         trx_digests[i] = trxs[i].digest();
+      });
 
       pending->_pending_block_state->header.transaction_mroot = merkle( move(trx_digests) );
    }
 
 
-   void finalize_block()
+   void finalize_block( bool compute_merkle_roots = true )
    {
       EOS_ASSERT(pending, block_validate_exception, "it is not valid to finalize when there is no pending block");
       try {
@@ -1404,8 +2279,10 @@ struct controller_impl {
       );
       resource_limits.process_block_usage(pending->_pending_block_state->block_num);
 
-      set_action_merkle();
-      set_trx_merkle();
+      if( compute_merkle_roots ) {
+         set_action_merkle();
+         set_trx_merkle();
+      }
 
       auto p = pending->_pending_block_state;
       p->id = p->header.id();
@@ -1459,6 +2336,11 @@ struct controller_impl {
    }
 
 
+   /**
+    *  The deduplication records stay one object per transaction rather than one bucket per expiration second: a
+    *  record is found by id alone (is_known_unexpired_transaction), and a bucket would be modified by every
+    *  transaction of its second, each copying it whole into the undo state of its session.
+    */
    void clear_expired_input_transactions() {
       //Look for expired transactions in the deduplication list, and remove them.
       auto& transaction_idx = db.get_mutable_index<transaction_multi_index>();
@@ -1467,27 +2349,28 @@ struct controller_impl {
       while( (!dedupe_index.empty()) && ( now > fc::time_point(dedupe_index.begin()->expiration) ) ) {
          transaction_idx.remove(*dedupe_index.begin());
       }
+      // an undo can bring removed records back, for a block or two
+      known_trx_filter.drop_expired( fc::time_point_sec( now ) - transaction_id_filter::span_seconds );
    }
 
 
    void check_actor_list( const flat_set<account_name>& actors )const {
       if( conf.actor_whitelist.size() > 0 ) {
          vector<account_name> excluded;
-         excluded.reserve( actors.size() );
-         set_difference( actors.begin(), actors.end(),
-                         conf.actor_whitelist.begin(), conf.actor_whitelist.end(),
-                         std::back_inserter(excluded) );
+         for( const auto& a : actors ) {
+            if( !access_lists.actor_whitelist.count( a.value ) )
+               excluded.push_back( a );
+         }
          EOS_ASSERT( excluded.size() == 0, actor_whitelist_exception,
                      "authorizing actor(s) in transaction are not on the actor whitelist: ${actors}",
                      ("actors", excluded)
                    );
       } else if( conf.actor_blacklist.size() > 0 ) {
          vector<account_name> blacklisted;
-         blacklisted.reserve( actors.size() );
-         set_intersection( actors.begin(), actors.end(),
-                           conf.actor_blacklist.begin(), conf.actor_blacklist.end(),
-                           std::back_inserter(blacklisted)
-                         );
+         for( const auto& a : actors ) {
+            if( access_lists.actor_blacklist.count( a.value ) )
+               blacklisted.push_back( a );
+         }
          EOS_ASSERT( blacklisted.size() == 0, actor_blacklist_exception,
                      "authorizing actor(s) in transaction are on the actor blacklist: ${actors}",
                      ("actors", blacklisted)
@@ -1497,12 +2380,12 @@ struct controller_impl {
 
    void check_contract_list( account_name code )const {
       if( conf.contract_whitelist.size() > 0 ) {
-         EOS_ASSERT( conf.contract_whitelist.find( code ) != conf.contract_whitelist.end(),
+         EOS_ASSERT( access_lists.contract_whitelist.count( code.value ),
                      contract_whitelist_exception,
                      "account '${code}' is not on the contract whitelist", ("code", code)
                    );
       } else if( conf.contract_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.contract_blacklist.find( code ) == conf.contract_blacklist.end(),
+         EOS_ASSERT( !access_lists.contract_blacklist.count( code.value ),
                      contract_blacklist_exception,
                      "account '${code}' is on the contract blacklist", ("code", code)
                    );
@@ -1511,7 +2394,7 @@ struct controller_impl {
 
    void check_action_list( account_name code, action_name action )const {
       if( conf.action_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.action_blacklist.find( std::make_pair(code, action) ) == conf.action_blacklist.end(),
+         EOS_ASSERT( !access_lists.action_blacklist.count( std::make_pair( code.value, action.value ) ),
                      action_blacklist_exception,
                      "action '${code}::${action}' is on the action blacklist",
                      ("code", code)("action", action)
@@ -1521,7 +2404,7 @@ struct controller_impl {
 
    void check_key_list( const public_key_type& key )const {
       if( conf.key_blacklist.size() > 0 ) {
-         EOS_ASSERT( conf.key_blacklist.find( key ) == conf.key_blacklist.end(),
+         EOS_ASSERT( !access_lists.key_blacklist.count( hashed_access_lists::key_of( key ) ),
                      key_blacklist_exception,
                      "public key '${key}' is on the key blacklist",
                      ("key", key)
@@ -1566,6 +2449,31 @@ struct controller_impl {
 
 }; /// controller_impl
 
+/**
+ *  Held by the public methods that change the chain state, so that read replicas never read it half changed, and
+ *  publishes the head to them once the outermost one returns; a read replica refuses the change instead.
+ */
+class read_replica_write_lock {
+   public:
+      explicit read_replica_write_lock( controller_impl& impl ):my(impl) {
+         EOS_ASSERT( my.conf.read_replica_of.empty(), database_exception, "a read replica does not change the chain state" );
+         if( my.read_replica && my.read_replica_write_depth++ == 0 )
+            lock = std::unique_lock<read_replica_segment>( *my.read_replica );
+      }
+
+      ~read_replica_write_lock() {
+         if( !my.read_replica )
+            return;
+         if( lock )
+            my.publish_replica_head();
+         --my.read_replica_write_depth;
+      }
+
+   private:
+      controller_impl&                        my;
+      std::unique_lock<read_replica_segment>  lock;
+};
+
 const resource_limits_manager&   controller::get_resource_limits_manager()const
 {
    return my->resource_limits;
@@ -1575,6 +2483,16 @@ resource_limits_manager&         controller::get_mutable_resource_limits_manager
    return my->resource_limits;
 }
 
+hot_state_cache& controller::get_mutable_hot_state_cache()
+{
+   return my->hot_state;
+}
+
+signal_dispatcher& controller::get_signal_dispatcher()
+{
+   return my->dispatcher;
+}
+
 const authorization_manager&   controller::get_authorization_manager()const
 {
    return my->authorization;
@@ -1602,12 +2520,23 @@ void controller::add_indices() {
 }
 
 void controller::startup( const snapshot_reader_ptr& snapshot ) {
+   if( get_read_replica() ) {
+      EOS_ASSERT( !snapshot, database_exception, "a read replica cannot start from a snapshot" );
+      my->check_state_layout( my->conf.read_replica_of, false );
+      follow_read_replica_head();
+      std::shared_lock<read_replica_segment> g( *my->read_replica );
+      core_symbol(symbol(get_core_symbol().core_symbol).name());
+      ilog( "following the chain state in ${d} as a read replica", ("d", my->conf.read_replica_of.generic_string()) );
+      return;
+   }
+
    my->head = my->fork_db.head();
    if( !my->head ) {
       elog( "No head block in fork db, perhaps we need to replay" );
    }
    my->init(snapshot);
    core_symbol(symbol(get_core_symbol().core_symbol).name());
+   read_replica_write_lock g( *my ); // publishes the head
 }
 
 const chainbase::database& controller::db()const { return my->db; }
@@ -1618,49 +2547,69 @@ const fork_database& controller::fork_db()const { return my->fork_db; }
 
 
 void controller::start_block( block_timestamp_type when, uint16_t confirm_block_count) {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    my->start_block(when, confirm_block_count, block_status::incomplete, optional<block_id_type>() );
 }
 
 void controller::finalize_block() {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    my->finalize_block();
 }
 
 void controller::sign_block( const std::function<signature_type( const digest_type& )>& signer_callback ) {
+   read_replica_write_lock g( *my );
    my->sign_block( signer_callback );
 }
 
 void controller::commit_block() {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    validate_reversible_available_size();
    my->commit_block(true);
 }
 
 void controller::abort_block() {
+   read_replica_write_lock g( *my );
    my->abort_block();
 }
 
 void controller::push_block( const signed_block_ptr& b, block_status s ) {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    validate_reversible_available_size();
    my->push_block( b, s );
 }
 
+void controller::prevalidate_block( const signed_block_ptr& b ) {
+   my->prevalidate_block( b );
+}
+
 void controller::push_confirmation( const header_confirmation& c ) {
    validate_db_available_size();
    my->push_confirmation( c );
 }
 
 transaction_trace_ptr controller::push_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline, uint32_t billed_cpu_time_us ) {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    EOS_ASSERT( get_read_mode() != chain::db_read_mode::READ_ONLY, transaction_type_exception, "push transaction not allowed in read-only mode" );
    EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
    return my->push_transaction(trx, deadline, billed_cpu_time_us, billed_cpu_time_us > 0 );
 }
 
+transaction_trace_ptr controller::dry_run_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline ) {
+   read_replica_write_lock g( *my );
+   EOS_ASSERT( my->pending && my->pending->_block_status == block_status::incomplete, block_validate_exception,
+               "a transaction can only be dry run on top of a speculative pending block" );
+   EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
+   return my->push_transaction(trx, deadline, 0, false, true );
+}
+
 transaction_trace_ptr controller::push_scheduled_transaction( const transaction_id_type& trxid, fc::time_point deadline, uint32_t billed_cpu_time_us )
 {
+   read_replica_write_lock g( *my );
    validate_db_available_size();
    return my->push_scheduled_transaction( trxid, deadline, billed_cpu_time_us, billed_cpu_time_us > 0 );
 }
@@ -1686,15 +2635,19 @@ const flat_set<public_key_type>& controller::get_key_blacklist() const {
 
 void controller::set_actor_whitelist( const flat_set<account_name>& new_actor_whitelist ) {
    my->conf.actor_whitelist = new_actor_whitelist;
+   my->access_lists.build( my->conf );
 }
 void controller::set_actor_blacklist( const flat_set<account_name>& new_actor_blacklist ) {
    my->conf.actor_blacklist = new_actor_blacklist;
+   my->access_lists.build( my->conf );
 }
 void controller::set_contract_whitelist( const flat_set<account_name>& new_contract_whitelist ) {
    my->conf.contract_whitelist = new_contract_whitelist;
+   my->access_lists.build( my->conf );
 }
 void controller::set_contract_blacklist( const flat_set<account_name>& new_contract_blacklist ) {
    my->conf.contract_blacklist = new_contract_blacklist;
+   my->access_lists.build( my->conf );
 }
 void controller::set_action_blacklist( const flat_set< pair<account_name, action_name> >& new_action_blacklist ) {
    for (auto& act: new_action_blacklist) {
@@ -1702,9 +2655,11 @@ void controller::set_action_blacklist( const flat_set< pair<account_name, action
       EOS_ASSERT(act.second != action_name(), action_type_exception, "Action blacklist - action name should not be empty");
    }
    my->conf.action_blacklist = new_action_blacklist;
+   my->access_lists.build( my->conf );
 }
 void controller::set_key_blacklist( const flat_set<public_key_type>& new_key_blacklist ) {
    my->conf.key_blacklist = new_key_blacklist;
+   my->access_lists.build( my->conf );
 }
 
 uint32_t controller::head_block_num()const {
@@ -1727,19 +2682,19 @@ block_state_ptr controller::head_block_state()const {
 }
 
 uint32_t controller::fork_db_head_block_num()const {
-   return my->fork_db.head()->block_num;
+   return my->fork_db_head()->block_num;
 }
 
 block_id_type controller::fork_db_head_block_id()const {
-   return my->fork_db.head()->id;
+   return my->fork_db_head()->id;
 }
 
 time_point controller::fork_db_head_block_time()const {
-   return my->fork_db.head()->header.timestamp;
+   return my->fork_db_head()->header.timestamp;
 }
 
 account_name  controller::fork_db_head_block_producer()const {
-   return my->fork_db.head()->header.producer;
+   return my->fork_db_head()->header.producer;
 }
 
 block_state_ptr controller::pending_block_state()const {
@@ -1810,17 +2765,24 @@ block_state_ptr controller::fetch_block_state_by_number( uint32_t block_num )con
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
 block_id_type controller::get_block_id_for_num( uint32_t block_num )const { try {
+   // the tapos summaries keep the ids of the last 65536 blocks of the current chain, the pending one aside
+   if( block_num <= head_block_num() ) {
+      const auto* summary = my->db.find<block_summary_object>( (uint16_t)block_num );
+      if( summary && block_header::num_from_id( summary->block_id ) == block_num )
+         return summary->block_id;
+   }
+
    auto blk_state = my->fork_db.get_block_in_current_chain_by_num( block_num );
    if( blk_state ) {
       return blk_state->id;
    }
 
-   auto signed_blk = my->blog.read_block_by_num(block_num);
+   auto id = my->blog.read_block_id_by_num(block_num);
 
-   EOS_ASSERT( BOOST_LIKELY( signed_blk != nullptr ), unknown_block_exception,
+   EOS_ASSERT( BOOST_LIKELY( id != block_id_type() ), unknown_block_exception,
                "Could not find block: ${block}", ("block", block_num) );
 
-   return signed_blk->id();
+   return id;
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
 sha256 controller::calculate_integrity_hash()const { try {
@@ -1833,6 +2795,7 @@ void controller::write_snapshot( const snapshot_writer_ptr& snapshot ) const {
 }
 
 void controller::pop_block() {
+   read_replica_write_lock g( *my );
    my->pop_block();
 }
 
@@ -1931,7 +2894,7 @@ bool controller::skip_db_sessions( block_status bs ) const {
 
 bool controller::skip_db_sessions( ) const {
    if (my->pending) {
-      return skip_db_sessions(my->pending->_block_status);
+      return my->in_block_input_trx || skip_db_sessions(my->pending->_block_status);
    } else {
       return false;
    }
@@ -1945,6 +2908,14 @@ bool controller::contracts_console()const {
    return my->conf.contracts_console;
 }
 
+execution_profiler* controller::get_execution_profiler() {
+   return my->profiler ? &*my->profiler : nullptr;
+}
+
+bool controller::profiles_transaction_phases()const {
+   return my->conf.profile_transaction_phases;
+}
+
 chain_id_type controller::get_chain_id()const {
    return my->chain_id;
 }
@@ -2013,6 +2984,25 @@ vector<transaction_id_type> controller::get_scheduled_transactions() const {
    return result;
 }
 
+vector<transaction_id_type> controller::get_scheduled_transactions( size_t max, scheduled_transactions_cursor& cursor,
+                                                                    const std::function<bool(const transaction_id_type&)>& skip ) const {
+   const auto& idx = db().get_index<generated_transaction_multi_index,by_delay>();
+
+   vector<transaction_id_type> result;
+   result.reserve(std::min(idx.size(), max));
+
+   const auto pbt = pending_block_time();
+   auto itr = idx.lower_bound( boost::make_tuple( cursor.delay_until, generated_transaction_object::id_type( cursor.id ) ) );
+   for( ; itr != idx.end() && itr->delay_until <= pbt && result.size() < max; ++itr ) {
+      // (delay_until, id) is unique, so the key right after this one is the same time with the next id
+      cursor.delay_until = itr->delay_until;
+      cursor.id = itr->id._id + 1;
+      if( !skip || !skip(itr->trx_id) )
+         result.emplace_back(itr->trx_id);
+   }
+   return result;
+}
+
 void controller::check_contract_list( account_name code )const {
    my->check_contract_list( code );
 }
@@ -2025,6 +3015,10 @@ void controller::check_key_list( const public_key_type& key )const {
    my->check_key_list( key );
 }
 
+bool controller::checks_contract_lists()const {
+   return my->access_lists.checks_actions();
+}
+
 bool controller::is_producing_block()const {
    if( !my->pending ) return false;
 
@@ -2099,13 +3093,47 @@ void controller::validate_reversible_available_size() const {
 }
 
 bool controller::is_known_unexpired_transaction( const transaction_id_type& id) const {
+   if( !my->known_trx_filter.may_contain( id ) )
+      return false;
    return db().find<transaction_object, by_trx_id>(id);
 }
 
+void controller::add_known_transaction( const transaction_id_type& id, fc::time_point_sec expire ) {
+   my->known_trx_filter.add( id, expire );
+}
+
+void controller::record_written_row( const table_id_object& table, uint64_t primary_key ) {
+   if( my->pending && my->pending->_written_rows )
+      my->pending->_written_rows->push_back( table_row_key{ table.code, table.scope, table.table, primary_key } );
+}
+
 void controller::set_subjective_cpu_leeway(fc::microseconds leeway) {
    my->subjective_cpu_leeway = leeway;
 }
 
+read_replica_segment* controller::get_read_replica()const {
+   return my->conf.read_replica_of.empty() ? nullptr : my->read_replica.get();
+}
+
+bool controller::follow_read_replica_head() {
+   EOS_ASSERT( get_read_replica(), database_exception, "not a read replica" );
+   std::shared_lock<read_replica_segment> g( *my->read_replica );
+   auto revision = my->read_replica->revision();
+   if( revision == my->followed_replica_revision )
+      return false;
+   my->head = std::make_shared<block_state>( my->read_replica->head() );
+   my->followed_replica_revision = revision;
+   return true;
+}
+
+void controller::set_trim_action_traces( bool trim ) {
+   my->trim_action_traces = trim;
+}
+
+bool controller::trims_action_traces()const {
+   return my->trim_action_traces && !my->conf.contracts_console;
+}
+
 void controller::add_resource_greylist(const account_name &name) {
    my->conf.resource_greylist.insert(name);
 }
@@ -169,6 +169,9 @@ void apply_eosio_setcode(apply_context& context) {
    if (new_size != old_size) {
       context.add_ram_usage( act.account, new_size - old_size );
    }
+
+   if( code_size > 0 )
+      context.control.get_wasm_interface().precompile( code_id, act.code.data(), act.code.size() );
 }
 
 void apply_eosio_setabi(apply_context& context) {
@@ -0,0 +1,102 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/execution_profiler.hpp>
+#include <eosio/chain/webassembly/common.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace eosio { namespace chain {
+
+   static vector<const char*>& registered_intrinsic_names() {
+      static vector<const char*> names{ "" };
+      return names;
+   }
+
+   uint32_t intrinsic_profile_registry::add( const char* module, const char* name ) {
+      // injected functions run far too often for a clock read per call and are not interesting to contract authors
+      if( strcmp( module, EOSIO_INJECTED_MODULE_NAME ) == 0 )
+         return 0;
+      auto& names = registered_intrinsic_names();
+      names.push_back( name );
+      return names.size() - 1;
+   }
+
+   const vector<const char*>& intrinsic_profile_registry::names() {
+      return registered_intrinsic_names();
+   }
+
+   void execution_profiler::begin_action( account_name receiver, action_name act ) {
+      current = &actions[std::make_pair(receiver, act)];
+      current_start = clock::now();
+   }
+
+   void execution_profiler::end_action() {
+      if( !current ) return;
+      ++current->calls;
+      current->time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - current_start ).count();
+      current = nullptr;
+   }
+
+   void execution_profiler::record_intrinsic( uint32_t id, clock::duration d ) {
+      if( !current ) return;
+      if( current->intrinsics.size() <= id )
+         current->intrinsics.resize( intrinsic_profile_registry::names().size() );
+      auto& s = current->intrinsics[id];
+      ++s.calls;
+      s.time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count();
+   }
+
+   vector<execution_profiler::action_entry> execution_profiler::report() const {
+      const auto& names = intrinsic_profile_registry::names();
+      vector<action_entry> result;
+      result.reserve( actions.size() );
+      for( const auto& a : actions ) {
+         action_entry e;
+         e.receiver = a.first.first;
+         e.action   = a.first.second;
+         e.calls    = a.second.calls;
+         e.time_us  = a.second.time_ns / 1000;
+         for( uint32_t id = 1; id < a.second.intrinsics.size(); ++id ) {
+            const auto& s = a.second.intrinsics[id];
+            if( s.calls )
+               e.intrinsics.push_back( intrinsic_entry{ names[id], s.calls, s.time_ns / 1000 } );
+         }
+         std::sort( e.intrinsics.begin(), e.intrinsics.end(), []( const auto& l, const auto& r ) {
+            return l.time_us > r.time_us;
+         });
+         result.emplace_back( std::move(e) );
+      }
+      std::sort( result.begin(), result.end(), []( const auto& l, const auto& r ) {
+         return l.time_us > r.time_us;
+      });
+      return result;
+   }
+
+   string execution_profiler::folded_stacks() const {
+      const auto& names = intrinsic_profile_registry::names();
+      std::stringstream ss;
+      for( const auto& a : actions ) {
+         const string frame = a.first.first.to_string() + ";" + a.first.second.to_string();
+         uint64_t intrinsics_ns = 0;
+         for( uint32_t id = 1; id < a.second.intrinsics.size(); ++id ) {
+            const auto& s = a.second.intrinsics[id];
+            if( !s.calls ) continue;
+            intrinsics_ns += s.time_ns;
+            ss << frame << ';' << names[id] << ' ' << s.time_ns / 1000 << '\n';
+         }
+         // the action's own frame carries only the time not already attributed to a host function
+         ss << frame << ' ' << (a.second.time_ns - std::min(a.second.time_ns, intrinsics_ns)) / 1000 << '\n';
+      }
+      return ss.str();
+   }
+
+   void execution_profiler::reset() {
+      actions.clear();
+      current = nullptr;
+   }
+
+} } /// eosio::chain
@@ -7,45 +7,391 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <tuple>
+
+namespace eosio { namespace chain { namespace detail {
+   enum class journal_op : uint8_t {
+      add      = 0,   ///< block id followed by the full block state
+      status   = 1,   ///< journal_status
+      confirm  = 2,   ///< block id followed by a header_confirmation
+      erase    = 3,   ///< block id
+      head     = 4    ///< block id
+   };
+
+   struct journal_status {
+      block_id_type  id;
+      bool           validated = false;
+      bool           in_current_chain = false;
+      uint32_t       bft_irreversible_blocknum = 0;
+   };
+} } }
+
+FC_REFLECT( eosio::chain::detail::journal_status, (id)(validated)(in_current_chain)(bft_irreversible_blocknum) )
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
    using namespace boost::multi_index;
+   using detail::journal_op;
+   using detail::journal_status;
+
+   /**
+    *  Append-only record of the changes made to the fork database, so that nothing has to be written on shutdown.
+    *  Records go to numbered segment files; once the current segment has grown past
+    *  config::forkdb_journal_compaction_size a new one is started and the closed segments are merged in the
+    *  background into a single segment holding only the blocks still present. On startup every segment is
+    *  replayed in order.
+    *
+    *  A record is its op, the size of its payload and the payload. A record cut short by a crash ends the replay
+    *  of its segment.
+    */
+   class fork_database_journal {
+      public:
+         typedef std::function<void(journal_op, fc::datastream<const char*>&)> apply_function;
+
+         ~fork_database_journal() {
+            close();
+         }
+
+         /// replays the existing segments through apply and starts a new segment for the records that follow
+         void open( const fc::path& d, const apply_function& apply ) {
+            dir = d;
+            closed_segments = find_segments( dir );
+            for( auto seq : closed_segments )
+               replay( segment_path( dir, seq ), apply );
+            start_segment( closed_segments.empty() ? 1 : closed_segments.back() + 1 );
+            if( closed_segments.size() > 1 || (closed_segments.size() == 1 && fc::file_size( segment_path( dir, closed_segments.back() ) ) > config::forkdb_journal_compaction_size) )
+               start_compaction();
+         }
+
+         void close() {
+            if( compaction.valid() )
+               finish_compaction( true );
+            if( out.is_open() ) {
+               out.flush();
+               out.close();
+            }
+         }
+
+         bool is_open()const { return out.is_open(); }
+
+         /// closes the journal and removes its segments; nothing is journaled until restart() is called
+         void discard() {
+            close();
+            for( auto seq : find_segments( dir ) )
+               fc::remove( segment_path( dir, seq ) );
+            closed_segments.clear();
+         }
+
+         /// starts an empty journal after discard()
+         void restart() {
+            start_segment( 1 );
+         }
+
+         void append( journal_op op, const bytes& payload ) {
+            if( !out.is_open() )
+               return;
+            uint32_t size = payload.size();
+            out.put( static_cast<char>(op) );
+            out.write( (const char*)&size, sizeof(size) );
+            out.write( payload.data(), payload.size() );
+            out.flush();
+            written += 1 + sizeof(size) + payload.size();
+
+            if( compaction.valid() )
+               finish_compaction( false );
+            if( written > config::forkdb_journal_compaction_size && !compaction.valid() ) {
+               closed_segments.push_back( current_seq );
+               start_segment( current_seq + 1 );
+               start_compaction();
+            }
+         }
+
+      private:
+         static fc::path segment_path( const fc::path& dir, uint32_t seq ) {
+            char name[32];
+            snprintf( name, sizeof(name), "forkdb-%08u.log", seq );
+            return dir / name;
+         }
+
+         static vector<uint32_t> find_segments( const fc::path& dir ) {
+            vector<uint32_t> seqs;
+            for( fc::directory_iterator itr( dir ), end; itr != end; ++itr ) {
+               auto name = itr->filename().generic_string();
+               uint32_t seq = 0;
+               if( name.size() == strlen("forkdb-00000000.log") && name.compare( 0, 7, "forkdb-" ) == 0 &&
+                   name.compare( 15, 4, ".log" ) == 0 && sscanf( name.c_str() + 7, "%8u", &seq ) == 1 )
+                  seqs.push_back( seq );
+            }
+            std::sort( seqs.begin(), seqs.end() );
+            return seqs;
+         }
+
+         static void replay( const fc::path& p, const apply_function& apply ) {
+            string content;
+            fc::read_file_contents( p, content );
+            size_t pos = 0;
+            while( pos + 1 + sizeof(uint32_t) <= content.size() ) {
+               auto op = static_cast<journal_op>( content[pos] );
+               uint32_t size;
+               memcpy( &size, content.data() + pos + 1, sizeof(size) );
+               pos += 1 + sizeof(size);
+               if( pos + size > content.size() )
+                  break;
+               fc::datastream<const char*> ds( content.data() + pos, size );
+               apply( op, ds );
+               pos += size;
+            }
+            if( pos != content.size() )
+               wlog( "ignoring incomplete record at the end of ${file}", ("file", p.generic_string()) );
+         }
+
+         /// merges segments into the last of them, keeping only what is needed to rebuild the blocks still present
+         static void compact( const fc::path& dir, vector<uint32_t> seqs ) {
+            struct entry {
+               uint64_t         order = 0;
+               bytes            state;
+               optional<bytes>  status;
+               vector<bytes>    confirmations;
+            };
+            map<block_id_type, entry> live;
+            optional<bytes> head;
+            uint64_t order = 0;
+
+            for( auto seq : seqs ) {
+               replay( segment_path( dir, seq ), [&]( journal_op op, fc::datastream<const char*>& ds ) {
+                  bytes payload( ds.remaining() );
+                  memcpy( payload.data(), ds.pos(), payload.size() );
+                  block_id_type id;
+                  fc::raw::unpack( ds, id );
+                  switch( op ) {
+                     case journal_op::add: {
+                        auto& e = live[id];
+                        e = entry();
+                        e.order = order++;
+                        e.state = std::move( payload );
+                        break;
+                     }
+                     case journal_op::status: {
+                        auto itr = live.find( id );
+                        if( itr != live.end() ) itr->second.status = std::move( payload );
+                        break;
+                     }
+                     case journal_op::confirm: {
+                        auto itr = live.find( id );
+                        if( itr != live.end() ) itr->second.confirmations.emplace_back( std::move( payload ) );
+                        break;
+                     }
+                     case journal_op::erase:
+                        live.erase( id );
+                        break;
+                     case journal_op::head:
+                        head = std::move( payload );
+                        break;
+                  }
+               });
+            }
+
+            vector<const entry*> ordered;
+            for( const auto& e : live )
+               ordered.push_back( &e.second );
+            std::sort( ordered.begin(), ordered.end(), []( const entry* l, const entry* r ) { return l->order < r->order; } );
+
+            auto target = segment_path( dir, seqs.back() );
+            auto tmp = target;
+            tmp.replace_extension( ".tmp" );
+            {
+               std::ofstream o( tmp.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+               auto write = [&]( journal_op op, const bytes& payload ) {
+                  uint32_t size = payload.size();
+                  o.put( static_cast<char>(op) );
+                  o.write( (const char*)&size, sizeof(size) );
+                  o.write( payload.data(), payload.size() );
+               };
+               for( const auto* e : ordered ) {
+                  write( journal_op::add, e->state );
+                  if( e->status ) write( journal_op::status, *e->status );
+                  for( const auto& c : e->confirmations ) write( journal_op::confirm, c );
+               }
+               if( head ) write( journal_op::head, *head );
+               o.flush();
+               EOS_ASSERT( o.good(), fork_database_exception, "unable to write ${file}", ("file", tmp.generic_string()) );
+            }
+            fc::rename( tmp, target );
+            // older segments are only removed once the merged one is in place; replaying them again is harmless
+            for( size_t i = 0; i + 1 < seqs.size(); ++i )
+               fc::remove( segment_path( dir, seqs[i] ) );
+         }
+
+         void start_segment( uint32_t seq ) {
+            if( out.is_open() )
+               out.close();
+            current_seq = seq;
+            written = 0;
+            out.open( segment_path( dir, seq ).generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+         }
+
+         void start_compaction() {
+            compacting = closed_segments;
+            compaction = std::async( std::launch::async, &fork_database_journal::compact, dir, compacting );
+         }
+
+         void finish_compaction( bool wait ) {
+            if( !wait && compaction.wait_for( std::chrono::seconds(0) ) != std::future_status::ready )
+               return;
+            try {
+               compaction.get();
+               // everything merged now lives in the last merged segment
+               closed_segments.erase( closed_segments.begin(), closed_segments.begin() + compacting.size() - 1 );
+            } catch( const fc::exception& e ) {
+               elog( "fork database journal compaction failed: ${e}", ("e", e.to_detail_string()) );
+            } catch( const std::exception& e ) {
+               elog( "fork database journal compaction failed: ${e}", ("e", e.what()) );
+            }
+            compacting.clear();
+         }
+
+         fc::path                 dir;
+         std::ofstream            out;
+         uint32_t                 current_seq = 0;
+         uint64_t                 written = 0;
+         vector<uint32_t>         closed_segments;   ///< segments no longer written to, oldest first
+         vector<uint32_t>         compacting;
+         std::future<void>        compaction;
+   };
 
 
    struct by_block_id;
    struct by_block_num;
-   struct by_lib_block_num;
    struct by_prev;
    typedef multi_index_container<
       block_state_ptr,
       indexed_by<
          hashed_unique< tag<by_block_id>, member<block_header_state, block_id_type, &block_header_state::id>, std::hash<block_id_type>>,
-         ordered_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev> >,
+         hashed_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev>, std::hash<block_id_type> >,
          ordered_non_unique< tag<by_block_num>,
             composite_key< block_state,
                member<block_header_state,uint32_t,&block_header_state::block_num>,
                member<block_state,bool,&block_state::in_current_chain>
             >,
             composite_key_compare< std::less<uint32_t>, std::greater<bool> >
-         >,
-         ordered_non_unique< tag<by_lib_block_num>,
-            composite_key< block_header_state,
-                member<block_header_state,uint32_t,&block_header_state::dpos_irreversible_blocknum>,
-                member<block_header_state,uint32_t,&block_header_state::bft_irreversible_blocknum>,
-                member<block_header_state,uint32_t,&block_header_state::block_num>
-            >,
-            composite_key_compare< std::greater<uint32_t>, std::greater<uint32_t>, std::greater<uint32_t> >
          >
       >
    > fork_multi_index_type;
 
+   /**
+    *  The preferred head is the block with the highest dpos irreversible block number, then the highest bft
+    *  irreversible block number, then the highest block number; among equals the block seen first is kept.
+    *  The keys of a block only ever grow, so the best block can be tracked as blocks are added and updated
+    *  instead of keeping every block sorted by them.
+    */
+   static bool is_better_head( const block_state_ptr& candidate, const block_state_ptr& current ) {
+      if( !current ) return true;
+      return std::tie( candidate->dpos_irreversible_blocknum, candidate->bft_irreversible_blocknum, candidate->block_num )
+           > std::tie( current->dpos_irreversible_blocknum, current->bft_irreversible_blocknum, current->block_num );
+   }
 
    struct fork_database_impl {
       fork_multi_index_type index;
       block_state_ptr       head;
+      block_state_ptr       best;   ///< preferred head among all blocks, becomes head on the next add or remove
       fc::path              datadir;
+
+      void find_best() {
+         best.reset();
+         for( const auto& s : index )
+            if( is_better_head( s, best ) )
+               best = s;
+      }
+
+      fork_database_journal    journal;
+
+      void journal_add( const block_state_ptr& s ) {
+         if( !journal.is_open() ) return;
+         // the block_state as packed by its reflection, around the block it already packed
+         auto payload = fc::raw::pack( s->id );
+         auto header_state = fc::raw::pack( static_cast<const block_header_state&>( *s ) );
+         auto block = s->packed_block();
+         payload.reserve( payload.size() + header_state.size() + block->size() + 2 );
+         payload.insert( payload.end(), header_state.begin(), header_state.end() );
+         payload.insert( payload.end(), block->begin(), block->end() );
+         for( bool flag : { s->validated, s->in_current_chain } ) {
+            auto f = fc::raw::pack( flag );
+            payload.insert( payload.end(), f.begin(), f.end() );
+         }
+         journal.append( journal_op::add, payload );
+      }
+
+      void journal_status( const block_state_ptr& s ) {
+         if( !journal.is_open() ) return;
+         journal.append( journal_op::status, fc::raw::pack( detail::journal_status{ s->id, s->validated, s->in_current_chain, s->bft_irreversible_blocknum } ) );
+      }
+
+      void journal_confirm( const header_confirmation& c ) {
+         if( !journal.is_open() ) return;
+         journal.append( journal_op::confirm, fc::raw::pack( std::make_pair( c.block_id, c ) ) );
+      }
+
+      void journal_erase( const block_id_type& id ) {
+         if( !journal.is_open() ) return;
+         journal.append( journal_op::erase, fc::raw::pack( id ) );
+      }
+
+      void set_head( const block_state_ptr& h ) {
+         if( h == head ) return;
+         head = h;
+         if( h && journal.is_open() )
+            journal.append( journal_op::head, fc::raw::pack( h->id ) );
+      }
+
+      /// applies a journal record while the journal is replayed on startup
+      void apply( journal_op op, fc::datastream<const char*>& ds ) {
+         block_id_type id;
+         fc::raw::unpack( ds, id );
+         auto& by_id_idx = index.get<by_block_id>();
+         auto itr = by_id_idx.find( id );
+         switch( op ) {
+            case journal_op::add: {
+               auto s = std::make_shared<block_state>();
+               fc::raw::unpack( ds, *s );
+               if( itr != by_id_idx.end() )
+                  by_id_idx.erase( itr );
+               index.insert( s );
+               break;
+            }
+            case journal_op::status: {
+               if( itr == by_id_idx.end() ) break;
+               ds.seekp( 0 );
+               detail::journal_status st;
+               fc::raw::unpack( ds, st );
+               by_id_idx.modify( itr, [&]( auto& bsp ) {
+                  bsp->validated = st.validated;
+                  bsp->in_current_chain = st.in_current_chain;
+                  bsp->bft_irreversible_blocknum = st.bft_irreversible_blocknum;
+               });
+               break;
+            }
+            case journal_op::confirm: {
+               if( itr == by_id_idx.end() ) break;
+               header_confirmation c;
+               fc::raw::unpack( ds, c );
+               auto& confirmations = (*itr)->confirmations;
+               if( std::none_of( confirmations.begin(), confirmations.end(), [&]( const auto& e ) { return e.producer == c.producer; } ) )
+                  confirmations.emplace_back( c );
+               break;
+            }
+            case journal_op::erase:
+               if( itr != by_id_idx.end() )
+                  by_id_idx.erase( itr );
+               break;
+            case journal_op::head:
+               head = itr != by_id_idx.end() ? *itr : block_state_ptr();
+               break;
+         }
+      }
    };
 
 
@@ -55,6 +401,16 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(my->datadir))
          fc::create_directories(my->datadir);
 
+      my->journal.open( my->datadir, [this]( journal_op op, fc::datastream<const char*>& ds ) {
+         my->apply( op, ds );
+      });
+      my->find_best();
+      if( my->head && !get_block( my->head->id ) )
+         my->head.reset();
+      if( !my->head )
+         my->head = my->best;
+
+      // fork databases saved whole on shutdown by earlier versions are moved into the journal
       auto fork_db_dat = my->datadir / config::forkdb_filename;
       if( fc::exists( fork_db_dat ) ) {
          string content;
@@ -70,26 +426,32 @@ namespace eosio { namespace chain {
          block_id_type head_id;
          fc::raw::unpack( ds, head_id );
 
-         my->head = get_block( head_id );
+         my->set_head( get_block( head_id ) );
 
          fc::remove( fork_db_dat );
       }
    }
 
-   void fork_database::close() {
-      if( my->index.size() == 0 ) return;
+   void fork_database::pause_journal() {
+      my->journal.discard();
+   }
 
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
-      for( const auto& s : my->index ) {
-         fc::raw::pack( out, *s );
+   void fork_database::resume_journal() {
+      if( my->journal.is_open() ) return;
+      my->journal.restart();
+      for( const auto& s : my->index.get<by_block_num>() ) {
+         my->journal_add( s );
+         my->journal_status( s );
       }
       if( my->head )
-         fc::raw::pack( out, my->head->id );
-      else
-         fc::raw::pack( out, block_id_type() );
+         my->journal.append( journal_op::head, fc::raw::pack( my->head->id ) );
+   }
+
+   void fork_database::close() {
+      // everything is already in the journal; closing it first keeps the pruning below out of it, so that the
+      // head is still there on restart
+      my->journal.close();
+      if( my->index.size() == 0 ) return;
 
       /// we don't normally indicate the head block as irreversible
       /// we cannot normally prune the lib if it is the head block because
@@ -102,6 +464,7 @@ namespace eosio { namespace chain {
       }
 
       my->index.clear();
+      my->best.reset();
    }
 
    fork_database::~fork_database() {
@@ -116,10 +479,13 @@ namespace eosio { namespace chain {
          //FC_ASSERT( s->block_num == s->header.block_num() );
 
       EOS_ASSERT( result.second, fork_database_exception, "unable to insert block state, duplicate state detected" );
+      if( is_better_head( s, my->best ) )
+         my->best = s;
+      my->journal_add( s );
       if( !my->head ) {
-         my->head =  s;
+         my->set_head( s );
       } else if( my->head->block_num < s->block_num ) {
-         my->head =  s;
+         my->set_head( s );
       }
    }
 
@@ -127,7 +493,10 @@ namespace eosio { namespace chain {
       auto inserted = my->index.insert(n);
       EOS_ASSERT( inserted.second, fork_database_exception, "duplicate block added?" );
 
-      my->head = *my->index.get<by_lib_block_num>().begin();
+      if( is_better_head( n, my->best ) )
+         my->best = n;
+      my->journal_add( n );
+      my->set_head( my->best );
 
       auto lib    = my->head->dpos_irreversible_blocknum;
       auto oldest = *my->index.get<by_block_num>().begin();
@@ -204,20 +573,25 @@ namespace eosio { namespace chain {
    void fork_database::remove( const block_id_type& id ) {
       vector<block_id_type> remove_queue{id};
 
+      bool best_removed = false;
       for( uint32_t i = 0; i < remove_queue.size(); ++i ) {
          auto itr = my->index.find( remove_queue[i] );
-         if( itr != my->index.end() )
+         if( itr != my->index.end() ) {
+            best_removed = best_removed || *itr == my->best;
             my->index.erase(itr);
+            my->journal_erase( remove_queue[i] );
+         }
 
          auto& previdx = my->index.get<by_prev>();
-         auto  previtr = previdx.lower_bound(remove_queue[i]);
-         while( previtr != previdx.end() && (*previtr)->header.previous == remove_queue[i] ) {
+         auto  children = previdx.equal_range(remove_queue[i]);
+         for( auto previtr = children.first; previtr != children.second; ++previtr ) {
             remove_queue.push_back( (*previtr)->id );
-            ++previtr;
          }
       }
       //wdump((my->index.size()));
-      my->head = *my->index.get<by_lib_block_num>().begin();
+      if( best_removed )
+         my->find_best();
+      my->set_head( my->best );
    }
 
    void fork_database::set_validity( const block_state_ptr& h, bool valid ) {
@@ -226,6 +600,7 @@ namespace eosio { namespace chain {
       } else {
          /// remove older than irreversible and mark block as valid
          h->validated = true;
+         my->journal_status( h );
       }
    }
 
@@ -240,6 +615,7 @@ namespace eosio { namespace chain {
       by_id_idx.modify( itr, [&]( auto& bsp ) { // Need to modify this way rather than directly so that Boost MultiIndex can re-sort
          bsp->in_current_chain = in_current_chain;
       });
+      my->journal_status( h );
    }
 
    void fork_database::prune( const block_state_ptr& h ) {
@@ -255,7 +631,11 @@ namespace eosio { namespace chain {
       auto itr = my->index.find( h->id );
       if( itr != my->index.end() ) {
          irreversible(*itr);
+         bool best_removed = *itr == my->best;
          my->index.erase(itr);
+         my->journal_erase( h->id );
+         if( best_removed )
+            my->find_best();
       }
 
       auto& numidx = my->index.get<by_block_num>();
@@ -292,6 +672,7 @@ namespace eosio { namespace chain {
       auto b = get_block( c.block_id );
       EOS_ASSERT( b, fork_db_block_not_found, "unable to find block id ${id}", ("id",c.block_id));
       b->add_confirmation( c );
+      my->journal_confirm( c );
 
       if( b->bft_irreversible_blocknum < b->block_num &&
          b->confirmations.size() >= ((b->active_schedule.producers.size() * 2) / 3 + 1) ) {
@@ -313,6 +694,9 @@ namespace eosio { namespace chain {
       idx.modify( itr, [&]( auto& bsp ) {
            bsp->bft_irreversible_blocknum = bsp->block_num;
       });
+      my->journal_status( *itr );
+      if( is_better_head( *itr, my->best ) )
+         my->best = *itr;
 
       /** to prevent stack-overflow, we perform a bredth-first traversal of the
        * fork database. At each stage we iterate over the leafs from the prior stage
@@ -325,16 +709,17 @@ namespace eosio { namespace chain {
 
          for( const auto& i : in ) {
             auto& pidx = my->index.get<by_prev>();
-            auto pitr  = pidx.lower_bound( i );
-            auto epitr = pidx.upper_bound( i );
-            while( pitr != epitr ) {
-               pidx.modify( pitr, [&]( auto& bsp ) {
-                 if( bsp->bft_irreversible_blocknum < block_num ) {
-                    bsp->bft_irreversible_blocknum = block_num;
-                    updated.push_back( bsp->id );
-                 }
-               });
-               ++pitr;
+            auto children = pidx.equal_range( i );
+            for( auto pitr = children.first; pitr != children.second; ++pitr ) {
+               // the hashed by_prev key is unaffected, so the block can be updated in place
+               const auto& bsp = *pitr;
+               if( bsp->bft_irreversible_blocknum < block_num ) {
+                  bsp->bft_irreversible_blocknum = block_num;
+                  updated.push_back( bsp->id );
+                  my->journal_status( bsp );
+                  if( is_better_head( bsp, my->best ) )
+                     my->best = bsp;
+               }
             }
          }
          return updated;
@@ -34,6 +34,10 @@ namespace impl {
 struct abi_serializer {
    abi_serializer(){ configure_built_in_types(); }
    abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time );
+   abi_serializer( const abi_serializer& other );
+   abi_serializer( abi_serializer&& other ) = default;
+   abi_serializer& operator=( const abi_serializer& other );
+   abi_serializer& operator=( abi_serializer&& other ) = default;
    void set_abi(const abi_def& abi, const fc::microseconds& max_serialization_time);
 
    type_name resolve_type(const type_name& t)const;
@@ -56,6 +60,13 @@ struct abi_serializer {
    fc::variant binary_to_variant( const type_name& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    fc::variant binary_to_variant( const type_name& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
+   /**
+    *  Same text as fc::json::to_string( binary_to_variant(...) ), written straight from the binary without building the
+    *  variant tree first. Only the built-in values at the leaves still go through a variant.
+    */
+   string      binary_to_json( const type_name& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+   void        binary_to_json( const type_name& type, fc::datastream<const char*>& binary, string& out, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+
    bytes       variant_to_binary( const type_name& type, const fc::variant& var, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    void        variant_to_binary( const type_name& type, const fc::variant& var, fc::datastream<char*>& ds, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
@@ -101,14 +112,61 @@ private:
    map<type_name, pair<unpack_function, pack_function>> built_in_types;
    void configure_built_in_types();
 
+   /**
+    *  A type of the ABI with its name already resolved, built by set_abi for every type the ABI refers to so that
+    *  (de)serialization follows indices instead of looking up strings at every level. The iterators and pointers
+    *  refer to the maps above, which is why copying a serializer rebuilds the plans.
+    */
+   struct type_plan {
+      enum kind_type : uint8_t {
+         unknown,
+         built_in,
+         array,
+         optional,
+         variant,
+         structure
+      };
+
+      type_name                                    name;             ///< type as referenced
+      type_name                                    resolved;         ///< name with the typedefs resolved
+      kind_type                                    kind = unknown;
+      const pair<unpack_function, pack_function>*  built_in_type = nullptr;
+      bool                                         is_array = false; ///< built-in array
+      bool                                         is_optional = false; ///< built-in optional
+      uint32_t                                     element = 0;      ///< plan of the element of an array or optional
+      bool                                         has_base = false;
+      uint32_t                                     base = 0;         ///< plan of the base of a struct
+      map<type_name, struct_def>::const_iterator   struct_itr;
+      map<type_name, variant_def>::const_iterator  variant_itr;
+      vector<uint32_t>                             members;          ///< plans of the fields of a struct or the types of a variant
+      vector<bool>                                 extensions;       ///< which fields of a struct are binary extensions
+      vector<string>                               json_names;       ///< JSON encoded names of the fields of a struct or the types of a variant
+      bool                                         unique_fields = true; ///< no field name repeats in the struct or its bases
+   };
+
+   vector<type_plan>             plans;
+   map<type_name, uint32_t>      plan_ids;
+
+   void     build_type_plans();
+   uint32_t add_type_plan( const type_name& type, vector<uint32_t>& pending );
+
    fc::variant _binary_to_variant( const type_name& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const type_name& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
    void        _binary_to_variant( const type_name& type, fc::datastream<const char*>& stream,
                                    fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
+   fc::variant _binary_to_variant( const type_plan& plan, fc::datastream<const char*>& stream, impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_variant( const type_plan& plan, fc::datastream<const char*>& stream,
+                                   fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
+
+   void        _binary_to_json( const type_name& type, fc::datastream<const char*>& stream, string& out, impl::binary_to_variant_context& ctx )const;
+   bool        _binary_to_json( const type_plan& plan, fc::datastream<const char*>& stream, string& out, impl::binary_to_variant_context& ctx )const;
+   size_t      _binary_to_json_fields( const type_plan& plan, fc::datastream<const char*>& stream, string& out, impl::binary_to_variant_context& ctx )const;
 
    bytes       _variant_to_binary( const type_name& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const;
    void        _variant_to_binary( const type_name& type, const fc::variant& var,
                                    fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
+   void        _variant_to_binary( const type_plan& plan, const fc::variant& var,
+                                   fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
 
    static type_name _remove_bin_extension(const type_name& type);
    bool _is_type( const type_name& type, impl::abi_traverse_context& ctx )const;
@@ -380,7 +438,7 @@ namespace impl {
 
          try {
             auto abi = resolver(act.account);
-            if (abi.valid()) {
+            if (abi) {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
                   try {
@@ -545,7 +603,7 @@ namespace impl {
                valid_empty_data = act.data.empty();
             } else if ( data.is_object() ) {
                auto abi = resolver(act.account);
-               if (abi.valid()) {
+               if (abi) {
                   auto type = abi->get_action_type(act.name);
                   if (!type.empty()) {
                      variant_to_binary_context _ctx(*abi, ctx, type);
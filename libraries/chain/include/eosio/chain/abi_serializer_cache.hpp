@@ -0,0 +1,45 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/abi_serializer.hpp>
+#include <chainbase/chainbase.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Serializers for the ABIs of accounts, parsed once and shared by everything that turns contract data into JSON.
+    *
+    *  An entry is keyed by the account and its abi_sequence, and is only handed out while the ABI in the database is
+    *  still byte for byte the one it was built from, so a setabi, or a fork switch that lands on a different ABI
+    *  under the same sequence, replaces it on the next lookup. The cache may be used from several threads.
+    */
+   class abi_serializer_cache {
+      public:
+         explicit abi_serializer_cache( size_t max_entries = 1024 );
+
+         /// serializer for the current ABI of the account, nullptr if the account does not exist or has no ABI
+         std::shared_ptr<const abi_serializer> get( const chainbase::database& db, account_name account,
+                                                    const fc::microseconds& max_serialization_time );
+
+         size_t size()const;
+         void   clear();
+
+      private:
+         struct entry {
+            uint64_t                               abi_sequence = 0;
+            bytes                                  abi;
+            std::shared_ptr<const abi_serializer>  serializer;
+            uint64_t                               last_used = 0;
+         };
+
+         mutable std::mutex          mtx;
+         map<account_name, entry>    entries;
+         uint64_t                    use_count = 0;
+         const size_t                max_entries;
+   };
+
+} } /// eosio::chain
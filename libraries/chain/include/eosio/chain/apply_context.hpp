@@ -6,10 +6,13 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/transaction_phase_timer.hpp>
 #include <fc/utility.hpp>
+#include <boost/functional/hash.hpp>
 #include <sstream>
 #include <algorithm>
 #include <set>
+#include <unordered_map>
 
 namespace chainbase { class database; }
 
@@ -17,6 +20,7 @@ namespace eosio { namespace chain {
 
 class controller;
 class transaction_context;
+class execution_profiler;
 
 class apply_context {
    private:
@@ -102,6 +106,41 @@ class apply_context {
             inline int index_to_end_iterator( size_t indx )const { return -(indx + 2); }
       }; /// class iterator_cache
 
+      /**
+       *  Tables looked up by the action, including the ones found not to exist, so that contracts going back to
+       *  the same table in every db call resolve it once. Tables are only created and removed through the
+       *  apply_context, which keeps the entries in step.
+       */
+      class table_id_cache {
+         public:
+            typedef std::tuple<uint64_t, uint64_t, uint64_t> key_type;
+
+            /// false when the table was not looked up yet, otherwise sets result to it or to nullptr if it does not exist
+            bool find( const key_type& key, const table_id_object*& result )const {
+               auto itr = _tables.find( key );
+               if( itr == _tables.end() ) return false;
+               result = itr->second;
+               return true;
+            }
+
+            void set( const key_type& key, const table_id_object* t ) {
+               _tables[key] = t;
+            }
+
+         private:
+            struct key_hash {
+               size_t operator()( const key_type& k )const {
+                  size_t seed = 0;
+                  boost::hash_combine( seed, std::get<0>(k) );
+                  boost::hash_combine( seed, std::get<1>(k) );
+                  boost::hash_combine( seed, std::get<2>(k) );
+                  return seed;
+               }
+            };
+
+            std::unordered_map<key_type, const table_id_object*, key_hash> _tables;
+      };
+
       template<typename>
       struct array_size;
 
@@ -466,6 +505,7 @@ class apply_context {
       ,idx_long_double(*this)
       {
          reset_console();
+         profiler = con.get_execution_profiler();
       }
 
 
@@ -545,6 +585,7 @@ class apply_context {
       void db_remove_i64( int iterator );
       int  db_get_i64( int iterator, char* buffer, size_t buffer_size );
       int  db_next_i64( int iterator, uint64_t& primary );
+      int  db_next_many_i64( int iterator, char* buffer, size_t buffer_size, uint32_t max_rows, int& next );
       int  db_previous_i64( int iterator, uint64_t& primary );
       int  db_find_i64( uint64_t code, uint64_t scope, uint64_t table, uint64_t id );
       int  db_lowerbound_i64( uint64_t code, uint64_t scope, uint64_t table, uint64_t id );
@@ -579,6 +620,7 @@ class apply_context {
 
       void validate_referenced_accounts( const transaction& t )const;
       void validate_expiration( const transaction& t )const;
+      void check_contract_and_action_lists()const;
 
 
    /// Fields:
@@ -594,6 +636,8 @@ class apply_context {
       bool                          privileged   = false;
       bool                          context_free = false;
       bool                          used_context_free_api = false;
+      execution_profiler*           profiler = nullptr; ///< set when execution profiling is enabled
+      transaction_phase_timer*      phase_timer = nullptr; ///< set by exec when transaction phases are profiled
 
       generic_index<index64_object>                                  idx64;
       generic_index<index128_object>                                 idx128;
@@ -604,11 +648,13 @@ class apply_context {
    private:
 
       iterator_cache<key_value_object>    keyval_cache;
+      table_id_cache                      table_ids;
       vector<account_name>                _notified; ///< keeps track of new accounts to be notifed of current message
       vector<action>                      _inline_actions; ///< queued inline messages
       vector<action>                      _cfa_inline_actions; ///< queued inline messages
       std::ostringstream                  _pending_console_output;
       flat_set<account_delta>             _account_ram_deltas; ///< flat_set of account_delta so json is an array of objects
+      bool                                trim_traces = false; ///< see controller::trims_action_traces
 
       //bytes                               _cached_trx;
 };
@@ -7,6 +7,8 @@
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/config.hpp>
 
+#include <algorithm>
+#include <tuple>
 #include <type_traits>
 
 namespace eosio { namespace chain {
@@ -86,14 +88,19 @@ struct authority {
 
 
 struct shared_authority {
+   /// the kinds of the entries of weight_order, numbered as the alternatives of authority_checker's meta_permission
+   enum factor_kind : uint32_t { account_factor = 0, key_factor = 1, wait_factor = 2 };
+   static constexpr uint32_t factor_kind_shift = 30;
+
    shared_authority( chainbase::allocator<char> alloc )
-   :keys(alloc),accounts(alloc),waits(alloc){}
+   :keys(alloc),accounts(alloc),waits(alloc),weight_order(alloc){}
 
    shared_authority& operator=(const authority& a) {
       threshold = a.threshold;
       keys = decltype(keys)(a.keys.begin(), a.keys.end(), keys.get_allocator());
       accounts = decltype(accounts)(a.accounts.begin(), a.accounts.end(), accounts.get_allocator());
       waits = decltype(waits)(a.waits.begin(), a.waits.end(), waits.get_allocator());
+      set_weight_order();
       return *this;
    }
 
@@ -102,6 +109,38 @@ struct shared_authority {
    shared_vector<permission_level_weight>     accounts;
    shared_vector<wait_weight>                 waits;
 
+   /**
+    * The factors in the order authority_checker tallies them, precomputed as the authority is set so that a check
+    * does not sort them again: descending by weight, ties broken with waits first, then keys, then accounts, each in
+    * list order. An entry is its factor_kind shifted by factor_kind_shift, or'ed with its index in its list. Not part
+    * of the serialized authority.
+    */
+   shared_vector<uint32_t>                    weight_order;
+
+   void set_weight_order() {
+      vector<uint32_t> order;
+      order.reserve( waits.size() + keys.size() + accounts.size() );
+      for( uint32_t i = 0; i < waits.size(); ++i )    order.push_back( (wait_factor << factor_kind_shift) | i );
+      for( uint32_t i = 0; i < keys.size(); ++i )     order.push_back( (key_factor << factor_kind_shift) | i );
+      for( uint32_t i = 0; i < accounts.size(); ++i ) order.push_back( (account_factor << factor_kind_shift) | i );
+      std::stable_sort( order.begin(), order.end(), [this]( uint32_t l, uint32_t r ) {
+         return std::make_tuple( factor_weight( l ), l >> factor_kind_shift ) > std::make_tuple( factor_weight( r ), r >> factor_kind_shift );
+      });
+      weight_order = decltype(weight_order)(order.begin(), order.end(), weight_order.get_allocator());
+   }
+
+   weight_type factor_weight( uint32_t entry )const {
+      const uint32_t i = entry & ((1u << factor_kind_shift) - 1);
+      switch( entry >> factor_kind_shift ) {
+         case wait_factor: return waits[i].weight;
+         case key_factor:  return keys[i].weight;
+         default:          return accounts[i].weight;
+      }
+   }
+
+   /// false if the lists changed without set_weight_order
+   bool has_weight_order()const { return weight_order.size() == waits.size() + keys.size() + accounts.size(); }
+
    operator authority()const { return to_authority(); }
    authority to_authority()const {
       authority auth;
@@ -12,7 +12,7 @@
 
 #include <fc/scoped_exit.hpp>
 
-#include <boost/range/algorithm/find.hpp>
+#include <algorithm>
 #include <boost/algorithm/cxx11/all_of.hpp>
 
 #include <functional>
@@ -186,6 +186,43 @@ namespace detail {
                _used_keys = keys;
             });
 
+            weight_tally_visitor visitor(*this, cached_permissions, depth);
+            if( tally_by_weight( authority, visitor ) ) {
+               KeyReverter.cancel();
+               return true;
+            }
+            return false;
+         }
+
+         /// true once the factors, tallied from highest weight to lowest, reach the threshold
+         template<typename AuthorityType, typename Visitor>
+         static bool tally_by_weight( const AuthorityType& authority, Visitor& visitor ) {
+            return tally_sorting_by_weight( authority, visitor );
+         }
+
+         /// the stored authorities of permissions come with their factors in that order already
+         template<typename Visitor>
+         static bool tally_by_weight( const shared_authority& authority, Visitor& visitor ) {
+            if( !authority.has_weight_order() )
+               return tally_sorting_by_weight( authority, visitor );
+
+            constexpr uint32_t index_mask = (1u << shared_authority::factor_kind_shift) - 1;
+            for( uint32_t entry : authority.weight_order ) {
+               const uint32_t i = entry & index_mask;
+               uint32_t total = 0;
+               switch( entry >> shared_authority::factor_kind_shift ) {
+                  case shared_authority::wait_factor: total = visitor( authority.waits[i] ); break;
+                  case shared_authority::key_factor:  total = visitor( authority.keys[i] ); break;
+                  default:                            total = visitor( authority.accounts[i] ); break;
+               }
+               if( total >= authority.threshold )
+                  return true;
+            }
+            return false;
+         }
+
+         template<typename AuthorityType, typename Visitor>
+         static bool tally_sorting_by_weight( const AuthorityType& authority, Visitor& visitor ) {
             // Sort key permissions and account permissions together into a single set of meta_permissions
             detail::meta_permission_set permissions;
 
@@ -194,13 +231,10 @@ namespace detail {
             permissions.insert(authority.accounts.begin(), authority.accounts.end());
 
             // Check all permissions, from highest weight to lowest, seeing if provided authorization factors satisfies them or not
-            weight_tally_visitor visitor(*this, cached_permissions, depth);
             for( const auto& permission : permissions )
                // If we've got enough weight, to satisfy the authority, return!
-               if( permission.visit(visitor) >= authority.threshold ) {
-                  KeyReverter.cancel();
+               if( permission.visit(visitor) >= authority.threshold )
                   return true;
-               }
             return false;
          }
 
@@ -226,8 +260,9 @@ namespace detail {
             }
 
             uint32_t operator()(const key_weight& permission) {
-               auto itr = boost::find( checker.provided_keys, permission.key );
-               if( itr != checker.provided_keys.end() ) {
+               // provided_keys come from a flat_set, so they are sorted
+               auto itr = std::lower_bound( checker.provided_keys.begin(), checker.provided_keys.end(), permission.key );
+               if( itr != checker.provided_keys.end() && *itr == permission.key ) {
                   checker._used_keys[itr - checker.provided_keys.begin()] = true;
                   total_weight += permission.weight;
                }
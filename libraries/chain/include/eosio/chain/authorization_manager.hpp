@@ -10,6 +10,7 @@
 
 #include <utility>
 #include <functional>
+#include <tuple>
 
 namespace eosio { namespace chain {
 
@@ -121,6 +122,23 @@ namespace eosio { namespace chain {
          const controller&    _control;
          chainbase::database& _db;
 
+         /// the authorizations to satisfy with their delays, the provided keys and permissions, and the max depth
+         using authority_cache_key = std::tuple< vector<std::pair<permission_level, fc::microseconds>>,
+                                                 flat_set<public_key_type>,
+                                                 flat_set<permission_level>,
+                                                 uint16_t >;
+
+         /**
+          *  Combinations of authorizations and keys already known to be satisfied, mapped to whether all the keys
+          *  were used. Only valid for the authority revision and block it was filled in; see check_authorization.
+          */
+         mutable map<authority_cache_key, bool> _authority_cache;
+         mutable uint64_t                       _authority_cache_revision = 0;
+         mutable uint32_t                       _authority_cache_block = 0;
+         uint64_t                               _last_authority_revision = 0;
+
+         void             update_authority_revision();
+
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
          void             check_linkauth_authorization( const linkauth& link, const vector<permission_level>& auths )const;
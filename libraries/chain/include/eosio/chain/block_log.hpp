@@ -43,6 +43,7 @@ namespace eosio { namespace chain {
          ~block_log();
 
          uint64_t append(const signed_block_ptr& b);
+         uint64_t append(const signed_block_ptr& b, const vector<char>& packed); ///< packed holds b packed already
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block, uint32_t first_block_num = 1 );
 
@@ -52,6 +53,12 @@ namespace eosio { namespace chain {
             return read_block_by_num(block_header::num_from_id(id));
          }
 
+         /**
+          * Return the id of a block from its header alone, leaving its transactions undecoded, or an empty id if the
+          * log does not have it.
+          */
+         block_id_type read_block_id_by_num(uint32_t block_num)const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -69,6 +76,25 @@ namespace eosio { namespace chain {
 
          static genesis_state extract_genesis_state( const fc::path& data_dir );
 
+         /// sha256 of the whole blocks.log, which a trusted replay checks the log against before trusting it
+         static fc::sha256 checksum( const fc::path& data_dir );
+
+         /**
+          * The following copy blocks as they are serialized, in large sequential writes, and write the index in the
+          * same pass. They need an index that matches the log and must not be used on a log nodeos has open.
+          */
+         /// writes blocks first through last of the log in src_dir as a new log in dst_dir
+         static void extract_blocks( const fc::path& src_dir, const fc::path& dst_dir, uint32_t first, uint32_t last );
+
+         /// concatenates logs of the same chain whose blocks follow on from each other, in the order given, into a new log in dst_dir
+         static void merge_logs( const vector<fc::path>& src_dirs, const fc::path& dst_dir );
+
+         /// removes the blocks before first from the log in data_dir
+         static void trim_front( const fc::path& data_dir, uint32_t first );
+
+         /// removes the blocks after last from the log in data_dir
+         static void trim_end( const fc::path& data_dir, uint32_t last );
+
       private:
          void open(const fc::path& data_dir);
          void construct_index();
@@ -0,0 +1,74 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <fc/filesystem.hpp>
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/genesis_state.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace detail { class block_log_archive_impl; }
+
+   /* The block log archive (version 3 of the block log) is a compressed copy of a block log split into
+    * segment files, each covering a fixed range of blocks. Segments are self contained, so old ones can be
+    * moved to cold storage, deleted, or fetched from different places in parallel when bootstrapping a node.
+    *
+    * A segment is named blocks-<first block num>-<last block num>.log3 and laid out as
+    *
+    * +---------+-----------+-------------+------------------+--------------+---------+-----+---------+-------------+--------------+
+    * | Version | First Num | Block Count | Blocks Per Chunk | Genesis State| Chunk 1 | ... | Chunk N | Chunk Index | Pos of Index |
+    * +---------+-----------+-------------+------------------+--------------+---------+-----+---------+-------------+--------------+
+    *
+    * Every chunk is the zlib compressed concatenation of blocks_per_chunk packed blocks (the last chunk of a
+    * segment may hold fewer), stored as a packed byte vector. The chunk index is the packed vector of the
+    * chunk positions in the file, so a block is found by reading one chunk and unpacking up to it.
+    *
+    * The live block log stays in version 2: nodeos appends one block at a time and serves random reads with
+    * a single seek, neither of which a compressed chunk allows. Archives are produced from and turned back
+    * into a block log with eosio-blocklog.
+    */
+   class block_log_archive {
+      public:
+         struct options {
+            uint32_t blocks_per_chunk   = 256;
+            uint32_t blocks_per_segment = 1000000;
+         };
+
+         static const uint32_t version = 3;
+
+         explicit block_log_archive( const fc::path& archive_dir );
+         block_log_archive( block_log_archive&& other );
+         ~block_log_archive();
+
+         signed_block_ptr read_block_by_num( uint32_t block_num )const;
+
+         /// 0 if the archive holds no segments
+         uint32_t first_block_num()const;
+         uint32_t last_block_num()const;
+
+         /// false if a segment is missing between the first and the last block
+         bool is_contiguous()const;
+
+         const genesis_state& genesis()const;
+
+         /**
+          * Writes the blocks of the block log in blocks_dir, from first_block_num onwards, as segments in
+          * archive_dir. Segments already present in archive_dir are kept, so an archive can be extended as the
+          * block log grows; a last segment that was not full is rewritten.
+          */
+         static void create( const fc::path& blocks_dir, const fc::path& archive_dir, const options& opts,
+                             uint32_t first_block_num = 0 );
+
+         /**
+          * Writes a block log into blocks_dir holding every block of the archive, starting a partial log when
+          * the archive does not begin at block 1. blocks_dir must not contain a block log.
+          */
+         static void extract( const fc::path& archive_dir, const fc::path& blocks_dir );
+
+      private:
+         std::unique_ptr<detail::block_log_archive_impl> my;
+   };
+
+} }
@@ -25,15 +25,23 @@ namespace eosio { namespace chain {
       /// this data is redundant with the data stored in block, but facilitates
       /// recapturing transactions when we pop a block
       vector<transaction_metadata_ptr>                    trxs;
+
+      /// `block` packed on first use, then shared by the block log, the fork database journal and the plugins that
+      /// send or export it; only call once the block is final
+      std::shared_ptr<const vector<char>> packed_block()const;
+
+   private:
+      mutable std::shared_ptr<const vector<char>>         _packed_block; ///< only accessed with atomic_load and atomic_store
    };
 
    using block_state_ptr = std::shared_ptr<block_state>;
 
    struct block_state_with_action_digests {
-      block_state_ptr block_state;
-      vector<digest_type> action_digests;
+      block_state_ptr                             block_state;
+      std::shared_ptr<const vector<digest_type>>  action_digests;   ///< shared with the controller, never modified
 
-      block_state_with_action_digests(block_state_ptr b, const vector<digest_type>& a) : block_state(b), action_digests(a) {}
+      block_state_with_action_digests(block_state_ptr b, std::shared_ptr<const vector<digest_type>> a)
+      : block_state(std::move(b)), action_digests(std::move(a)) {}
    };
 
    using block_state_with_action_digests_ptr = std::shared_ptr<block_state_with_action_digests>;
@@ -20,6 +20,10 @@ const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 bl
 
 const static auto default_state_dir_name     = "state";
 const static auto forkdb_filename            = "forkdb.dat";
+const static auto forkdb_journal_compaction_size = 32*1024*1024ll; ///< size of a fork database journal segment before it is merged with the older ones
+const static auto wasm_cache_filename        = "wasm_cache.dat";
+const static auto state_layout_filename      = "state_layout.dat";
+const static auto read_replica_filename      = "read_replica.bin";
 const static auto default_state_size            = 1*1024*1024*1024ll;
 const static auto default_state_guard_size      =    128*1024*1024ll;
 
@@ -96,6 +100,22 @@ const static uint32_t   hashing_checktime_block_size       = 10*1024;  /// call
 
 const static eosio::chain::wasm_interface::vm_type default_wasm_runtime = eosio::chain::wasm_interface::vm_type::wabt;
 const static uint32_t   default_abi_serializer_max_time_ms = 15*1000; ///< default deadline for abi serialization methods
+const static uint64_t   default_wasm_cache_size            = 1024*1024*1024ll; ///< estimated bytes of instantiated contracts kept in memory
+const static uint32_t   default_wasm_cache_max_entries     = 1024;
+const static uint32_t   default_wasm_compile_threads       = 2;
+const static uint32_t   default_signature_recovery_threads = 4;
+const static uint32_t   default_snapshot_threads           = 4;
+const static uint32_t   signal_dispatch_max_pending        = 1024; ///< handlers a subscriber of the signal_dispatcher lets wait before signals block
+const static uint64_t   snapshot_max_buffered_section_size = 256*1024*1024ll;  ///< larger snapshot sections are loaded straight from the file rather than on a worker
+const static uint32_t   snapshot_tables_per_part           = 1024;  ///< contract tables serialized together when writing a snapshot in parallel
+const static uint32_t   snapshot_frame_size                = 4*1024*1024;  ///< uncompressed bytes of rows per frame of a compressed snapshot
+const static uint32_t   block_log_cache_size               = 256;  ///< recently read irreversible blocks kept deserialized
+const static uint32_t   max_prevalidated_blocks            = 64;  ///< blocks whose transactions may be prepared ahead of being pushed
+const static uint32_t   default_hot_state_cache_rows       = 64*1024; ///< contract table rows found by primary key kept at hand
+const static uint32_t   default_signature_recovery_cache_size = 64*1024; ///< keys recovered from signatures kept process wide
+const static uint64_t   default_prepared_code_cache_size   = 256*1024*1024ll;  ///< injected binaries shared by every controller in the process
+const static uint32_t   default_wasm_tier_up_threshold     = 100;  ///< invocations on wabt before the tiered runtime moves a contract to wavm
+const static uint64_t   default_wasm_jit_fast_compile_size = 512*1024;  ///< injected code size from which wavm skips most LLVM optimizations
 
 /**
  *  The number of sequential blocks produced by a single producer
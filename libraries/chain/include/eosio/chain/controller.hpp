@@ -1,5 +1,6 @@
 #pragma once
 #include <eosio/chain/block_state.hpp>
+#include <eosio/chain/state_deltas.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/genesis_state.hpp>
 #include <boost/signals2/signal.hpp>
@@ -30,10 +31,15 @@ namespace eosio { namespace chain {
    class core_symbol_object;
    class permission_object;
    class account_object;
+   class table_id_object;
    using resource_limits::resource_limits_manager;
    using apply_handler = std::function<void(apply_context&)>;
 
    class fork_database;
+   class execution_profiler;
+   class read_replica_segment;
+   class hot_state_cache;
+   class signal_dispatcher;
 
    enum class db_read_mode {
       SPECULATIVE,
@@ -47,6 +53,12 @@ namespace eosio { namespace chain {
       LIGHT
    };
 
+   enum class db_map_mode {
+      MAPPED,    ///< plain file mapping, pages are faulted in and written back by the kernel as it sees fit
+      LOCKED,    ///< the whole mapping is read in at startup and locked in memory
+      HUGEPAGES  ///< as LOCKED, also asking for the mapping to be backed by huge pages
+   };
+
    class controller {
       public:
 
@@ -64,16 +76,33 @@ namespace eosio { namespace chain {
             uint64_t                 reversible_cache_size  =  chain::config::default_reversible_cache_size;
             uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             bool                     read_only              =  false;
+            bool                     enable_read_replicas   =  false;   ///< let other processes follow this chain state, see read_replica_segment
+            path                     read_replica_of;                   ///< state dir of the node this one follows as a read replica
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
+            optional<fc::sha256>     trusted_replay_checksum;   ///< checksum of blocks.log that enables a trusted replay
             bool                     contracts_console      =  false;
             bool                     allow_ram_billing_in_notify = false;
 
             genesis_state            genesis;
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
+            uint64_t                 wasm_cache_size        =  chain::config::default_wasm_cache_size;
+            uint32_t                 wasm_cache_max_entries =  chain::config::default_wasm_cache_max_entries;
+            flat_set<account_name>   wasm_cache_pinned_accounts = { chain::config::system_account_name };
+            uint32_t                 wasm_compile_threads   =  chain::config::default_wasm_compile_threads;
+            uint32_t                 wasm_tier_up_threshold =  chain::config::default_wasm_tier_up_threshold;
+            uint64_t                 wasm_jit_fast_compile_size = chain::config::default_wasm_jit_fast_compile_size;
+            bool                     profile_execution      =  false;
+            bool                     profile_transaction_phases = false;
+            uint32_t                 signature_recovery_threads = chain::config::default_signature_recovery_threads;
+            uint32_t                 snapshot_threads       =  chain::config::default_snapshot_threads;
+            uint32_t                 hot_state_cache_rows   =  chain::config::default_hot_state_cache_rows; ///< 0 disables the hot_state_cache
+            uint32_t                 signature_recovery_cache_size = chain::config::default_signature_recovery_cache_size; ///< 0 disables it
+            uint32_t                 signal_dispatch_threads = 0; ///< 0 runs every signal handler on the emitting thread
 
             db_read_mode             read_mode              = db_read_mode::SPECULATIVE;
             validation_mode          block_validation_mode  = validation_mode::FULL;
+            db_map_mode              state_map_mode         = db_map_mode::MAPPED;
 
             flat_set<account_name>   resource_greylist;
             flat_set<account_name>   trusted_producers;
@@ -124,11 +153,35 @@ namespace eosio { namespace chain {
           */
          vector<transaction_id_type> get_scheduled_transactions() const;
 
+         /**
+          * Where a batched walk of the scheduled transactions resumes; a default constructed cursor starts at the
+          * first one.
+          */
+         struct scheduled_transactions_cursor {
+            time_point delay_until;
+            int64_t    id = 0;
+         };
+
+         /**
+          * The next max of those transaction IDs after cursor, in the same order, leaving out the ones skip returns
+          * true for, and moves cursor past the last one looked at. Lets a producer work through a large backlog of
+          * due transactions in batches without walking the ones it has already seen again.
+          */
+         vector<transaction_id_type> get_scheduled_transactions( size_t max, scheduled_transactions_cursor& cursor,
+                                                                 const std::function<bool(const transaction_id_type&)>& skip ) const;
+
          /**
           *
           */
          transaction_trace_ptr push_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline, uint32_t billed_cpu_time_us = 0 );
 
+         /**
+          * Executes trx on top of the pending block and undoes it, whether it succeeded or not. Nothing is added to
+          * the block, no signal is emitted and the unapplied transactions are left alone; the returned trace carries
+          * the receipt the transaction would have been given.
+          */
+         transaction_trace_ptr dry_run_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline );
+
          /**
           * Attempt to execute a specific transaction in our deferred trx database
           *
@@ -142,6 +195,13 @@ namespace eosio { namespace chain {
 
          void push_block( const signed_block_ptr& b, block_status s = block_status::complete );
 
+         /**
+          * Call this method for blocks that are expected to be pushed soon, e.g. ones queued behind others from the
+          * network. The block's transactions are unpacked and their signing keys recovered in the background so
+          * that push_block finds the work done.
+          */
+         void prevalidate_block( const signed_block_ptr& b );
+
          /**
           * Call this method when a producer confirmation is received, this might update
           * the last bft irreversible block and/or cause a switch of forks
@@ -160,6 +220,9 @@ namespace eosio { namespace chain {
          resource_limits_manager&              get_mutable_resource_limits_manager();
          const authorization_manager&          get_authorization_manager()const;
          authorization_manager&                get_mutable_authorization_manager();
+         hot_state_cache&                      get_mutable_hot_state_cache();
+         /// for subscribers whose handlers may run off the main thread, connected through a subscriber of it
+         signal_dispatcher&                    get_signal_dispatcher();
 
          const flat_set<account_name>&   get_actor_whitelist() const;
          const flat_set<account_name>&   get_actor_blacklist() const;
@@ -212,6 +275,7 @@ namespace eosio { namespace chain {
          void check_contract_list( account_name code )const;
          void check_action_list( account_name code, action_name action )const;
          void check_key_list( const public_key_type& key )const;
+         bool checks_contract_lists()const; ///< whether check_contract_list or check_action_list can fail
          bool is_producing_block()const;
 
          bool is_ram_billing_in_notify_allowed()const;
@@ -239,6 +303,12 @@ namespace eosio { namespace chain {
 
          bool contracts_console()const;
 
+         /// null unless the controller was configured with profile_execution
+         execution_profiler* get_execution_profiler();
+
+         /// whether transaction traces carry the time spent per transaction_phase
+         bool profiles_transaction_phases()const;
+
          chain_id_type get_chain_id()const;
 
          db_read_mode get_read_mode()const;
@@ -246,10 +316,28 @@ namespace eosio { namespace chain {
 
          void set_subjective_cpu_leeway(fc::microseconds leeway);
 
+         /**
+          * Trimmed traces keep the receipt and exception of each action of a transaction, but not its copy of the
+          * action, its console output, RAM deltas or inline traces, none of which the receipts and merkle roots of a
+          * block are built from. For nodes where nothing reads traces; ignored while contracts_console is on.
+          */
+         void set_trim_action_traces( bool trim );
+         bool trims_action_traces()const;
+
+         /**
+          * A read replica maps the chain state of the node it follows read-only and never changes it: it rejects blocks
+          * and transactions and serves reads only while holding the segment's shared lock. Its head is the one the node
+          * followed published last; the fork database and block log of a replica stay empty.
+          */
+         read_replica_segment* get_read_replica()const; ///< null unless this controller is a read replica
+         bool follow_read_replica_head(); ///< true if the head moved
+
          signal<void(const signed_block_ptr&)>         pre_accepted_block;
          signal<void(const block_state_ptr&)>          accepted_block_header;
          signal<void(const block_state_ptr&)>          accepted_block;
          signal<void(const block_state_with_action_digests_ptr&)> accepted_block_with_action_digests;
+         /// right after accepted_block; the rows written are only tracked while this signal is connected
+         signal<void(const block_state_deltas_ptr&)>   accepted_block_state_deltas;
          signal<void(const block_state_ptr&)>          irreversible_block;
          signal<void(const transaction_metadata_ptr&)> accepted_transaction;
          signal<void(const transaction_trace_ptr&)>    applied_transaction;
@@ -296,6 +384,8 @@ namespace eosio { namespace chain {
          friend class transaction_context;
 
          chainbase::database& mutable_db()const;
+         void add_known_transaction( const transaction_id_type& id, fc::time_point_sec expire );
+         void record_written_row( const table_id_object& table, uint64_t primary_key );
 
          std::unique_ptr<controller_impl> my;
 
@@ -315,9 +405,23 @@ FC_REFLECT( eosio::chain::controller::config,
             (read_only)
             (force_all_checks)
             (disable_replay_opts)
+            (trusted_replay_checksum)
             (contracts_console)
             (genesis)
             (wasm_runtime)
+            (wasm_cache_size)
+            (wasm_cache_max_entries)
+            (wasm_cache_pinned_accounts)
+            (wasm_compile_threads)
+            (wasm_tier_up_threshold)
+            (wasm_jit_fast_compile_size)
+            (profile_execution)
+            (profile_transaction_phases)
+            (signature_recovery_threads)
+            (snapshot_threads)
+            (hot_state_cache_rows)
+            (signature_recovery_cache_size)
+            (signal_dispatch_threads)
             (resource_greylist)
             (trusted_producers)
           )
@@ -460,6 +460,10 @@ namespace eosio { namespace chain {
                                     3170007, "The configured snapshot directory does not exist" )
       FC_DECLARE_DERIVED_EXCEPTION( snapshot_exists_exception,  producer_exception,
                                     3170008, "The requested snapshot already exists" )
+      FC_DECLARE_DERIVED_EXCEPTION( pending_trx_queue_full,  producer_exception,
+                                    3170009, "Too many transactions of the account are waiting to be applied" )
+      FC_DECLARE_DERIVED_EXCEPTION( incoming_trx_rate_limited,  producer_exception,
+                                    3170010, "Too many transactions from the same source" )
 
    FC_DECLARE_DERIVED_EXCEPTION( reversible_blocks_exception,           chain_exception,
                                  3180000, "Reversible Blocks exception" )
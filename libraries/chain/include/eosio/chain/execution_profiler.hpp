@@ -0,0 +1,117 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <chrono>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Names of the host functions that can be profiled, indexed by the id handed out at registration.
+    *  Id 0 is reserved for functions that are not profiled (the injected checktime and friends).
+    */
+   class intrinsic_profile_registry {
+      public:
+         static uint32_t add( const char* module, const char* name );
+         static const vector<const char*>& names();
+   };
+
+   /// id of a registered host function, one per method so the invokers can find it without a lookup
+   template<typename MethodSig, MethodSig Method>
+   struct intrinsic_profile_id {
+      static uint32_t value;
+   };
+
+   template<typename MethodSig, MethodSig Method>
+   uint32_t intrinsic_profile_id<MethodSig, Method>::value = 0;
+
+   struct intrinsic_profile_registrator {
+      intrinsic_profile_registrator( const char* module, const char* name, uint32_t& id ) {
+         id = intrinsic_profile_registry::add( module, name );
+      }
+   };
+
+   /**
+    *  Accumulates the wall time spent executing each (receiver, action) pair and, within it, each host function.
+    *  Only counters and a clock read per call are involved so it can be left enabled on a replica.
+    */
+   class execution_profiler {
+      public:
+         struct intrinsic_stats {
+            uint64_t calls = 0;
+            uint64_t time_ns = 0;
+         };
+
+         struct action_stats {
+            uint64_t                calls = 0;
+            uint64_t                time_ns = 0;   ///< including time spent in host functions
+            vector<intrinsic_stats> intrinsics;    ///< indexed by intrinsic profile id
+         };
+
+         struct intrinsic_entry {
+            string   name;
+            uint64_t calls = 0;
+            uint64_t time_us = 0;
+         };
+
+         struct action_entry {
+            account_name            receiver;
+            action_name             action;
+            uint64_t                calls = 0;
+            uint64_t                time_us = 0;
+            vector<intrinsic_entry> intrinsics;
+         };
+
+         typedef std::chrono::steady_clock clock;
+
+         class action_scope {
+            public:
+               action_scope( execution_profiler* p, account_name receiver, action_name act ) : profiler(p) {
+                  if( profiler ) profiler->begin_action( receiver, act );
+               }
+               ~action_scope() {
+                  if( profiler ) profiler->end_action();
+               }
+            private:
+               execution_profiler* profiler;
+         };
+
+         class intrinsic_scope {
+            public:
+               intrinsic_scope( execution_profiler* p, uint32_t id ) : profiler(id ? p : nullptr), id(id) {
+                  if( profiler ) start = clock::now();
+               }
+               ~intrinsic_scope() {
+                  if( profiler ) profiler->record_intrinsic( id, clock::now() - start );
+               }
+            private:
+               execution_profiler* profiler;
+               uint32_t            id;
+               clock::time_point   start;
+         };
+
+         void begin_action( account_name receiver, action_name act );
+         void end_action();
+         void record_intrinsic( uint32_t id, clock::duration d );
+
+         /// profile sorted by total time, most expensive first
+         vector<action_entry> report() const;
+
+         /// one line per stack as consumed by flamegraph.pl: "receiver;action[;intrinsic] microseconds"
+         string folded_stacks() const;
+
+         void reset();
+
+      private:
+         std::map<std::pair<account_name, action_name>, action_stats> actions;
+         action_stats*      current = nullptr;
+         clock::time_point  current_start;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::execution_profiler::intrinsic_entry, (name)(calls)(time_us) )
+FC_REFLECT( eosio::chain::execution_profiler::action_entry, (receiver)(action)(calls)(time_us)(intrinsics) )
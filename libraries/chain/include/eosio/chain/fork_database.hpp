@@ -27,6 +27,15 @@ namespace eosio { namespace chain {
 
          void close();
 
+         /**
+          *  Stops journaling changes and drops the journal written so far. While the block log is replayed every
+          *  block would otherwise be journaled only to be pruned as irreversible right after it is applied.
+          */
+         void pause_journal();
+
+         /// writes the blocks held now to a fresh journal and journals the changes that follow again
+         void resume_journal();
+
          block_state_ptr  get_block(const block_id_type& id)const;
          block_state_ptr  get_block_in_current_chain_by_num( uint32_t n )const;
 //         vector<block_state_ptr>    get_blocks_by_number(uint32_t n)const;
@@ -16,6 +16,27 @@
 namespace eosio { namespace chain {
    using boost::multi_index_container;
    using namespace boost::multi_index;
+
+   /**
+    * The packed transaction of a generated_transaction_object, kept apart from the scheduling fields and their five
+    * indices so that modifying the scheduling object only copies a handle into the undo state. Never modified: a
+    * replaced transaction gets a new payload and the old one is removed.
+    */
+   class generated_transaction_payload_object : public chainbase::object<generated_transaction_payload_object_type, generated_transaction_payload_object>
+   {
+         OBJECT_CTOR(generated_transaction_payload_object, (packed_trx) )
+
+         id_type                       id;
+         shared_blob                   packed_trx;
+   };
+
+   using generated_transaction_payload_index = chainbase::shared_multi_index_container<
+      generated_transaction_payload_object,
+      indexed_by<
+         ordered_unique< tag<by_id>, BOOST_MULTI_INDEX_MEMBER(generated_transaction_payload_object, generated_transaction_payload_object::id_type, id)>
+      >
+   >;
+
    /**
     * The purpose of this object is to store transactions generated by processing the
     * transactions included in the chain.  These transactions should be treated like
@@ -24,7 +45,7 @@ namespace eosio { namespace chain {
     */
    class generated_transaction_object : public chainbase::object<generated_transaction_object_type, generated_transaction_object>
    {
-         OBJECT_CTOR(generated_transaction_object, (packed_trx) )
+         OBJECT_CTOR(generated_transaction_object)
 
          id_type                       id;
          transaction_id_type           trx_id;
@@ -34,17 +55,49 @@ namespace eosio { namespace chain {
          time_point                    delay_until; /// this generated transaction will not be applied until the specified time
          time_point                    expiration; /// this generated transaction will not be applied after this time
          time_point                    published;
-         shared_blob                   packed_trx;
+         generated_transaction_payload_object::id_type payload;
+         uint32_t                      packed_trx_size = 0; ///< of the payload, which RAM is billed for
+
+         const shared_blob& packed_trx( const chainbase::database& db )const {
+            return db.get<generated_transaction_payload_object>( payload ).packed_trx;
+         }
 
-         uint32_t set( const transaction& trx ) {
+         /// creates the payload of `trx`; the caller sets it on the object and removes the payload it replaces
+         static const generated_transaction_payload_object& create_payload( chainbase::database& db, const transaction& trx ) {
             auto trxsize = fc::raw::pack_size( trx );
-            packed_trx.resize( trxsize );
-            fc::datastream<char*> ds( packed_trx.data(), trxsize );
-            fc::raw::pack( ds, trx );
-            return trxsize;
+            return db.create<generated_transaction_payload_object>( [&]( auto& p ) {
+               p.packed_trx.resize( trxsize );
+               fc::datastream<char*> ds( p.packed_trx.data(), trxsize );
+               fc::raw::pack( ds, trx );
+            });
+         }
+
+         void set_payload( const generated_transaction_payload_object& p ) {
+            payload = p.id;
+            packed_trx_size = p.packed_trx.size();
          }
    };
 
+   /// removes a generated transaction along with its payload
+   inline void remove_generated_transaction( chainbase::database& db, const generated_transaction_object& gto ) {
+      db.remove( db.get<generated_transaction_payload_object>( gto.payload ) );
+      db.remove( gto );
+   }
+
+   /**
+    * generated transactions are stored in snapshots with their packed transaction inlined, as before it was split off
+    */
+   struct snapshot_generated_transaction_object {
+      transaction_id_type           trx_id;
+      account_name                  sender;
+      uint128_t                     sender_id = 0;
+      account_name                  payer;
+      time_point                    delay_until;
+      time_point                    expiration;
+      time_point                    published;
+      bytes                         packed_trx;
+   };
+
    struct by_trx_id;
    struct by_expiration;
    struct by_delay;
@@ -80,7 +133,7 @@ namespace eosio { namespace chain {
    class generated_transaction
    {
       public:
-         generated_transaction(const generated_transaction_object& gto)
+         generated_transaction(const generated_transaction_object& gto, const chainbase::database& db)
          :trx_id(gto.trx_id)
          ,sender(gto.sender)
          ,sender_id(gto.sender_id)
@@ -88,7 +141,7 @@ namespace eosio { namespace chain {
          ,delay_until(gto.delay_until)
          ,expiration(gto.expiration)
          ,published(gto.published)
-         ,packed_trx(gto.packed_trx.begin(), gto.packed_trx.end())
+         ,packed_trx(gto.packed_trx(db).begin(), gto.packed_trx(db).end())
          {}
 
          generated_transaction(const generated_transaction& gt) = default;
@@ -115,5 +168,8 @@ namespace eosio { namespace chain {
 } } // eosio::chain
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::generated_transaction_object, eosio::chain::generated_transaction_multi_index)
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::generated_transaction_payload_object, eosio::chain::generated_transaction_payload_index)
 
-FC_REFLECT(eosio::chain::generated_transaction_object, (trx_id)(sender)(sender_id)(payer)(delay_until)(expiration)(published)(packed_trx))
\ No newline at end of file
+FC_REFLECT(eosio::chain::generated_transaction_object, (trx_id)(sender)(sender_id)(payer)(delay_until)(expiration)(published)(payload)(packed_trx_size))
+FC_REFLECT(eosio::chain::generated_transaction_payload_object, (packed_trx))
+FC_REFLECT(eosio::chain::snapshot_generated_transaction_object, (trx_id)(sender)(sender_id)(payer)(delay_until)(expiration)(published)(packed_trx))
\ No newline at end of file
@@ -51,6 +51,13 @@ namespace eosio { namespace chain {
 
         id_type    id;
         uint64_t   global_action_sequence = 0;
+
+        /**
+         * Tag of the current set of permissions, changed by the authorization manager whenever a permission is
+         * created, modified or removed. Lives in the database so that undoing a session restores the tag along with
+         * the permissions it describes; it is not part of the snapshot.
+         */
+        uint64_t   authority_revision = 0;
    };
 
    using global_property_multi_index = chainbase::shared_multi_index_container<
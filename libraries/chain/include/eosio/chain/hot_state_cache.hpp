@@ -0,0 +1,125 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/contract_table_objects.hpp>
+
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * The contract table rows found by primary key lately, by (table, primary key), in front of the by_scope_primary
+    * index of chainbase, which stays the source of truth. It is a flat open-addressed table of pointers to the rows, so
+    * a hit is a probe or two of one contiguous array rather than a walk down the nodes of the index; the rows of the
+    * few tables nearly every transaction touches (token balances of exchanges, the global state of the system
+    * contract, the RAM market) stay in it.
+    *
+    * The pointers are only valid as long as the rows are in the database: apply_context removes a row from the cache
+    * as it removes it from the database, and the cache is cleared whenever changes are undone, as rows they created
+    * are then gone. Rows modified in place stay valid. When max_rows rows are cached it starts over empty.
+    */
+   class hot_state_cache {
+      public:
+         explicit hot_state_cache( uint32_t max_rows = 0 ) { set_max_rows( max_rows ); }
+
+         /// 0 disables the cache
+         void set_max_rows( uint32_t max_rows ) {
+            _max_rows = max_rows;
+            size_t capacity = 0;
+            if( max_rows ) {
+               capacity = 2; // at most half full, so probe sequences stay short
+               while( capacity < uint64_t(max_rows) * 2 )
+                  capacity *= 2;
+            }
+            _slots.assign( capacity, slot() );
+            _size = 0;
+         }
+
+         bool enabled()const { return _max_rows > 0; }
+
+         const key_value_object* find( table_id t_id, uint64_t primary_key )const {
+            if( !_size )
+               return nullptr;
+            for( size_t i = home( t_id, primary_key ); _slots[i].row; i = next( i ) ) {
+               if( _slots[i].t_id == t_id && _slots[i].primary_key == primary_key )
+                  return _slots[i].row;
+            }
+            return nullptr;
+         }
+
+         void add( const key_value_object& row ) {
+            if( !enabled() )
+               return;
+            if( _size >= _max_rows )
+               clear();
+            size_t i = home( row.t_id, row.primary_key );
+            for( ; _slots[i].row; i = next( i ) ) {
+               if( _slots[i].t_id == row.t_id && _slots[i].primary_key == row.primary_key ) {
+                  _slots[i].row = &row;
+                  return;
+               }
+            }
+            _slots[i] = slot{ row.t_id, row.primary_key, &row };
+            ++_size;
+         }
+
+         /// before the row is removed from the database
+         void remove( const key_value_object& row ) {
+            if( !_size )
+               return;
+            size_t i = home( row.t_id, row.primary_key );
+            for( ; _slots[i].row; i = next( i ) ) {
+               if( _slots[i].t_id == row.t_id && _slots[i].primary_key == row.primary_key )
+                  break;
+            }
+            if( !_slots[i].row )
+               return;
+
+            // shifts the rows that probed past the slot back, so that no probe sequence is broken by the hole
+            for( size_t j = next( i ); _slots[j].row; j = next( j ) ) {
+               size_t h = home( _slots[j].t_id, _slots[j].primary_key );
+               bool reachable_from_hole = i <= j ? ( h <= i || h > j ) : ( h <= i && h > j );
+               if( reachable_from_hole ) {
+                  _slots[i] = _slots[j];
+                  i = j;
+               }
+            }
+            _slots[i] = slot();
+            --_size;
+         }
+
+         void clear() {
+            if( !_size )
+               return;
+            std::fill( _slots.begin(), _slots.end(), slot() );
+            _size = 0;
+         }
+
+         size_t size()const { return _size; }
+
+      private:
+         struct slot {
+            table_id                   t_id;
+            uint64_t                   primary_key = 0;
+            const key_value_object*    row = nullptr;
+         };
+
+         size_t home( table_id t_id, uint64_t primary_key )const {
+            uint64_t h = primary_key + uint64_t(t_id._id) * 0x9e3779b97f4a7c15ull;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return h & ( _slots.size() - 1 );
+         }
+
+         size_t next( size_t i )const { return ( i + 1 ) & ( _slots.size() - 1 ); }
+
+         uint32_t             _max_rows = 0;
+         size_t               _size = 0;
+         std::vector<slot>    _slots;
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,125 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      /// slots of the per thread shards, threads beyond that share slots
+      constexpr uint32_t metric_shards = 16;
+      /// the slot of the calling thread, handed out round robin on first use
+      uint32_t metric_shard();
+
+      struct alignas(64) metric_cell {
+         std::atomic<uint64_t> value{0};
+      };
+   }
+
+   /// monotonic count, incremented without locks in the shard of the calling thread
+   class metric_counter {
+      public:
+         void add( uint64_t n = 1 ) {
+            shards[detail::metric_shard()].value.fetch_add( n, std::memory_order_relaxed );
+         }
+         uint64_t value()const;
+
+      private:
+         detail::metric_cell shards[detail::metric_shards];
+   };
+
+   /// current level of something, such as the depth of a queue
+   class metric_gauge {
+      public:
+         void set( int64_t v ) { current.store( v, std::memory_order_relaxed ); }
+         void add( int64_t n ) { current.fetch_add( n, std::memory_order_relaxed ); }
+         int64_t value()const { return current.load( std::memory_order_relaxed ); }
+
+      private:
+         std::atomic<int64_t> current{0};
+   };
+
+   /**
+    *  Durations counted in fixed buckets, per thread like metric_counter. Bucket bounds are in microseconds and
+    *  reported in seconds, as Prometheus expects.
+    */
+   class metric_histogram {
+      public:
+         explicit metric_histogram( vector<int64_t> bounds_us );
+
+         void observe( fc::microseconds d );
+
+         const vector<int64_t>& bounds()const { return bounds_us; }
+         /// per bucket, not cumulative, the last one without an upper bound
+         vector<uint64_t> counts()const;
+         uint64_t sum_us()const;
+
+         /// 50us to 10s, for work done on the chain thread
+         static const vector<int64_t>& default_bounds();
+
+      private:
+         size_t stride()const { return bounds_us.size() + 2; } ///< buckets and the sum
+
+         vector<int64_t>                       bounds_us;
+         std::unique_ptr<detail::metric_cell[]> cells;       ///< metric_shards times stride
+   };
+
+   /// observes the time from construction to destruction
+   class scoped_metric_timer {
+      public:
+         explicit scoped_metric_timer( metric_histogram& h ) : histogram(h), start( fc::time_point::now() ) {}
+         ~scoped_metric_timer() { histogram.observe( fc::time_point::now() - start ); }
+
+      private:
+         metric_histogram& histogram;
+         fc::time_point    start;
+   };
+
+   typedef vector<std::pair<string,string>> metric_labels;
+
+   /**
+    *  Process wide set of named metrics, rendered in the Prometheus text exposition format.
+    *
+    *  Looking a metric up takes a lock, so callers look it up once and keep the reference, which stays valid for
+    *  the life of the process. Updating a metric never takes a lock. Metrics of one name share their help and type
+    *  and are told apart by their labels.
+    */
+   class metrics_registry {
+      public:
+         static metrics_registry& instance();
+
+         metric_counter&   counter( const string& name, const string& help, const metric_labels& labels = metric_labels() );
+         metric_gauge&     gauge( const string& name, const string& help, const metric_labels& labels = metric_labels() );
+         metric_histogram& histogram( const string& name, const string& help, const metric_labels& labels = metric_labels(),
+                                      const vector<int64_t>& bounds_us = metric_histogram::default_bounds() );
+
+         string to_prometheus()const;
+
+      private:
+         enum class metric_type { counter, gauge, histogram };
+
+         struct family {
+            metric_type type;
+            string      help;
+            // keyed by the rendered labels
+            std::map<string, std::unique_ptr<metric_counter>>   counters;
+            std::map<string, std::unique_ptr<metric_gauge>>     gauges;
+            std::map<string, std::unique_ptr<metric_histogram>> histograms;
+         };
+
+         family& get_family( const string& name, const string& help, metric_type type );
+
+         mutable std::mutex      mtx;
+         std::map<string,family> families;
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,64 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/block_header_state.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  A small file next to the shared_memory.bin of a node that read replicas follow: other processes on the host that
+    *  map that chain state read-only and serve reads from it, without applying blocks themselves.
+    *
+    *  The file holds a process-shared reader/writer lock, which the node takes exclusively around every change of its
+    *  chain state and the replicas take shared around every read, and the packed header state of the node's head
+    *  block, published with a revision that is bumped and signalled to the waiting replicas every time the head moves.
+    *
+    *  BasicLockable for the exclusive lock and provides lock_shared/unlock_shared, so std::unique_lock and
+    *  std::shared_lock can hold it.
+    */
+   class read_replica_segment {
+      public:
+         /**
+          *  The node followed creates or resets the file in its state dir; a replica opens the one in the state dir of
+          *  the node it follows, which must be running already.
+          */
+         read_replica_segment( const fc::path& state_dir, bool followed );
+         ~read_replica_segment();
+
+         read_replica_segment( const read_replica_segment& ) = delete;
+         read_replica_segment& operator=( const read_replica_segment& ) = delete;
+
+         void lock();
+         void unlock();
+         void lock_shared();
+         void unlock_shared();
+
+         /// the node followed, holding the exclusive lock
+         void publish_head( const chain_id_type& chain_id, const block_header_state& head );
+
+         /// 0 until a head is published
+         uint64_t revision()const;
+
+         /// a replica, holding the shared lock
+         chain_id_type      chain_id()const;
+         block_header_state head()const;
+
+         /// blocks until the revision moves past `known` or the timeout expires; true if it moved
+         bool wait_for_revision( uint64_t known, const fc::microseconds& timeout );
+
+      private:
+         struct shared_data;
+
+         boost::interprocess::file_mapping    mapping;
+         boost::interprocess::mapped_region   region;
+         shared_data*                         data = nullptr;
+   };
+
+} } /// eosio::chain
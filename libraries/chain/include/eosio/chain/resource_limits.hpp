@@ -13,6 +13,9 @@ namespace eosio { namespace chain { namespace resource_limits {
          T numerator;
          T denominator;
       };
+
+      struct pending_account_usage;
+      class  pending_usage_journal;
    }
 
    using ratio = impl::ratio<uint64_t>;
@@ -37,10 +40,12 @@ namespace eosio { namespace chain { namespace resource_limits {
 
    class resource_limits_manager {
       public:
-         explicit resource_limits_manager(chainbase::database& db)
-         :_db(db)
-         {
-         }
+         /**
+          *  A read replica maps the state of the node it follows but not its in-process journal of pending usage,
+          *  so with committed_usage_only the usage of accounts is read from their rows, as of the head block
+          */
+         explicit resource_limits_manager(chainbase::database& db, bool committed_usage_only = false);
+         ~resource_limits_manager();
 
          void add_indices();
          void initialize_database();
@@ -79,7 +84,13 @@ namespace eosio { namespace chain { namespace resource_limits {
          int64_t get_account_ram_usage( const account_name& name ) const;
 
       private:
-         chainbase::database& _db;
+         /// usage of the account written by the transactions of the pending block, nullptr if there is none
+         const impl::pending_account_usage* find_pending_usage( const account_name& account )const;
+         void sync_pending_usage()const;
+
+         chainbase::database&                          _db;
+         std::unique_ptr<impl::pending_usage_journal>  _pending_usage;
+         bool                                          _committed_usage_only = false;
    };
 } } } /// eosio::chain
 
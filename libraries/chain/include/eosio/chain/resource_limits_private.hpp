@@ -249,6 +249,13 @@ namespace eosio { namespace chain { namespace resource_limits {
        */
       uint64_t virtual_cpu_limit = 0ULL;
 
+      /**
+       * Number of pending usage journal entries written by the transactions applied so far in the pending block.
+       * It is kept here so that it is undone together with the session of a failed transaction; it is not part of
+       * snapshots since it is always 0 between blocks.
+       */
+      uint32_t pending_usage_entries = 0;
+
    };
 
    using resource_limits_state_index = chainbase::shared_multi_index_container<
@@ -0,0 +1,87 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <boost/asio/io_service.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Runs the handlers that subscribers marked thread-safe connect to the signals of the controller on threads of
+    *  its own, so that a slow exporter does not hold up applying the next block. The handlers of one subscriber run
+    *  one at a time, in the order the signals were emitted, whichever signals they are connected to; the handlers of
+    *  different subscribers run concurrently.
+    *
+    *  Without threads every handler runs inline on the emitting thread, as handlers connected to the signals directly
+    *  do. A handler run on a dispatch thread cannot abort the block by throwing: what it throws is logged.
+    */
+   class signal_dispatcher {
+      public:
+         class subscriber;
+         using subscriber_ptr = std::shared_ptr<subscriber>;
+
+         /// max_pending handlers of a subscriber at most wait to run, beyond which the emitting thread waits
+         signal_dispatcher( uint32_t threads_count, uint32_t max_pending_handlers );
+         ~signal_dispatcher();
+
+         /// runs what is pending, then joins the threads; handlers posted afterwards run inline
+         void stop();
+
+         bool running()const { return !threads.empty(); }
+
+         subscriber_ptr make_subscriber( const std::string& name );
+
+      private:
+         void schedule( const subscriber_ptr& s );
+
+         uint32_t                                          max_pending;
+         boost::asio::io_service                           ios;
+         std::unique_ptr<boost::asio::io_service::work>    work;
+         std::vector<std::thread>                          threads;
+   };
+
+   class signal_dispatcher::subscriber : public std::enable_shared_from_this<subscriber> {
+      public:
+         subscriber( signal_dispatcher& dispatcher, const std::string& name );
+
+         /// runs f after everything posted before it
+         void post( std::function<void()> f );
+
+         /// waits until everything posted so far has run, e.g. before what the handlers feed is stopped
+         void flush();
+
+         /// connects h to the signal, to run as posted to this subscriber
+         template<typename Signal, typename Handler>
+         auto connect( Signal& signal, Handler h ) {
+            return signal.connect( [self = shared_from_this(), h]( const auto& arg ) {
+               self->post( [h, arg]() { h( arg ); } );
+            } );
+         }
+
+         const std::string& name()const { return _name; }
+
+      private:
+         friend class signal_dispatcher;
+
+         void drain();
+
+         signal_dispatcher&                   _dispatcher;
+         std::string                          _name;
+         std::mutex                           _mutex;
+         std::condition_variable              _cond;
+         std::deque<std::function<void()>>    _pending;
+         bool                                 _draining = false; ///< scheduled on, or running on, a dispatch thread
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,54 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  The keys recovered from signatures lately, process wide, by the digest signed and the signature. A transaction
+    *  is recovered as it arrives, as it is pushed, as it is retried after its block was aborted and as the block that
+    *  includes it is validated, each time with new metadata; a signature only costs a recovery the first time.
+    *
+    *  The entries are split over shards of their own lock, so the threads recovering the keys of a block do not
+    *  contend; each shard drops its oldest entries past its part of the capacity.
+    */
+   class signature_recovery_cache {
+      public:
+         static signature_recovery_cache& instance();
+
+         /// the key that signed digest, canonical signatures only
+         public_key_type recover( const signature_type& sig, const digest_type& digest );
+
+         /// 0 disables the cache; entries past the new capacity are dropped as new ones arrive
+         void set_capacity( uint32_t entries );
+
+         size_t size()const;
+         void clear();
+
+      private:
+         static constexpr uint32_t shards = 16;
+
+         struct key_hash {
+            size_t operator()( const digest_type& k )const { return k._hash[0]; }
+         };
+
+         struct shard {
+            mutable std::mutex                                                  mtx;
+            std::unordered_map<digest_type, public_key_type, key_hash>          keys;  // guarded by `mtx`
+            std::deque<digest_type>                                             order; // oldest first, guarded by `mtx`
+         };
+
+         std::atomic<uint32_t>   shard_capacity{ config::default_signature_recovery_cache_size / shards };
+         shard                   _shards[shards];
+   };
+
+} } /// eosio::chain
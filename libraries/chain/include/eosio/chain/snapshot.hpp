@@ -7,8 +7,12 @@
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fc/variant_object.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/scoped_exit.hpp>
 #include <boost/core/demangle.hpp>
+#include <functional>
 #include <ostream>
+#include <sstream>
 
 namespace eosio { namespace chain {
    /**
@@ -135,8 +139,14 @@ namespace eosio { namespace chain {
                snapshot_writer& _writer;
          };
 
+         typedef std::function<void(section_writer&)> section_function;
+
          template<typename F>
          void write_section(const std::string section_name, F f) {
+            if( queued_sections ) {
+               queued_sections->emplace_back( section_name, section_function( f ) );
+               return;
+            }
             write_start_section(section_name);
             auto section = section_writer(*this);
             f(section);
@@ -148,12 +158,40 @@ namespace eosio { namespace chain {
             write_section(detail::snapshot_section_traits<T>::section_name(), f);
          }
 
+         /**
+          * Calls f and writes the sections it writes once it returns, in the order they were written. Writers that
+          * accept serialized rows serialize these sections on up to `threads` threads, so they must not depend on
+          * each other. Consecutive sections with the same name are written as a single section, which allows a large
+          * section to be split into parts.
+          */
+         template<typename F>
+         void write_sections(uint32_t threads, F f) {
+            vector<std::pair<std::string, section_function>> sections;
+            {
+               queued_sections = &sections;
+               auto reset = fc::make_scoped_exit([this](){ queued_sections = nullptr; });
+               f();
+            }
+            write_queued_sections( sections, threads );
+         }
+
       virtual ~snapshot_writer(){};
 
       protected:
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
          virtual void write_end_section() = 0;
+
+         /// whether the current section can be given rows serialized elsewhere through write_rows
+         virtual bool accepts_serialized_rows() const { return false; }
+         /// applied to serialized rows on the thread that serialized them, before they are given to write_rows
+         virtual std::string encode_rows( std::string rows ) const { return rows; }
+         virtual void write_rows( uint64_t row_count, const std::string& rows ) {}
+
+      private:
+         void write_queued_sections( const vector<std::pair<std::string, section_function>>& sections, uint32_t threads );
+
+         vector<std::pair<std::string, section_function>>* queued_sections = nullptr;
    };
 
    using snapshot_writer_ptr = std::shared_ptr<snapshot_writer>;
@@ -263,8 +301,14 @@ namespace eosio { namespace chain {
 
          };
 
+      typedef std::function<void(section_reader&)> section_function;
+
       template<typename F>
       void read_section(const std::string& section_name, F f) {
+         if( queued_sections ) {
+            queued_sections->emplace_back( section_name, section_function( f ) );
+            return;
+         }
          set_section(section_name);
          auto section = section_reader(*this);
          f(section);
@@ -276,6 +320,22 @@ namespace eosio { namespace chain {
          read_section(detail::snapshot_section_traits<T>::section_name(), f);
       }
 
+      /**
+       * Calls f and reads the sections it reads once it returns. Readers that can hand out the serialized rows of a
+       * section load them on up to `threads` threads, so these sections must not depend on each other and must
+       * only create objects in indices no other section of the batch touches.
+       */
+      template<typename F>
+      void read_sections(uint32_t threads, F f) {
+         vector<std::pair<std::string, section_function>> sections;
+         {
+            queued_sections = &sections;
+            auto reset = fc::make_scoped_exit([this](){ queued_sections = nullptr; });
+            f();
+         }
+         read_queued_sections( sections, threads );
+      }
+
       template<typename T>
       bool has_section(const std::string& suffix = std::string()) {
          return has_section(suffix + detail::snapshot_section_traits<T>::section_name());
@@ -291,6 +351,17 @@ namespace eosio { namespace chain {
          virtual bool read_row( detail::abstract_snapshot_row_reader& row_reader ) = 0;
          virtual bool empty( ) = 0;
          virtual void clear_section() = 0;
+
+         virtual bool provides_serialized_rows() const { return false; }
+         /// size in bytes of the rows of a section
+         virtual uint64_t serialized_rows_size( const std::string& section_name ) { return 0; }
+         /// reads the rows of a section without deserializing them and returns how many there are
+         virtual uint64_t read_serialized_rows( const std::string& section_name, std::string& rows ) { return 0; }
+
+      private:
+         void read_queued_sections( const vector<std::pair<std::string, section_function>>& sections, uint32_t threads );
+
+         vector<std::pair<std::string, section_function>>* queued_sections = nullptr;
    };
 
    using snapshot_reader_ptr = std::shared_ptr<snapshot_reader>;
@@ -338,6 +409,10 @@ namespace eosio { namespace chain {
 
          static const uint32_t magic_number = 0x30510550;
 
+      protected:
+         bool accepts_serialized_rows() const override { return true; }
+         void write_rows( uint64_t row_count, const std::string& rows ) override;
+
       private:
          detail::ostream_wrapper snapshot;
          std::streampos          header_pos;
@@ -357,15 +432,169 @@ namespace eosio { namespace chain {
          bool empty ( ) override;
          void clear_section() override;
 
+      protected:
+         bool provides_serialized_rows() const override { return true; }
+         uint64_t serialized_rows_size( const std::string& section_name ) override;
+         uint64_t read_serialized_rows( const std::string& section_name, std::string& rows ) override;
+
       private:
          bool validate_section() const;
 
          std::istream&  snapshot;
          std::streampos header_pos;
+         std::streampos section_end;
          uint64_t       num_rows;
          uint64_t       cur_row;
    };
 
+   /**
+    * Binary snapshot with zlib compressed sections, written and read strictly front to back so that it can be
+    * piped from or to another host without being staged on disk first.
+    *
+    * After the magic number and version come the sections, each laid out as
+    *
+    * +--------------+---------+-----+---------+-------------+-----------+----------------+
+    * | Name (null   | Frame 1 | ... | Frame N | End of rows | Row Count | Section Digest |
+    * | terminated)  |         |     |         | (uint32 0)  | (uint64)  | (sha256)       |
+    * +--------------+---------+-----+---------+-------------+-----------+----------------+
+    *
+    * followed by an empty name marking the end of the snapshot. A frame is a uint32 length and that many bytes
+    * of zlib compressed rows; rows may continue from one frame into the next. The digest covers every frame,
+    * lengths included, and is checked once the section has been read.
+    */
+   class compressed_ostream_snapshot_writer : public snapshot_writer {
+      public:
+         explicit compressed_ostream_snapshot_writer(std::ostream& snapshot);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         static const uint32_t magic_number = 0x30510551;
+
+      protected:
+         bool accepts_serialized_rows() const override { return true; }
+         std::string encode_rows( std::string rows ) const override;
+         void write_rows( uint64_t row_count, const std::string& frames ) override;
+
+      private:
+         void write_frames( const std::string& frames );
+         void flush_rows();
+
+         std::ostream&        snapshot;
+         std::ostringstream   pending;
+         detail::ostream_wrapper pending_wrapper;
+         fc::sha256::encoder  digest;
+         uint64_t             row_count;
+   };
+
+   /**
+    * Reads a snapshot written by compressed_ostream_snapshot_writer from a stream without seeking. Sections are
+    * expected in the order they were written; a section asked for out of order makes the reader keep the ones it
+    * passes over in memory.
+    */
+   class compressed_istream_snapshot_reader : public snapshot_reader {
+      public:
+         explicit compressed_istream_snapshot_reader(std::istream& snapshot);
+         ~compressed_istream_snapshot_reader();
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+
+      private:
+         class frame_buffer;
+
+         /// reads ahead until the named section is next in the stream, keeping those passed over
+         bool find_section( const string& section_name );
+
+         std::istream&                      snapshot;
+         uint32_t                           version;
+         bool                               at_end = false;
+         map<string, std::string>           passed_sections;
+         std::unique_ptr<std::istringstream> passed_section;
+         std::unique_ptr<frame_buffer>      frames;
+         std::unique_ptr<std::istream>      rows;
+         string                             next_section;   ///< section whose name was read last, its frames come next
+         uint64_t                           cur_row = 0;
+   };
+
+   /// the content defined chunks of the rows of a snapshot, by digest
+   struct snapshot_chunk_index {
+      struct chunk {
+         uint64_t pos = 0;    ///< in the snapshot file, only known for an index built by delta_snapshot_writer::index_snapshot
+         uint32_t size = 0;
+      };
+
+      fc::sha256                 integrity_hash;   ///< of the snapshotted state, as controller::calculate_integrity_hash
+      std::map<fc::sha256, chunk> chunks;
+   };
+
+   /**
+    * Records the state of the chain as the difference to an earlier snapshot, given by the index of its chunks.
+    *
+    * The rows of each section are cut into chunks where a rolling hash of their content says so, which is why
+    * rows created, modified or removed only change the chunks around them. Chunks already in the base are written
+    * as their digest and the others zlib compressed. The layout is
+    *
+    * +-------+---------+------------+-----------+-----+-----------+-----------+-------------+
+    * | Magic | Version | Base State | Section 1 | ... | Section N | Empty     | State       |
+    * |       |         | Digest     |           |     |           | Name      | Digest      |
+    * +-------+---------+------------+-----------+-----+-----------+-----------+-------------+
+    *
+    * where a section is its null terminated name, its chunks and an end marker followed by its row count, and
+    * the digests are the integrity hashes of the base and of the recorded state.
+    *
+    * A delta is applied to the binary snapshot it was taken against, or to the result of applying the deltas
+    * before it, and gives the binary snapshot that would have been written instead.
+    */
+   class delta_snapshot_writer : public snapshot_writer {
+      public:
+         delta_snapshot_writer(std::ostream& delta, const snapshot_chunk_index& base);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         /// chunks of the state written, to take the next delta against
+         const snapshot_chunk_index& index()const { return written; }
+
+         static const uint32_t magic_number = 0x30510552;
+
+         /// indexes a binary snapshot as written by ostream_snapshot_writer
+         static snapshot_chunk_index index_snapshot( std::istream& snapshot );
+
+         /// writes the delta between two binary snapshots
+         static void create( std::istream& base, std::istream& target, std::ostream& delta );
+
+         /// writes the binary snapshot obtained by applying deltas, in order, to a binary snapshot
+         static void apply( const fc::path& base, const vector<fc::path>& deltas, const fc::path& output );
+
+      protected:
+         bool accepts_serialized_rows() const override { return true; }
+         void write_rows( uint64_t row_count, const std::string& rows ) override;
+
+      private:
+         class chunker;
+
+         void flush_rows();
+         void write_chunk( const std::string& chunk );
+
+         std::ostream&                delta;
+         const snapshot_chunk_index&  base;
+         snapshot_chunk_index         written;
+         fc::sha256::encoder          integrity;
+         std::ostringstream           pending;
+         detail::ostream_wrapper      pending_wrapper;
+         std::shared_ptr<chunker>     rows;
+         uint64_t                     row_count;
+   };
+
    class integrity_hash_snapshot_writer : public snapshot_writer {
       public:
          explicit integrity_hash_snapshot_writer(fc::sha256::encoder&  enc);
@@ -375,6 +604,10 @@ namespace eosio { namespace chain {
          void write_end_section( ) override;
          void finalize();
 
+      protected:
+         bool accepts_serialized_rows() const override { return true; }
+         void write_rows( uint64_t row_count, const std::string& rows ) override;
+
       private:
          fc::sha256::encoder&  enc;
 
@@ -0,0 +1,74 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <softfloat.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/**
+ * The float opcodes of a contract are injected as calls to softfloat so that every node computes the same bits.
+ * Addition, subtraction, multiplication, division, square root and the conversions between float and double are
+ * correctly rounded by IEEE 754, so one rounding to nearest even on an SSE2 host gives exactly what softfloat gives,
+ * subnormals included. What IEEE 754 leaves open is which NaN comes out, so a NaN result is computed again with
+ * softfloat and only that case pays for it.
+ *
+ * The native path needs the double and float types to be evaluated in their own precision, which rules out x87, and
+ * the compiler not to reassociate or flush subnormals, which rules out fast math. At run time it needs the MXCSR of
+ * the thread in its default state: rounding to nearest even, subnormals neither flushed to zero (FTZ) nor read as
+ * zero (DAZ), and all exceptions masked. A library may change these for the whole thread, so they are checked before
+ * every native operation and anything else falls back to softfloat.
+ */
+#if defined(__x86_64__) && defined(__SSE2_MATH__) && defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0 && !defined(__FAST_MATH__)
+#define EOSIO_SOFTFLOAT_FAST_PATH 1
+#include <xmmintrin.h>
+#endif
+
+namespace eosio { namespace chain { namespace softfloat_fast_path {
+
+   static_assert( std::numeric_limits<float>::is_iec559 && std::numeric_limits<double>::is_iec559,
+                  "float and double have to be IEEE 754 binary32 and binary64" );
+
+   inline float  to_native( float32_t f ) { float r;  memcpy( &r, &f, sizeof(r) ); return r; }
+   inline double to_native( float64_t f ) { double r; memcpy( &r, &f, sizeof(r) ); return r; }
+   inline float32_t to_softfloat( float f )  { float32_t r; memcpy( &r, &f, sizeof(r) ); return r; }
+   inline float64_t to_softfloat( double f ) { float64_t r; memcpy( &r, &f, sizeof(r) ); return r; }
+
+#ifdef EOSIO_SOFTFLOAT_FAST_PATH
+   /// DAZ, the exception masks, the rounding control and FTZ, ignoring the sticky exception flags
+   constexpr uint32_t mxcsr_control_mask = 0xffc0;
+   constexpr uint32_t mxcsr_default      = 0x1f80;
+
+   inline bool native_rounding() { return ( _mm_getcsr() & mxcsr_control_mask ) == mxcsr_default; }
+
+#define EOSIO_SOFTFLOAT_FAST( native, soft ) \
+   if( native_rounding() ) { auto r = native; if( !std::isnan( r ) ) return to_softfloat( r ); } \
+   return soft;
+#else
+#define EOSIO_SOFTFLOAT_FAST( native, soft ) \
+   return soft;
+#endif
+
+   inline float32_t add( float32_t a, float32_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) + to_native(b), f32_add( a, b ) ) }
+   inline float32_t sub( float32_t a, float32_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) - to_native(b), f32_sub( a, b ) ) }
+   inline float32_t mul( float32_t a, float32_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) * to_native(b), f32_mul( a, b ) ) }
+   inline float32_t div( float32_t a, float32_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) / to_native(b), f32_div( a, b ) ) }
+   inline float32_t sqrt( float32_t a )             { EOSIO_SOFTFLOAT_FAST( std::sqrt( to_native(a) ),   f32_sqrt( a ) ) }
+
+   inline float64_t add( float64_t a, float64_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) + to_native(b), f64_add( a, b ) ) }
+   inline float64_t sub( float64_t a, float64_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) - to_native(b), f64_sub( a, b ) ) }
+   inline float64_t mul( float64_t a, float64_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) * to_native(b), f64_mul( a, b ) ) }
+   inline float64_t div( float64_t a, float64_t b ) { EOSIO_SOFTFLOAT_FAST( to_native(a) / to_native(b), f64_div( a, b ) ) }
+   inline float64_t sqrt( float64_t a )             { EOSIO_SOFTFLOAT_FAST( std::sqrt( to_native(a) ),   f64_sqrt( a ) ) }
+
+   inline float64_t promote( float32_t a ) { EOSIO_SOFTFLOAT_FAST( double( to_native(a) ), f32_to_f64( a ) ) }
+   inline float32_t demote( float64_t a )  { EOSIO_SOFTFLOAT_FAST( float( to_native(a) ),  f64_to_f32( a ) ) }
+
+#undef EOSIO_SOFTFLOAT_FAST
+
+} } } /// eosio::chain::softfloat_fast_path
@@ -0,0 +1,67 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /// a row of a contract table written by an action
+   struct table_row_key {
+      account_name   code;
+      scope_name     scope;
+      table_name     table;
+      uint64_t       primary_key = 0;
+
+      friend bool operator<( const table_row_key& a, const table_row_key& b ) {
+         return std::tie( a.code, a.scope, a.table, a.primary_key ) < std::tie( b.code, b.scope, b.table, b.primary_key );
+      }
+      friend bool operator==( const table_row_key& a, const table_row_key& b ) {
+         return std::tie( a.code, a.scope, a.table, a.primary_key ) == std::tie( b.code, b.scope, b.table, b.primary_key );
+      }
+   };
+
+   /// a contract table as a block left it; `present` is false when the block removed it
+   struct table_delta {
+      account_name   code;
+      scope_name     scope;
+      table_name     table;
+      bool           present = false;
+      account_name   payer;
+      uint32_t       count = 0;
+   };
+
+   /// a row as a block left it; `present` is false when the block removed it
+   struct table_row_delta {
+      account_name   code;
+      scope_name     scope;
+      table_name     table;
+      uint64_t       primary_key = 0;
+      bool           present = false;
+      account_name   payer;
+      bytes          value;
+   };
+
+   /**
+    * The final state of the contract tables and rows that the transactions of a block wrote, in key order. Rows that
+    * were written and restored, or created and removed, within the block are reported all the same, so applying the
+    * deltas of a block means upserting the present rows and deleting the others. Secondary index objects are not
+    * reported, the contracts derive them from the rows.
+    */
+   struct block_state_deltas {
+      uint32_t                 block_num = 0;
+      block_id_type            block_id;
+      vector<table_delta>      tables;
+      vector<table_row_delta>  rows;
+   };
+
+   using block_state_deltas_ptr = std::shared_ptr<const block_state_deltas>;
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::table_row_key, (code)(scope)(table)(primary_key) )
+FC_REFLECT( eosio::chain::table_delta, (code)(scope)(table)(present)(payer)(count) )
+FC_REFLECT( eosio::chain::table_row_delta, (code)(scope)(table)(primary_key)(present)(payer)(value) )
+FC_REFLECT( eosio::chain::block_state_deltas, (block_num)(block_id)(tables)(rows) )
@@ -0,0 +1,52 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Process wide record of the threads of the node, so that they can be told apart in top, perf and gdb, kept on
+    *  the CPUs configured for them, and accounted for in the metrics.
+    *
+    *  A thread registers itself as it starts, by a name such as "net-2": the pool it belongs to, a dash and its index
+    *  in the pool. The CPUs configured for the longest of "net-2" and "net" that has any are the only ones it then
+    *  runs on, which keeps the main thread and the pools on the socket whose caches and memory they use. The CPU time
+    *  of every registered thread is published as eosio_thread_cpu_microseconds_total when the metrics are updated.
+    *
+    *  Pinning and CPU time are only supported on Linux; elsewhere registering only names the thread.
+    */
+   class thread_registry {
+      public:
+         static thread_registry& instance();
+
+         /// CPUs by thread or pool name, before the threads they apply to register
+         void set_affinities( std::map<string, vector<uint32_t>> cpus );
+
+         /// names the calling thread, pins it as configured and tracks its CPU time until it exits
+         void register_current_thread( const string& name );
+
+         /// adds the CPU time the registered threads used since the last update to their counters
+         void update_metrics();
+
+         /// "0-3,8" to 0, 1, 2, 3 and 8
+         static vector<uint32_t> parse_cpu_list( const string& list );
+
+      private:
+         struct tracked_thread;
+         friend struct thread_registration;
+
+         void unregister( tracked_thread* t );
+         void update( tracked_thread& t );
+
+         std::mutex                          mtx;
+         std::map<string, vector<uint32_t>>  affinities;
+         vector<tracked_thread*>             threads;
+   };
+
+} } /// eosio::chain
@@ -8,6 +8,8 @@
 #include <eosio/chain/action_receipt.hpp>
 #include <eosio/chain/block.hpp>
 
+#include <boost/pool/pool_alloc.hpp>
+
 namespace eosio { namespace chain {
 
    struct account_delta {
@@ -47,6 +49,32 @@ namespace eosio { namespace chain {
    struct transaction_trace;
    using transaction_trace_ptr = std::shared_ptr<transaction_trace>;
 
+   /// where the time of a transaction went, see transaction_phase_timer
+   struct transaction_phase_times {
+      uint64_t init_ns = 0;
+      uint64_t authorization_ns = 0;
+      uint64_t dispatch_ns = 0;
+      uint64_t native_ns = 0;
+      uint64_t wasm_ns = 0;
+      uint64_t db_ns = 0;
+      uint64_t deferred_ns = 0;
+      uint64_t finalize_ns = 0;
+      uint64_t total_ns = 0;
+
+      transaction_phase_times& operator+=( const transaction_phase_times& o ) {
+         init_ns += o.init_ns;
+         authorization_ns += o.authorization_ns;
+         dispatch_ns += o.dispatch_ns;
+         native_ns += o.native_ns;
+         wasm_ns += o.wasm_ns;
+         db_ns += o.db_ns;
+         deferred_ns += o.deferred_ns;
+         finalize_ns += o.finalize_ns;
+         total_ns += o.total_ns;
+         return *this;
+      }
+   };
+
    struct transaction_trace {
       transaction_id_type                        id;
       uint32_t                                   block_num = 0;
@@ -61,8 +89,17 @@ namespace eosio { namespace chain {
       transaction_trace_ptr                      failed_dtrx_trace;
       fc::optional<fc::exception>                except;
       std::exception_ptr                         except_ptr;
+      fc::optional<transaction_phase_times>      phase_times; ///< set when the controller profiles transaction phases
    };
 
+   /**
+    * Traces are allocated along with their reference count from a pool, which they go back to when the last subscriber
+    * drops them, on whichever thread that is, instead of going through malloc for every transaction applied.
+    */
+   inline transaction_trace_ptr make_transaction_trace() {
+      return std::allocate_shared<transaction_trace>( boost::fast_pool_allocator<transaction_trace>() );
+   }
+
 } }  /// namespace eosio::chain
 
 FC_REFLECT( eosio::chain::account_delta,
@@ -75,6 +112,9 @@ FC_REFLECT( eosio::chain::base_action_trace,
 FC_REFLECT_DERIVED( eosio::chain::action_trace,
                     (eosio::chain::base_action_trace), (inline_traces) )
 
+FC_REFLECT( eosio::chain::transaction_phase_times, (init_ns)(authorization_ns)(dispatch_ns)(native_ns)(wasm_ns)(db_ns)
+                                                   (deferred_ns)(finalize_ns)(total_ns) )
+
 FC_REFLECT( eosio::chain::transaction_trace, (id)(block_num)(block_time)(producer_block_id)
                                              (receipt)(elapsed)(net_usage)(scheduled)
-                                             (action_traces)(failed_dtrx_trace)(except) )
+                                             (action_traces)(failed_dtrx_trace)(except)(phase_times) )
@@ -131,8 +131,10 @@ namespace eosio { namespace chain {
       bytes                                   packed_trx;
 
       time_point_sec     expiration()const;
-      transaction_id_type id()const;
+      transaction_id_type id()const; ///< computed once
       transaction_id_type get_uncached_id()const; // thread safe
+      digest_type        sig_digest( const chain_id_type& chain_id )const; ///< computed once per chain id
+      flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id, bool allow_duplicate_keys = false, bool use_cache = true )const;
       bytes              get_raw_transaction()const; // thread safe
       vector<bytes>      get_context_free_data()const;
       transaction        get_transaction()const;
@@ -142,7 +144,10 @@ namespace eosio { namespace chain {
 
    private:
       mutable optional<transaction>           unpacked_trx; // <-- intermediate buffer used to retrieve values
+      mutable optional<transaction_id_type>   trx_id; ///< set along with unpacked_trx, or by set_transaction
+      mutable optional<pair<chain_id_type, digest_type>> signing_digest;
       void local_unpack()const;
+      void set_id( const bytes& raw );
    };
 
    using packed_transaction_ptr = std::shared_ptr<packed_transaction>;
@@ -1,6 +1,7 @@
 #pragma once
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/transaction_phase_timer.hpp>
 #include <signal.h>
 
 namespace eosio { namespace chain {
@@ -28,6 +29,7 @@ namespace eosio { namespace chain {
                               const signed_transaction& t,
                               const transaction_id_type& trx_id,
                               fc::time_point start = fc::time_point::now() );
+         ~transaction_context();
 
          void init_for_implicit_trx( uint64_t initial_net_usage = 0 );
 
@@ -47,7 +49,13 @@ namespace eosio { namespace chain {
 
          void check_net_usage()const;
 
-         void checktime()const;
+         /// the expired flag is raised by the deadline timer's signal handler, or left raised when polling,
+         /// so the common case is a single load that the WASM runtimes can inline into every injected check
+         inline void checktime()const {
+            if( BOOST_LIKELY(_deadline_timer.expired == false) )
+               return;
+            check_deadline();
+         }
 
          void pause_billing_timer();
          void resume_billing_timer();
@@ -56,8 +64,18 @@ namespace eosio { namespace chain {
 
          std::tuple<int64_t, int64_t, bool, bool> max_bandwidth_billed_accounts_can_pay( bool force_elastic_limits = false )const;
 
+         /// null unless the controller profiles transaction phases
+         transaction_phase_timer* phase_timer() { return phases ? &*phases : nullptr; }
+
+         /// copies the phase times so far into the trace, called right before the trace is emitted
+         void record_phase_times();
+
+         /// of trx, decoded from trx_meta when it is set and first read by a context-free action
+         const vector<bytes>& context_free_data()const;
+
       private:
 
+         void check_deadline()const;
          friend struct controller_impl;
          friend class apply_context;
 
@@ -77,6 +95,7 @@ namespace eosio { namespace chain {
 
          controller&                   control;
          const signed_transaction&     trx;
+         const transaction_metadata*   trx_meta = nullptr; ///< of an input transaction, trx is its trx
          transaction_id_type           id;
          optional<chainbase::database::session>  undo_session;
          transaction_trace_ptr         trace;
@@ -88,6 +107,8 @@ namespace eosio { namespace chain {
          vector<action_receipt>        executed;
          flat_set<account_name>        bill_to_accounts;
          flat_set<account_name>        validate_ram_usage;
+         /// receiver, contract and name of the actions that passed the contract and action lists, not checked again
+         vector<std::tuple<account_name, account_name, action_name>> list_checked_actions;
 
          /// the maximum number of virtual CPU instructions of the transaction that can be safely billed to the billable accounts
          uint64_t                      initial_max_billable_cpu = 0;
@@ -124,6 +145,8 @@ namespace eosio { namespace chain {
          fc::microseconds              billing_timer_duration_limit;
 
          deadline_timer                _deadline_timer;
+
+         optional<transaction_phase_timer> phases;
    };
 
 } }
@@ -0,0 +1,66 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <map>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Bloom filters of the ids of the transactions recorded for deduplication, one for each span of their expiration
+    * times, so that the filters of spans that expired are dropped whole. A transaction the filters have not seen is
+    * certainly not in the deduplication index; the ones they have seen, and a few false positives, still have to be
+    * looked up there. Ids are sha256 digests already, so their words serve as the hashes.
+    */
+   class transaction_id_filter {
+      public:
+         static constexpr uint32_t span_seconds  = 600;
+         static constexpr uint32_t bits_per_span = 1 << 20; ///< about 0.1% false positives with 100k transactions in a span
+         static constexpr uint32_t hashes        = 4;
+
+         void add( const transaction_id_type& id, fc::time_point_sec expiration ) {
+            auto& bits = _spans[expiration.sec_since_epoch() / span_seconds];
+            if( bits.empty() )
+               bits.resize( bits_per_span / 64 );
+            for( uint32_t i = 0; i < hashes; ++i ) {
+               auto b = bit( id, i );
+               bits[b / 64] |= uint64_t(1) << (b % 64);
+            }
+         }
+
+         bool may_contain( const transaction_id_type& id )const {
+            for( const auto& s : _spans ) {
+               uint32_t i = 0;
+               for( ; i < hashes; ++i ) {
+                  auto b = bit( id, i );
+                  if( !(s.second[b / 64] & (uint64_t(1) << (b % 64))) )
+                     break;
+               }
+               if( i == hashes )
+                  return true;
+            }
+            return false;
+         }
+
+         /// drops the spans that only hold expiration times before t
+         void drop_expired( fc::time_point_sec t ) {
+            _spans.erase( _spans.begin(), _spans.lower_bound( t.sec_since_epoch() / span_seconds ) );
+         }
+
+         void clear() { _spans.clear(); }
+
+         size_t spans()const { return _spans.size(); }
+
+      private:
+         static uint32_t bit( const transaction_id_type& id, uint32_t i ) {
+            return id._hash[i] & (bits_per_span - 1);
+         }
+
+         std::map<uint32_t, vector<uint64_t>> _spans; ///< by expiration time / span_seconds
+   };
+
+} } /// eosio::chain
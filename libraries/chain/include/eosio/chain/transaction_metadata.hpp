@@ -17,7 +17,7 @@ class transaction_metadata {
    public:
       transaction_id_type                                        id;
       transaction_id_type                                        signed_id;
-      signed_transaction                                         trx;
+      signed_transaction                                         trx; ///< without its context-free data when made from a packed_transaction, see context_free_data()
       packed_transaction                                         packed_trx;
       optional<pair<chain_id_type, flat_set<public_key_type>>>   signing_keys;
       bool                                                       accepted = false;
@@ -26,25 +26,48 @@ class transaction_metadata {
 
       explicit transaction_metadata( const signed_transaction& t, packed_transaction::compression_type c = packed_transaction::none )
       :trx(t),packed_trx(t, c) {
-         id = trx.id();
+         id = packed_trx.id();
          //raw_packed = fc::raw::pack( static_cast<const transaction&>(trx) );
          signed_id = digest_type::hash(packed_trx);
       }
 
       explicit transaction_metadata( const packed_transaction& ptrx )
-      :trx( ptrx.get_signed_transaction() ), packed_trx(ptrx) {
-         id = trx.id();
+      :trx( ptrx.get_transaction(), ptrx.signatures, vector<bytes>() ), packed_trx(ptrx) {
+         id = packed_trx.id();
          //raw_packed = fc::raw::pack( static_cast<const transaction&>(trx) );
          signed_id = digest_type::hash(packed_trx);
       }
 
       const flat_set<public_key_type>& recover_keys( const chain_id_type& chain_id ) {
          if( !signing_keys || signing_keys->first != chain_id ) // Unlikely for more than one chain_id to be used in one nodeos instance
-            signing_keys = std::make_pair( chain_id, trx.get_signature_keys( chain_id ) );
+            signing_keys = std::make_pair( chain_id, packed_trx.get_signature_keys( chain_id ) );
          return signing_keys->second;
       }
 
       uint32_t total_actions()const { return trx.context_free_actions.size() + trx.actions.size(); }
+
+      /**
+       *  The context-free data of the transaction, which is only decompressed and unpacked from packed_trx when it is
+       *  first read: by a context-free action as it runs, and so never on a replay that skips them.
+       */
+      const vector<bytes>& context_free_data()const {
+         if( !trx.context_free_data.empty() || packed_trx.packed_context_free_data.empty() )
+            return trx.context_free_data;
+         if( !unpacked_context_free_data )
+            unpacked_context_free_data = packed_trx.get_context_free_data();
+         return *unpacked_context_free_data;
+      }
+
+      /// trx with its context-free data, for the plugins that report it; decodes it anew, so any thread may call it
+      signed_transaction get_signed_transaction()const {
+         auto result = trx;
+         if( result.context_free_data.empty() )
+            result.context_free_data = packed_trx.get_context_free_data();
+         return result;
+      }
+
+   private:
+      mutable optional<vector<bytes>>                            unpacked_context_free_data;
 };
 
 using transaction_metadata_ptr = std::shared_ptr<transaction_metadata>;
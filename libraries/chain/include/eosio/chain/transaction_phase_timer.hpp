@@ -0,0 +1,92 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/trace.hpp>
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace eosio { namespace chain {
+
+   enum class transaction_phase : uint8_t {
+      init,           ///< net and cpu limits, recording the transaction id
+      authorization,  ///< including the recovery of keys not recovered ahead of time
+      dispatch,       ///< bookkeeping of actions, receipts and inline actions, outside of their handlers
+      native,         ///< handlers of the system contract built into the chain
+      wasm,           ///< contract code and host functions, except those below
+      db,             ///< database host functions
+      deferred,       ///< scheduling and canceling deferred and delayed transactions
+      finalize,       ///< billing and the receipt in the pending block
+      count
+   };
+
+   /**
+    *  Splits the time of one transaction into the phases above, each by the time stamp counter where there is one.
+    *
+    *  Only the current phase is tracked and charged whenever it changes, so nested phases are exclusive: time in a db
+    *  host function counts as db and not also as wasm. A transition is one counter read.
+    */
+   class transaction_phase_timer {
+      public:
+         transaction_phase_timer() : started( ticks() ), last( started ) {}
+
+         /// charges the current phase and switches to p, returning the phase it replaced
+         transaction_phase enter( transaction_phase p ) {
+            auto now = ticks();
+            elapsed[static_cast<size_t>(current)] += now - last;
+            last = now;
+            auto prev = current;
+            current = p;
+            return prev;
+         }
+
+         /// charged up to now
+         transaction_phase_times times();
+
+         /// the phase between construction and destruction, does nothing with a null timer
+         class scope {
+            public:
+               scope( transaction_phase_timer* t, transaction_phase p ) : timer(t) {
+                  if( timer ) prev = timer->enter( p );
+               }
+               ~scope() {
+                  if( timer ) timer->enter( prev );
+               }
+            private:
+               transaction_phase_timer* timer;
+               transaction_phase        prev = transaction_phase::init;
+         };
+
+         /// one host function call, charged as db when it is one of the db intrinsics
+         class intrinsic_scope {
+            public:
+               intrinsic_scope( transaction_phase_timer* t, uint32_t intrinsic_id )
+               :inner( t && is_db_intrinsic( intrinsic_id ) ? t : nullptr, transaction_phase::db ) {}
+            private:
+               scope inner;
+         };
+
+         static bool is_db_intrinsic( uint32_t intrinsic_id );
+
+      private:
+         static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+         }
+
+         uint64_t           started;
+         uint64_t           last;
+         transaction_phase  current = transaction_phase::init;
+         uint64_t           elapsed[static_cast<size_t>(transaction_phase::count)] = {};
+   };
+
+} } /// eosio::chain
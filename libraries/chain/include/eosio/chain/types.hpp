@@ -173,6 +173,7 @@ namespace eosio { namespace chain {
       action_history_object_type,               ///< Defined by history_plugin
       reversible_block_object_type,
       core_symbol_object_type,
+      generated_transaction_payload_object_type,
       OBJECT_TYPE_COUNT ///< Sentry value which contains the number of different object types
    };
 
@@ -45,6 +45,34 @@ namespace eosio { namespace chain {
       };
    } }
 
+   /**
+    * Bounds on the cache of instantiated modules kept by wasm_interface. A limit of zero means unbounded.
+    * Modules run on behalf of a pinned account are never evicted; they still count against the limits.
+    * With compile_threads set, code can be compiled ahead of its first use, see wasm_interface::precompile.
+    */
+   struct wasm_cache_config {
+      uint64_t                 max_bytes = 0;
+      uint32_t                 max_entries = 0;
+      flat_set<account_name>   pinned_accounts;
+      uint32_t                 compile_threads = 0;
+      uint32_t                 tier_up_threshold = 0;   ///< invocations before the tiered runtime JIT compiles a contract
+      uint64_t                 jit_fast_compile_size = 0;   ///< injected code size from which the JIT optimizes less; zero for never
+   };
+
+   struct wasm_cache_stats {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      uint64_t background_compiles = 0;
+      uint64_t tier_ups = 0;
+      uint64_t injection_reuses = 0;   ///< instantiations that skipped injection because the code was already prepared
+      uint64_t entries = 0;
+      uint64_t pinned_entries = 0;
+      uint64_t bytes = 0;   ///< estimated resident size of all cached modules
+      uint64_t fast_jit_compiles = 0;   ///< JIT compiles that skipped most optimizations because of the size of the code
+      uint64_t shared_instantiations = 0;   ///< instantiations served by a module another cache in the process still held
+   };
+
    /**
     * @class wasm_interface
     *
@@ -53,10 +81,11 @@ namespace eosio { namespace chain {
       public:
          enum class vm_type {
             wavm,
-            wabt
+            wabt,
+            tiered   ///< start every contract on wabt, move hot ones to wavm
          };
 
-         wasm_interface(vm_type vm);
+         wasm_interface(vm_type vm, const wasm_cache_config& cache = wasm_cache_config());
          ~wasm_interface();
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
@@ -68,6 +97,18 @@ namespace eosio { namespace chain {
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         //Starts compiling code on a background thread so its first apply does not have to; no-op without compile threads
+         void precompile(const digest_type& code_id, const char* code, size_t code_size);
+
+         //Moves finished background compiles and tier-ups into the instantiation cache; called between transactions,
+         //since finishing a WAVM compile instantiates it on the calling thread
+         void collect_compiles();
+
+         wasm_cache_stats cache_stats() const;
+
+         //Code currently in the instantiation cache with the account it last ran for; pinned first, then most recently used first
+         vector<pair<account_name, digest_type>> cached_code() const;
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -79,4 +120,5 @@ namespace eosio{ namespace chain {
    std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime);
 }}
 
-FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt) )
+FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt)(tiered) )
+FC_REFLECT( eosio::chain::wasm_cache_stats, (hits)(misses)(evictions)(background_compiles)(tier_ups)(injection_reuses)(entries)(pinned_entries)(bytes)(fast_jit_compiles)(shared_instantiations) )
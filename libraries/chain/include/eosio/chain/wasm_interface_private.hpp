@@ -7,8 +7,18 @@
 #include <eosio/chain/wasm_eosio_injection.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_registry.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/asio.hpp>
+
+#include <future>
+#include <list>
+#include <mutex>
+#include <thread>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -23,16 +33,96 @@ using namespace Runtime;
 namespace eosio { namespace chain {
 
    struct wasm_interface_impl {
-      wasm_interface_impl(wasm_interface::vm_type vm) {
-         if(vm == wasm_interface::vm_type::wavm)
-            runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
-         else if(vm == wasm_interface::vm_type::wabt)
-            runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
-         else
+      struct cached_module {
+         digest_type                                          code_id;
+         std::shared_ptr<wasm_instantiated_module_interface>  module;
+         uint64_t                                             size = 0;  ///< estimated resident bytes
+         uint32_t                                             pins = 0;  ///< number of pinned accounts running this code
+         account_name                                         receiver;  ///< account this code last ran for
+         wasm_runtime_interface*                              runtime = nullptr;  ///< runtime that instantiated module
+         uint32_t                                             invocations = 0;
+         bool                                                 tier_up_queued = false;
+      };
+      typedef std::list<cached_module> module_list;
+
+      struct prepared_code;
+
+      struct compiled_module {
+         std::shared_ptr<wasm_instantiated_module_interface>  module;   ///< null until instantiated, see finish_compile
+         std::shared_ptr<const prepared_code>                 prepared; ///< injected code waiting to be instantiated
+         uint64_t                                             size = 0;
+         wasm_runtime_interface*                              runtime = nullptr;
+         bool                                                 reused_injection = false;
+         bool                                                 fast_jit = false;   ///< JIT compiled with fastCompile
+         bool                                                 shared = false;     ///< already instantiated elsewhere in the process
+      };
+
+      struct runtime_tier {
+         std::unique_ptr<wasm_runtime_interface>  runtime;
+         uint32_t                                 code_size_multiplier = 1;
+         bool                                     counts_linear_memory = false;
+         webassembly::wavm::wavm_runtime*         jit = nullptr;            ///< runtime, when it is wavm
+         /// WAVM's object and memory registries, which its trap handler reads, are not safe to change while WAVM code
+         /// runs on the application thread, so its modules are only parsed and injected on the compile threads
+         bool                                     instantiates_off_thread = true;
+         metric_histogram*                        compile_time = nullptr;
+      };
+
+      /// hot tiers only get contracts that already ran often, so their JIT compile is worth more optimization
+      static runtime_tier make_tier(wasm_interface::vm_type vm, const wasm_cache_config& cache, bool hot = false) {
+         runtime_tier tier;
+         if(vm == wasm_interface::vm_type::wavm) {
+            webassembly::wavm::wavm_options options;
+            options.level = hot ? JITOptimizationLevel::aggressive : JITOptimizationLevel::standard;
+            options.fast_compile_size = cache.jit_fast_compile_size;
+            auto jit = std::make_unique<webassembly::wavm::wavm_runtime>(options);
+            tier.jit = jit.get();
+            tier.instantiates_off_thread = false;
+            tier.runtime = std::move(jit);
+            //JITed machine code is several times larger than the wasm it came from
+            tier.code_size_multiplier = 8;
+         } else if(vm == wasm_interface::vm_type::wabt) {
+            tier.runtime = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
+            //wabt keeps its own copy of linear memory per instance
+            tier.code_size_multiplier = 3;
+            tier.counts_linear_memory = true;
+         } else
             EOS_THROW(wasm_exception, "wasm_interface_impl fall through");
+         tier.compile_time = &metrics_registry::instance().histogram( "eosio_chain_wasm_compile_seconds",
+                                                                      "time to compile or instantiate a contract, per runtime",
+                                                                      {{"runtime", fc::reflector<wasm_interface::vm_type>::to_string(vm)}} );
+         return tier;
+      }
+
+      wasm_interface_impl(wasm_interface::vm_type vm, const wasm_cache_config& cache) : cache_config(cache) {
+         if(vm == wasm_interface::vm_type::tiered) {
+            //everything starts on the interpreter; contracts that turn out to be hot are moved to the JIT
+            EOS_ASSERT(cache_config.compile_threads > 0, wasm_exception, "the tiered wasm runtime requires compile threads");
+            base_tier = make_tier(wasm_interface::vm_type::wabt, cache_config);
+            optimized_tier = make_tier(wasm_interface::vm_type::wavm, cache_config, true);
+         } else {
+            base_tier = make_tier(vm, cache_config);
+         }
+         running_runtime = base_tier.runtime.get();
+
+         if(cache_config.compile_threads) {
+            compile_work.reset(new boost::asio::io_service::work(compile_ios));
+            for(uint32_t i = 0; i < cache_config.compile_threads; ++i)
+               compile_threads.emplace_back([this, i]() {
+                  thread_registry::instance().register_current_thread("chain-compile-" + std::to_string(i));
+                  compile_ios.run();
+               });
+         }
+      }
+
+      ~wasm_interface_impl() {
+         compile_work.reset();
+         compile_ios.stop();
+         for(auto& t : compile_threads)
+            t.join();
       }
 
-      std::vector<uint8_t> parse_initial_memory(const Module& module) {
+      static std::vector<uint8_t> parse_initial_memory(const Module& module) {
          std::vector<uint8_t> mem_image;
 
          for(const DataSegment& data_segment : module.dataSegments) {
@@ -50,19 +140,139 @@ namespace eosio { namespace chain {
          return mem_image;
       }
 
-      std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_id,
-                                                                                    const shared_string& code,
-                                                                                    transaction_context& trx_context )
-      {
-         auto it = instantiation_cache.find(code_id);
-         if(it == instantiation_cache.end()) {
-            auto timer_pause = fc::make_scoped_exit([&](){
-               trx_context.resume_billing_timer();
-            });
-            trx_context.pause_billing_timer();
-            IR::Module module;
+      /// validated and injected code ready to be handed to any runtime
+      struct prepared_code {
+         std::vector<U8>       bytes;
+         std::vector<uint8_t>  initial_memory;
+         uint64_t              memory_pages = 0;   ///< initial size of the linear memory
+      };
+
+      /**
+       *  Injected binaries shared by every wasm_interface in the process, keyed by code_id. Injection does
+       *  not depend on the runtime, so an evicted module, a tier-up or another controller only pays for the
+       *  runtime's own compile.
+       */
+      class prepared_code_cache {
+         public:
+            static prepared_code_cache& instance() {
+               static prepared_code_cache cache;
+               return cache;
+            }
+
+            std::shared_ptr<const prepared_code> find( const digest_type& code_id ) {
+               std::lock_guard<std::mutex> lock(mtx);
+               auto it = index.find(code_id);
+               if(it == index.end())
+                  return nullptr;
+               entries.splice(entries.begin(), entries, it->second);
+               return it->second->second;
+            }
+
+            void insert( const digest_type& code_id, std::shared_ptr<const prepared_code> code ) {
+               std::lock_guard<std::mutex> lock(mtx);
+               if(index.count(code_id))
+                  return;
+               bytes += code->bytes.size() + code->initial_memory.size();
+               entries.emplace_front(code_id, std::move(code));
+               index.emplace(code_id, entries.begin());
+               while(bytes > config::default_prepared_code_cache_size && entries.size() > 1) {
+                  const auto& last = entries.back();
+                  bytes -= last.second->bytes.size() + last.second->initial_memory.size();
+                  index.erase(last.first);
+                  entries.pop_back();
+               }
+            }
+
+         private:
+            typedef std::list<std::pair<digest_type, std::shared_ptr<const prepared_code>>> entry_list;
+            std::mutex                                  mtx;
+            entry_list                                  entries;   ///< most recently used first
+            map<digest_type, entry_list::iterator>      index;
+            uint64_t                                    bytes = 0;
+      };
+
+      /**
+       *  Instantiated modules alive anywhere in the process, keyed by code_id and by how they were compiled, so that
+       *  every wasm_interface running the same code shares one copy of its compiled code and tables. A module only
+       *  lives as long as some cache holds it.
+       *
+       *  Sharing relies on what the runtimes already do: linear memory, globals and tables are reset at the start of
+       *  every apply, so no state of one apply reaches the next, and a process runs one apply at a time since the
+       *  runtimes keep the running instance in static state.
+       */
+      class shared_module_registry {
+         public:
+            typedef std::pair<digest_type, uint32_t> key_type;   ///< code_id and compile variant
+
+            static shared_module_registry& instance() {
+               static shared_module_registry registry;
+               return registry;
+            }
+
+            std::shared_ptr<wasm_instantiated_module_interface> find( const key_type& key ) {
+               std::lock_guard<std::mutex> lock(mtx);
+               auto it = modules.find(key);
+               if(it == modules.end())
+                  return nullptr;
+               auto module = it->second.lock();
+               if(!module)
+                  modules.erase(it);
+               return module;
+            }
+
+            /// keeps the module already registered for key, if there is one still alive
+            std::shared_ptr<wasm_instantiated_module_interface> insert( const key_type& key, std::shared_ptr<wasm_instantiated_module_interface> module ) {
+               std::lock_guard<std::mutex> lock(mtx);
+               auto& registered = modules[key];
+               if(auto existing = registered.lock())
+                  return existing;
+               registered = module;
+               // expired entries of evicted code are dropped as new code comes in
+               for(auto it = modules.begin(); it != modules.end(); )
+                  it = it->second.expired() ? modules.erase(it) : std::next(it);
+               return module;
+            }
+
+         private:
+            std::mutex                                                          mtx;
+            map<key_type, std::weak_ptr<wasm_instantiated_module_interface>>   modules;
+      };
+
+      /// what, besides the code, decides the compiled module: the runtime and, for the JIT, the optimization level
+      static uint32_t compile_variant(const runtime_tier& tier, size_t code_size) {
+         if(tier.jit)
+            return 1 + static_cast<uint32_t>(tier.jit->optimization_level(code_size));
+         return 0;
+      }
+
+      static uint64_t estimate_size(const runtime_tier& tier, const prepared_code& code) {
+         uint64_t size = code.bytes.size() * tier.code_size_multiplier + code.initial_memory.size();
+         if(tier.counts_linear_memory)
+            size += code.memory_pages << IR::numBytesPerPageLog2;
+         return size;
+      }
+
+      //the injectors keep their bookkeeping in static members, so only one module may be injected at a time
+      static std::mutex& injection_mutex() {
+         static std::mutex m;
+         return m;
+      }
+
+      /// parses and injects code, or returns the result of doing so earlier; may be called from the compile threads
+      static std::shared_ptr<const prepared_code> prepare( const digest_type& code_id, const char* code, size_t code_size, bool& reused ) {
+         auto& cache = prepared_code_cache::instance();
+         if(auto prepared = cache.find(code_id)) {
+            reused = true;
+            return prepared;
+         }
+         reused = false;
+
+         IR::Module module;
+         auto prepared = std::make_shared<prepared_code>();
+         {
+            std::lock_guard<std::mutex> lock(injection_mutex());
             try {
-               Serialization::MemoryInputStream stream((const U8*)code.data(), code.size());
+               Serialization::MemoryInputStream stream((const U8*)code, code_size);
                WASM::serialize(stream, module);
                module.userSections.clear();
             } catch(const Serialization::FatalSerializationException& e) {
@@ -74,26 +284,283 @@ namespace eosio { namespace chain {
             wasm_injections::wasm_binary_injection injector(module);
             injector.inject();
 
-            std::vector<U8> bytes;
             try {
                Serialization::ArrayOutputStream outstream;
                WASM::serialize(outstream, module);
-               bytes = outstream.getBytes();
+               prepared->bytes = outstream.getBytes();
             } catch(const Serialization::FatalSerializationException& e) {
                EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
             } catch(const IR::ValidationException& e) {
                EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
             }
-            it = instantiation_cache.emplace(code_id, runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module))).first;
          }
-         return it->second;
+
+         prepared->initial_memory = parse_initial_memory(module);
+         if(module.memories.defs.size())
+            prepared->memory_pages = module.memories.defs[0].type.size.min;
+         cache.insert(code_id, prepared);
+         return prepared;
+      }
+
+      /**
+       *  Instantiates code with the runtime of tier. On the compile threads, for a runtime that cannot instantiate
+       *  there, it stops once the code is injected, and finish_compile instantiates it on the application thread.
+       */
+      compiled_module compile( const runtime_tier& tier, const digest_type& code_id, const char* code, size_t code_size,
+                               bool background = false ) {
+         compiled_module result;
+         auto prepared = prepare(code_id, code, code_size, result.reused_injection);
+         result.size = estimate_size(tier, *prepared);
+         result.runtime = tier.runtime.get();
+         if(tier.jit)
+            result.fast_jit = tier.jit->optimization_level(prepared->bytes.size()) == JITOptimizationLevel::fastCompile;
+
+         if(background && !tier.instantiates_off_thread) {
+            result.prepared = std::move(prepared);
+            return result;
+         }
+         instantiate(tier, code_id, *prepared, result);
+         return result;
+      }
+
+      /// completes on the application thread what compile left to it
+      compiled_module finish_compile( const runtime_tier& tier, const digest_type& code_id, compiled_module&& compiled ) {
+         if(!compiled.module) {
+            auto prepared = std::move(compiled.prepared);
+            instantiate(tier, code_id, *prepared, compiled);
+         }
+         return std::move(compiled);
       }
 
-      std::unique_ptr<wasm_runtime_interface> runtime_interface;
-      map<digest_type, std::unique_ptr<wasm_instantiated_module_interface>> instantiation_cache;
+      void instantiate( const runtime_tier& tier, const digest_type& code_id, const prepared_code& prepared, compiled_module& result ) {
+         auto& registry = shared_module_registry::instance();
+         const shared_module_registry::key_type key(code_id, compile_variant(tier, prepared.bytes.size()));
+         if((result.module = registry.find(key))) {
+            result.shared = true;
+            return;
+         }
+
+         auto start = fc::time_point::now();
+         result.module = registry.insert(key, tier.runtime->instantiate_module((const char*)prepared.bytes.data(), prepared.bytes.size(), prepared.initial_memory));
+         auto elapsed = fc::time_point::now() - start;
+         tier.compile_time->observe(elapsed);
+         if(tier.jit) {
+            dlog("JIT compiled ${id}, ${size} bytes of injected code, in ${us}us${fast}",
+                 ("id", code_id)("size", prepared.bytes.size())("us", elapsed.count())
+                 ("fast", result.fast_jit ? " with fast compile" : ""));
+         }
+      }
+
+      /// starts compiling code on the compile threads so that the first action using it does not pay for it
+      void precompile( const digest_type& code_id, const char* code, size_t code_size ) {
+         if(compile_threads.empty() || instantiation_cache.count(code_id) || pending_compiles.count(code_id))
+            return;
+         auto task = std::make_shared<std::packaged_task<compiled_module()>>(
+            [this, code_id, wasm = std::vector<char>(code, code + code_size)]() {
+               return compile(base_tier, code_id, wasm.data(), wasm.size(), true);
+            });
+         pending_compiles.emplace(code_id, task->get_future());
+         compile_ios.post([task]() { (*task)(); });
+      }
+
+      /// moves finished background compiles into the cache; failures are dropped and reported when the code is used
+      void collect_compiles() {
+         for(auto it = pending_compiles.begin(); it != pending_compiles.end(); ) {
+            if(it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+               ++it;
+               continue;
+            }
+            try {
+               auto entry = insert(it->first, finish_compile(base_tier, it->first, it->second.get()));
+               ++stats.background_compiles;
+               evict(entry);
+            } catch(...) {
+            }
+            it = pending_compiles.erase(it);
+         }
+
+         for(auto it = pending_tier_ups.begin(); it != pending_tier_ups.end(); ) {
+            if(it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+               ++it;
+               continue;
+            }
+            try {
+               auto compiled = finish_compile(optimized_tier, it->first, it->second.get());
+               auto cached = instantiation_cache.find(it->first);
+               if(cached != instantiation_cache.end()) {
+                  auto& entry = *cached->second;
+                  stats.bytes = stats.bytes - entry.size + compiled.size;
+                  entry.module = std::move(compiled.module);
+                  entry.size = compiled.size;
+                  entry.runtime = compiled.runtime;
+                  ++stats.tier_ups;
+                  if(compiled.reused_injection)
+                     ++stats.injection_reuses;
+                  if(compiled.fast_jit)
+                     ++stats.fast_jit_compiles;
+                  if(compiled.shared)
+                     ++stats.shared_instantiations;
+                  evict(cached->second);
+               }
+            } catch(...) {
+               //code the JIT cannot take simply stays on the interpreter
+            }
+            it = pending_tier_ups.erase(it);
+         }
+      }
+
+      /// counts an invocation of a module still on the base tier and queues its JIT compile once it is hot
+      void maybe_tier_up( module_list::iterator entry, const shared_string& code ) {
+         if(!optimized_tier.runtime || entry->runtime == optimized_tier.runtime.get() || entry->tier_up_queued)
+            return;
+         if(++entry->invocations < cache_config.tier_up_threshold)
+            return;
+         entry->tier_up_queued = true;
+         auto task = std::make_shared<std::packaged_task<compiled_module()>>(
+            [this, code_id = entry->code_id, wasm = std::vector<char>(code.begin(), code.end())]() {
+               return compile(optimized_tier, code_id, wasm.data(), wasm.size(), true);
+            });
+         pending_tier_ups.emplace(entry->code_id, task->get_future());
+         compile_ios.post([task]() { (*task)(); });
+      }
+
+      module_list::iterator insert( const digest_type& code_id, compiled_module&& compiled ) {
+         auto entry = lru_modules.emplace(lru_modules.begin());
+         entry->code_id = code_id;
+         entry->module = std::move(compiled.module);
+         entry->size = compiled.size;
+         entry->runtime = compiled.runtime;
+         if(compiled.reused_injection)
+            ++stats.injection_reuses;
+         if(compiled.fast_jit)
+            ++stats.fast_jit_compiles;
+         if(compiled.shared)
+            ++stats.shared_instantiations;
+         instantiation_cache.emplace(code_id, entry);
+         stats.bytes += compiled.size;
+         return entry;
+      }
+
+      std::shared_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_id,
+                                                                                    const shared_string& code,
+                                                                                    account_name receiver,
+                                                                                    transaction_context& trx_context )
+      {
+         //other finished compiles are collected by wasm_interface::collect_compiles at the start of a block, which no
+         //transaction is billed for; only the code this action needs is finished here, with billing paused
+         auto it = instantiation_cache.find(code_id);
+         static auto& cache_hits = metrics_registry::instance().counter( "eosio_chain_wasm_instantiation_cache_hits_total",
+                                                                         "actions whose contract was already instantiated" );
+         static auto& cache_misses = metrics_registry::instance().counter( "eosio_chain_wasm_instantiation_cache_misses_total",
+                                                                           "actions whose contract had to be compiled or instantiated" );
+         if(it != instantiation_cache.end()) {
+            ++stats.hits;
+            cache_hits.add();
+            touch(it->second, receiver);
+            maybe_tier_up(it->second, code);
+            running_runtime = it->second->runtime;
+            return it->second->module;
+         }
+
+         ++stats.misses;
+         cache_misses.add();
+         auto timer_pause = fc::make_scoped_exit([&](){
+            trx_context.resume_billing_timer();
+         });
+         trx_context.pause_billing_timer();
+
+         compiled_module compiled;
+         auto pending = pending_compiles.find(code_id);
+         if(pending != pending_compiles.end()) {
+            //still compiling in the background; waiting is never slower than starting over here
+            auto result = std::move(pending->second);
+            pending_compiles.erase(pending);
+            compiled = finish_compile(base_tier, code_id, result.get());
+            ++stats.background_compiles;
+         } else {
+            compiled = compile(base_tier, code_id, code.data(), code.size());
+         }
+
+         auto entry = insert(code_id, std::move(compiled));
+         touch(entry, receiver);
+         evict(entry);
+         maybe_tier_up(entry, code);
+         running_runtime = entry->runtime;
+         return entry->module;
+      }
+
+      /// marks the entry as most recently used; if receiver is pinned the entry moves to (or stays in) the pinned set
+      void touch(module_list::iterator entry, account_name receiver) {
+         entry->receiver = receiver;
+         if(cache_config.pinned_accounts.count(receiver)) {
+            auto current = pinned_code.find(receiver);
+            if(current == pinned_code.end() || current->second != entry->code_id) {
+               //a pinned account that changed its code releases the pin on the old code
+               if(current != pinned_code.end())
+                  unpin(current->second);
+               pinned_code[receiver] = entry->code_id;
+               if(entry->pins++ == 0)
+                  pinned_modules.splice(pinned_modules.begin(), lru_modules, entry);
+            }
+         }
+         if(!entry->pins)
+            lru_modules.splice(lru_modules.begin(), lru_modules, entry);
+      }
+
+      void unpin(const digest_type& code_id) {
+         auto it = instantiation_cache.find(code_id);
+         if(it == instantiation_cache.end())
+            return;
+         if(--it->second->pins == 0)
+            lru_modules.splice(lru_modules.begin(), pinned_modules, it->second);
+      }
+
+      bool over_limits() const {
+         return (cache_config.max_entries && instantiation_cache.size() > cache_config.max_entries) ||
+                (cache_config.max_bytes && stats.bytes > cache_config.max_bytes);
+      }
+
+      /// drops least recently used, unpinned modules until the cache is within its limits; never drops keep.
+      /// Only called before a module runs so no evicted module can be executing.
+      void evict(module_list::iterator keep) {
+         while(over_limits() && !lru_modules.empty()) {
+            auto victim = std::prev(lru_modules.end());
+            if(victim == keep)
+               break;
+            stats.bytes -= victim->size;
+            ++stats.evictions;
+            instantiation_cache.erase(victim->code_id);
+            lru_modules.erase(victim);
+         }
+      }
+
+      wasm_cache_config                                 cache_config;
+      runtime_tier                                      base_tier;
+      runtime_tier                                      optimized_tier;    ///< only set for the tiered runtime
+      wasm_runtime_interface*                           running_runtime = nullptr;
+      //the lists own the modules and must be destroyed before the runtimes
+      module_list                                       lru_modules;     ///< most recently used first
+      module_list                                       pinned_modules;
+      map<digest_type, module_list::iterator>           instantiation_cache;
+      map<account_name, digest_type>                    pinned_code;
+      map<digest_type, std::future<compiled_module>>    pending_compiles;
+      map<digest_type, std::future<compiled_module>>    pending_tier_ups;
+      wasm_cache_stats                                  stats;
+
+      boost::asio::io_service                           compile_ios;
+      std::unique_ptr<boost::asio::io_service::work>    compile_work;
+      std::vector<std::thread>                          compile_threads;
    };
 
+#define _REGISTER_INTRINSIC_PROFILE(CLS, MOD, METHOD, NAME, SIG)\
+   static eosio::chain::intrinsic_profile_registrator _INTRINSIC_NAME(__intrinsic_profile, __COUNTER__) (\
+      MOD,\
+      NAME,\
+      eosio::chain::intrinsic_profile_id<SIG, &CLS::METHOD>::value\
+   );\
+
 #define _REGISTER_INTRINSIC_EXPLICIT(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
+   _REGISTER_INTRINSIC_PROFILE(CLS, MOD, METHOD, NAME, SIG)\
    _REGISTER_WAVM_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
    _REGISTER_WABT_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)
 
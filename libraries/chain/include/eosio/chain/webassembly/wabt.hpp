@@ -4,6 +4,7 @@
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/execution_profiler.hpp>
 #include <softfloat_types.h>
 
 //wabt includes
@@ -29,6 +30,10 @@ struct wabt_apply_instance_vars {
    }
 };
 
+/**
+ * The arguments of a host function are read with operator[]: wabt only links an import whose signature matches the
+ * registered one, so there are always exactly as many as the intrinsic takes.
+ */
 struct intrinsic_registrator {
    using intrinsic_fn = TypedValue(*)(wabt_apply_instance_vars&, const TypedValues&);
 
@@ -78,13 +83,10 @@ inline array_ptr<T> array_ptr_impl (wabt_apply_instance_vars& vars, uint32_t ptr
 inline null_terminated_ptr null_terminated_ptr_impl(wabt_apply_instance_vars& vars, uint32_t ptr)
 {
    char *value = vars.get_validated_pointer(ptr, 1);
-   const char* p = value;
    const char* const top_of_memory = vars.memory->data.data() + vars.memory->data.size();
-   while(p < top_of_memory)
-      if(*p++ == '\0')
-         return null_terminated_ptr(value);
-
-   FC_THROW_EXCEPTION(wasm_execution_error, "unterminated string");
+   if(!memchr(value, '\0', top_of_memory - value))
+      FC_THROW_EXCEPTION(wasm_execution_error, "unterminated string");
+   return null_terminated_ptr(value);
 }
 
 
@@ -342,7 +344,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<Input, Inputs...>> {
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) {
-      auto& last = args.at(offset);
+      auto& last = args[offset];
       auto native = convert_literal_to_native<Input>(last);
       return Then(vars, native, rest..., args, (uint32_t)offset - 1);
    };
@@ -369,8 +371,8 @@ struct intrinsic_invoker_impl<Ret, std::tuple<array_ptr<T>, size_t, Inputs...>>
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<std::is_const<U>::value, Ret> {
       static_assert(!std::is_pointer<U>::value, "Currently don't support array of pointers");
-      uint32_t ptr = args.at((uint32_t)offset - 1).get_i32();
-      size_t length = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset - 1].get_i32();
+      size_t length = args[(uint32_t)offset].get_i32();
       T* base = array_ptr_impl<T>(vars, ptr, length);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
          if(vars.ctx.control.contracts_console())
@@ -386,8 +388,8 @@ struct intrinsic_invoker_impl<Ret, std::tuple<array_ptr<T>, size_t, Inputs...>>
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<!std::is_const<U>::value, Ret> {
       static_assert(!std::is_pointer<U>::value, "Currently don't support array of pointers");
-      uint32_t ptr = args.at((uint32_t)offset - 1).get_i32();
-      size_t length = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset - 1].get_i32();
+      size_t length = args[(uint32_t)offset].get_i32();
       T* base = array_ptr_impl<T>(vars, ptr, length);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
          if(vars.ctx.control.contracts_console())
@@ -423,7 +425,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<null_terminated_ptr, Inputs...>> {
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) {
-      uint32_t ptr = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset].get_i32();
       return Then(vars, null_terminated_ptr_impl(vars, ptr), rest..., args, (uint32_t)offset - 1);
    };
 
@@ -448,9 +450,9 @@ struct intrinsic_invoker_impl<Ret, std::tuple<array_ptr<T>, array_ptr<U>, size_t
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) {
-      uint32_t ptr_t = args.at((uint32_t)offset - 2).get_i32();
-      uint32_t ptr_u = args.at((uint32_t)offset - 1).get_i32();
-      size_t length = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr_t = args[(uint32_t)offset - 2].get_i32();
+      uint32_t ptr_u = args[(uint32_t)offset - 1].get_i32();
+      size_t length = args[(uint32_t)offset].get_i32();
       static_assert(std::is_same<std::remove_const_t<T>, char>::value && std::is_same<std::remove_const_t<U>, char>::value, "Currently only support array of (const)chars");
       return Then(vars, array_ptr_impl<T>(vars, ptr_t, length), array_ptr_impl<U>(vars, ptr_u, length), length, args, (uint32_t)offset - 3);
    };
@@ -474,9 +476,9 @@ struct intrinsic_invoker_impl<Ret, std::tuple<array_ptr<char>, int, size_t>> {
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, const TypedValues& args, int offset) {
-      uint32_t ptr = args.at((uint32_t)offset - 2).get_i32();
-      uint32_t value = args.at((uint32_t)offset - 1).get_i32();
-      size_t length = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset - 2].get_i32();
+      uint32_t value = args[(uint32_t)offset - 1].get_i32();
+      size_t length = args[(uint32_t)offset].get_i32();
       return Then(vars, array_ptr_impl<char>(vars, ptr, length), value, length, args, (uint32_t)offset - 3);
    };
 
@@ -501,7 +503,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T *, Inputs...>> {
 
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<std::is_const<U>::value, Ret> {
-      uint32_t ptr = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset].get_i32();
       T* base = array_ptr_impl<T>(vars, ptr, 1);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
          if(vars.ctx.control.contracts_console())
@@ -516,7 +518,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T *, Inputs...>> {
 
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<!std::is_const<U>::value, Ret> {
-      uint32_t ptr = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset].get_i32();
       T* base = array_ptr_impl<T>(vars, ptr, 1);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
          if(vars.ctx.control.contracts_console())
@@ -551,7 +553,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<const name&, Inputs...>> {
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) {
-      uint64_t wasm_value = args.at((uint32_t)offset).get_i64();
+      uint64_t wasm_value = args[(uint32_t)offset].get_i64();
       auto value = name(wasm_value);
       return Then(vars, value, rest..., args, (uint32_t)offset - 1);
    }
@@ -577,7 +579,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<const fc::time_point_sec&, Inputs.
 
    template<then_type Then>
    static Ret translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) {
-      uint32_t wasm_value = args.at((uint32_t)offset).get_i32();
+      uint32_t wasm_value = args[(uint32_t)offset].get_i32();
       auto value = fc::time_point_sec(wasm_value);
       return Then(vars, value, rest..., args, (uint32_t)offset - 1);
    }
@@ -605,7 +607,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T &, Inputs...>> {
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<std::is_const<U>::value, Ret> {
       // references cannot be created for null pointers
-      uint32_t ptr = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset].get_i32();
       EOS_ASSERT(ptr != 0, binaryen_exception, "references cannot be created for null pointers");
       T* base = array_ptr_impl<T>(vars, ptr, 1);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
@@ -622,7 +624,7 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T &, Inputs...>> {
    template<then_type Then, typename U=T>
    static auto translate_one(wabt_apply_instance_vars& vars, Inputs... rest, const TypedValues& args, int offset) -> std::enable_if_t<!std::is_const<U>::value, Ret> {
       // references cannot be created for null pointers
-      uint32_t ptr = args.at((uint32_t)offset).get_i32();
+      uint32_t ptr = args[(uint32_t)offset].get_i32();
       EOS_ASSERT(ptr != 0, binaryen_exception, "references cannot be created for null pointers");
       T* base = array_ptr_impl<T>(vars, ptr, 1);
       if ( reinterpret_cast<uintptr_t>(base) % alignof(T) != 0 ) {
@@ -656,6 +658,8 @@ struct intrinsic_function_invoker {
    template<MethodSig Method>
    static Ret wrapper(wabt_apply_instance_vars& vars, Params... params, const TypedValues&, int) {
       class_from_wasm<Cls>::value(vars.ctx).checktime();
+      execution_profiler::intrinsic_scope profile((vars.ctx).profiler, intrinsic_profile_id<MethodSig, Method>::value);
+      transaction_phase_timer::intrinsic_scope phase((vars.ctx).phase_timer, intrinsic_profile_id<MethodSig, Method>::value);
       return (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
    }
 
@@ -672,6 +676,8 @@ struct intrinsic_function_invoker<void, MethodSig, Cls, Params...> {
    template<MethodSig Method>
    static void_type wrapper(wabt_apply_instance_vars& vars, Params... params, const TypedValues& args, int offset) {
       class_from_wasm<Cls>::value(vars.ctx).checktime();
+      execution_profiler::intrinsic_scope profile((vars.ctx).profiler, intrinsic_profile_id<MethodSig, Method>::value);
+      transaction_phase_timer::intrinsic_scope phase((vars.ctx).phase_timer, intrinsic_profile_id<MethodSig, Method>::value);
       (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
       return void_type();
    }
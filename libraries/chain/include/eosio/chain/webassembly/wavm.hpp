@@ -4,6 +4,7 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/webassembly/runtime_interface.hpp>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/execution_profiler.hpp>
 #include <softfloat.hpp>
 #include "Runtime/Runtime.h"
 #include "IR/Types.h"
@@ -16,14 +17,26 @@ using namespace Runtime;
 using namespace fc;
 using namespace eosio::chain::webassembly::common;
 
+/**
+ * How much LLVM optimizes the modules a wavm_runtime compiles. Optimizing is most of the compile time of a large
+ * contract, so code from fast_compile_size bytes on is compiled with JITOptimizationLevel::fastCompile.
+ */
+struct wavm_options {
+   JITOptimizationLevel  level = JITOptimizationLevel::standard;
+   uint64_t              fast_compile_size = 0;   ///< zero to compile everything with level
+};
+
 class wavm_runtime : public eosio::chain::wasm_runtime_interface {
    public:
-      wavm_runtime();
+      explicit wavm_runtime(const wavm_options& options = wavm_options());
       ~wavm_runtime();
       std::unique_ptr<wasm_instantiated_module_interface> instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) override;
 
       void immediately_exit_currently_running_module() override;
 
+      /// the optimization level code of code_size bytes is compiled with
+      JITOptimizationLevel optimization_level(size_t code_size) const;
+
       struct runtime_guard {
          runtime_guard();
          ~runtime_guard();
@@ -31,6 +44,7 @@ class wavm_runtime : public eosio::chain::wasm_runtime_interface {
 
    private:
       std::shared_ptr<runtime_guard> _runtime_guard;
+      wavm_options                   _options;
 };
 
 //This is a temporary hack for the single threaded implementation
@@ -40,6 +54,31 @@ struct running_instance_context {
 };
 extern running_instance_context the_running_instance_context;
 
+/**
+ * the linear memory of the running instance, read once per intrinsic call so that all of its pointer arguments are
+ * checked against it without going back to the runtime for each of them
+ */
+struct memory_bounds {
+   char*  base;
+   size_t size;
+};
+
+inline memory_bounds get_memory_bounds(running_instance_context& ctx)
+{
+   MemoryInstance* mem = ctx.memory;
+   if (!mem)
+      Runtime::causeException(Exception::Cause::accessViolation);
+   return { (char*)getMemoryBaseAddress(mem), IR::numBytesPerPage * Runtime::getMemoryNumPages(mem) };
+}
+
+template<typename T>
+inline T* validated_array_ptr (const memory_bounds& mem, U32 ptr, size_t length)
+{
+   if (ptr >= mem.size || length > (mem.size - ptr) / sizeof(T))
+      Runtime::causeException(Exception::Cause::accessViolation);
+   return (T*)(mem.base + ptr);
+}
+
 /**
  * class to represent an in-wasm-memory array
  * it is a hint to the transcriber that the next parameter will
@@ -50,17 +89,7 @@ extern running_instance_context the_running_instance_context;
 template<typename T>
 inline array_ptr<T> array_ptr_impl (running_instance_context& ctx, U32 ptr, size_t length)
 {
-   MemoryInstance* mem = ctx.memory;
-   if (!mem) 
-      Runtime::causeException(Exception::Cause::accessViolation);
-
-   size_t mem_total = IR::numBytesPerPage * Runtime::getMemoryNumPages(mem);
-   if (ptr >= mem_total || length > (mem_total - ptr) / sizeof(T))
-      Runtime::causeException(Exception::Cause::accessViolation);
-   
-   T* ret_ptr = (T*)(getMemoryBaseAddress(mem) + ptr);
-
-   return array_ptr<T>((T*)(getMemoryBaseAddress(mem) + ptr));
+   return array_ptr<T>(validated_array_ptr<T>(get_memory_bounds(ctx), ptr, length));
 }
 
 /**
@@ -68,18 +97,10 @@ inline array_ptr<T> array_ptr_impl (running_instance_context& ctx, U32 ptr, size
  */
 inline null_terminated_ptr null_terminated_ptr_impl(running_instance_context& ctx, U32 ptr)
 {
-   MemoryInstance* mem = ctx.memory;
-   if(!mem)
+   const memory_bounds mem = get_memory_bounds(ctx);
+   if(ptr >= mem.size || !memchr(mem.base + ptr, '\0', mem.size - ptr))
       Runtime::causeException(Exception::Cause::accessViolation);
-
-   char *value                     = (char*)(getMemoryBaseAddress(mem) + ptr);
-   const char* p                   = value;
-   const char* const top_of_memory = (char*)(getMemoryBaseAddress(mem) + IR::numBytesPerPage*Runtime::getMemoryNumPages(mem));
-   while(p < top_of_memory)
-      if(*p++ == '\0')
-         return null_terminated_ptr(value);
-
-   Runtime::causeException(Exception::Cause::accessViolation);
+   return null_terminated_ptr(mem.base + ptr);
 }
 
 
@@ -167,14 +188,10 @@ inline auto convert_native_to_wasm(const running_instance_context& ctx, const fc
 }
 
 inline auto convert_native_to_wasm(running_instance_context& ctx, char* ptr) {
-   MemoryInstance* mem = ctx.memory;
-   if(!mem)
-      Runtime::causeException(Exception::Cause::accessViolation);
-   char* base = (char*)getMemoryBaseAddress(mem);
-   char* top_of_memory = base + IR::numBytesPerPage*Runtime::getMemoryNumPages(mem);
-   if(ptr < base || ptr >= top_of_memory)
+   const memory_bounds mem = get_memory_bounds(ctx);
+   if(ptr < mem.base || ptr >= mem.base + mem.size)
       Runtime::causeException(Exception::Cause::accessViolation);
-   return (U32)(ptr - base);
+   return (U32)(ptr - mem.base);
 }
 
 template<typename T>
@@ -462,7 +479,8 @@ struct intrinsic_invoker_impl<Ret, std::tuple<array_ptr<T>, array_ptr<U>, size_t
    static Ret translate_one(running_instance_context& ctx, Inputs... rest, Translated... translated, I32 ptr_t, I32 ptr_u, I32 size) {
       static_assert(std::is_same<std::remove_const_t<T>, char>::value && std::is_same<std::remove_const_t<U>, char>::value, "Currently only support array of (const)chars");
       const auto length = size_t(size);
-      return Then(ctx, array_ptr_impl<T>(ctx, (U32)ptr_t, length), array_ptr_impl<U>(ctx, (U32)ptr_u, length), length, rest..., translated...);
+      const memory_bounds mem = get_memory_bounds(ctx);
+      return Then(ctx, array_ptr<T>(validated_array_ptr<T>(mem, (U32)ptr_t, length)), array_ptr<U>(validated_array_ptr<U>(mem, (U32)ptr_u, length)), length, rest..., translated...);
    };
 
    template<then_type Then>
@@ -589,10 +607,10 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T &, Inputs...>, std::tuple<Transl
    static auto translate_one(running_instance_context& ctx, Inputs... rest, Translated... translated, I32 ptr) -> std::enable_if_t<std::is_const<U>::value, Ret> {
       // references cannot be created for null pointers
       EOS_ASSERT((U32)ptr != 0, wasm_exception, "references cannot be created for null pointers");
-      MemoryInstance* mem = ctx.memory;
-      if(!mem || (U32)ptr+sizeof(T) >= IR::numBytesPerPage*Runtime::getMemoryNumPages(mem))
+      const memory_bounds mem = get_memory_bounds(ctx);
+      if((U32)ptr+sizeof(T) >= mem.size)
          Runtime::causeException(Exception::Cause::accessViolation);
-      T &base = *(T*)(getMemoryBaseAddress(mem)+(U32)ptr);
+      T &base = *(T*)(mem.base+(U32)ptr);
       if ( reinterpret_cast<uintptr_t>(&base) % alignof(T) != 0 ) {
          if(ctx.apply_ctx->control.contracts_console())
             wlog( "misaligned const reference" );
@@ -608,10 +626,10 @@ struct intrinsic_invoker_impl<Ret, std::tuple<T &, Inputs...>, std::tuple<Transl
    static auto translate_one(running_instance_context& ctx, Inputs... rest, Translated... translated, I32 ptr) -> std::enable_if_t<!std::is_const<U>::value, Ret> {
       // references cannot be created for null pointers
       EOS_ASSERT((U32)ptr != 0, wasm_exception, "reference cannot be created for null pointers");
-      MemoryInstance* mem = ctx.memory;
-      if(!mem || (U32)ptr+sizeof(T) >= IR::numBytesPerPage*Runtime::getMemoryNumPages(mem))
+      const memory_bounds mem = get_memory_bounds(ctx);
+      if((U32)ptr+sizeof(T) >= mem.size)
          Runtime::causeException(Exception::Cause::accessViolation);
-      T &base = *(T*)(getMemoryBaseAddress(mem)+(U32)ptr);
+      T &base = *(T*)(mem.base+(U32)ptr);
       if ( reinterpret_cast<uintptr_t>(&base) % alignof(T) != 0 ) {
          if(ctx.apply_ctx->control.contracts_console())
             wlog( "misaligned reference" );
@@ -641,6 +659,8 @@ struct intrinsic_function_invoker {
    template<MethodSig Method>
    static Ret wrapper(running_instance_context& ctx, Params... params) {
       class_from_wasm<Cls>::value(*ctx.apply_ctx).checktime();
+      execution_profiler::intrinsic_scope profile((*ctx.apply_ctx).profiler, intrinsic_profile_id<MethodSig, Method>::value);
+      transaction_phase_timer::intrinsic_scope phase((*ctx.apply_ctx).phase_timer, intrinsic_profile_id<MethodSig, Method>::value);
       return (class_from_wasm<Cls>::value(*ctx.apply_ctx).*Method)(params...);
    }
 
@@ -660,6 +680,8 @@ struct intrinsic_function_invoker<WasmSig, void, MethodSig, Cls, Params...> {
    template<MethodSig Method>
    static void_type wrapper(running_instance_context& ctx, Params... params) {
       class_from_wasm<Cls>::value(*ctx.apply_ctx).checktime();
+      execution_profiler::intrinsic_scope profile((*ctx.apply_ctx).profiler, intrinsic_profile_id<MethodSig, Method>::value);
+      transaction_phase_timer::intrinsic_scope phase((*ctx.apply_ctx).phase_timer, intrinsic_profile_id<MethodSig, Method>::value);
       (class_from_wasm<Cls>::value(*ctx.apply_ctx).*Method)(params...);
       return void_type();
    }
@@ -35,15 +35,24 @@ bool is_canonical_right(const digest_type& val) {
 digest_type merkle(vector<digest_type> ids) {
    if( 0 == ids.size() ) { return digest_type(); }
 
+   static_assert( sizeof(digest_type) == 32, "pairs of digests must be contiguous to be hashed in place" );
+
+   // hashing the two adjacent digests directly gives the same result as hashing their packed canonical pair,
+   // without building the pair or going through a datastream for every node
    while( ids.size() > 1 ) {
       if( ids.size() % 2 )
          ids.push_back(ids.back());
 
-      for (int i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+      const size_t pairs = ids.size() / 2;
+      for( size_t i = 0; i < pairs; ++i ) {
+         auto& l = ids[2 * i];
+         auto& r = ids[2 * i + 1];
+         l._hash[0] &= 0xFFFFFFFFFFFFFF7FULL;
+         r._hash[0] |= 0x0000000000000080ULL;
+         ids[i] = digest_type::hash( reinterpret_cast<const char*>(&l), 2 * sizeof(digest_type) );
       }
 
-      ids.resize(ids.size() / 2);
+      ids.resize(pairs);
    }
 
    return ids.front();
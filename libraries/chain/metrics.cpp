@@ -0,0 +1,167 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace eosio { namespace chain {
+
+   namespace detail {
+      uint32_t metric_shard() {
+         static std::atomic<uint32_t> next{0};
+         thread_local uint32_t shard = next.fetch_add( 1, std::memory_order_relaxed ) % metric_shards;
+         return shard;
+      }
+   }
+
+   uint64_t metric_counter::value()const {
+      uint64_t v = 0;
+      for( const auto& s : shards )
+         v += s.value.load( std::memory_order_relaxed );
+      return v;
+   }
+
+   metric_histogram::metric_histogram( vector<int64_t> bounds )
+   :bounds_us( std::move( bounds ) )
+   ,cells( new detail::metric_cell[detail::metric_shards * (bounds_us.size() + 2)] )
+   {
+      EOS_ASSERT( std::is_sorted( bounds_us.begin(), bounds_us.end() ), misc_exception, "histogram bounds must be sorted" );
+   }
+
+   void metric_histogram::observe( fc::microseconds d ) {
+      auto us = std::max<int64_t>( d.count(), 0 );
+      auto bucket = std::lower_bound( bounds_us.begin(), bounds_us.end(), us ) - bounds_us.begin();
+      auto* shard = &cells[detail::metric_shard() * stride()];
+      shard[bucket].value.fetch_add( 1, std::memory_order_relaxed );
+      shard[stride() - 1].value.fetch_add( us, std::memory_order_relaxed );
+   }
+
+   vector<uint64_t> metric_histogram::counts()const {
+      vector<uint64_t> result( bounds_us.size() + 1, 0 );
+      for( uint32_t s = 0; s < detail::metric_shards; ++s )
+         for( size_t i = 0; i < result.size(); ++i )
+            result[i] += cells[s * stride() + i].value.load( std::memory_order_relaxed );
+      return result;
+   }
+
+   uint64_t metric_histogram::sum_us()const {
+      uint64_t sum = 0;
+      for( uint32_t s = 0; s < detail::metric_shards; ++s )
+         sum += cells[s * stride() + stride() - 1].value.load( std::memory_order_relaxed );
+      return sum;
+   }
+
+   const vector<int64_t>& metric_histogram::default_bounds() {
+      static const vector<int64_t> b = {
+         50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 10000000
+      };
+      return b;
+   }
+
+   metrics_registry& metrics_registry::instance() {
+      static metrics_registry registry;
+      return registry;
+   }
+
+   namespace {
+      string render_labels( const metric_labels& labels ) {
+         string result;
+         for( const auto& l : labels ) {
+            result += result.empty() ? "{" : ",";
+            result += l.first + "=\"";
+            for( char c : l.second ) {
+               if( c == '\\' || c == '"' ) result += '\\';
+               if( c == '\n' ) { result += "\\n"; continue; }
+               result += c;
+            }
+            result += "\"";
+         }
+         return result.empty() ? result : result + "}";
+      }
+
+      /// labels of a histogram bucket, the le label added to the labels of the histogram
+      string bucket_labels( const string& labels, const string& le ) {
+         string bucket = "le=\"" + le + "\"";
+         return labels.empty() ? "{" + bucket + "}" : labels.substr( 0, labels.size() - 1 ) + "," + bucket + "}";
+      }
+
+      string seconds( uint64_t us ) {
+         std::ostringstream ss;
+         ss << std::setprecision( 9 ) << us / 1000000.0;
+         return ss.str();
+      }
+   }
+
+   metrics_registry::family& metrics_registry::get_family( const string& name, const string& help, metric_type type ) {
+      auto itr = families.find( name );
+      if( itr == families.end() )
+         itr = families.emplace( name, family{ type, help } ).first;
+      EOS_ASSERT( itr->second.type == type, misc_exception, "metric ${n} was registered with another type", ("n", name) );
+      return itr->second;
+   }
+
+   metric_counter& metrics_registry::counter( const string& name, const string& help, const metric_labels& labels ) {
+      std::lock_guard<std::mutex> g( mtx );
+      auto& m = get_family( name, help, metric_type::counter ).counters[render_labels( labels )];
+      if( !m ) m.reset( new metric_counter() );
+      return *m;
+   }
+
+   metric_gauge& metrics_registry::gauge( const string& name, const string& help, const metric_labels& labels ) {
+      std::lock_guard<std::mutex> g( mtx );
+      auto& m = get_family( name, help, metric_type::gauge ).gauges[render_labels( labels )];
+      if( !m ) m.reset( new metric_gauge() );
+      return *m;
+   }
+
+   metric_histogram& metrics_registry::histogram( const string& name, const string& help, const metric_labels& labels,
+                                                  const vector<int64_t>& bounds_us ) {
+      std::lock_guard<std::mutex> g( mtx );
+      auto& m = get_family( name, help, metric_type::histogram ).histograms[render_labels( labels )];
+      if( !m ) m.reset( new metric_histogram( bounds_us ) );
+      return *m;
+   }
+
+   string metrics_registry::to_prometheus()const {
+      std::lock_guard<std::mutex> g( mtx );
+      std::ostringstream out;
+      for( const auto& f : families ) {
+         const auto& name = f.first;
+         out << "# HELP " << name << " " << f.second.help << "\n";
+         switch( f.second.type ) {
+            case metric_type::counter:
+               out << "# TYPE " << name << " counter\n";
+               for( const auto& m : f.second.counters )
+                  out << name << m.first << " " << m.second->value() << "\n";
+               break;
+            case metric_type::gauge:
+               out << "# TYPE " << name << " gauge\n";
+               for( const auto& m : f.second.gauges )
+                  out << name << m.first << " " << m.second->value() << "\n";
+               break;
+            case metric_type::histogram:
+               out << "# TYPE " << name << " histogram\n";
+               for( const auto& m : f.second.histograms ) {
+                  const auto& h = *m.second;
+                  auto counts = h.counts();
+                  uint64_t cumulative = 0;
+                  for( size_t i = 0; i < counts.size(); ++i ) {
+                     cumulative += counts[i];
+                     auto le = i < h.bounds().size() ? seconds( h.bounds()[i] ) : string( "+Inf" );
+                     out << name << "_bucket" << bucket_labels( m.first, le ) << " " << cumulative << "\n";
+                  }
+                  out << name << "_sum" << m.first << " " << seconds( h.sum_us() ) << "\n";
+                  out << name << "_count" << m.first << " " << cumulative << "\n";
+               }
+               break;
+         }
+      }
+      return out.str();
+   }
+
+} } /// eosio::chain
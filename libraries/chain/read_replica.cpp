@@ -0,0 +1,112 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/read_replica.hpp>
+#include <eosio/chain/config.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <atomic>
+#include <fstream>
+
+namespace eosio { namespace chain {
+
+   namespace bip = boost::interprocess;
+
+   struct read_replica_segment::shared_data {
+      static const uint32_t current_version = 1;
+      static const uint32_t max_head_size = 64*1024; ///< a header state with a few hundred producers
+
+      uint32_t                          version = current_version;
+      bip::interprocess_sharable_mutex  state_mutex;
+      bip::interprocess_mutex           revision_mutex;
+      bip::interprocess_condition       revision_changed; ///< signalled with revision_mutex held
+      std::atomic<uint64_t>             revision{0};
+      chain_id_type                     chain_id;
+      uint32_t                          head_size = 0;
+      char                              head[max_head_size];
+   };
+
+   read_replica_segment::read_replica_segment( const fc::path& state_dir, bool followed ) {
+      auto file = ( state_dir / config::read_replica_filename ).generic_string();
+      if( followed ) {
+         if( !fc::is_directory( state_dir ) )
+            fc::create_directories( state_dir );
+         std::ofstream( file.c_str(), std::ios::out | std::ios::app | std::ios::binary );
+         boost::filesystem::resize_file( file, sizeof(shared_data) );
+      } else {
+         EOS_ASSERT( fc::exists( file ), database_exception,
+                     "${f} does not exist; the node followed must run with enable-read-replicas", ("f", file) );
+         EOS_ASSERT( boost::filesystem::file_size( file ) == sizeof(shared_data), database_exception,
+                     "${f} was written by a different version", ("f", file) );
+      }
+
+      mapping = bip::file_mapping( file.c_str(), bip::read_write );
+      region = bip::mapped_region( mapping, bip::read_write, 0, sizeof(shared_data) );
+      if( followed ) {
+         // resets the lock, which a replica must not hold meanwhile: replicas are restarted along with the node
+         data = new( region.get_address() ) shared_data();
+      } else {
+         data = static_cast<shared_data*>( region.get_address() );
+         EOS_ASSERT( data->version == shared_data::current_version, database_exception,
+                     "${f} was written by a different version", ("f", file) );
+      }
+   }
+
+   read_replica_segment::~read_replica_segment() {}
+
+   void read_replica_segment::lock()          { data->state_mutex.lock(); }
+   void read_replica_segment::unlock()        { data->state_mutex.unlock(); }
+   void read_replica_segment::lock_shared()   { data->state_mutex.lock_sharable(); }
+   void read_replica_segment::unlock_shared() { data->state_mutex.unlock_sharable(); }
+
+   void read_replica_segment::publish_head( const chain_id_type& chain_id, const block_header_state& head ) {
+      auto size = fc::raw::pack_size( head );
+      EOS_ASSERT( size <= shared_data::max_head_size, database_exception,
+                  "header state of ${s} bytes does not fit the read replica segment", ("s", size) );
+      fc::datastream<char*> ds( data->head, size );
+      fc::raw::pack( ds, head );
+      data->head_size = size;
+      data->chain_id = chain_id;
+
+      bip::scoped_lock<bip::interprocess_mutex> g( data->revision_mutex );
+      data->revision.fetch_add( 1, std::memory_order_release );
+      data->revision_changed.notify_all();
+   }
+
+   uint64_t read_replica_segment::revision()const {
+      return data->revision.load( std::memory_order_acquire );
+   }
+
+   chain_id_type read_replica_segment::chain_id()const {
+      return data->chain_id;
+   }
+
+   block_header_state read_replica_segment::head()const {
+      EOS_ASSERT( data->head_size > 0, database_exception, "the node followed has not published a head yet" );
+      fc::datastream<const char*> ds( data->head, data->head_size );
+      block_header_state head;
+      fc::raw::unpack( ds, head );
+      return head;
+   }
+
+   bool read_replica_segment::wait_for_revision( uint64_t known, const fc::microseconds& timeout ) {
+      auto until = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( timeout.count() );
+      bip::scoped_lock<bip::interprocess_mutex> g( data->revision_mutex );
+      while( revision() == known ) {
+         if( !data->revision_changed.timed_wait( g, until ) )
+            break;
+      }
+      return revision() != known;
+   }
+
+} } /// eosio::chain
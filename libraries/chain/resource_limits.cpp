@@ -47,6 +47,89 @@ void resource_limits_state_object::update_virtual_net_limit( const resource_limi
    virtual_net_limit = update_elastic_limit(virtual_net_limit, average_block_net_usage.average(), cfg.net_limit_parameters);
 }
 
+namespace impl {
+   struct pending_account_usage {
+      account_name       owner;
+      usage_accumulator  net_usage;
+      usage_accumulator  cpu_usage;
+      uint32_t           previous;   ///< position of the previous entry of the same account, npos if none
+   };
+
+   /**
+    *  Account usage written while a block is pending. Instead of modifying the resource_usage_object of every
+    *  account a transaction bills, which leaves an undo entry per account and transaction, the new accumulators are
+    *  appended here and resource_limits_state_object::pending_usage_entries records how many entries are in effect.
+    *  That count is modified in the same session as the billing, so when the session of a transaction is undone the
+    *  entries past it are dropped the next time the journal is used. process_block_usage writes the latest entry of
+    *  every account back, one modify per account per block.
+    */
+   class pending_usage_journal {
+      public:
+         static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+         void sync( uint32_t in_effect ) {
+            EOS_ASSERT( in_effect <= entries.size(), rate_limiting_state_inconsistent,
+                        "pending account usage was lost, replay blockchain" );
+            while( entries.size() > in_effect ) {
+               const auto& e = entries.back();
+               if( e.previous == npos )
+                  latest.erase( e.owner );
+               else
+                  latest[e.owner] = e.previous;
+               entries.pop_back();
+            }
+         }
+
+         const pending_account_usage* find( const account_name& owner )const {
+            auto itr = latest.find( owner );
+            return itr != latest.end() ? &entries[itr->second] : nullptr;
+         }
+
+         void append( const account_name& owner, const usage_accumulator& net_usage, const usage_accumulator& cpu_usage ) {
+            auto itr = latest.find( owner );
+            entries.push_back( pending_account_usage{ owner, net_usage, cpu_usage, itr != latest.end() ? itr->second : npos } );
+            latest[owner] = entries.size() - 1;
+         }
+
+         uint32_t size()const { return entries.size(); }
+
+         template<typename F>
+         void for_each_account( F&& f )const {
+            for( const auto& l : latest )
+               f( entries[l.second] );
+         }
+
+         void clear() {
+            entries.clear();
+            latest.clear();
+         }
+
+      private:
+         vector<pending_account_usage>    entries;
+         map<account_name, uint32_t>      latest;   ///< position of the latest entry of each account
+   };
+}
+
+resource_limits_manager::resource_limits_manager(chainbase::database& db, bool committed_usage_only)
+:_db(db)
+,_pending_usage(std::make_unique<impl::pending_usage_journal>())
+,_committed_usage_only(committed_usage_only)
+{
+}
+
+resource_limits_manager::~resource_limits_manager() = default;
+
+void resource_limits_manager::sync_pending_usage()const {
+   _pending_usage->sync( _db.get<resource_limits_state_object>().pending_usage_entries );
+}
+
+const impl::pending_account_usage* resource_limits_manager::find_pending_usage( const account_name& account )const {
+   if( _committed_usage_only )
+      return nullptr; // the entries counted by pending_usage_entries are in the journal of the node followed
+   sync_pending_usage();
+   return _pending_usage->find( account );
+}
+
 void resource_limits_manager::add_indices() {
    resource_index_set::add_indices(_db);
 }
@@ -76,6 +159,7 @@ void resource_limits_manager::add_to_snapshot( const snapshot_writer_ptr& snapsh
 }
 
 void resource_limits_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+   _pending_usage->clear();
    resource_index_set::walk_indices([this, &snapshot]( auto utils ){
       snapshot->read_section<typename decltype(utils)::index_t::value_type>([this]( auto& section ) {
          bool more = !section.empty();
@@ -109,12 +193,28 @@ void resource_limits_manager::set_block_parameters(const elastic_limit_parameter
 }
 
 void resource_limits_manager::update_account_usage(const flat_set<account_name>& accounts, uint32_t time_slot ) {
+   const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
+   sync_pending_usage();
+   bool updated = false;
    for( const auto& a : accounts ) {
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
+      const auto* pending = _pending_usage->find( a );
+      const resource_usage_object* usage = pending ? nullptr : &_db.get<resource_usage_object,by_owner>( a );
+      auto net_usage = pending ? pending->net_usage : usage->net_usage;
+      auto cpu_usage = pending ? pending->cpu_usage : usage->cpu_usage;
+      // adding nothing in the slot the account was last billed in leaves it unchanged
+      if( net_usage.last_ordinal == time_slot && cpu_usage.last_ordinal == time_slot )
+         continue;
+
+      net_usage.add( 0, time_slot, config.account_net_usage_average_window );
+      cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
+      _pending_usage->append( a, net_usage, cpu_usage );
+      updated = true;
+   }
+
+   if( updated ) {
+      _db.modify(state, [&](resource_limits_state_object& rls){
+         rls.pending_usage_entries = _pending_usage->size();
       });
    }
 }
@@ -123,23 +223,26 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
    const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
 
+   sync_pending_usage();
    for( const auto& a : accounts ) {
 
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
+      const auto* pending = _pending_usage->find( a );
+      const resource_usage_object* usage = pending ? nullptr : &_db.get<resource_usage_object,by_owner>( a );
+      auto account_net_usage = pending ? pending->net_usage : usage->net_usage;
+      auto account_cpu_usage = pending ? pending->cpu_usage : usage->cpu_usage;
       int64_t unused;
       int64_t net_weight;
       int64_t cpu_weight;
       get_account_limits( a, unused, net_weight, cpu_weight );
 
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
-      });
+      account_net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
+      account_cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
+      _pending_usage->append( a, account_net_usage, account_cpu_usage );
 
       if( cpu_weight >= 0 && state.total_cpu_weight > 0 ) {
          uint128_t window_size = config.account_cpu_usage_average_window;
          auto virtual_network_capacity_in_window = (uint128_t)state.virtual_cpu_limit * window_size;
-         auto cpu_used_in_window                 = ((uint128_t)usage.cpu_usage.value_ex * window_size) / (uint128_t)config::rate_limiting_precision;
+         auto cpu_used_in_window                 = ((uint128_t)account_cpu_usage.value_ex * window_size) / (uint128_t)config::rate_limiting_precision;
 
          uint128_t user_weight     = (uint128_t)cpu_weight;
          uint128_t all_user_weight = state.total_cpu_weight;
@@ -158,7 +261,7 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
 
          uint128_t window_size = config.account_net_usage_average_window;
          auto virtual_network_capacity_in_window = (uint128_t)state.virtual_net_limit * window_size;
-         auto net_used_in_window                 = ((uint128_t)usage.net_usage.value_ex * window_size) / (uint128_t)config::rate_limiting_precision;
+         auto net_used_in_window                 = ((uint128_t)account_net_usage.value_ex * window_size) / (uint128_t)config::rate_limiting_precision;
 
          uint128_t user_weight     = (uint128_t)net_weight;
          uint128_t all_user_weight = state.total_net_weight;
@@ -179,6 +282,7 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
    _db.modify(state, [&](resource_limits_state_object& rls){
       rls.pending_cpu_usage += cpu_usage;
       rls.pending_net_usage += net_usage;
+      rls.pending_usage_entries = _pending_usage->size();
    });
 
    EOS_ASSERT( state.pending_cpu_usage <= config.cpu_limit_parameters.max, block_resource_exhausted, "Block has insufficient cpu resources" );
@@ -326,7 +430,20 @@ void resource_limits_manager::process_account_limit_updates() {
 void resource_limits_manager::process_block_usage(uint32_t block_num) {
    const auto& s = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
+
+   sync_pending_usage();
+   _pending_usage->for_each_account( [&]( const impl::pending_account_usage& pending ) {
+      const auto& usage = _db.get<resource_usage_object,by_owner>( pending.owner );
+      _db.modify( usage, [&]( auto& bu ){
+         bu.net_usage = pending.net_usage;
+         bu.cpu_usage = pending.cpu_usage;
+      });
+   });
+   _pending_usage->clear();
+
    _db.modify(s, [&](resource_limits_state_object& state){
+      state.pending_usage_entries = 0;
+
       // apply pending usage, update virtual limits and reset the pending
 
       state.average_block_cpu_usage.add(state.pending_cpu_usage, block_num, config.cpu_limit_parameters.periods);
@@ -371,7 +488,8 @@ int64_t resource_limits_manager::get_account_cpu_limit( const account_name& name
 account_resource_limit resource_limits_manager::get_account_cpu_limit_ex( const account_name& name, bool elastic) const {
 
    const auto& state = _db.get<resource_limits_state_object>();
-   const auto& usage = _db.get<resource_usage_object, by_owner>(name);
+   const auto* pending = find_pending_usage( name );
+   const auto& cpu_usage = pending ? pending->cpu_usage : _db.get<resource_usage_object, by_owner>(name).cpu_usage;
    const auto& config = _db.get<resource_limits_config_object>();
 
    int64_t cpu_weight, x, y;
@@ -390,7 +508,7 @@ account_resource_limit resource_limits_manager::get_account_cpu_limit_ex( const
    uint128_t all_user_weight = (uint128_t)state.total_cpu_weight;
 
    auto max_user_use_in_window = (virtual_cpu_capacity_in_window * user_weight) / all_user_weight;
-   auto cpu_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.cpu_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   auto cpu_used_in_window  = impl::integer_divide_ceil((uint128_t)cpu_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
 
    if( max_user_use_in_window <= cpu_used_in_window )
       arl.available = 0;
@@ -410,7 +528,8 @@ int64_t resource_limits_manager::get_account_net_limit( const account_name& name
 account_resource_limit resource_limits_manager::get_account_net_limit_ex( const account_name& name, bool elastic) const {
    const auto& config = _db.get<resource_limits_config_object>();
    const auto& state  = _db.get<resource_limits_state_object>();
-   const auto& usage  = _db.get<resource_usage_object, by_owner>(name);
+   const auto* pending = find_pending_usage( name );
+   const auto& net_usage = pending ? pending->net_usage : _db.get<resource_usage_object, by_owner>(name).net_usage;
 
    int64_t net_weight, x, y;
    get_account_limits( name, x, net_weight, y );
@@ -429,7 +548,7 @@ account_resource_limit resource_limits_manager::get_account_net_limit_ex( const
 
 
    auto max_user_use_in_window = (virtual_network_capacity_in_window * user_weight) / all_user_weight;
-   auto net_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.net_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   auto net_used_in_window  = impl::integer_divide_ceil((uint128_t)net_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
 
    if( max_user_use_in_window <= net_used_in_window )
       arl.available = 0;
@@ -0,0 +1,97 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/signal_dispatcher.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_registry.hpp>
+
+namespace eosio { namespace chain {
+
+   signal_dispatcher::signal_dispatcher( uint32_t threads_count, uint32_t max_pending_handlers )
+   :max_pending( std::max( max_pending_handlers, 1u ) )
+   {
+      if( threads_count ) {
+         work.reset( new boost::asio::io_service::work( ios ) );
+         for( uint32_t i = 0; i < threads_count; ++i )
+            threads.emplace_back( [this, i]() {
+               thread_registry::instance().register_current_thread( "chain-signal-" + std::to_string( i ) );
+               ios.run();
+            } );
+      }
+   }
+
+   signal_dispatcher::~signal_dispatcher() {
+      stop();
+   }
+
+   void signal_dispatcher::stop() {
+      if( threads.empty() )
+         return;
+      work.reset(); // the threads return once nothing is left to run
+      for( auto& t : threads )
+         t.join();
+      threads.clear();
+   }
+
+   signal_dispatcher::subscriber_ptr signal_dispatcher::make_subscriber( const std::string& name ) {
+      return std::make_shared<subscriber>( *this, name );
+   }
+
+   void signal_dispatcher::schedule( const subscriber_ptr& s ) {
+      ios.post( [s]() { s->drain(); } );
+   }
+
+   signal_dispatcher::subscriber::subscriber( signal_dispatcher& dispatcher, const std::string& name )
+   :_dispatcher( dispatcher ), _name( name )
+   {}
+
+   void signal_dispatcher::subscriber::post( std::function<void()> f ) {
+      if( !_dispatcher.running() ) {
+         f();
+         return;
+      }
+
+      std::unique_lock<std::mutex> g( _mutex );
+      _cond.wait( g, [&]() { return _pending.size() < _dispatcher.max_pending; } );
+      _pending.push_back( std::move( f ) );
+      if( !_draining ) {
+         _draining = true;
+         _dispatcher.schedule( shared_from_this() );
+      }
+   }
+
+   void signal_dispatcher::subscriber::flush() {
+      std::unique_lock<std::mutex> g( _mutex );
+      _cond.wait( g, [&]() { return !_draining; } );
+   }
+
+   void signal_dispatcher::subscriber::drain() {
+      // a batch at a time, so that the other subscribers get their turn on a small pool
+      for( uint32_t n = 0; n < 64; ++n ) {
+         std::function<void()> f;
+         {
+            std::lock_guard<std::mutex> g( _mutex );
+            if( _pending.empty() ) {
+               _draining = false;
+               _cond.notify_all();
+               return;
+            }
+            f = std::move( _pending.front() );
+            _pending.pop_front();
+            _cond.notify_all();
+         }
+         try {
+            f();
+         } catch( const fc::exception& e ) {
+            wlog( "${s} signal handler: ${details}", ("s", _name)("details", e.to_detail_string()) );
+         } catch( const std::exception& e ) {
+            wlog( "${s} signal handler: ${what}", ("s", _name)("what", e.what()) );
+         } catch( ... ) {
+            wlog( "${s} signal handler threw exception", ("s", _name) );
+         }
+      }
+      _dispatcher.schedule( shared_from_this() );
+   }
+
+} } /// eosio::chain
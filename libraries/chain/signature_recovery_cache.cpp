@@ -0,0 +1,82 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/metrics.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace chain {
+
+   signature_recovery_cache& signature_recovery_cache::instance() {
+      static signature_recovery_cache cache;
+      return cache;
+   }
+
+   public_key_type signature_recovery_cache::recover( const signature_type& sig, const digest_type& digest ) {
+      static auto& recovery_time = metrics_registry::instance().histogram( "eosio_chain_signature_recovery_seconds",
+                                                                            "time to recover the key of a signature not in the recovery cache" );
+      static auto& hits = metrics_registry::instance().counter( "eosio_chain_signature_recovery_cache_hits_total",
+                                                                "signatures whose key was found in the recovery cache" );
+
+      const auto capacity = shard_capacity.load( std::memory_order_relaxed );
+      if( !capacity ) {
+         scoped_metric_timer timer( recovery_time );
+         return public_key_type( sig, digest );
+      }
+
+      digest_type::encoder enc;
+      fc::raw::pack( enc, digest );
+      fc::raw::pack( enc, sig );
+      const auto key = enc.result();
+      auto& s = _shards[key._hash[1] % shards];
+      {
+         std::lock_guard<std::mutex> g( s.mtx );
+         auto itr = s.keys.find( key );
+         if( itr != s.keys.end() ) {
+            hits.add();
+            return itr->second;
+         }
+      }
+
+      public_key_type recovered;
+      {
+         scoped_metric_timer timer( recovery_time );
+         recovered = public_key_type( sig, digest );
+      }
+
+      std::lock_guard<std::mutex> g( s.mtx );
+      if( s.keys.emplace( key, recovered ).second )
+         s.order.push_back( key );
+      while( s.order.size() > capacity ) {
+         s.keys.erase( s.order.front() );
+         s.order.pop_front();
+      }
+      return recovered;
+   }
+
+   void signature_recovery_cache::set_capacity( uint32_t entries ) {
+      shard_capacity.store( entries ? std::max<uint32_t>( entries / shards, 1 ) : 0, std::memory_order_relaxed );
+      if( !entries )
+         clear();
+   }
+
+   size_t signature_recovery_cache::size()const {
+      size_t n = 0;
+      for( const auto& s : _shards ) {
+         std::lock_guard<std::mutex> g( s.mtx );
+         n += s.keys.size();
+      }
+      return n;
+   }
+
+   void signature_recovery_cache::clear() {
+      for( auto& s : _shards ) {
+         std::lock_guard<std::mutex> g( s.mtx );
+         s.keys.clear();
+         s.order.clear();
+      }
+   }
+
+} } /// eosio::chain
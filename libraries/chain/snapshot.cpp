@@ -1,9 +1,188 @@
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/config.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <sstream>
+
 namespace eosio { namespace chain {
 
+namespace bio = boost::iostreams;
+
+namespace detail {
+   /// serializes the rows of one section into memory
+   class section_buffer_writer : public snapshot_writer {
+      public:
+         std::string rows() const { return out.str(); }
+         uint64_t    row_count = 0;
+         std::string encoded;
+
+      protected:
+         void write_start_section( const std::string& ) override {}
+         void write_row( const abstract_snapshot_row_writer& row_writer ) override {
+            row_writer.write(wrapper);
+            ++row_count;
+         }
+         void write_end_section( ) override {}
+
+      private:
+         std::ostringstream out;
+         ostream_wrapper    wrapper{out};
+   };
+
+   static std::string zlib_compress( const char* data, size_t size ) {
+      std::string out;
+      bio::filtering_ostream comp;
+      comp.push(bio::zlib_compressor(bio::zlib::default_compression));
+      comp.push(bio::back_inserter(out));
+      bio::write(comp, data, size);
+      bio::close(comp);
+      return out;
+   }
+
+   static std::string zlib_decompress( const std::string& data ) {
+      try {
+         std::string out;
+         bio::filtering_ostream decomp;
+         decomp.push(bio::zlib_decompressor());
+         decomp.push(bio::back_inserter(out));
+         bio::write(decomp, data.data(), data.size());
+         bio::close(decomp);
+         return out;
+      } catch( const bio::zlib_error& e ) {
+         EOS_THROW( snapshot_exception, "Compressed snapshot has a corrupted frame (${what})", ("what", e.what()) );
+      }
+   }
+
+   /// compresses rows into frames of up to config::snapshot_frame_size uncompressed bytes
+   static std::string compress_frames( const std::string& rows ) {
+      std::string frames;
+      for( size_t pos = 0; pos < rows.size(); pos += config::snapshot_frame_size ) {
+         auto frame = zlib_compress( rows.data() + pos, std::min<size_t>( config::snapshot_frame_size, rows.size() - pos ) );
+         uint32_t size = frame.size();
+         frames.append( (const char*)&size, sizeof(size) );
+         frames.append( frame );
+      }
+      return frames;
+   }
+
+   /// reads the rows of one section from memory
+   class section_buffer_reader : public snapshot_reader {
+      public:
+         section_buffer_reader( const std::string& rows, uint64_t row_count )
+         :in(rows)
+         ,num_rows(row_count)
+         {}
+
+         void validate() const override {}
+
+      protected:
+         bool has_section( const std::string& ) override { return false; }
+         void set_section( const std::string& ) override {}
+         bool read_row( abstract_snapshot_row_reader& row_reader ) override {
+            row_reader.provide(in);
+            return ++cur_row < num_rows;
+         }
+         bool empty( ) override { return num_rows == 0; }
+         void clear_section() override {}
+
+      private:
+         std::istringstream in;
+         uint64_t           num_rows;
+         uint64_t           cur_row = 0;
+   };
+}
+
+void snapshot_writer::write_queued_sections( const vector<std::pair<std::string, section_function>>& sections, uint32_t threads ) {
+   const std::string* open_section = nullptr;
+   auto start_section = [&]( const std::string& name ) {
+      if( open_section && *open_section == name )
+         return;
+      if( open_section )
+         write_end_section();
+      write_start_section( name );
+      open_section = &name;
+   };
+
+   if( threads < 2 || !accepts_serialized_rows() ) {
+      for( const auto& s : sections ) {
+         start_section( s.first );
+         auto section = section_writer(*this);
+         s.second(section);
+      }
+   } else {
+      // sections are serialized ahead while the oldest one is written, keeping at most `threads` of them in memory
+      std::deque<std::pair<size_t, std::future<std::shared_ptr<detail::section_buffer_writer>>>> running;
+      auto write_oldest = [&]() {
+         auto buffer = running.front().second.get();
+         start_section( sections[running.front().first].first );
+         write_rows( buffer->row_count, buffer->encoded );
+         running.pop_front();
+      };
+      for( size_t i = 0; i < sections.size(); ++i ) {
+         if( running.size() >= threads )
+            write_oldest();
+         running.emplace_back( i, std::async( std::launch::async, [this, &sections, i]() {
+            auto buffer = std::make_shared<detail::section_buffer_writer>();
+            auto section = section_writer(*buffer);
+            sections[i].second(section);
+            buffer->encoded = encode_rows( buffer->rows() );
+            return buffer;
+         }));
+      }
+      while( !running.empty() )
+         write_oldest();
+   }
+
+   if( open_section )
+      write_end_section();
+}
+
+void snapshot_reader::read_queued_sections( const vector<std::pair<std::string, section_function>>& sections, uint32_t threads ) {
+   if( threads < 2 || !provides_serialized_rows() ) {
+      for( const auto& s : sections )
+         read_section( s.first, s.second );
+      return;
+   }
+
+   // sections are loaded into memory one at a time and deserialized by the workers; the largest ones are read
+   // straight from the snapshot on this thread once the others have been handed out
+   std::deque<std::future<void>> running;
+   vector<size_t> streamed;
+   for( size_t i = 0; i < sections.size(); ++i ) {
+      if( serialized_rows_size( sections[i].first ) > config::snapshot_max_buffered_section_size ) {
+         streamed.push_back( i );
+         continue;
+      }
+      auto rows = std::make_shared<std::string>();
+      auto row_count = read_serialized_rows( sections[i].first, *rows );
+      if( running.size() >= threads ) {
+         running.front().get();
+         running.pop_front();
+      }
+      running.emplace_back( std::async( std::launch::async, [&sections, i, rows, row_count]() {
+         detail::section_buffer_reader buffer( *rows, row_count );
+         auto section = section_reader(buffer);
+         sections[i].second(section);
+      }));
+   }
+   for( auto i : streamed )
+      read_section( sections[i].first, sections[i].second );
+   while( !running.empty() ) {
+      running.front().get();
+      running.pop_front();
+   }
+}
+
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
 : snapshot(snapshot)
 {
@@ -178,6 +357,11 @@ void ostream_snapshot_writer::write_end_section( ) {
    row_count = 0;
 }
 
+void ostream_snapshot_writer::write_rows( uint64_t count, const std::string& rows ) {
+   snapshot.write(rows.data(), rows.size());
+   row_count += count;
+}
+
 void ostream_snapshot_writer::finalize() {
    uint64_t end_marker = std::numeric_limits<uint64_t>::max();
 
@@ -188,6 +372,7 @@ void ostream_snapshot_writer::finalize() {
 istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 :snapshot(snapshot)
 ,header_pos(snapshot.tellg())
+,section_end(-1)
 ,num_rows(0)
 ,cur_row(0)
 {
@@ -312,6 +497,7 @@ void istream_snapshot_reader::set_section( const string& section_name ) {
       if (match && snapshot.get() == 0) {
          cur_row = 0;
          num_rows = row_count;
+         section_end = next_section_pos;
 
          // leave the stream at the right point
          restore_pos.cancel();
@@ -336,6 +522,538 @@ void istream_snapshot_reader::clear_section() {
    cur_row = 0;
 }
 
+uint64_t istream_snapshot_reader::serialized_rows_size( const string& section_name ) {
+   set_section(section_name);
+   auto size = section_end - snapshot.tellg();
+   clear_section();
+   return size;
+}
+
+uint64_t istream_snapshot_reader::read_serialized_rows( const string& section_name, std::string& rows ) {
+   set_section(section_name);
+   auto row_count = num_rows;
+   rows.resize( section_end - snapshot.tellg() );
+   snapshot.read( &rows[0], rows.size() );
+   clear_section();
+   return row_count;
+}
+
+compressed_ostream_snapshot_writer::compressed_ostream_snapshot_writer(std::ostream& snapshot)
+:snapshot(snapshot)
+,pending_wrapper(pending)
+,row_count(0)
+{
+   auto totem = magic_number;
+   snapshot.write((char*)&totem, sizeof(totem));
+
+   auto version = current_snapshot_version;
+   snapshot.write((char*)&version, sizeof(version));
+}
+
+void compressed_ostream_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(!section_name.empty(), snapshot_exception, "Compressed snapshot sections must be named");
+   snapshot.write(section_name.data(), section_name.size());
+   snapshot.put(0);
+
+   digest.reset();
+   pending.str(std::string());
+   row_count = 0;
+}
+
+void compressed_ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_writer.write(pending_wrapper);
+   row_count++;
+   if( pending.tellp() >= std::streampos(config::snapshot_frame_size) )
+      flush_rows();
+}
+
+std::string compressed_ostream_snapshot_writer::encode_rows( std::string rows ) const {
+   return detail::compress_frames( rows );
+}
+
+void compressed_ostream_snapshot_writer::write_rows( uint64_t count, const std::string& frames ) {
+   flush_rows();
+   write_frames( frames );
+   row_count += count;
+}
+
+void compressed_ostream_snapshot_writer::write_frames( const std::string& frames ) {
+   snapshot.write(frames.data(), frames.size());
+   digest.write(frames.data(), frames.size());
+}
+
+void compressed_ostream_snapshot_writer::flush_rows() {
+   auto rows = pending.str();
+   if( rows.empty() )
+      return;
+   pending.str(std::string());
+   write_frames( detail::compress_frames( rows ) );
+}
+
+void compressed_ostream_snapshot_writer::write_end_section( ) {
+   flush_rows();
+
+   uint32_t end_of_rows = 0;
+   snapshot.write((char*)&end_of_rows, sizeof(end_of_rows));
+   snapshot.write((char*)&row_count, sizeof(row_count));
+   auto result = digest.result();
+   snapshot.write(result.data(), result.data_size());
+}
+
+void compressed_ostream_snapshot_writer::finalize() {
+   // an empty name ends the snapshot
+   snapshot.put(0);
+}
+
+/// presents the frames of a section as one stream of rows
+class compressed_istream_snapshot_reader::frame_buffer : public std::streambuf {
+   public:
+      explicit frame_buffer( std::istream& in )
+      :in(in)
+      {}
+
+      std::istream&        in;
+      bool                 finished = false;
+      fc::sha256::encoder  digest;
+
+   protected:
+      int_type underflow() override {
+         while( gptr() == egptr() && !finished ) {
+            uint32_t size = 0;
+            in.read((char*)&size, sizeof(size));
+            EOS_ASSERT(in.good(), snapshot_exception, "Compressed snapshot ends in the middle of a section");
+            if( size == 0 ) {
+               finished = true;
+               break;
+            }
+
+            std::string frame(size, '\0');
+            in.read(&frame[0], size);
+            EOS_ASSERT(in.good(), snapshot_exception, "Compressed snapshot ends in the middle of a section");
+            digest.write((const char*)&size, sizeof(size));
+            digest.write(frame.data(), frame.size());
+
+            data = detail::zlib_decompress( frame );
+            setg(&data[0], &data[0], &data[0] + data.size());
+         }
+         return gptr() == egptr() ? traits_type::eof() : traits_type::to_int_type(*gptr());
+      }
+
+   private:
+      std::string data;
+};
+
+compressed_istream_snapshot_reader::compressed_istream_snapshot_reader(std::istream& snapshot)
+:snapshot(snapshot)
+,version(0)
+{
+   uint32_t totem = 0;
+   snapshot.read((char*)&totem, sizeof(totem));
+   snapshot.read((char*)&version, sizeof(version));
+   EOS_ASSERT(snapshot.good() && totem == compressed_ostream_snapshot_writer::magic_number, snapshot_exception,
+              "Compressed snapshot has unexpected magic number!");
+}
+
+compressed_istream_snapshot_reader::~compressed_istream_snapshot_reader() {}
+
+void compressed_istream_snapshot_reader::validate() const {
+   EOS_ASSERT(version == current_snapshot_version, snapshot_exception,
+              "Compressed snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+              ("expected", current_snapshot_version)("actual", version));
+}
+
+bool compressed_istream_snapshot_reader::find_section( const string& section_name ) {
+   if( next_section == section_name || passed_sections.count(section_name) )
+      return true;
+
+   while( !at_end ) {
+      if( !next_section.empty() ) {
+         // keep the section in the way, frames and trailer as they are
+         std::string body;
+         while( true ) {
+            uint32_t size = 0;
+            snapshot.read((char*)&size, sizeof(size));
+            EOS_ASSERT(snapshot.good(), snapshot_exception, "Compressed snapshot ends in the middle of a section");
+            body.append((const char*)&size, sizeof(size));
+            if( size == 0 )
+               break;
+            auto pos = body.size();
+            body.resize(pos + size);
+            snapshot.read(&body[pos], size);
+         }
+         auto pos = body.size();
+         body.resize(pos + sizeof(uint64_t) + fc::sha256().data_size());
+         snapshot.read(&body[pos], body.size() - pos);
+         EOS_ASSERT(snapshot.good(), snapshot_exception, "Compressed snapshot ends in the middle of a section");
+         passed_sections[next_section] = std::move(body);
+         next_section.clear();
+      }
+
+      std::getline(snapshot, next_section, '\0');
+      EOS_ASSERT(snapshot.good(), snapshot_exception, "Compressed snapshot ends without an end marker");
+      if( next_section.empty() ) {
+         at_end = true;
+      } else if( next_section == section_name ) {
+         return true;
+      }
+   }
+   return false;
+}
+
+bool compressed_istream_snapshot_reader::has_section( const string& section_name ) {
+   return find_section(section_name);
+}
+
+void compressed_istream_snapshot_reader::set_section( const string& section_name ) {
+   EOS_ASSERT(find_section(section_name), snapshot_exception,
+              "Compressed snapshot has no section named ${n} left to read", ("n", section_name));
+
+   std::istream* source = &snapshot;
+   if( next_section == section_name ) {
+      next_section.clear();
+   } else {
+      passed_section = std::make_unique<std::istringstream>(std::move(passed_sections[section_name]));
+      passed_sections.erase(section_name);
+      source = passed_section.get();
+   }
+
+   frames = std::make_unique<frame_buffer>(*source);
+   rows = std::make_unique<std::istream>(frames.get());
+   rows->exceptions(std::istream::badbit | std::istream::failbit);
+   cur_row = 0;
+}
+
+bool compressed_istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   try {
+      row_reader.provide(*rows);
+   } catch( const std::ios_base::failure& e ) {
+      EOS_THROW(snapshot_exception, "Compressed snapshot section ends in the middle of a row (${what})", ("what", e.what()));
+   }
+   ++cur_row;
+   return rows->peek() != std::istream::traits_type::eof();
+}
+
+bool compressed_istream_snapshot_reader::empty ( ) {
+   return rows->peek() == std::istream::traits_type::eof();
+}
+
+void compressed_istream_snapshot_reader::clear_section() {
+   if( !frames )
+      return;
+
+   rows->ignore(std::numeric_limits<std::streamsize>::max());
+   auto& source = frames->in;
+   uint64_t row_count = 0;
+   fc::sha256 expected;
+   source.read((char*)&row_count, sizeof(row_count));
+   source.read(expected.data(), expected.data_size());
+   EOS_ASSERT(source.good(), snapshot_exception, "Compressed snapshot ends in the middle of a section");
+   EOS_ASSERT(frames->digest.result() == expected, snapshot_exception, "Compressed snapshot section does not match its digest");
+   EOS_ASSERT(row_count == cur_row, snapshot_exception,
+              "Compressed snapshot section holds ${expected} rows, ${actual} were read", ("expected", row_count)("actual", cur_row));
+
+   rows.reset();
+   frames.reset();
+   passed_section.reset();
+   cur_row = 0;
+}
+
+namespace detail {
+   enum class delta_entry : uint8_t {
+      end_of_section = 0,
+      base_chunk     = 1,   ///< digest of a chunk of the base
+      literal_chunk  = 2    ///< uint32 size and that many bytes of zlib compressed rows
+   };
+
+   /// a binary snapshot writer that can be given the rows of a section in pieces
+   struct raw_snapshot_writer : public ostream_snapshot_writer {
+      using ostream_snapshot_writer::ostream_snapshot_writer;
+      using ostream_snapshot_writer::write_rows;
+   };
+
+   /// walks the sections of a binary snapshot, passing their rows in pieces
+   template<typename StartSection, typename Rows, typename EndSection>
+   void read_binary_snapshot( std::istream& in, StartSection start_section, Rows rows, EndSection end_section ) {
+      uint32_t totem = 0, version = 0;
+      in.read((char*)&totem, sizeof(totem));
+      in.read((char*)&version, sizeof(version));
+      EOS_ASSERT(in.good() && totem == ostream_snapshot_writer::magic_number && version == current_snapshot_version,
+                 snapshot_exception, "Not a binary snapshot of version ${v}", ("v", current_snapshot_version));
+
+      vector<char> buffer(1024*1024);
+      while( true ) {
+         uint64_t section_size = 0;
+         in.read((char*)&section_size, sizeof(section_size));
+         EOS_ASSERT(in.good(), snapshot_exception, "Binary snapshot ends without an end marker");
+         if( section_size == std::numeric_limits<uint64_t>::max() )
+            break;
+
+         uint64_t row_count = 0;
+         in.read((char*)&row_count, sizeof(row_count));
+         std::string name;
+         std::getline(in, name, '\0');
+         EOS_ASSERT(in.good() && section_size >= sizeof(row_count) + name.size() + 1, snapshot_exception,
+                    "Binary snapshot has a malformed section header");
+
+         start_section( name, uint64_t(in.tellg()) );
+         for( uint64_t remaining = section_size - sizeof(row_count) - name.size() - 1; remaining > 0; ) {
+            auto n = std::min<uint64_t>( remaining, buffer.size() );
+            in.read(buffer.data(), n);
+            EOS_ASSERT(in.good(), snapshot_exception, "Binary snapshot ends in the middle of a section");
+            rows( buffer.data(), n );
+            remaining -= n;
+         }
+         end_section( row_count );
+      }
+   }
+}
+
+/**
+ * Cuts a stream of bytes into chunks wherever a gear hash of the bytes since the start of the chunk has its
+ * low bits clear, which happens every average_size bytes on average. The boundaries define the delta format,
+ * so neither the table nor the sizes can change.
+ */
+class delta_snapshot_writer::chunker {
+   public:
+      static const uint32_t min_size     = 2*1024;
+      static const uint32_t average_size = 8*1024;
+      static const uint32_t max_size     = 64*1024;
+
+      explicit chunker( std::function<void(const std::string&)> emit )
+      :emit(std::move(emit))
+      {}
+
+      void feed( const char* data, size_t size ) {
+         const auto& gear = gear_table();
+         for( size_t i = 0; i < size; ++i ) {
+            current.push_back(data[i]);
+            hash = (hash << 1) + gear[(uint8_t)data[i]];
+            if( (current.size() >= min_size && (hash & (average_size - 1)) == 0) || current.size() >= max_size )
+               finish();
+         }
+      }
+
+      void finish() {
+         if( !current.empty() )
+            emit(current);
+         current.clear();
+         hash = 0;
+      }
+
+   private:
+      static const std::array<uint64_t, 256>& gear_table() {
+         static const auto table = []() {
+            std::array<uint64_t, 256> t;
+            uint64_t x = 0x736e617073686f74ull;   // splitmix64
+            for( auto& v : t ) {
+               uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+               z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+               z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+               v = z ^ (z >> 31);
+            }
+            return t;
+         }();
+         return table;
+      }
+
+      std::function<void(const std::string&)> emit;
+      std::string current;
+      uint64_t    hash = 0;
+};
+
+delta_snapshot_writer::delta_snapshot_writer(std::ostream& delta, const snapshot_chunk_index& base)
+:delta(delta)
+,base(base)
+,pending_wrapper(pending)
+,rows(std::make_shared<chunker>([this]( const std::string& chunk ) { write_chunk(chunk); }))
+,row_count(0)
+{
+   auto totem = magic_number;
+   delta.write((char*)&totem, sizeof(totem));
+
+   auto version = current_snapshot_version;
+   delta.write((char*)&version, sizeof(version));
+
+   delta.write(base.integrity_hash.data(), base.integrity_hash.data_size());
+}
+
+void delta_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(!section_name.empty(), snapshot_exception, "Delta snapshot sections must be named");
+   delta.write(section_name.data(), section_name.size());
+   delta.put(0);
+   pending.str(std::string());
+   row_count = 0;
+}
+
+void delta_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_writer.write(pending_wrapper);
+   row_count++;
+   if( pending.tellp() >= std::streampos(chunker::max_size) )
+      flush_rows();
+}
+
+void delta_snapshot_writer::write_rows( uint64_t count, const std::string& serialized ) {
+   flush_rows();
+   rows->feed(serialized.data(), serialized.size());
+   row_count += count;
+}
+
+void delta_snapshot_writer::flush_rows() {
+   auto serialized = pending.str();
+   pending.str(std::string());
+   rows->feed(serialized.data(), serialized.size());
+}
+
+void delta_snapshot_writer::write_chunk( const std::string& chunk ) {
+   auto digest = fc::sha256::hash(chunk);
+   integrity.write(chunk.data(), chunk.size());
+   written.chunks.emplace(digest, snapshot_chunk_index::chunk{0, uint32_t(chunk.size())});
+
+   if( base.chunks.count(digest) ) {
+      delta.put((char)detail::delta_entry::base_chunk);
+      delta.write(digest.data(), digest.data_size());
+   } else {
+      auto compressed = detail::zlib_compress(chunk.data(), chunk.size());
+      uint32_t size = compressed.size();
+      delta.put((char)detail::delta_entry::literal_chunk);
+      delta.write((char*)&size, sizeof(size));
+      delta.write(compressed.data(), compressed.size());
+   }
+}
+
+void delta_snapshot_writer::write_end_section( ) {
+   flush_rows();
+   rows->finish();
+   delta.put((char)detail::delta_entry::end_of_section);
+   delta.write((char*)&row_count, sizeof(row_count));
+}
+
+void delta_snapshot_writer::finalize() {
+   written.integrity_hash = integrity.result();
+   delta.put(0);
+   delta.write(written.integrity_hash.data(), written.integrity_hash.data_size());
+}
+
+snapshot_chunk_index delta_snapshot_writer::index_snapshot( std::istream& snapshot ) {
+   snapshot_chunk_index index;
+   fc::sha256::encoder integrity;
+   uint64_t pos = 0;
+   chunker rows([&]( const std::string& chunk ) {
+      index.chunks.emplace(fc::sha256::hash(chunk), snapshot_chunk_index::chunk{pos, uint32_t(chunk.size())});
+      integrity.write(chunk.data(), chunk.size());
+      pos += chunk.size();
+   });
+
+   detail::read_binary_snapshot( snapshot,
+      [&]( const std::string&, uint64_t rows_pos ) { pos = rows_pos; },
+      [&]( const char* data, size_t size ) { rows.feed(data, size); },
+      [&]( uint64_t ) { rows.finish(); } );
+
+   index.integrity_hash = integrity.result();
+   return index;
+}
+
+void delta_snapshot_writer::create( std::istream& base, std::istream& target, std::ostream& delta ) {
+   auto index = index_snapshot( base );
+   delta_snapshot_writer writer( delta, index );
+   detail::read_binary_snapshot( target,
+      [&]( const std::string& name, uint64_t ) { writer.write_start_section(name); },
+      [&]( const char* data, size_t size ) { writer.write_rows(0, std::string(data, size)); },
+      [&]( uint64_t row_count ) {
+         writer.write_rows(row_count, std::string());
+         writer.write_end_section();
+      } );
+   writer.finalize();
+}
+
+void delta_snapshot_writer::apply( const fc::path& base, const vector<fc::path>& deltas, const fc::path& output ) {
+   EOS_ASSERT(!deltas.empty(), snapshot_exception, "No delta snapshot to apply");
+
+   fc::path state = base;
+   for( size_t i = 0; i < deltas.size(); ++i ) {
+      std::ifstream state_in(state.generic_string(), std::ios::in | std::ios::binary);
+      EOS_ASSERT(state_in.good(), snapshot_exception, "Unable to open ${f}", ("f", state.generic_string()));
+      auto index = index_snapshot( state_in );
+      state_in.clear();
+
+      std::ifstream delta_in(deltas[i].generic_string(), std::ios::in | std::ios::binary);
+      uint32_t totem = 0, version = 0;
+      fc::sha256 base_hash;
+      delta_in.read((char*)&totem, sizeof(totem));
+      delta_in.read((char*)&version, sizeof(version));
+      delta_in.read(base_hash.data(), base_hash.data_size());
+      EOS_ASSERT(delta_in.good() && totem == magic_number && version == current_snapshot_version, snapshot_exception,
+                 "${f} is not a delta snapshot of version ${v}", ("f", deltas[i].generic_string())("v", current_snapshot_version));
+      EOS_ASSERT(base_hash == index.integrity_hash, snapshot_exception,
+                 "${f} was not taken against the state it is applied to", ("f", deltas[i].generic_string()));
+
+      // intermediate states are written next to the output and removed once the next one has been built
+      auto target = output;
+      if( i + 1 < deltas.size() )
+         target = fc::path( output.generic_string() + ".part" + std::to_string(i % 2) );
+
+      std::ofstream out(target.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc);
+      detail::raw_snapshot_writer writer(out);
+      fc::sha256::encoder integrity;
+      auto write = [&]( const std::string& rows ) {
+         integrity.write(rows.data(), rows.size());
+         writer.write_rows(0, rows);
+      };
+
+      while( true ) {
+         std::string name;
+         std::getline(delta_in, name, '\0');
+         EOS_ASSERT(delta_in.good(), snapshot_exception, "Delta snapshot ends without an end marker");
+         if( name.empty() )
+            break;
+
+         writer.write_start_section(name);
+         while( true ) {
+            auto entry = (detail::delta_entry)delta_in.get();
+            EOS_ASSERT(delta_in.good(), snapshot_exception, "Delta snapshot ends in the middle of a section");
+            if( entry == detail::delta_entry::end_of_section )
+               break;
+
+            if( entry == detail::delta_entry::base_chunk ) {
+               fc::sha256 digest;
+               delta_in.read(digest.data(), digest.data_size());
+               auto itr = index.chunks.find(digest);
+               EOS_ASSERT(itr != index.chunks.end(), snapshot_exception, "Delta snapshot refers to a chunk its base does not have");
+               std::string chunk(itr->second.size, '\0');
+               state_in.seekg(itr->second.pos);
+               state_in.read(&chunk[0], chunk.size());
+               EOS_ASSERT(state_in.good(), snapshot_exception, "Unable to read a chunk of ${f}", ("f", state.generic_string()));
+               write(chunk);
+            } else {
+               EOS_ASSERT(entry == detail::delta_entry::literal_chunk, snapshot_exception, "Delta snapshot has an unknown entry");
+               uint32_t size = 0;
+               delta_in.read((char*)&size, sizeof(size));
+               std::string compressed(size, '\0');
+               delta_in.read(&compressed[0], size);
+               EOS_ASSERT(delta_in.good(), snapshot_exception, "Delta snapshot ends in the middle of a section");
+               write(detail::zlib_decompress(compressed));
+            }
+         }
+
+         uint64_t row_count = 0;
+         delta_in.read((char*)&row_count, sizeof(row_count));
+         writer.write_rows(row_count, std::string());
+         writer.write_end_section();
+      }
+
+      fc::sha256 state_hash;
+      delta_in.read(state_hash.data(), state_hash.data_size());
+      EOS_ASSERT(delta_in.good() && state_hash == integrity.result(), snapshot_exception,
+                 "Applying ${f} did not give the state it recorded", ("f", deltas[i].generic_string()));
+      writer.finalize();
+      out.close();
+
+      if( i > 0 )
+         fc::remove(state);
+      state = target;
+   }
+}
+
 integrity_hash_snapshot_writer::integrity_hash_snapshot_writer(fc::sha256::encoder& enc)
 :enc(enc)
 {
@@ -350,6 +1068,10 @@ void integrity_hash_snapshot_writer::write_row( const detail::abstract_snapshot_
    row_writer.write(enc);
 }
 
+void integrity_hash_snapshot_writer::write_rows( uint64_t, const std::string& rows ) {
+   enc.write(rows.data(), rows.size());
+}
+
 void integrity_hash_snapshot_writer::write_end_section( ) {
    // no-op for structural details
 }
@@ -0,0 +1,175 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/thread_registry.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+#include <time.h>
+
+namespace eosio { namespace chain {
+
+   struct thread_registry::tracked_thread {
+      string            name;
+      metric_counter*   cpu_time = nullptr;
+      uint64_t          reported_us = 0;
+#ifdef __linux__
+      clockid_t         clock;
+#endif
+   };
+
+   /// held by every registered thread, so that it is no longer tracked once it exits
+   struct thread_registration {
+      std::unique_ptr<thread_registry::tracked_thread> thread;
+
+      ~thread_registration() {
+         if( thread )
+            thread_registry::instance().unregister( thread.get() );
+      }
+   };
+
+   namespace {
+      thread_local thread_registration current_thread;
+
+      void set_os_name( const string& name ) {
+         // the kernel keeps at most 15 characters
+         auto os_name = name.substr( 0, 15 );
+#if defined(__APPLE__)
+         pthread_setname_np( os_name.c_str() );
+#elif defined(__linux__)
+         pthread_setname_np( pthread_self(), os_name.c_str() );
+#endif
+      }
+
+      void set_os_affinity( const string& name, const vector<uint32_t>& cpus ) {
+#ifdef __linux__
+         cpu_set_t set;
+         CPU_ZERO( &set );
+         for( auto cpu : cpus )
+            CPU_SET( cpu, &set );
+         if( int err = pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) )
+            wlog( "unable to pin thread ${n} to its CPUs: ${e}", ("n", name)("e", strerror( err )) );
+#else
+         wlog( "thread affinity is not supported on this platform, thread ${n} is not pinned", ("n", name) );
+#endif
+      }
+   }
+
+   thread_registry& thread_registry::instance() {
+      static thread_registry registry;
+      return registry;
+   }
+
+   void thread_registry::set_affinities( std::map<string, vector<uint32_t>> cpus ) {
+      std::lock_guard<std::mutex> g( mtx );
+      affinities = std::move( cpus );
+   }
+
+   void thread_registry::register_current_thread( const string& name ) {
+      set_os_name( name );
+
+      vector<uint32_t> cpus;
+      {
+         std::lock_guard<std::mutex> g( mtx );
+         // "mysql-db-actions-2", then "mysql-db-actions", "mysql-db" and "mysql"
+         for( auto prefix = name; !prefix.empty(); ) {
+            auto itr = affinities.find( prefix );
+            if( itr != affinities.end() ) {
+               cpus = itr->second;
+               break;
+            }
+            auto dash = prefix.rfind( '-' );
+            prefix = dash == string::npos ? string() : prefix.substr( 0, dash );
+         }
+
+         auto& t = current_thread.thread;
+         if( t ) {
+            // registered again, under another name
+            update( *t );
+            threads.erase( std::find( threads.begin(), threads.end(), t.get() ) );
+         }
+         t.reset( new tracked_thread() );
+         t->name = name;
+         t->cpu_time = &metrics_registry::instance().counter( "eosio_thread_cpu_microseconds_total",
+                                                              "CPU time used by a thread of the node",
+                                                              { { "thread", name } } );
+#ifdef __linux__
+         if( pthread_getcpuclockid( pthread_self(), &t->clock ) )
+            t->cpu_time = nullptr;
+#else
+         t->cpu_time = nullptr;
+#endif
+         threads.push_back( t.get() );
+      }
+
+      if( !cpus.empty() )
+         set_os_affinity( name, cpus );
+   }
+
+   void thread_registry::update_metrics() {
+      std::lock_guard<std::mutex> g( mtx );
+      for( auto* t : threads )
+         update( *t );
+   }
+
+   void thread_registry::update( tracked_thread& t ) {
+#ifdef __linux__
+      // the clock of a thread is only valid while it runs; it unregisters under the lock before it exits
+      if( !t.cpu_time )
+         return;
+      struct timespec ts;
+      if( clock_gettime( t.clock, &ts ) )
+         return;
+      uint64_t us = uint64_t(ts.tv_sec) * 1000000 + uint64_t(ts.tv_nsec) / 1000;
+      if( us > t.reported_us ) {
+         t.cpu_time->add( us - t.reported_us );
+         t.reported_us = us;
+      }
+#endif
+   }
+
+   void thread_registry::unregister( tracked_thread* t ) {
+      std::lock_guard<std::mutex> g( mtx );
+      update( *t );
+      auto itr = std::find( threads.begin(), threads.end(), t );
+      if( itr != threads.end() )
+         threads.erase( itr );
+   }
+
+   vector<uint32_t> thread_registry::parse_cpu_list( const string& list ) {
+      vector<string> ranges;
+      boost::split( ranges, list, boost::is_any_of( "," ) );
+      vector<uint32_t> result;
+      for( auto r : ranges ) {
+         boost::trim( r );
+         EOS_ASSERT( !r.empty(), misc_exception, "empty entry in CPU list ${l}", ("l", list) );
+         vector<string> bounds;
+         boost::split( bounds, r, boost::is_any_of( "-" ) );
+         EOS_ASSERT( bounds.size() <= 2, misc_exception, "invalid CPU range ${r}", ("r", r) );
+         uint32_t first = 0, last = 0;
+         try {
+            first = boost::lexical_cast<uint32_t>( bounds.front() );
+            last = boost::lexical_cast<uint32_t>( bounds.back() );
+         } catch( const boost::bad_lexical_cast& ) {
+            EOS_THROW( misc_exception, "invalid CPU range ${r}", ("r", r) );
+         }
+         EOS_ASSERT( first <= last, misc_exception, "invalid CPU range ${r}", ("r", r) );
+#ifdef __linux__
+         EOS_ASSERT( last < CPU_SETSIZE, misc_exception, "CPU ${c} is beyond the supported ${n}", ("c", last)("n", CPU_SETSIZE) );
+#endif
+         for( auto cpu = first; cpu <= last; ++cpu )
+            result.push_back( cpu );
+      }
+      std::sort( result.begin(), result.end() );
+      result.erase( std::unique( result.begin(), result.end() ), result.end() );
+      return result;
+   }
+
+} } /// eosio::chain
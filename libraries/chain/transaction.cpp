@@ -7,47 +7,20 @@
 #include <fc/smart_ref_impl.hpp>
 #include <algorithm>
 
-#include <boost/range/adaptor/transformed.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/member.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 
+#include <zlib.h>
+
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 #include <eosio/chain/transaction.hpp>
 
 namespace eosio { namespace chain {
 
-using namespace boost::multi_index;
-
-struct cached_pub_key {
-   transaction_id_type trx_id;
-   public_key_type pub_key;
-   signature_type sig;
-   cached_pub_key(const cached_pub_key&) = delete;
-   cached_pub_key() = delete;
-   cached_pub_key& operator=(const cached_pub_key&) = delete;
-   cached_pub_key(cached_pub_key&&) = default;
-};
-struct by_sig{};
-
-typedef multi_index_container<
-   cached_pub_key,
-   indexed_by<
-      sequenced<>,
-      hashed_unique<
-         tag<by_sig>,
-         member<cached_pub_key,
-                signature_type,
-                &cached_pub_key::sig>
-      >
-   >
-> recovery_cache_type;
-
 void transaction_header::set_reference_block( const block_id_type& reference_block ) {
    ref_block_num    = fc::endian_reverse_u32(reference_block._hash[0]);
    ref_block_prefix = reference_block._hash[1];
@@ -81,27 +54,20 @@ digest_type transaction::sig_digest( const chain_id_type& chain_id, const vector
    return enc.result();
 }
 
-flat_set<public_key_type> transaction::get_signature_keys( const vector<signature_type>& signatures,
-      const chain_id_type& chain_id, const vector<bytes>& cfd, bool allow_duplicate_keys, bool use_cache )const
-{ try {
-   using boost::adaptors::transformed;
-
-   constexpr size_t recovery_cache_size = 1000;
-   static recovery_cache_type recovery_cache;
-   const digest_type digest = sig_digest(chain_id, cfd);
+/// recovers the keys that signed digest, through the process wide signature_recovery_cache when use_cache is set
+static flat_set<public_key_type> recover_signature_keys( const vector<signature_type>& signatures, const digest_type& digest,
+                                                         bool allow_duplicate_keys, bool use_cache )
+{
+   static auto& recovery_time = metrics_registry::instance().histogram( "eosio_chain_signature_recovery_seconds",
+                                                                         "time to recover the key of a signature not in the recovery cache" );
 
    flat_set<public_key_type> recovered_pub_keys;
    for(const signature_type& sig : signatures) {
       public_key_type recov;
       if( use_cache ) {
-         recovery_cache_type::index<by_sig>::type::iterator it = recovery_cache.get<by_sig>().find( sig );
-         if( it == recovery_cache.get<by_sig>().end() || it->trx_id != id()) {
-            recov = public_key_type( sig, digest );
-            recovery_cache.emplace_back(cached_pub_key{id(), recov, sig} ); //could fail on dup signatures; not a problem
-         } else {
-            recov = it->pub_key;
-         }
+         recov = signature_recovery_cache::instance().recover( sig, digest );
       } else {
+         scoped_metric_timer timer( recovery_time );
          recov = public_key_type( sig, digest );
       }
       bool successful_insertion = false;
@@ -112,12 +78,13 @@ flat_set<public_key_type> transaction::get_signature_keys( const vector<signatur
                );
    }
 
-   if( use_cache ) {
-      while ( recovery_cache.size() > recovery_cache_size )
-         recovery_cache.erase( recovery_cache.begin() );
-   }
-
    return recovered_pub_keys;
+}
+
+flat_set<public_key_type> transaction::get_signature_keys( const vector<signature_type>& signatures,
+      const chain_id_type& chain_id, const vector<bytes>& cfd, bool allow_duplicate_keys, bool use_cache )const
+{ try {
+   return recover_signature_keys( signatures, sig_digest(chain_id, cfd), allow_duplicate_keys, use_cache );
 } FC_CAPTURE_AND_RETHROW() }
 
 
@@ -164,22 +131,6 @@ digest_type packed_transaction::packed_digest()const {
 
 namespace bio = boost::iostreams;
 
-template<size_t Limit>
-struct read_limiter {
-   using char_type = char;
-   using category = bio::multichar_output_filter_tag;
-
-   template<typename Sink>
-   size_t write(Sink &sink, const char* s, size_t count)
-   {
-      EOS_ASSERT(_total + count <= Limit, tx_decompression_error, "Exceeded maximum decompressed transaction size");
-      _total += count;
-      return bio::write(sink, s, count);
-   }
-
-   size_t _total = 0;
-};
-
 static vector<bytes> unpack_context_free_data(const bytes& data) {
    if( data.size() == 0 )
       return vector<bytes>();
@@ -191,22 +142,49 @@ static transaction unpack_transaction(const bytes& data) {
    return fc::raw::unpack<transaction>(data);
 }
 
+/**
+ *  One inflate state per thread, reset for every transaction instead of building a filter chain for each. Inflates
+ *  into a buffer that grows as needed until limit, and rejects the data unless the zlib stream ends within them.
+ */
+class zlib_inflater {
+   public:
+      zlib_inflater() {
+         EOS_ASSERT( inflateInit( &_strm ) == Z_OK, tx_decompression_error, "unable to initialize zlib: ${m}", ("m", _strm.msg ? _strm.msg : "") );
+      }
+      ~zlib_inflater() { inflateEnd( &_strm ); }
+
+      bytes inflate( const bytes& data, size_t limit ) {
+         EOS_ASSERT( inflateReset( &_strm ) == Z_OK, tx_decompression_error, "unable to reset zlib" );
+         _strm.next_in  = reinterpret_cast<Bytef*>( const_cast<char*>( data.data() ) );
+         _strm.avail_in = data.size();
+
+         bytes out( std::min<size_t>( std::max<size_t>( 4 * data.size(), 1024 ), limit + 1 ) );
+         size_t have = 0;
+         for( ;; ) {
+            _strm.next_out  = reinterpret_cast<Bytef*>( out.data() + have );
+            _strm.avail_out = out.size() - have;
+            int r = ::inflate( &_strm, Z_NO_FLUSH );
+            have = out.size() - _strm.avail_out;
+            EOS_ASSERT( have <= limit, tx_decompression_error, "Exceeded maximum decompressed transaction size" );
+            if( r == Z_STREAM_END )
+               break;
+            EOS_ASSERT( r == Z_OK || r == Z_BUF_ERROR, tx_decompression_error, "invalid compressed data: ${m}", ("m", _strm.msg ? _strm.msg : "") );
+            if( _strm.avail_out == 0 )
+               out.resize( std::min<size_t>( 2 * out.size(), limit + 1 ) );
+            else
+               EOS_ASSERT( _strm.avail_in != 0, tx_decompression_error, "compressed data is truncated" );
+         }
+         out.resize( have );
+         return out;
+      }
+
+   private:
+      z_stream _strm{};
+};
+
 static bytes zlib_decompress(const bytes& data) {
-   try {
-      bytes out;
-      bio::filtering_ostream decomp;
-      decomp.push(bio::zlib_decompressor());
-      decomp.push(read_limiter<1*1024*1024>()); // limit to 10 megs decompressed for zip bomb protections
-      decomp.push(bio::back_inserter(out));
-      bio::write(decomp, data.data(), data.size());
-      bio::close(decomp);
-      return out;
-   } catch( fc::exception& er ) {
-      throw;
-   } catch( ... ) {
-      fc::unhandled_exception er( FC_LOG_MESSAGE( warn, "internal decompression error"), std::current_exception() );
-      throw er;
-   }
+   static thread_local zlib_inflater inflater;
+   return inflater.inflate( data, 1*1024*1024 ); // zip bomb protection
 }
 
 static vector<bytes> zlib_decompress_context_free_data(const bytes& data) {
@@ -233,11 +211,7 @@ static bytes pack_context_free_data(const vector<bytes>& cfd ) {
    return fc::raw::pack(cfd);
 }
 
-static bytes zlib_compress_context_free_data(const vector<bytes>& cfd ) {
-   if( cfd.size() == 0 )
-      return bytes();
-
-   bytes in = pack_context_free_data(cfd);
+static bytes zlib_compress(const bytes& in) {
    bytes out;
    bio::filtering_ostream comp;
    comp.push(bio::zlib_compressor(bio::zlib::best_compression));
@@ -247,15 +221,11 @@ static bytes zlib_compress_context_free_data(const vector<bytes>& cfd ) {
    return out;
 }
 
-static bytes zlib_compress_transaction(const transaction& t) {
-   bytes in = pack_transaction(t);
-   bytes out;
-   bio::filtering_ostream comp;
-   comp.push(bio::zlib_compressor(bio::zlib::best_compression));
-   comp.push(bio::back_inserter(out));
-   bio::write(comp, in.data(), in.size());
-   bio::close(comp);
-   return out;
+static bytes zlib_compress_context_free_data(const vector<bytes>& cfd ) {
+   if( cfd.size() == 0 )
+      return bytes();
+
+   return zlib_compress(pack_context_free_data(cfd));
 }
 
 bytes packed_transaction::get_raw_transaction() const
@@ -294,10 +264,25 @@ time_point_sec packed_transaction::expiration()const
 
 transaction_id_type packed_transaction::id()const
 {
-   local_unpack();
-   return get_transaction().id();
+   if( !trx_id )
+      local_unpack();
+   return *trx_id;
+}
+
+digest_type packed_transaction::sig_digest( const chain_id_type& chain_id )const
+{
+   if( !signing_digest || signing_digest->first != chain_id ) {
+      local_unpack();
+      signing_digest = std::make_pair( chain_id, unpacked_trx->sig_digest( chain_id, get_context_free_data() ) );
+   }
+   return signing_digest->second;
 }
 
+flat_set<public_key_type> packed_transaction::get_signature_keys( const chain_id_type& chain_id, bool allow_duplicate_keys, bool use_cache )const
+{ try {
+   return recover_signature_keys( signatures, sig_digest( chain_id ), allow_duplicate_keys, use_cache );
+} FC_CAPTURE_AND_RETHROW() }
+
 transaction_id_type packed_transaction::get_uncached_id()const
 {
    const auto raw = get_raw_transaction();
@@ -319,6 +304,10 @@ void packed_transaction::local_unpack()const
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
          }
       } FC_CAPTURE_AND_RETHROW((compression)(packed_trx))
+      // not a hash of the received bytes: the id is the hash of the transaction as it packs, and bytes that do not
+      // pack back the same (overlong varints) still decode
+      if( !trx_id )
+         trx_id = unpacked_trx->id();
    }
 }
 
@@ -328,6 +317,14 @@ transaction packed_transaction::get_transaction()const
    return transaction(*unpacked_trx);
 }
 
+void packed_transaction::set_id( const bytes& raw )
+{
+   // the bytes were just packed from the transaction, so they hash to its id
+   unpacked_trx.reset();
+   trx_id = digest_type::hash( raw.data(), raw.size() );
+   signing_digest.reset();
+}
+
 signed_transaction packed_transaction::get_signed_transaction() const
 {
    try {
@@ -346,12 +343,14 @@ signed_transaction packed_transaction::get_signed_transaction() const
 void packed_transaction::set_transaction(const transaction& t, packed_transaction::compression_type _compression)
 {
    try {
+      bytes raw = pack_transaction(t);
+      set_id(raw);
       switch(_compression) {
          case none:
-            packed_trx = pack_transaction(t);
+            packed_trx = std::move(raw);
             break;
          case zlib:
-            packed_trx = zlib_compress_transaction(t);
+            packed_trx = zlib_compress(raw);
             break;
          default:
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
@@ -364,13 +363,15 @@ void packed_transaction::set_transaction(const transaction& t, packed_transactio
 void packed_transaction::set_transaction(const transaction& t, const vector<bytes>& cfd, packed_transaction::compression_type _compression)
 {
    try {
+      bytes raw = pack_transaction(t);
+      set_id(raw);
       switch(_compression) {
          case none:
-            packed_trx = pack_transaction(t);
+            packed_trx = std::move(raw);
             packed_context_free_data = pack_context_free_data(cfd);
             break;
          case zlib:
-            packed_trx = zlib_compress_transaction(t);
+            packed_trx = zlib_compress(raw);
             packed_context_free_data = zlib_compress_context_free_data(cfd);
             break;
          default:
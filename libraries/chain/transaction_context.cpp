@@ -1,5 +1,7 @@
 #include <eosio/chain/apply_context.hpp>
 #include <eosio/chain/transaction_context.hpp>
+#include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/chain/hot_state_cache.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/resource_limits.hpp>
@@ -153,7 +155,7 @@ namespace bacc = boost::accumulators;
    ,trx(t)
    ,id(trx_id)
    ,undo_session()
-   ,trace(std::make_shared<transaction_trace>())
+   ,trace(make_transaction_trace())
    ,start(s)
    ,net_usage(trace->net_usage)
    ,pseudo_start(s)
@@ -166,9 +168,15 @@ namespace bacc = boost::accumulators;
       trace->block_time = c.pending_block_time();
       trace->producer_block_id = c.pending_producer_block_id();
       executed.reserve( trx.total_actions() );
+      if( c.profiles_transaction_phases() )
+         phases.emplace();
       EOS_ASSERT( trx.transaction_extensions.size() == 0, unsupported_feature, "we don't support any extensions yet" );
    }
 
+   const vector<bytes>& transaction_context::context_free_data()const {
+      return trx_meta ? trx_meta->context_free_data() : trx.context_free_data;
+   }
+
    void transaction_context::init(uint64_t initial_net_usage)
    {
       EOS_ASSERT( !is_initialized, transaction_exception, "cannot initialize twice" );
@@ -331,6 +339,9 @@ namespace bacc = boost::accumulators;
 
    void transaction_context::exec() {
       EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
+      if( phases ) phases->enter( transaction_phase::dispatch );
+
+      trace->action_traces.reserve( (apply_context_free ? trx.context_free_actions.size() : 0) + trx.actions.size() );
 
       if( apply_context_free ) {
          for( const auto& act : trx.context_free_actions ) {
@@ -351,6 +362,7 @@ namespace bacc = boost::accumulators;
 
    void transaction_context::finalize() {
       EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
+      if( phases ) phases->enter( transaction_phase::finalize );
 
       if( is_input ) {
          auto& am = control.get_mutable_authorization_manager();
@@ -404,12 +416,24 @@ namespace bacc = boost::accumulators;
                                 block_timestamp_type(control.pending_block_time()).slot ); // Should never fail
    }
 
+   transaction_context::~transaction_context() {
+      // the session is still open if the transaction failed, and undoes it as it is destroyed
+      if (undo_session) control.get_mutable_hot_state_cache().clear();
+   }
+
    void transaction_context::squash() {
-      if (undo_session) undo_session->squash();
+      if (undo_session) {
+         undo_session->squash();
+         undo_session.reset();
+      }
    }
 
    void transaction_context::undo() {
-      if (undo_session) undo_session->undo();
+      if (undo_session) {
+         undo_session->undo();
+         undo_session.reset();
+         control.get_mutable_hot_state_cache().clear();
+      }
    }
 
    void transaction_context::check_net_usage()const {
@@ -432,9 +456,7 @@ namespace bacc = boost::accumulators;
       }
    }
 
-   void transaction_context::checktime()const {
-      if(BOOST_LIKELY(_deadline_timer.expired == false))
-         return;
+   void transaction_context::check_deadline()const {
       auto now = fc::time_point::now();
       if( BOOST_UNLIKELY( now > _deadline ) ) {
          // edump((now-start)(now-pseudo_start));
@@ -576,6 +598,8 @@ namespace bacc = boost::accumulators;
    }
 
    void transaction_context::schedule_transaction() {
+      transaction_phase_timer::scope phase( phase_timer(), transaction_phase::deferred );
+
       // Charge ahead of time for the additional net usage needed to retire the delayed transaction
       // whether that be by successfully executing, soft failure, hard failure, or expiration.
       if( trx.delay_sec.value == 0 ) { // Do not double bill. Only charge if we have not already charged for the delay.
@@ -586,7 +610,7 @@ namespace bacc = boost::accumulators;
 
       auto first_auth = trx.first_authorizor();
 
-      uint32_t trx_size = 0;
+      const auto& payload = generated_transaction_object::create_payload( control.mutable_db(), trx );
       const auto& cgto = control.mutable_db().create<generated_transaction_object>( [&]( auto& gto ) {
         gto.trx_id      = id;
         gto.payer       = first_auth;
@@ -595,10 +619,15 @@ namespace bacc = boost::accumulators;
         gto.published   = control.pending_block_time();
         gto.delay_until = gto.published + delay;
         gto.expiration  = gto.delay_until + fc::seconds(control.get_global_properties().configuration.deferred_trx_expiration_window);
-        trx_size = gto.set( trx );
+        gto.set_payload( payload );
       });
 
-      add_ram_usage( cgto.payer, (config::billable_size_v<generated_transaction_object> + trx_size) );
+      add_ram_usage( cgto.payer, (config::billable_size_v<generated_transaction_object> + cgto.packed_trx_size) );
+   }
+
+   void transaction_context::record_phase_times() {
+      if( phases )
+         trace->phase_times = phases->times();
    }
 
    void transaction_context::record_transaction( const transaction_id_type& id, fc::time_point_sec expire ) {
@@ -613,6 +642,7 @@ namespace bacc = boost::accumulators;
           EOS_ASSERT( false, tx_duplicate,
                      "duplicate transaction ${id}", ("id", id ) );
       }
+      control.add_known_transaction( id, expire );
    } /// record_transaction
 
 
@@ -0,0 +1,61 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/transaction_phase_timer.hpp>
+#include <eosio/chain/execution_profiler.hpp>
+
+#include <cstring>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      /// counter ticks per nanosecond, measured once against the steady clock
+      double ticks_per_ns() {
+#if defined(__x86_64__) || defined(__i386__)
+         static const double rate = []() {
+            auto clock_start = std::chrono::steady_clock::now();
+            auto tsc_start = __rdtsc();
+            // a couple of milliseconds, paid by the first transaction profiled, put the error well below 1%
+            while( std::chrono::steady_clock::now() - clock_start < std::chrono::milliseconds(2) ) {}
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - clock_start ).count();
+            return double( __rdtsc() - tsc_start ) / ns;
+         }();
+         return rate;
+#else
+         return 1;
+#endif
+      }
+   }
+
+   transaction_phase_times transaction_phase_timer::times() {
+      enter( current );
+      auto ns = [rate = ticks_per_ns()]( uint64_t ticks ) { return static_cast<uint64_t>( ticks / rate ); };
+      auto phase_ns = [&]( transaction_phase p ) { return ns( elapsed[static_cast<size_t>(p)] ); };
+
+      transaction_phase_times t;
+      t.init_ns          = phase_ns( transaction_phase::init );
+      t.authorization_ns = phase_ns( transaction_phase::authorization );
+      t.dispatch_ns      = phase_ns( transaction_phase::dispatch );
+      t.native_ns        = phase_ns( transaction_phase::native );
+      t.wasm_ns          = phase_ns( transaction_phase::wasm );
+      t.db_ns            = phase_ns( transaction_phase::db );
+      t.deferred_ns      = phase_ns( transaction_phase::deferred );
+      t.finalize_ns      = phase_ns( transaction_phase::finalize );
+      t.total_ns         = ns( last - started );
+      return t;
+   }
+
+   bool transaction_phase_timer::is_db_intrinsic( uint32_t intrinsic_id ) {
+      // every host function is registered during static initialization, before any transaction runs
+      static const vector<bool> db = []() {
+         const auto& names = intrinsic_profile_registry::names();
+         vector<bool> result( names.size(), false );
+         for( size_t i = 1; i < names.size(); ++i )
+            result[i] = strncmp( names[i], "db_", 3 ) == 0;
+         return result;
+      }();
+      return intrinsic_id < db.size() && db[intrinsic_id];
+   }
+
+} } /// eosio::chain
@@ -10,10 +10,12 @@
 #include <eosio/chain/wasm_interface_private.hpp>
 #include <eosio/chain/wasm_eosio_validation.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/softfloat_fast_path.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/core_symbol_object.hpp>
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/symbol.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha1.hpp>
@@ -29,7 +31,7 @@ namespace eosio { namespace chain {
    using namespace webassembly;
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm) : my( new wasm_interface_impl(vm) ) {}
+   wasm_interface::wasm_interface(vm_type vm, const wasm_cache_config& cache) : my( new wasm_interface_impl(vm, cache) ) {}
 
    wasm_interface::~wasm_interface() {}
 
@@ -56,11 +58,39 @@ namespace eosio { namespace chain {
 	 }
 
    void wasm_interface::apply( const digest_type& code_id, const shared_string& code, apply_context& context ) {
-      my->get_instantiated_module(code_id, code, context.trx_context)->apply(context);
+      my->get_instantiated_module(code_id, code, context.receiver, context.trx_context)->apply(context);
    }
 
    void wasm_interface::exit() {
-      my->runtime_interface->immediately_exit_currently_running_module();
+      my->running_runtime->immediately_exit_currently_running_module();
+   }
+
+   void wasm_interface::precompile(const digest_type& code_id, const char* code, size_t code_size) {
+      my->precompile(code_id, code, code_size);
+   }
+
+   void wasm_interface::collect_compiles() {
+      if(!my->pending_compiles.empty() || !my->pending_tier_ups.empty())
+         my->collect_compiles();
+   }
+
+   vector<pair<account_name, digest_type>> wasm_interface::cached_code() const {
+      vector<pair<account_name, digest_type>> result;
+      result.reserve(my->instantiation_cache.size());
+      for(const auto* modules : {&my->pinned_modules, &my->lru_modules}) {
+         for(const auto& m : *modules) {
+            if(m.receiver != account_name())
+               result.emplace_back(m.receiver, m.code_id);
+         }
+      }
+      return result;
+   }
+
+   wasm_cache_stats wasm_interface::cache_stats() const {
+      wasm_cache_stats result = my->stats;
+      result.entries = my->instantiation_cache.size();
+      result.pinned_entries = my->pinned_modules.size();
+      return result;
    }
 
    wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
@@ -213,21 +243,21 @@ class softfloat_api : public context_aware_api {
       softfloat_api( apply_context& ctx )
       :context_aware_api(ctx, true) {}
 
-      // float binops
+      // float binops, see softfloat_fast_path.hpp for when they are computed natively
       float _eosio_f32_add( float a, float b ) {
-         float32_t ret = f32_add( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = softfloat_fast_path::add( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_sub( float a, float b ) {
-         float32_t ret = f32_sub( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = softfloat_fast_path::sub( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_div( float a, float b ) {
-         float32_t ret = f32_div( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = softfloat_fast_path::div( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_mul( float a, float b ) {
-         float32_t ret = f32_mul( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = softfloat_fast_path::mul( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_min( float af, float bf ) {
@@ -281,7 +311,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
-         float32_t ret = f32_sqrt( to_softfloat32(a) );
+         float32_t ret = softfloat_fast_path::sqrt( to_softfloat32(a) );
          return from_softfloat32(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -384,19 +414,19 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
-         float64_t ret = f64_add( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = softfloat_fast_path::add( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_sub( double a, double b ) {
-         float64_t ret = f64_sub( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = softfloat_fast_path::sub( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_div( double a, double b ) {
-         float64_t ret = f64_div( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = softfloat_fast_path::div( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_mul( double a, double b ) {
-         float64_t ret = f64_mul( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = softfloat_fast_path::mul( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_min( double af, double bf ) {
@@ -445,7 +475,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
-         float64_t ret = f64_sqrt( to_softfloat64(a) );
+         float64_t ret = softfloat_fast_path::sqrt( to_softfloat64(a) );
          return from_softfloat64(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -555,10 +585,10 @@ class softfloat_api : public context_aware_api {
 
       // float and double conversions
       double _eosio_f32_promote( float a ) {
-         return from_softfloat64(f32_to_f64( to_softfloat32(a)) );
+         return from_softfloat64(softfloat_fast_path::promote( to_softfloat32(a)) );
       }
       float _eosio_f64_demote( double a ) {
-         return from_softfloat32(f64_to_f32( to_softfloat64(a)) );
+         return from_softfloat32(softfloat_fast_path::demote( to_softfloat64(a)) );
       }
       int32_t _eosio_f32_trunc_i32s( float af ) {
          float32_t a = to_softfloat32(af);
@@ -781,6 +811,39 @@ class crypto_api : public context_aware_api {
       void ripemd160(array_ptr<char> data, size_t datalen, fc::ripemd160& hash_val) {
          hash_val = encode<fc::ripemd160::encoder>( data, datalen );
       }
+
+      /**
+       * Same as `merkle()`, calling checktime once per tree level.
+       */
+      void merkle_root( array_ptr<const fc::sha256> digests, size_t count, fc::sha256& root ) {
+         vector<digest_type> ids( digests.value, digests.value + count );
+         while( ids.size() > 1 ) {
+            if( ids.size() % 2 )
+               ids.push_back( ids.back() );
+
+            for( size_t i = 0; i < ids.size() / 2; ++i ) {
+               ids[i] = digest_type::hash( make_canonical_pair( ids[2 * i], ids[(2 * i) + 1] ) );
+            }
+
+            ids.resize( ids.size() / 2 );
+            context.trx_context.checktime();
+         }
+         root = ids.empty() ? digest_type() : ids.front();
+      }
+
+      /**
+       * Each node of the branch is a canonical sibling, whose first bit tells the side it is on,
+       * see `make_canonical_left` and `make_canonical_right`.
+       */
+      void assert_merkle_branch( const fc::sha256& leaf, array_ptr<const fc::sha256> branch, size_t branch_len, const fc::sha256& root ) {
+         auto node = leaf;
+         for( size_t i = 0; i < branch_len; ++i ) {
+            const auto& sibling = branch.value[i];
+            node = is_canonical_right( sibling ) ? digest_type::hash( make_canonical_pair( node, sibling ) )
+                                                 : digest_type::hash( make_canonical_pair( sibling, node ) );
+         }
+         EOS_ASSERT( node == root, crypto_api_exception, "merkle branch mismatch" );
+      }
 };
 
 class permission_api : public context_aware_api {
@@ -1276,6 +1339,9 @@ class database_api : public context_aware_api {
       int db_next_i64( int itr, uint64_t& primary ) {
          return context.db_next_i64(itr, primary);
       }
+      int db_next_many_i64( int itr, array_ptr<char> buffer, size_t buffer_size, uint32_t max_rows, int& next ) {
+         return context.db_next_many_i64( itr, buffer, buffer_size, max_rows, next );
+      }
       int db_previous_i64( int itr, uint64_t& primary ) {
          return context.db_previous_i64(itr, primary);
       }
@@ -1409,10 +1475,9 @@ class compiler_builtins : public context_aware_api {
       compiler_builtins( apply_context& ctx )
       :context_aware_api(ctx,true){}
 
+      // shifts of 128 bits or more give 0, as the fc::uint128_t they were first written with did
       void __ashlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         ret = shift < 128 ? __int128( to_uint128( low, high ) << shift ) : 0;
       }
 
       void __ashrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
@@ -1424,94 +1489,57 @@ class compiler_builtins : public context_aware_api {
       }
 
       void __lshlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         ret = shift < 128 ? __int128( to_uint128( low, high ) << shift ) : 0;
       }
 
       void __lshrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i >>= shift;
-         ret = (unsigned __int128)i;
+         ret = shift < 128 ? __int128( to_uint128( low, high ) >> shift ) : 0;
       }
 
+      // divisions of values that fit in 64 bits use the 64 bit instruction instead of the 128 bit division routine
       void __divti3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
+         EOS_ASSERT((lb | hb) != 0, arithmetic_exception, "divide by zero");
 
-         rhs <<= 64;
-         rhs |=  lb;
-
-         EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
-
-         lhs /= rhs;
-
-         ret = lhs;
+         if( fits_int64( la, ha ) && fits_int64( lb, hb ) && int64_t(lb) != -1 ) {
+            ret = int64_t(la) / int64_t(lb);
+            return;
+         }
+         ret = to_int128( la, ha ) / to_int128( lb, hb );
       }
 
       void __udivti3(unsigned __int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         unsigned __int128 lhs = ha;
-         unsigned __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
+         EOS_ASSERT((lb | hb) != 0, arithmetic_exception, "divide by zero");
 
-         EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
-
-         lhs /= rhs;
-         ret = lhs;
+         if( (ha | hb) == 0 ) {
+            ret = la / lb;
+            return;
+         }
+         ret = to_uint128( la, ha ) / to_uint128( lb, hb );
       }
 
       void __multi3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
-
-         lhs *= rhs;
-         ret = lhs;
+         // the low 128 bits of the product are the same signed or not, and unsigned overflow is defined
+         ret = __int128( to_uint128( la, ha ) * to_uint128( lb, hb ) );
       }
 
       void __modti3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
+         EOS_ASSERT((lb | hb) != 0, arithmetic_exception, "divide by zero");
 
-         rhs <<= 64;
-         rhs |=  lb;
-
-         EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
-
-         lhs %= rhs;
-         ret = lhs;
+         if( fits_int64( la, ha ) && fits_int64( lb, hb ) && int64_t(lb) != -1 ) {
+            ret = int64_t(la) % int64_t(lb);
+            return;
+         }
+         ret = to_int128( la, ha ) % to_int128( lb, hb );
       }
 
       void __umodti3(unsigned __int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         unsigned __int128 lhs = ha;
-         unsigned __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
-
-         EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
+         EOS_ASSERT((lb | hb) != 0, arithmetic_exception, "divide by zero");
 
-         lhs %= rhs;
-         ret = lhs;
+         if( (ha | hb) == 0 ) {
+            ret = la % lb;
+            return;
+         }
+         ret = to_uint128( la, ha ) % to_uint128( lb, hb );
       }
 
       // arithmetic long double
@@ -1655,6 +1683,18 @@ class compiler_builtins : public context_aware_api {
       }
 
       static constexpr uint32_t SHIFT_WIDTH = (sizeof(uint64_t)*8)-1;
+
+   private:
+      static unsigned __int128 to_uint128( uint64_t low, uint64_t high ) {
+         return (unsigned __int128)high << 64 | low;
+      }
+      static __int128 to_int128( uint64_t low, uint64_t high ) {
+         return __int128( to_uint128( low, high ) );
+      }
+      /// true when the high half is only the sign extension of the low half
+      static bool fits_int64( uint64_t low, uint64_t high ) {
+         return high == uint64_t( int64_t(low) >> 63 );
+      }
 };
 
 
@@ -1787,6 +1827,7 @@ REGISTER_INTRINSICS( database_api,
    (db_remove_i64,       void(int))
    (db_get_i64,          int(int, int, int))
    (db_next_i64,         int(int, int))
+   (db_next_many_i64,    int(int, int, int, int, int))
    (db_previous_i64,     int(int, int))
    (db_find_i64,         int(int64_t,int64_t,int64_t,int64_t))
    (db_lowerbound_i64,   int(int64_t,int64_t,int64_t,int64_t))
@@ -1811,6 +1852,8 @@ REGISTER_INTRINSICS(crypto_api,
    (sha256,                 void(int, int, int)           )
    (sha512,                 void(int, int, int)           )
    (ripemd160,              void(int, int, int)           )
+   (merkle_root,            void(int, int, int)           )
+   (assert_merkle_branch,   void(int, int, int, int)      )
 );
 
 
@@ -1964,6 +2007,8 @@ std::istream& operator>>(std::istream& in, wasm_interface::vm_type& runtime) {
       runtime = eosio::chain::wasm_interface::vm_type::wavm;
    else if (s == "wabt")
       runtime = eosio::chain::wasm_interface::vm_type::wabt;
+   else if (s == "tiered")
+      runtime = eosio::chain::wasm_interface::vm_type::tiered;
    else
       in.setstate(std::ios_base::failbit);
    return in;
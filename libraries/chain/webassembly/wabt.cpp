@@ -23,6 +23,10 @@ class wabt_instantiated_module : public wasm_instantiated_module_interface {
          _executor(_env.get(), nullptr, Thread::Options(64*1024,
                                                         wasm_constraints::maximum_call_depth+2))
       {
+         //looked up once rather than by name on every action
+         _apply = _instatiated_module->GetExport("apply");
+         EOS_ASSERT( _apply && _apply->kind == ExternalKind::Func, wasm_execution_error, "wabt module does not export an apply function" );
+
          for(Index i = 0; i < _env->GetGlobalCount(); ++i) {
             if(_env->GetGlobal(i)->mutable_ == false)
                continue;
@@ -46,24 +50,29 @@ class wabt_instantiated_module : public wasm_instantiated_module_interface {
             Memory* memory = this_run_vars.memory = _env->GetMemory(0);
             memory->page_limits = _initial_memory_configuration;
             memory->data.resize(_initial_memory_configuration.initial * WABT_PAGE_SIZE);
-            memset(memory->data.data(), 0, memory->data.size());
+            //the initial image is written over its own range, so only what lies beyond it needs zeroing
             memcpy(memory->data.data(), _initial_memory.data(), _initial_memory.size());
+            memset(memory->data.data() + _initial_memory.size(), 0, memory->data.size() - _initial_memory.size());
          }
 
          _params[0].set_i64(uint64_t(context.receiver));
          _params[1].set_i64(uint64_t(context.act.account));
          _params[2].set_i64(uint64_t(context.act.name));
 
-         ExecResult res = _executor.RunStartFunction(_instatiated_module);
-         EOS_ASSERT( res.result == interp::Result::Ok, wasm_execution_error, "wabt start function failure (${s})", ("s", ResultToString(res.result)) );
+         ExecResult res;
+         if(_instatiated_module->start_func_index != kInvalidIndex) {
+            res = _executor.RunStartFunction(_instatiated_module);
+            EOS_ASSERT( res.result == interp::Result::Ok, wasm_execution_error, "wabt start function failure (${s})", ("s", ResultToString(res.result)) );
+         }
 
-         res = _executor.RunExportByName(_instatiated_module, "apply", _params);
+         res = _executor.RunExport(_apply, _params);
          EOS_ASSERT( res.result == interp::Result::Ok, wasm_execution_error, "wabt execution failure (${s})", ("s", ResultToString(res.result)) );
       }
 
    private:
       std::unique_ptr<interp::Environment>              _env;
       DefinedModule*                                    _instatiated_module;  //this is owned by the Environment
+      Export*                                           _apply = nullptr;     //owned by _instatiated_module
       std::vector<uint8_t>                              _initial_memory;
       TypedValues                                       _params{3, TypedValue(Type::I64)};
       std::vector<std::pair<Global*, TypedValue>>       _initial_globals;
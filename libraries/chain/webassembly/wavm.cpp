@@ -13,6 +13,7 @@
 #include "Runtime/Intrinsics.h"
 
 #include <mutex>
+#include <set>
 
 using namespace IR;
 using namespace Runtime;
@@ -21,13 +22,31 @@ namespace eosio { namespace chain { namespace webassembly { namespace wavm {
 
 running_instance_context the_running_instance_context;
 
+//ModuleInstances are only released by WAVM's garbage collector, which frees everything not reachable from the
+// roots it is given. Track the instances still owned by a wavm_instantiated_module (across every wavm_runtime) so that
+// a collection after a module is evicted from the instantiation cache frees only the evicted ones.
+// The GC and instantiation share global state, guarded by instance_lock between the wasm_interfaces of the process.
+// Neither is safe while WAVM code runs, which the lock does not cover, so wasm_interface_impl only instantiates WAVM
+// modules on the application thread and leaves parsing and injection to its compile threads.
+static std::mutex                 instance_lock;
+static std::set<ModuleInstance*>  live_instances;
+static bool                       collection_pending = false;
+
 class wavm_instantiated_module : public wasm_instantiated_module_interface {
    public:
       wavm_instantiated_module(ModuleInstance* instance, std::unique_ptr<Module> module, std::vector<uint8_t> initial_mem) :
          _initial_memory(initial_mem),
          _instance(instance),
          _module(std::move(module))
-      {}
+      {
+         live_instances.insert(_instance);
+      }
+
+      ~wavm_instantiated_module() {
+         std::lock_guard<std::mutex> l(instance_lock);
+         live_instances.erase(_instance);
+         collection_pending = true;
+      }
 
       void apply(apply_context& context) override {
          vector<Value> args = {Value(uint64_t(context.receiver)),
@@ -76,7 +95,7 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
 
       std::vector<uint8_t>     _initial_memory;
       //naked pointer because ModuleInstance is opaque
-      //_instance is deleted via WAVM's object garbage collection when wavm_rutime is deleted
+      //_instance is deleted via WAVM's object garbage collection once this module is destroyed, see live_instances
       ModuleInstance*          _instance;
       std::unique_ptr<Module>  _module;
 };
@@ -95,7 +114,7 @@ wavm_runtime::runtime_guard::~runtime_guard() {
 static weak_ptr<wavm_runtime::runtime_guard> __runtime_guard_ptr;
 static std::mutex __runtime_guard_lock;
 
-wavm_runtime::wavm_runtime() {
+wavm_runtime::wavm_runtime(const wavm_options& options) : _options(options) {
    std::lock_guard<std::mutex> l(__runtime_guard_lock);
    if (__runtime_guard_ptr.use_count() == 0) {
       _runtime_guard = std::make_shared<runtime_guard>();
@@ -109,6 +128,12 @@ wavm_runtime::~wavm_runtime() {
 }
 
 std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_module(const char* code_bytes, size_t code_size, std::vector<uint8_t> initial_memory) {
+   std::lock_guard<std::mutex> l(instance_lock);
+   if(collection_pending) {
+      Runtime::freeUnreferencedObjects(std::vector<ObjectInstance*>(live_instances.begin(), live_instances.end()));
+      collection_pending = false;
+   }
+
    std::unique_ptr<Module> module = std::make_unique<Module>();
    try {
       Serialization::MemoryInputStream stream((const U8*)code_bytes, code_size);
@@ -121,12 +146,18 @@ std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_mo
 
    eosio::chain::webassembly::common::root_resolver resolver;
    LinkResult link_result = linkModule(*module, resolver);
-   ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports));
+   ModuleInstance *instance = instantiateModule(*module, std::move(link_result.resolvedImports), optimization_level(code_size));
    EOS_ASSERT(instance != nullptr, wasm_exception, "Fail to Instantiate WAVM Module");
 
    return std::make_unique<wavm_instantiated_module>(instance, std::move(module), initial_memory);
 }
 
+JITOptimizationLevel wavm_runtime::optimization_level(size_t code_size) const {
+   if(_options.fast_compile_size && code_size >= _options.fast_compile_size)
+      return JITOptimizationLevel::fastCompile;
+   return _options.level;
+}
+
 void wavm_runtime::immediately_exit_currently_running_module() {
 #ifdef _WIN32
    throw wasm_exit();
@@ -70,6 +70,30 @@ namespace eosio { namespace testing {
 
    bool expect_assert_message(const fc::exception& ex, string expected);
 
+   class base_tester;
+
+   /**
+    *  A chain set up once per test process and kept as an in-memory snapshot, along with what the tester that set it
+    *  up knows about its producers. Testers constructed from it restore the snapshot instead of repeating the setup.
+    *
+    *  Only the state is restored: the block log of a restored tester starts after the snapshot, so blocks and
+    *  transaction receipts of the setup are not available from it.
+    */
+   struct fixture_snapshot {
+      fc::variant                                               state;
+      map<account_name, block_id_type>                          last_produced_block;
+      std::map<chain::public_key_type, chain::private_key_type> block_signing_private_keys;
+   };
+
+   /**
+    *  The fixture snapshot registered under key. The first call for a key builds the chain with make and takes the
+    *  snapshot, after producing a block if transactions are pending; later calls return the same snapshot and do
+    *  not call make.
+    */
+   const fixture_snapshot& get_fixture_snapshot( const string& key, const std::function<std::unique_ptr<base_tester>()>& make );
+
+   snapshot_reader_ptr make_snapshot_reader( const fixture_snapshot& fixture );
+
    /**
     *  @class tester
     *  @brief provides utility function to simplify the creation of unit tests
@@ -87,6 +111,7 @@ namespace eosio { namespace testing {
 
          void              init(bool push_genesis = true, db_read_mode read_mode = db_read_mode::SPECULATIVE);
          void              init(controller::config config, const snapshot_reader_ptr& snapshot = nullptr);
+         void              init(const fixture_snapshot& fixture);
 
          void              close();
          void              open( const snapshot_reader_ptr& snapshot );
@@ -274,6 +299,7 @@ namespace eosio { namespace testing {
       protected:
          signed_block_ptr _produce_block( fc::microseconds skip_time, bool skip_pending_trxs = false, uint32_t skip_flag = 0 );
          void             _start_block(fc::time_point block_time);
+         void             set_default_config( db_read_mode read_mode );
 
       // Fields:
       protected:
@@ -298,6 +324,10 @@ namespace eosio { namespace testing {
          init(config);
       }
 
+      tester(const fixture_snapshot& fixture) {
+         init(fixture);
+      }
+
       signed_block_ptr produce_block( fc::microseconds skip_time = fc::milliseconds(config::block_interval_ms), uint32_t skip_flag = 0/*skip_missed_block_penalty*/ )override {
          return _produce_block(skip_time, false, skip_flag);
       }
@@ -374,6 +404,16 @@ namespace eosio { namespace testing {
          init(config);
       }
 
+      validating_tester(const fixture_snapshot& fixture) {
+         vcfg = default_config();
+
+         validating_node = std::make_unique<controller>(vcfg);
+         validating_node->add_indices();
+         validating_node->startup( make_snapshot_reader( fixture ) );
+
+         init(fixture);
+      }
+
       signed_block_ptr produce_block( fc::microseconds skip_time = fc::milliseconds(config::block_interval_ms), uint32_t skip_flag = 0 /*skip_missed_block_penalty*/ )override {
          auto sb = _produce_block(skip_time, false, skip_flag | 2);
          validating_node->push_block( sb );
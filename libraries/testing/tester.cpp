@@ -3,6 +3,7 @@
 #include <eosio/testing/tester.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/chain/eosio_contract.hpp>
+#include <eosio/chain/snapshot.hpp>
 
 #include <eosio.bios/eosio.bios.wast.hpp>
 #include <eosio.bios/eosio.bios.abi.hpp>
@@ -82,7 +83,52 @@ namespace eosio { namespace testing {
      return control->head_block_id() == other.control->head_block_id();
    }
 
+   const fixture_snapshot& get_fixture_snapshot( const string& key, const std::function<std::unique_ptr<base_tester>()>& make ) {
+      static std::map<string, fixture_snapshot> fixtures;
+      auto itr = fixtures.find( key );
+      if( itr != fixtures.end() )
+         return itr->second;
+
+      fixture_snapshot fixture;
+      {
+         auto t = make();
+         // a snapshot only covers the head block, so what is still pending goes into a block first
+         auto pending = t->control->pending_block_state();
+         if( pending && !pending->block->transactions.empty() )
+            t->produce_block();
+         t->control->abort_block();
+         fc::mutable_variant_object state;
+         auto writer = std::make_shared<variant_snapshot_writer>( state );
+         t->control->write_snapshot( writer );
+         writer->finalize();
+         fixture.state = fc::variant( state );
+         fixture.last_produced_block = t->get_last_produced_block_map();
+         fixture.block_signing_private_keys = t->block_signing_private_keys;
+      }
+      return fixtures.emplace( key, std::move(fixture) ).first->second;
+   }
+
+   snapshot_reader_ptr make_snapshot_reader( const fixture_snapshot& fixture ) {
+      return std::make_shared<variant_snapshot_reader>( fixture.state );
+   }
+
    void base_tester::init(bool push_genesis, db_read_mode read_mode) {
+      set_default_config(read_mode);
+
+      open(nullptr);
+
+      if (push_genesis)
+         push_genesis_block();
+   }
+
+   void base_tester::init(const fixture_snapshot& fixture) {
+      set_default_config(db_read_mode::SPECULATIVE);
+      open(make_snapshot_reader(fixture));
+      last_produced_block = fixture.last_produced_block;
+      block_signing_private_keys = fixture.block_signing_private_keys;
+   }
+
+   void base_tester::set_default_config(db_read_mode read_mode) {
       cfg.blocks_dir      = tempdir.path() / config::default_blocks_dir_name;
       cfg.state_dir  = tempdir.path() / config::default_state_dir_name;
       cfg.state_size = 1024*1024*8;
@@ -101,11 +147,6 @@ namespace eosio { namespace testing {
          else if(boost::unit_test::framework::master_test_suite().argv[i] == std::string("--wabt"))
             cfg.wasm_runtime = chain::wasm_interface::vm_type::wabt;
       }
-
-      open(nullptr);
-
-      if (push_genesis)
-         push_genesis_block();
    }
 
 
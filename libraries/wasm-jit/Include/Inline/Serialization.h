@@ -53,6 +53,16 @@ namespace Serialization
 	// An output stream that writes to an array of bytes.
 	struct ArrayOutputStream : public OutputStream
 	{
+		// Preallocates at least numBytes of output, so that writing that much does not grow the array again.
+		void reserve(Uptr numBytes)
+		{
+			const Uptr nextIndex = next - bytes.data();
+			if(nextIndex + numBytes <= bytes.size()) { return; }
+			bytes.resize(nextIndex + numBytes);
+			next = bytes.data() + nextIndex;
+			end = bytes.data() + bytes.size();
+		}
+
 		// Moves the output array from the stream to the caller.
 		std::vector<U8>&& getBytes()
 		{
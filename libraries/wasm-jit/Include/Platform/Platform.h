@@ -87,9 +87,15 @@ namespace Platform
 	PLATFORM_API bool setVirtualPageAccess(U8* baseVirtualAddress,Uptr numPages,MemoryAccess access);
 
 	// Decommits the physical memory that was committed to the specified virtual pages.
+	// The pages read as zero if they are committed again.
 	// baseVirtualAddress must be a multiple of the preferred page size.
 	PLATFORM_API void decommitVirtualPages(U8* baseVirtualAddress,Uptr numPages);
 
+	// Zeroes committed pages by returning their physical memory to the OS; the pages stay accessible and are
+	// zero-filled on their next access, so the cost is proportional to the pages that were actually touched.
+	// baseVirtualAddress must be a multiple of the preferred page size.
+	PLATFORM_API void resetVirtualPages(U8* baseVirtualAddress,Uptr numPages);
+
 	// Frees virtual addresses. Any physical memory committed to the addresses must have already been decommitted.
 	// baseVirtualAddress must be a multiple of the preferred page size.
 	PLATFORM_API void freeVirtualPages(U8* baseVirtualAddress,Uptr numPages);
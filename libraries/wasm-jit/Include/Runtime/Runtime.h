@@ -202,8 +202,17 @@ namespace Runtime
 		std::vector<GlobalInstance*> globals;
 	};
 
+	// How much LLVM optimizes the functions of a module before generating machine code for them.
+	enum class JITOptimizationLevel
+	{
+		fastCompile,	// only promotes locals to registers and simplifies the control flow
+		standard,		// the default pipeline
+		aggressive		// the default pipeline followed by CSE, GVN, LICM and dead store elimination
+	};
+
 	// Instantiates a module, bindings its imports to the specified objects. May throw InstantiationException.
 	RUNTIME_API ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports);
+	RUNTIME_API ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports,JITOptimizationLevel optimizationLevel);
 
 	// Gets the default table/memory for a ModuleInstance.
 	RUNTIME_API MemoryInstance* getDefaultMemory(ModuleInstance* moduleInstance);
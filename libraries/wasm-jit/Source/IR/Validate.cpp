@@ -151,6 +151,10 @@ namespace IR
 			locals = functionType->parameters;
 			locals.insert(locals.end(),functionDef.nonParameterLocalTypes.begin(),functionDef.nonParameterLocalTypes.end());
 
+			// Sized for typical compiler output, so that most functions validate without growing the stacks.
+			controlStack.reserve(16);
+			stack.reserve(64);
+
 			// Push the function context onto the control stack.
 			pushControlStack(ControlContext::Type::function,functionType->ret,functionType->ret);
 		}
@@ -97,8 +97,25 @@ namespace Platform
 	{
 		errorUnless(isPageAligned(baseVirtualAddress));
 		auto numBytes = numPages << getPageSizeLog2();
-		if(madvise(baseVirtualAddress,numBytes,MADV_DONTNEED)) { Errors::fatal("madvise failed"); }
-		if(mprotect(baseVirtualAddress,numBytes,PROT_NONE)) { Errors::fatal("mprotect failed"); }
+		#ifdef __linux__
+			if(madvise(baseVirtualAddress,numBytes,MADV_DONTNEED)) { Errors::fatal("madvise failed"); }
+			if(mprotect(baseVirtualAddress,numBytes,PROT_NONE)) { Errors::fatal("mprotect failed"); }
+		#else
+			// MADV_DONTNEED is only a hint elsewhere; replacing the mapping is the portable way to get zero pages back.
+			if(mmap(baseVirtualAddress,numBytes,PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,-1,0) == MAP_FAILED) { Errors::fatal("mmap failed"); }
+		#endif
+	}
+
+	void resetVirtualPages(U8* baseVirtualAddress,Uptr numPages)
+	{
+		errorUnless(isPageAligned(baseVirtualAddress));
+		auto numBytes = numPages << getPageSizeLog2();
+		#ifdef __linux__
+			// Private anonymous pages dropped with MADV_DONTNEED are zero-filled on their next access.
+			if(madvise(baseVirtualAddress,numBytes,MADV_DONTNEED)) { Errors::fatal("madvise failed"); }
+		#else
+			if(mmap(baseVirtualAddress,numBytes,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,-1,0) == MAP_FAILED) { Errors::fatal("mmap failed"); }
+		#endif
 	}
 
 	void freeVirtualPages(U8* baseVirtualAddress,Uptr numPages)
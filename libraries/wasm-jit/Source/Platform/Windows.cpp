@@ -78,6 +78,13 @@ namespace Platform
 		if(baseVirtualAddress && !result) { Errors::fatal("VirtualFree(MEM_DECOMMIT) failed"); }
 	}
 
+	void resetVirtualPages(U8* baseVirtualAddress,Uptr numPages)
+	{
+		// Pages that are decommitted and committed again are zero-filled on demand.
+		decommitVirtualPages(baseVirtualAddress,numPages);
+		if(!commitVirtualPages(baseVirtualAddress,numPages)) { Errors::fatal("VirtualAlloc(MEM_COMMIT) failed"); }
+	}
+
 	void freeVirtualPages(U8* baseVirtualAddress,Uptr numPages)
 	{
 		errorUnless(isPageAligned(baseVirtualAddress));
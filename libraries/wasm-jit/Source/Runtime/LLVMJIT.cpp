@@ -238,7 +238,7 @@ namespace LLVMJIT
 			#endif
 		}
 
-		void compile(llvm::Module* llvmModule);
+		void compile(llvm::Module* llvmModule,JITOptimizationLevel optimizationLevel = JITOptimizationLevel::standard);
 
 		virtual void notifySymbolLoaded(const char* name,Uptr baseAddress,Uptr numBytes,std::map<U32,U32>&& offsetToOpIndexMap) = 0;
 
@@ -555,7 +555,7 @@ namespace LLVMJIT
 		Log::printf(Log::Category::debug,"Dumped LLVM module to: %s\n",augmentedFilename.c_str());
 	}
 
-	void JITUnit::compile(llvm::Module* llvmModule)
+	void JITUnit::compile(llvm::Module* llvmModule,JITOptimizationLevel optimizationLevel)
 	{
 		// Get a target machine object for this host, and set the module to use its data layout.
 		llvmModule->setDataLayout(targetMachine->createDataLayout());
@@ -576,10 +576,28 @@ namespace LLVMJIT
 
 		auto fpm = new llvm::legacy::FunctionPassManager(llvmModule);
 		fpm->add(llvm::createPromoteMemoryToRegisterPass());
-		fpm->add(llvm::createInstructionCombiningPass());
-		fpm->add(llvm::createCFGSimplificationPass());
-		fpm->add(llvm::createJumpThreadingPass());
-		fpm->add(llvm::createConstantPropagationPass());
+		if(optimizationLevel == JITOptimizationLevel::fastCompile)
+		{
+			// Instruction combining and jump threading are most of the time spent on huge modules.
+			fpm->add(llvm::createCFGSimplificationPass());
+		}
+		else
+		{
+			fpm->add(llvm::createInstructionCombiningPass());
+			fpm->add(llvm::createCFGSimplificationPass());
+			fpm->add(llvm::createJumpThreadingPass());
+			fpm->add(llvm::createConstantPropagationPass());
+		}
+		if(optimizationLevel == JITOptimizationLevel::aggressive)
+		{
+			fpm->add(llvm::createEarlyCSEPass());
+			fpm->add(llvm::createReassociatePass());
+			fpm->add(llvm::createGVNPass());
+			fpm->add(llvm::createLICMPass());
+			fpm->add(llvm::createDeadStoreEliminationPass());
+			fpm->add(llvm::createInstructionCombiningPass());
+			fpm->add(llvm::createCFGSimplificationPass());
+		}
 		fpm->doInitialization();
 
 		for(auto functionIt = llvmModule->begin();functionIt != llvmModule->end();++functionIt)
@@ -610,7 +628,7 @@ namespace LLVMJIT
 		delete llvmModule;
 	}
 
-	void instantiateModule(const IR::Module& module,ModuleInstance* moduleInstance)
+	void instantiateModule(const IR::Module& module,ModuleInstance* moduleInstance,JITOptimizationLevel optimizationLevel)
 	{
 		// Emit LLVM IR for the module.
 		auto llvmModule = emitModule(module,moduleInstance);
@@ -620,7 +638,7 @@ namespace LLVMJIT
 		moduleInstance->jitModule = jitModule;
 
 		// Compile the module.
-		jitModule->compile(llvmModule);
+		jitModule->compile(llvmModule,optimizationLevel);
 	}
 
 	std::string getExternalFunctionName(ModuleInstance* moduleInstance,Uptr functionDefIndex)
@@ -3,6 +3,8 @@
 #include "Platform/Platform.h"
 #include "RuntimePrivate.h"
 
+#include <algorithm>
+
 namespace Runtime
 {
 	// Global lists of memories; used to query whether an address is reserved by one of them.
@@ -89,12 +91,16 @@ namespace Runtime
 	}
 
 	void resetMemory(MemoryInstance* memory, MemoryType& newMemoryType) {
-		memory->type.size.min = 1;
-		if(shrinkMemory(memory, memory->numPages - 1) == -1)
+		// Zero the pages that stay committed by handing them back to the OS rather than with memset, so only the
+		// pages the previous call actually touched cost anything; pages beyond the new minimum are decommitted.
+		const Uptr keptPages = std::min(memory->numPages, Uptr(newMemoryType.size.min));
+		if(keptPages > 0)
+			Platform::resetVirtualPages(memory->baseAddress, keptPages << getPlatformPagesPerWebAssemblyPageLog2());
+		memory->type.size.min = keptPages;
+		if(shrinkMemory(memory, memory->numPages - keptPages) == -1)
 			causeException(Exception::Cause::outOfMemory);
-		memset(memory->baseAddress, 0, 1<<IR::numBytesPerPageLog2);
 		memory->type = newMemoryType;
-		if(growMemory(memory, memory->type.size.min - 1) == -1)
+		if(growMemory(memory, memory->type.size.min - keptPages) == -1)
 			causeException(Exception::Cause::outOfMemory);
    }
 
@@ -114,7 +120,7 @@ namespace Runtime
 			{
 				return -1;
 			}
-			memset(memory->baseAddress + (memory->numPages << IR::numBytesPerPageLog2), 0, numNewPages << IR::numBytesPerPageLog2);
+			// Newly committed pages are either fresh or were decommitted, so they already read as zero.
 			memory->numPages += numNewPages;
 		}
 		return previousNumPages;
@@ -31,6 +31,11 @@ namespace Runtime
 	MemoryInstance* MemoryInstance::theMemoryInstance = nullptr;
 
 	ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports)
+	{
+		return instantiateModule(module,std::move(imports),JITOptimizationLevel::standard);
+	}
+
+	ModuleInstance* instantiateModule(const IR::Module& module,ImportBindings&& imports,JITOptimizationLevel optimizationLevel)
 	{
 		ModuleInstance* moduleInstance = new ModuleInstance(
 			std::move(imports.functions),
@@ -130,7 +135,7 @@ namespace Runtime
 		}
 
 		// Generate machine code for the module.
-		LLVMJIT::instantiateModule(module,moduleInstance);
+		LLVMJIT::instantiateModule(module,moduleInstance,optimizationLevel);
 
 		// Set up the instance's exports.
 		for(const Export& exportIt : module.exports)
@@ -20,7 +20,7 @@ namespace LLVMJIT
 	};
 
 	void init();
-	void instantiateModule(const IR::Module& module,Runtime::ModuleInstance* moduleInstance);
+	void instantiateModule(const IR::Module& module,Runtime::ModuleInstance* moduleInstance,Runtime::JITOptimizationLevel optimizationLevel);
 	bool describeInstructionPointer(Uptr ip,std::string& outDescription);
 	
 	typedef void (*InvokeFunctionPointer)(void*,U64*);
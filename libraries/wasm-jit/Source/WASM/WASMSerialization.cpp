@@ -504,11 +504,14 @@ namespace WASM
 			if( locals_accum > eosio::chain::wasm_constraints::maximum_func_local_bytes )
 				throw FatalSerializationException( "too many locals" );
 
-			for(Uptr index = 0;index < localSet.num;++index) { functionDef.nonParameterLocalTypes.push_back(localSet.type); }
+			functionDef.nonParameterLocalTypes.insert(functionDef.nonParameterLocalTypes.end(),localSet.num,localSet.type);
 		}
 
 		// Deserialize the function code, validate it, and re-encode it in the IR format.
+		// The IR encoding of an operator is rarely more than twice its binary encoding, so reserving that up front
+		// replaces the many reallocations of growing the output from nothing with a single trim at the end.
 		ArrayOutputStream irCodeByteStream;
+		irCodeByteStream.reserve(bodyStream.capacity() * 2 + 16);
 		OperatorEncoderStream irEncoderStream(irCodeByteStream);
 		CodeValidationStream codeValidationStream(module,functionDef);
 		while(bodyStream.capacity())
@@ -533,6 +536,7 @@ namespace WASM
 		};
 		codeValidationStream.finish();
 		functionDef.code = std::move(irCodeByteStream.getBytes());
+		functionDef.code.shrink_to_fit();
 	}
 	
 	template<typename Stream>
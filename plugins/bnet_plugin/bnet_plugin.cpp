@@ -48,6 +48,7 @@
 #include <eosio/bnet_plugin/bnet_plugin.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/thread_registry.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
 #include <fc/io/json.hpp>
@@ -80,6 +81,7 @@ namespace fc {
 const fc::string logger_name("bnet_plugin");
 fc::logger plugin_logger;
 std::string peer_log_format;
+uint32_t    max_session_transactions = 0; ///< 0 for no limit, set once in plugin_initialize
 
 #define peer_dlog( PEER, FORMAT, ... ) \
   FC_MULTILINE_MACRO_BEGIN \
@@ -188,6 +190,47 @@ namespace eosio {
 
   class bnet_plugin_impl;
 
+  /**
+   *  Blocks packed as a bnet_message once, when they are accepted, and shared by every session relaying them.
+   *  A buffer is dropped from the cache when its block becomes irreversible; sessions still writing it hold
+   *  their own reference until the write completes. Accessed from the thread pool and the app thread.
+   */
+  class packed_block_cache {
+     public:
+        typedef std::shared_ptr<const vector<char>> buffer_ptr;
+
+        /// the bnet_message of the block, around the block as its block_state packed it
+        void add( const block_state_ptr& s ) {
+           auto block = s->packed_block();
+           auto packed = std::make_shared<vector<char>>( fc::raw::pack( fc::unsigned_int( bnet_message::tag<signed_block_ptr>::value ) ) );
+           packed->insert( packed->end(), block->begin(), block->end() );
+           const auto& id = s->id;
+           std::lock_guard<std::mutex> g( _mtx );
+           _buffers[id] = std::move( packed );
+        }
+
+        buffer_ptr find( const block_id_type& id )const {
+           std::lock_guard<std::mutex> g( _mtx );
+           auto itr = _buffers.find( id );
+           return itr == _buffers.end() ? buffer_ptr() : itr->second;
+        }
+
+        /// forgets lib and every block below it, including those of forks that were abandoned
+        void prune( uint32_t lib ) {
+           std::lock_guard<std::mutex> g( _mtx );
+           for( auto itr = _buffers.begin(); itr != _buffers.end(); ) {
+              if( block_header::num_from_id( itr->first ) <= lib )
+                 itr = _buffers.erase( itr );
+              else
+                 ++itr;
+           }
+        }
+
+     private:
+        mutable std::mutex                      _mtx;
+        std::map<block_id_type, buffer_ptr>     _buffers;
+  };
+
   template <typename Strand>
   void verify_strand_in_this_thread(const Strand& strand, const char* func, int line) {
      if( !strand.running_in_this_thread() ) {
@@ -299,6 +342,7 @@ namespace eosio {
         string                                                         _remote_port;
 
         vector<char>                                                  _out_buffer;
+        packed_block_cache::buffer_ptr                                _out_block; ///< sent instead of _out_buffer when set
         //boost::beast::multi_buffer                                  _in_buffer;
         boost::beast::flat_buffer                                     _in_buffer;
         flat_set<block_id_type>                                       _block_header_notices;
@@ -453,10 +497,23 @@ namespace eosio {
            stat.id       = t->id;
            stat.trx      = t;
            _transaction_status.insert( stat );
+           drop_oldest_transactions();
 
            maybe_send_next_message();
         }
 
+        /**
+         *  Transactions only go out when no block, notice or ping is waiting, so under a flood they pile up
+         *  here. Past max_session_transactions the oldest the peer has not been sent yet are dropped, they are
+         *  the stalest; transactions already sent sort last in by_received and only go once nothing else is left.
+         */
+        void drop_oldest_transactions() {
+           if( !max_session_transactions ) return;
+           auto& idx = _transaction_status.get<by_received>();
+           while( _transaction_status.size() > max_session_transactions )
+              idx.erase( idx.begin() );
+        }
+
         /**
          * Remove all transactions that expired from cache prior to now
          */
@@ -641,7 +698,7 @@ namespace eosio {
            verify_strand_in_this_thread(_strand, __func__, __LINE__);
 
            _state = sending_state;
-           _ws->async_write( boost::asio::buffer(_out_buffer),
+           _ws->async_write( _out_block ? boost::asio::buffer(*_out_block) : boost::asio::buffer(_out_buffer),
                              boost::asio::bind_executor(
                                 _strand,
                                std::bind( &session::on_write,
@@ -650,6 +707,9 @@ namespace eosio {
                                           std::placeholders::_2 ) ) );
         } FC_LOG_AND_RETHROW() }
 
+        /// sends the cached packed copy of b when there is one, packs b otherwise
+        void send_block( const block_id_type& id, const signed_block_ptr& b );
+
         void mark_block_status( const block_id_type& id, bool known_by_peer, bool recv_from_peer ) {
            auto itr = _block_status.find(id);
            if( itr == _block_status.end() ) {
@@ -676,7 +736,7 @@ namespace eosio {
         void maybe_send_next_message() {
            verify_strand_in_this_thread(_strand, __func__, __LINE__);
            if( _state == sending_state ) return; /// in process of sending
-           if( _out_buffer.size() ) return; /// in process of sending
+           if( _out_buffer.size() || _out_block ) return; /// in process of sending
            if( !_recv_remote_hello || !_sent_remote_hello ) return;
 
            clear_expired_trx();
@@ -818,7 +878,7 @@ namespace eosio {
             _last_sent_block_id  = next_id;
             _last_sent_block_num = nextblock->block_num();
 
-            send( nextblock );
+            send_block( next_id, nextblock );
             status( "sending block " + std::to_string( block_header::num_from_id(next_id) ) );
 
             if( nextblock->timestamp > (fc::time_point::now() - fc::seconds(5)) ) {
@@ -1071,6 +1131,7 @@ namespace eosio {
            }
            _state = idle_state;
            _out_buffer.resize(0);
+           _out_block.reset();
            maybe_send_next_message();
         }
 
@@ -1166,6 +1227,7 @@ namespace eosio {
          std::shared_ptr<listener>                              _listener;
          std::shared_ptr<boost::asio::deadline_timer>           _timer;    // only access on app io_service
          std::map<const session*, std::weak_ptr<session> >      _sessions; // only access on app io_service
+         packed_block_cache                                     _block_cache;
 
          channels::irreversible_block::channel_type::handle     _on_irb_handle;
          channels::accepted_block::channel_type::handle         _on_accepted_block_handle;
@@ -1212,6 +1274,7 @@ namespace eosio {
           * can purge their block cache
           */
          void on_irreversible_block( block_state_ptr s ) {
+            _block_cache.prune( s->block_num );
             for_each_session( [s]( auto ses ){ ses->on_new_lib( s ); } );
          }
 
@@ -1223,6 +1286,7 @@ namespace eosio {
           */
          void on_accepted_block( block_state_ptr s ) {
             _ioc->post( [s,this] { /// post this to the thread pool because packing can be intensive
+               _block_cache.add( s );
                for_each_session( [s]( auto ses ){ ses->on_accepted_block( s ); } );
             });
          }
@@ -1320,6 +1384,7 @@ namespace eosio {
          ("bnet-threads", bpo::value<uint32_t>(), "the number of threads to use to process network messages" )
          ("bnet-connect", bpo::value<vector<string>>()->composing(), "remote endpoint of other node to connect to; Use multiple bnet-connect options as needed to compose a network" )
          ("bnet-no-trx", bpo::bool_switch()->default_value(false), "this peer will request no pending transactions from other nodes" )
+         ("bnet-max-session-transactions", bpo::value<uint32_t>()->default_value(100000), "the maximum number of transactions tracked for a peer, the oldest not yet sent are dropped beyond it. 0 for no limit" )
          ("bnet-peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
            "Available Variables:\n"
@@ -1362,6 +1427,7 @@ namespace eosio {
                my->_num_threads = 8;
          }
          my->_request_trx = !options.at( "bnet-no-trx" ).as<bool>();
+         max_session_transactions = options.at( "bnet-max-session-transactions" ).as<uint32_t>();
 
       } FC_LOG_AND_RETHROW()
    }
@@ -1422,7 +1488,10 @@ namespace eosio {
 
       my->_socket_threads.reserve( my->_num_threads );
       for( auto i = 0; i < my->_num_threads; ++i ) {
-         my->_socket_threads.emplace_back( [&ioc]{ wlog( "start thread" ); ioc.run(); wlog( "end thread" ); } );
+         my->_socket_threads.emplace_back( [&ioc, i]{
+            chain::thread_registry::instance().register_current_thread( "bnet-" + std::to_string( i ) );
+            wlog( "start thread" ); ioc.run(); wlog( "end thread" );
+         } );
       }
 
       for( const auto& peer : my->_connect_to_peers ) {
@@ -1473,6 +1542,14 @@ namespace eosio {
      });
    }
 
+   void session::send_block( const block_id_type& id, const signed_block_ptr& b ) {
+      _out_block = _net_plugin->_block_cache.find( id );
+      if( _out_block )
+         send();
+      else
+         send( b );
+   }
+
    void session::do_hello() {
       /// TODO: find more effecient way to move large array of ids in event of fork
       async_get_pending_block_ids( [self = shared_from_this() ]( const vector<block_id_type>& ids, uint32_t lib ){
@@ -4,9 +4,12 @@
  */
 #include <eosio/chain_api_plugin/chain_api_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/read_replica.hpp>
 
 #include <fc/io/json.hpp>
 
+#include <shared_mutex>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _chain_api_plugin = app().register_plugin<chain_api_plugin>();
@@ -21,12 +24,21 @@ public:
    controller& db;
 };
 
+static uint32_t batch_max_calls_option = 100;
 
 chain_api_plugin::chain_api_plugin(){}
 chain_api_plugin::~chain_api_plugin(){}
 
-void chain_api_plugin::set_program_options(options_description&, options_description&) {}
-void chain_api_plugin::plugin_initialize(const variables_map&) {}
+void chain_api_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("batch-max-calls", bpo::value<uint32_t>()->default_value(100),
+          "Maximum number of read-only calls accepted by a single /v1/chain/batch request")
+         ;
+}
+
+void chain_api_plugin::plugin_initialize(const variables_map& options) {
+   batch_max_calls_option = options.at( "batch-max-calls" ).as<uint32_t>();
+}
 
 struct async_result_visitor : public fc::visitor<std::string> {
    template<typename T>
@@ -35,11 +47,17 @@ struct async_result_visitor : public fc::visitor<std::string> {
    }
 };
 
+/// a read replica reads the chain state of the node it follows while holding the shared lock; a no-op otherwise
+static std::shared_lock<chain::read_replica_segment> lock_read_replica( chain::read_replica_segment* replica ) {
+   return replica ? std::shared_lock<chain::read_replica_segment>( *replica ) : std::shared_lock<chain::read_replica_segment>();
+}
+
 #define CALL(api_name, api_handle, api_namespace, call_name, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [api_handle](string, string body, url_response_callback cb) mutable { \
+   [api_handle, replica](string, string body, url_response_callback cb) mutable { \
           api_handle.validate(); \
           try { \
+             auto replica_lock = lock_read_replica( replica ); \
              if (body.empty()) body = "{}"; \
              auto result = api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()); \
              cb(http_response_code, fc::json::to_string(result)); \
@@ -50,7 +68,8 @@ struct async_result_visitor : public fc::visitor<std::string> {
 
 #define CALL_ASYNC(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [api_handle](string, string body, url_response_callback cb) mutable { \
+   [api_handle, replica](string, string body, url_response_callback cb) mutable { \
+      auto replica_lock = lock_read_replica( replica ); \
       if (body.empty()) body = "{}"; \
       api_handle.validate(); \
       api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(),\
@@ -68,6 +87,48 @@ struct async_result_visitor : public fc::visitor<std::string> {
    }\
 }
 
+using batch_call = std::function<fc::variant(const fc::variant&)>;
+
+#define BATCH_RO_CALL(call_name) \
+{std::string(#call_name), \
+   [ro_api](const fc::variant& params) mutable { \
+      return fc::variant(ro_api.call_name(params.as<chain_apis::read_only::call_name ## _params>())); \
+   }}
+
+/**
+ *  Runs the read-only calls of a /v1/chain/batch request, given as [{"call": "get_account", "params": {...}}, ...],
+ *  one after the other within a single http callback on the main thread, so that every call sees the same state.
+ *  The result holds one {"code", "result"} object per call, a failed call has the error_results of its exception
+ *  as result and does not stop the others.
+ */
+static fc::variant run_batch( const std::map<string, batch_call>& calls, uint32_t max_calls, const string& body ) {
+   auto requests = fc::json::from_string( body ).get_array();
+   EOS_ASSERT( requests.size() <= max_calls, chain::invalid_http_request, "batch of ${n} calls exceeds batch-max-calls of ${m}",
+               ("n", requests.size())("m", max_calls) );
+   fc::variants results;
+   results.reserve( requests.size() );
+   for( const auto& request : requests ) {
+      int code = 200;
+      fc::variant result;
+      string call_name;
+      try {
+         const auto& o = request.get_object();
+         call_name = o["call"].as_string();
+         auto itr = calls.find( call_name );
+         EOS_ASSERT( itr != calls.end(), chain::invalid_http_request, "${c} is not a read-only chain call", ("c", call_name) );
+         result = itr->second( o.contains( "params" ) ? o["params"] : fc::variant( fc::variant_object() ) );
+      } catch( ... ) {
+         http_plugin::handle_exception( "chain", call_name.empty() ? "batch" : call_name.c_str(), fc::json::to_string( request ),
+                                        [&]( int c, string error ) {
+            code = c;
+            result = fc::json::from_string( error );
+         } );
+      }
+      results.emplace_back( fc::mutable_variant_object()( "code", code )( "result", std::move( result ) ) );
+   }
+   return fc::variant( std::move( results ) );
+}
+
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
@@ -78,10 +139,34 @@ void chain_api_plugin::plugin_startup() {
    my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
    auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
    auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
+   auto* replica = app().get_plugin<chain_plugin>().chain().get_read_replica();
 
    auto& _http_plugin = app().get_plugin<http_plugin>();
    ro_api.set_shorten_abi_errors( !_http_plugin.verbose_errors() );
 
+   std::map<string, batch_call> batch_calls = {
+      BATCH_RO_CALL(get_info),
+      BATCH_RO_CALL(get_block),
+      BATCH_RO_CALL(get_block_header_state),
+      BATCH_RO_CALL(get_account),
+      BATCH_RO_CALL(get_code),
+      BATCH_RO_CALL(get_code_hash),
+      BATCH_RO_CALL(get_abi),
+      BATCH_RO_CALL(get_raw_code_and_abi),
+      BATCH_RO_CALL(get_raw_abi),
+      BATCH_RO_CALL(get_table_rows),
+      BATCH_RO_CALL(get_table_by_scope),
+      BATCH_RO_CALL(get_currency_balance),
+      BATCH_RO_CALL(get_currency_stats),
+      BATCH_RO_CALL(get_producers),
+      BATCH_RO_CALL(get_producer_schedule),
+      BATCH_RO_CALL(get_scheduled_transactions),
+      BATCH_RO_CALL(abi_json_to_bin),
+      BATCH_RO_CALL(abi_bin_to_json),
+      BATCH_RO_CALL(get_required_keys),
+      BATCH_RO_CALL(get_transaction_id)
+   };
+
    _http_plugin.add_api({
       CHAIN_RO_CALL(get_info, 200l),
       CHAIN_RO_CALL(get_block, 200),
@@ -105,8 +190,20 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_transaction_id, 200),
       CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
       CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
-      CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202)
+      CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
+      CHAIN_RW_CALL_ASYNC(dry_run_transaction, chain_apis::read_write::dry_run_transaction_results, 200)
    });
+
+   _http_plugin.add_handler( "/v1/chain/batch",
+      [batch_calls = std::move( batch_calls ), max_calls = batch_max_calls_option, replica]( string, string body, url_response_callback cb ) {
+         try {
+            auto replica_lock = lock_read_replica( replica );
+            if( body.empty() ) body = "[]";
+            cb( 200, fc::json::to_string( run_batch( batch_calls, max_calls, body ) ) );
+         } catch( ... ) {
+            http_plugin::handle_exception( "chain", "batch", body, cb );
+         }
+      } );
 }
 
 void chain_api_plugin::plugin_shutdown() {}
@@ -0,0 +1,88 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <appbase/application.hpp>
+
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace eosio { namespace chain { namespace plugin_interface {
+
+   /**
+    * How urgent work posted to the application thread is: blocks and block production first, transactions next,
+    * API requests and relaying last.
+    */
+   enum class priority : uint8_t { low, medium, high };
+
+   /**
+    * Handlers posted to the application io_service run in the order they were posted. Work posted through this
+    * queue is held in it instead, and each handler posted for it runs whichever queued function is the most
+    * urgent by the time that handler gets its turn, the oldest first among equals. So blocks overtake the
+    * transactions and requests waiting before them. Timers and sockets of the io_service are not queued and
+    * keep their turn.
+    */
+   class execution_priority_queue {
+   public:
+      template<typename F>
+      void post( boost::asio::io_service& ios, priority p, F&& f ) {
+         {
+            std::lock_guard<std::mutex> g( mtx_ );
+            queue_.push( queued{ p, order_++, std::function<void()>( std::forward<F>( f ) ) } );
+         }
+         ios.post( [this]() { execute_highest(); } );
+      }
+
+      /// runs the most urgent queued function, if any is left
+      void execute_highest() {
+         std::function<void()> f;
+         {
+            std::lock_guard<std::mutex> g( mtx_ );
+            if( queue_.empty() )
+               return;
+            f = std::move( const_cast<queued&>( queue_.top() ).f ); // popped right after
+            queue_.pop();
+         }
+         f();
+      }
+
+      size_t size()const {
+         std::lock_guard<std::mutex> g( mtx_ );
+         return queue_.size();
+      }
+
+   private:
+      struct queued {
+         priority              p;
+         uint64_t              order;
+         std::function<void()> f;
+      };
+
+      struct less_urgent {
+         bool operator()( const queued& a, const queued& b )const {
+            return a.p != b.p ? a.p < b.p : a.order > b.order;
+         }
+      };
+
+      mutable std::mutex                                             mtx_;
+      std::priority_queue<queued, std::vector<queued>, less_urgent>  queue_;     // guarded by `mtx_`
+      uint64_t                                                       order_ = 0; // guarded by `mtx_`
+   };
+
+   /// the queue in front of the io_service of the application
+   inline execution_priority_queue& app_queue() {
+      static execution_priority_queue q;
+      return q;
+   }
+
+   /// runs f on the application thread, ahead of less urgent work posted the same way
+   template<typename F>
+   void app_post( priority p, F&& f ) {
+      app_queue().post( appbase::app().get_io_service(), p, std::forward<F>( f ) );
+   }
+
+} } } // eosio::chain::plugin_interface
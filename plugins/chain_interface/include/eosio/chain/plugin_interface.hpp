@@ -19,6 +19,9 @@ namespace eosio { namespace chain { namespace plugin_interface {
    template<typename T>
    using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
 
+   /// one result per transaction of a batch, in the order they were given
+   using transaction_batch_results = vector<fc::static_variant<fc::exception_ptr, transaction_trace_ptr>>;
+
    struct chain_plugin_interface;
 
    namespace channels {
@@ -53,6 +56,8 @@ namespace eosio { namespace chain { namespace plugin_interface {
          // synchronously push a block/trx to a single provider
          using block_sync            = method_decl<chain_plugin_interface, void(const signed_block_ptr&), first_provider_policy>;
          using transaction_async     = method_decl<chain_plugin_interface, void(const packed_transaction_ptr&, bool, next_function<transaction_trace_ptr>), first_provider_policy>;
+         // unpack and recover the keys of every trx first, then push them back to back
+         using transaction_batch_async = method_decl<chain_plugin_interface, void(const vector<packed_transaction_ptr>&, bool, std::function<void(const transaction_batch_results&)>), first_provider_policy>;
       }
    }
 
@@ -15,6 +15,9 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
+#include <eosio/chain/read_replica.hpp>
+#include <eosio/chain/thread_registry.hpp>
 
 #include <eosio/chain/eosio_contract.hpp>
 
@@ -25,11 +28,15 @@
 #include <boost/signals2/connection.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/asio.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
 #include <signal.h>
 #include <cstdlib>
+#include <atomic>
+#include <thread>
 
 namespace eosio {
 
@@ -110,6 +117,39 @@ void validate(boost::any& v,
   }
 }
 
+std::ostream& operator<<(std::ostream& osm, eosio::chain::db_map_mode m) {
+   if ( m == eosio::chain::db_map_mode::MAPPED ) {
+      osm << "mapped";
+   } else if ( m == eosio::chain::db_map_mode::LOCKED ) {
+      osm << "locked";
+   } else if ( m == eosio::chain::db_map_mode::HUGEPAGES ) {
+      osm << "hugepages";
+   }
+
+   return osm;
+}
+
+void validate(boost::any& v,
+              const std::vector<std::string>& values,
+              eosio::chain::db_map_mode* /* target_type */,
+              int)
+{
+  using namespace boost::program_options;
+
+  validators::check_first_occurrence(v);
+  std::string const& s = validators::get_single_string(values);
+
+  if ( s == "mapped" ) {
+     v = boost::any(eosio::chain::db_map_mode::MAPPED);
+  } else if ( s == "locked" ) {
+     v = boost::any(eosio::chain::db_map_mode::LOCKED);
+  } else if ( s == "hugepages" ) {
+     v = boost::any(eosio::chain::db_map_mode::HUGEPAGES);
+  } else {
+     throw validation_error(validation_error::invalid_option_value);
+  }
+}
+
 }
 
 using namespace eosio;
@@ -158,8 +198,12 @@ public:
    {}
 
    bool                             exit_after_init_chain = false;
+   bool                             trim_unconsumed_traces = false;
+   vector<string>                   trace_consumer_plugins;
    bfs::path                        blocks_dir;
    bool                             readonly = false;
+   std::thread                      read_replica_follower; ///< moves the head of a read replica when the node followed publishes one
+   std::atomic<bool>                stop_following{false};
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
 
    fc::optional<fork_database>      fork_db;
@@ -170,7 +214,26 @@ public:
    //txn_msg_rate_limits              rate_limits;
    fc::optional<vm_type>            wasm_runtime;
    fc::microseconds                 abi_serializer_max_time_ms;
+   chain::abi_serializer_cache      abi_cache;
+   std::unique_ptr<chain_apis::block_response_cache> block_cache;
+   // recovers the signing keys of dry run transactions, which are then executed on the application thread
+   fc::optional<boost::asio::thread_pool> dry_run_pool;
+   fc::microseconds                 dry_run_max_time;
    fc::optional<bfs::path>          snapshot_path;
+   // a snapshot is opened once, so that it can be read from a pipe
+   std::unique_ptr<std::ifstream>   snapshot_file;
+   snapshot_reader_ptr              snapshot_reader;
+
+   void open_snapshot( const bfs::path& path ) {
+      snapshot_path = path;
+      snapshot_file = std::make_unique<std::ifstream>(path.generic_string(), (std::ios::in | std::ios::binary));
+      // both formats start with their magic number, which differ in the first byte
+      if( snapshot_file->peek() == (compressed_ostream_snapshot_writer::magic_number & 0xff) )
+         snapshot_reader = std::make_shared<compressed_istream_snapshot_reader>(*snapshot_file);
+      else
+         snapshot_reader = std::make_shared<istream_snapshot_reader>(*snapshot_file);
+      snapshot_reader->validate();
+   }
 
 
    // retained references to channels for easy publication
@@ -219,15 +282,68 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
-         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"), "Override default WASM runtime")
+         ("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt/tiered"), "Override default WASM runtime")
+         ("wasm-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_cache_size / (1024  * 1024)),
+          "Maximum estimated size (in MiB) of instantiated contracts kept in memory; least recently used contracts are evicted first (0 for unbounded)")
+         ("wasm-cache-max-entries", bpo::value<uint32_t>()->default_value(config::default_wasm_cache_max_entries),
+          "Maximum number of instantiated contracts kept in memory (0 for unbounded)")
+         ("wasm-cache-pin-account", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "Account whose contract is never evicted from the instantiation cache, in addition to eosio (may specify multiple times)")
+         ("wasm-compile-threads", bpo::value<uint32_t>()->default_value(config::default_wasm_compile_threads),
+          "Number of threads compiling newly set and pinned contracts ahead of their first use (0 to compile on first use)")
+         ("wasm-tier-up-threshold", bpo::value<uint32_t>()->default_value(config::default_wasm_tier_up_threshold),
+          "With wasm-runtime=tiered, number of invocations on wabt after which a contract is compiled with wavm")
+         ("wasm-jit-fast-compile-size-kb", bpo::value<uint64_t>()->default_value(config::default_wasm_jit_fast_compile_size / 1024),
+          "Size (in KiB) of injected contract code from which wavm compiles with fewer optimizations to bound its compile time (0 to always fully optimize)")
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(config::default_signature_recovery_threads),
+          "Number of threads recovering the signing keys of a block's transactions before it is applied (0 to recover them in order)")
+         ("snapshot-threads", bpo::value<uint32_t>()->default_value(config::default_snapshot_threads),
+          "Number of threads serializing and loading the sections of a snapshot (0 or 1 to process them in order)")
+         ("signal-dispatch-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads running the block and transaction handlers of the plugins that allow it, such as the kafka and mysql exporters, so they do not delay applying blocks (0 to run them on the main thread)")
+         ("thread-affinity", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "Pin a thread, or a pool of threads, to CPUs, as NAME=CPUS such as main=0 or net=2-3,6 (may specify multiple times). "
+          "Threads are named main, chain-recovery-N, chain-compile-N, chain-signal-N, net-N, bnet-N, http-N, icp-relay-N, kafka-N, "
+          "mongo-db-traces, mongo-db-transactions, mongo-db-blocks and mysql-db-..., and a name also applies to the threads whose names "
+          "start with it and a dash, such as chain for all the chain pools. Without one a thread runs on any CPU.")
+         ("hot-state-cache-rows", bpo::value<uint32_t>()->default_value(config::default_hot_state_cache_rows),
+          "Maximum number of contract table rows found by primary key that are kept at hand in front of the state database (0 to disable)")
+         ("signature-recovery-cache-size", bpo::value<uint32_t>()->default_value(config::default_signature_recovery_cache_size),
+          "Maximum number of keys recovered from transaction and block signatures that are kept so the same signature is not recovered again (0 to disable)")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
           "Override default maximum ABI serialization time allowed in ms")
+         ("get-block-cache-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of irreversible blocks whose /v1/chain/get_block result is kept rendered, filled as blocks become irreversible (0 to disable)")
+         ("dry-run-threads", bpo::value<uint16_t>()->default_value(1),
+          "Number of worker threads recovering the signing keys of /v1/chain/dry_run_transaction calls (0 to recover them on the main thread)")
+         ("dry-run-max-time-ms", bpo::value<uint32_t>()->default_value(30),
+          "Maximum time (in milliseconds) a transaction of /v1/chain/dry_run_transaction may execute for")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
+         ("database-map-mode", bpo::value<eosio::chain::db_map_mode>()->default_value(eosio::chain::db_map_mode::MAPPED),
+          "How the chain state database is kept in memory (\"mapped\", \"locked\" or \"hugepages\").\n"
+          "In \"mapped\" mode pages are read from and written back to the state file on demand.\n"
+          "In \"locked\" mode the whole database is read in at startup and locked in memory; chain-state-db-size-mb of memory must be lockable.\n"
+          "In \"hugepages\" mode the database is locked as well and backed by huge pages where the kernel supports it, e.g. a state dir on tmpfs mounted with huge=always.\n")
+         ("enable-read-replicas", bpo::bool_switch()->default_value(false),
+          "Let other nodeos processes on this host follow the chain state of this one with read-replica-of; changes to the state wait for their reads in progress")
+         ("read-replica-of", bpo::value<bfs::path>(),
+          "State directory of a nodeos on this host running with enable-read-replicas; its chain state is mapped read-only and this node serves chain API reads from it without applying blocks. "
+          "The fork database and block log of a replica stay empty, so get_block only finds blocks on the node followed. Restart replicas along with the node they follow.")
          ("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")
          ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks database")
          ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
+         ("profile-execution", bpo::bool_switch()->default_value(false),
+          "Accumulate the time spent per (receiver, action) and per host function; see /v1/producer/get_execution_profile")
+         ("profile-transaction-phases", bpo::bool_switch()->default_value(false),
+          "Add the time spent in authorization, dispatch, native and WASM handlers, database host functions, deferred scheduling and finalization to every transaction trace")
+         ("trim-unconsumed-traces", bpo::bool_switch()->default_value(false),
+          "When no plugin listed by trace-consumer-plugin is enabled and nothing subscribes to the applied transaction channel, keep only the receipts and exceptions of actions in transaction traces, including those returned by the push_transaction APIs")
+         ("trace-consumer-plugin", bpo::value<vector<string>>()->composing()->multitoken()
+             ->default_value({"eosio::history_plugin", "eosio::mongo_db_plugin", "eosio::kafka_plugin", "eosio::mysql_db_plugin"},
+                              "eosio::history_plugin eosio::mongo_db_plugin eosio::kafka_plugin eosio::mysql_db_plugin"),
+          "Plugin that reads full transaction traces, for trim-unconsumed-traces (may specify multiple times)")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
           "Account added to actor whitelist (may specify multiple times)")
          ("actor-blacklist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -280,6 +396,9 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "do not skip any checks that can be skipped while replaying irreversible blocks")
          ("disable-replay-opts", bpo::bool_switch()->default_value(false),
           "disable optimizations that specifically target replay")
+         ("trusted-replay-checksum", bpo::value<string>(),
+          "sha256 of blocks.log as printed by eosio-blocklog --checksum; when the log matches it, the merkle roots of "
+          "its blocks are taken as given instead of recomputed during the replay")
          ("replay-blockchain", bpo::bool_switch()->default_value(false),
           "clear chain state database and replay all blocks")
          ("hard-replay-blockchain", bpo::bool_switch()->default_value(false),
@@ -293,7 +412,7 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("export-reversible-blocks", bpo::value<bfs::path>(),
            "export reversible block database in portable format into specified file and then exit")
          ("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.")
-         ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")
+         ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from, which may be a pipe for compressed snapshots")
          ;
 
 }
@@ -347,6 +466,22 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          throw;
       }
 
+      if( options.count( "thread-affinity" )) {
+         std::map<string, vector<uint32_t>> affinities;
+         for( const auto& a : options["thread-affinity"].as<vector<string>>() ) {
+            auto pos = a.find( '=' );
+            EOS_ASSERT( pos != string::npos && pos > 0, plugin_config_exception, "Invalid entry in thread-affinity: '${a}'", ("a", a));
+            try {
+               affinities[a.substr( 0, pos )] = thread_registry::parse_cpu_list( a.substr( pos + 1 ));
+            } catch( const fc::exception& e ) {
+               EOS_THROW( plugin_config_exception, "Invalid entry in thread-affinity: '${a}': ${e}", ("a", a)("e", e.top_message()));
+            }
+         }
+         thread_registry::instance().set_affinities( std::move( affinities ));
+      }
+      // the threads of the controller and of the plugins register as they start, after this
+      thread_registry::instance().register_current_thread( "main" );
+
       my->chain_config = controller::config();
 
       LOAD_VALUE_SET( options, "actor-whitelist", my->chain_config->actor_whitelist );
@@ -355,6 +490,7 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       LOAD_VALUE_SET( options, "contract-blacklist", my->chain_config->contract_blacklist );
 
       LOAD_VALUE_SET( options, "trusted-producer", my->chain_config->trusted_producers );
+      LOAD_VALUE_SET( options, "wasm-cache-pin-account", my->chain_config->wasm_cache_pinned_accounts );
 
       if( options.count( "action-blacklist" )) {
          const std::vector<std::string>& acts = options["action-blacklist"].as<std::vector<std::string>>();
@@ -408,6 +544,12 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if(options.count("abi-serializer-max-time-ms"))
          my->abi_serializer_max_time_ms = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
+      if( options.at( "get-block-cache-size" ).as<uint32_t>() > 0 )
+         my->block_cache.reset( new chain_apis::block_response_cache( options.at( "get-block-cache-size" ).as<uint32_t>() ) );
+      if( options.at( "dry-run-threads" ).as<uint16_t>() > 0 )
+         my->dry_run_pool.emplace( options.at( "dry-run-threads" ).as<uint16_t>() );
+      my->dry_run_max_time = fc::milliseconds( options.at( "dry-run-max-time-ms" ).as<uint32_t>() );
+
       my->chain_config->blocks_dir = my->blocks_dir;
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
@@ -415,6 +557,8 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if( options.count( "chain-state-db-size-mb" ))
          my->chain_config->state_size = options.at( "chain-state-db-size-mb" ).as<uint64_t>() * 1024 * 1024;
 
+      my->chain_config->state_map_mode = options.at( "database-map-mode" ).as<db_map_mode>();
+
       if( options.count( "chain-state-db-guard-size-mb" ))
          my->chain_config->state_guard_size = options.at( "chain-state-db-guard-size-mb" ).as<uint64_t>() * 1024 * 1024;
 
@@ -428,9 +572,29 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
 
+      my->chain_config->wasm_cache_size = options.at( "wasm-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+      my->chain_config->wasm_cache_max_entries = options.at( "wasm-cache-max-entries" ).as<uint32_t>();
+      my->chain_config->wasm_compile_threads = options.at( "wasm-compile-threads" ).as<uint32_t>();
+      my->chain_config->wasm_tier_up_threshold = options.at( "wasm-tier-up-threshold" ).as<uint32_t>();
+      my->chain_config->wasm_jit_fast_compile_size = options.at( "wasm-jit-fast-compile-size-kb" ).as<uint64_t>() * 1024;
+      my->chain_config->signature_recovery_threads = options.at( "signature-recovery-threads" ).as<uint32_t>();
+      my->chain_config->snapshot_threads = options.at( "snapshot-threads" ).as<uint32_t>();
+      my->chain_config->signal_dispatch_threads = options.at( "signal-dispatch-threads" ).as<uint32_t>();
+      my->chain_config->hot_state_cache_rows = options.at( "hot-state-cache-rows" ).as<uint32_t>();
+      my->chain_config->signature_recovery_cache_size = options.at( "signature-recovery-cache-size" ).as<uint32_t>();
+
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
+      if( options.count( "trusted-replay-checksum" )) {
+         EOS_ASSERT( !my->chain_config->force_all_checks && !my->chain_config->disable_replay_opts, plugin_config_exception,
+                     "trusted-replay-checksum cannot be combined with force-all-checks or disable-replay-opts" );
+         my->chain_config->trusted_replay_checksum = fc::sha256( options.at( "trusted-replay-checksum" ).as<string>() );
+      }
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
+      my->chain_config->profile_execution = options.at( "profile-execution" ).as<bool>();
+      my->chain_config->profile_transaction_phases = options.at( "profile-transaction-phases" ).as<bool>();
+      my->trim_unconsumed_traces = options.at( "trim-unconsumed-traces" ).as<bool>();
+      my->trace_consumer_plugins = options.at( "trace-consumer-plugin" ).as<vector<string>>();
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
 
       if( options.count( "extract-genesis-json" ) || options.at( "print-genesis-json" ).as<bool>()) {
@@ -543,18 +707,15 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       my->exit_after_init_chain = options.at("exit-after-initialize-blockchain").as<bool>();
 
       if (options.count( "snapshot" )) {
-         my->snapshot_path = options.at( "snapshot" ).as<bfs::path>();
-         EOS_ASSERT( fc::exists(*my->snapshot_path), plugin_config_exception,
-                     "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()) );
+         auto snapshot_path = options.at( "snapshot" ).as<bfs::path>();
+         EOS_ASSERT( fc::exists(snapshot_path), plugin_config_exception,
+                     "Cannot load snapshot, ${name} does not exist", ("name", snapshot_path.generic_string()) );
 
          // recover genesis information from the snapshot
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
-         reader->validate();
-         reader->read_section<genesis_state>([this]( auto &section ){
+         my->open_snapshot( snapshot_path );
+         my->snapshot_reader->read_section<genesis_state>([this]( auto &section ){
             section.read_row(my->chain_config->genesis);
          });
-         infile.close();
 
          EOS_ASSERT( options.count( "genesis-json" ) == 0 &&  options.count( "genesis-timestamp" ) == 0,
                  plugin_config_exception,
@@ -624,6 +785,19 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->block_validation_mode = options.at("validation-mode").as<validation_mode>();
       }
 
+      my->chain_config->enable_read_replicas = options.at( "enable-read-replicas" ).as<bool>();
+      if( options.count( "read-replica-of" ) ) {
+         auto dir = options.at( "read-replica-of" ).as<bfs::path>();
+         my->chain_config->read_replica_of = dir.is_relative() ? bfs::current_path() / dir : dir;
+         EOS_ASSERT( !my->chain_config->enable_read_replicas, plugin_config_exception,
+                     "read-replica-of cannot be combined with enable-read-replicas" );
+         EOS_ASSERT( !my->snapshot_reader, plugin_config_exception, "read-replica-of cannot be combined with snapshot" );
+         EOS_ASSERT( my->chain_config->read_replica_of != my->chain_config->state_dir, plugin_config_exception,
+                     "read-replica-of must be the state directory of another node" );
+         // rejects the read_write API calls
+         my->chain_config->read_mode = db_read_mode::READ_ONLY;
+      }
+
       my->chain.emplace( *my->chain_config );
       my->chain_id.emplace( my->chain->get_chain_id());
 
@@ -670,12 +844,18 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->accepted_block_channel.publish( blk );
       } );
 
-      my->accepted_block_with_action_digests_connection = my->chain->accepted_block_with_action_digests.connect( [this]( const block_state_with_action_digests_ptr& blk ) {
-         my->accepted_block_with_action_digests_channel.publish( blk );
-      } );
-
       my->irreversible_block_connection = my->chain->irreversible_block.connect( [this]( const block_state_ptr& blk ) {
          my->irreversible_block_channel.publish( blk );
+         if( my->block_cache ) {
+            // rendered once the block that made it irreversible has been dealt with
+            plugin_interface::app_post( plugin_interface::priority::low, [this, block_num = blk->block_num]() {
+               try {
+                  get_read_only_api().get_block( chain_apis::read_only::get_block_params{ std::to_string( block_num ) } );
+               } catch( const fc::exception& e ) {
+                  wlog( "unable to cache get_block of ${n}: ${e}", ("n", block_num)("e", e.to_string()) );
+               }
+            } );
+         }
       } );
 
       my->accepted_transaction_connection = my->chain->accepted_transaction.connect(
@@ -701,11 +881,10 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 void chain_plugin::plugin_startup()
 { try {
    try {
-      if (my->snapshot_path) {
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
-         my->chain->startup(reader);
-         infile.close();
+      if (my->snapshot_reader) {
+         my->chain->startup(my->snapshot_reader);
+         my->snapshot_reader.reset();
+         my->snapshot_file.reset();
       } else {
          my->chain->startup();
       }
@@ -720,11 +899,51 @@ void chain_plugin::plugin_startup()
       ilog("starting chain in read/write mode");
    }
 
+   if( auto* replica = my->chain->get_read_replica() ) {
+      my->read_replica_follower = std::thread( [this, replica]() {
+         uint64_t known = replica->revision();
+         while( !my->stop_following ) {
+            if( !replica->wait_for_revision( known, fc::milliseconds( 500 ) ) )
+               continue;
+            known = replica->revision();
+            plugin_interface::app_post( plugin_interface::priority::high, [this]() {
+               try {
+                  if( my->chain )
+                     my->chain->follow_read_replica_head();
+               } FC_LOG_AND_DROP()
+            } );
+         }
+      } );
+   }
+
    ilog("Blockchain started; head block is #${num}, genesis timestamp is ${ts}",
         ("num", my->chain->head_block_num())("ts", (std::string)my->chain_config->genesis.initial_timestamp));
 
    my->chain_config.reset();
 
+   // the digests are only kept by the controller while this signal is connected; plugins subscribe to the channel
+   // in their own startup, after this one, so look for subscribers once every plugin has started
+   app().get_io_service().post( [this]() {
+      if( !my->chain )
+         return;
+
+      if( my->trim_unconsumed_traces ) {
+         bool consumed = my->applied_transaction_channel.has_subscribers();
+         for( const auto& name : my->trace_consumer_plugins ) {
+            auto* p = app().find_plugin( name );
+            consumed = consumed || (p && p->get_state() != abstract_plugin::registered);
+         }
+         my->chain->set_trim_action_traces( !consumed );
+         ilog( consumed ? "transaction traces are consumed, so they are kept whole" : "trimming transaction traces, which nothing consumes" );
+      }
+
+      if( !my->accepted_block_with_action_digests_channel.has_subscribers() )
+         return;
+      my->accepted_block_with_action_digests_connection = my->chain->accepted_block_with_action_digests.connect( [this]( const block_state_with_action_digests_ptr& blk ) {
+         my->accepted_block_with_action_digests_channel.publish( blk );
+      } );
+   } );
+
    if (my->exit_after_init_chain) {
       wlog("Exit after initialize new blockchain with genesis state");
       app().get_io_service().stop();
@@ -740,12 +959,23 @@ void chain_plugin::plugin_shutdown() {
    my->accepted_transaction_connection.reset();
    my->applied_transaction_connection.reset();
    my->accepted_confirmation_connection.reset();
+   if( my->dry_run_pool ) {
+      my->dry_run_pool->stop();
+      my->dry_run_pool->join();
+   }
+   my->stop_following = true;
+   if( my->read_replica_follower.joinable() )
+      my->read_replica_follower.join();
    my->chain.reset();
 }
 
-chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time)
+chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, chain::abi_serializer_cache* abi_cache,
+                                   boost::asio::thread_pool* dry_run_pool, const fc::microseconds& dry_run_max_time)
 : db(db)
 , abi_serializer_max_time(abi_serializer_max_time)
+, abi_cache(abi_cache)
+, dry_run_pool(dry_run_pool)
+, dry_run_max_time(dry_run_max_time)
 {
 }
 
@@ -754,7 +984,8 @@ void chain_apis::read_write::validate() const {
 }
 
 chain_apis::read_write chain_plugin::get_read_write_api() {
-   return chain_apis::read_write(chain(), get_abi_serializer_max_time());
+   return chain_apis::read_write(chain(), get_abi_serializer_max_time(), &get_abi_serializer_cache(),
+                                 my->dry_run_pool ? &*my->dry_run_pool : nullptr, my->dry_run_max_time);
 }
 
 void chain_plugin::accept_block(const signed_block_ptr& block ) {
@@ -973,6 +1204,24 @@ bool chain_plugin::export_reversible_blocks( const fc::path& reversible_dir,
 controller& chain_plugin::chain() { return *my->chain; }
 const controller& chain_plugin::chain() const { return *my->chain; }
 
+bool chain_plugin::starts_fresh()const {
+   return !my->snapshot_reader && my->chain_config->read_replica_of.empty() && !my->chain->fork_db().head() &&
+          !fc::exists( my->blocks_dir / "blocks.log" );
+}
+
+void chain_plugin::set_startup_snapshot( const fc::path& snapshot ) {
+   EOS_ASSERT( starts_fresh(), plugin_config_exception, "Snapshot can only be used to initialize an empty database." );
+   my->open_snapshot( snapshot );
+   genesis_state genesis;
+   my->snapshot_reader->read_section<genesis_state>([&genesis]( auto &section ){
+      section.read_row(genesis);
+   });
+   EOS_ASSERT( genesis.compute_chain_id() == *my->chain_id, plugin_config_exception,
+               "snapshot ${f} is of chain ${c}, not ${id}",
+               ("f", snapshot.generic_string())("c", genesis.compute_chain_id())("id", *my->chain_id) );
+   ilog( "chain starts from snapshot ${f}", ("f", snapshot.generic_string()) );
+}
+
 chain::chain_id_type chain_plugin::get_chain_id()const {
    EOS_ASSERT( my->chain_id.valid(), chain_id_type_exception, "chain ID has not been initialized yet" );
    return *my->chain_id;
@@ -982,6 +1231,14 @@ fc::microseconds chain_plugin::get_abi_serializer_max_time() const {
    return my->abi_serializer_max_time_ms;
 }
 
+chain::abi_serializer_cache& chain_plugin::get_abi_serializer_cache() const {
+   return my->abi_cache;
+}
+
+chain_apis::block_response_cache* chain_plugin::get_block_response_cache() const {
+   return my->block_cache.get();
+}
+
 void chain_plugin::log_guard_exception(const chain::guard_exception&e ) const {
    if (e.code() == chain::database_guard_exception::code_value) {
       elog("Database has reached an unsafe level of usage, shutting down to avoid corrupting the database.  "
@@ -1077,6 +1334,23 @@ uint64_t read_only::get_table_index_name(const read_only::get_table_rows_params&
    return index;
 }
 
+string read_only::encode_cursor( const table_rows_cursor& c ) {
+   auto packed = fc::raw::pack( c );
+   return fc::to_hex( packed.data(), packed.size() );
+}
+
+read_only::table_rows_cursor read_only::decode_cursor( const string& continuation, uint64_t table_id ) {
+   table_rows_cursor c;
+   try {
+      vector<char> packed( continuation.size() / 2 );
+      EOS_ASSERT( continuation.size() % 2 == 0 && fc::from_hex( continuation, packed.data(), packed.size() ) == packed.size(),
+                  chain::contract_table_query_exception, "continuation is not hex" );
+      c = fc::raw::unpack<table_rows_cursor>( packed );
+   } EOS_RETHROW_EXCEPTIONS( chain::contract_table_query_exception, "Invalid continuation: ${c}", ("c", continuation) )
+   EOS_ASSERT( c.table_id == table_id, chain::contract_table_query_exception, "continuation belongs to another table or index" );
+   return c;
+}
+
 template<>
 uint64_t convert_to_type(const string& str, const string& desc) {
    uint64_t value = 0;
@@ -1125,46 +1399,50 @@ string get_table_type( const abi_def& abi, const name& table_name ) {
 }
 
 read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-
+   EOS_ASSERT( !p.count_only || !p.keys_only, chain::contract_table_query_exception, "count_only and keys_only are exclusive" );
    bool primary = false;
    auto table_with_index = get_table_index_name( p, primary );
    if( primary ) {
       EOS_ASSERT( p.table == table_with_index, chain::contract_table_query_exception, "Invalid table name ${t}", ( "t", p.table ));
+      // raw rows, keys and counts skip the ABI entirely, the only primary index type there is is i64
+      if( !decodes_rows( p ) ) {
+         return get_table_rows_ex<key_value_index>(p);
+      }
+      const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
       auto table_type = get_table_type( abi, p.table );
       if( table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name" ) {
-         return get_table_rows_ex<key_value_index>(p,abi);
+         return get_table_rows_ex<key_value_index>(p);
       }
       EOS_ASSERT( false, chain::contract_table_query_exception,  "Invalid table type ${type}", ("type",table_type)("abi",abi));
    } else {
       EOS_ASSERT( !p.key_type.empty(), chain::contract_table_query_exception, "key type required for non-primary index" );
 
       if (p.key_type == chain_apis::i64 || p.key_type == "name") {
-         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abi, [](uint64_t v)->uint64_t {
+         return get_table_rows_by_seckey<index64_index, uint64_t>(p, [](uint64_t v)->uint64_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i128) {
-         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abi, [](uint128_t v)->uint128_t {
+         return get_table_rows_by_seckey<index128_index, uint128_t>(p, [](uint128_t v)->uint128_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i256) {
          if ( p.encode_type == chain_apis::hex) {
             using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function());
          }
          using  conv = keytype_converter<chain_apis::i256>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function());
       }
       else if (p.key_type == chain_apis::float64) {
-         return get_table_rows_by_seckey<index_double_index, double>(p, abi, [](double v)->float64_t {
+         return get_table_rows_by_seckey<index_double_index, double>(p, [](double v)->float64_t {
             float64_t f = *(float64_t *)&v;
             return f;
          });
       }
       else if (p.key_type == chain_apis::float128) {
-         return get_table_rows_by_seckey<index_long_double_index, double>(p, abi, [](double v)->float128_t{
+         return get_table_rows_by_seckey<index_long_double_index, double>(p, [](double v)->float128_t{
             float64_t f = *(float64_t *)&v;
             float128_t f128;
             f64_to_f128M(f, &f128);
@@ -1173,11 +1451,11 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       }
       else if (p.key_type == chain_apis::sha256) {
          using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function());
       }
       else if(p.key_type == chain_apis::ripemd160) {
          using  conv = keytype_converter<chain_apis::ripemd160,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function());
       }
       EOS_ASSERT(false, chain::contract_table_query_exception,  "Unsupported secondary index type: ${t}", ("t", p.key_type));
    }
@@ -1301,7 +1579,9 @@ fc::variant get_global_row( const database& db, const abi_def& abi, const abi_se
 read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const {
    const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{ abi, abi_serializer_max_time };
+   const auto abis_ptr = get_abi_serializer( config::system_account_name );
+   EOS_ASSERT( abis_ptr, chain::abi_not_found_exception, "No ABI found for ${contract}", ("contract", config::system_account_name) );
+   const auto& abis = *abis_ptr;
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type",table_type));
 
    const auto& d = db.db();
@@ -1363,20 +1643,35 @@ read_only::get_producer_schedule_result read_only::get_producer_schedule( const
 template<typename Api>
 struct resolver_factory {
    static auto make(const Api* api, const fc::microseconds& max_serialization_time) {
-      return [api, max_serialization_time](const account_name &name) -> optional<abi_serializer> {
-         const auto* accnt = api->db.db().template find<account_object, by_name>(name);
-         if (accnt != nullptr) {
-            abi_def abi;
-            if (abi_serializer::to_abi(accnt->abi, abi)) {
-               return abi_serializer(abi, max_serialization_time);
-            }
-         }
-
-         return optional<abi_serializer>();
+      return [api](const account_name &name) -> std::shared_ptr<const abi_serializer> {
+         return api->get_abi_serializer(name);
       };
    }
 };
 
+static std::shared_ptr<const abi_serializer> get_abi_serializer( const controller& db, chain::abi_serializer_cache* abi_cache,
+                                                                 account_name account, const fc::microseconds& max_serialization_time ) {
+   if( abi_cache )
+      return abi_cache->get( db.db(), account, max_serialization_time );
+
+   const auto* accnt = db.db().find<account_object, by_name>(account);
+   if (accnt != nullptr) {
+      abi_def abi;
+      if (abi_serializer::to_abi(accnt->abi, abi)) {
+         return std::make_shared<const abi_serializer>(abi, max_serialization_time);
+      }
+   }
+   return nullptr;
+}
+
+std::shared_ptr<const abi_serializer> read_only::get_abi_serializer( account_name account )const {
+   return chain_apis::get_abi_serializer( db, abi_cache, account, abi_serializer_max_time );
+}
+
+std::shared_ptr<const abi_serializer> read_write::get_abi_serializer( account_name account )const {
+   return chain_apis::get_abi_serializer( db, abi_cache, account, abi_serializer_max_time );
+}
+
 template<typename Api>
 auto make_resolver(const Api* api, const fc::microseconds& max_serialization_time) {
    return resolver_factory<Api>::make(api, max_serialization_time);
@@ -1434,13 +1729,15 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
          fc::variant pretty_transaction;
 
          transaction trx;
-         fc::datastream<const char*> ds( itr->packed_trx.data(), itr->packed_trx.size() );
+         const auto& packed_trx = itr->packed_trx( d );
+         fc::datastream<const char*> ds( packed_trx.data(), packed_trx.size() );
          fc::raw::unpack(ds,trx);
 
          abi_serializer::to_variant(trx, pretty_transaction, resolver, abi_serializer_max_time);
          row("transaction", pretty_transaction);
       } else {
-         auto packed_transaction = bytes(itr->packed_trx.begin(), itr->packed_trx.end());
+         const auto& packed_trx = itr->packed_trx( d );
+         auto packed_transaction = bytes(packed_trx.begin(), packed_trx.end());
          row("transaction", packed_transaction);
       }
 
@@ -1459,6 +1756,21 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
 fc::variant read_only::get_block(const read_only::get_block_params& params) const {
    signed_block_ptr block;
    EOS_ASSERT(!params.block_num_or_id.empty() && params.block_num_or_id.size() <= 64, chain::block_id_type_exception, "Invalid Block number or ID, must be greater than 0 and less than 64 characters" );
+   if( block_cache ) {
+      block_response_cache::response_ptr cached;
+      try {
+         if( params.block_num_or_id.size() == 64 ) {
+            auto id = fc::variant(params.block_num_or_id).as<block_id_type>();
+            cached = block_cache->find( block_header::num_from_id(id), id );
+         } else {
+            auto num = fc::to_uint64(params.block_num_or_id);
+            if( num <= std::numeric_limits<uint32_t>::max() )
+               cached = block_cache->find( num );
+         }
+      } catch( ... ) {} // left to the uncached path to report
+      if( cached )
+         return *cached;
+   }
    try {
       block = db.fetch_block_by_id(fc::variant(params.block_num_or_id).as<block_id_type>());
       if (!block) {
@@ -1474,10 +1786,13 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
 
    uint32_t ref_block_prefix = block->id()._hash[1];
 
-   return fc::mutable_variant_object(pretty_output.get_object())
+   fc::variant result = fc::mutable_variant_object(pretty_output.get_object())
            ("id", block->id())
            ("block_num",block->block_num())
            ("ref_block_prefix", ref_block_prefix);
+   if( block_cache && block->block_num() <= db.last_irreversible_block_num() )
+      block_cache->insert( block->block_num(), block->id(), std::make_shared<fc::variant>( result ) );
+   return result;
 }
 
 fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
@@ -1547,36 +1862,105 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
    } CATCH_AND_CALL(next);
 }
 
-static void push_recurse(read_write* rw, int index, const std::shared_ptr<read_write::push_transactions_params>& params, const std::shared_ptr<read_write::push_transactions_results>& results, const next_function<read_write::push_transactions_results>& next) {
-   auto wrapped_next = [=](const fc::static_variant<fc::exception_ptr, read_write::push_transaction_results>& result) {
-      if (result.contains<fc::exception_ptr>()) {
-         const auto& e = result.get<fc::exception_ptr>();
-         results->emplace_back( read_write::push_transaction_results{ transaction_id_type(), fc::mutable_variant_object( "error", e->to_detail_string() ) } );
-      } else {
-         const auto& r = result.get<read_write::push_transaction_results>();
-         results->emplace_back( r );
-      }
+static read_write::push_transaction_results push_transaction_error( const fc::exception& e ) {
+   return read_write::push_transaction_results{ transaction_id_type(), fc::mutable_variant_object( "error", e.to_detail_string() ) };
+}
 
-      int next_index = index + 1;
-      if (next_index < params->size()) {
-         push_recurse(rw, next_index, params, results, next );
-      } else {
+void read_write::push_transactions(const read_write::push_transactions_params& params, next_function<read_write::push_transactions_results> next) {
+   try {
+      EOS_ASSERT( params.size() <= 1000, too_many_tx_at_once, "Attempt to push too many transactions at once" );
+      auto results = std::make_shared<read_write::push_transactions_results>(params.size());
+      auto resolver = make_resolver(this, abi_serializer_max_time);
+
+      // the transactions that parse are handed over together, so that their keys are recovered in parallel
+      vector<packed_transaction_ptr> trxs;
+      auto positions = std::make_shared<vector<size_t>>();
+      for( size_t i = 0; i < params.size(); ++i ) {
+         try {
+            auto trx = std::make_shared<packed_transaction>();
+            try {
+               abi_serializer::from_variant(params[i], *trx, resolver, abi_serializer_max_time);
+            } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+            trxs.emplace_back( std::move(trx) );
+            positions->push_back( i );
+         } catch( const fc::exception& e ) {
+            (*results)[i] = push_transaction_error( e );
+         }
+      }
+      if( trxs.empty() ) {
          next(*results);
+         return;
       }
-   };
 
-   rw->push_transaction(params->at(index), wrapped_next);
+      app().get_method<incoming::methods::transaction_batch_async>()(trxs, true, [this, results, positions, next](const transaction_batch_results& batch) {
+         try {
+            for( size_t j = 0; j < batch.size(); ++j ) {
+               auto& out = (*results)[(*positions)[j]];
+               if( batch[j].contains<fc::exception_ptr>() ) {
+                  out = push_transaction_error( *batch[j].get<fc::exception_ptr>() );
+                  continue;
+               }
+               const auto& trx_trace_ptr = batch[j].get<transaction_trace_ptr>();
+               fc::variant output;
+               try {
+                  output = db.to_variant_with_abi( *trx_trace_ptr, abi_serializer_max_time );
+               } catch( chain::abi_exception& ) {
+                  output = *trx_trace_ptr;
+               }
+               out = read_write::push_transaction_results{ trx_trace_ptr->id, output };
+            }
+            next(*results);
+         } CATCH_AND_CALL(next);
+      });
+
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } CATCH_AND_CALL(next);
 }
 
-void read_write::push_transactions(const read_write::push_transactions_params& params, next_function<read_write::push_transactions_results> next) {
+void read_write::dry_run_transaction(const read_write::dry_run_transaction_params& params, next_function<read_write::dry_run_transaction_results> next) {
    try {
-      EOS_ASSERT( params.size() <= 1000, too_many_tx_at_once, "Attempt to push too many transactions at once" );
-      auto params_copy = std::make_shared<read_write::push_transactions_params>(params.begin(), params.end());
-      auto result = std::make_shared<read_write::push_transactions_results>();
-      result->reserve(params.size());
+      packed_transaction input;
+      auto resolver = make_resolver(this, abi_serializer_max_time);
+      try {
+         abi_serializer::from_variant(params, input, resolver, abi_serializer_max_time);
+      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+      auto mtrx = std::make_shared<transaction_metadata>(input);
 
-      push_recurse(this, 0, params_copy, result, next);
+      auto execute = [this, mtrx, next]() {
+         try {
+            auto trace = db.dry_run_transaction(mtrx, fc::time_point::now() + dry_run_max_time);
+            if( trace->except )
+               trace->except->dynamic_rethrow_exception();
 
+            fc::variant output;
+            try {
+               output = db.to_variant_with_abi( *trace, abi_serializer_max_time );
+            } catch( chain::abi_exception& ) {
+               output = *trace;
+            }
+            next(read_write::dry_run_transaction_results{trace->id, output, trace->receipt->cpu_usage_us, trace->net_usage});
+         } catch ( boost::interprocess::bad_alloc& ) {
+            chain_plugin::handle_db_exhaustion();
+         } CATCH_AND_CALL(next);
+      };
+
+      if( !dry_run_pool ) {
+         execute();
+         return;
+      }
+      // only the key recovery can leave the application thread, the state the transaction runs against cannot
+      auto chain_id = db.get_chain_id();
+      boost::asio::post( *dry_run_pool, [mtrx, chain_id, execute]() {
+         try {
+            mtrx->recover_keys( chain_id );
+         } catch( ... ) {
+            // redone, and reported, when the transaction is executed
+         }
+         plugin_interface::app_post( plugin_interface::priority::low, execute );
+      });
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
    } CATCH_AND_CALL(next);
 }
 
@@ -1701,11 +2085,8 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       ++perm;
    }
 
-   const auto& code_account = db.db().get<account_object,by_name>( config::system_account_name );
-
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   if( const auto abis_ptr = get_abi_serializer( config::system_account_name ) ) {
+      const auto& abis = *abis_ptr;
 
       const auto token_code = N(eosio.token);
 
@@ -1789,16 +2170,15 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
    const auto code_account = db.db().find<account_object,by_name>( params.code );
    EOS_ASSERT(code_account != nullptr, contract_query_exception, "Contract can't be found ${contract}", ("contract", params.code));
 
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account->abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
-      auto action_type = abis.get_action_type(params.action);
+   if( const auto abis = get_abi_serializer( params.code ) ) {
+      auto action_type = abis->get_action_type(params.action);
       EOS_ASSERT(!action_type.empty(), action_validate_exception, "Unknown action ${action} in contract ${contract}", ("action", params.action)("contract", params.code));
       try {
-         result.binargs = abis.variant_to_binary( action_type, params.args, abi_serializer_max_time, shorten_abi_errors );
+         result.binargs = abis->variant_to_binary( action_type, params.args, abi_serializer_max_time, shorten_abi_errors );
       } EOS_RETHROW_EXCEPTIONS(chain::invalid_action_args_exception,
                                 "'${args}' is invalid args for action '${action}' code '${code}'. expected '${proto}'",
-                                ("args", params.args)("action", params.action)("code", params.code)("proto", action_abi_to_variant(abi, action_type)))
+                                ("args", params.args)("action", params.action)("code", params.code)
+                                ("proto", action_abi_to_variant(eosio::chain_apis::get_abi(db, params.code), action_type)))
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
    }
@@ -1808,11 +2188,9 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
 
 read_only::abi_bin_to_json_result read_only::abi_bin_to_json( const read_only::abi_bin_to_json_params& params )const {
    abi_bin_to_json_result result;
-   const auto& code_account = db.db().get<account_object,by_name>( params.code );
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
-      result.args = abis.binary_to_variant( abis.get_action_type( params.action ), params.binargs, abi_serializer_max_time, shorten_abi_errors );
+   db.db().get<account_object,by_name>( params.code );
+   if( const auto abis = get_abi_serializer( params.code ) ) {
+      result.args = abis->binary_to_variant( abis->get_action_type( params.action ), params.binargs, abi_serializer_max_time, shorten_abi_errors );
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
    }
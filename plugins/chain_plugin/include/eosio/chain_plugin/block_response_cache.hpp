@@ -0,0 +1,74 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <fc/variant.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace eosio { namespace chain_apis {
+
+   /**
+    *  get_block results of irreversible blocks, which never change once rendered.
+    *
+    *  Holds up to max_entries blocks and forgets the least recently requested one beyond that. The cache may be
+    *  used from several threads.
+    */
+   class block_response_cache {
+      public:
+         typedef std::shared_ptr<const fc::variant> response_ptr;
+
+         explicit block_response_cache( size_t max_entries ) : max_entries( max_entries ) {}
+
+         /// nullptr unless block_num is cached and, if id is not empty, was cached for that id
+         response_ptr find( uint32_t block_num, const chain::block_id_type& id = chain::block_id_type() ) {
+            std::lock_guard<std::mutex> g( mtx );
+            auto itr = entries.find( block_num );
+            if( itr == entries.end() || ( id != chain::block_id_type() && itr->second.id != id ) )
+               return response_ptr();
+            lru.splice( lru.begin(), lru, itr->second.lru_pos );
+            return itr->second.response;
+         }
+
+         void insert( uint32_t block_num, const chain::block_id_type& id, response_ptr response ) {
+            std::lock_guard<std::mutex> g( mtx );
+            auto itr = entries.find( block_num );
+            if( itr != entries.end() ) {
+               itr->second.id = id;
+               itr->second.response = std::move( response );
+               lru.splice( lru.begin(), lru, itr->second.lru_pos );
+               return;
+            }
+            lru.push_front( block_num );
+            entries.emplace( block_num, entry{ id, std::move( response ), lru.begin() } );
+            while( entries.size() > max_entries ) {
+               entries.erase( lru.back() );
+               lru.pop_back();
+            }
+         }
+
+         size_t size()const {
+            std::lock_guard<std::mutex> g( mtx );
+            return entries.size();
+         }
+
+      private:
+         struct entry {
+            chain::block_id_type           id;
+            response_ptr                   response;
+            std::list<uint32_t>::iterator  lru_pos;
+         };
+
+         mutable std::mutex           mtx;
+         std::map<uint32_t, entry>    entries;
+         std::list<uint32_t>          lru; ///< most recently used first
+         const size_t                 max_entries;
+   };
+
+} } /// eosio::chain_apis
@@ -13,15 +13,19 @@
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/types.hpp>
+#include <eosio/chain_plugin/block_response_cache.hpp>
 
 #include <boost/container/flat_set.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <fc/static_variant.hpp>
+#include <fc/crypto/hex.hpp>
 
 namespace fc { class variant; }
+namespace boost { namespace asio { class thread_pool; } }
 
 namespace eosio {
    using chain::controller;
@@ -69,13 +73,16 @@ uint64_t convert_to_type(const string& str, const string& desc);
 class read_only {
    const controller& db;
    const fc::microseconds abi_serializer_max_time;
+   chain::abi_serializer_cache* abi_cache = nullptr;
+   block_response_cache* block_cache = nullptr;
    bool  shorten_abi_errors = true;
 
 public:
    static const string KEYi64;
 
-   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time)
-      : db(db), abi_serializer_max_time(abi_serializer_max_time) {}
+   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, chain::abi_serializer_cache* abi_cache = nullptr,
+             block_response_cache* block_cache = nullptr)
+      : db(db), abi_serializer_max_time(abi_serializer_max_time), abi_cache(abi_cache), block_cache(block_cache) {}
 
    void validate() const {}
 
@@ -269,11 +276,16 @@ public:
       string      key_type;  // type of key specified by index_position
       string      index_position; // 1 - primary (first), 2 - secondary index (in order defined by multi_index), 3 - third index, etc
       string      encode_type{"dec"}; //dec, hex , default=dec
+      string      continuation; ///< continuation of a previous result for the same query, resumes where it stopped instead of at lower_bound
+      bool        count_only = false; ///< only count the rows in range, limit does not apply
+      bool        keys_only = false;  ///< rows hold the keys of each row instead of its value
     };
 
    struct get_table_rows_result {
       vector<fc::variant> rows; ///< one row per item, either encoded as hex String or JSON object
       bool                more = false; ///< true if last element in data is not the end and sizeof data() < limit
+      string              continuation; ///< set when more is true, pass it back to fetch the following rows
+      uint32_t            count = 0; ///< rows walked, for count_only the number of rows in range when more is false
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
@@ -385,15 +397,38 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
+   /// position of the next row of a get_table_rows walk, handed out hex encoded as its continuation
+   struct table_rows_cursor {
+      uint64_t      table_id = 0;  ///< id of the table_id_object of the index walked
+      vector<char>  secondary;     ///< raw secondary key, empty for the primary index
+      uint64_t      primary = 0;
+   };
+
+   static string encode_cursor( const table_rows_cursor& c );
+   /// throws unless continuation is a cursor of table_id
+   static table_rows_cursor decode_cursor( const string& continuation, uint64_t table_id );
+
+   /// serializer for the ABI of the account, from the shared cache when there is one
+   std::shared_ptr<const abi_serializer> get_abi_serializer( account_name account )const;
+
+   /// whether rows need their values decoded through the ABI of the contract
+   static bool decodes_rows( const get_table_rows_params& p ) { return p.json && !p.count_only && !p.keys_only; }
+
+   /// keys_only rendering of secondary keys, 64 bit keys as numbers and wider ones as the hex of their bytes
+   static fc::variant secondary_key_to_variant( uint64_t k ) { return fc::variant( k ); }
+   template<typename K>
+   static fc::variant secondary_key_to_variant( const K& k ) { return fc::variant( fc::to_hex( (const char*)&k, sizeof(k) ) ); }
+
    template <typename IndexType, typename SecKeyType, typename ConvFn>
-   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
+   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, ConvFn conv )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
+      // rows are only decoded for json, raw rows, keys and counts need no ABI
+      const auto abis = decodes_rows( p ) ? get_abi_serializer( p.code ) : nullptr;
+      EOS_ASSERT( abis || !decodes_rows( p ), chain::abi_not_found_exception, "No ABI found for ${contract}", ("contract", p.code) );
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -425,6 +460,15 @@ public:
                upper = secidx.lower_bound( boost::make_tuple( low_tid, conv( uv )));
             }
          }
+         using secondary_key_type = typename IndexType::value_type::secondary_key_type;
+         if (p.continuation.size()) {
+            auto c = decode_cursor( p.continuation, index_t_id->id._id );
+            EOS_ASSERT( c.secondary.size() == sizeof(secondary_key_type), chain::contract_table_query_exception,
+                        "continuation is not for a ${k} index", ("k", p.key_type) );
+            secondary_key_type sk;
+            memcpy( &sk, c.secondary.data(), sizeof(sk) );
+            lower = secidx.lower_bound( boost::make_tuple( low_tid, sk, c.primary ));
+         }
 
          vector<char> data;
 
@@ -433,37 +477,48 @@ public:
          unsigned int count = 0;
          auto itr = lower;
          for (; itr != upper; ++itr) {
-
-            const auto* itr2 = d.find<chain::key_value_object, chain::by_scope_primary>(boost::make_tuple(t_id->id, itr->primary_key));
-            if (itr2 == nullptr) continue;
-            copy_inline_row(*itr2, data);
-
-            if (p.json) {
-               result.rows.emplace_back( abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors ) );
-            } else {
-               result.rows.emplace_back(fc::variant(data));
+            // counts and keys come from the secondary index alone
+            if (p.keys_only) {
+               result.rows.emplace_back( fc::mutable_variant_object()("primary_key", itr->primary_key)
+                                                                     ("secondary_key", secondary_key_to_variant(itr->secondary_key)) );
+            } else if (!p.count_only) {
+               const auto* itr2 = d.find<chain::key_value_object, chain::by_scope_primary>(boost::make_tuple(t_id->id, itr->primary_key));
+               if (itr2 == nullptr) continue;
+               copy_inline_row(*itr2, data);
+
+               if (p.json) {
+                  result.rows.emplace_back( abis->binary_to_variant( abis->get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors ) );
+               } else {
+                  result.rows.emplace_back(fc::variant(data));
+               }
             }
+            ++result.count;
 
-            if (++count == p.limit || fc::time_point::now() > end) {
+            if ((!p.count_only && ++count == p.limit) || fc::time_point::now() > end) {
+               ++itr;
                break;
             }
          }
          if (itr != upper) {
             result.more = true;
+            table_rows_cursor c{ index_t_id->id._id, vector<char>( sizeof(secondary_key_type) ), itr->primary_key };
+            memcpy( c.secondary.data(), &itr->secondary_key, sizeof(secondary_key_type) );
+            result.continuation = encode_cursor( c );
          }
       }
       return result;
    }
 
    template <typename IndexType>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_def& abi )const {
+   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
+      // rows are only decoded for json, raw rows, keys and counts need no ABI
+      const auto abis = decodes_rows( p ) ? get_abi_serializer( p.code ) : nullptr;
+      EOS_ASSERT( abis || !decodes_rows( p ), chain::abi_not_found_exception, "No ABI found for ${contract}", ("contract", p.code) );
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
       if (t_id != nullptr) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -489,6 +544,11 @@ public:
                upper = idx.lower_bound( boost::make_tuple( t_id->id, uv ));
             }
          }
+         if (p.continuation.size()) {
+            auto c = decode_cursor( p.continuation, t_id->id._id );
+            EOS_ASSERT( c.secondary.empty(), chain::contract_table_query_exception, "continuation is not for the primary index" );
+            lower = idx.lower_bound( boost::make_tuple( t_id->id, c.primary ));
+         }
 
          vector<char> data;
 
@@ -497,21 +557,27 @@ public:
          unsigned int count = 0;
          auto itr = lower;
          for (; itr != upper; ++itr) {
-            copy_inline_row(*itr, data);
-
-            if (p.json) {
-               result.rows.emplace_back( abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors ) );
-            } else {
-               result.rows.emplace_back(fc::variant(data));
+            if (p.keys_only) {
+               result.rows.emplace_back( fc::mutable_variant_object()("primary_key", itr->primary_key) );
+            } else if (!p.count_only) {
+               copy_inline_row(*itr, data);
+
+               if (p.json) {
+                  result.rows.emplace_back( abis->binary_to_variant( abis->get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors ) );
+               } else {
+                  result.rows.emplace_back(fc::variant(data));
+               }
             }
+            ++result.count;
 
-            if (++count == p.limit || fc::time_point::now() > end) {
+            if ((!p.count_only && ++count == p.limit) || fc::time_point::now() > end) {
                ++itr;
                break;
             }
          }
          if (itr != upper) {
             result.more = true;
+            result.continuation = encode_cursor( table_rows_cursor{ t_id->id._id, {}, itr->primary_key } );
          }
       }
       return result;
@@ -525,8 +591,14 @@ public:
 class read_write {
    controller& db;
    const fc::microseconds abi_serializer_max_time;
+   chain::abi_serializer_cache* abi_cache = nullptr;
+   boost::asio::thread_pool* dry_run_pool = nullptr;
+   fc::microseconds dry_run_max_time;
+
+   std::shared_ptr<const abi_serializer> get_abi_serializer( account_name account )const;
 public:
-   read_write(controller& db, const fc::microseconds& abi_serializer_max_time);
+   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, chain::abi_serializer_cache* abi_cache = nullptr,
+              boost::asio::thread_pool* dry_run_pool = nullptr, const fc::microseconds& dry_run_max_time = fc::milliseconds(30));
    void validate() const;
 
    using push_block_params = chain::signed_block;
@@ -545,6 +617,19 @@ public:
    using push_transactions_results = vector<push_transaction_results>;
    void push_transactions(const push_transactions_params& params, chain::plugin_interface::next_function<push_transactions_results> next);
 
+   /**
+    * Executes a transaction against the current state without keeping any of its effects, so that wallets can learn
+    * what it would do and cost. Its signing keys are recovered on a worker thread.
+    */
+   using dry_run_transaction_params = push_transaction_params;
+   struct dry_run_transaction_results {
+      chain::transaction_id_type  transaction_id;
+      fc::variant                 processed;
+      uint32_t                    cpu_usage_us = 0;
+      uint64_t                    net_usage = 0;  ///< bytes, as billed
+   };
+   void dry_run_transaction(const dry_run_transaction_params& params, chain::plugin_interface::next_function<dry_run_transaction_results> next);
+
    friend resolver_factory<read_write>;
 };
 
@@ -621,7 +706,9 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
-   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time()); }
+   chain_apis::read_only get_read_only_api() const {
+      return chain_apis::read_only(chain(), get_abi_serializer_max_time(), &get_abi_serializer_cache(), get_block_response_cache());
+   }
    chain_apis::read_write get_read_write_api();
 
    void accept_block( const chain::signed_block_ptr& block );
@@ -650,8 +737,21 @@ public:
    const controller& chain() const;
 
    chain::chain_id_type get_chain_id() const;
+
+   /// true until plugin_startup if the chain has no state and no blocks, so it would start from genesis
+   bool starts_fresh() const;
+   /**
+    *  starts the chain from a snapshot, as --snapshot does, in place of genesis; only until plugin_startup and while
+    *  starts_fresh(). The genesis of the snapshot must be that of the chain configured
+    */
+   void set_startup_snapshot( const fc::path& snapshot );
    fc::microseconds get_abi_serializer_max_time() const;
 
+   /// serializers for the ABIs of accounts shared by the APIs of this and other plugins
+   chain::abi_serializer_cache& get_abi_serializer_cache() const;
+   /// nullptr unless get-block-cache-size is set
+   chain_apis::block_response_cache* get_block_response_cache() const;
+
    void handle_guard_exception(const chain::guard_exception& e) const;
 
    static void handle_db_exhaustion();
@@ -671,9 +771,11 @@ FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id))
 FC_REFLECT(eosio::chain_apis::read_only::get_block_header_state_params, (block_num_or_id))
 
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
+FC_REFLECT( eosio::chain_apis::read_write::dry_run_transaction_results, (transaction_id)(processed)(cpu_usage_us)(net_usage) )
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type) )
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(continuation)(count_only)(keys_only) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(continuation)(count) );
+FC_REFLECT( eosio::chain_apis::read_only::table_rows_cursor, (table_id)(secondary)(primary) )
 
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result_row, (code)(scope)(table)(payer)(count));
@@ -5,6 +5,23 @@
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
 #include <eosio/db_size_api_plugin/db_size_api_plugin.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/block_summary_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/core_symbol_object.hpp>
+#include <eosio/chain/database_utils.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <eosio/chain/transaction_object.hpp>
+
+#include <boost/core/demangle.hpp>
+#include <boost/mpl/size.hpp>
+
+#include <algorithm>
+#include <map>
 
 namespace eosio {
 
@@ -24,33 +41,165 @@ using namespace eosio;
           } \
        }}
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle->call_name();
 
+namespace {
+   using namespace eosio::chain;
+
+   /// the indices the chain keeps in the state database
+   using state_index_set = index_set<
+      account_index,
+      account_sequence_index,
+      global_property_multi_index,
+      dynamic_global_property_multi_index,
+      core_symbol_multi_index,
+      block_summary_multi_index,
+      transaction_multi_index,
+      generated_transaction_multi_index,
+      generated_transaction_payload_index,
+      table_id_multi_index,
+      key_value_index,
+      index64_index,
+      index128_index,
+      index256_index,
+      index_double_index,
+      index_long_double_index,
+      permission_index,
+      permission_usage_index,
+      permission_link_index,
+      resource_limits::resource_limits_index,
+      resource_limits::resource_usage_index,
+      resource_limits::resource_limits_state_index,
+      resource_limits::resource_limits_config_index
+   >;
+
+   /**
+    * The size of a row of each index by the name chainbase gives it: the object and, for each of its ordered
+    * indices, a node of three offset pointers
+    */
+   std::map<string, uint64_t> state_row_sizes() {
+      std::map<string, uint64_t> sizes;
+      state_index_set::walk_indices( [&sizes]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         using value_t = typename index_t::value_type;
+         constexpr uint64_t node_size = 3 * sizeof(boost::interprocess::offset_ptr<void>);
+         sizes[boost::core::demangle( typeid(value_t).name() )] =
+            sizeof(value_t) + boost::mpl::size<typename index_t::index_type_list>::value * node_size;
+      });
+      return sizes;
+   }
+
+   using secondary_index_set = index_set<
+      index64_index,
+      index128_index,
+      index256_index,
+      index_double_index,
+      index_long_double_index
+   >;
+
+   /// the billable size of the rows of a table, as apply_context charges them to their payers, summed over its rows
+   uint64_t table_bytes( const chainbase::database& db, table_id t_id ) {
+      uint64_t bytes = 0;
+      const auto& rows = db.get_index<key_value_index, by_scope_primary>();
+      for( auto itr = rows.lower_bound( boost::make_tuple( t_id ) ); itr != rows.end() && itr->t_id == t_id; ++itr )
+         bytes += itr->value.size() + config::billable_size_v<key_value_object>;
+
+      secondary_index_set::walk_indices( [&db, &bytes, t_id]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         const auto& idx = db.get_index<index_t, by_primary>();
+         for( auto itr = idx.lower_bound( boost::make_tuple( t_id ) ); itr != idx.end() && itr->t_id == t_id; ++itr )
+            bytes += config::billable_size_v<typename index_t::value_type>;
+      });
+      return bytes;
+   }
+
+   /// the largest block the segment can still allocate at once, found by allocating and freeing blocks of halving sizes
+   uint64_t largest_free_block( chainbase::database& db ) {
+      auto* segment = db.get_segment_manager();
+      uint64_t lo = 0, hi = segment->get_free_memory();
+      while( lo < hi ) {
+         uint64_t mid = lo + (hi - lo + 1) / 2;
+         void* p = segment->allocate( mid, std::nothrow );
+         if( p ) {
+            segment->deallocate( p );
+            lo = mid;
+         } else {
+            hi = mid - 1;
+         }
+      }
+      return lo;
+   }
+}
+
 
 void db_size_api_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
        CALL(db_size, this, get,
             INVOKE_R_V(this, get), 200),
+       CALL(db_size, this, get_tables,
+            INVOKE_R_R(this, get_tables, db_size_tables_params), 200),
    });
 }
 
 db_size_stats db_size_api_plugin::get() {
-   const chainbase::database& db = app().get_plugin<chain_plugin>().chain().db();
+   // only the probe for the largest free block allocates, and frees right away
+   chainbase::database& db = const_cast<chainbase::database&>( app().get_plugin<chain_plugin>().chain().db() );
    db_size_stats ret;
 
    ret.free_bytes = db.get_segment_manager()->get_free_memory();
    ret.size = db.get_segment_manager()->get_size();
    ret.used_bytes = ret.size - ret.free_bytes;
+   ret.largest_free_block = largest_free_block(db);
+   if( ret.free_bytes )
+      ret.fragmentation = 1.0 - double(ret.largest_free_block) / ret.free_bytes;
 
+   static const auto row_sizes = state_row_sizes();
    chainbase::database::database_index_row_count_multiset indices = db.row_count_per_index();
-   for(const auto& i : indices)
-      ret.indices.emplace_back(db_size_index_count{i.second, i.first});
+   for(const auto& i : indices) {
+      auto s = row_sizes.find(i.second);
+      uint64_t row_size = s != row_sizes.end() ? s->second : 0;
+      ret.indices.emplace_back(db_size_index_count{i.second, i.first, row_size, i.first * row_size});
+   }
+
+   return ret;
+}
 
+db_size_tables db_size_api_plugin::get_tables( const db_size_tables_params& params ) {
+   const chainbase::database& db = app().get_plugin<chain_plugin>().chain().db();
+   const auto& idx = db.get_index<table_id_multi_index, by_code_scope_table>();
+
+   // nothing on the write path of the chain keeps the size of a table, so its rows are walked here
+   std::map<std::pair<account_name, name>, db_size_table> by_code_table;
+   auto itr = params.code ? idx.lower_bound( boost::make_tuple( *params.code ) ) : idx.begin();
+   for( ; itr != idx.end() && (!params.code || itr->code == *params.code); ++itr ) {
+      auto& t = by_code_table[std::make_pair( itr->code, itr->table )];
+      t.code = itr->code;
+      t.table = itr->table;
+      ++t.scopes;
+      t.row_count += itr->count;
+      t.bytes += table_bytes( db, itr->id );
+   }
+
+   db_size_tables ret;
+   ret.tables.reserve( by_code_table.size() );
+   for( auto& t : by_code_table )
+      ret.tables.emplace_back( std::move( t.second ) );
+   std::sort( ret.tables.begin(), ret.tables.end(), []( const db_size_table& a, const db_size_table& b ) {
+      return a.bytes > b.bytes;
+   });
+   if( ret.tables.size() > params.limit ) {
+      ret.tables.resize( params.limit );
+      ret.more = true;
+   }
    return ret;
 }
 
 #undef INVOKE_R_V
+#undef INVOKE_R_R
 #undef CALL
 
 }
@@ -16,15 +16,37 @@ using namespace appbase;
 struct db_size_index_count {
    string   index;
    uint64_t row_count;
+   uint64_t row_size = 0; ///< the fixed size of a row with its index nodes, 0 for indices of other plugins
+   uint64_t bytes = 0;    ///< row_count * row_size, the shared strings of the rows not included
 };
 
 struct db_size_stats {
    uint64_t                    free_bytes;
    uint64_t                    used_bytes;
    uint64_t                    size;
+   uint64_t                    largest_free_block = 0; ///< the largest row or string that can still be allocated
+   double                      fragmentation = 0;      ///< the part of the free bytes not in the largest free block
    vector<db_size_index_count> indices;
 };
 
+struct db_size_tables_params {
+   optional<account_name> code;        ///< only the tables of this contract
+   uint32_t               limit = 100; ///< the largest tables first
+};
+
+struct db_size_table {
+   account_name code;
+   name         table;
+   uint32_t     scopes = 0;
+   uint64_t     row_count = 0;
+   uint64_t     bytes = 0; ///< billable bytes of the rows, as charged to the RAM of their payers
+};
+
+struct db_size_tables {
+   vector<db_size_table> tables;
+   bool                  more = false; ///< whether tables were left out by the limit
+};
+
 class db_size_api_plugin : public plugin<db_size_api_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
@@ -42,11 +64,15 @@ public:
    void plugin_shutdown() {}
 
    db_size_stats get();
+   db_size_tables get_tables( const db_size_tables_params& params );
 
 private:
 };
 
 }
 
-FC_REFLECT( eosio::db_size_index_count, (index)(row_count) )
-FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
\ No newline at end of file
+FC_REFLECT( eosio::db_size_index_count, (index)(row_count)(row_size)(bytes) )
+FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(largest_free_block)(fragmentation)(indices) )
+FC_REFLECT( eosio::db_size_tables_params, (code)(limit) )
+FC_REFLECT( eosio::db_size_table, (code)(table)(scopes)(row_count)(bytes) )
+FC_REFLECT( eosio::db_size_tables, (tables)(more) )
\ No newline at end of file
@@ -0,0 +1,161 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/history_plugin/action_history_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace eosio {
+
+   namespace detail {
+      class action_history_log_impl {
+         public:
+            std::mutex                                 mtx;
+            fc::path                                   log_file;
+            std::ofstream                              writer;
+            std::ifstream                              reader;
+            uint64_t                                   end_pos = 0;
+            uint64_t                                   last_seq = 0;
+            std::map<account_name, vector<uint64_t>>   by_account; ///< offsets in account sequence order
+            std::multimap<uint64_t, uint64_t>          by_trx;     ///< first 8 bytes of the trx id to offset
+
+            static uint64_t id_key( const transaction_id_type& id ) {
+               uint64_t k = 0;
+               for( size_t i = 0; i < sizeof(k); ++i )
+                  k = (k << 8) | uint8_t( id.data()[i] );
+               return k;
+            }
+
+            void index( const action_history_entry& e, uint64_t pos ) {
+               for( const auto& a : e.accounts )
+                  by_account[a].push_back( pos );
+               by_trx.emplace( id_key( e.trx_id ), pos );
+               last_seq = e.action_sequence_num;
+            }
+
+            action_history_entry read( uint64_t pos ) {
+               reader.clear();
+               reader.seekg( pos );
+               uint32_t size = 0;
+               reader.read( (char*)&size, sizeof(size) );
+               vector<char> packed( size );
+               reader.read( packed.data(), size );
+               EOS_ASSERT( reader, chain::plugin_exception, "unable to read action history at ${p} of ${f}",
+                           ("p", pos)("f", log_file.generic_string()) );
+               return fc::raw::unpack<action_history_entry>( packed );
+            }
+
+            /// indexes every complete entry and returns the end of the last one
+            uint64_t scan() {
+               auto file_size = boost::filesystem::file_size( log_file.generic_string() );
+               uint64_t pos = 0;
+               while( pos + sizeof(uint32_t) <= file_size ) {
+                  reader.clear();
+                  reader.seekg( pos );
+                  uint32_t size = 0;
+                  reader.read( (char*)&size, sizeof(size) );
+                  if( !reader || pos + sizeof(size) + size > file_size )
+                     break;
+                  try {
+                     index( read( pos ), pos );
+                  } catch( const fc::exception& e ) {
+                     wlog( "dropping damaged action history from ${p} on: ${e}", ("p", pos)("e", e.to_string()) );
+                     break;
+                  }
+                  pos += sizeof(size) + size;
+               }
+               return pos;
+            }
+      };
+   }
+
+   action_history_log::action_history_log( const fc::path& dir )
+   :my( new detail::action_history_log_impl() ) {
+      if( !fc::is_directory( dir ) )
+         fc::create_directories( dir );
+      my->log_file = dir / "actions.log";
+      if( !fc::exists( my->log_file ) )
+         std::ofstream( my->log_file.generic_string().c_str(), std::ios::binary );
+
+      my->reader.open( my->log_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      my->end_pos = my->scan();
+      if( my->end_pos != boost::filesystem::file_size( my->log_file.generic_string() ) ) {
+         wlog( "truncating ${f} to its last complete action", ("f", my->log_file.generic_string()) );
+         boost::filesystem::resize_file( my->log_file.generic_string(), my->end_pos );
+      }
+      my->writer.open( my->log_file.generic_string().c_str(), std::ios::out | std::ios::app | std::ios::binary );
+      EOS_ASSERT( my->reader && my->writer, chain::plugin_exception, "unable to open ${f}", ("f", my->log_file.generic_string()) );
+      ilog( "action history log ${f} holds actions up to ${s}", ("f", my->log_file.generic_string())("s", my->last_seq) );
+   }
+
+   action_history_log::~action_history_log() {
+      if( my && my->writer.is_open() )
+         my->writer.flush();
+   }
+
+   void action_history_log::append( const action_history_entry& e ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      if( e.action_sequence_num <= my->last_seq )
+         return;
+      auto packed = fc::raw::pack( e );
+      uint32_t size = packed.size();
+      my->writer.write( (const char*)&size, sizeof(size) );
+      my->writer.write( packed.data(), packed.size() );
+      my->writer.flush();
+      EOS_ASSERT( my->writer, chain::plugin_exception, "unable to append to ${f}", ("f", my->log_file.generic_string()) );
+      my->index( e, my->end_pos );
+      my->end_pos += sizeof(size) + size;
+   }
+
+   uint64_t action_history_log::last_action_sequence_num()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return my->last_seq;
+   }
+
+   uint32_t action_history_log::account_action_count( account_name account )const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto itr = my->by_account.find( account );
+      return itr == my->by_account.end() ? 0 : itr->second.size();
+   }
+
+   action_history_entry action_history_log::read_account_action( account_name account, uint32_t account_sequence_num ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto itr = my->by_account.find( account );
+      EOS_ASSERT( itr != my->by_account.end() && account_sequence_num < itr->second.size(), chain::plugin_exception,
+                  "action ${n} of ${a} is not in the action history log", ("n", account_sequence_num)("a", account) );
+      return my->read( itr->second[account_sequence_num] );
+   }
+
+   vector<action_history_entry> action_history_log::read_transaction( const transaction_id_type& prefix, size_t hex_digits,
+                                                                      const std::function<bool(const transaction_id_type&)>& matches ) {
+      const auto bits = std::min<size_t>( hex_digits * 4, 64 );
+      const uint64_t mask = bits == 0 ? 0 : ~uint64_t(0) << (64 - bits);
+      const uint64_t key = detail::action_history_log_impl::id_key( prefix ) & mask;
+      std::lock_guard<std::mutex> g( my->mtx );
+
+      vector<action_history_entry> result;
+      for( auto itr = my->by_trx.lower_bound( key ); itr != my->by_trx.end() && (itr->first & mask) == key; ++itr ) {
+         auto e = my->read( itr->second );
+         if( !matches( e.trx_id ) )
+            continue;
+         // entries of one key are in the order they were appended, which is action sequence order
+         auto range = my->by_trx.equal_range( itr->first );
+         for( auto r = range.first; r != range.second; ++r ) {
+            auto a = r == itr ? e : my->read( r->second );
+            if( a.trx_id == e.trx_id )
+               result.emplace_back( std::move( a ) );
+         }
+         break;
+      }
+      return result;
+   }
+
+} /// namespace eosio
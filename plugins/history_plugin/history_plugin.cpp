@@ -1,6 +1,7 @@
 #include <eosio/history_plugin/history_plugin.hpp>
 #include <eosio/history_plugin/account_control_history_object.hpp>
 #include <eosio/history_plugin/public_key_history_object.hpp>
+#include <eosio/history_plugin/action_history_log.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
@@ -8,11 +9,19 @@
 #include <fc/io/json.hpp>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem/path.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace eosio {
    using namespace chain;
    using boost::signals2::scoped_connection;
+   namespace bfs = boost::filesystem;
 
    static appbase::abstract_plugin& _history_plugin = app().register_plugin<history_plugin>();
 
@@ -142,6 +151,30 @@ namespace eosio {
          std::set<filter_entry> filter_out;
          chain_plugin*          chain_plug = nullptr;
          fc::optional<scoped_connection> applied_transaction_connection;
+         fc::optional<scoped_connection> irreversible_block_connection;
+         fc::optional<scoped_connection> accepted_block_connection;
+         /// actions of irreversible blocks when history-log-dir is set, the state database then only holds reversible ones
+         std::unique_ptr<action_history_log> log;
+
+         /**
+          *  With history-async-writer actions are not recorded in the state database while blocks are applied. The
+          *  traces of a block are held until it is irreversible and then filtered, packed and appended to the log by
+          *  the writer thread.
+          */
+         bool                                         async_writer = false;
+         vector<transaction_trace_ptr>                applied_traces; ///< since the last accepted block
+         struct block_traces {
+            uint32_t                      block_num = 0;
+            vector<transaction_trace_ptr> traces;
+         };
+         std::map<block_id_type, block_traces>        reversible_traces;
+         std::mutex                                   writer_mtx;
+         std::condition_variable                      writer_cv;
+         std::deque<vector<transaction_trace_ptr>>    writer_queue;
+         bool                                         writer_stopping = false;
+         std::thread                                  writer_thread;
+
+         ~history_plugin_impl() { stop_writer(); }
 
           bool filter(const action_trace& act) {
             bool pass_on = false;
@@ -211,9 +244,9 @@ namespace eosio {
             const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
             auto itr = idx.lower_bound( boost::make_tuple( name(n.value+1), 0 ) );
 
-            uint64_t asn = 0;
+            uint64_t asn = log ? log->account_action_count( n ) : 0;
             if( itr != idx.begin() ) --itr;
-            if( itr->account == n )
+            if( itr != idx.end() && itr->account == n )
                asn = itr->account_sequence_num + 1;
 
             //idump((n)(act.receipt.global_sequence)(asn));
@@ -282,10 +315,163 @@ namespace eosio {
          }
 
          void on_applied_transaction( const transaction_trace_ptr& trace ) {
+            if( async_writer ) {
+               applied_traces.emplace_back( trace );
+               // key and controlled account history stays in the state database, it relies on its undo sessions
+               for( const auto& atrace : trace->action_traces ) {
+                  on_system_actions( atrace );
+               }
+               return;
+            }
             for( const auto& atrace : trace->action_traces ) {
                on_action_trace( atrace );
             }
          }
+
+         void on_system_actions( const action_trace& at ) {
+            if( at.receipt.receiver == chain::config::system_account_name )
+               on_system_action( at );
+            for( const auto& iline : at.inline_traces ) {
+               on_system_actions( iline );
+            }
+         }
+
+         /**
+          *  Keeps, of the traces applied since the previous block, the last one of each transaction in the block and
+          *  of its onblock transaction. The others belong to speculative blocks that were aborted or to transactions
+          *  that failed.
+          */
+         void on_accepted_block( const block_state_ptr& bs ) {
+            std::map<transaction_id_type, transaction_trace_ptr> latest;
+            transaction_trace_ptr onblock;
+            for( const auto& t : applied_traces ) {
+               if( t->block_num != bs->block_num || !t->receipt || t->except )
+                  continue;
+               latest[t->id] = t;
+               if( t->action_traces.size() == 1 && t->action_traces[0].act.account == chain::config::system_account_name &&
+                   t->action_traces[0].act.name == N(onblock) )
+                  onblock = t;
+            }
+
+            auto& bt = reversible_traces[bs->id];
+            bt.block_num = bs->block_num;
+            bt.traces.clear();
+            if( onblock )
+               bt.traces.emplace_back( onblock );
+            for( const auto& receipt : bs->block->transactions ) {
+               auto id = receipt.trx.contains<packed_transaction>() ? receipt.trx.get<packed_transaction>().id()
+                                                                    : receipt.trx.get<transaction_id_type>();
+               auto itr = latest.find( id );
+               if( itr != latest.end() )
+                  bt.traces.emplace_back( itr->second );
+            }
+
+            applied_traces.erase( std::remove_if( applied_traces.begin(), applied_traces.end(),
+                                                  [&]( const transaction_trace_ptr& t ) { return t->block_num <= bs->block_num; } ),
+                                  applied_traces.end() );
+         }
+
+         void on_irreversible_block( const block_state_ptr& bs ) {
+            auto itr = reversible_traces.find( bs->id );
+            if( itr != reversible_traces.end() ) {
+               std::lock_guard<std::mutex> g( writer_mtx );
+               writer_queue.emplace_back( std::move( itr->second.traces ) );
+               writer_cv.notify_one();
+            }
+            for( auto i = reversible_traces.begin(); i != reversible_traces.end(); ) {
+               if( i->second.block_num <= bs->block_num )
+                  i = reversible_traces.erase( i );
+               else
+                  ++i;
+            }
+         }
+
+         void write_action_trace( const action_trace& at ) {
+            if( filter( at ) ) {
+               action_history_entry e;
+               e.action_sequence_num = at.receipt.global_sequence;
+               e.block_num = at.block_num;
+               e.block_time = at.block_time;
+               e.trx_id = at.trx_id;
+               e.packed_action_trace = fc::raw::pack( at );
+               auto aset = account_set( at );
+               e.accounts.assign( aset.begin(), aset.end() );
+               log->append( e );
+            }
+            for( const auto& iline : at.inline_traces ) {
+               write_action_trace( iline );
+            }
+         }
+
+         /// runs until stopped, after writing everything queued before
+         void run_writer() {
+            while( true ) {
+               vector<transaction_trace_ptr> traces;
+               {
+                  std::unique_lock<std::mutex> g( writer_mtx );
+                  writer_cv.wait( g, [this]() { return writer_stopping || !writer_queue.empty(); } );
+                  if( writer_queue.empty() )
+                     return;
+                  traces = std::move( writer_queue.front() );
+                  writer_queue.pop_front();
+               }
+               try {
+                  for( const auto& t : traces ) {
+                     for( const auto& atrace : t->action_traces ) {
+                        write_action_trace( atrace );
+                     }
+                  }
+               } FC_LOG_AND_DROP()
+            }
+         }
+
+         void stop_writer() {
+            if( !writer_thread.joinable() )
+               return;
+            {
+               std::lock_guard<std::mutex> g( writer_mtx );
+               writer_stopping = true;
+               writer_cv.notify_one();
+            }
+            writer_thread.join();
+         }
+
+         /**
+          *  Moves the actions of blocks up to lib, with their account history entries, out of the state database into
+          *  the log. Removals that are undone by a fork switch bring back actions the log already holds, they are
+          *  moved out again, and dropped by the log, on the next irreversible block.
+          */
+         void move_irreversible_to_log( uint32_t lib ) {
+            auto& chain = chain_plug->chain();
+            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
+            const auto& idx = db.get_index<action_history_index, by_action_sequence_num>();
+            const auto& account_idx = db.get_index<account_history_index, by_account_action_seq>();
+
+            while( !idx.empty() && idx.begin()->block_num <= lib ) {
+               const auto& a = *idx.begin();
+               action_history_entry e;
+               e.action_sequence_num = a.action_sequence_num;
+               e.block_num = a.block_num;
+               e.block_time = a.block_time;
+               e.trx_id = a.trx_id;
+               e.packed_action_trace.assign( a.packed_action_trace.begin(), a.packed_action_trace.end() );
+
+               action_trace t;
+               fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
+               fc::raw::unpack( ds, t );
+               // the oldest account history entry of each account is the one of the oldest action
+               for( auto n : account_set( t ) ) {
+                  auto itr = account_idx.lower_bound( boost::make_tuple( n, 0 ) );
+                  if( itr != account_idx.end() && itr->account == n && itr->action_sequence_num == a.action_sequence_num ) {
+                     e.accounts.push_back( n );
+                     db.remove( *itr );
+                  }
+               }
+
+               log->append( e );
+               db.remove( a );
+            }
+         }
    };
 
    history_plugin::history_plugin()
@@ -306,6 +492,15 @@ namespace eosio {
             ("filter-out,F", bpo::value<vector<string>>()->composing(),
              "Do not track actions which match receiver:action:actor. Action and Actor both blank excludes all from Reciever. Actor blank excludes all from reciever:action. Receiver may not be blank.")
             ;
+      cfg.add_options()
+            ("history-log-dir", bpo::value<bfs::path>(),
+             "The location of an append-only log (absolute path or relative to application data dir) the actions of irreversible blocks are moved to "
+             "out of the chain state database. Leave unset to keep every action in the chain state database.")
+            ("history-async-writer", bpo::bool_switch()->default_value(false),
+             "Do not record actions while blocks are applied, but append them to the history log from a separate thread once "
+             "their block is irreversible. Requires history-log-dir. Actions of reversible blocks are then not available, "
+             "and those of blocks still reversible at shutdown are never recorded.")
+            ;
    }
 
    void history_plugin::plugin_initialize(const variables_map& options) {
@@ -355,6 +550,33 @@ namespace eosio {
                chain.applied_transaction.connect( [&]( const transaction_trace_ptr& p ) {
                   my->on_applied_transaction( p );
                } ));
+
+         if( options.count( "history-log-dir" )) {
+            auto dir = options.at( "history-log-dir" ).as<bfs::path>();
+            if( dir.is_relative())
+               dir = app().data_dir() / dir;
+            my->log.reset( new action_history_log( dir ));
+         }
+         my->async_writer = options.at( "history-async-writer" ).as<bool>();
+         EOS_ASSERT( !my->async_writer || my->log, fc::invalid_arg_exception, "history-async-writer requires history-log-dir" );
+
+         if( my->async_writer ) {
+            // started here already, so that a replay during chain_plugin startup does not just fill the queue
+            my->writer_thread = std::thread( [impl = my.get()]() { impl->run_writer(); } );
+            my->accepted_block_connection.emplace(
+                  chain.accepted_block.connect( [&]( const block_state_ptr& s ) {
+                     my->on_accepted_block( s );
+                  } ));
+            my->irreversible_block_connection.emplace(
+                  chain.irreversible_block.connect( [&]( const block_state_ptr& s ) {
+                     my->on_irreversible_block( s );
+                  } ));
+         } else if( my->log ) {
+            my->irreversible_block_connection.emplace(
+                  chain.irreversible_block.connect( [&]( const block_state_ptr& s ) {
+                     my->move_irreversible_to_log( s->block_num );
+                  } ));
+         }
       } FC_LOG_AND_RETHROW()
    }
 
@@ -363,17 +585,60 @@ namespace eosio {
 
    void history_plugin::plugin_shutdown() {
       my->applied_transaction_connection.reset();
+      my->irreversible_block_connection.reset();
+      my->accepted_block_connection.reset();
+      my->stop_writer();
    }
 
 
 
 
    namespace history_apis {
+      template<typename T>
+      static fc::variant to_variant_with_abi( const chain_plugin& chain_plug, const T& obj ) {
+         const auto& db = chain_plug.chain().db();
+         const auto abi_serializer_max_time = chain_plug.get_abi_serializer_max_time();
+         auto& abi_cache = chain_plug.get_abi_serializer_cache();
+
+         fc::variant pretty_output;
+         abi_serializer::to_variant( obj, pretty_output,
+                                     [&]( account_name n ) -> std::shared_ptr<const abi_serializer> {
+                                        if( n.good() ) {
+                                           try {
+                                              return abi_cache.get( db, n, abi_serializer_max_time );
+                                           } FC_CAPTURE_AND_LOG((n))
+                                        }
+                                        return nullptr;
+                                     },
+                                     abi_serializer_max_time );
+         return pretty_output;
+      }
+
+      /// whether the packed action_trace matches the contract and action filters, read from its first fields only
+      static bool matches_action( const char* data, size_t size, const read_only::get_actions_params& params ) {
+         if( !params.filter_contract && !params.filter_action )
+            return true;
+         fc::datastream<const char*> ds( data, size );
+         // skip the action_receipt up to its auth_sequence, then that map of account_name to uint64_t
+         ds.skip( sizeof(account_name) + sizeof(digest_type) + 2 * sizeof(uint64_t) );
+         fc::unsigned_int auth_count;
+         fc::raw::unpack( ds, auth_count );
+         ds.skip( auth_count.value * (sizeof(account_name) + sizeof(uint64_t)) );
+         fc::unsigned_int code_sequence, abi_sequence;
+         fc::raw::unpack( ds, code_sequence );
+         fc::raw::unpack( ds, abi_sequence );
+         account_name contract;
+         action_name  act;
+         fc::raw::unpack( ds, contract );
+         fc::raw::unpack( ds, act );
+         return ( !params.filter_contract || contract == *params.filter_contract ) &&
+                ( !params.filter_action || act == *params.filter_action );
+      }
+
       read_only::get_actions_result read_only::get_actions( const read_only::get_actions_params& params )const {
          edump((params));
         auto& chain = history->chain_plug->chain();
         const auto& db = chain.db();
-        const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
 
         const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
 
@@ -382,17 +647,17 @@ namespace eosio {
         int32_t end = 0;
         int32_t offset = params.offset ? *params.offset : -20;
         auto n = params.account_name;
-        idump((pos));
-        if( pos == -1 ) {
+        // account sequence numbers below logged are in the log, the others in the state database
+        const int32_t logged = history->log ? history->log->account_action_count( n ) : 0;
+        int32_t count = logged;
+        {
             auto itr = idx.lower_bound( boost::make_tuple( name(n.value+1), 0 ) );
-            if( itr == idx.begin() ) {
-               if( itr->account == n )
-                  pos = itr->account_sequence_num+1;
-            } else if( itr != idx.begin() ) --itr;
-
-            if( itr->account == n )
-               pos = itr->account_sequence_num + 1;
+            if( itr != idx.begin() ) --itr;
+            if( itr != idx.end() && itr->account == n )
+               count = itr->account_sequence_num + 1;
         }
+        idump((pos));
+        if( pos == -1 && count > 0 ) pos = count;
 
         if( pos== -1 ) pos = 0xfffffff;
 
@@ -408,32 +673,67 @@ namespace eosio {
 
         idump((start)(end));
 
-        auto start_itr = idx.lower_bound( boost::make_tuple( n, start ) );
-        auto end_itr = idx.upper_bound( boost::make_tuple( n, end) );
+        // calls f( global sequence, block_num, block_time, packed trace, its size ) for account sequence number asn
+        auto with_action = [&]( int32_t asn, auto&& f ) {
+           if( asn < logged ) {
+              auto e = history->log->read_account_action( n, asn );
+              f( e.action_sequence_num, e.block_num, e.block_time, e.packed_action_trace.data(), e.packed_action_trace.size() );
+           } else {
+              auto itr = idx.find( boost::make_tuple( n, asn ) );
+              EOS_ASSERT( itr != idx.end(), chain::plugin_exception, "action ${n} of ${a} is missing from history", ("n", asn)("a", n) );
+              const auto& a = db.get<action_history_object, by_action_sequence_num>( itr->action_sequence_num );
+              f( a.action_sequence_num, a.block_num, a.block_time, a.packed_action_trace.data(), a.packed_action_trace.size() );
+           }
+        };
+        auto block_time_of = [&]( int32_t asn ) {
+           block_timestamp_type t;
+           with_action( asn, [&]( uint64_t, uint32_t, block_timestamp_type bt, const char*, size_t ) { t = bt; } );
+           return t;
+        };
+        // first account sequence number in [lo, hi) whose block time satisfies past, block times never decrease
+        auto partition = [&]( int32_t lo, int32_t hi, auto&& past ) {
+           while( lo < hi ) {
+              auto mid = lo + (hi - lo) / 2;
+              if( past( block_time_of( mid ) ) ) hi = mid;
+              else lo = mid + 1;
+           }
+           return lo;
+        };
+
+        int32_t first = std::max( start, 0 );
+        int32_t last  = std::min( end, count - 1 );
+        if( first <= last && params.min_block_time )
+           first = partition( first, last + 1, [&]( block_timestamp_type t ) { return t >= *params.min_block_time; } );
+        if( first <= last && params.max_block_time )
+           last = partition( first, last + 1, [&]( block_timestamp_type t ) { return t > *params.max_block_time; } ) - 1;
 
         auto start_time = fc::time_point::now();
         auto end_time = start_time;
 
         get_actions_result result;
         result.last_irreversible_block = chain.last_irreversible_block_num();
-        while( start_itr != end_itr ) {
-           const auto& a = db.get<action_history_object, by_action_sequence_num>( start_itr->action_sequence_num );
-           fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
-           action_trace t;
-           fc::raw::unpack( ds, t );
-           result.actions.emplace_back( ordered_action_result{
-                                 start_itr->action_sequence_num,
-                                 start_itr->account_sequence_num,
-                                 a.block_num, a.block_time,
-                                 chain.to_variant_with_abi(t, abi_serializer_max_time)
-                                 });
+        const bool raw = params.raw && *params.raw;
+        for( int32_t asn = first; asn <= last; ++asn ) {
+           with_action( asn, [&]( uint64_t seq, uint32_t block_num, block_timestamp_type block_time, const char* data, size_t size ) {
+              if( !matches_action( data, size, params ) )
+                 return;
+              fc::variant trace;
+              if( raw ) {
+                 trace = fc::variant( bytes( data, data + size ) );
+              } else {
+                 fc::datastream<const char*> ds( data, size );
+                 action_trace t;
+                 fc::raw::unpack( ds, t );
+                 trace = to_variant_with_abi(*history->chain_plug, t);
+              }
+              result.actions.emplace_back( ordered_action_result{ seq, asn, block_num, block_time, std::move( trace ) } );
+           });
 
            end_time = fc::time_point::now();
            if( end_time - start_time > fc::microseconds(100000) ) {
               result.time_limit_exceeded_error = true;
               break;
            }
-           ++start_itr;
         }
         return result;
       }
@@ -441,7 +741,6 @@ namespace eosio {
 
       read_only::get_transaction_result read_only::get_transaction( const read_only::get_transaction_params& p )const {
          auto& chain = history->chain_plug->chain();
-         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
 
          transaction_id_type input_id;
          auto input_id_length = p.id.size();
@@ -468,13 +767,31 @@ namespace eosio {
 
          bool in_history = (itr != idx.end() && txn_id_matched(itr->trx_id) );
 
+         vector<action_history_entry> logged;
+         if( !in_history && history->log ) {
+            logged = history->log->read_transaction( input_id, input_id_length, txn_id_matched );
+            in_history = !logged.empty();
+         }
+
          if( !in_history && !p.block_num_hint ) {
             EOS_THROW(tx_not_found, "Transaction ${id} not found in history and no block hint was given", ("id",p.id));
          }
 
          get_transaction_result result;
 
-         if( in_history ) {
+         if( in_history && !logged.empty() ) {
+            result.id         = logged.front().trx_id;
+            result.last_irreversible_block = chain.last_irreversible_block_num();
+            result.block_num  = logged.front().block_num;
+            result.block_time = logged.front().block_time;
+
+            for( const auto& e : logged ) {
+              fc::datastream<const char*> ds( e.packed_action_trace.data(), e.packed_action_trace.size() );
+              action_trace t;
+              fc::raw::unpack( ds, t );
+              result.traces.emplace_back( to_variant_with_abi(*history->chain_plug, t) );
+            }
+         } else if( in_history ) {
             result.id         = itr->trx_id;
             result.last_irreversible_block = chain.last_irreversible_block_num();
             result.block_num  = itr->block_num;
@@ -485,11 +802,13 @@ namespace eosio {
               fc::datastream<const char*> ds( itr->packed_action_trace.data(), itr->packed_action_trace.size() );
               action_trace t;
               fc::raw::unpack( ds, t );
-              result.traces.emplace_back( chain.to_variant_with_abi(t, abi_serializer_max_time) );
+              result.traces.emplace_back( to_variant_with_abi(*history->chain_plug, t) );
 
               ++itr;
             }
+         }
 
+         if( in_history ) {
             auto blk = chain.fetch_block_by_number( result.block_num );
             if( blk == nullptr ) { // still in pending
                 auto blk_state = chain.pending_block_state();
@@ -504,7 +823,7 @@ namespace eosio {
                         auto mtrx = transaction_metadata(pt);
                         if (mtrx.id == result.id) {
                             fc::mutable_variant_object r("receipt", receipt);
-                            r("trx", chain.to_variant_with_abi(mtrx.trx, abi_serializer_max_time));
+                            r("trx", to_variant_with_abi(*history->chain_plug, mtrx.get_signed_transaction()));
                             result.trx = move(r);
                             break;
                         }
@@ -532,7 +851,7 @@ namespace eosio {
                         result.block_num = *p.block_num_hint;
                         result.block_time = blk->timestamp;
                         fc::mutable_variant_object r("receipt", receipt);
-                        r("trx", chain.to_variant_with_abi(mtrx.trx, abi_serializer_max_time));
+                        r("trx", to_variant_with_abi(*history->chain_plug, mtrx.get_signed_transaction()));
                         result.trx = move(r);
                         found = true;
                         break;
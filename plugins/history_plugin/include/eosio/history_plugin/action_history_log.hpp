@@ -0,0 +1,70 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/block_timestamp.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <functional>
+
+namespace eosio {
+   using chain::account_name;
+   using chain::block_timestamp_type;
+   using chain::bytes;
+   using chain::transaction_id_type;
+   using std::vector;
+
+   struct action_history_entry {
+      uint64_t              action_sequence_num = 0;
+      uint32_t              block_num = 0;
+      block_timestamp_type  block_time;
+      transaction_id_type   trx_id;
+      vector<account_name>  accounts; ///< the accounts that have this action in their history
+      bytes                 packed_action_trace;
+   };
+
+   namespace detail { class action_history_log_impl; }
+
+   /**
+    *  Append-only file of the actions of irreversible blocks, so that they do not have to stay in the state database.
+    *
+    *  Every entry is stored as its packed size followed by the packed action_history_entry. Only the offsets of the
+    *  entries are kept in memory: per account in account sequence order, and per transaction keyed by the first
+    *  8 bytes of its id. They are rebuilt by scanning the file on open, which also drops an entry cut short by a
+    *  crash. Methods may be called from any thread.
+    */
+   class action_history_log {
+      public:
+         explicit action_history_log( const fc::path& dir );
+         ~action_history_log();
+
+         /// ignored unless the action sequence number is past the last one appended, so replays may append again
+         void append( const action_history_entry& e );
+
+         /// 0 if the log is empty
+         uint64_t last_action_sequence_num()const;
+
+         /// the account sequence number the next action of the account gets
+         uint32_t account_action_count( account_name account )const;
+
+         /// action of the account with the given account sequence number, which must be below account_action_count
+         action_history_entry read_account_action( account_name account, uint32_t account_sequence_num );
+
+         /**
+          *  Actions, in action sequence order, of the first transaction found whose id starts with the first
+          *  hex_digits hex digits of prefix and satisfies matches. Empty if there is none.
+          */
+         vector<action_history_entry> read_transaction( const transaction_id_type& prefix, size_t hex_digits,
+                                                        const std::function<bool(const transaction_id_type&)>& matches );
+
+      private:
+         std::unique_ptr<detail::action_history_log_impl> my;
+   };
+
+} /// namespace eosio
+
+FC_REFLECT( eosio::action_history_entry, (action_sequence_num)(block_num)(block_time)(trx_id)(accounts)(packed_action_trace) )
@@ -34,6 +34,12 @@ class read_only {
          chain::account_name account_name;
          optional<int32_t>   pos; /// a absolute sequence positon -1 is the end/last action
          optional<int32_t>   offset; ///< the number of actions relative to pos, negative numbers return [pos-offset,pos), positive numbers return [pos,pos+offset)
+         /// only actions of the range that match all filters given are returned, non-matching ones are never decoded
+         optional<chain::account_name>         filter_contract;
+         optional<chain::action_name>          filter_action;
+         optional<chain::block_timestamp_type> min_block_time;
+         optional<chain::block_timestamp_type> max_block_time;
+         optional<bool>                        raw; ///< action_trace as the hex of the packed trace instead of decoded with the ABI
       };
 
       struct ordered_action_result {
@@ -137,7 +143,8 @@ class history_plugin : public plugin<history_plugin> {
 
 } /// namespace eosio
 
-FC_REFLECT( eosio::history_apis::read_only::get_actions_params, (account_name)(pos)(offset) )
+FC_REFLECT( eosio::history_apis::read_only::get_actions_params, (account_name)(pos)(offset)
+            (filter_contract)(filter_action)(min_block_time)(max_block_time)(raw) )
 FC_REFLECT( eosio::history_apis::read_only::get_actions_result, (actions)(last_irreversible_block)(time_limit_exceeded_error) )
 FC_REFLECT( eosio::history_apis::read_only::ordered_action_result, (global_action_seq)(account_action_seq)(block_num)(block_time)(action_trace) )
 
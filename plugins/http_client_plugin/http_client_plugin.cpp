@@ -4,12 +4,109 @@
  */
 #include <eosio/http_client_plugin/http_client_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/metrics.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <condition_variable>
 #include <fstream>
+#include <map>
+#include <mutex>
 
 namespace eosio {
 
-http_client_plugin::http_client_plugin():my(new http_client()){}
+/**
+ *  The clients of one host. A client keeps its connection to the host open after a call, so one that is handed out
+ *  again skips the connect and TLS handshake; one whose call failed is dropped, as its connection may be broken.
+ */
+struct http_client_host_pool {
+   vector<std::unique_ptr<http_client>>   idle;
+   uint32_t                               busy = 0;
+   std::condition_variable                released;
+   chain::metric_histogram*               latency = nullptr;
+   chain::metric_counter*                 failures = nullptr;
+};
+
+class http_client_plugin_impl {
+   public:
+      http_client                                   client;
+      vector<string>                                root_pems;
+      bool                                          verify_peers = true;
+      uint32_t                                      max_connections = 4;
+      fc::microseconds                              timeout;
+
+      std::mutex                                    mtx;
+      std::map<string, http_client_host_pool>       pools; // guarded by `mtx`
+
+      std::unique_ptr<http_client> make_client()const {
+         std::unique_ptr<http_client> c( new http_client() );
+         for( const auto& pem : root_pems )
+            c->add_cert( pem );
+         c->set_verify_peers( verify_peers );
+         return c;
+      }
+
+      static string host_of( const fc::url& dest ) {
+         string host = dest.proto() + "://" + ( dest.host() ? *dest.host() : string() );
+         if( dest.port() )
+            host += ":" + std::to_string( *dest.port() );
+         return host;
+      }
+
+      fc::variant post_sync( const fc::url& dest, const fc::variant& payload, fc::time_point deadline ) {
+         if( deadline == fc::time_point::maximum() && timeout.count() > 0 )
+            deadline = fc::time_point::now() + timeout;
+
+         const auto start = fc::time_point::now();
+         const auto host = host_of( dest );
+         std::unique_ptr<http_client> c;
+         http_client_host_pool* pool = nullptr;
+         {
+            std::unique_lock<std::mutex> g( mtx );
+            pool = &pools[host];
+            if( !pool->latency ) {
+               auto& registry = chain::metrics_registry::instance();
+               pool->latency = &registry.histogram( "eosio_http_client_request_seconds",
+                                                    "time of outbound http calls, waiting for a connection included", {{"host", host}} );
+               pool->failures = &registry.counter( "eosio_http_client_failures_total", "outbound http calls that failed",
+                                                   {{"host", host}} );
+            }
+            auto available = [&]{ return !pool->idle.empty() || pool->busy < max_connections; };
+            if( deadline == fc::time_point::maximum() ) {
+               pool->released.wait( g, available );
+            } else {
+               auto wait = std::chrono::microseconds( std::max<int64_t>( ( deadline - fc::time_point::now() ).count(), 0 ) );
+               EOS_ASSERT( pool->released.wait_for( g, wait, available ), chain::http_request_fail,
+                           "timed out waiting for a connection to ${h}", ("h", host) );
+            }
+            if( !pool->idle.empty() ) {
+               c = std::move( pool->idle.back() );
+               pool->idle.pop_back();
+            }
+            ++pool->busy;
+         }
+
+         auto release = [&]( bool keep ) {
+            pool->latency->observe( fc::time_point::now() - start );
+            std::lock_guard<std::mutex> g( mtx );
+            --pool->busy;
+            if( keep )
+               pool->idle.emplace_back( std::move( c ) );
+            pool->released.notify_one();
+         };
+         try {
+            if( !c )
+               c = make_client();
+            auto result = c->post_sync( dest, payload, deadline );
+            release( true );
+            return result;
+         } catch( ... ) {
+            pool->failures->add();
+            release( false );
+            throw;
+         }
+      }
+};
+
+http_client_plugin::http_client_plugin():my(new http_client_plugin_impl()){}
 http_client_plugin::~http_client_plugin(){}
 
 void http_client_plugin::set_program_options(options_description&, options_description& cfg) {
@@ -18,6 +115,10 @@ void http_client_plugin::set_program_options(options_description&, options_descr
        "PEM encoded trusted root certificate (or path to file containing one) used to validate any TLS connections made.  (may specify multiple times)\n")
       ("https-client-validate-peers", boost::program_options::value<bool>()->default_value(true),
        "true: validate that the peer certificates are valid and trusted, false: ignore cert errors")
+      ("http-client-max-connections", boost::program_options::value<uint32_t>()->default_value(4),
+       "Maximum number of connections kept open to each host called, and so of concurrent calls to it")
+      ("http-client-timeout-ms", boost::program_options::value<uint32_t>()->default_value(0),
+       "Time allowed for an outbound call whose caller set no deadline, waiting for a connection included (0 for none)")
       ;
 
 }
@@ -43,14 +144,20 @@ void http_client_plugin::plugin_initialize(const variables_map& options) {
             }
 
             try {
-               my->add_cert( pem_str );
+               my->client.add_cert( pem_str );
+               my->root_pems.emplace_back( pem_str );
             } catch ( const fc::exception& e ) {
                elog( "Failed to read PEM : ${e} \n${pem}\n", ("pem", pem_str)( "e", e.to_detail_string()));
             }
          }
       }
 
-      my->set_verify_peers( options.at( "https-client-validate-peers" ).as<bool>());
+      my->verify_peers = options.at( "https-client-validate-peers" ).as<bool>();
+      my->client.set_verify_peers( my->verify_peers );
+
+      my->max_connections = options.at( "http-client-max-connections" ).as<uint32_t>();
+      EOS_ASSERT( my->max_connections > 0, chain::plugin_config_exception, "http-client-max-connections must be at least 1" );
+      my->timeout = fc::milliseconds( options.at( "http-client-timeout-ms" ).as<uint32_t>() );
    } FC_LOG_AND_RETHROW()
 }
 
@@ -59,7 +166,17 @@ void http_client_plugin::plugin_startup() {
 }
 
 void http_client_plugin::plugin_shutdown() {
+   std::lock_guard<std::mutex> g( my->mtx );
+   for( auto& p : my->pools )
+      p.second.idle.clear();
+}
+
+fc::variant http_client_plugin::post_sync( const fc::url& dest, const fc::variant& payload, const fc::time_point& deadline ) {
+   return my->post_sync( dest, payload, deadline );
+}
 
+http_client& http_client_plugin::get_client() {
+   return my->client;
 }
 
 }
@@ -23,12 +23,19 @@ namespace eosio {
         void plugin_startup();
         void plugin_shutdown();
 
-        http_client& get_client() {
-           return *my;
-        }
+        /**
+         *  Posts to dest on a client of the pool of its host, whose connections are kept open between calls, waiting
+         *  for one while http-client-max-connections calls to the host are in flight. Any thread may call it. Without
+         *  a deadline, http-client-timeout-ms applies.
+         */
+        fc::variant post_sync( const fc::url& dest, const fc::variant& payload,
+                               const fc::time_point& deadline = fc::time_point::maximum() );
+
+        /// a client of its own, shared by every caller and not thread safe; post_sync keeps the connections open
+        http_client& get_client();
 
       private:
-        std::unique_ptr<http_client> my;
+        std::unique_ptr<class http_client_plugin_impl> my;
    };
 
 }
@@ -5,15 +5,23 @@
 #include <eosio/http_plugin/http_plugin.hpp>
 #include <eosio/http_plugin/local_endpoint.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
+#include <eosio/chain/thread_registry.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/io/json.hpp>
 #include <fc/crypto/openssl.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -23,6 +31,8 @@
 #include <websocketpp/logger/stub.hpp>
 
 #include <thread>
+#include <algorithm>
+#include <cctype>
 #include <memory>
 #include <regex>
 
@@ -31,6 +41,7 @@ namespace eosio {
    static appbase::abstract_plugin& _http_plugin = app().register_plugin<http_plugin>();
 
    namespace asio = boost::asio;
+   namespace bio = boost::iostreams;
 
    using std::map;
    using std::vector;
@@ -126,6 +137,53 @@ namespace eosio {
 
    static bool verbose_http_errors = false;
 
+   namespace detail {
+
+      enum class content_encoding {
+         identity,
+         gzip,
+         deflate
+      };
+
+      /// gzip is preferred over deflate, codings the client refused with q=0 are skipped
+      inline content_encoding accepted_encoding( const string& accept_encoding ) {
+         bool gzip = false, deflate = false;
+         vector<string> codings;
+         boost::split( codings, accept_encoding, boost::is_any_of( "," ));
+         for( auto& c : codings ) {
+            vector<string> params;
+            boost::split( params, c, boost::is_any_of( ";" ));
+            auto name = boost::algorithm::to_lower_copy( boost::algorithm::trim_copy( params[0] ));
+            bool refused = false;
+            for( size_t i = 1; i < params.size(); ++i ) {
+               auto p = boost::algorithm::erase_all_copy( params[i], " " );
+               if( p == "q=0" || p == "q=0.0" || p == "q=0.00" || p == "q=0.000" )
+                  refused = true;
+            }
+            if( refused )
+               continue;
+            if( name == "gzip" || name == "x-gzip" ) gzip = true;
+            else if( name == "deflate" ) deflate = true;
+         }
+         return gzip ? content_encoding::gzip : deflate ? content_encoding::deflate : content_encoding::identity;
+      }
+
+      /// deflate is sent in the zlib format, which is what clients expect for that coding
+      inline string compress_body( const string& body, content_encoding encoding ) {
+         string out;
+         out.reserve( body.size() / 4 );
+         bio::filtering_ostream comp;
+         if( encoding == content_encoding::gzip )
+            comp.push( bio::gzip_compressor() );
+         else
+            comp.push( bio::zlib_compressor() );
+         comp.push( bio::back_inserter( out ));
+         bio::write( comp, body.data(), body.size() );
+         bio::close( comp );
+         return out;
+      }
+   }
+
    class http_plugin_impl {
       public:
          map<string,url_handler>  url_handlers;
@@ -135,6 +193,9 @@ namespace eosio {
          string                   access_control_max_age;
          bool                     access_control_allow_credentials = false;
          size_t                   max_body_size;
+         size_t                   compression_min_size = 0; ///< 0 to never compress responses
+         // address of the client whose request is being handed to a url_handler, empty in between
+         string                   current_client_address;
 
          websocket_server_type    server;
 
@@ -154,6 +215,33 @@ namespace eosio {
          string                   http_server_address_option_name  = "http-server-address";
          string                   https_server_address_option_name = "https-server-address";
 
+         // socket i/o runs on these threads when http-threads is not 0, url handlers always run on the main thread
+         uint16_t                                                              thread_pool_size = 0;
+         std::unique_ptr<asio::io_context>                                     server_ioc;
+         optional<asio::executor_work_guard<asio::io_context::executor_type>>  server_ioc_work;
+         vector<std::thread>                                                   thread_pool;
+
+         asio::io_service& server_io_service() {
+            return server_ioc ? *server_ioc : app().get_io_service();
+         }
+
+         /// requests come after blocks and transactions queued for the application thread
+         template<typename F>
+         void on_main_thread( F&& f ) {
+            if( server_ioc )
+               chain::plugin_interface::app_post( chain::plugin_interface::priority::low, std::forward<F>( f ) );
+            else
+               f();
+         }
+
+         template<typename F>
+         void on_server_thread( F&& f ) {
+            if( server_ioc )
+               server_ioc->post( std::forward<F>( f ) );
+            else
+               f();
+         }
+
          bool host_port_is_valid( const std::string& header_host_port, const string& endpoint_local_host_port ) {
             return !validate_host || header_host_port == endpoint_local_host_port || valid_hosts.find(header_host_port) != valid_hosts.end();
          }
@@ -254,6 +342,17 @@ namespace eosio {
             return true;
          }
 
+         // the remote endpoint without its port, so that all connections of one client share an address
+         template<class T>
+         static string client_address_of(typename websocketpp::server<T>::connection_ptr con) {
+            string endpoint = con->get_remote_endpoint();
+            auto colon = endpoint.rfind( ':' );
+            if( colon != string::npos && colon + 1 < endpoint.size() &&
+                std::all_of( endpoint.begin() + colon + 1, endpoint.end(), []( unsigned char c ) { return std::isdigit( c ); } ) )
+               endpoint.erase( colon );
+            return endpoint;
+         }
+
          template<class T>
          void handle_http_request(typename websocketpp::server<T>::connection_ptr con) {
             try {
@@ -281,26 +380,72 @@ namespace eosio {
                }
 
                con->append_header( "Content-type", "application/json" );
-               auto body = con->get_request_body();
-               auto resource = con->get_uri()->get_resource();
+               con->defer_http_response();
+               on_main_thread( [this, con, resource = con->get_uri()->get_resource(), body = con->get_request_body(),
+                                client = client_address_of<T>( con )]() mutable {
+                  dispatch_http_request<T>( con, resource, std::move( body ), client );
+               } );
+            } catch( ... ) {
+               handle_exception<T>( con );
+            }
+         }
+
+         /// compresses bodies of at least compression_min_size bytes when the client accepts it, off the main thread
+         template<class T>
+         void set_response_body(typename websocketpp::server<T>::connection_ptr con, string body) {
+            if( compression_min_size && body.size() >= compression_min_size ) {
+               auto encoding = detail::accepted_encoding( con->get_request_header( "Accept-Encoding" ));
+               if( encoding != detail::content_encoding::identity ) {
+                  try {
+                     auto compressed = detail::compress_body( body, encoding );
+                     con->append_header( "Content-Encoding", encoding == detail::content_encoding::gzip ? "gzip" : "deflate" );
+                     con->append_header( "Vary", "Accept-Encoding" );
+                     con->set_body( std::move( compressed ));
+                     return;
+                  } catch( const std::exception& e ) {
+                     elog( "unable to compress http response: ${e}", ("e", e.what()));
+                  }
+               }
+            }
+            con->set_body( std::move( body ));
+         }
+
+         /// runs on the main thread, the deferred response is sent back on the thread that serves the connection
+         template<class T>
+         void dispatch_http_request(typename websocketpp::server<T>::connection_ptr con, const string& resource,
+                                    string body, const string& client) {
+            // the connection is only touched on the server thread, whatever the outcome
+            try {
                auto handler_itr = url_handlers.find( resource );
                if( handler_itr != url_handlers.end()) {
-                  con->defer_http_response();
-                  handler_itr->second( resource, body, [con]( auto code, auto&& body ) {
-                     con->set_body( std::move( body ));
-                     con->set_status( websocketpp::http::status_code::value( code ));
-                     con->send_http_response();
+                  current_client_address = client;
+                  auto clear_client = fc::make_scoped_exit( [this]() { current_client_address.clear(); } );
+                  handler_itr->second( resource, std::move( body ), [this, con]( auto code, auto&& body ) {
+                     on_server_thread( [this, con, code, body = std::move( body )]() mutable {
+                        set_response_body<T>( con, std::move( body ));
+                        con->set_status( websocketpp::http::status_code::value( code ));
+                        con->send_http_response();
+                     } );
                   } );
-
                } else {
                   dlog( "404 - not found: ${ep}", ("ep", resource));
                   error_results results{websocketpp::http::status_code::not_found,
                                         "Not Found", error_results::error_info(fc::exception( FC_LOG_MESSAGE( error, "Unknown Endpoint" )), verbose_http_errors )};
-                  con->set_body( fc::json::to_string( results ));
-                  con->set_status( websocketpp::http::status_code::not_found );
+                  on_server_thread( [con, body = fc::json::to_string( results )]() mutable {
+                     con->set_body( std::move( body ));
+                     con->set_status( websocketpp::http::status_code::not_found );
+                     con->send_http_response();
+                  } );
                }
             } catch( ... ) {
-               handle_exception<T>( con );
+               on_server_thread( [con, e = std::current_exception()]() {
+                  try {
+                     std::rethrow_exception( e );
+                  } catch( ... ) {
+                     handle_exception<T>( con );
+                  }
+                  con->send_http_response();
+               } );
             }
          }
 
@@ -308,7 +453,7 @@ namespace eosio {
          void create_server_for_endpoint(const tcp::endpoint& ep, websocketpp::server<detail::asio_with_stub_log<T>>& ws) {
             try {
                ws.clear_access_channels(websocketpp::log::alevel::all);
-               ws.init_asio(&app().get_io_service());
+               ws.init_asio(&server_io_service());
                ws.set_reuse_addr(true);
                ws.set_max_http_body_size(max_body_size);
                ws.set_http_handler([&](connection_hdl hdl) {
@@ -400,6 +545,10 @@ namespace eosio {
             ("verbose-http-errors", bpo::bool_switch()->default_value(false), "Append the error log to HTTP responses")
             ("http-validate-host", boost::program_options::value<bool>()->default_value(true), "If set to false, then any incoming \"Host\" header is considered valid")
             ("http-alias", bpo::value<std::vector<string>>()->composing(), "Additionaly acceptable values for the \"Host\" header of incoming HTTP requests, can be specified multiple times.  Includes http/s_server_address by default.")
+            ("http-compression-min-size", bpo::value<uint32_t>()->default_value(0),
+             "Responses of at least this many bytes are sent gzip or deflate encoded to clients accepting it, 0 to never compress")
+            ("http-threads", bpo::value<uint16_t>()->default_value(0),
+             "Number of threads serving http connections, 0 to serve them on the main thread. Request handlers always run on the main thread")
             ;
    }
 
@@ -472,6 +621,12 @@ namespace eosio {
          }
 
          my->max_body_size = options.at( "max-body-size" ).as<uint32_t>();
+         my->compression_min_size = options.at( "http-compression-min-size" ).as<uint32_t>();
+         my->thread_pool_size = options.at( "http-threads" ).as<uint16_t>();
+         if( my->thread_pool_size ) {
+            my->server_ioc = std::make_unique<asio::io_context>();
+            my->server_ioc_work.emplace( asio::make_work_guard( *my->server_ioc ));
+         }
          verbose_http_errors = options.at( "verbose-http-errors" ).as<bool>();
 
          //watch out for the returns above when adding new code here
@@ -501,7 +656,7 @@ namespace eosio {
       if(my->unix_endpoint) {
          try {
             my->unix_server.clear_access_channels(websocketpp::log::alevel::all);
-            my->unix_server.init_asio(&app().get_io_service());
+            my->unix_server.init_asio(&my->server_io_service());
             my->unix_server.set_max_http_body_size(my->max_body_size);
             my->unix_server.listen(*my->unix_endpoint);
             my->unix_server.set_http_handler([&](connection_hdl hdl) {
@@ -541,6 +696,13 @@ namespace eosio {
             throw;
          }
       }
+
+      for( uint16_t i = 0; i < my->thread_pool_size; ++i ) {
+         my->thread_pool.emplace_back( [ioc = my->server_ioc.get(), i]() {
+            chain::thread_registry::instance().register_current_thread( "http-" + std::to_string( i ) );
+            ioc->run();
+         });
+      }
    }
 
    void http_plugin::plugin_shutdown() {
@@ -548,6 +710,13 @@ namespace eosio {
          my->server.stop_listening();
       if(my->https_server.is_listening())
          my->https_server.stop_listening();
+      if( my->server_ioc ) {
+         my->server_ioc_work.reset();
+         my->server_ioc->stop();
+         for( auto& t : my->thread_pool )
+            t.join();
+         my->thread_pool.clear();
+      }
    }
 
    void http_plugin::add_handler(const string& url, const url_handler& handler) {
@@ -610,4 +779,8 @@ namespace eosio {
       return verbose_http_errors;
    }
 
+   const string& http_plugin::client_address()const {
+      return my->current_client_address;
+   }
+
 }
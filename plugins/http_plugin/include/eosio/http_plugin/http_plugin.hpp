@@ -63,9 +63,10 @@ namespace eosio {
     *  thread.  The callback can be called from any thread and will
     *  automatically propagate the call to the http thread.
     *
-    *  The HTTP service will run in its own thread with its own io_service to
-    *  make sure that HTTP request processing does not interfer with other
-    *  plugins.
+    *  With http-threads set, connections are served by a pool of threads
+    *  with its own io_service, so that reading requests and writing
+    *  responses does not interfere with other plugins. Only the handlers
+    *  themselves run on the application thread.
     */
    class http_plugin : public appbase::plugin<http_plugin>
    {
@@ -97,6 +98,9 @@ namespace eosio {
 
         bool verbose_errors()const;
 
+        /// address of the client whose request is being handled, empty unless called from within a url_handler
+        const string& client_address()const;
+
       private:
         std::unique_ptr<class http_plugin_impl> my;
    };
@@ -2,62 +2,140 @@
 
 #include <appbase/application.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
 
 #include "icp_relay.hpp"
 
 namespace icp {
 
+// leading fields of the rows of the icp contract's `block` and `blockstate` tables, which is all the head needs
+struct stored_block_header_prefix {
+   uint64_t pk = 0;
+   block_id_type id;
+   uint32_t block_num = 0;
+};
+
+struct stored_block_header_state_prefix {
+   uint64_t pk = 0;
+   block_id_type id;
+   uint32_t block_num = 0;
+   block_id_type previous;
+   uint32_t dpos_irreversible_blocknum = 0;
+   uint32_t bft_irreversible_blocknum = 0;
+};
+
+}
+
+FC_REFLECT(icp::stored_block_header_prefix, (pk)(id)(block_num))
+FC_REFLECT(icp::stored_block_header_state_prefix, (pk)(id)(block_num)(previous)(dpos_irreversible_blocknum)(bft_irreversible_blocknum))
+
+namespace icp {
+
 using namespace appbase;
 using namespace eosio;
 
 const string ICP_VERSION = "icp-0.0.1";
 
-std::shared_ptr<head> read_only::get_head() const {
+namespace {
+
+/// the first row of table in the order of its secondary index at index_pos (0 for the first secondary index)
+template<typename IndexType, typename Row>
+optional<Row> first_row_by_secondary(const chainbase::database& d, account_name code, name table, uint64_t index_pos) {
+   const uint64_t table_with_index = (uint64_t(table) & 0xFFFFFFFFFFFFFFF0ULL) | index_pos; // see multi_index packing of index name
+   const auto* t_id = d.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, uint64_t(code), table));
+   const auto* index_t_id = d.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, uint64_t(code), name(table_with_index)));
+   if (not t_id or not index_t_id) return optional<Row>();
+
+   const auto& secidx = d.get_index<IndexType, by_secondary>();
+   auto itr = secidx.lower_bound(boost::make_tuple(index_t_id->id));
+   if (itr == secidx.end() or itr->t_id != index_t_id->id) return optional<Row>();
+
+   const auto* obj = d.find<key_value_object, by_scope_primary>(boost::make_tuple(t_id->id, itr->primary_key));
+   if (not obj) return optional<Row>();
+
+   // rows may have more fields than are read here
+   Row row;
+   fc::datastream<const char*> ds(obj->value.data(), obj->value.size());
+   fc::raw::unpack(ds, row);
+   return row;
+}
+
+}
+
+std::shared_ptr<head> read_only::get_head(channel& c) const {
+   if (c.cached_head_) return c.cached_head_;
+
+   const auto& d = app().get_plugin<chain_plugin>().chain().db();
+   const auto code = c.local_contract_;
+
+   auto state = first_row_by_secondary<index128_index, stored_block_header_state_prefix>(d, code, N(blockstate), 3); // libblocknum
+   if (not state) return c.cached_head_ = get_ring_head(c);
+
+   std::shared_ptr<head> h = std::make_shared<head>();
+   h->head_block_num = state->block_num;
+   h->head_block_id = state->id;
+   h->last_irreversible_block_num = std::max(state->dpos_irreversible_blocknum, state->bft_irreversible_blocknum);
+
+   auto block = first_row_by_secondary<index64_index, stored_block_header_prefix>(d, code, N(block), 2); // blocknum
+   if (block) { // TODO: is this right?
+      h->last_irreversible_block_id = block->id;
+   }
+
+   return c.cached_head_ = h;
+}
+
+// Head of the fork store in ring slots mode
+std::shared_ptr<head> read_only::get_ring_head(const channel& c) const {
    auto& chain = app().get_plugin<chain_plugin>();
    auto ro_api = chain.get_read_only_api();
 
    chain_apis::read_only::get_table_rows_params p;
    p.json = true;
-   p.code = relay_->local_contract_;
-   p.scope = relay_->local_contract_.to_string();
-   p.table = "blockstate";
+   p.code = c.local_contract_;
+   p.scope = c.local_contract_.to_string();
+   p.table = "ringhead";
    p.limit = 1;
-   p.key_type = "i128";
-   p.index_position = "5"; // libblocknum
-   auto blockstates = ro_api.get_table_rows(p);
-   if (blockstates.rows.empty()) return nullptr;
+   auto ringhead = ro_api.get_table_rows(p);
+   if (ringhead.rows.empty()) return nullptr;
 
-   auto& row = blockstates.rows.front();
+   auto& row = ringhead.rows.front();
    std::shared_ptr<head> h = std::make_shared<head>();
-   h->head_block_num = static_cast<uint32_t>(row["block_num"].as_uint64());
-   h->head_block_id = block_id_type(row["id"].as_string());
-   h->last_irreversible_block_num = static_cast<uint32_t>(std::max(row["dpos_irreversible_blocknum"].as_uint64(), row["bft_irreversible_blocknum"].as_uint64()));
-
+   h->head_block_num = static_cast<uint32_t>(row["head_block_num"].as_uint64());
+   h->head_block_id = block_id_type(row["head_block_id"].as_string());
+   h->last_irreversible_block_num = static_cast<uint32_t>(row["last_irreversible_block_num"].as_uint64());
+   h->last_irreversible_block_id = block_id_type(row["last_irreversible_block_id"].as_string());
+   return h;
+}
 
-   p.table = "block";
-   p.key_type = "i64";
-   p.index_position = "4"; // blocknum
-   auto blocks = ro_api.get_table_rows(p); // TODO: is this right?
-   if (not blocks.rows.empty()) {
-      h->last_irreversible_block_id = block_id_type(blocks.rows.front()["id"].as_string());
+read_only::get_metrics_results read_only::get_metrics(const get_metrics_params&) const {
+   get_metrics_results r;
+   r.messages = relay_->message_counters_.stats();
+   r.latencies = relay_->latency_stats();
+   // sessions still saying hello belong to no channel yet, and are left out
+   for (auto& c: relay_->channels()) {
+      for (auto& s: relay_->live_sessions(c.get())) {
+         r.sessions.push_back(session_stats{s->session_id_, s->peer_, c->local_contract_, s->queue_depth_.load(), s->max_queue_depth_.load(),
+                                            s->ping_rtt_.stats(), s->counters_.stats()});
+      }
    }
-
-   return h;
+   return r;
 }
 
-read_only::get_info_results read_only::get_info(const get_info_params&) const {
+read_only::get_info_results read_only::get_info(const get_info_params& params) const {
    auto& chain = app().get_plugin<chain_plugin>();
+   auto c = relay_->find_channel(params.local_contract);
+   EOS_ASSERT(c, invalid_http_request, "Unknown icp channel: ${c}", ("c", params.local_contract));
 
    get_info_results info;
    info.icp_version = ICP_VERSION;
    info.local_chain_id = chain.get_chain_id();
-   info.peer_chain_id = relay_->peer_chain_id_;
-   info.local_contract = relay_->local_contract_;
-   info.peer_contract = relay_->peer_contract_;
+   info.peer_chain_id = c->peer_chain_id_;
+   info.local_contract = c->local_contract_;
+   info.peer_contract = c->peer_contract_;
 
    auto ro_api = chain.get_read_only_api();
 
-   auto head = get_head();
+   auto head = get_head(*c);
    if (head) {
       info.head_block_num = head->head_block_num;
       info.head_block_id = head->head_block_id;
@@ -67,8 +145,8 @@ read_only::get_info_results read_only::get_info(const get_info_params&) const {
 
    chain_apis::read_only::get_table_rows_params p;
    p.json = true;
-   p.code = relay_->local_contract_;
-   p.scope = relay_->local_contract_.to_string();
+   p.code = c->local_contract_;
+   p.scope = c->local_contract_.to_string();
    p.table = "storemeter";
    p.limit = 1;
    p.key_type = "";
@@ -105,6 +183,8 @@ read_write::open_channel_results read_write::open_channel(const open_channel_par
    auto& chain = app().get_plugin<chain_plugin>();
    auto& controller = chain.chain();
    auto ro_api = chain.get_read_only_api();
+   auto c = relay_->find_channel(params.local_contract);
+   EOS_ASSERT(c, invalid_http_request, "Unknown icp channel: ${c}", ("c", params.local_contract));
 
    block_state_ptr b;
    optional<uint64_t> block_num;
@@ -133,7 +213,7 @@ read_write::open_channel_results read_write::open_channel(const open_channel_par
 
    auto header = static_cast<const block_header_state&>(*b);
 
-   relay_->open_channel(header);
+   c->open_channel(header);
 
    return open_channel_results{};
 }
@@ -4,6 +4,8 @@
 
 #include <eosio/chain/types.hpp>
 
+#include "metrics.hpp"
+
 namespace icp {
 
 using namespace std;
@@ -11,6 +13,8 @@ using namespace eosio::chain;
 
 class relay; // forward declaration
 using relay_ptr = std::shared_ptr<relay>;
+class channel;
+using channel_ptr = std::shared_ptr<channel>;
 
 struct empty{};
 
@@ -28,9 +32,12 @@ class read_only {
 public:
    explicit read_only(relay_ptr relay) : relay_(std::move(relay)) {}
 
-   std::shared_ptr<head> get_head() const;
+   std::shared_ptr<head> get_head(channel& c) const;
+   std::shared_ptr<head> get_ring_head(const channel& c) const;
 
-   using get_info_params = empty;
+   struct get_info_params {
+      account_name local_contract; // of the channel, the first one if empty
+   };
    struct get_info_results {
       string icp_version;
       chain_id_type local_chain_id;
@@ -56,6 +63,27 @@ public:
    };
    get_info_results get_info(const get_info_params&) const;
 
+   using get_metrics_params = empty;
+   struct latency_stats {
+      string stage;
+      histogram_stats latency;
+   };
+   struct session_stats {
+      int session_id = 0;
+      string peer;
+      account_name local_contract; // of the channel of the session
+      uint32_t queue_depth = 0;
+      uint32_t max_queue_depth = 0;
+      histogram_stats ping_rtt;
+      vector<message_type_stats> messages;
+   };
+   struct get_metrics_results {
+      vector<message_type_stats> messages; // aggregated over all sessions, including closed ones
+      vector<latency_stats> latencies;
+      vector<session_stats> sessions;
+   };
+   get_metrics_results get_metrics(const get_metrics_params&) const;
+
 private:
    relay_ptr relay_;
 };
@@ -66,6 +94,7 @@ public:
 
    struct open_channel_params {
       string seed_block_num_or_id;
+      account_name local_contract; // of the channel, the first one if empty
    };
    using open_channel_results = empty;
    // NB: the `open_channel` api can only be called once
@@ -79,9 +108,13 @@ private:
 
 FC_REFLECT(icp::empty, )
 FC_REFLECT(icp::head, (head_block_num)(head_block_id)(last_irreversible_block_num)(last_irreversible_block_id))
+FC_REFLECT(icp::read_only::get_info_params, (local_contract))
 FC_REFLECT(icp::read_only::get_info_results, (icp_version)(local_chain_id)(peer_chain_id)(local_contract)(peer_contract)
                                              (head_block_num)(head_block_id)(last_irreversible_block_num)(last_irreversible_block_id)
                                              (max_blocks)(current_blocks)(last_outgoing_packet_seq)(last_incoming_packet_seq)
                                              (last_outgoing_receipt_seq)(last_incoming_receipt_seq)
                                              (max_packets)(current_packets))
-FC_REFLECT(icp::read_write::open_channel_params, (seed_block_num_or_id))
+FC_REFLECT(icp::read_only::latency_stats, (stage)(latency))
+FC_REFLECT(icp::read_only::session_stats, (session_id)(peer)(local_contract)(queue_depth)(max_queue_depth)(ping_rtt)(messages))
+FC_REFLECT(icp::read_only::get_metrics_results, (messages)(latencies)(sessions))
+FC_REFLECT(icp::read_write::open_channel_params, (seed_block_num_or_id)(local_contract))
@@ -0,0 +1,125 @@
+#include "cache.hpp"
+
+#include <fc/io/raw.hpp>
+
+namespace icp {
+
+void cache_journal::open(const fc::path& dir) {
+   if (not fc::exists(dir)) fc::create_directories(dir);
+   file_ = dir / "cache.log";
+
+   uint32_t lib = 0;
+   if (fc::exists(file_)) {
+      std::ifstream in(file_.generic_string(), std::ios::binary);
+      uint64_t good_pos = 0;
+      while (in) {
+         uint32_t size = 0;
+         in.read(reinterpret_cast<char*>(&size), sizeof(size));
+         if (in.gcount() != sizeof(size)) break;
+
+         vector<char> data(size);
+         in.read(data.data(), size);
+         if (static_cast<uint32_t>(in.gcount()) != size) break; // torn write at the tail
+
+         cache_record r;
+         try {
+            fc::raw::unpack(data, r);
+         } catch (...) {
+            break;
+         }
+
+         switch (r.which()) {
+            case cache_record::tag<send_transaction>::value: {
+               auto& t = r.get<send_transaction>();
+               if (t.block_num > lib) send_transactions_.insert(std::move(t));
+               break;
+            }
+            case cache_record::tag<block_with_action_digests>::value: {
+               auto& b = r.get<block_with_action_digests>();
+               if (b.block_num > lib) blocks_.insert(std::move(b));
+               break;
+            }
+            case cache_record::tag<irreversible_mark>::value:
+               lib = std::max(lib, r.get<irreversible_mark>().block_num);
+               break;
+         }
+
+         good_pos = static_cast<uint64_t>(in.tellg());
+         ++records_;
+      }
+      in.close();
+
+      if (good_pos != fc::file_size(file_)) {
+         wlog("truncate icp relay cache journal ${f} to ${p} bytes", ("f", file_.generic_string())("p", good_pos));
+         fc::resize_file(file_, good_pos);
+      }
+   }
+
+   // entries below the last mark may still be in the indices if they were replayed before the mark
+   prune(lib);
+   compact();
+   ilog("icp relay cache: ${t} send transactions, ${b} blocks", ("t", send_transactions_.size())("b", blocks_.size()));
+}
+
+void cache_journal::close() {
+   if (out_.is_open()) out_.close();
+}
+
+void cache_journal::append(const send_transaction& t) {
+   write(t);
+}
+
+void cache_journal::append(const block_with_action_digests& b) {
+   write(b);
+}
+
+void cache_journal::prune(uint32_t block_num) {
+   {
+      auto& idx = send_transactions_.get<by_block_num>();
+      idx.erase(idx.begin(), idx.upper_bound(block_num));
+   }
+   {
+      auto& idx = blocks_.get<by_block_num>();
+      idx.erase(idx.begin(), idx.upper_bound(block_num));
+   }
+
+   if (not out_.is_open()) return;
+   write(irreversible_mark{block_num});
+
+   auto live = send_transactions_.size() + blocks_.size();
+   if (records_ > 2 * live + 1024) compact();
+}
+
+void cache_journal::write(const cache_record& r) {
+   if (not out_.is_open()) return;
+   auto data = fc::raw::pack(r);
+   auto size = static_cast<uint32_t>(data.size());
+   out_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+   out_.write(data.data(), data.size());
+   out_.flush();
+   ++records_;
+}
+
+void cache_journal::compact() {
+   close();
+
+   auto tmp = file_;
+   tmp.replace_extension(".tmp");
+   {
+      std::ofstream out(tmp.generic_string(), std::ios::binary | std::ios::trunc);
+      auto write_record = [&](const cache_record& r) {
+         auto data = fc::raw::pack(r);
+         auto size = static_cast<uint32_t>(data.size());
+         out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+         out.write(data.data(), data.size());
+      };
+      for (auto& t: send_transactions_) write_record(t);
+      for (auto& b: blocks_) write_record(b);
+   }
+   fc::rename(tmp, file_);
+
+   records_ = send_transactions_.size() + blocks_.size();
+   out_.open(file_.generic_string(), std::ios::binary | std::ios::app);
+}
+
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <fstream>
+
+#include <fc/filesystem.hpp>
+#include <fc/static_variant.hpp>
 #include <eosio/chain/controller.hpp>
 
 namespace icp {
@@ -36,13 +40,104 @@ typedef boost::multi_index_container<send_transaction,
 
 struct block_with_action_digests {
    block_id_type id;
+   uint32_t block_num = 0;
    vector<digest_type> action_digests;
 };
 
 typedef boost::multi_index_container<block_with_action_digests,
    indexed_by<
-      ordered_unique<tag<by_id>, member<block_with_action_digests, block_id_type, &block_with_action_digests::id>>
+      ordered_unique<tag<by_id>, member<block_with_action_digests, block_id_type, &block_with_action_digests::id>>,
+      ordered_non_unique<tag<by_block_num>, member<block_with_action_digests, uint32_t, &block_with_action_digests::block_num>>
    >
 > block_with_action_digests_index;
 
+struct irreversible_mark {
+   uint32_t block_num = 0;
+};
+
+using cache_record = fc::static_variant<send_transaction, block_with_action_digests, irreversible_mark>;
+
+/**
+ * Append-only journal backing `send_transaction_index` and `block_with_action_digests_index` in the data dir,
+ * so that after restart the relay can still produce proofs for packets in reversible blocks.
+ *
+ * Entries up to an irreversible mark are dropped on replay, and the journal is rewritten with only
+ * the live entries once the dropped ones dominate.
+ */
+class cache_journal {
+public:
+   cache_journal(send_transaction_index& send_transactions, block_with_action_digests_index& blocks)
+      : send_transactions_(send_transactions), blocks_(blocks) {}
+
+   /// Replay the journal file in `dir` into the indices
+   void open(const fc::path& dir);
+   void close();
+
+   void append(const send_transaction& t);
+   void append(const block_with_action_digests& b);
+   /// Erase entries of blocks up to `block_num` from the indices and the journal
+   void prune(uint32_t block_num);
+
+private:
+   void write(const cache_record& r);
+   void compact();
+
+   send_transaction_index& send_transactions_;
+   block_with_action_digests_index& blocks_;
+
+   fc::path file_;
+   std::ofstream out_;
+   uint64_t records_ = 0; // records in the journal file, including dropped ones
+};
+
+/**
+ * Rolling window of the ids of the most recently accepted blocks, addressed by block number.
+ *
+ * Accepting a block whose number is not greater than the newest one (i.e. a fork switch)
+ * drops all ids above it, so the window always reflects the current branch.
+ */
+class recent_block_ids {
+public:
+   explicit recent_block_ids(uint32_t capacity) : ids_(capacity) {}
+
+   void push(const block_id_type& id) {
+      auto num = block_header::num_from_id(id);
+      if (empty() or num > last_num_ + 1 or num < first_num_) {
+         first_num_ = num; // unlinkable, restart the window
+      } else if (num == last_num_ + 1 and num - first_num_ == ids_.size()) {
+         ++first_num_; // full, evict the oldest
+      }
+      last_num_ = num;
+      ids_[num % ids_.size()] = id;
+   }
+
+   bool empty() const { return last_num_ == 0; }
+   bool contains(uint32_t num) const { return not empty() and num >= first_num_ and num <= last_num_; }
+
+   const block_id_type& at(uint32_t num) const {
+      FC_ASSERT(contains(num), "block ${n} not in recent block ids", ("n", num));
+      return ids_[num % ids_.size()];
+   }
+
+   /** Append ids of blocks in [first, last] to `out`, return false if any of them is out of the window */
+   bool slice(uint32_t first, uint32_t last, vector<block_id_type>& out) const {
+      if (first > last) return true;
+      if (not contains(first) or not contains(last)) return false;
+      out.reserve(out.size() + last - first + 1);
+      for (auto n = first; n <= last; ++n) {
+         out.push_back(ids_[n % ids_.size()]);
+      }
+      return true;
+   }
+
+private:
+   vector<block_id_type> ids_;
+   uint32_t first_num_ = 0;
+   uint32_t last_num_ = 0;
+};
+
 }
+
+FC_REFLECT(icp::send_transaction, (id)(block_num)(peer_actions)(actions)(action_receipts))
+FC_REFLECT(icp::block_with_action_digests, (id)(block_num)(action_digests))
+FC_REFLECT(icp::irreversible_mark, (block_num))
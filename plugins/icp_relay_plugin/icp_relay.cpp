@@ -1,5 +1,10 @@
 #include "icp_relay.hpp"
 
+#include <algorithm>
+
+#include <eosio/chain/plugin_interface.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
+#include <eosio/chain/thread_registry.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <fc/io/json.hpp>
 
@@ -51,7 +56,7 @@ void listener::on_accept(boost::system::error_code ec) {
 
    try {
       auto s = std::make_shared<session>(move(socket_), relay_);
-      relay_->async_add_session(s);
+      relay_->add_session(s);
       s->do_accept();
    } catch (std::exception& e) {
       socket_.close();
@@ -61,6 +66,12 @@ void listener::on_accept(boost::system::error_code ec) {
 }
 
 void relay::start() {
+   ioc_ = std::make_unique<boost::asio::io_context>(num_threads_);
+
+   for (auto& c: channels_) {
+      c->start();
+   }
+
    on_applied_transaction_handle_ = app().get_channel<channels::applied_transaction>().subscribe([this](transaction_trace_ptr t) {
       on_applied_transaction(t);
    });
@@ -77,9 +88,7 @@ void relay::start() {
       on_bad_block(b);
    });
 
-   ioc_ = std::make_unique<boost::asio::io_context>(num_threads_);
-
-   timer_ = std::make_shared<boost::asio::deadline_timer>(app().get_io_service());
+   timer_ = std::make_shared<boost::asio::deadline_timer>(*ioc_);
    start_reconnect_timer();
 
    auto address = boost::asio::ip::make_address(endpoint_address_);
@@ -89,19 +98,26 @@ void relay::start() {
    socket_threads_.reserve(num_threads_);
    for (auto i = 0; i < num_threads_; ++i) {
       socket_threads_.emplace_back([this, i] {
+         thread_registry::instance().register_current_thread("icp-relay-" + std::to_string(i));
          wlog("start thread ${i}", ("i", i));
          ioc_->run();
          wlog("stop thread ${i}", ("i", i));
       });
    }
 
-   for (const auto& peer: connect_to_peers_) {
-      auto s = std::make_shared<session>(peer, *ioc_, shared_from_this());
-      sessions_[s.get()] = s;
-      s->do_connect();
+   for (auto& c: channels_) {
+      for (const auto& peer: c->connect_to_peers_) {
+         connect(peer, c);
+      }
    }
 }
 
+void relay::connect(const string& peer, const channel_ptr& c) {
+   auto s = std::make_shared<session>(peer, *ioc_, shared_from_this(), c);
+   add_session(s, c.get());
+   s->do_connect();
+}
+
 void relay::stop() {
    try {
       timer_->cancel();
@@ -127,6 +143,10 @@ void relay::stop() {
    for_each_session([](auto session) {
       EOS_ASSERT(false, plugin_exception, "session ${s} still active", ("s", session->session_id_));
    });
+
+   for (auto& c: channels_) {
+      c->stop();
+   }
 }
 
 void relay::start_reconnect_timer() {
@@ -139,23 +159,21 @@ void relay::start_reconnect_timer() {
          return;
       }
 
-      verify_strand_in_this_thread(app().get_io_service().get_executor(), __func__, __LINE__);
-
-      for (const auto& peer: connect_to_peers_) {
-         bool found = false;
-         for (const auto& s: sessions_ ) {
-            auto ses = s.second.lock();
-            if( ses && (ses->peer_ == peer) ) {
-               found = true;
-               break;
+      for (auto& c: channels_) {
+         auto sessions = live_sessions(c.get());
+         for (const auto& peer: c->connect_to_peers_) {
+            bool found = false;
+            for (const auto& ses: sessions) {
+               if (ses->peer_ == peer) {
+                  found = true;
+                  break;
+               }
             }
-         }
 
-         if (not found) {
-            wlog("attempt to connect to ${p}", ("p", peer));
-            auto s = std::make_shared<session>(peer, *ioc_, shared_from_this());
-            sessions_[s.get()] = s;
-            s->do_connect();
+            if (not found) {
+               wlog("attempt to connect to ${p} for channel ${c}", ("p", peer)("c", c->local_contract_));
+               connect(peer, c);
+            }
          }
       }
 
@@ -163,60 +181,184 @@ void relay::start_reconnect_timer() {
    });
 }
 
-void relay::async_add_session(std::weak_ptr<session> s) {
-   app().get_io_service().post([s, this] {
-      if (auto l = s.lock()) {
-         sessions_[l.get()] = s;
-      }
-   });
+void relay::add_channel(const channel_ptr& c) {
+   FC_ASSERT(channels_by_contract_.emplace(c->local_contract_, c).second, "duplicate icp channel of local contract ${c}", ("c", c->local_contract_));
+   channels_.push_back(c);
+}
+
+channel_ptr relay::find_channel(account_name local_contract) const {
+   if (local_contract.empty()) return channels_.empty() ? nullptr : channels_.front();
+   auto it = channels_by_contract_.find(local_contract);
+   return it == channels_by_contract_.end() ? nullptr : it->second;
+}
+
+channel_ptr relay::find_channel(const hello& hi) const {
+   auto c = find_channel(hi.peer_contract);
+   return c and c->matches(hi) ? c : nullptr;
+}
+
+void relay::add_session(std::weak_ptr<session> s, const channel* c) {
+   if (auto l = s.lock()) {
+      std::lock_guard<std::mutex> g(sessions_mtx_);
+      sessions_[l.get()] = std::make_pair(s, c);
+   }
+}
+
+void relay::bind_session(const session* s, const channel* c) {
+   std::lock_guard<std::mutex> g(sessions_mtx_);
+   auto itr = sessions_.find(s);
+   if (itr != sessions_.end()) {
+      itr->second.second = c;
+   }
 }
 
 void relay::on_session_close(const session* s) {
-   verify_strand_in_this_thread(app().get_io_service().get_executor(), __func__, __LINE__);
+   std::lock_guard<std::mutex> g(sessions_mtx_);
    auto itr = sessions_.find(s);
    if (itr != sessions_.end()) {
       sessions_.erase(itr);
    }
 }
 
-void relay::for_each_session(std::function<void (session_ptr)> callback) {
-   app().get_io_service().post([this, callback = callback] {
-      for (const auto& item : sessions_) {
-         if (auto ses = item.second.lock()) {
-            ses->post([ses, callback = callback]() {
-               callback(ses);
-            });
-         }
+// The returned sessions may be the last owners, so they must be released out of the lock
+vector<session_ptr> relay::live_sessions(const channel* c) {
+   vector<session_ptr> sessions;
+   std::lock_guard<std::mutex> g(sessions_mtx_);
+   sessions.reserve(sessions_.size());
+   for (const auto& item : sessions_) {
+      if (c and item.second.second != c) continue;
+      if (auto ses = item.second.first.lock()) {
+         sessions.push_back(std::move(ses));
       }
-   });
+   }
+   return sessions;
+}
+
+void relay::for_each_session(std::function<void (session_ptr)> callback, const channel* c) {
+   for (const auto& ses : live_sessions(c)) {
+      ses->post([ses, callback]() {
+         callback(ses);
+      });
+   }
+}
+
+void relay::on_applied_transaction(const transaction_trace_ptr& t) {
+   // one pass for all channels, so that only the channels whose contract the transaction ran go through it again
+   flat_set<channel*> targets;
+   for (auto& action: t->action_traces) {
+      if (action.receipt.receiver != action.act.account) continue;
+      auto it = channels_by_contract_.find(action.act.account);
+      if (it != channels_by_contract_.end()) targets.insert(it->second.get());
+   }
+
+   for (auto c: targets) {
+      c->on_applied_transaction(t);
+   }
+}
+
+void relay::on_accepted_block(const block_state_with_action_digests_ptr& b) {
+   recent_block_ids_.push(b->block_state->id); // shared by all channels
+
+   for (auto& c: channels_) {
+      c->on_accepted_block(b);
+   }
+}
+
+void relay::on_irreversible_block(const block_state_ptr& s) {
+   for (auto& c: channels_) {
+      c->on_irreversible_block(s);
+   }
+}
+
+void relay::on_bad_block(const signed_block_ptr& b) {
+}
+
+// Ids of blocks in [first_num, end_num)
+vector<block_id_type> relay::get_merkle_path(uint32_t first_num, uint32_t end_num) const {
+   vector<block_id_type> merkle_path;
+   if (end_num == 0 or recent_block_ids_.slice(first_num, end_num - 1, merkle_path)) return merkle_path;
+
+   // fall back to the chain for blocks accepted before the window was filled
+   auto& chain = app().get_plugin<chain_plugin>().chain();
+   merkle_path.clear();
+   for (uint32_t i = first_num; i < end_num; ++i) {
+      merkle_path.push_back(recent_block_ids_.contains(i) ? recent_block_ids_.at(i) : chain.get_block_id_for_num(i));
+   }
+   return merkle_path;
+}
+
+void relay::record_latency(const string& stage, fc::microseconds d) {
+   latencies_[stage].record(d);
+}
+
+vector<read_only::latency_stats> relay::latency_stats() const {
+   vector<read_only::latency_stats> result;
+   for (auto& l: latencies_) {
+      result.push_back(read_only::latency_stats{l.first, l.second.stats()});
+   }
+   return result;
+}
+
+void channel::start() {
+   send_strand_ = std::make_unique<strand_type>(relay_.ioc_->get_executor());
+   cache_journal_.open(cache_dir_);
 }
 
-void relay::send(const icp_message& msg) {
-   for_each_session([m=msg](session_ptr s) mutable {
-      s->buffer_send(move(m));
+void channel::stop() {
+   cache_journal_.close();
+}
+
+void channel::send(icp_message msg) {
+   // pack on the relay threads, off the application thread, one at a time so that the sessions get them in order
+   boost::asio::post(*send_strand_, [this, msg=std::move(msg)] {
+      broadcast(msg);
    });
 }
 
-void relay::open_channel(const block_header_state& seed) {
+void channel::broadcast(const icp_message& msg) {
+   auto frame = make_frame(msg); // pack once, shared by all sessions
+   relay_.for_each_session([frame](session_ptr s) {
+      s->buffer_send(frame);
+   }, this);
+}
+
+head channel::get_peer_head() const {
+   std::lock_guard<std::mutex> g(peer_head_mtx_);
+   return peer_head_;
+}
+
+void channel::set_peer_head(const head& h) {
+   std::lock_guard<std::mutex> g(peer_head_mtx_);
+   if (sent_block_num_ > peer_head_.head_block_num and h.head_block_num >= sent_block_num_) {
+      auto d = fc::time_point::now() - sent_time_;
+      headers_round_trip_ = headers_round_trip_.count() ? (headers_round_trip_ * 3 + d) / 4 : d; // smoothed
+   }
+   peer_head_ = h;
+}
+
+void channel::open_channel(const block_header_state& seed) {
    send(channel_seed{seed});
 }
 
-void relay::on_applied_transaction(const transaction_trace_ptr& t) {
+void channel::on_applied_transaction(const transaction_trace_ptr& t) {
    vector<action_name> peer_actions;
    vector<action> actions;
    vector<action_receipt> action_receipts;
    for (auto& action: t->action_traces) {
       if (not (action.act.account == local_contract_ and action.receipt.receiver == action.act.account)) continue;
 
+      // addblocks moves the head, the other actions may prune the tables it is read from
+      cached_head_.reset();
+
       if (action.act.name == ACTION_ADDBLOCKS) {
-         app().get_io_service().post([this] {
+         app_post(priority::low, [this] {
             // update local head
-            auto head = get_read_only_api().get_head();
+            auto head = relay_.get_read_only_api().get_head(*this);
             if (head) {
                local_head_ = *head;
-               for_each_session([h=*head](session_ptr s) {
+               relay_.for_each_session([h=*head](session_ptr s) {
                   s->local_head_ = h;
-               });
+               }, this);
             }
          });
       }
@@ -259,92 +401,219 @@ void relay::on_applied_transaction(const transaction_trace_ptr& t) {
    if (peer_actions.empty()) return;
 
    auto it = send_transactions_.find(t->id);
-   if (it == send_transactions_.end()) return; // TODO
-   send_transactions_.insert(send_transaction{t->id, t->block_num, peer_actions, actions, action_receipts});
+   if (it != send_transactions_.end()) return;
+   send_transaction st{t->id, t->block_num, peer_actions, actions, action_receipts};
+   cache_journal_.append(st);
+   send_transactions_.insert(std::move(st));
 }
 
-constexpr uint32_t MAX_CACHED_BLOCKS = 1000;
-constexpr uint32_t MIN_CACHED_BLOCKS = 100;
-
-void relay::on_accepted_block(const block_state_with_action_digests_ptr& b) {
+void channel::on_accepted_block(const block_state_with_action_digests_ptr& b) {
    bool must_send = false;
-   bool may_send = false;
 
    auto& s = b->block_state;
+   auto peer_head = get_peer_head();
 
    // new pending schedule
    if (s->header.new_producers.valid()) {
       must_send = true;
       pending_schedule_version_ = s->pending_schedule.version;
+      schedule_blocks_.push_back(s);
    }
 
    // new active schedule
    if (s->active_schedule.version == pending_schedule_version_) {
       must_send = true;
       pending_schedule_version_ = 0; // reset
+      if (schedule_blocks_.empty() or schedule_blocks_.back() != s) schedule_blocks_.push_back(s);
    }
 
+   uint32_t packets = 0;
    for (auto& t: s->trxs) {
-      auto it = send_transactions_.find(t->id);
-      if (it != send_transactions_.end()) {
-         may_send = true;
-
-         if (block_with_action_digests_.find(s->id) == block_with_action_digests_.end()) {
-            block_with_action_digests_.insert(block_with_action_digests{s->id, b->action_digests});
-         }
+      if (send_transactions_.find(t->id) == send_transactions_.end()) continue;
+      ++packets;
 
-         break;
+      if (block_with_action_digests_.find(s->id) == block_with_action_digests_.end()) {
+         block_with_action_digests bd{s->id, s->block_num, *b->action_digests};
+         cache_journal_.append(bd);
+         block_with_action_digests_.insert(std::move(bd));
       }
    }
+   if (packets) {
+      if (not pending_packets_) pending_since_ = s->block_num;
+      pending_packets_ += packets;
+   }
 
-   if (not must_send and s->block_num >= peer_head_.head_block_num) {
-      auto lag = s->block_num - peer_head_.head_block_num;
-      if ((may_send and lag >= MIN_CACHED_BLOCKS) or lag >= MAX_CACHED_BLOCKS) {
-         must_send = true;
-      }
+   if (not must_send and s->block_num >= peer_head.head_block_num) {
+      must_send = headers_due(s->block_num, peer_head);
    }
 
    if (must_send) {
-      auto& chain = app().get_plugin<chain_plugin>();
-      vector<block_id_type> merkle_path;
-      for (uint32_t i = peer_head_.head_block_num + 1; i < s->block_num; ++i) {
-         merkle_path.push_back(chain.chain().get_block_id_for_num(i));
-      }
+      send_block_headers(s, peer_head);
+   }
+}
 
-      send(block_header_with_merkle_path{*s, merkle_path});
+bool channel::headers_due(uint32_t block_num, const head& peer_head) const {
+   auto& cadence = relay_.header_cadence_;
+   if (block_num - peer_head.head_block_num >= cadence.max_lag) return true;
+   if (not pending_packets_) return false;
+
+   {
+      // let the run on its way reach the peer first, for as long as runs usually take
+      std::lock_guard<std::mutex> g(peer_head_mtx_);
+      if (sent_block_num_ > peer_head.head_block_num and fc::time_point::now() - sent_time_ < headers_round_trip_) return false;
    }
+
+   return block_num - pending_since_ >= cadence.max_packet_delay or
+          (cadence.packet_batch and pending_packets_ >= cadence.packet_batch);
 }
 
-void relay::on_irreversible_block(const block_state_ptr& s) {
+void channel::send_block_headers(const block_state_ptr& s, const head& peer_head) {
+   pending_packets_ = 0;
+   {
+      std::lock_guard<std::mutex> g(peer_head_mtx_);
+      sent_block_num_ = s->block_num;
+      sent_time_ = fc::time_point::now();
+   }
+
+   while (not schedule_blocks_.empty() and schedule_blocks_.front()->block_num <= peer_head.head_block_num) {
+      schedule_blocks_.pop_front(); // already got by the peer
+   }
+
+   // schedule changing blocks cannot be skipped, so if the peer lags behind them, send them along in one run
+   vector<block_state_ptr> run;
+   for (auto& b: schedule_blocks_) {
+      if (run.size() >= MAX_HEADERS_PER_RUN) break;
+      if (b->block_num < s->block_num) run.push_back(b);
+   }
+   if (run.size() < MAX_HEADERS_PER_RUN) run.push_back(s);
+
+   if (run.size() == 1) {
+      send(block_header_with_merkle_path{*s, relay_.get_merkle_path(peer_head.head_block_num + 1, s->block_num)});
+      return;
+   }
+
+   block_headers_with_merkle_paths headers;
+   headers.block_headers.reserve(run.size());
+   headers.merkle_paths.reserve(run.size());
+   auto first_num = peer_head.head_block_num + 1;
+   for (auto& b: run) {
+      headers.block_headers.push_back(*b);
+      headers.merkle_paths.push_back(relay_.get_merkle_path(first_num, b->block_num));
+      first_num = b->block_num + 1;
+   }
+   send(std::move(headers));
+}
+
+void channel::on_irreversible_block(const block_state_ptr& s) {
    vector<send_transaction> txs;
    for (auto& t: s->trxs) {
       auto it = send_transactions_.find(t->id);
       if (it != send_transactions_.end()) txs.push_back(*it);
    }
 
-   if (txs.empty()) return;
-   
+   vector<digest_type> digests;
    auto bit = block_with_action_digests_.find(s->id);
-   if (bit == block_with_action_digests_.end()) {
+   bool found = bit != block_with_action_digests_.end();
+   if (found) digests = bit->action_digests;
+
+   // nothing at or below this block is needed anymore, neither in memory nor in the journal
+   cache_journal_.prune(s->block_num);
+
+   if (txs.empty()) return;
+
+   relay_.record_latency("irreversible", fc::time_point::now() - s->header.timestamp.to_time_point());
+
+   if (not found) {
       elog("cannot find block action digests: block id ${id}", ("id", s->id));
       return;
    }
 
    icp_actions ia;
    ia.block_header = static_cast<block_header>(s->header);
-   ia.action_digests = bit->action_digests;
    for (auto& t: txs) {
       ia.peer_actions.insert(ia.peer_actions.end(), t.peer_actions.cbegin(), t.peer_actions.cend());
       ia.actions.insert(ia.actions.end(), t.actions.cbegin(), t.actions.cend());
       ia.action_receipts.insert(ia.action_receipts.end(), t.action_receipts.cbegin(), t.action_receipts.cend());
    }
-   send(ia);
+
+   if (not relay_.compact_proofs_) {
+      ia.action_digests = std::move(digests);
+      send(std::move(ia));
+      return;
+   }
+
+   // prepare the proofs on the relay threads, after what was sent before and before what is sent after
+   boost::asio::post(*send_strand_, [this, ia=std::move(ia), digests=std::move(digests), id=s->id, batch=relay_.batch_packets_]() mutable {
+      vector<uint64_t> indices;
+      indices.reserve(ia.action_receipts.size());
+      for (auto& r: ia.action_receipts) {
+         auto it = std::find(digests.cbegin(), digests.cend(), r.digest());
+         if (it == digests.cend()) {
+            elog("cannot find action receipt digest: block id ${id}", ("id", id));
+            return;
+         }
+         indices.push_back(static_cast<uint64_t>(it - digests.cbegin()));
+      }
+
+      // a single packet gains nothing from a batch
+      if (not batch or std::count(ia.peer_actions.cbegin(), ia.peer_actions.cend(), ACTION_ONPACKET) < 2) {
+         icp_compact_actions ica;
+         ica.block_header = std::move(ia.block_header);
+         ica.peer_actions = std::move(ia.peer_actions);
+         ica.actions = std::move(ia.actions);
+         ica.action_receipts = std::move(ia.action_receipts);
+         ica.merkle_branches = merkle_branches(std::move(digests), indices);
+         ica.index_bitmaps = std::move(indices);
+         broadcast(icp_message(std::move(ica)));
+         return;
+      }
+
+      icp_batched_actions iba;
+      auto& others = iba.others;
+      others.block_header = std::move(ia.block_header);
+      vector<size_t> packets;
+      for (size_t i = 0; i < ia.peer_actions.size(); ++i) {
+         if (ia.peer_actions[i] == ACTION_ONPACKET) {
+            packets.push_back(i);
+            continue;
+         }
+         others.peer_actions.push_back(ia.peer_actions[i]);
+         others.actions.push_back(std::move(ia.actions[i]));
+         others.action_receipts.push_back(std::move(ia.action_receipts[i]));
+         others.index_bitmaps.push_back(indices[i]);
+      }
+      others.merkle_branches = merkle_branches(digests, others.index_bitmaps);
+
+      // the proof walks the leaves in tree order, which is also the order of their sequences
+      std::sort(packets.begin(), packets.end(), [&](size_t a, size_t b) { return indices[a] < indices[b]; });
+      for (auto i: packets) {
+         iba.packets.push_back(std::move(ia.actions[i]));
+         iba.packet_receipts.push_back(std::move(ia.action_receipts[i]));
+         iba.leaf_indices.push_back(indices[i]);
+      }
+      iba.leaf_count = digests.size();
+      iba.merkle_proof = merkle_multiproof(std::move(digests), iba.leaf_indices);
+      broadcast(icp_message(std::move(iba)));
+   });
 }
 
-void relay::on_bad_block(const signed_block_ptr& b) {
+bool channel::is_linkable(uint32_t first_num) {
+   auto head = relay_.get_read_only_api().get_head(*this);
+
+   if (not head) {
+      elog("local head not found, maybe icp channel not opened");
+      return false;
+   }
+
+   if (first_num != head->head_block_num + 1) {
+      elog("unlinkable block: has ${has}, got ${got}", ("has", head->head_block_num)("got", first_num));
+      return false;
+   }
+
+   return true;
 }
 
-void relay::push_transaction(vector<action> actions, packed_transaction::compression_type compression) {
+void channel::push_transaction(vector<action> actions, packed_transaction::compression_type compression) {
    auto& chain = app().get_plugin<chain_plugin>();
 
    signed_transaction trx;
@@ -354,37 +623,51 @@ void relay::push_transaction(vector<action> actions, packed_transaction::compres
       a.authorization = signer_;
    }
 
-   trx.expiration = chain.chain().head_block_time() + tx_expiration_;
+   trx.expiration = chain.chain().head_block_time() + relay_.tx_expiration_;
    trx.set_reference_block(chain.chain().last_irreversible_block_id());
-   trx.max_cpu_usage_ms = tx_max_cpu_usage_;
-   trx.max_net_usage_words = (tx_max_net_usage_ + 7)/8;
-   trx.delay_sec = delaysec_;
+   trx.max_cpu_usage_ms = relay_.tx_max_cpu_usage_;
+   trx.max_net_usage_words = (relay_.tx_max_net_usage_ + 7)/8;
+   trx.delay_sec = relay_.delaysec_;
 
    auto pp = app().find_plugin<producer_plugin>();
    FC_ASSERT(pp and pp->get_state() == abstract_plugin::started, "producer_plugin not found");
 
    if (signer_required_keys_.empty()) {
       auto available_keys = pp->get_producer_keys();
-      auto ro_api = chain.get_read_only_api();
-      fc::variant v{static_cast<const transaction&>(trx)};
-      signer_required_keys_ = ro_api.get_required_keys(chain_apis::read_only::get_required_keys_params{v, available_keys}).required_keys;
+      signer_required_keys_ = chain.chain().get_authorization_manager().get_required_keys(trx, available_keys, fc::seconds(trx.delay_sec));
    }
 
+   // the signature providers record their latency unguarded, so they are only called on the application thread
    auto digest = trx.sig_digest(chain.get_chain_id(), trx.context_free_data);
    for (auto& k: signer_required_keys_) {
       trx.signatures.push_back(pp->sign_compact(k, digest));
    }
 
-   auto packet_tx = fc::mutable_variant_object(packed_transaction(trx, compression));
-   auto rw_api = chain.get_read_write_api();
-   rw_api.push_transaction(fc::variant_object(packet_tx), [](const fc::static_variant<fc::exception_ptr, chain_apis::read_write::push_transaction_results>& result) {
+   push_queue_.push_back(std::make_shared<packed_transaction>(trx, compression));
+   push_next();
+}
+
+void channel::push_next() {
+   // the contract only accepts addblocks and the packets that follow them in order, so each transaction waits for
+   // the one pushed before it, which the chain may otherwise apply after it once their keys are recovered
+   if (pushing_ or push_queue_.empty()) return;
+   pushing_ = true;
+   auto ptrx = std::move(push_queue_.front());
+   push_queue_.pop_front();
+
+   app().get_method<incoming::methods::transaction_async>()(ptrx, false, [self=shared_from_this(), id=ptrx->id()](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
       if (result.contains<fc::exception_ptr>()) {
-         result.get<fc::exception_ptr>()->dynamic_rethrow_exception();
+         elog("transaction ${id} failed: ${e}", ("id", id)("e", result.get<fc::exception_ptr>()->to_detail_string()));
       } else {
-         auto& r = result.get<chain_apis::read_write::push_transaction_results>();
-         wlog("transaction ${id}: ${processed}", ("id", r.transaction_id)("processed", fc::json::to_string(r.processed)));
+         auto& trace = result.get<transaction_trace_ptr>();
+         dlog("transaction ${id}: elapsed ${e}us", ("id", id)("e", trace->elapsed.count()));
          // TODO
       }
+      // not from within the callback, which may run before transaction_async returns
+      app_post(priority::low, [self] {
+         self->pushing_ = false;
+         self->push_next();
+      });
    });
 }
 
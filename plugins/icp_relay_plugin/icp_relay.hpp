@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
@@ -38,6 +39,92 @@ private:
    relay_ptr relay_;
 };
 
+constexpr uint32_t MAX_CACHED_BLOCKS = 1000;
+constexpr uint32_t MIN_CACHED_BLOCKS = 100;
+constexpr uint32_t MAX_HEADERS_PER_RUN = 16;
+
+/**
+ * When to send block headers to the peer, apart from schedule changing blocks which are always sent at once.
+ * Headers are sent once a packet has waited `max_packet_delay` blocks for them or `packet_batch` packets wait,
+ * and without packets once the peer lags `max_lag` blocks behind. While a run is on its way, packets wait for
+ * it as long as the peer took to apply the previous ones, so a peer slow at addblocks gets fewer, longer runs.
+ */
+struct header_cadence {
+   uint32_t max_packet_delay = MIN_CACHED_BLOCKS; // blocks
+   uint32_t max_lag = MAX_CACHED_BLOCKS; // blocks
+   uint32_t packet_batch = 0; // 0 to only go by `max_packet_delay`
+};
+
+/**
+ * One icp channel: the local icp contract, its counterpart on the peer chain, and everything the relay keeps
+ * to serve it. All channels of a relay share its sessions threads, its accepted block processing and its ring
+ * of recent block ids.
+ */
+class channel : public std::enable_shared_from_this<channel> {
+public:
+   explicit channel(relay& r) : relay_(r) {}
+
+   void start();
+   void stop();
+
+   /// Broadcast to the sessions of this channel
+   void send(icp_message msg);
+
+   void open_channel(const block_header_state& seed);
+   void push_transaction(vector<action> actions, packed_transaction::compression_type compression = packed_transaction::none); // only call on app io_service
+   bool is_linkable(uint32_t first_num); // only call on app io_service
+
+   /// Whether a peer relay saying hello serves the other end of this channel
+   bool matches(const hello& hi) const { return hi.contract == peer_contract_ and hi.peer_contract == local_contract_; }
+
+   head get_peer_head() const;
+   void set_peer_head(const head& h);
+
+   void on_applied_transaction(const transaction_trace_ptr& t);
+   void on_accepted_block(const block_state_with_action_digests_ptr& b);
+   void on_irreversible_block(const block_state_ptr& s);
+
+   account_name local_contract_;
+   account_name peer_contract_;
+   chain_id_type peer_chain_id_;
+   vector<chain::permission_level> signer_;
+   flat_set<public_key_type> signer_required_keys_;
+   std::vector<std::string> connect_to_peers_;
+   fc::path cache_dir_;
+
+   head local_head_; // only access on app io_service
+   std::shared_ptr<head> cached_head_; // read_only::get_head until the next action of the local contract, only access on app io_service
+
+private:
+   void broadcast(const icp_message& msg); // only call on `send_strand_`
+   void push_next(); // only call on app io_service
+   bool headers_due(uint32_t block_num, const head& peer_head) const;
+   void send_block_headers(const block_state_ptr& s, const head& peer_head);
+
+   relay& relay_;
+
+   using strand_type = boost::asio::strand<boost::asio::io_context::executor_type>;
+   std::unique_ptr<strand_type> send_strand_; // packs the messages and proofs sent, in order, on the relay threads
+
+   mutable std::mutex peer_head_mtx_;
+   head peer_head_; // guarded by `peer_head_mtx_`
+   uint32_t sent_block_num_ = 0; // of the last header sent, guarded by `peer_head_mtx_`
+   fc::time_point sent_time_; // guarded by `peer_head_mtx_`
+   fc::microseconds headers_round_trip_; // from sending headers until the peer reports them as its head, guarded by `peer_head_mtx_`
+
+   uint32_t pending_packets_ = 0; // in blocks whose headers have not been sent since
+   uint32_t pending_since_ = 0; // block number of the oldest of them
+
+   send_transaction_index send_transactions_;
+   block_with_action_digests_index block_with_action_digests_;
+   cache_journal cache_journal_{send_transactions_, block_with_action_digests_};
+   uint32_t pending_schedule_version_ = 0;
+   deque<block_state_ptr> schedule_blocks_; // schedule changing blocks which the peer may not have got yet
+
+   deque<packed_transaction_ptr> push_queue_; // signed, waiting for the transaction pushed before them, only access on app io_service
+   bool pushing_ = false; // a transaction was pushed and has not been answered yet, only access on app io_service
+};
+
 class relay : public std::enable_shared_from_this<relay> {
 public:
    void start();
@@ -48,45 +135,52 @@ public:
 
    void start_reconnect_timer();
 
-   void async_add_session(std::weak_ptr<session> s);
-   void on_session_close(const session* s);
-
-   void for_each_session(std::function<void (session_ptr)> callback);
-   void send(const icp_message& msg);
+   void add_channel(const channel_ptr& c); // only call before start
+   const vector<channel_ptr>& channels() const { return channels_; }
+   channel_ptr find_channel(account_name local_contract) const; // the first channel if `local_contract` is empty
+   channel_ptr find_channel(const hello& hi) const;
 
-   // void send_icp_transaction();
+   void add_session(std::weak_ptr<session> s, const channel* c = nullptr);
+   void bind_session(const session* s, const channel* c); // incoming sessions, once their channel is known
+   void on_session_close(const session* s);
 
-   void open_channel(const block_header_state& seed);
-   void push_transaction(vector<action> actions, packed_transaction::compression_type compression = packed_transaction::none);
+   vector<session_ptr> live_sessions(const channel* c = nullptr); // of all channels if `c` is null
+   void for_each_session(std::function<void (session_ptr)> callback, const channel* c = nullptr);
 
    std::string endpoint_address_;
    std::uint16_t endpoint_port_;
    std::uint32_t num_threads_ = 1;
-   std::vector<std::string> connect_to_peers_;
+   bool compact_proofs_ = false;
+   bool batch_packets_ = false;
+   bool compress_ = true;
+   uint32_t frame_batch_bytes_ = 0; // 0 sends one websocket message for each icp message
+   header_cadence header_cadence_;
 
    public_key_type id_ = fc::crypto::private_key::generate().get_public_key(); // random key to identify this process
-   account_name local_contract_;
-   account_name peer_contract_;
-   chain_id_type peer_chain_id_;
-   vector<chain::permission_level> signer_;
-   flat_set<public_key_type> signer_required_keys_;
 
-   head peer_head_;
+   void record_latency(const string& stage, fc::microseconds d); // only call on app io_service
+   vector<read_only::latency_stats> latency_stats() const; // only call on app io_service
+
+   message_counters message_counters_; // aggregated over all sessions
 
 private:
+   friend class channel;
+
+   void connect(const string& peer, const channel_ptr& c);
+
    void on_applied_transaction(const transaction_trace_ptr& t);
    void on_accepted_block(const block_state_with_action_digests_ptr& b);
    void on_irreversible_block(const block_state_ptr& s);
    void on_bad_block(const signed_block_ptr& b);
 
-   // void push_icp_transaction();
-   // void cache_transaction();
+   vector<block_id_type> get_merkle_path(uint32_t first_num, uint32_t end_num) const;
 
    std::unique_ptr<boost::asio::io_context> ioc_;
    std::vector<std::thread> socket_threads_;
    std::shared_ptr<listener> listener_;
-   std::shared_ptr<boost::asio::deadline_timer> timer_; // only access on app io_service
-   std::map<const session*, std::weak_ptr<session>> sessions_; // only access on app io_service
+   std::shared_ptr<boost::asio::deadline_timer> timer_; // only access on relay io_context
+   std::mutex sessions_mtx_;
+   std::map<const session*, std::pair<std::weak_ptr<session>, const channel*>> sessions_; // guarded by `sessions_mtx_`
 
    channels::applied_transaction::channel_type::handle on_applied_transaction_handle_;
    channels::accepted_block_with_action_digests::channel_type::handle on_accepted_block_handle_;
@@ -98,11 +192,11 @@ private:
    uint32_t tx_max_net_usage_ = 0;
    uint32_t delaysec_ = 0;
 
-   send_transaction_index send_transactions_;
-   block_with_action_digests_index block_with_action_digests_;
-   uint32_t pending_schedule_version_ = 0;
+   vector<channel_ptr> channels_; // in configuration order, fixed once started
+   flat_map<account_name, channel_ptr> channels_by_contract_;
+   recent_block_ids recent_block_ids_{MAX_CACHED_BLOCKS};
 
-   head local_head_;
+   std::map<string, latency_histogram> latencies_; // by relaying stage, sendaction to onpacket etc.
 };
 
 }
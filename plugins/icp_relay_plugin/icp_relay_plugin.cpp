@@ -36,11 +36,19 @@ void icp_relay_plugin::set_program_options(options_description&, options_descrip
     cfg.add_options()
        ("icp-relay-endpoint", bpo::value<string>()->default_value("0.0.0.0:8765"), "The endpoint upon which to listen for incoming connections")
        ("icp-relay-threads", bpo::value<uint32_t>(), "The number of threads to use to process network messages")
-       ("icp-relay-connect", bpo::value<vector<string>>()->composing(), "Remote endpoint of other node to connect to (may specify multiple times)")
+       ("icp-relay-connect", bpo::value<vector<string>>()->composing(), "Remote endpoint of other node to connect to, prefixed with '<local contract>=' for a channel other than the first one (may specify multiple times)")
        ("icp-relay-peer-chain-id", bpo::value<string>(), "The chain id of icp peer")
        ("icp-relay-peer-contract", bpo::value<string>()->default_value("cochainioicp"), "The peer icp contract account name")
        ("icp-relay-local-contract", bpo::value<string>()->default_value("cochainioicp"), "The local icp contract account name")
        ("icp-relay-signer", bpo::value<string>()->default_value("cochainrelay@active"), "The account and permission level to authorize icp transactions on local icp contract, as in 'account@permission'")
+       ("icp-relay-channel", bpo::value<vector<string>>()->composing(), "Another icp channel to serve, as in '<local contract>:<peer contract>:<peer chain id>[:<signer>]', the signer defaulting to --icp-relay-signer (may specify multiple times)")
+       ("icp-relay-compact-proofs", bpo::value<bool>()->default_value(false), "Send only the merkle branch of each action instead of all action digests of the block, the peer icp contract must support compact proofs")
+       ("icp-relay-batch-packets", bpo::value<bool>()->default_value(false), "With compact proofs, relay all packets of a block in one 'onpackets' action with one merkle proof, the peer relays and icp contract must support packet batching")
+       ("icp-relay-compression", bpo::value<bool>()->default_value(true), "Offer permessage-deflate compression of session traffic, used with the peers that accept it")
+       ("icp-relay-frame-batch-bytes", bpo::value<uint32_t>()->default_value(0), "Coalesce the queued messages of a session into one websocket message of up to this many bytes, 0 to send each message alone; the peer relays must support frame batching")
+       ("icp-relay-header-max-delay", bpo::value<uint32_t>()->default_value(MIN_CACHED_BLOCKS), "The most blocks a packet waits before block headers are sent to the peer for it")
+       ("icp-relay-header-max-lag", bpo::value<uint32_t>()->default_value(MAX_CACHED_BLOCKS), "The most blocks the peer head is let lag behind before block headers are sent without any packet waiting")
+       ("icp-relay-header-packet-batch", bpo::value<uint32_t>()->default_value(0), "Send block headers as soon as this many packets wait for them, 0 to only wait for --icp-relay-header-max-delay")
     ;
 }
 
@@ -71,15 +79,56 @@ void icp_relay_plugin::plugin_initialize(const variables_map& options) {
         if (relay_->num_threads_ > 8) relay_->num_threads_ = 8;
     }
 
+    auto signer = options.at("icp-relay-signer").as<string>();
+    auto cache_dir = app().data_dir() / "icp-relay";
+
+    auto add_channel = [&](const string& local_contract, const string& peer_contract, const string& peer_chain_id, const string& signer) {
+        auto c = std::make_shared<icp::channel>(*relay_);
+        c->local_contract_ = account_name(local_contract);
+        c->peer_contract_ = account_name(peer_contract);
+        c->peer_chain_id_ = chain_id_type(peer_chain_id);
+        c->signer_ = get_account_permissions(vector<string>{signer});
+        // the first channel keeps the journal where a single channel relay had it
+        c->cache_dir_ = relay_->channels().empty() ? cache_dir : cache_dir / local_contract;
+        relay_->add_channel(c);
+        ilog("icp channel between local contract ${l} and peer contract ${p} of chain ${id}", ("l", c->local_contract_)("p", c->peer_contract_)("id", c->peer_chain_id_));
+    };
+
+    if (options.count("icp-relay-peer-chain-id")) {
+        add_channel(options.at("icp-relay-local-contract").as<string>(), options.at("icp-relay-peer-contract").as<string>(),
+                    options.at("icp-relay-peer-chain-id").as<string>(), signer);
+    }
+
+    if (options.count("icp-relay-channel")) {
+        for (const auto& spec: options.at("icp-relay-channel").as<vector<string>>()) {
+            vector<string> pieces;
+            boost::algorithm::split(pieces, spec, boost::algorithm::is_any_of(":"));
+            FC_ASSERT(pieces.size() == 3 or pieces.size() == 4, "invalid --icp-relay-channel ${c}", ("c", spec));
+            add_channel(pieces[0], pieces[1], pieces[2], pieces.size() == 4 ? pieces[3] : signer);
+        }
+    }
+
+    FC_ASSERT(not relay_->channels().empty(), "option --icp-relay-peer-chain-id or --icp-relay-channel must be specified");
+
     if (options.count("icp-relay-connect")) {
-        relay_->connect_to_peers_ = options.at("icp-relay-connect").as<vector<string>>();
+        for (const auto& peer: options.at("icp-relay-connect").as<vector<string>>()) {
+            auto eq = peer.find('=');
+            auto c = relay_->find_channel(account_name(eq == string::npos ? string() : peer.substr(0, eq)));
+            FC_ASSERT(c, "no icp channel for --icp-relay-connect ${p}", ("p", peer));
+            c->connect_to_peers_.push_back(eq == string::npos ? peer : peer.substr(eq + 1));
+        }
     }
 
-    FC_ASSERT(options.count("icp-relay-peer-chain-id"), "option --icp-relay-peer-chain-id must be specified");
-    relay_->local_contract_ = account_name(options.at("icp-relay-local-contract").as<string>());
-    relay_->peer_contract_ = account_name(options.at("icp-relay-peer-contract").as<string>());
-    relay_->peer_chain_id_ = chain_id_type(options.at("icp-relay-peer-chain-id").as<string>());
-    relay_->signer_ = get_account_permissions(vector<string>{options.at("icp-relay-signer").as<string>()});
+    relay_->compact_proofs_ = options.at("icp-relay-compact-proofs").as<bool>();
+    relay_->batch_packets_ = options.at("icp-relay-batch-packets").as<bool>();
+    relay_->compress_ = options.at("icp-relay-compression").as<bool>();
+    relay_->frame_batch_bytes_ = options.at("icp-relay-frame-batch-bytes").as<uint32_t>();
+
+    auto& cadence = relay_->header_cadence_;
+    cadence.max_packet_delay = options.at("icp-relay-header-max-delay").as<uint32_t>();
+    cadence.max_lag = options.at("icp-relay-header-max-lag").as<uint32_t>();
+    cadence.packet_batch = options.at("icp-relay-header-packet-batch").as<uint32_t>();
+    FC_ASSERT(cadence.max_packet_delay <= cadence.max_lag, "--icp-relay-header-max-delay must not exceed --icp-relay-header-max-lag");
 }
 
 void icp_relay_plugin::plugin_startup() {
@@ -3,6 +3,7 @@
  */
 
 #include <fc/io/raw.hpp>
+#include <eosio/chain/merkle.hpp>
 
 #include "api.hpp"
 
@@ -17,6 +18,7 @@ const action_name ACTION_ADDBLOCKS{"addblocks"};
 const action_name ACTION_ADDBLOCK{"addblock"};
 const action_name ACTION_SENDACTION{"sendaction"};
 const action_name ACTION_ONPACKET{"onpacket"};
+const action_name ACTION_ONPACKETS{"onpackets"};
 const action_name ACTION_ONRECEIPT{"onreceipt"};
 const action_name ACTION_ONCLEANUP{"oncleanup"};
 const action_name ACTION_GENPROOF{"genproof"};
@@ -32,6 +34,21 @@ struct icp_action {
    block_id_type block_id;
    vector<digest_type> merkle_path;
 };
+// Same layout as `icp_action` followed by a format tag and the leaf index bitmap, which the icp contract takes as a compact proof
+struct icp_compact_action : icp_action {
+   uint8_t format = 1; // `icp_action_compact_format` of the icp contract
+   uint64_t index_bitmap = 0;
+};
+
+// Packets of one block proved by one multi-leaf proof, as the icp contract takes them in `onpackets`
+struct icp_packets_action {
+   vector<bytes> actions;
+   vector<bytes> action_receipts;
+   block_id_type block_id;
+   uint64_t leaf_count = 0;
+   vector<uint64_t> leaf_indices;
+   vector<digest_type> merkle_proof;
+};
 
 struct hello {
    public_key_type id; // sender id
@@ -55,6 +72,15 @@ struct block_header_with_merkle_path {
    block_header_state block_header;
    vector<block_id_type> merkle_path;
 };
+/**
+ * A run of headers for a lagging peer, to be added in one transaction.
+ * Each merkle path is delta-encoded against the previous header in the run (the first one against
+ * the peer head), i.e. it only carries the ids of the blocks skipped since that header.
+ */
+struct block_headers_with_merkle_paths {
+   vector<block_header_state> block_headers;
+   vector<vector<block_id_type>> merkle_paths;
+};
 struct icp_actions {
    block_header block_header;
    vector<digest_type> action_digests;
@@ -64,15 +90,120 @@ struct icp_actions {
    vector<action_receipt> action_receipts;
 };
 
+/**
+ * Same as `icp_actions`, but instead of all action digests of the block,
+ * carries only the sibling branch and the leaf index of each action receipt.
+ */
+struct icp_compact_actions {
+   block_header block_header;
+
+   vector<action_name> peer_actions;
+   vector<action> actions;
+   vector<action_receipt> action_receipts;
+   vector<vector<digest_type>> merkle_branches;
+   vector<uint64_t> index_bitmaps;
+};
+
+/**
+ * Same as `icp_compact_actions` for the actions other than packets, while the packets of the block are proved
+ * together by one multi-leaf proof, to be relayed in one `onpackets`
+ */
+struct icp_batched_actions {
+   icp_compact_actions others; // including the block header
+
+   vector<action> packets;
+   vector<action_receipt> packet_receipts;
+   uint64_t leaf_count = 0; // action digests of the block
+   vector<uint64_t> leaf_indices; // of each packet receipt, ascending
+   vector<digest_type> merkle_proof;
+};
+
 using icp_message = fc::static_variant<
    hello,
    ping,
    pong,
    channel_seed,
    block_header_with_merkle_path,
-   icp_actions
+   icp_actions,
+   block_headers_with_merkle_paths,
+   icp_compact_actions,
+   icp_batched_actions
 >;
 
+/**
+ * A packed `icp_message`, immutable and shared by the write queues of all sessions,
+ * so that a message relayed to many peers is serialized only once.
+ */
+using icp_frame = std::shared_ptr<const vector<char>>;
+
+inline icp_frame make_frame(const icp_message& msg) {
+   return std::make_shared<const vector<char>>(fc::raw::pack(msg));
+}
+
+/**
+ * Generate the sibling branches of the leaves at `indices` in one pass over the tree,
+ * each sibling marked canonical left or right, from the bottom up
+ */
+inline vector<vector<digest_type>> merkle_branches(vector<digest_type> ids, vector<uint64_t> indices) {
+   vector<vector<digest_type>> branches(indices.size());
+
+   while (ids.size() > 1) {
+      if (ids.size() % 2)
+         ids.push_back(ids.back());
+
+      for (size_t k = 0; k < indices.size(); ++k) {
+         auto& index = indices[k];
+         const auto& sibling = ids[index ^ 1];
+         branches[k].push_back(index & 1 ? make_canonical_left(sibling) : make_canonical_right(sibling));
+         index >>= 1;
+      }
+
+      for (size_t i = 0; i < ids.size() / 2; ++i) {
+         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+      }
+
+      ids.resize(ids.size() / 2);
+   }
+
+   return branches;
+}
+
+/**
+ * Generate one proof for all the leaves at `indices` (strictly ascending): from the bottom up, the siblings of
+ * the nodes known at each level which are neither known themselves nor the duplicate of an odd last node,
+ * as the icp contract consumes them in `merkle_multiproof_root`
+ */
+inline vector<digest_type> merkle_multiproof(vector<digest_type> ids, vector<uint64_t> indices) {
+   vector<digest_type> proof;
+
+   while (ids.size() > 1) {
+      auto size = ids.size();
+      if (size % 2)
+         ids.push_back(ids.back());
+
+      size_t n = 0;
+      for (size_t k = 0; k < indices.size(); ++k) {
+         auto index = indices[k];
+         auto sibling = index ^ 1;
+         if (k + 1 < indices.size() and indices[k + 1] == sibling) {
+            ++k;
+         } else if (sibling < size) {
+            proof.push_back(ids[sibling]);
+         }
+         indices[n++] = index >> 1;
+      }
+      indices.resize(n);
+
+      for (size_t i = 0; i < ids.size() / 2; ++i) {
+         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+      }
+
+      ids.resize(ids.size() / 2);
+   }
+
+   return proof;
+}
+
 }
 
 FC_REFLECT(icp::hello, (id)(chain_id)(contract)(peer_contract))
@@ -80,5 +211,10 @@ FC_REFLECT(icp::ping, (sent)(code)(head))
 FC_REFLECT(icp::pong, (sent)(code))
 FC_REFLECT(icp::channel_seed, (seed))
 FC_REFLECT(icp::block_header_with_merkle_path, (block_header)(merkle_path))
+FC_REFLECT(icp::block_headers_with_merkle_paths, (block_headers)(merkle_paths))
 FC_REFLECT(icp::icp_actions, (block_header)(action_digests)(peer_actions)(actions)(action_receipts))
 FC_REFLECT(icp::icp_action, (action)(action_receipt)(block_id)(merkle_path))
+FC_REFLECT_DERIVED(icp::icp_compact_action, (icp::icp_action), (format)(index_bitmap))
+FC_REFLECT(icp::icp_compact_actions, (block_header)(peer_actions)(actions)(action_receipts)(merkle_branches)(index_bitmaps))
+FC_REFLECT(icp::icp_packets_action, (actions)(action_receipts)(block_id)(leaf_count)(leaf_indices)(merkle_proof))
+FC_REFLECT(icp::icp_batched_actions, (others)(packets)(packet_receipts)(leaf_count)(leaf_indices)(merkle_proof))
@@ -0,0 +1,60 @@
+#include "metrics.hpp"
+
+namespace icp {
+
+void message_counters::on_sent(size_t type, size_t bytes) {
+   if (type >= num_message_types) return;
+   auto& c = counters_[type];
+   c.sent_count.fetch_add(1, std::memory_order_relaxed);
+   c.sent_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void message_counters::on_received(size_t type, size_t bytes) {
+   if (type >= num_message_types) return;
+   auto& c = counters_[type];
+   c.received_count.fetch_add(1, std::memory_order_relaxed);
+   c.received_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+vector<message_type_stats> message_counters::stats() const {
+   vector<message_type_stats> result;
+   for (size_t i = 0; i < num_message_types; ++i) {
+      auto& c = counters_[i];
+      message_type_stats s{message_type_names[i],
+                           c.sent_count.load(std::memory_order_relaxed),
+                           c.sent_bytes.load(std::memory_order_relaxed),
+                           c.received_count.load(std::memory_order_relaxed),
+                           c.received_bytes.load(std::memory_order_relaxed)};
+      if (s.sent_count == 0 and s.received_count == 0) continue;
+      result.push_back(std::move(s));
+   }
+   return result;
+}
+
+void latency_histogram::record(fc::microseconds d) {
+   auto us = static_cast<uint64_t>(std::max<int64_t>(d.count(), 0));
+
+   size_t bucket = 0;
+   while (bucket < num_buckets and us > (uint64_t(1000) << bucket)) ++bucket;
+   counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+   samples_.fetch_add(1, std::memory_order_relaxed);
+   total_us_.fetch_add(us, std::memory_order_relaxed);
+   auto max = max_us_.load(std::memory_order_relaxed);
+   while (us > max and not max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+}
+
+histogram_stats latency_histogram::stats() const {
+   histogram_stats s;
+   s.samples = samples_.load(std::memory_order_relaxed);
+   s.total_us = total_us_.load(std::memory_order_relaxed);
+   s.max_us = max_us_.load(std::memory_order_relaxed);
+   for (size_t i = 0; i <= num_buckets; ++i) {
+      auto n = counts_[i].load(std::memory_order_relaxed);
+      if (n == 0) continue;
+      s.buckets.push_back(histogram_bucket{i < num_buckets ? uint64_t(1) << i : 0, n});
+   }
+   return s;
+}
+
+}
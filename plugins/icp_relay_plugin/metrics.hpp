@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <eosio/chain/types.hpp>
+
+namespace icp {
+
+using namespace std;
+
+/// Names of the `icp_message` types, in the order of the variant
+constexpr const char* message_type_names[] = {
+   "hello",
+   "ping",
+   "pong",
+   "channel_seed",
+   "block_header_with_merkle_path",
+   "icp_actions",
+   "block_headers_with_merkle_paths",
+   "icp_compact_actions",
+   "icp_batched_actions"
+};
+constexpr size_t num_message_types = sizeof(message_type_names) / sizeof(message_type_names[0]);
+
+struct message_type_stats {
+   string type;
+   uint64_t sent_count = 0;
+   uint64_t sent_bytes = 0;
+   uint64_t received_count = 0;
+   uint64_t received_bytes = 0;
+};
+
+/**
+ * Message and byte counters per message type, safe to update from any relay thread.
+ */
+class message_counters {
+public:
+   void on_sent(size_t type, size_t bytes);
+   void on_received(size_t type, size_t bytes);
+
+   /// Stats of the message types which have been seen at least once
+   vector<message_type_stats> stats() const;
+
+private:
+   struct counter {
+      std::atomic<uint64_t> sent_count{0};
+      std::atomic<uint64_t> sent_bytes{0};
+      std::atomic<uint64_t> received_count{0};
+      std::atomic<uint64_t> received_bytes{0};
+   };
+
+   std::array<counter, num_message_types> counters_;
+};
+
+struct histogram_bucket {
+   uint64_t le_ms = 0; // upper bound of the bucket; 0 for the overflow bucket
+   uint64_t count = 0;
+};
+
+struct histogram_stats {
+   uint64_t samples = 0;
+   uint64_t total_us = 0;
+   uint64_t max_us = 0;
+   vector<histogram_bucket> buckets; // non-empty buckets only
+};
+
+/**
+ * Latency histogram with power-of-two millisecond buckets, safe to record from any thread.
+ */
+class latency_histogram {
+public:
+   static constexpr size_t num_buckets = 20; // the last bound is 2^19 ms, about 9 minutes
+
+   void record(fc::microseconds d);
+   histogram_stats stats() const;
+
+private:
+   std::array<std::atomic<uint64_t>, num_buckets + 1> counts_{}; // the last one counts overflows
+   std::atomic<uint64_t> samples_{0};
+   std::atomic<uint64_t> total_us_{0};
+   std::atomic<uint64_t> max_us_{0};
+};
+
+}
+
+FC_REFLECT(icp::message_type_stats, (type)(sent_count)(sent_bytes)(received_count)(received_bytes))
+FC_REFLECT(icp::histogram_bucket, (le_ms)(count))
+FC_REFLECT(icp::histogram_stats, (samples)(total_us)(max_us)(buckets))
@@ -1,11 +1,45 @@
 #include "session.hpp"
 
 #include <appbase/application.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
 
 #include "icp_relay.hpp"
 
 namespace icp {
 
+// the type tag leads a packed `icp_message` as a varint, which is a single byte for all our types
+static size_t frame_type(const icp_frame& frame) {
+   return frame->empty() ? num_message_types : static_cast<uint8_t>(frame->front());
+}
+
+// one entry of each vector per action, and a branch no longer than the 64 levels its bitmap can index
+static bool well_formed(const icp_compact_actions& ia) {
+   auto n = ia.peer_actions.size();
+   if (ia.actions.size() != n or ia.action_receipts.size() != n or ia.merkle_branches.size() != n or ia.index_bitmaps.size() != n) {
+      return false;
+   }
+   for (size_t i = 0; i < n; ++i) {
+      auto levels = ia.merkle_branches[i].size();
+      if (levels > 64 or (levels < 64 and (ia.index_bitmaps[i] >> levels) != 0)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// the leaf indices of the packets are strictly ascending and within the leaves of the block
+static bool well_formed(const icp_batched_actions& ia) {
+   if (ia.packets.empty() or ia.packets.size() != ia.packet_receipts.size() or ia.packets.size() != ia.leaf_indices.size()) {
+      return false;
+   }
+   for (size_t i = 0; i < ia.leaf_indices.size(); ++i) {
+      if (ia.leaf_indices[i] >= ia.leaf_count or (i > 0 and ia.leaf_indices[i] <= ia.leaf_indices[i - 1])) {
+         return false;
+      }
+   }
+   return well_formed(ia.others);
+}
+
 // Creating session from server socket acceptance
 session::session(tcp::socket socket, relay_ptr relay)
    : ios_(socket.get_io_service()),
@@ -16,7 +50,7 @@ session::session(tcp::socket socket, relay_ptr relay)
 
    session_id_ = next_session_id();
    set_socket_options();
-   ws_->binary(true);
+   set_stream_options();
    wlog("open session ${id}", ("id", session_id_));
 }
 
@@ -26,21 +60,21 @@ void session::do_accept() {
          return on_error(ec, "accept");
       }
 
-      do_hello();
-      do_read();
+      do_read(); // hello is sent in reply, when the channel is known
    }));
 }
 
 // Creating outgoing session
-session::session(const string& peer, boost::asio::io_context& ioc, relay_ptr relay)
+session::session(const string& peer, boost::asio::io_context& ioc, relay_ptr relay, channel_ptr channel)
    : ios_(ioc),
      resolver_(ioc),
      ws_(std::make_unique<ws::stream<tcp::socket>>(ioc)),
      strand_(ws_->get_executor()),
-     relay_(relay) {
+     relay_(relay),
+     channel_(channel) {
 
    session_id_ = next_session_id();
-   ws_->binary(true);
+   set_stream_options();
    wlog("open session ${id}", ("id", session_id_));
 
    peer_ = peer;
@@ -89,10 +123,7 @@ void session::on_connect(boost::system::error_code ec) {
 
 session::~session() {
    wlog("close session ${n}", ("n", session_id_));
-   std::weak_ptr<relay> r = relay_;
-   app().get_io_service().post([r, s=this] {
-      if (auto relay = r.lock()) relay->on_session_close(s);
-   });
+   relay_->on_session_close(this);
 }
 
 int session::next_session_id() {
@@ -116,6 +147,18 @@ void session::set_socket_options() {
    }
 }
 
+void session::set_stream_options() {
+   ws_->binary(true);
+
+   if (relay_->compress_) {
+      // negotiated in the handshake, so peers that do not support it are talked to uncompressed
+      ws::permessage_deflate pmd;
+      pmd.client_enable = true;
+      pmd.server_enable = true;
+      ws_->set_option(pmd);
+   }
+}
+
 void session::on_error(boost::system::error_code ec, const char* what) {
    try {
       verify_strand_in_this_thread(strand_, __func__, __LINE__);
@@ -142,9 +185,10 @@ void session::do_hello() {
    hello hello_msg;
    hello_msg.id = relay_->id_;
    hello_msg.chain_id = app().get_plugin<chain_plugin>().get_chain_id();
-   hello_msg.contract = relay_->local_contract_;
-   hello_msg.peer_contract = relay_->peer_contract_;
+   hello_msg.contract = channel_->local_contract_;
+   hello_msg.peer_contract = channel_->peer_contract_;
    send(hello_msg);
+   sent_remote_hello_ = true;
 }
 
 void session::do_read() {
@@ -158,12 +202,18 @@ void session::do_read() {
              auto size = boost::asio::buffer_size(in_buffer_.data());
              fc::datastream<const char*> ds(data, size);
 
-             icp_message msg;
-             fc::raw::unpack(ds, msg);
-             on_message(msg);
-             in_buffer_.consume(ds.tellp());
+             // a websocket message may carry several icp messages, packed back to back by a batching peer
+             while (ds.remaining()) {
+                auto start = ds.tellp();
+                icp_message msg;
+                fc::raw::unpack(ds, msg);
+                counters_.on_received(msg.which(), ds.tellp() - start);
+                relay_->message_counters_.on_received(msg.which(), ds.tellp() - start);
+                on_message(msg);
+             }
+             in_buffer_.consume(size);
 
-             wait_on_app();
+             do_read();
 
           } catch (...) {
              wlog("close bad payload");
@@ -177,21 +227,6 @@ void session::do_read() {
    );
 }
 
-/** If we just call do_read here then this thread might run ahead of
- * the main thread, instead we post an event to main which will then
- * post a new read event when ready.
- *
- * This also keeps the "shared pointer" alive in the callback preventing
- * the connection from being closed.
- */
-void session::wait_on_app() {
-   app().get_io_service().post(
-      boost::asio::bind_executor(strand_, [self = shared_from_this()] {
-         self->do_read();
-      })
-   );
-}
-
 bool session::send_ping() {
    auto delta_t = fc::time_point::now() - last_sent_ping_.sent;
    if (delta_t < fc::seconds(3)) return false;
@@ -218,7 +253,7 @@ void session::send() {
       verify_strand_in_this_thread(strand_, __func__, __LINE__);
 
       state_ = sending_state;
-      ws_->async_write(boost::asio::buffer(out_buffer_),
+      ws_->async_write(boost::asio::buffer(*out_buffer_),
                        boost::asio::bind_executor(strand_,
                           [this, self=shared_from_this()](boost::system::error_code ec, std::size_t bytes_transferred) {
                           verify_strand_in_this_thread(strand_, __func__, __LINE__);
@@ -227,7 +262,7 @@ void session::send() {
                             return on_error(ec, "write");
                           }
                           state_ = idle_state;
-                          out_buffer_.resize(0);
+                          out_buffer_.reset();
                           maybe_send_next_message();
                        })
       );
@@ -236,37 +271,75 @@ void session::send() {
 
 void session::send(const icp_message& msg) {
    try {
-      auto ps = fc::raw::pack_size(msg);
-      out_buffer_.resize(ps);
-      fc::datastream<char*> ds(out_buffer_.data(), ps);
-      fc::raw::pack(ds, msg);
-      send();
+      send(make_frame(msg));
    } FC_LOG_AND_RETHROW()
 }
 
-void session::buffer_send(icp_message&& msg) {
-   msg_buffer_.push_back(move(msg));
+void session::count_sent(const icp_frame& frame) {
+   counters_.on_sent(frame_type(frame), frame->size());
+   relay_->message_counters_.on_sent(frame_type(frame), frame->size());
+}
+
+void session::send(const icp_frame& frame) {
+   count_sent(frame);
+   out_buffer_ = frame;
+   send();
+}
+
+// packs as many queued messages as fit `frame_batch_bytes_` back to back into one write, at least one
+void session::send_batch() {
+   auto frame = msg_buffer_.front();
+   msg_buffer_.pop_front();
+   if (not relay_->frame_batch_bytes_ or msg_buffer_.empty()
+       or frame->size() + msg_buffer_.front()->size() > relay_->frame_batch_bytes_) {
+      return send(frame);
+   }
+
+   auto batch = std::make_shared<vector<char>>();
+   batch->reserve(relay_->frame_batch_bytes_);
+   count_sent(frame);
+   batch->insert(batch->end(), frame->begin(), frame->end());
+   while (not msg_buffer_.empty() and batch->size() + msg_buffer_.front()->size() <= relay_->frame_batch_bytes_) {
+      frame = msg_buffer_.front();
+      msg_buffer_.pop_front();
+      count_sent(frame);
+      batch->insert(batch->end(), frame->begin(), frame->end());
+   }
+   out_buffer_ = std::move(batch);
+   send();
+}
+
+void session::buffer_send(const icp_frame& frame) {
+   msg_buffer_.push_back(frame);
+   auto depth = static_cast<uint32_t>(msg_buffer_.size());
+   queue_depth_ = depth;
+   if (depth > max_queue_depth_) max_queue_depth_ = depth; // only written on the strand
 }
 
 void session::maybe_send_next_message() {
    verify_strand_in_this_thread(strand_, __func__, __LINE__);
    if (state_ == sending_state) return; // in process of sending
-   if (out_buffer_.size()) return; // in process of sending
+   if (out_buffer_) return; // in process of sending
    if (!recv_remote_hello_ || !sent_remote_hello_) return;
 
    if (send_pong()) return;
    if (send_ping()) return;
 
    if (not msg_buffer_.empty()) {
-      auto msg = msg_buffer_.front();
-      send(msg);
-      msg_buffer_.pop_front();
+      send_batch();
+      queue_depth_ = static_cast<uint32_t>(msg_buffer_.size());
    }
    // TODO
 }
 
 void session::on_message(const icp_message& msg) {
    try {
+      if (not recv_remote_hello_ and msg.which() != icp_message::tag<hello>::value) {
+         wlog("message before hello received");
+         ws_->close(boost::beast::websocket::close_code::bad_payload);
+         return;
+      }
+
       switch (msg.which()) {
          case icp_message::tag<hello>::value:
             on(msg.get<hello>());
@@ -277,6 +350,24 @@ void session::on_message(const icp_message& msg) {
          case icp_message::tag<pong>::value:
             on(msg.get<pong>());
             break;
+         case icp_message::tag<channel_seed>::value:
+            on(msg.get<channel_seed>());
+            break;
+         case icp_message::tag<block_header_with_merkle_path>::value:
+            on(msg.get<block_header_with_merkle_path>());
+            break;
+         case icp_message::tag<icp_actions>::value:
+            on(msg.get<icp_actions>());
+            break;
+         case icp_message::tag<block_headers_with_merkle_paths>::value:
+            on(msg.get<block_headers_with_merkle_paths>());
+            break;
+         case icp_message::tag<icp_compact_actions>::value:
+            on(msg.get<icp_compact_actions>());
+            break;
+         case icp_message::tag<icp_batched_actions>::value:
+            on(msg.get<icp_batched_actions>());
+            break;
          default:
             wlog("bad message received");
             ws_->close(boost::beast::websocket::close_code::bad_payload);
@@ -292,13 +383,11 @@ void session::on_message(const icp_message& msg) {
 }
 
 void session::check_for_redundant_connection() {
-   app().get_io_service().post([self=shared_from_this()] {
-      self->relay_->for_each_session([self](auto s) {
-         if (s != self && s->peer_id_ == self->peer_id_) {
-            self->close();
-         }
-      });
-   });
+   relay_->for_each_session([self=shared_from_this()](auto s) {
+      if (s != self && s->peer_id_ == self->peer_id_) {
+         self->close();
+      }
+   }, channel_.get()); // a peer relay serving several channels has one session for each
 }
 
 void session::on(const hello& hi) {
@@ -314,6 +403,20 @@ void session::on(const hello& hi) {
       return close();
    }
 
+   if (not channel_) {
+      channel_ = relay_->find_channel(hi);
+      if (not channel_) {
+         elog("bad peer: no icp channel between my contract ${peer_contract} and peer icp contract ${contract}", ("contract", hi.contract)("peer_contract", hi.peer_contract));
+         return close();
+      }
+      relay_->bind_session(this, channel_.get());
+      do_hello();
+   } else if (not channel_->matches(hi)) {
+      elog("bad peer: wrong icp contracts");
+      return close();
+   }
+
+   recv_remote_hello_ = true;
    peer_id_ = hi.id;
 
    check_for_redundant_connection();
@@ -323,9 +426,7 @@ void session::on(const ping& p) {
    last_recv_ping_ = p;
    last_recv_ping_time_ = fc::time_point::now();
 
-   app().get_io_service().post([=, self=shared_from_this()] {
-      relay_->peer_head_ = p.head; // TODO: check validity
-   });
+   channel_->set_peer_head(p.head); // TODO: check validity
 }
 
 void session::on(const pong& p) {
@@ -333,58 +434,82 @@ void session::on(const pong& p) {
       close();
       return;
    }
+   ping_rtt_.record(fc::time_point::now() - last_sent_ping_.sent);
    last_sent_ping_.code = fc::sha256(); // reset
 }
 
 void session::on(const channel_seed& s) {
    auto data = fc::raw::pack(s.seed);
-   app().get_io_service().post([=, self=shared_from_this()] {
+   app_post(priority::low, [=, self=shared_from_this()] {
       action a;
       a.name = ACTION_OPENCHANNEL;
       a.data = data;
-      relay_->push_transaction(vector<action>{a});
+      channel_->push_transaction(vector<action>{a});
    });
 }
 
 void session::on(const block_header_with_merkle_path& b) {
-   auto ro = relay_->get_read_only_api();
-   auto head = ro.get_head();
-
-   if (not head) {
-      elog("local head not found, maybe icp channel not opened");
-      return;
-   }
-
    auto first_num = b.block_header.block_num;
    if (not b.merkle_path.empty()) {
       first_num = block_header::num_from_id(b.merkle_path.front());
    }
 
-   if (first_num != head->head_block_num + 1) {
-      elog("unlinkable block: has ${has}, got ${got}", ("has", head->head_block_num)("got", first_num));
+   auto data = fc::raw::pack(b);
+   auto block_time = b.block_header.header.timestamp.to_time_point();
+
+   app_post(priority::low, [=, self=shared_from_this()] {
+      if (not channel_->is_linkable(first_num)) return;
+      // TODO: more check and workaround
+
+      relay_->record_latency("addblocks", fc::time_point::now() - block_time);
+
+      action a;
+      a.name = ACTION_ADDBLOCKS;
+      a.data = data;
+      channel_->push_transaction(vector<action>{a});
+   });
+}
+
+void session::on(const block_headers_with_merkle_paths& b) {
+   if (b.block_headers.empty() or b.block_headers.size() != b.merkle_paths.size()) {
+      elog("malformed block headers run");
       return;
    }
-   // TODO: more check and workaround
 
-   auto data = fc::raw::pack(b);
+   auto first_num = b.block_headers.front().block_num;
+   if (not b.merkle_paths.front().empty()) {
+      first_num = block_header::num_from_id(b.merkle_paths.front().front());
+   }
 
-   app().get_io_service().post([=, self=shared_from_this()] {
+   // fold the whole run into one transaction
+   vector<action> actions;
+   actions.reserve(b.block_headers.size());
+   for (size_t i = 0; i < b.block_headers.size(); ++i) {
       action a;
       a.name = ACTION_ADDBLOCKS;
-      a.data = data;
-      relay_->push_transaction(vector<action>{a});
+      a.data = fc::raw::pack(block_header_with_merkle_path{b.block_headers[i], b.merkle_paths[i]});
+      actions.push_back(move(a));
+   }
+
+   auto last_time = b.block_headers.back().header.timestamp.to_time_point();
+
+   app_post(priority::low, [=, self=shared_from_this()] {
+      if (not channel_->is_linkable(first_num)) return;
+      relay_->record_latency("addblocks", fc::time_point::now() - last_time);
+      channel_->push_transaction(actions);
    });
 }
 
 void session::on(const icp_actions& ia) {
    auto block_id = ia.block_header.id();
+   auto block_time = ia.block_header.timestamp.to_time_point();
    auto data = fc::raw::pack(ia.block_header);
 
-   app().get_io_service().post([=, self=shared_from_this()] {
+   app_post(priority::low, [=, self=shared_from_this()] {
       action a;
       a.name = ACTION_ADDBLOCK;
       a.data = data;
-      relay_->push_transaction(vector<action>{a}); // TODO: check block existing
+      channel_->push_transaction(vector<action>{a}); // TODO: check block existing
    });
 
    // TODO: rate limiting, cache, and retry
@@ -392,10 +517,77 @@ void session::on(const icp_actions& ia) {
       action a;
       a.name = ia.peer_actions[i];
       a.data = fc::raw::pack(icp_action{fc::raw::pack(ia.actions[i]), fc::raw::pack(ia.action_receipts[i]), block_id, ia.action_digests});
-      app().get_io_service().post([=, self=shared_from_this()] {
-         relay_->push_transaction(vector<action>{a});
+      app_post(priority::low, [=, self=shared_from_this()] {
+         relay_->record_latency(a.name.to_string(), fc::time_point::now() - block_time);
+         channel_->push_transaction(vector<action>{a});
+      });
+   }
+}
+
+void session::on(const icp_compact_actions& ia) {
+   if (not well_formed(ia)) {
+      elog("malformed compact icp actions");
+      return;
+   }
+
+   auto block_id = ia.block_header.id();
+   auto block_time = ia.block_header.timestamp.to_time_point();
+   auto data = fc::raw::pack(ia.block_header);
+
+   app_post(priority::low, [=, self=shared_from_this()] {
+      action a;
+      a.name = ACTION_ADDBLOCK;
+      a.data = data;
+      channel_->push_transaction(vector<action>{a}); // TODO: check block existing
+   });
+
+   for (size_t i = 0; i < ia.peer_actions.size(); ++i) {
+      icp_compact_action ca;
+      ca.action = fc::raw::pack(ia.actions[i]);
+      ca.action_receipt = fc::raw::pack(ia.action_receipts[i]);
+      ca.block_id = block_id;
+      ca.merkle_path = ia.merkle_branches[i];
+      ca.index_bitmap = ia.index_bitmaps[i];
+
+      action a;
+      a.name = ia.peer_actions[i];
+      a.data = fc::raw::pack(ca);
+      app_post(priority::low, [=, self=shared_from_this()] {
+         relay_->record_latency(a.name.to_string(), fc::time_point::now() - block_time);
+         channel_->push_transaction(vector<action>{a});
       });
    }
 }
 
+
+void session::on(const icp_batched_actions& ia) {
+   if (not well_formed(ia)) {
+      elog("malformed batched icp actions");
+      return;
+   }
+
+   on(ia.others); // adds the block, then relays the other actions
+
+   icp_packets_action pa;
+   pa.actions.reserve(ia.packets.size());
+   pa.action_receipts.reserve(ia.packets.size());
+   for (size_t i = 0; i < ia.packets.size(); ++i) {
+      pa.actions.push_back(fc::raw::pack(ia.packets[i]));
+      pa.action_receipts.push_back(fc::raw::pack(ia.packet_receipts[i]));
+   }
+   pa.block_id = ia.others.block_header.id();
+   pa.leaf_count = ia.leaf_count;
+   pa.leaf_indices = ia.leaf_indices;
+   pa.merkle_proof = ia.merkle_proof;
+
+   action a;
+   a.name = ACTION_ONPACKETS;
+   a.data = fc::raw::pack(pa);
+   auto block_time = ia.others.block_header.timestamp.to_time_point();
+   app_post(priority::low, [=, self=shared_from_this()] {
+      relay_->record_latency(a.name.to_string(), fc::time_point::now() - block_time);
+      channel_->push_transaction(vector<action>{a});
+   });
+}
+
 }
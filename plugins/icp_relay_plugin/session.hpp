@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include <boost/beast/core.hpp>
@@ -43,7 +44,7 @@ void verify_strand_in_this_thread(const Strand& strand, const char* func, int li
 class session : public std::enable_shared_from_this<session> {
 public:
    session(tcp::socket socket, relay_ptr relay);
-   session(const string& peer, boost::asio::io_context& ioc, relay_ptr relay);
+   session(const string& peer, boost::asio::io_context& ioc, relay_ptr relay, channel_ptr channel);
    ~session();
 
    void do_accept();
@@ -52,25 +53,33 @@ public:
 
    void post(std::function<void()> callback);
 
-   void buffer_send(icp_message&& msg);
+   void buffer_send(const icp_frame& frame);
 
    head local_head_;
    string peer_;
 
    int session_id_;
 
+   message_counters counters_;
+   std::atomic<uint32_t> queue_depth_{0};
+   std::atomic<uint32_t> max_queue_depth_{0};
+   latency_histogram ping_rtt_;
+
 private:
    static int next_session_id();
    void set_socket_options();
+   void set_stream_options();
    void on_connect(boost::system::error_code ec);
    void on_error(boost::system::error_code ec, const char* what);
    void do_hello();
    void do_read();
-   void wait_on_app();
    bool send_ping();
    bool send_pong();
    void send();
    void send(const icp_message& msg);
+   void send(const icp_frame& frame);
+   void send_batch();
+   void count_sent(const icp_frame& frame);
    void maybe_send_next_message();
    void on_message(const icp_message& msg);
    void check_for_redundant_connection();
@@ -81,6 +90,9 @@ private:
    void on(const channel_seed& s);
    void on(const block_header_with_merkle_path& b);
    void on(const icp_actions& ia);
+   void on(const block_headers_with_merkle_paths& b);
+   void on(const icp_compact_actions& ia);
+   void on(const icp_batched_actions& ia);
 
    enum session_state {
       hello_state,
@@ -94,14 +106,15 @@ private:
    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
 
    relay_ptr relay_;
+   channel_ptr channel_; // given for outgoing sessions, chosen by the hello of the peer for incoming ones
 
    session_state state_ = hello_state;
 
    string remote_host_;
    string remote_port_;
 
-   deque<icp_message> msg_buffer_;
-   vector<char> out_buffer_;
+   deque<icp_frame> msg_buffer_;
+   icp_frame out_buffer_;
    boost::beast::flat_buffer in_buffer_;
 
    bool recv_remote_hello_ = false;
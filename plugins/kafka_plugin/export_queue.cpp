@@ -0,0 +1,104 @@
+#include "export_queue.hpp"
+
+#include "try_handle.hpp"
+
+namespace kafka {
+
+export_queue::export_queue(size_t capacity)
+    : queue_(std::min(std::max<size_t>(capacity, 1), max_capacity)),
+      depth_metric_(chain::metrics_registry::instance().gauge("eosio_kafka_queue_depth",
+                                                              "blocks and transaction traces waiting for the kafka encoder threads")) {}
+
+export_queue::~export_queue() {
+    stop();
+}
+
+void export_queue::start(unsigned threads, std::function<void(const export_job&)> handler) {
+    handler_ = std::move(handler);
+    done_ = false;
+    for (unsigned i = 0; i < std::max(threads, 1u); ++i) {
+        threads_.emplace_back([this, i] {
+            chain::thread_registry::instance().register_current_thread("kafka-" + std::to_string(i));
+            run();
+        });
+    }
+    running_ = true;
+}
+
+void export_queue::stop() {
+    if (threads_.empty()) return;
+
+    running_ = false;
+    done_ = true;
+    cv_.notify_all();
+    for (auto& t: threads_) t.join();
+    threads_.clear();
+
+    report(true);
+}
+
+void export_queue::push(export_job job) {
+    // without encoder threads nothing would make room, and a full queue would stall the caller for good
+    if (not running_) {
+        if (dropped_++ == 0) elog("kafka export queue has no encoder threads, dropping what is pushed");
+        return;
+    }
+
+    auto j = new export_job(std::move(job));
+
+    if (not queue_.bounded_push(j)) {
+        auto start = fc::time_point::now();
+        ++stalls_;
+        do {
+            cv_.notify_all();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        } while (not queue_.bounded_push(j));
+        stall_time_ += fc::time_point::now() - start;
+    }
+
+    auto depth = ++depth_;
+    depth_metric_.add(1);
+    if (depth > max_depth_) max_depth_ = depth;
+    ++pushed_;
+    cv_.notify_one();
+
+    report(false);
+}
+
+void export_queue::run() {
+    while (true) {
+        export_job* j = nullptr;
+        if (queue_.pop(j)) {
+            --depth_;
+            depth_metric_.add(-1);
+            handle([&] { handler_(*j); }, "export");
+            delete j;
+            continue;
+        }
+
+        if (done_) break;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::milliseconds(10), [this] { return done_ or not queue_.empty(); });
+    }
+}
+
+void export_queue::report(bool force) {
+    auto now = fc::time_point::now();
+    if (not force and (stalls_ == 0 or now - last_report_ < fc::seconds(10))) return;
+    last_report_ = now;
+
+    auto log = [&] {
+        return fc::mutable_variant_object()("pushed", pushed_)("depth", depth_.load())("max_depth", max_depth_)
+                ("stalls", stalls_)("stall_ms", stall_time_.count() / 1000);
+    };
+    if (stalls_) wlog("kafka export queue back-pressure: ${s}", ("s", log()));
+    else ilog("kafka export queue: ${s}", ("s", log()));
+
+    // `pushed_` is a running total, the others are per report interval
+    max_depth_ = depth_;
+    stalls_ = 0;
+    stall_time_ = fc::microseconds();
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <boost/lockfree/queue.hpp>
+
+#include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_registry.hpp>
+
+namespace kafka {
+
+using namespace std;
+using namespace eosio;
+
+struct export_job {
+    chain::signed_block_ptr block;
+    chain::transaction_trace_ptr trace;
+    bool irreversible{};
+    bool marker{}; // only mark the block, which has been sent in full, irreversible
+    chain::block_state_ptr state; // of `block`, which packs it once for all its consumers, null for blocks read from the log
+};
+
+/**
+ * Bounded lock-free queue between the controller signals and a pool of encoder threads,
+ * so that building and producing messages do not run on the chain thread.
+ * A full queue blocks the signal thread, which is counted as a stall.
+ */
+class export_queue {
+public:
+    static constexpr size_t max_capacity = 65534; // limited by the tagged node indices of the queue
+
+    explicit export_queue(size_t capacity);
+    ~export_queue();
+
+    void start(unsigned threads, std::function<void(const export_job&)> handler);
+    /// Stop the encoder threads after the queued jobs are done
+    void stop();
+
+    /// Drops the job when the encoder threads are not running
+    void push(export_job job);
+
+private:
+    void run();
+    void report(bool force);
+
+    boost::lockfree::queue<export_job*, boost::lockfree::fixed_sized<true>> queue_;
+    std::function<void(const export_job&)> handler_;
+    vector<std::thread> threads_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::atomic<bool> done_{false};
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::atomic<uint64_t> depth_{0};
+    chain::metric_gauge& depth_metric_;
+    uint64_t max_depth_{}; // only accessed on the signal thread
+    uint64_t pushed_{};
+    uint64_t stalls_{};
+    fc::microseconds stall_time_{};
+    fc::time_point last_report_ = fc::time_point::now();
+};
+
+}
@@ -1,6 +1,9 @@
 #include "kafka.hpp"
 
+#include <fstream>
+
 #include <fc/io/json.hpp>
+#include <eosio/chain/abi_def.hpp>
 
 #include "try_handle.hpp"
 
@@ -40,6 +43,113 @@ TransactionStatus transactionStatus(fc::enum_type<uint8_t, chain::transaction_re
 
 }
 
+/**
+ * The messages of one block or one transaction trace, encoded one after the other into one buffer and handed to the
+ * producer together, which copies them into its own queue.
+ */
+class message_batch {
+public:
+    /// `write(stream)` packs the payload, and is called twice: to size it and to write it
+    template<typename Write>
+    void add(const string& topic, const void* key, size_t key_size, Write&& write) {
+        auto r = begin(topic, key, key_size);
+        fc::datastream<size_t> sizer;
+        write(sizer);
+        r.payload_size = sizer.tellp();
+        arena_.resize(r.payload + r.payload_size);
+        fc::datastream<char*> ds(arena_.data() + r.payload, r.payload_size);
+        write(ds);
+        records_.push_back(r);
+    }
+
+    void add(const string& topic, const void* key, size_t key_size, const string& payload) {
+        auto r = begin(topic, key, key_size);
+        arena_.insert(arena_.end(), payload.begin(), payload.end());
+        r.payload_size = payload.size();
+        records_.push_back(r);
+    }
+
+    void produce(Producer& producer, int partition) {
+        for (const auto& r: records_) {
+            producer.produce(MessageBuilder(*r.topic).partition(partition)
+                .key(Buffer(arena_.data() + r.key, r.key_size)).payload(Buffer(arena_.data() + r.payload, r.payload_size)));
+        }
+        records_.clear();
+        arena_.clear();
+    }
+
+private:
+    struct record {
+        const string* topic;
+        size_t key;
+        size_t key_size;
+        size_t payload;
+        size_t payload_size;
+    };
+
+    record begin(const string& topic, const void* key, size_t key_size) {
+        record r{&topic, arena_.size(), key_size, 0, 0};
+        arena_.insert(arena_.end(), static_cast<const char*>(key), static_cast<const char*>(key) + key_size);
+        r.payload = arena_.size();
+        return r;
+    }
+
+    bytes arena_;
+    vector<record> records_;
+};
+
+namespace {
+
+// ABI of the `fc::raw` payloads, see types.hpp
+chain::abi_def payload_abi() {
+    chain::abi_def abi;
+    abi.version = "eosio::abi/1.0";
+    abi.structs = {
+        {"block", "", {
+            {"id", "bytes"}, {"num", "uint32"}, {"timestamp", "block_timestamp_type"}, {"lib", "bool"}, {"block", "bytes"},
+            {"tx_count", "uint32"}, {"action_count", "uint32"}, {"context_free_action_count", "uint32"}
+        }},
+        {"block_irreversible", "", {
+            {"id", "bytes"}, {"num", "uint32"}
+        }},
+        {"transaction", "", {
+            {"id", "bytes"}, {"block_id", "bytes"}, {"block_num", "uint32"}, {"block_time", "block_timestamp_type"},
+            {"block_seq", "uint16"}, {"action_count", "uint32"}, {"context_free_action_count", "uint32"}
+        }},
+        {"transaction_trace", "", {
+            {"id", "bytes"}, {"block_num", "uint32"}, {"scheduled", "bool"}, {"status", "int64"}, // enum packed as int64
+            {"net_usage_words", "uint32"}, {"cpu_usage_us", "uint32"}, {"exception", "string"}
+        }},
+        {"action", "", {
+            {"global_seq", "uint64"}, {"recv_seq", "uint64"}, {"parent_seq", "uint64"}, {"account", "name"}, {"name", "name"},
+            {"auth", "bytes"}, {"data", "bytes"}, {"receiver", "name"}, {"auth_seq", "bytes"}, {"code_seq", "uint32"},
+            {"abi_seq", "uint32"}, {"block_num", "uint32"}, {"tx_id", "bytes"}, {"console", "string"}
+        }}
+    };
+    return abi;
+}
+
+}
+
+std::istream& operator>>(std::istream& in, payload_format& format) {
+    std::string s;
+    in >> s;
+    if (s == "json") format = payload_format::json;
+    else if (s == "raw") format = payload_format::raw;
+    else in.setstate(std::ios_base::failbit);
+    return in;
+}
+
+std::istream& operator>>(std::istream& in, partition_key& key) {
+    std::string s;
+    in >> s;
+    if (s == "id") key = partition_key::id;
+    else if (s == "receiver") key = partition_key::receiver;
+    else if (s == "account") key = partition_key::account;
+    else in.setstate(std::ios_base::failbit);
+    return in;
+}
+
 void kafka::set_config(Configuration config) {
     config_ = config;
 }
@@ -51,135 +161,249 @@ void kafka::set_topics(const string& block_topic, const string& tx_topic, const
     action_topic_ = action_topic;
 }
 
+void kafka::set_irreversible_topic(const string& topic) {
+    irreversible_topic_ = topic;
+}
+
 void kafka::set_partition(int partition) {
     partition_ =  partition;
 }
 
+void kafka::set_payload_format(payload_format format, const string& schema_topic) {
+    payload_format_ = format;
+    schema_topic_ = schema_topic;
+}
+
+void kafka::set_action_routes(vector<action_route> routes, partition_key key) {
+    action_routes_ = std::move(routes);
+    action_partition_key_ = key;
+}
+
+void kafka::set_checkpoint(const fc::path& file, uint32_t interval) {
+    checkpoint_file_ = file;
+    checkpoint_interval_ = std::max(interval, 1u);
+
+    if (fc::exists(checkpoint_file_)) {
+        std::ifstream in(checkpoint_file_.generic_string());
+        in >> checkpoint_;
+        ilog("Kafka export checkpoint at block ${n}", ("n", checkpoint_));
+    } else {
+        fc::create_directories(checkpoint_file_.parent_path());
+    }
+    delivered_ = checkpoint_;
+}
+
+void kafka::queue_irreversible(uint32_t block_num) {
+    if (checkpoint_file_.empty()) return;
+    std::lock_guard<std::mutex> lock(checkpoint_mtx_);
+    queued_irreversible_.insert(block_num);
+}
+
+// Called after the irreversible block `block_num` has been produced
+void kafka::checkpoint(uint32_t block_num) {
+    if (checkpoint_file_.empty()) return;
+    uint32_t safe;
+    {
+        std::lock_guard<std::mutex> lock(checkpoint_mtx_);
+        queued_irreversible_.erase(block_num);
+        delivered_ = std::max(delivered_, block_num);
+        // with several encoder threads, earlier blocks may still be in progress
+        safe = queued_irreversible_.empty() ? delivered_ : std::min(delivered_, *queued_irreversible_.begin() - 1);
+        if (checkpointing_ or safe < checkpoint_ + checkpoint_interval_) return;
+        checkpointing_ = true; // one encoder thread waits for the broker at a time
+    }
+
+    // wait for the acknowledgements of everything produced so far, without holding up the other threads
+    producer_->flush();
+
+    std::lock_guard<std::mutex> lock(checkpoint_mtx_);
+    if (safe > checkpoint_) write_checkpoint(safe);
+    checkpointing_ = false;
+}
+
+void kafka::write_checkpoint(uint32_t block_num) {
+    auto tmp = checkpoint_file_;
+    tmp.replace_extension(".tmp");
+    {
+        std::ofstream out(tmp.generic_string(), std::ios::trunc);
+        out << block_num;
+    }
+    fc::rename(tmp, checkpoint_file_);
+    checkpoint_ = block_num;
+}
+
+const string* kafka::route_action(const chain::action& act) const {
+    for (auto& r: action_routes_) {
+        if (r.account and r.account != act.account.value) continue;
+        if (r.action and r.action != act.name.value) continue;
+        return r.topic.empty() ? nullptr : &r.topic;
+    }
+    return &action_topic_;
+}
+
 void kafka::start() {
     producer_ = std::make_unique<Producer>(config_);
 
     auto conf = producer_->get_configuration().get_all();
     ilog("Kafka config: ${conf}", ("conf", conf));
+
+    if (payload_format_ == payload_format::raw) publish_schema();
+}
+
+void kafka::publish_schema() {
+    auto payload = fc::json::to_string(payload_abi(), fc::json::legacy_generator);
+    string key = "abi";
+    producer_->produce(MessageBuilder(schema_topic_).partition(partition_).key(Buffer(key.data(), key.size())).payload(payload));
 }
 
 void kafka::stop() {
     producer_->flush();
 
+    if (not checkpoint_file_.empty()) {
+        std::lock_guard<std::mutex> lock(checkpoint_mtx_);
+        auto safe = queued_irreversible_.empty() ? delivered_ : std::min(delivered_, *queued_irreversible_.begin() - 1);
+        if (safe > checkpoint_) write_checkpoint(safe);
+    }
+
     producer_.reset();
 }
 
-void kafka::push_block(const chain::block_state_ptr& block_state, bool irreversible) {
-    const auto& header = block_state->header;
-    auto b = std::make_shared<Block>();
+void kafka::push_block(const chain::signed_block_ptr& block, bool irreversible, const chain::block_state_ptr& state) {
+    Block b{};
 
-    b->id = checksum_bytes(block_state->id);
-    b->num = block_state->block_num;
-    b->timestamp = header.timestamp;
+    b.id = checksum_bytes(block->id());
+    b.num = block->block_num();
+    b.timestamp = block->timestamp;
 
-    b->lib = irreversible;
+    b.lib = irreversible;
 
-    b->block = fc::raw::pack(*block_state->block);
-    b->tx_count = static_cast<uint32_t>(block_state->block->transactions.size());
+    b.tx_count = static_cast<uint32_t>(block->transactions.size());
 
+    message_batch batch;
     uint16_t seq{};
-    for (const auto& tx_receipt: block_state->block->transactions) {
-        auto count = push_transaction(tx_receipt, b, seq++);
-        b->action_count += count.first;
-        b->context_free_action_count += count.second;
+    for (const auto& tx_receipt: block->transactions) {
+        auto count = push_transaction(tx_receipt, b, seq++, batch);
+        b.action_count += count.first;
+        b.context_free_action_count += count.second;
     }
 
-    consume_block(b);
+    auto packed = state ? state->packed_block() : std::make_shared<const bytes>(fc::raw::pack(*block));
+    if (payload_format_ == payload_format::raw) {
+        // in the order of FC_REFLECT(kafka::Block), with the packed block written from where it is shared
+        batch.add(block_topic_, b.id.data(), b.id.size(), [&](auto& s) {
+            fc::raw::pack(s, b.id);
+            fc::raw::pack(s, b.num);
+            fc::raw::pack(s, b.timestamp);
+            fc::raw::pack(s, b.lib);
+            fc::raw::pack(s, fc::unsigned_int(static_cast<uint32_t>(packed->size())));
+            s.write(packed->data(), packed->size());
+            fc::raw::pack(s, b.tx_count);
+            fc::raw::pack(s, b.action_count);
+            fc::raw::pack(s, b.context_free_action_count);
+        });
+    } else {
+        b.block.assign(packed->begin(), packed->end());
+        encode(batch, block_topic_, b.id.data(), b.id.size(), b);
+    }
+    batch.produce(*producer_, partition_);
+
+    if (irreversible) checkpoint(b.num);
 }
 
-std::pair<uint32_t, uint32_t> kafka::push_transaction(const chain::transaction_receipt& tx_receipt, const BlockPtr& block, uint16_t block_seq) {
-    auto t = std::make_shared<Transaction>();
+void kafka::push_irreversible_marker(const chain::signed_block_ptr& block) {
+    BlockIrreversible m{checksum_bytes(block->id()), block->block_num()};
+    message_batch batch;
+    encode(batch, irreversible_topic_, m.id.data(), m.id.size(), m);
+    batch.produce(*producer_, partition_);
+
+    checkpoint(m.num);
+}
+
+std::pair<uint32_t, uint32_t> kafka::push_transaction(const chain::transaction_receipt& tx_receipt, const Block& block, uint16_t block_seq, message_batch& batch) {
+    Transaction t{};
     if(tx_receipt.trx.contains<transaction_id_type>()) {
-        t->id = checksum_bytes(tx_receipt.trx.get<transaction_id_type>());
+        t.id = checksum_bytes(tx_receipt.trx.get<transaction_id_type>());
     } else {
-        auto signed_tx = tx_receipt.trx.get<chain::packed_transaction>().get_signed_transaction();
-        t->id = checksum_bytes(signed_tx.id());
-        t->action_count = static_cast<uint32_t>(signed_tx.actions.size());
-        t->context_free_action_count = static_cast<uint32_t>(signed_tx.context_free_actions.size());
+        // only the transaction itself, neither its signatures nor its context free data, and without touching the
+        // unpacked copy cached in the packed_transaction of the shared block
+        auto tx = fc::raw::unpack<transaction>(tx_receipt.trx.get<chain::packed_transaction>().get_raw_transaction());
+        t.id = checksum_bytes(tx.id());
+        t.action_count = static_cast<uint32_t>(tx.actions.size());
+        t.context_free_action_count = static_cast<uint32_t>(tx.context_free_actions.size());
     }
-    t->block_id = block->id;
-    t->block_num = block->num;
-    t->block_time = block->timestamp;
-    t->block_seq = block_seq;
+    t.block_id = block.id;
+    t.block_num = block.num;
+    t.block_time = block.timestamp;
+    t.block_seq = block_seq;
 
-    consume_transaction(t);
+    encode(batch, tx_topic_, t.id.data(), t.id.size(), t);
 
-    return {t->action_count, t->context_free_action_count};
+    return {t.action_count, t.context_free_action_count};
 }
 
 void kafka::push_transaction_trace(const chain::transaction_trace_ptr& tx_trace) {
-    auto t = std::make_shared<TransactionTrace>();
+    TransactionTrace t{};
 
-    t->id = checksum_bytes(tx_trace->id);
-    t->block_num = tx_trace->block_num;
-    t->scheduled = tx_trace->scheduled;
+    t.id = checksum_bytes(tx_trace->id);
+    t.block_num = tx_trace->block_num;
+    t.scheduled = tx_trace->scheduled;
     if (tx_trace->receipt) {
-        t->status = transactionStatus(tx_trace->receipt->status);
-        t->cpu_usage_us = tx_trace->receipt->cpu_usage_us;
-        t->net_usage_words = tx_trace->receipt->net_usage_words;
+        t.status = transactionStatus(tx_trace->receipt->status);
+        t.cpu_usage_us = tx_trace->receipt->cpu_usage_us;
+        t.net_usage_words = tx_trace->receipt->net_usage_words;
     }
     if (tx_trace->except) {
-        t->exception = tx_trace->except->to_string();
+        t.exception = tx_trace->except->to_string();
     }
 
-    consume_transaction_trace(t);
+    message_batch batch;
+    encode(batch, tx_trace_topic_, t.id.data(), t.id.size(), t);
 
     for (auto& action_trace: tx_trace->action_traces) {
-        push_action(action_trace, 0, t); // 0 means no parent
+        push_action(action_trace, 0, batch); // 0 means no parent
     }
+    batch.produce(*producer_, partition_);
 }
 
-void kafka::push_action(const chain::action_trace& action_trace, uint64_t parent_seq, const TransactionTracePtr& tx) {
-    auto a = std::make_shared<Action>();
-
-    a->global_seq = action_trace.receipt.global_sequence;
-    a->recv_seq = action_trace.receipt.recv_sequence;
-    a->parent_seq = parent_seq;
-    a->account = action_trace.act.account;
-    a->name = action_trace.act.name;
-    if (not action_trace.act.authorization.empty()) a->auth = fc::raw::pack(action_trace.act.authorization);
-    a->data = action_trace.act.data;
-    a->receiver = action_trace.receipt.receiver;
-    if (not action_trace.receipt.auth_sequence.empty()) a->auth_seq = fc::raw::pack(action_trace.receipt.auth_sequence);
-    a->code_seq = action_trace.receipt.code_sequence;
-    a->abi_seq = action_trace.receipt.abi_sequence;
-    a->block_num = action_trace.block_num;
-    a->tx_id = checksum_bytes(action_trace.trx_id);
-    if (not action_trace.console.empty()) a->console = action_trace.console;
-
-    consume_action(a);
+void kafka::push_action(const chain::action_trace& action_trace, uint64_t parent_seq, message_batch& batch) {
+    // filter before building the message, but still visit the inline traces, which route on their own
+    auto topic = route_action(action_trace.act);
+    if (topic) {
+        Action a{};
+
+        a.global_seq = action_trace.receipt.global_sequence;
+        a.recv_seq = action_trace.receipt.recv_sequence;
+        a.parent_seq = parent_seq;
+        a.account = action_trace.act.account;
+        a.name = action_trace.act.name;
+        if (not action_trace.act.authorization.empty()) a.auth = fc::raw::pack(action_trace.act.authorization);
+        a.data = action_trace.act.data;
+        a.receiver = action_trace.receipt.receiver;
+        if (not action_trace.receipt.auth_sequence.empty()) a.auth_seq = fc::raw::pack(action_trace.receipt.auth_sequence);
+        a.code_seq = action_trace.receipt.code_sequence;
+        a.abi_seq = action_trace.receipt.abi_sequence;
+        a.block_num = action_trace.block_num;
+        a.tx_id = checksum_bytes(action_trace.trx_id);
+        if (not action_trace.console.empty()) a.console = action_trace.console;
+
+        const name_t* key = &a.global_seq;
+        if (action_partition_key_ == partition_key::receiver) key = &a.receiver;
+        else if (action_partition_key_ == partition_key::account) key = &a.account;
+        encode(batch, *topic, key, sizeof(*key), a);
+    }
 
     for (auto& inline_trace: action_trace.inline_traces) {
-        push_action(inline_trace, action_trace.receipt.global_sequence, tx);
+        push_action(inline_trace, action_trace.receipt.global_sequence, batch);
     }
 }
 
-void kafka::consume_block(BlockPtr block) {
-    auto payload = fc::json::to_string(*block, fc::json::legacy_generator);
-    Buffer buffer (block->id.data(), block->id.size());
-    producer_->produce(MessageBuilder(block_topic_).partition(partition_).key(buffer).payload(payload));
-}
-
-void kafka::consume_transaction(TransactionPtr tx) {
-    auto payload = fc::json::to_string(*tx, fc::json::legacy_generator);
-    Buffer buffer (tx->id.data(), tx->id.size());
-    producer_->produce(MessageBuilder(tx_topic_).partition(partition_).key(buffer).payload(payload));
-}
-
-void kafka::consume_transaction_trace(TransactionTracePtr tx_trace) {
-    auto payload = fc::json::to_string(*tx_trace, fc::json::legacy_generator);
-    Buffer buffer (tx_trace->id.data(), tx_trace->id.size());
-    producer_->produce(MessageBuilder(tx_trace_topic_).partition(partition_).key(buffer).payload(payload));
-}
-
-void kafka::consume_action(ActionPtr action) {
-    auto payload = fc::json::to_string(*action, fc::json::legacy_generator);
-    Buffer buffer((char*)&action->global_seq, sizeof(action->global_seq));
-    producer_->produce(MessageBuilder(action_topic_).partition(partition_).key(buffer).payload(payload));
+template<typename T>
+void kafka::encode(message_batch& batch, const string& topic, const void* key, size_t key_size, const T& message) {
+    if (payload_format_ == payload_format::raw) {
+        batch.add(topic, key, key_size, [&](auto& s) { fc::raw::pack(s, message); });
+    } else {
+        batch.add(topic, key, key_size, fc::json::to_string(message, fc::json::legacy_generator));
+    }
 }
 
 }
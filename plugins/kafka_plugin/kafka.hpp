@@ -1,7 +1,11 @@
 #pragma once
 
+#include <mutex>
+#include <set>
+
 #include <cppkafka/cppkafka.h>
 
+#include <fc/filesystem.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
 #include "types.hpp"
@@ -12,33 +16,83 @@ using namespace std;
 using namespace cppkafka;
 using namespace eosio;
 
+enum class payload_format {
+    json, // JSON by fc::json legacy generator
+    raw // fc::raw, with the ABI of the payloads published on the schema topic
+};
+
+std::istream& operator>>(std::istream& in, payload_format& format);
+
+/// Route of actions of contract `account` and name `action` to `topic`; 0 matches any, and an empty topic drops them
+struct action_route {
+    name_t account{};
+    name_t action{};
+    string topic;
+};
+
+enum class partition_key {
+    id, // action global sequence
+    receiver,
+    account
+};
+
+std::istream& operator>>(std::istream& in, partition_key& key);
+
+class message_batch;
+
 class kafka {
 public:
     void set_config(Configuration config);
     void set_topics(const string& block_topic, const string& tx_topic, const string& tx_trace_topic, const string& action_topic);
+    void set_irreversible_topic(const string& topic);
     void set_partition(int partition);
+    void set_payload_format(payload_format format, const string& schema_topic);
+    void set_action_routes(vector<action_route> routes, partition_key key);
+    /// Persist the last delivered irreversible block number into `file` every `interval` blocks
+    void set_checkpoint(const fc::path& file, uint32_t interval);
+    uint32_t checkpoint_block_num() const { return checkpoint_; }
+    /// Call on the signal thread before queueing an irreversible block, so that the checkpoint never passes it
+    void queue_irreversible(uint32_t block_num);
     void start();
     void stop();
 
-    void push_block(const chain::block_state_ptr& block_state, bool irreversible);
-    std::pair<uint32_t, uint32_t> push_transaction(const chain::transaction_receipt& transaction_receipt, const BlockPtr& block, uint16_t block_seq);
+    void push_block(const chain::signed_block_ptr& block, bool irreversible, const chain::block_state_ptr& state = nullptr);
+    void push_irreversible_marker(const chain::signed_block_ptr& block);
     void push_transaction_trace(const chain::transaction_trace_ptr& transaction_trace);
-    void push_action(const chain::action_trace& action_trace, uint64_t parent_seq, const TransactionTracePtr& tx);
 
 private:
-    void consume_block(BlockPtr block);
-    void consume_transaction(TransactionPtr tx);
-    void consume_transaction_trace(TransactionTracePtr tx_trace);
-    void consume_action(ActionPtr action);
+    std::pair<uint32_t, uint32_t> push_transaction(const chain::transaction_receipt& transaction_receipt, const Block& block, uint16_t block_seq, message_batch& batch);
+    void push_action(const chain::action_trace& action_trace, uint64_t parent_seq, message_batch& batch);
+    const string* route_action(const chain::action& act) const;
+
+    template<typename T>
+    void encode(message_batch& batch, const string& topic, const void* key, size_t key_size, const T& message);
+    void publish_schema();
+    void checkpoint(uint32_t block_num);
+    void write_checkpoint(uint32_t block_num);
 
     Configuration config_;
     string block_topic_;
     string tx_topic_;
     string tx_trace_topic_;
     string action_topic_;
+    string irreversible_topic_;
 
     int partition_{-1};
 
+    payload_format payload_format_{payload_format::json};
+    vector<action_route> action_routes_; // the first match wins
+    partition_key action_partition_key_{partition_key::id};
+
+    fc::path checkpoint_file_;
+    uint32_t checkpoint_interval_{};
+    uint32_t checkpoint_{}; // last persisted, written under `checkpoint_mtx_`
+    std::mutex checkpoint_mtx_;
+    uint32_t delivered_{}; // guarded by `checkpoint_mtx_`
+    bool checkpointing_{false}; // a thread is flushing the producer before writing the checkpoint, guarded by `checkpoint_mtx_`
+    std::set<uint32_t> queued_irreversible_; // guarded by `checkpoint_mtx_`
+    string schema_topic_;
+
     std::unique_ptr<Producer> producer_;
 };
 
@@ -3,6 +3,7 @@
 #include <fc/io/json.hpp>
 
 #include "kafka.hpp"
+#include "export_queue.hpp"
 #include "try_handle.hpp"
 
 namespace eosio {
@@ -22,6 +23,22 @@ enum class compression_codec {
     lz4
 };
 
+enum class block_mode {
+    both,
+    irreversible,
+    marker
+};
+
+std::istream& operator>>(std::istream& in, block_mode& mode) {
+    std::string s;
+    in >> s;
+    if (s == "both") mode = block_mode::both;
+    else if (s == "irreversible") mode = block_mode::irreversible;
+    else if (s == "marker") mode = block_mode::marker;
+    else in.setstate(std::ios_base::failbit);
+    return in;
+}
+
 std::istream& operator>>(std::istream& in, compression_codec& codec) {
     std::string s;
     in >> s;
@@ -46,6 +63,12 @@ void kafka_plugin::set_program_options(options_description&, options_description
             ("kafka-transaction-topic", bpo::value<string>()->default_value("eos.txs"), "Kafka topic for message `transaction`")
             ("kafka-transaction-trace-topic", bpo::value<string>()->default_value("eos.txtraces"), "Kafka topic for message `transaction_trace`")
             ("kafka-action-topic", bpo::value<string>()->default_value("eos.actions"), "Kafka topic for message `action`")
+            ("kafka-irreversible-topic", bpo::value<string>()->default_value("eos.irreversible"), "Kafka topic for message `block_irreversible` in kafka-block-mode=marker")
+            ("kafka-block-mode", bpo::value<block_mode>()->value_name("both/irreversible/marker"), "Kafka which blocks are sent with their transactions, default is both: both=accepted and irreversible blocks, irreversible=irreversible blocks only, marker=accepted blocks, and then a `block_irreversible` message referring to each by id")
+            ("kafka-payload-format", bpo::value<kafka::payload_format>()->value_name("json/raw"), "Kafka payload encoding of messages, default is json; raw is fc::raw binary, whose ABI is published on kafka-schema-topic")
+            ("kafka-schema-topic", bpo::value<string>()->default_value("eos.schema"), "Kafka topic for the ABI of raw payloads")
+            ("kafka-action-route", bpo::value<vector<string>>()->composing()->multitoken(), "Kafka routing rule of actions, formatted as contract:action=topic, where contract or action may be * to match any, e.g., eosio.token:transfer=eos.transfers; an empty topic drops the matched actions before encoding; the first matching rule applies, and unmatched actions go to kafka-action-topic (may specify multiple times)")
+            ("kafka-action-partition-by", bpo::value<kafka::partition_key>()->value_name("id/receiver/account"), "Kafka key of action messages for partitioning, default is id (the action global sequence)")
             ("kafka-batch-num-messages", bpo::value<unsigned>()->default_value(1024), "Kafka minimum number of messages to wait for to accumulate in the local queue before sending off a message set")
             ("kafka-queue-buffering-max-ms", bpo::value<unsigned>()->default_value(500), "Kafka how long to wait for kafka-batch-num-messages to fill up in the local queue")
             ("kafka-compression-codec", bpo::value<compression_codec>()->value_name("none/gzip/snappy/lz4"), "Kafka compression codec to use for compressing message sets, default is snappy")
@@ -54,6 +77,10 @@ void kafka_plugin::set_program_options(options_description&, options_description
             ("kafka-start-block-num", bpo::value<unsigned>()->default_value(1), "Kafka starts syncing from which block number")
             ("kafka-statistics-interval-ms", bpo::value<unsigned>()->default_value(0), "Kafka statistics emit interval, maximum is 86400000, 0 disables statistics")
             ("kafka-fixed-partition", bpo::value<int>()->default_value(-1), "Kafka specify fixed partition for all topics, -1 disables specify")
+            ("kafka-enable-idempotence", bpo::value<bool>()->default_value(true), "Kafka idempotent producer, so that retries never duplicate or reorder messages; implies kafka-request-required-acks=-1")
+            ("kafka-checkpoint-interval", bpo::value<unsigned>()->default_value(1000), "Kafka persist the last delivered irreversible block number in the data dir every this number of blocks, and resume from there on restart; 0 disables")
+            ("kafka-encoder-threads", bpo::value<unsigned>()->default_value(1), "Kafka number of threads building and producing messages off the chain thread; more than 1 does not keep the order of messages across blocks")
+            ("kafka-queue-size", bpo::value<unsigned>()->default_value(4096), "Kafka maximum number of blocks and transaction traces waiting for the encoder threads, at most 65534; the chain thread waits when it is full")
             ;
     // TODO: security options
 }
@@ -94,6 +121,13 @@ void kafka_plugin::plugin_initialize(const variables_map& options) {
             {"message.send.max.retries", options.at("kafka-message-send-max-retries").as<unsigned>()},
             {"socket.keepalive.enable", true}
     };
+    if (options.at("kafka-enable-idempotence").as<bool>()) {
+        if (options.at("kafka-request-required-acks").as<int>() != -1) {
+            ilog("kafka-request-required-acks is set to -1 by kafka-enable-idempotence");
+        }
+        config.set("enable.idempotence", true);
+        config.set("request.required.acks", -1);
+    }
     auto stats_interval = options.at("kafka-statistics-interval-ms").as<unsigned>();
     if (stats_interval > 0) {
         config.set("statistics.interval.ms", stats_interval);
@@ -109,40 +143,117 @@ void kafka_plugin::plugin_initialize(const variables_map& options) {
             options.at("kafka-action-topic").as<string>()
     );
 
+    kafka_->set_irreversible_topic(options.at("kafka-irreversible-topic").as<string>());
+    auto mode = options.count("kafka-block-mode") ? options.at("kafka-block-mode").as<block_mode>() : block_mode::both;
+
+    if (options.count("kafka-payload-format")) {
+        kafka_->set_payload_format(options.at("kafka-payload-format").as<kafka::payload_format>(), options.at("kafka-schema-topic").as<string>());
+    }
+
+    {
+        vector<kafka::action_route> routes;
+        if (options.count("kafka-action-route")) {
+            for (auto& s: options.at("kafka-action-route").as<vector<string>>()) {
+                auto colon = s.find(':');
+                auto eq = s.find('=');
+                EOS_ASSERT(colon != string::npos and eq != string::npos and colon < eq, chain::plugin_config_exception,
+                           "Invalid kafka-action-route ${r}, expected contract:action=topic", ("r", s));
+                auto to_name = [](const string& n) -> kafka::name_t { return n == "*" ? 0 : chain::string_to_name(n.c_str()); };
+                routes.push_back(kafka::action_route{to_name(s.substr(0, colon)), to_name(s.substr(colon + 1, eq - colon - 1)), s.substr(eq + 1)});
+            }
+        }
+        auto key = options.count("kafka-action-partition-by") ? options.at("kafka-action-partition-by").as<kafka::partition_key>() : kafka::partition_key::id;
+        kafka_->set_action_routes(std::move(routes), key);
+    }
+
     if (options.at("kafka-fixed-partition").as<int>() >= 0) {
         kafka_->set_partition(options.at("kafka-fixed-partition").as<int>());
     }
 
     unsigned start_block_num = options.at("kafka-start-block-num").as<unsigned>();
 
+    auto checkpoint_interval = options.at("kafka-checkpoint-interval").as<unsigned>();
+    if (checkpoint_interval > 0) {
+        kafka_->set_checkpoint(app().data_dir() / "kafka" / "checkpoint", checkpoint_interval);
+        // skip the blocks already delivered, e.g., on replay
+        start_block_num = std::max(start_block_num, kafka_->checkpoint_block_num() + 1);
+    }
+    start_block_num_ = start_block_num;
+
+    encoder_threads_ = options.at("kafka-encoder-threads").as<unsigned>();
+    queue_ = std::make_unique<kafka::export_queue>(options.at("kafka-queue-size").as<unsigned>());
+
+    // the consumers run before any signal is connected: chain_plugin replays the blocks log in its startup,
+    // before ours, and the handlers of the replayed blocks would otherwise wait on a full queue forever
+    kafka_->start();
+    queue_->start(encoder_threads_, [this](const kafka::export_job& job) {
+        if (job.marker) kafka_->push_irreversible_marker(job.block);
+        else if (job.block) kafka_->push_block(job.block, job.irreversible, job.state);
+        else kafka_->push_transaction_trace(job.trace);
+    });
+
     // add callback to chain_controller config
     chain_plugin_ = app().find_plugin<chain_plugin>();
     auto& chain = chain_plugin_->chain();
 
-    block_conn_ = chain.accepted_block.connect([=](const chain::block_state_ptr& b) {
+    auto checkpoint = kafka_->checkpoint_block_num(); // as persisted at the last shutdown
+
+    // the handlers only feed the export queue, so they may run on the signal dispatch threads
+    signals_ = chain.get_signal_dispatcher().make_subscriber("kafka_plugin");
+    block_conn_ = signals_->connect(chain.accepted_block, [=](const chain::block_state_ptr& b) {
+        if (mode == block_mode::irreversible) return;
         if (not start_sync_) {
             if (b->block_num >= start_block_num) start_sync_ = true;
             else return;
         }
-        handle([=] { kafka_->push_block(b, false); }, "push block");
+        queue_->push(kafka::export_job{b->block, nullptr, false, false, b});
     });
-    irreversible_block_conn_ = chain.irreversible_block.connect([=](const chain::block_state_ptr& b) {
+    irreversible_block_conn_ = signals_->connect(chain.irreversible_block, [=](const chain::block_state_ptr& b) {
+        // at or below the checkpoint, as on a replay, the block was delivered before
+        if (b->block_num <= checkpoint or b->block_num <= last_queued_irreversible_) return;
         if (not start_sync_) {
             if (b->block_num >= start_block_num) start_sync_ = true;
             else return;
         }
-        handle([=] { kafka_->push_block(b, true); }, "push irreversible block");
+        last_queued_irreversible_ = b->block_num;
+        // blocks before the start were never sent as accepted, so send them in full
+        bool marker = mode == block_mode::marker and b->block_num >= start_block_num;
+        kafka_->queue_irreversible(b->block_num);
+        queue_->push(kafka::export_job{b->block, nullptr, true, marker, b});
     });
-    transaction_conn_ = chain.applied_transaction.connect([=](const chain::transaction_trace_ptr& t) {
+    transaction_conn_ = signals_->connect(chain.applied_transaction, [=](const chain::transaction_trace_ptr& t) {
         if (not start_sync_) return;
-        handle([=] { kafka_->push_transaction_trace(t); }, "push transaction");
+        queue_->push(kafka::export_job{nullptr, t, false});
     });
 }
 
 void kafka_plugin::plugin_startup() {
     if (not configured_) return;
     ilog("Starting kafka_plugin");
-    kafka_->start();
+
+    // re-export the irreversible blocks between the checkpoint and the last irreversible block,
+    // which have been applied but may not have been delivered before the last shutdown
+    auto& chain = chain_plugin_->chain();
+    auto lib = chain.last_irreversible_block_num();
+    if (kafka_->checkpoint_block_num() > 0 and start_block_num_ <= lib) {
+        ilog("Kafka re-export irreversible blocks ${f} to ${l}", ("f", start_block_num_)("l", lib));
+        vector<chain::signed_block_ptr> blocks;
+        for (auto n = start_block_num_; n <= lib; ++n) {
+            auto b = chain.fetch_block_by_number(n);
+            if (not b) break;
+            blocks.push_back(b);
+        }
+        // after the blocks of the replay, which may still wait on the dispatch threads and are not sent again
+        signals_->post([this, blocks = std::move(blocks)] {
+            for (const auto& b: blocks) {
+                if (b->block_num() <= last_queued_irreversible_) continue;
+                last_queued_irreversible_ = b->block_num();
+                kafka_->queue_irreversible(b->block_num());
+                queue_->push(kafka::export_job{b, nullptr, true});
+            }
+            start_sync_ = true;
+        });
+    }
     ilog("Started kafka_plugin");
 }
 
@@ -154,7 +265,9 @@ void kafka_plugin::plugin_shutdown() {
         block_conn_.disconnect();
         irreversible_block_conn_.disconnect();
         transaction_conn_.disconnect();
+        signals_->flush();
 
+        queue_->stop();
         kafka_->stop();
     } catch (const std::exception& e) {
         elog("Exception on kafka_plugin shutdown: ${e}", ("e", e.what()));
@@ -2,9 +2,11 @@
 
 #include <appbase/application.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain/signal_dispatcher.hpp>
 
 namespace kafka {
 class kafka; // forward declaration
+class export_queue;
 }
 
 namespace eosio {
@@ -32,10 +34,15 @@ private:
     boost::signals2::connection block_conn_;
     boost::signals2::connection irreversible_block_conn_;
     boost::signals2::connection transaction_conn_;
+    chain::signal_dispatcher::subscriber_ptr signals_; // keeps blocks and traces in order when they are dispatched off the main thread
 
     std::atomic<bool> start_sync_{false};
+    unsigned start_block_num_{1};
+    uint32_t last_queued_irreversible_{0}; // only access in the handlers of `signals_`
 
     std::unique_ptr<class kafka::kafka> kafka_;
+    std::unique_ptr<class kafka::export_queue> queue_;
+    unsigned encoder_threads_{1};
 };
 
 }
@@ -24,6 +24,11 @@ struct Block {
     uint32_t context_free_action_count{};
 };
 
+struct BlockIrreversible { // marks a block already sent as `Block` irreversible
+    bytes id;
+    unsigned num;
+};
+
 struct Transaction {
     bytes id;
 
@@ -79,6 +84,7 @@ struct Action {
 };
 
 using BlockPtr = std::shared_ptr<Block>;
+using BlockIrreversiblePtr = std::shared_ptr<BlockIrreversible>;
 using TransactionPtr = std::shared_ptr<Transaction>;
 using TransactionTracePtr = std::shared_ptr<TransactionTrace>;
 using ActionPtr = std::shared_ptr<Action>;
@@ -88,6 +94,7 @@ using ActionPtr = std::shared_ptr<Action>;
 FC_REFLECT_ENUM(kafka::TransactionStatus, (executed)(soft_fail)(hard_fail)(delayed)(expired)(unknown))
 
 FC_REFLECT(kafka::Block, (id)(num)(timestamp)(lib)(block)(tx_count)(action_count)(context_free_action_count))
+FC_REFLECT(kafka::BlockIrreversible, (id)(num))
 FC_REFLECT(kafka::Transaction, (id)(block_id)(block_num)(block_time)(block_seq)(action_count)(context_free_action_count))
 FC_REFLECT(kafka::TransactionTrace, (id)(block_num)(scheduled)(status)(net_usage_words)(cpu_usage_us)(exception))
 FC_REFLECT(kafka::Action, (global_seq)(recv_seq)(parent_seq)(account)(name)(auth)(data)(receiver)(auth_seq)(code_seq)(abi_seq)(block_num)(tx_id)(console))
@@ -4,10 +4,16 @@
  */
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
 #include <eosio/login_plugin/login_plugin.hpp>
 
 #include <fc/io/json.hpp>
 
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <map>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _login_plugin = app().register_plugin<login_plugin>();
@@ -20,29 +26,170 @@ struct login_request {
    chain::time_point_sec expiration_time;
 };
 
-struct login_request_pub_key_index {};
-struct login_request_time_index {};
+/**
+ * Pending login requests by public key, and a time wheel of their keys with a slot for each second of the longest
+ * timeout, so expiring them visits the slots of the seconds passed since the last time rather than an index of all
+ * requests ordered by time. A slot can still hold keys of a later lap of the wheel, which stay there.
+ * Only used on the application thread.
+ */
+class login_request_cache {
+ public:
+   void set_max_timeout(uint32_t seconds) { wheel.assign(seconds + 1, std::vector<chain::public_key_type>()); }
+
+   size_t size() const { return requests.size(); }
 
-using login_request_container = boost::multi_index_container<
-    login_request,
-    indexed_by< //
-        ordered_unique<tag<login_request_pub_key_index>,
-                       member<login_request, chain::public_key_type, &login_request::server_ephemeral_pub_key>>,
-        ordered_non_unique<tag<login_request_time_index>,
-                           member<login_request, chain::time_point_sec, &login_request::expiration_time>> //
-        >>;
+   void insert(const login_request& request) {
+      requests.emplace(request.server_ephemeral_pub_key, request);
+      wheel[request.expiration_time.sec_since_epoch() % wheel.size()].push_back(request.server_ephemeral_pub_key);
+   }
+
+   /// removes the request of the key, if any is left
+   fc::optional<login_request> take(const chain::public_key_type& key) {
+      auto it = requests.find(key);
+      if (it == requests.end())
+         return {};
+      login_request request = std::move(it->second);
+      requests.erase(it);
+      return request;
+   }
+
+   /// drops the requests that expired before now, to the second
+   void expire(fc::time_point_sec now) {
+      auto end = now.sec_since_epoch();
+      if (next_second == 0 || end - next_second > wheel.size())
+         next_second = end > wheel.size() ? end - wheel.size() : 0;
+      for (; next_second < end; ++next_second) {
+         auto& slot = wheel[next_second % wheel.size()];
+         auto later = slot.begin();
+         for (auto& key : slot) {
+            auto it = requests.find(key);
+            if (it == requests.end())
+               continue; // finalized already
+            if (it->second.expiration_time.sec_since_epoch() < end)
+               requests.erase(it);
+            else if (&*later++ != &key)
+               *(later - 1) = std::move(key);
+         }
+         slot.erase(later, slot.end());
+      }
+   }
+
+ private:
+   std::map<chain::public_key_type, login_request> requests;
+   std::vector<std::vector<chain::public_key_type>> wheel = std::vector<std::vector<chain::public_key_type>>(61);
+   uint32_t next_second = 0; ///< the first second whose slot has not been swept
+};
 
 class login_plugin_impl {
  public:
-   login_request_container requests{};
+   login_request_cache requests{};
    uint32_t max_login_requests = 1000000;
    uint32_t max_login_timeout = 60;
 
-   void expire_requests() {
-      auto& index = requests.get<login_request_time_index>();
-      auto now = fc::time_point::now();
-      for (auto it = index.begin(); it != index.end() && it->expiration_time < now; it = index.erase(it))
-         ;
+   // derives the shared secrets and recovers the keys of batches of login requests
+   fc::optional<boost::asio::thread_pool> crypto_pool;
+
+   void expire_requests() { requests.expire(fc::time_point_sec{fc::time_point::now()}); }
+
+   /// derives the digest signed by the client from the request and recovers the keys of the signatures
+   static void recover_keys(const login_request& request, const login_plugin::finalize_login_request_params& params,
+                            login_plugin::finalize_login_request_results& result) {
+      auto shared_secret = request.server_ephemeral_priv_key.generate_shared_secret(params.client_ephemeral_pub_key);
+
+      chain::bytes combined_data(1024 * 1024);
+      chain::datastream<char*> sig_data_ds{combined_data.data(), combined_data.size()};
+      fc::raw::pack(sig_data_ds, params.permission);
+      fc::raw::pack(sig_data_ds, shared_secret);
+      fc::raw::pack(sig_data_ds, params.data);
+      combined_data.resize(sig_data_ds.tellp());
+
+      result.digest = chain::sha256::hash(combined_data);
+      for (auto& sig : params.signatures)
+         result.recovered_keys.insert(chain::public_key_type{sig, result.digest});
+   }
+
+   static void check_permission(const login_plugin::finalize_login_request_params& params,
+                                login_plugin::finalize_login_request_results& result) {
+      try {
+         auto noop_checktime = [] {};
+         auto& chain = app().get_plugin<chain_plugin>().chain();
+         chain.get_authorization_manager().check_authorization( //
+             params.permission.actor, params.permission.permission, result.recovered_keys, {}, fc::microseconds(0),
+             noop_checktime, true);
+         result.permission_satisfied = true;
+      } catch (...) {
+         result.error = "keys do not satisfy permission";
+      }
+   }
+
+   /// recovers the keys of the batch on the pool, then checks the permissions back on the application thread
+   void finalize_login_requests(std::vector<login_plugin::finalize_login_request_params> params,
+                                url_response_callback cb) {
+      struct batch_state {
+         std::vector<login_plugin::finalize_login_request_params> params;
+         std::vector<fc::optional<login_request>> requests;
+         std::vector<login_plugin::finalize_login_request_results> results;
+         std::atomic<size_t> unrecovered{0};
+      };
+      auto batch = std::make_shared<batch_state>();
+      batch->params = std::move(params);
+      batch->requests.resize(batch->params.size());
+      batch->results.resize(batch->params.size());
+
+      expire_requests();
+      size_t found = 0;
+      for (size_t i = 0; i < batch->params.size(); ++i) {
+         batch->requests[i] = requests.take(batch->params[i].server_ephemeral_pub_key);
+         if (batch->requests[i])
+            ++found;
+         else
+            batch->results[i].error = "server_ephemeral_pub_key expired or not found";
+      }
+
+      // a request whose keys can't be recovered is not checked against its permission
+      auto recover = [batch](size_t i) {
+         try {
+            recover_keys(*batch->requests[i], batch->params[i], batch->results[i]);
+         } catch (const fc::exception& e) {
+            batch->requests[i].reset();
+            batch->results[i].error = e.to_string();
+         } catch (const std::exception& e) {
+            batch->requests[i].reset();
+            batch->results[i].error = e.what();
+         }
+      };
+
+      auto finish = [batch, cb]() {
+         try {
+            for (size_t i = 0; i < batch->params.size(); ++i) {
+               if (batch->requests[i])
+                  check_permission(batch->params[i], batch->results[i]);
+            }
+            cb(200, fc::json::to_string(batch->results));
+         } catch (...) {
+            http_plugin::handle_exception("login", "finalize_login_requests", "", cb);
+         }
+      };
+
+      if (!crypto_pool || found == 0) {
+         for (size_t i = 0; i < batch->params.size(); ++i) {
+            if (batch->requests[i])
+               recover(i);
+         }
+         finish();
+         return;
+      }
+
+      batch->unrecovered = found;
+      for (size_t i = 0; i < batch->params.size(); ++i) {
+         if (!batch->requests[i])
+            continue;
+         boost::asio::post(*crypto_pool, [batch, i, recover, finish]() {
+            recover(i);
+            if (--batch->unrecovered == 0)
+               chain::plugin_interface::app_post(chain::plugin_interface::priority::low, finish);
+         });
+      }
    }
 };
 
@@ -54,12 +201,18 @@ void login_plugin::set_program_options(options_description&, options_description
        ("max-login-requests", bpo::value<uint32_t>()->default_value(1000000),
         "The maximum number of pending login requests") //
        ("max-login-timeout", bpo::value<uint32_t>()->default_value(60),
-        "The maximum timeout for pending login requests (in seconds)");
+        "The maximum timeout for pending login requests (in seconds)") //
+       ("login-threads", bpo::value<uint16_t>()->default_value(0),
+        "Number of threads recovering the keys of /v1/login/finalize_login_requests batches; 0 to recover them on the application thread");
 }
 
 void login_plugin::plugin_initialize(const variables_map& options) {
    my->max_login_requests = options.at("max-login-requests").as<uint32_t>();
    my->max_login_timeout = options.at("max-login-timeout").as<uint32_t>();
+   my->requests.set_max_timeout(my->max_login_timeout);
+   auto login_threads = options.at("login-threads").as<uint16_t>();
+   if (login_threads > 0)
+      my->crypto_pool.emplace(login_threads);
 }
 
 #define CALL(call_name, http_response_code)                                                                            \
@@ -81,13 +234,29 @@ void login_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
        CALL(start_login_request, 200), //
        CALL(finalize_login_request, 200),
+       {std::string("/v1/login/finalize_login_requests"),
+        [this](string, string body, url_response_callback cb) mutable {
+           try {
+              if (body.empty())
+                 body = "[]";
+              my->finalize_login_requests(
+                  fc::json::from_string(body).as<std::vector<login_plugin::finalize_login_request_params>>(), cb);
+           } catch (...) {
+              http_plugin::handle_exception("login", "finalize_login_requests", body, cb);
+           }
+        }},
        // CALL(do_not_use_gen_r1_key, 200),  //
        // CALL(do_not_use_sign, 200),        //
        // CALL(do_not_use_get_secret, 200),  //
    });
 }
 
-void login_plugin::plugin_shutdown() {}
+void login_plugin::plugin_shutdown() {
+   if (my->crypto_pool) {
+      my->crypto_pool->stop();
+      my->crypto_pool->join();
+   }
+}
 
 login_plugin::start_login_request_results
 login_plugin::start_login_request(const login_plugin::start_login_request_params& params) {
@@ -109,39 +278,14 @@ login_plugin::finalize_login_request_results
 login_plugin::finalize_login_request(const login_plugin::finalize_login_request_params& params) {
    finalize_login_request_results result;
    my->expire_requests();
-   auto& index = my->requests.get<login_request_pub_key_index>();
-   auto it = index.find(params.server_ephemeral_pub_key);
-   if (it == index.end()) {
+   auto request = my->requests.take(params.server_ephemeral_pub_key);
+   if (!request) {
       result.error = "server_ephemeral_pub_key expired or not found";
       return result;
    }
-   auto request = *it;
-   index.erase(it);
-
-   auto shared_secret = request.server_ephemeral_priv_key.generate_shared_secret(params.client_ephemeral_pub_key);
-
-   chain::bytes combined_data(1024 * 1024);
-   chain::datastream<char*> sig_data_ds{combined_data.data(), combined_data.size()};
-   fc::raw::pack(sig_data_ds, params.permission);
-   fc::raw::pack(sig_data_ds, shared_secret);
-   fc::raw::pack(sig_data_ds, params.data);
-   combined_data.resize(sig_data_ds.tellp());
-
-   result.digest = chain::sha256::hash(combined_data);
-   for (auto& sig : params.signatures)
-      result.recovered_keys.insert(chain::public_key_type{sig, result.digest});
-
-   try {
-      auto noop_checktime = [] {};
-      auto& chain = app().get_plugin<chain_plugin>().chain();
-      chain.get_authorization_manager().check_authorization( //
-          params.permission.actor, params.permission.permission, result.recovered_keys, {}, fc::microseconds(0),
-          noop_checktime, true);
-      result.permission_satisfied = true;
-   } catch (...) {
-      result.error = "keys do not satisfy permission";
-   }
 
+   login_plugin_impl::recover_keys(*request, params, result);
+   login_plugin_impl::check_permission(params, result);
    return result;
 }
 
@@ -0,0 +1,36 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/http_plugin/http_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+/**
+ *  Serves the process wide metrics registry of eosio::chain in the Prometheus text format on
+ *  /v1/metrics/prometheus, for a Prometheus server to scrape.
+ */
+class metrics_api_plugin : public plugin<metrics_api_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((http_plugin))
+
+   metrics_api_plugin() = default;
+   metrics_api_plugin(const metrics_api_plugin&) = delete;
+   metrics_api_plugin(metrics_api_plugin&&) = delete;
+   metrics_api_plugin& operator=(const metrics_api_plugin&) = delete;
+   metrics_api_plugin& operator=(metrics_api_plugin&&) = delete;
+   virtual ~metrics_api_plugin() override = default;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
+   void plugin_initialize(const variables_map& vm) {}
+   void plugin_startup();
+   void plugin_shutdown() {}
+};
+
+}
@@ -0,0 +1,28 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/metrics_api_plugin/metrics_api_plugin.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_registry.hpp>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _metrics_api_plugin = app().register_plugin<metrics_api_plugin>();
+
+void metrics_api_plugin::plugin_startup() {
+   // the body is the text exposition format, not json, which Prometheus reads whatever the content type says
+   app().get_plugin<http_plugin>().add_api({
+      {std::string("/v1/metrics/prometheus"),
+       [](string, string body, url_response_callback cb) {
+          try {
+             chain::thread_registry::instance().update_metrics();
+             cb(200, chain::metrics_registry::instance().to_prometheus());
+          } catch (...) {
+             http_plugin::handle_exception("metrics", "prometheus", body, cb);
+          }
+       }}
+   });
+}
+
+}
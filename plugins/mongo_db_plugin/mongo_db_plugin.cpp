@@ -6,6 +6,8 @@
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_registry.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
 
@@ -20,8 +22,14 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
 #include <queue>
 
+#include <bsoncxx/builder/basic/array.hpp>
 #include <bsoncxx/builder/basic/kvp.hpp>
 #include <bsoncxx/builder/basic/document.hpp>
 #include <bsoncxx/exception/exception.hpp>
@@ -76,7 +84,11 @@ public:
    fc::optional<boost::signals2::scoped_connection> accepted_transaction_connection;
    fc::optional<boost::signals2::scoped_connection> applied_transaction_connection;
 
-   void consume_blocks();
+   struct writer_lane;
+   void run_lane( writer_lane& lane, const std::function<void(mongocxx::database&)>& open,
+                  const std::function<void()>& flush );
+   void start_lanes();
+   void stop_lanes();
 
    void accepted_block( const chain::block_state_ptr& );
    void applied_irreversible_block(const chain::block_state_ptr&);
@@ -90,17 +102,24 @@ public:
    void _process_accepted_block( const chain::block_state_ptr& );
    void process_irreversible_block(const chain::block_state_ptr&);
    void _process_irreversible_block(const chain::block_state_ptr&);
+   void process_irreversible_transactions(const chain::block_state_ptr&);
+   void _process_irreversible_transactions(const chain::block_state_ptr&);
+   void process_irreversible_accounts(const chain::block_state_ptr&);
+   void _process_irreversible_accounts(const chain::block_state_ptr&);
 
-   optional<abi_serializer> get_abi_serializer( account_name n );
+   std::shared_ptr<const abi_serializer> get_abi_serializer( account_name n );
    template<typename T> fc::variant to_variant_with_abi( const T& obj );
 
    void purge_abi_cache();
 
-   bool add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
-                          const chain::transaction_trace_ptr& t,
+   bool add_action_trace( const chain::action_trace& atrace, const chain::transaction_trace_ptr& t,
                           bool executed, const std::chrono::milliseconds& now );
+   void append_bulk( mongocxx::collection& collection, std::unique_ptr<mongocxx::bulk_write>& bulk, size_t& ops,
+                     const mongocxx::model::write& op );
+   void flush_trace_bulks();
 
    void update_account(const chain::action& act);
+   void update_accounts(const vector<chain::action>& actions);
 
    void add_pub_keys( const vector<chain::key_weight>& keys, const account_name& name,
                       const permission_name& permission, const std::chrono::milliseconds& now );
@@ -118,7 +137,7 @@ public:
    void init();
    void wipe_database();
 
-   template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e);
+   void queue( writer_lane& lane, std::function<void()> work );
 
    bool configured{false};
    bool wipe_database_on_startup{false};
@@ -135,6 +154,7 @@ public:
    bool store_transactions = true;
    bool store_transaction_traces = true;
    bool store_action_traces = true;
+   bool irreversible_accounts = false;
 
    std::string db_name;
    mongocxx::instance mongo_inst;
@@ -151,19 +171,47 @@ public:
    mongocxx::collection _account_controls;
 
    size_t max_queue_size = 0;
-   int queue_sleep_time = 0;
+   size_t bulk_size = 0;
    size_t abi_cache_size = 0;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_process_queue;
-   std::deque<chain::block_state_ptr> block_state_queue;
-   std::deque<chain::block_state_ptr> block_state_process_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_process_queue;
-   boost::mutex mtx;
-   boost::condition_variable condition;
-   boost::thread consume_thread;
+
+   /**
+    *  A writer thread with its own connection from mongo_pool, writing to collections no other lane writes to.
+    *  The chain thread only waits on a lane whose queue holds more than max_queue_size entries, and then just
+    *  until the writer has taken the queue over, not until it has been written.
+    */
+   struct writer_lane {
+      std::string                       name;
+      std::deque<std::function<void()>> queue;
+      boost::mutex                      mtx;
+      boost::condition_variable         work_cv;
+      boost::condition_variable         space_cv;
+      boost::thread                     thread;
+      chain::metric_gauge*              depth = nullptr; ///< queue size in the metrics registry, set under mtx
+   };
+   writer_lane traces_lane;       ///< accounts, pub_keys, account_controls, action_traces, transaction_traces
+   writer_lane transactions_lane; ///< transactions
+   writer_lane blocks_lane;       ///< blocks, block_states
+
+   /**
+    *  With irreversible_accounts, the account actions of executed transactions wait here, by transaction id with the
+    *  actions of their latest trace, until the block that includes them becomes irreversible. Traces lane only.
+    */
+   struct pending_account_update {
+      uint32_t               block_num = 0;
+      vector<chain::action>  actions;
+   };
+   std::map<transaction_id_type, pending_account_update> pending_account_actions;
+
+   // unordered batches of the traces lane, executed every bulk_size operations and whenever its queue is drained
+   std::unique_ptr<mongocxx::bulk_write> action_traces_bulk;
+   size_t action_traces_bulk_ops = 0;
+   std::unique_ptr<mongocxx::bulk_write> trans_traces_bulk;
+   size_t trans_traces_bulk_ops = 0;
+
+   boost::mutex abi_cache_mtx; ///< guards abi_cache_index and _abi_accounts, every lane serializes with abis
+   mongocxx::pool::entry abi_client;
+   mongocxx::collection _abi_accounts;
+
    std::atomic_bool done{false};
    std::atomic_bool startup{true};
    fc::optional<chain::chain_id_type> chain_id;
@@ -175,7 +223,7 @@ public:
    struct abi_cache {
       account_name                     account;
       fc::time_point                   last_accessed;
-      fc::optional<abi_serializer>     serializer;
+      std::shared_ptr<const abi_serializer> serializer;
    };
 
    typedef boost::multi_index_container<abi_cache,
@@ -287,31 +335,22 @@ bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
 }
 
 
-template<typename Queue, typename Entry>
-void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e ) {
-   boost::mutex::scoped_lock lock( mtx );
-   auto queue_size = queue.size();
-   if( queue_size > max_queue_size ) {
-      lock.unlock();
-      condition.notify_one();
-      queue_sleep_time += 10;
-      if( queue_sleep_time > 1000 )
-         wlog("queue size: ${q}", ("q", queue_size));
-      boost::this_thread::sleep_for( boost::chrono::milliseconds( queue_sleep_time ));
-      lock.lock();
-   } else {
-      queue_sleep_time -= 10;
-      if( queue_sleep_time < 0 ) queue_sleep_time = 0;
+void mongo_db_plugin_impl::queue( writer_lane& lane, std::function<void()> work ) {
+   boost::mutex::scoped_lock lock( lane.mtx );
+   if( lane.queue.size() > max_queue_size ) {
+      wlog( "${l} queue size: ${q}, waiting for its writer", ("l", lane.name)("q", lane.queue.size()) );
+      lane.space_cv.wait( lock, [&]() { return lane.queue.size() <= max_queue_size || done; } );
    }
-   queue.emplace_back( e );
+   lane.queue.emplace_back( std::move( work ) );
+   if( lane.depth ) lane.depth->set( lane.queue.size() );
    lock.unlock();
-   condition.notify_one();
+   lane.work_cv.notify_one();
 }
 
 void mongo_db_plugin_impl::accepted_transaction( const chain::transaction_metadata_ptr& t ) {
    try {
       if( store_transactions ) {
-         queue( transaction_metadata_queue, t );
+         queue( transactions_lane, [this, t]() { process_accepted_transaction( t ); } );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_transaction ${e}", ("e", e.to_string()));
@@ -347,7 +386,7 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
       if( !is_producer && !t->producer_block_id.valid() )
          return;
       // always queue since account information always gathered
-      queue( transaction_trace_queue, t );
+      queue( traces_lane, [this, t]() { process_applied_transaction( t ); } );
    } catch (fc::exception& e) {
       elog("FC Exception while applied_transaction ${e}", ("e", e.to_string()));
    } catch (std::exception& e) {
@@ -359,8 +398,16 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
 
 void mongo_db_plugin_impl::applied_irreversible_block( const chain::block_state_ptr& bs ) {
    try {
-      if( store_blocks || store_block_states || store_transactions ) {
-         queue( irreversible_block_state_queue, bs );
+      if( store_blocks || store_block_states ) {
+         queue( blocks_lane, [this, bs]() { process_irreversible_block( bs ); } );
+      }
+      if( store_transactions ) {
+         // with the transactions lane, so it follows the inserts of the transactions it marks
+         queue( transactions_lane, [this, bs]() { process_irreversible_transactions( bs ); } );
+      }
+      if( irreversible_accounts ) {
+         // with the traces lane, after the traces of the block
+         queue( traces_lane, [this, bs]() { process_irreversible_accounts( bs ); } );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
@@ -379,7 +426,7 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
          }
       }
       if( store_blocks || store_block_states ) {
-         queue( block_state_queue, bs );
+         queue( blocks_lane, [this, bs]() { process_accepted_block( bs ); } );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_block ${e}", ("e", e.to_string()));
@@ -390,124 +437,98 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
    }
 }
 
-void mongo_db_plugin_impl::consume_blocks() {
+void mongo_db_plugin_impl::run_lane( writer_lane& lane, const std::function<void(mongocxx::database&)>& open,
+                                     const std::function<void()>& flush ) {
+   chain::thread_registry::instance().register_current_thread( "mongo-db-" + lane.name );
    try {
       auto mongo_client = mongo_pool->acquire();
-      auto& mongo_conn = *mongo_client;
-
-      _accounts = mongo_conn[db_name][accounts_col];
-      _trans = mongo_conn[db_name][trans_col];
-      _trans_traces = mongo_conn[db_name][trans_traces_col];
-      _action_traces = mongo_conn[db_name][action_traces_col];
-      _blocks = mongo_conn[db_name][blocks_col];
-      _block_states = mongo_conn[db_name][block_states_col];
-      _pub_keys = mongo_conn[db_name][pub_keys_col];
-      _account_controls = mongo_conn[db_name][account_controls_col];
+      auto mongo_db = (*mongo_client)[db_name];
+      open( mongo_db );
 
       while (true) {
-         boost::mutex::scoped_lock lock(mtx);
-         while ( transaction_metadata_queue.empty() &&
-                 transaction_trace_queue.empty() &&
-                 block_state_queue.empty() &&
-                 irreversible_block_state_queue.empty() &&
-                 !done ) {
-            condition.wait(lock);
-         }
+         boost::mutex::scoped_lock lock( lane.mtx );
+         lane.work_cv.wait( lock, [&]() { return !lane.queue.empty() || done; } );
 
          // capture for processing
-         size_t transaction_metadata_size = transaction_metadata_queue.size();
-         if (transaction_metadata_size > 0) {
-            transaction_metadata_process_queue = move(transaction_metadata_queue);
-            transaction_metadata_queue.clear();
-         }
-         size_t transaction_trace_size = transaction_trace_queue.size();
-         if (transaction_trace_size > 0) {
-            transaction_trace_process_queue = move(transaction_trace_queue);
-            transaction_trace_queue.clear();
-         }
-         size_t block_state_size = block_state_queue.size();
-         if (block_state_size > 0) {
-            block_state_process_queue = move(block_state_queue);
-            block_state_queue.clear();
-         }
-         size_t irreversible_block_size = irreversible_block_state_queue.size();
-         if (irreversible_block_size > 0) {
-            irreversible_block_state_process_queue = move(irreversible_block_state_queue);
-            irreversible_block_state_queue.clear();
-         }
-
+         auto work = std::move( lane.queue );
+         lane.queue.clear();
+         if( lane.depth ) lane.depth->set( 0 );
          lock.unlock();
+         lane.space_cv.notify_all();
 
-         if (done) {
-            ilog("draining queue, size: ${q}", ("q", transaction_metadata_size + transaction_trace_size + block_state_size + irreversible_block_size));
+         if( done ) {
+            ilog( "draining ${l} queue, size: ${q}", ("l", lane.name)("q", work.size()) );
          }
 
-         // process transactions
          auto start_time = fc::time_point::now();
-         auto size = transaction_trace_process_queue.size();
-         while (!transaction_trace_process_queue.empty()) {
-            const auto& t = transaction_trace_process_queue.front();
-            process_applied_transaction(t);
-            transaction_trace_process_queue.pop_front();
+         auto size = work.size();
+         for( const auto& w : work ) {
+            w();
          }
+         if( flush ) flush();
          auto time = fc::time_point::now() - start_time;
          auto per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_applied_transaction,  time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
-
-         start_time = fc::time_point::now();
-         size = transaction_metadata_process_queue.size();
-         while (!transaction_metadata_process_queue.empty()) {
-            const auto& t = transaction_metadata_process_queue.front();
-            process_accepted_transaction(t);
-            transaction_metadata_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_accepted_transaction, time per: ${p}, size: ${s}, time: ${t}", ("s", size)( "t", time )( "p", per ));
-
-         // process blocks
-         start_time = fc::time_point::now();
-         size = block_state_process_queue.size();
-         while (!block_state_process_queue.empty()) {
-            const auto& bs = block_state_process_queue.front();
-            process_accepted_block( bs );
-            block_state_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_accepted_block,       time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
-
-         // process irreversible blocks
-         start_time = fc::time_point::now();
-         size = irreversible_block_state_process_queue.size();
-         while (!irreversible_block_state_process_queue.empty()) {
-            const auto& bs = irreversible_block_state_process_queue.front();
-            process_irreversible_block(bs);
-            irreversible_block_state_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_irreversible_block,   time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
+            ilog( "${l} writer, time per: ${p}, size: ${s}, time: ${t}", ("l", lane.name)("s", size)("t", time)("p", per) );
 
-         if( transaction_metadata_size == 0 &&
-             transaction_trace_size == 0 &&
-             block_state_size == 0 &&
-             irreversible_block_size == 0 &&
-             done ) {
+         if( size == 0 && done ) {
             break;
          }
       }
-      ilog("mongo_db_plugin consume thread shutdown gracefully");
+      ilog( "mongo_db_plugin ${l} writer shutdown gracefully", ("l", lane.name) );
    } catch (fc::exception& e) {
-      elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
+      elog("FC Exception while writing ${l} ${e}", ("l", lane.name)("e", e.to_string()));
    } catch (std::exception& e) {
-      elog("STD Exception while consuming block ${e}", ("e", e.what()));
+      elog("STD Exception while writing ${l} ${e}", ("l", lane.name)("e", e.what()));
    } catch (...) {
-      elog("Unknown exception while consuming block");
+      elog("Unknown exception while writing ${l}", ("l", lane.name));
+   }
+}
+
+void mongo_db_plugin_impl::start_lanes() {
+   traces_lane.name = "traces";
+   traces_lane.thread = boost::thread( [this] {
+      run_lane( traces_lane, [this]( mongocxx::database& mongo_db ) {
+         _accounts = mongo_db[accounts_col];
+         _pub_keys = mongo_db[pub_keys_col];
+         _account_controls = mongo_db[account_controls_col];
+         _trans_traces = mongo_db[trans_traces_col];
+         _action_traces = mongo_db[action_traces_col];
+      }, [this] { flush_trace_bulks(); } );
+   } );
+   transactions_lane.name = "transactions";
+   transactions_lane.thread = boost::thread( [this] {
+      run_lane( transactions_lane, [this]( mongocxx::database& mongo_db ) {
+         _trans = mongo_db[trans_col];
+      }, std::function<void()>() );
+   } );
+   blocks_lane.name = "blocks";
+   blocks_lane.thread = boost::thread( [this] {
+      run_lane( blocks_lane, [this]( mongocxx::database& mongo_db ) {
+         _blocks = mongo_db[blocks_col];
+         _block_states = mongo_db[block_states_col];
+      }, std::function<void()>() );
+   } );
+   for( auto* lane : { &traces_lane, &transactions_lane, &blocks_lane } ) {
+      auto& depth = chain::metrics_registry::instance().gauge( "eosio_mongo_db_queue_depth",
+                                                               "work waiting for a writer thread of mongo_db_plugin",
+                                                               {{"lane", lane->name}} );
+      boost::mutex::scoped_lock lock( lane->mtx );
+      depth.set( lane->queue.size() );
+      lane->depth = &depth;
+   }
+}
+
+void mongo_db_plugin_impl::stop_lanes() {
+   done = true;
+   for( auto* lane : { &traces_lane, &transactions_lane, &blocks_lane } ) {
+      {
+         boost::mutex::scoped_lock lock( lane->mtx );
+         lane->work_cv.notify_one();
+         lane->space_cv.notify_all();
+      }
+      if( lane->thread.joinable() )
+         lane->thread.join();
    }
 }
 
@@ -528,6 +549,91 @@ auto find_block( mongocxx::collection& blocks, const string& id ) {
    return blocks.find_one( make_document( kvp( "block_id", id )), options);
 }
 
+/**
+ *  Builds BSON straight from a variant, the same BSON that bsoncxx::from_json( fc::json::to_string( v ) ) parsed:
+ *  integers above 0xffffffff, doubles and blobs as strings, other integers as int32 when they fit and int64
+ *  otherwise. Strings that are not valid utf8 are pruned and purged is set.
+ */
+template<typename Append>
+void append_bson_value( const fc::variant& v, bool& purged, Append&& append ) {
+   using namespace bsoncxx::types;
+   using bsoncxx::builder::basic::sub_array;
+   using bsoncxx::builder::basic::sub_document;
+
+   auto append_integer = [&]( int64_t i ) {
+      if( i >= std::numeric_limits<int32_t>::min() && i <= std::numeric_limits<int32_t>::max() )
+         append( b_int32{static_cast<int32_t>(i)} );
+      else
+         append( b_int64{i} );
+   };
+
+   switch( v.get_type() ) {
+      case fc::variant::null_type:
+         append( b_null{} );
+         break;
+      case fc::variant::int64_type:
+         if( v.as_int64() > 0xffffffff )
+            append( v.as_string() );
+         else
+            append_integer( v.as_int64() );
+         break;
+      case fc::variant::uint64_type:
+         if( v.as_uint64() > 0xffffffff )
+            append( v.as_string() );
+         else
+            append_integer( static_cast<int64_t>(v.as_uint64()) );
+         break;
+      case fc::variant::bool_type:
+         append( b_bool{v.as_bool()} );
+         break;
+      case fc::variant::string_type: {
+         const auto& s = v.get_string();
+         if( fc::is_utf8( s ) ) {
+            append( s );
+         } else {
+            purged = true;
+            append( fc::prune_invalid_utf8( s ) );
+         }
+         break;
+      }
+      case fc::variant::array_type:
+         append( [&]( sub_array a ) {
+            for( const auto& e : v.get_array() )
+               append_bson_value( e, purged, [&]( auto&& value ) { a.append( std::forward<decltype(value)>( value ) ); } );
+         } );
+         break;
+      case fc::variant::object_type:
+         append( [&]( sub_document d ) {
+            for( const auto& e : v.get_object() )
+               append_bson_value( e.value(), purged, [&]( auto&& value ) {
+                  d.append( bsoncxx::builder::basic::kvp( e.key(), std::forward<decltype(value)>( value ) ) );
+               } );
+         } );
+         break;
+      default: // double and blob
+         append( v.as_string() );
+   }
+}
+
+/// appends the fields of the object v to doc, flagging the document when strings in it had to be pruned
+void append_bson_fields( bsoncxx::builder::basic::document& doc, const fc::variant& v ) {
+   using bsoncxx::builder::basic::kvp;
+   bool purged = false;
+   for( const auto& e : v.get_object() )
+      append_bson_value( e.value(), purged, [&]( auto&& value ) { doc.append( kvp( e.key(), std::forward<decltype(value)>( value ) ) ); } );
+   if( purged )
+      doc.append( kvp( "non-utf8-purged", bsoncxx::types::b_bool{true} ) );
+}
+
+/// appends v under key to doc, flagging the document when strings in it had to be pruned
+void append_bson_field( bsoncxx::builder::basic::document& doc, const std::string& key, const fc::variant& v ) {
+   using bsoncxx::builder::basic::kvp;
+   bool purged = false;
+   append_bson_value( v, purged, [&]( auto&& value ) { doc.append( kvp( key, std::forward<decltype(value)>( value ) ) ); } );
+   if( purged )
+      doc.append( kvp( "non-utf8-purged", bsoncxx::types::b_bool{true} ) );
+}
+
 void handle_mongo_exception( const std::string& desc, int line_num ) {
    bool shutdown = true;
    try {
@@ -582,11 +688,12 @@ void mongo_db_plugin_impl::purge_abi_cache() {
    }
 }
 
-optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name n ) {
+std::shared_ptr<const abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name n ) {
    using bsoncxx::builder::basic::kvp;
    using bsoncxx::builder::basic::make_document;
    if( n.good()) {
       try {
+         boost::mutex::scoped_lock lock( abi_cache_mtx );
 
          auto itr = abi_cache_index.find( n );
          if( itr != abi_cache_index.end() ) {
@@ -597,7 +704,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
             return itr->serializer;
          }
 
-         auto account = _accounts.find_one( make_document( kvp("name", n.to_string())) );
+         auto account = _abi_accounts.find_one( make_document( kvp("name", n.to_string())) );
          if(account) {
             auto view = account->view();
             abi_def abi;
@@ -606,7 +713,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                   abi = fc::json::from_string( bsoncxx::to_json( view["abi"].get_document())).as<abi_def>();
                } catch (...) {
                   ilog( "Unable to convert account abi to abi_def for ${n}", ( "n", n ));
-                  return optional<abi_serializer>();
+                  return nullptr;
                }
 
                purge_abi_cache(); // make room if necessary
@@ -643,14 +750,14 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
                   }
                }
                abis.set_abi( abi, abi_serializer_max_time );
-               entry.serializer.emplace( std::move( abis ) );
+               entry.serializer = std::make_shared<const abi_serializer>( std::move( abis ) );
                abi_cache_index.insert( entry );
                return entry.serializer;
             }
          }
       } FC_CAPTURE_AND_LOG((n))
    }
-   return optional<abi_serializer>();
+   return nullptr;
 }
 
 template<typename T>
@@ -703,6 +810,33 @@ void mongo_db_plugin_impl::process_irreversible_block(const chain::block_state_p
   }
 }
 
+void mongo_db_plugin_impl::process_irreversible_transactions(const chain::block_state_ptr& bs) {
+  try {
+     if( start_block_reached ) {
+        _process_irreversible_transactions( bs );
+     }
+  } catch (fc::exception& e) {
+     elog("FC Exception while processing irreversible transactions: ${e}", ("e", e.to_detail_string()));
+  } catch (std::exception& e) {
+     elog("STD Exception while processing irreversible transactions: ${e}", ("e", e.what()));
+  } catch (...) {
+     elog("Unknown exception while processing irreversible transactions");
+  }
+}
+
+void mongo_db_plugin_impl::process_irreversible_accounts(const chain::block_state_ptr& bs) {
+  try {
+     // like update_account, whether or not the start block was reached
+     _process_irreversible_accounts( bs );
+  } catch (fc::exception& e) {
+     elog("FC Exception while processing irreversible accounts: ${e}", ("e", e.to_detail_string()));
+  } catch (std::exception& e) {
+     elog("STD Exception while processing irreversible accounts: ${e}", ("e", e.what()));
+  } catch (...) {
+     elog("Unknown exception while processing irreversible accounts");
+  }
+}
+
 void mongo_db_plugin_impl::process_accepted_block( const chain::block_state_ptr& bs ) {
    try {
       if( start_block_reached ) {
@@ -724,7 +858,7 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
    using bsoncxx::builder::basic::make_array;
    namespace bbb = bsoncxx::builder::basic;
 
-   const auto& trx = t->trx;
+   const auto trx = t->get_signed_transaction();
 
    if( !filter_include( trx ) ) return;
    
@@ -738,43 +872,16 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 
    trans_doc.append( kvp( "trx_id", trx_id_str ) );
 
-   auto v = to_variant_with_abi( trx );
-   string trx_json = fc::json::to_string( v );
+   append_bson_fields( trans_doc, to_variant_with_abi( trx ) );
 
-   try {
-      const auto& trx_value = bsoncxx::from_json( trx_json );
-      trans_doc.append( bsoncxx::builder::concatenate_doc{trx_value.view()} );
-   } catch( bsoncxx::exception& ) {
-      try {
-         trx_json = fc::prune_invalid_utf8( trx_json );
-         const auto& trx_value = bsoncxx::from_json( trx_json );
-         trans_doc.append( bsoncxx::builder::concatenate_doc{trx_value.view()} );
-         trans_doc.append( kvp( "non-utf8-purged", b_bool{true} ) );
-      } catch( bsoncxx::exception& e ) {
-         elog( "Unable to convert transaction JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-         elog( "  JSON: ${j}", ("j", trx_json) );
-      }
-   }
-
-   string signing_keys_json;
-   if( t->signing_keys.valid() ) {
-      signing_keys_json = fc::json::to_string( t->signing_keys->second );
-   } else {
-      auto signing_keys = trx.get_signature_keys( *chain_id, false, false );
-      if( !signing_keys.empty() ) {
-         signing_keys_json = fc::json::to_string( signing_keys );
-      }
-   }
-
-   if( !signing_keys_json.empty() ) {
-      try {
-         const auto& keys_value = bsoncxx::from_json( signing_keys_json );
-         trans_doc.append( kvp( "signing_keys", keys_value ) );
-      } catch( bsoncxx::exception& e ) {
-         // should never fail, so don't attempt to remove invalid utf8
-         elog( "Unable to convert signing keys JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-         elog( "  JSON: ${j}", ("j", signing_keys_json) );
-      }
+   auto signing_keys = t->signing_keys.valid() ? t->signing_keys->second : trx.get_signature_keys( *chain_id, false, false );
+   if( !signing_keys.empty() ) {
+      // kept the way from_json stored the JSON array: a document keyed by index
+      trans_doc.append( kvp( "signing_keys", [&]( bsoncxx::builder::basic::sub_document keys ) {
+         uint32_t i = 0;
+         for( const auto& k : signing_keys )
+            keys.append( kvp( std::to_string( i++ ), string( k ) ) );
+      } ) );
    }
 
    trans_doc.append( kvp( "accepted", b_bool{t->accepted} ) );
@@ -797,15 +904,22 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 }
 
 bool
-mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
-                                        const chain::transaction_trace_ptr& t,
+mongo_db_plugin_impl::add_action_trace( const chain::action_trace& atrace, const chain::transaction_trace_ptr& t,
                                         bool executed, const std::chrono::milliseconds& now )
 {
    using namespace bsoncxx::types;
    using bsoncxx::builder::basic::kvp;
 
    if( executed && atrace.receipt.receiver == chain::config::system_account_name ) {
-      update_account( atrace.act );
+      if( !irreversible_accounts ) {
+         update_account( atrace.act );
+      } else if( atrace.act.account == chain::config::system_account_name &&
+                 (atrace.act.name == newaccount || atrace.act.name == updateauth ||
+                  atrace.act.name == deleteauth || atrace.act.name == setabi) ) {
+         auto& pending = pending_account_actions[t->id];
+         pending.block_num = t->block_num;
+         pending.actions.emplace_back( atrace.act );
+      }
    }
 
    bool added = false;
@@ -814,34 +928,19 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
       auto action_traces_doc = bsoncxx::builder::basic::document{};
       const chain::base_action_trace& base = atrace; // without inline action traces
 
-      auto v = to_variant_with_abi( base );
-      string json = fc::json::to_string( v );
-      try {
-         const auto& value = bsoncxx::from_json( json );
-         action_traces_doc.append( bsoncxx::builder::concatenate_doc{value.view()} );
-      } catch( bsoncxx::exception& ) {
-         try {
-            json = fc::prune_invalid_utf8( json );
-            const auto& value = bsoncxx::from_json( json );
-            action_traces_doc.append( bsoncxx::builder::concatenate_doc{value.view()} );
-            action_traces_doc.append( kvp( "non-utf8-purged", b_bool{true} ) );
-         } catch( bsoncxx::exception& e ) {
-            elog( "Unable to convert action trace JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-            elog( "  JSON: ${j}", ("j", json) );
-         }
-      }
+      append_bson_fields( action_traces_doc, to_variant_with_abi( base ) );
       if( t->receipt.valid() ) {
          action_traces_doc.append( kvp( "trx_status", std::string( t->receipt->status ) ) );
       }
       action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
 
       mongocxx::model::insert_one insert_op{action_traces_doc.view()};
-      bulk_action_traces.append( insert_op );
+      append_bulk( _action_traces, action_traces_bulk, action_traces_bulk_ops, insert_op );
       added = true;
    }
 
    for( const auto& iline_atrace : atrace.inline_traces ) {
-      added |= add_action_trace( bulk_action_traces, iline_atrace, t, executed, now );
+      added |= add_action_trace( iline_atrace, t, executed, now );
    }
 
    return added;
@@ -857,15 +956,15 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-   mongocxx::options::bulk_write bulk_opts;
-   bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_action_traces = _action_traces.create_bulk_write(bulk_opts);
    bool write_atraces = false;
    bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
+   if( irreversible_accounts ) {
+      pending_account_actions.erase( t->id ); // only the latest execution counts
+   }
 
    for( const auto& atrace : t->action_traces ) {
       try {
-         write_atraces |= add_action_trace( bulk_action_traces, atrace, t, executed, now );
+         write_atraces |= add_action_trace( atrace, t, executed, now );
       } catch(...) {
          handle_mongo_exception("add action traces", __LINE__);
       }
@@ -878,46 +977,54 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
 
    if( store_transaction_traces ) {
       try {
-         auto v = to_variant_with_abi( *t );
-         string json = fc::json::to_string( v );
-         try {
-            const auto& value = bsoncxx::from_json( json );
-            trans_traces_doc.append( bsoncxx::builder::concatenate_doc{value.view()} );
-         } catch( bsoncxx::exception& ) {
-            try {
-               json = fc::prune_invalid_utf8( json );
-               const auto& value = bsoncxx::from_json( json );
-               trans_traces_doc.append( bsoncxx::builder::concatenate_doc{value.view()} );
-               trans_traces_doc.append( kvp( "non-utf8-purged", b_bool{true} ) );
-            } catch( bsoncxx::exception& e ) {
-               elog( "Unable to convert transaction JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-               elog( "  JSON: ${j}", ("j", json) );
-            }
-         }
+         append_bson_fields( trans_traces_doc, to_variant_with_abi( *t ) );
          trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
 
-         try {
-            if( !_trans_traces.insert_one( trans_traces_doc.view() ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", t->id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "trans_traces insert: " + json, __LINE__ );
-         }
+         mongocxx::model::insert_one insert_op{trans_traces_doc.view()};
+         append_bulk( _trans_traces, trans_traces_bulk, trans_traces_bulk_ops, insert_op );
       } catch( ... ) {
          handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
    }
 
-   // insert action_traces
-   try {
-      if( !bulk_action_traces.execute() ) {
-         EOS_ASSERT( false, chain::mongo_db_insert_fail,
-                     "Bulk action traces insert failed for transaction trace: ${id}", ("id", t->id) );
-      }
-   } catch( ... ) {
-      handle_mongo_exception( "action traces insert", __LINE__ );
+   if( action_traces_bulk_ops >= bulk_size || trans_traces_bulk_ops >= bulk_size )
+      flush_trace_bulks();
+}
+
+void mongo_db_plugin_impl::append_bulk( mongocxx::collection& collection, std::unique_ptr<mongocxx::bulk_write>& bulk,
+                                        size_t& ops, const mongocxx::model::write& op ) {
+   if( !bulk ) {
+      mongocxx::options::bulk_write bulk_opts;
+      bulk_opts.ordered( false );
+      bulk.reset( new mongocxx::bulk_write( collection.create_bulk_write( bulk_opts ) ) );
    }
+   bulk->append( op );
+   ++ops;
+}
 
+void mongo_db_plugin_impl::flush_trace_bulks() {
+   if( trans_traces_bulk_ops > 0 ) {
+      try {
+         if( !trans_traces_bulk->execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk transaction traces insert failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "trans_traces insert", __LINE__ );
+      }
+   }
+   if( action_traces_bulk_ops > 0 ) {
+      try {
+         if( !action_traces_bulk->execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk action traces insert failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "action traces insert", __LINE__ );
+      }
+   }
+   trans_traces_bulk.reset();
+   trans_traces_bulk_ops = 0;
+   action_traces_bulk.reset();
+   action_traces_bulk_ops = 0;
 }
 
 void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr& bs ) {
@@ -946,21 +1053,9 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
 
       const chain::block_header_state& bhs = *bs;
 
-      auto json = fc::json::to_string( bhs );
-      try {
-         const auto& value = bsoncxx::from_json( json );
-         block_state_doc.append( kvp( "block_header_state", value ) );
-      } catch( bsoncxx::exception& ) {
-         try {
-            json = fc::prune_invalid_utf8( json );
-            const auto& value = bsoncxx::from_json( json );
-            block_state_doc.append( kvp( "block_header_state", value ) );
-            block_state_doc.append( kvp( "non-utf8-purged", b_bool{true} ) );
-         } catch( bsoncxx::exception& e ) {
-            elog( "Unable to convert block_header_state JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-            elog( "  JSON: ${j}", ("j", json) );
-         }
-      }
+      fc::variant bhs_var;
+      fc::to_variant( bhs, bhs_var );
+      append_bson_field( block_state_doc, "block_header_state", bhs_var );
       block_state_doc.append( kvp( "createdAt", b_date{now} ) );
 
       try {
@@ -976,7 +1071,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
             }
          }
       } catch( ... ) {
-         handle_mongo_exception( "block_states insert: " + json, __LINE__ );
+         handle_mongo_exception( "block_states insert: " + block_id_str, __LINE__ );
       }
    }
 
@@ -985,22 +1080,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
       block_doc.append( kvp( "block_num", b_int32{static_cast<int32_t>(block_num)} ),
                         kvp( "block_id", block_id_str ) );
 
-      auto v = to_variant_with_abi( *bs->block );
-      auto json = fc::json::to_string( v );
-      try {
-         const auto& value = bsoncxx::from_json( json );
-         block_doc.append( kvp( "block", value ) );
-      } catch( bsoncxx::exception& ) {
-         try {
-            json = fc::prune_invalid_utf8( json );
-            const auto& value = bsoncxx::from_json( json );
-            block_doc.append( kvp( "block", value ) );
-            block_doc.append( kvp( "non-utf8-purged", b_bool{true} ) );
-         } catch( bsoncxx::exception& e ) {
-            elog( "Unable to convert block JSON to MongoDB JSON: ${e}", ("e", e.what()) );
-            elog( "  JSON: ${j}", ("j", json) );
-         }
-      }
+      append_bson_field( block_doc, "block", to_variant_with_abi( *bs->block ) );
       block_doc.append( kvp( "createdAt", b_date{now} ) );
 
       try {
@@ -1016,7 +1096,7 @@ void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr
             }
          }
       } catch( ... ) {
-         handle_mongo_exception( "blocks insert: " + json, __LINE__ );
+         handle_mongo_exception( "blocks insert: " + block_id_str, __LINE__ );
       }
    }
 }
@@ -1064,6 +1144,19 @@ void mongo_db_plugin_impl::_process_irreversible_block(const chain::block_state_
 
       _block_states.update_one( make_document( kvp( "_id", ir_block->view()["_id"].get_oid() ) ), update_doc.view() );
    }
+}
+
+void mongo_db_plugin_impl::_process_irreversible_transactions(const chain::block_state_ptr& bs)
+{
+   using namespace bsoncxx::types;
+   using bsoncxx::builder::basic::make_document;
+   using bsoncxx::builder::basic::kvp;
+
+   const auto block_id = bs->block->id();
+   const auto block_id_str = block_id.str();
+
+   auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
    if( store_transactions ) {
       const auto block_num = bs->block->block_num();
@@ -1288,6 +1381,8 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
                std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()} );
          auto setabi = act.data_as<chain::setabi>();
 
+         // held until the abi is updated, so that no other lane caches the old one again meanwhile
+         boost::mutex::scoped_lock lock( abi_cache_mtx );
          abi_cache_index.erase( setabi.account );
 
          auto account = find_account( _accounts, setabi.account );
@@ -1323,6 +1418,167 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
    }
 }
 
+void mongo_db_plugin_impl::_process_irreversible_accounts(const chain::block_state_ptr& bs)
+{
+   if( pending_account_actions.empty() ) return;
+
+   vector<chain::action> actions;
+   for( const auto& receipt : bs->block->transactions ) {
+      // get id via get_uncached_id() as packed_transaction.id() mutates the block shared with the other lanes
+      const auto id = receipt.trx.contains<packed_transaction>() ? receipt.trx.get<packed_transaction>().get_uncached_id()
+                                                                 : receipt.trx.get<transaction_id_type>();
+      auto itr = pending_account_actions.find( id );
+      if( itr != pending_account_actions.end() ) {
+         std::move( itr->second.actions.begin(), itr->second.actions.end(), std::back_inserter( actions ) );
+         pending_account_actions.erase( itr );
+      }
+   }
+   // what is left up to this block was executed speculatively or on a fork that was dropped
+   for( auto itr = pending_account_actions.begin(); itr != pending_account_actions.end(); ) {
+      if( itr->second.block_num <= bs->block_num )
+         itr = pending_account_actions.erase( itr );
+      else
+         ++itr;
+   }
+
+   if( !actions.empty() )
+      update_accounts( actions );
+}
+
+/**
+ *  Applies the account actions of irreversible blocks the way update_account does one at a time, but coalesced: the
+ *  last change of each account and permission is written, with one bulk write for each collection.
+ */
+void mongo_db_plugin_impl::update_accounts(const vector<chain::action>& actions)
+{
+   using bsoncxx::builder::basic::kvp;
+   using bsoncxx::builder::basic::make_document;
+   using namespace bsoncxx::types;
+
+   struct account_change {
+      bool                         created = false;
+      fc::optional<chain::bytes>   abi;
+   };
+   std::map<account_name, account_change> accounts;
+   std::map<std::pair<account_name, permission_name>, fc::optional<chain::authority>> auths; ///< empty when deleted
+
+   for( const auto& act : actions ) {
+      try {
+         if( act.name == newaccount ) {
+            auto newacc = act.data_as<chain::newaccount>();
+            accounts[newacc.name].created = true;
+            auths[std::make_pair( newacc.name, owner )] = newacc.owner;
+            auths[std::make_pair( newacc.name, active )] = newacc.active;
+         } else if( act.name == updateauth ) {
+            auto update = act.data_as<chain::updateauth>();
+            auths[std::make_pair( update.account, update.permission )] = update.auth;
+         } else if( act.name == deleteauth ) {
+            auto del = act.data_as<chain::deleteauth>();
+            auths[std::make_pair( del.account, del.permission )] = fc::optional<chain::authority>();
+         } else if( act.name == setabi ) {
+            auto set = act.data_as<chain::setabi>();
+            accounts[set.account].abi = set.abi;
+         }
+      } catch( fc::exception& e ) {
+         // if unable to unpack native type, skip it
+      }
+   }
+
+   auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()} );
+
+   if( !accounts.empty() ) {
+      // held until the abis are updated, so that no other lane caches an old one again meanwhile
+      boost::mutex::scoped_lock lock( abi_cache_mtx );
+
+      mongocxx::options::bulk_write bulk_opts;
+      bulk_opts.ordered( false );
+      auto bulk = _accounts.create_bulk_write( bulk_opts );
+      for( const auto& a : accounts ) {
+         const string name_str = a.first.to_string();
+         auto set_doc = bsoncxx::builder::basic::document{};
+         set_doc.append( kvp( "name", name_str ) );
+         if( a.second.created )
+            set_doc.append( kvp( "createdAt", b_date{now} ) );
+         if( a.second.abi ) {
+            abi_cache_index.erase( a.first );
+            try {
+               fc::variant abi( fc::raw::unpack<chain::abi_def>( *a.second.abi ) );
+               bool purged = false;
+               append_bson_value( abi, purged, [&]( auto&& value ) { set_doc.append( kvp( "abi", std::forward<decltype(value)>( value ) ) ); } );
+               set_doc.append( kvp( "updatedAt", b_date{now} ) );
+            } catch( fc::exception& e ) {
+               elog( "Unable to unpack abi of ${n}: ${e}", ("n", a.first)("e", e.to_string()) );
+            }
+         }
+         auto update_doc = bsoncxx::builder::basic::document{};
+         update_doc.append( kvp( "$set", set_doc.view() ) );
+         if( !a.second.created )
+            update_doc.append( kvp( "$setOnInsert", make_document( kvp( "createdAt", b_date{now} ) ) ) );
+
+         mongocxx::model::update_one update_op{make_document( kvp( "name", name_str ) ), update_doc.extract()};
+         update_op.upsert( true );
+         bulk.append( update_op );
+      }
+      try {
+         if( !bulk.execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_update_fail, "Bulk accounts update failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "accounts update", __LINE__ );
+      }
+   }
+
+   if( !auths.empty() ) {
+      // ordered, the deletes of a permission go before its inserts
+      auto keys_bulk = _pub_keys.create_bulk_write();
+      auto controls_bulk = _account_controls.create_bulk_write();
+      for( const auto& a : auths ) {
+         const string account = a.first.first.to_string();
+         const string permission = a.first.second.to_string();
+         keys_bulk.append( mongocxx::model::delete_many{make_document( kvp( "account", account ), kvp( "permission", permission ) )} );
+         controls_bulk.append( mongocxx::model::delete_many{make_document( kvp( "controlled_account", account ),
+                                                                           kvp( "controlled_permission", permission ) )} );
+         if( !a.second ) continue;
+
+         for( const auto& pub_key_weight : a.second->keys ) {
+            auto find_doc = make_document( kvp( "account", account ),
+                                           kvp( "public_key", pub_key_weight.key.operator string() ),
+                                           kvp( "permission", permission ) );
+            auto update_doc = make_document( kvp( "$set", make_document( bsoncxx::builder::concatenate_doc{find_doc.view()},
+                                                                         kvp( "createdAt", b_date{now} ) ) ) );
+            mongocxx::model::update_one insert_op{find_doc.view(), update_doc.view()};
+            insert_op.upsert( true );
+            keys_bulk.append( insert_op );
+         }
+         for( const auto& controlling_account : a.second->accounts ) {
+            auto find_doc = make_document( kvp( "controlled_account", account ),
+                                           kvp( "controlled_permission", permission ),
+                                           kvp( "controlling_account", controlling_account.permission.actor.to_string() ) );
+            auto update_doc = make_document( kvp( "$set", make_document( bsoncxx::builder::concatenate_doc{find_doc.view()},
+                                                                         kvp( "createdAt", b_date{now} ) ) ) );
+            mongocxx::model::update_one insert_op{find_doc.view(), update_doc.view()};
+            insert_op.upsert( true );
+            controls_bulk.append( insert_op );
+         }
+      }
+      try {
+         if( !keys_bulk.execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_update_fail, "Bulk pub_keys update failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "pub_keys update", __LINE__ );
+      }
+      try {
+         if( !controls_bulk.execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_update_fail, "Bulk account_controls update failed" );
+         }
+      } catch( ... ) {
+         handle_mongo_exception( "account_controls update", __LINE__ );
+      }
+   }
+}
+
 mongo_db_plugin_impl::mongo_db_plugin_impl()
 {
 }
@@ -1331,14 +1587,12 @@ mongo_db_plugin_impl::~mongo_db_plugin_impl() {
    if (!startup) {
       try {
          ilog( "mongo_db_plugin shutdown in process please be patient this can take a few minutes" );
-         done = true;
-         condition.notify_one();
-
-         consume_thread.join();
+         stop_lanes();
 
+         abi_client.reset();
          mongo_pool.reset();
       } catch( std::exception& e ) {
-         elog( "Exception on mongo_db_plugin shutdown of consume thread: ${e}", ("e", e.what()));
+         elog( "Exception on mongo_db_plugin shutdown of writer threads: ${e}", ("e", e.what()));
       }
    }
 }
@@ -1441,9 +1695,12 @@ void mongo_db_plugin_impl::init() {
       handle_mongo_exception( "mongo init", __LINE__ );
    }
 
-   ilog("starting db plugin thread");
+   abi_client = mongo_pool->acquire();
+   _abi_accounts = (*abi_client)[db_name][accounts_col];
+
+   ilog("starting db plugin writer threads");
 
-   consume_thread = boost::thread([this] { consume_blocks(); });
+   start_lanes();
 
    startup = false;
 }
@@ -1465,7 +1722,9 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
 {
    cfg.add_options()
          ("mongodb-queue-size,q", bpo::value<uint32_t>()->default_value(1024),
-         "The target queue size between nodeos and MongoDB plugin thread.")
+         "The target queue size between nodeos and each of the MongoDB plugin writer threads.")
+         ("mongodb-bulk-size", bpo::value<uint32_t>()->default_value(500),
+         "The number of action and transaction trace inserts sent to MongoDB in one unordered bulk write.")
          ("mongodb-abi-cache-size", bpo::value<uint32_t>()->default_value(2048),
           "The maximum size of the abi cache for serializing data.")
          ("mongodb-wipe", bpo::bool_switch()->default_value(false),
@@ -1479,6 +1738,8 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
                " Example: mongodb://127.0.0.1:27017/EOS")
          ("mongodb-update-via-block-num", bpo::value<bool>()->default_value(false),
           "Update blocks/block_state with latest via block number so that duplicates are overwritten.")
+         ("mongodb-irreversible-accounts", bpo::value<bool>()->default_value(false),
+          "Update accounts, pub_keys and account_controls only from irreversible blocks, coalesced per account and permission.")
          ("mongodb-store-blocks", bpo::value<bool>()->default_value(true),
           "Enables storing blocks in mongodb.")
          ("mongodb-store-block-states", bpo::value<bool>()->default_value(true),
@@ -1521,6 +1782,10 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          if( options.count( "mongodb-queue-size" )) {
             my->max_queue_size = options.at( "mongodb-queue-size" ).as<uint32_t>();
          }
+         if( options.count( "mongodb-bulk-size" )) {
+            my->bulk_size = options.at( "mongodb-bulk-size" ).as<uint32_t>();
+            EOS_ASSERT( my->bulk_size > 0, chain::plugin_config_exception, "mongodb-bulk-size > 0 required" );
+         }
          if( options.count( "mongodb-abi-cache-size" )) {
             my->abi_cache_size = options.at( "mongodb-abi-cache-size" ).as<uint32_t>();
             EOS_ASSERT( my->abi_cache_size > 0, chain::plugin_config_exception, "mongodb-abi-cache-size > 0 required" );
@@ -1546,6 +1811,9 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          if( options.count( "mongodb-store-action-traces" )) {
             my->store_action_traces = options.at( "mongodb-store-action-traces" ).as<bool>();
          }
+         if( options.count( "mongodb-irreversible-accounts" )) {
+            my->irreversible_accounts = options.at( "mongodb-irreversible-accounts" ).as<bool>();
+         }
          if( options.count( "mongodb-filter-on" )) {
             auto fo = options.at( "mongodb-filter-on" ).as<vector<string>>();
             my->filter_on_star = false;
@@ -1,7 +1,10 @@
 #include "action_handler.hpp"
 
+#include <eosio/chain/thread_registry.hpp>
+
 #include <fc/io/raw.hpp>
 
+#include "prepared_lookup.hpp"
 #include "try_handle.hpp"
 
 namespace eosio {
@@ -34,6 +37,7 @@ token_transfer_handler::token_transfer_handler(const std::vector<std::string>& c
 
 void token_transfer_handler::start() {
     thread_ = std::thread([this] {
+        chain::thread_registry::instance().register_current_thread("mysql-db-transfers");
         loop_handle(done_, "consume token transfer actions", [=] { consume_token_transfers(); });
     });
 }
@@ -60,12 +64,13 @@ void token_transfer_handler::consume_token_transfers() {
 
     odb::transaction t(db_->begin());
 
-    query q(query::action_global_seq.in_range(seqs.begin(), seqs.end()));
-    auto result = db_->query<TokenTransfer>(q);
+    auto by_seq = make_prepared_lookup<TokenTransfer, uint64_t>("mysql_db_plugin.token_transfer.action_global_seq", FIFO_POP_SIZE, [](const uint64_t& seq) -> query {
+        return query::action_global_seq == query::_ref(seq);
+    });
     std::unordered_set<uint64_t> set;
-    for (auto it = result.begin(); it != result.end(); ++it) {
+    by_seq.each(seqs, [&](odb::result<TokenTransfer>::iterator& it) {
         set.insert(it.id());
-    }
+    });
     for (auto& p: distinct_transfers) {
         auto& transfer = p.second;
         if (set.count(transfer->action_global_seq_)) db_->update(*transfer);
@@ -0,0 +1,100 @@
+#include "bulk_insert.hpp"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace eosio {
+
+bulk_insert::bulk_insert(odb::database& db, std::string table, const std::vector<std::string>& columns,
+                         std::size_t max_rows, bool upsert, std::size_t max_bytes)
+        : db_(db), max_rows_(std::max<std::size_t>(max_rows, 1)), max_bytes_(max_bytes) {
+    prefix_ = "INSERT INTO `" + table + "` (";
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+        if (i) prefix_ += ", ";
+        prefix_ += "`" + columns[i] + "`";
+    }
+    prefix_ += ") VALUES ";
+
+    if (upsert) {
+        suffix_ = " ON DUPLICATE KEY UPDATE ";
+        for (std::size_t i = 1; i < columns.size(); ++i) {
+            if (i > 1) suffix_ += ", ";
+            suffix_ += "`" + columns[i] + "`=VALUES(`" + columns[i] + "`)";
+        }
+    }
+}
+
+void bulk_insert::begin_row() {
+    row_.clear();
+    row_ += '(';
+}
+
+void bulk_insert::end_row() {
+    row_ += ')';
+
+    if (pending_rows_ >= max_rows_ or (pending_rows_ > 0 and sql_.size() + row_.size() + suffix_.size() + 1 > max_bytes_)) flush();
+
+    if (pending_rows_ == 0) sql_ = prefix_;
+    else sql_ += ',';
+    sql_ += row_;
+    ++pending_rows_;
+    ++total_rows_;
+}
+
+void bulk_insert::flush() {
+    if (pending_rows_ == 0) return;
+    sql_ += suffix_;
+    db_.execute(sql_);
+    sql_.clear();
+    pending_rows_ = 0;
+}
+
+void bulk_insert::add(uint64_t v) {
+    row_ += std::to_string(v);
+}
+
+void bulk_insert::add(int64_t v) {
+    row_ += std::to_string(v);
+}
+
+void bulk_insert::add(bool v) {
+    row_ += v ? '1' : '0';
+}
+
+void bulk_insert::add(const bytes& v) {
+    add_hex(v.data(), v.size());
+}
+
+void bulk_insert::add(const std::string& v) {
+    add_hex(v.data(), v.size());
+}
+
+void bulk_insert::add(const datetime& v) {
+    if (v.is_special()) { // unset, such as a default constructed `not_a_date_time`
+        row_ += "NULL";
+        return;
+    }
+    row_ += '\'';
+    row_ += boost::posix_time::to_iso_extended_string(v);
+    row_ += '\'';
+}
+
+void bulk_insert::add(TransactionStatus v) {
+    row_ += std::to_string(static_cast<unsigned>(v) + 1); // index of MySQL ENUM value starts from 1
+}
+
+void bulk_insert::add_hex(const char* data, std::size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    if (size == 0) {
+        row_ += "''";
+        return;
+    }
+    row_ += "X'";
+    for (std::size_t i = 0; i < size; ++i) {
+        auto c = static_cast<unsigned char>(data[i]);
+        row_ += digits[c >> 4];
+        row_ += digits[c & 0xf];
+    }
+    row_ += '\'';
+}
+
+}
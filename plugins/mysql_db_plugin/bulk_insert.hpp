@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <odb/database.hxx>
+
+#include "odb/eos.hpp"
+
+namespace eosio {
+
+constexpr std::size_t BULK_INSERT_MAX_BYTES = 1024 * 1024; // keep statements well below MySQL max_allowed_packet
+
+/**
+ * Builder of multi-row `INSERT` statements, which are executed whenever the statement is about to
+ * exceed `max_rows` rows or `max_bytes` bytes, and finally on `flush`.
+ * Binary and string values go as hex literals, so no escaping is needed.
+ * With `upsert`, rows with an existing primary key, which must be the first column, are updated instead.
+ */
+class bulk_insert {
+public:
+    bulk_insert(odb::database& db, std::string table, const std::vector<std::string>& columns,
+                std::size_t max_rows, bool upsert = false, std::size_t max_bytes = BULK_INSERT_MAX_BYTES);
+
+    template <typename... Values>
+    void row(const Values&... values) {
+        begin_row();
+        add_all(values...);
+        end_row();
+    }
+
+    void flush();
+    std::size_t rows() const { return total_rows_; }
+
+private:
+    void begin_row();
+    void end_row();
+
+    void add_all() {}
+    template <typename Value, typename... Values>
+    void add_all(const Value& value, const Values&... values) {
+        if (row_.size() > 1) row_ += ',';
+        add(value);
+        add_all(values...);
+    }
+
+    void add(uint64_t v);
+    void add(int64_t v);
+    void add(uint32_t v) { add(uint64_t(v)); }
+    void add(uint16_t v) { add(uint64_t(v)); }
+    void add(uint8_t v) { add(uint64_t(v)); }
+    void add(bool v);
+    void add(const bytes& v);
+    void add(const std::string& v);
+    void add(const datetime& v);
+    void add(TransactionStatus v);
+    template <typename T>
+    void add(const odb::nullable<T>& v) {
+        if (v.null()) row_ += "NULL";
+        else add(*v);
+    }
+    void add_hex(const char* data, std::size_t size);
+
+    odb::database& db_;
+    std::string prefix_;
+    std::string suffix_;
+    std::string sql_;
+    std::string row_;
+    std::size_t max_rows_;
+    std::size_t max_bytes_;
+    std::size_t pending_rows_{};
+    std::size_t total_rows_{};
+};
+
+}
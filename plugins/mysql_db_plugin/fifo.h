@@ -5,17 +5,29 @@
 #pragma once
 
 #include <mutex>
+#include <thread>
 #include <condition_variable>
 #include <atomic>
-#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 #include <boost/noncopyable.hpp>
+#include <eosio/chain/metrics.hpp>
 
 namespace eosio {
 
 constexpr std::size_t FIFO_MAX_SIZE = 1000; // TODO: is cache useless?
 constexpr std::size_t FIFO_POP_SIZE = 1000;
 
+/**
+ * Bounded lock-free ring buffer, with any number of producers and a single consumer.
+ * `push` takes no lock; the consumer drains up to `num` elements at once and sleeps when empty.
+ * When full, `push` either waits for the consumer, drops the element and counts it, or spills it
+ * into an append-only file. Once spilling, all elements go to the file until the consumer has drained it,
+ * so they are still consumed in order; elements left in the file are drained first after restart.
+ */
 template <typename T>
 class fifo : public boost::noncopyable {
 public:
@@ -23,63 +35,222 @@ public:
         blocking, not_blocking
     };
 
+    enum class full_policy {
+        block, drop, spill
+    };
+
+    using packer = std::function<std::vector<char>(const T&)>;
+    using unpacker = std::function<T(const std::vector<char>&)>;
+
     fifo(std::size_t max_size = FIFO_MAX_SIZE);
     void push(const T& element);
     std::vector<T> pop(std::size_t num = FIFO_POP_SIZE);
     void set_behavior(behavior value);
+    void set_full_policy(full_policy value) { full_policy_ = value; }
+    /// Set `full_policy::spill` with the spill file and the serialization of elements
+    void set_spill(const std::string& file, packer pack, unpacker unpack);
     void awaken();
+    /// Keep `gauge` at the number of elements in the ring, not counting spilled ones; may be shared by fifos
+    void set_depth_metric(chain::metric_gauge* gauge) { depth_ = gauge; }
+
+    uint64_t dropped() const { return dropped_; }
+    uint64_t stalls() const { return stalls_; }
+    uint64_t spilled() const { return spilled_; }
 
 private:
+    struct cell {
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+
+    bool try_push(const T& element);
+    void spill(const T& element);
+    void unspill(std::size_t num, std::vector<T>& result);
+    bool empty() const { return cells_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1 and not spilling_; }
+
+    std::unique_ptr<cell[]> cells_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> tail_{0}; // next push position
+    alignas(64) std::size_t head_{0}; // next pop position, only accessed by the consumer
+
+    std::atomic<behavior> behavior_{behavior::blocking};
+    std::atomic<full_policy> full_policy_{full_policy::block};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> stalls_{0};
+    std::atomic<uint64_t> spilled_{0};
+    chain::metric_gauge* depth_ = nullptr;
+
+    // only taken while spilling
+    std::mutex spill_mux_;
+    std::atomic<bool> spilling_{false};
+    std::string spill_file_;
+    std::ofstream spill_out_;
+    std::ifstream spill_in_;
+    uint64_t spill_write_pos_{};
+    uint64_t spill_read_pos_{};
+    packer pack_;
+    unpacker unpack_;
+
+    // only for sleeping, never taken when the consumer is busy
     std::mutex mux_;
     std::condition_variable not_empty_cv_;
-    std::condition_variable not_full_cv_;
-    std::atomic<behavior> behavior_{behavior::blocking};
-    std::deque<T> deque_;
-    std::size_t max_size_;
+    std::atomic<bool> consumer_waiting_{false};
 };
 
 template <typename T>
 fifo<T>::fifo(std::size_t max_size) {
-    max_size_ = max_size;
+    std::size_t size = 2;
+    while (size < max_size) size <<= 1;
+    mask_ = size - 1;
+    cells_.reset(new cell[size]);
+    for (std::size_t i = 0; i < size; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
 }
 
 template <typename T>
-void fifo<T>::push(const T& element) {
-    std::unique_lock<std::mutex> lock(mux_);
+bool fifo<T>::try_push(const T& element) {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    cell* c;
+    while (true) {
+        c = &cells_[pos & mask_];
+        auto seq = c->seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    c->data = element;
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+void fifo<T>::set_spill(const std::string& file, packer pack, unpacker unpack) {
+    std::lock_guard<std::mutex> lock(spill_mux_);
+    spill_file_ = file;
+    pack_ = std::move(pack);
+    unpack_ = std::move(unpack);
 
-    if (deque_.size() >= max_size_) {
-        not_full_cv_.wait(lock, [&] {
-            return behavior_ == behavior::not_blocking || deque_.size() < max_size_;
-        });
+    spill_out_.open(spill_file_, std::ios::binary | std::ios::app);
+    spill_in_.open(spill_file_, std::ios::binary);
+    spill_in_.seekg(0, std::ios::end);
+    spill_write_pos_ = static_cast<uint64_t>(spill_in_.tellg());
+    spill_in_.seekg(0);
+    spill_read_pos_ = 0;
+    spilling_ = spill_write_pos_ > 0; // left from the last run
+
+    full_policy_ = full_policy::spill;
+}
+
+template <typename T>
+void fifo<T>::spill(const T& element) {
+    std::lock_guard<std::mutex> lock(spill_mux_);
+    if (not spilling_) {
+        if (try_push(element)) return; // drained meanwhile
+        spilling_ = true;
     }
 
-    deque_.push_back(element);
-    not_empty_cv_.notify_one();
+    auto data = pack_(element);
+    auto size = static_cast<uint32_t>(data.size());
+    spill_out_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    spill_out_.write(data.data(), data.size());
+    spill_out_.flush();
+    spill_write_pos_ += sizeof(size) + data.size();
+    ++spilled_;
 }
 
+// Only called by the consumer after the ring has been drained
 template <typename T>
-std::vector<T> fifo<T>::pop(std::size_t num) {
-    std::unique_lock<std::mutex> lock(mux_);
-    if (deque_.empty()) {
-        not_empty_cv_.wait(lock, [&] {
-            return behavior_ == behavior::not_blocking || !deque_.empty();
-        });
+void fifo<T>::unspill(std::size_t num, std::vector<T>& result) {
+    std::lock_guard<std::mutex> lock(spill_mux_);
+    if (not spilling_) return;
+
+    spill_in_.clear();
+    spill_in_.seekg(spill_read_pos_);
+    while (result.size() < num and spill_read_pos_ < spill_write_pos_) {
+        uint32_t size = 0;
+        std::vector<char> data;
+        if (spill_in_.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+            data.resize(size);
+            spill_in_.read(data.data(), size);
+        }
+        if (not spill_in_) {
+            spill_read_pos_ = spill_write_pos_; // torn record of a crash, nothing else follows it
+            break;
+        }
+        spill_read_pos_ += sizeof(size) + size;
+        result.push_back(unpack_(data));
     }
 
+    if (spill_read_pos_ >= spill_write_pos_) {
+        spill_out_.close();
+        spill_out_.open(spill_file_, std::ios::binary | std::ios::trunc);
+        spill_write_pos_ = spill_read_pos_ = 0;
+        spilling_ = false;
+    }
+}
+
+template <typename T>
+void fifo<T>::push(const T& element) {
+    if (spilling_ or not try_push(element)) {
+        if (full_policy_ == full_policy::spill) {
+            spill(element);
+        } else if (full_policy_ == full_policy::drop) {
+            ++dropped_;
+            return;
+        } else {
+            ++stalls_;
+            while (not try_push(element)) {
+                if (behavior_ == behavior::not_blocking) return; // shutting down
+                not_empty_cv_.notify_one();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            if (depth_) depth_->add(1);
+        }
+    } else if (depth_) {
+        depth_->add(1);
+    }
+
+    if (consumer_waiting_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(mux_);
+        not_empty_cv_.notify_one();
+    }
+}
+
+template <typename T>
+std::vector<T> fifo<T>::pop(std::size_t num) {
     std::vector<T> result;
-    for (std::size_t i = 0; i < num && !deque_.empty(); ++i) {
-        result.push_back(std::move(deque_.front()));
-        deque_.pop_front();
+    while (true) {
+        for (std::size_t i = 0; i < num; ++i) {
+            auto& c = cells_[head_ & mask_];
+            if (c.seq.load(std::memory_order_acquire) != head_ + 1) break; // empty
+            result.push_back(std::move(c.data));
+            c.data = T();
+            c.seq.store(head_ + mask_ + 1, std::memory_order_release);
+            ++head_;
+        }
+        if (depth_ and not result.empty()) depth_->add(-static_cast<int64_t>(result.size()));
+        if (result.empty() and spilling_) unspill(num, result);
+        if (not result.empty() or behavior_ == behavior::not_blocking) return result;
+
+        // sleep until pushed; the timeout covers a push racing with the flag
+        std::unique_lock<std::mutex> lock(mux_);
+        consumer_waiting_.store(true, std::memory_order_release);
+        if (empty()) {
+            not_empty_cv_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        consumer_waiting_.store(false, std::memory_order_relaxed);
     }
-    not_full_cv_.notify_all();
-    return result;
 }
 
 template <typename T>
 void fifo<T>::set_behavior(behavior value) {
     behavior_ = value;
+    std::lock_guard<std::mutex> lock(mux_);
     not_empty_cv_.notify_all();
-    not_full_cv_.notify_all();
 }
 
 template <typename T>
@@ -87,4 +258,81 @@ void fifo<T>::awaken() {
     set_behavior(behavior::not_blocking);
 }
 
+/**
+ * A fifo per consumer, where elements with the same key always go into the same fifo,
+ * so that they are consumed in order.
+ */
+template <typename T>
+class sharded_fifo : public boost::noncopyable {
+public:
+    void resize(std::size_t shards, std::size_t max_size = FIFO_MAX_SIZE);
+    std::size_t size() const { return shards_.size(); }
+
+    void push(std::size_t key, const T& element) { shards_[key % shards_.size()]->push(element); }
+    fifo<T>& shard(std::size_t i) { return *shards_.at(i); }
+    void set_full_policy(typename fifo<T>::full_policy value);
+    /// Spill into `file_prefix`.<shard>
+    void set_spill(const std::string& file_prefix, typename fifo<T>::packer pack, typename fifo<T>::unpacker unpack);
+    void awaken();
+    void set_depth_metric(chain::metric_gauge* gauge);
+
+    uint64_t dropped() const;
+    uint64_t stalls() const;
+    uint64_t spilled() const;
+
+private:
+    std::vector<std::unique_ptr<fifo<T>>> shards_;
+};
+
+template <typename T>
+void sharded_fifo<T>::resize(std::size_t shards, std::size_t max_size) {
+    shards_.clear();
+    for (std::size_t i = 0; i < std::max<std::size_t>(shards, 1); ++i) {
+        shards_.push_back(std::make_unique<fifo<T>>(max_size));
+    }
+}
+
+template <typename T>
+void sharded_fifo<T>::set_full_policy(typename fifo<T>::full_policy value) {
+    for (auto& f: shards_) f->set_full_policy(value);
+}
+
+template <typename T>
+void sharded_fifo<T>::set_spill(const std::string& file_prefix, typename fifo<T>::packer pack, typename fifo<T>::unpacker unpack) {
+    for (std::size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i]->set_spill(file_prefix + "." + std::to_string(i), pack, unpack);
+    }
+}
+
+template <typename T>
+void sharded_fifo<T>::awaken() {
+    for (auto& f: shards_) f->awaken();
+}
+
+template <typename T>
+void sharded_fifo<T>::set_depth_metric(chain::metric_gauge* gauge) {
+    for (auto& f: shards_) f->set_depth_metric(gauge);
+}
+
+template <typename T>
+uint64_t sharded_fifo<T>::dropped() const {
+    uint64_t n = 0;
+    for (auto& f: shards_) n += f->dropped();
+    return n;
+}
+
+template <typename T>
+uint64_t sharded_fifo<T>::stalls() const {
+    uint64_t n = 0;
+    for (auto& f: shards_) n += f->stalls();
+    return n;
+}
+
+template <typename T>
+uint64_t sharded_fifo<T>::spilled() const {
+    uint64_t n = 0;
+    for (auto& f: shards_) n += f->spilled();
+    return n;
+}
+
 }
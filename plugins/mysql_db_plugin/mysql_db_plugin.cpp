@@ -3,6 +3,8 @@
  *  @copyright defined in eos/LICENSE.txt
  */
 #include <eosio/mysql_db_plugin/mysql_db_plugin.hpp>
+#include <eosio/chain/signal_dispatcher.hpp>
+#include <eosio/chain/thread_registry.hpp>
 
 #include <boost/date_time/c_local_time_adjustor.hpp>
 
@@ -16,6 +18,8 @@
 #include "odb/eos.hpp"
 #include "odb/eos-odb.hxx"
 #include "fifo.h"
+#include "bulk_insert.hpp"
+#include "prepared_lookup.hpp"
 #include "try_handle.hpp"
 #include "action_handler.hpp"
 
@@ -50,9 +54,9 @@ static appbase::abstract_plugin& _mysql_db_plugin = app().register_plugin<mysql_
 class mysql_db_plugin_impl {
 public:
     void consume_blocks();
-    void consume_transactions();
-    void consume_transaction_traces();
-    void consume_actions();
+    void consume_transactions(std::size_t shard);
+    void consume_transaction_traces(std::size_t shard);
+    void consume_actions(std::size_t shard);
 
     void push_block(const chain::block_state_ptr& block_state);
     std::pair<uint32_t, uint32_t> push_transaction(const chain::transaction_receipt& transaction_receipt, const BlockPtr& block, const uint16_t block_seq);
@@ -65,6 +69,13 @@ public:
 
     bool configured_{false};
     bool wipe_database_on_startup_{false};
+    std::size_t batch_size_{FIFO_POP_SIZE}; // rows popped and inserted at once
+
+    // High-water marks of the stored rows, above which nothing can exist yet, so the lookups are skipped.
+    // Each shard keeps its own, starting from the maximum over all.
+    unsigned block_hwm_{};
+    std::vector<unsigned> transaction_block_hwm_;
+    std::vector<uint64_t> action_hwm_;
 
     chain_plugin* chain_plugin_{nullptr};
     shared_ptr<odb::database> db_;
@@ -74,30 +85,33 @@ public:
     std::atomic<bool> start_sync_{false};
 
     StatsPtr stats_;
-    fifo<BlockPtr> block_queue_;
-    fifo<TransactionPtr> transaction_queue_;
-    fifo<TransactionTracePtr> transaction_trace_queue_;
-    fifo<ActionPtr> action_queue_;
+    // sharded by id, except blocks, which are consumed in order by one thread along with the stats
+    sharded_fifo<BlockPtr> block_queue_;
+    sharded_fifo<TransactionPtr> transaction_queue_;
+    sharded_fifo<TransactionTracePtr> transaction_trace_queue_;
+    sharded_fifo<ActionPtr> action_queue_;
 
     boost::signals2::connection block_conn_;
     boost::signals2::connection irreversible_block_conn_;
     boost::signals2::connection transaction_conn_;
+    chain::signal_dispatcher::subscriber_ptr signals_; // keeps blocks and traces in order when they are dispatched off the main thread
 
     std::thread consume_block_thread_;
-    std::thread consume_transaction_thread_;
-    std::thread consume_transaction_trace_thread_;
-    std::thread consume_action_thread_;
+    std::vector<std::thread> consume_transaction_threads_;
+    std::vector<std::thread> consume_transaction_trace_threads_;
+    std::vector<std::thread> consume_action_threads_;
 
     std::vector<action_handler_ptr> action_handlers_;
 };
 
 void mysql_db_plugin_impl::stop() {
     try {
-        done_ = true;
-
         block_conn_.disconnect();
         irreversible_block_conn_.disconnect();
         transaction_conn_.disconnect();
+        if (signals_) signals_->flush(); // while the consumers still drain the queues
+
+        done_ = true;
 
         block_queue_.awaken();
         transaction_queue_.awaken();
@@ -105,9 +119,14 @@ void mysql_db_plugin_impl::stop() {
         action_queue_.awaken();
 
         if (consume_block_thread_.joinable()) consume_block_thread_.join();
-        if (consume_transaction_thread_.joinable()) consume_transaction_thread_.join();
-        if (consume_transaction_trace_thread_.joinable()) consume_transaction_trace_thread_.join();
-        if (consume_action_thread_.joinable()) consume_action_thread_.join();
+        for (auto& t: consume_transaction_threads_) if (t.joinable()) t.join();
+        for (auto& t: consume_transaction_trace_threads_) if (t.joinable()) t.join();
+        for (auto& t: consume_action_threads_) if (t.joinable()) t.join();
+
+        auto dropped = block_queue_.dropped() + transaction_queue_.dropped() + transaction_trace_queue_.dropped() + action_queue_.dropped();
+        auto stalls = block_queue_.stalls() + transaction_queue_.stalls() + transaction_trace_queue_.stalls() + action_queue_.stalls();
+        auto spilled = block_queue_.spilled() + transaction_queue_.spilled() + transaction_trace_queue_.spilled() + action_queue_.spilled();
+        if (dropped or stalls or spilled) wlog("mysql queues were full: ${d} dropped, ${s} stalls, ${p} spilled", ("d", dropped)("s", stalls)("p", spilled));
 
         if (db_) db_.reset();
 
@@ -123,6 +142,13 @@ namespace {
 
 inline bytes checksum_bytes(const fc::sha256& s) { return bytes(s.data(), s.data() + sizeof(fc::sha256)); }
 
+// the leading 8 bytes of checksums are well distributed for sharding
+inline std::size_t shard_key(const bytes& id) {
+    uint64_t key{};
+    memcpy(&key, id.data(), std::min(id.size(), sizeof(key)));
+    return static_cast<std::size_t>(key);
+}
+
 boost::posix_time::ptime now() {
     return boost::posix_time::microsec_clock::local_time(); // adapt to MySQL Local TimeZone setting
 }
@@ -148,6 +174,99 @@ fc::time_point time_point(int64_t microseconds) {
     return fc::time_point(fc::microseconds(microseconds));
 }
 
+// serialization of rows spilled to disk
+
+template <typename Stream> void pack_fields(Stream&) {}
+template <typename Stream, typename F, typename... Fs>
+void pack_fields(Stream& s, const F& f, const Fs&... fs) { fc::raw::pack(s, f); pack_fields(s, fs...); }
+
+template <typename Stream> void unpack_fields(Stream&) {}
+template <typename Stream, typename F, typename... Fs>
+void unpack_fields(Stream& s, F& f, Fs&... fs) { fc::raw::unpack(s, f); unpack_fields(s, fs...); }
+
+template <typename... Fs>
+vector<char> pack_all(const Fs&... fs) {
+    fc::datastream<size_t> ps;
+    pack_fields(ps, fs...);
+    vector<char> data(ps.tellp());
+    fc::datastream<char*> ds(data.data(), data.size());
+    pack_fields(ds, fs...);
+    return data;
+}
+
+template <typename... Fs>
+void unpack_all(const vector<char>& data, Fs&... fs) {
+    fc::datastream<const char*> ds(data.data(), data.size());
+    unpack_fields(ds, fs...);
+}
+
+const datetime epoch(boost::gregorian::date(1970, 1, 1));
+// an unset datetime survives the cache, to be written as NULL
+const int64_t unset_us = std::numeric_limits<int64_t>::min();
+int64_t to_us(const datetime& t) { return t.is_special() ? unset_us : (t - epoch).total_microseconds(); }
+datetime from_us(int64_t us) { return us == unset_us ? datetime() : epoch + boost::posix_time::microseconds(us); }
+
+template <typename T>
+fc::optional<T> to_optional(const nullable<T>& v) { return v.null() ? fc::optional<T>() : fc::optional<T>(*v); }
+template <typename T>
+nullable<T> from_optional(const fc::optional<T>& v) { return v ? nullable<T>(*v) : nullable<T>(); }
+
+vector<char> pack_block(const BlockPtr& b) {
+    return pack_all(b->id_, b->num_, to_us(b->timestamp_), b->block_, b->tx_count_, b->action_count_, b->context_free_action_count_, to_us(b->created_at_));
+}
+
+BlockPtr unpack_block(const vector<char>& data) {
+    auto b = std::make_shared<Block>();
+    int64_t timestamp, created_at;
+    unpack_all(data, b->id_, b->num_, timestamp, b->block_, b->tx_count_, b->action_count_, b->context_free_action_count_, created_at);
+    b->timestamp_ = from_us(timestamp);
+    b->created_at_ = from_us(created_at);
+    return b;
+}
+
+vector<char> pack_transaction(const TransactionPtr& t) {
+    return pack_all(t->id_, t->block_id_, t->block_num_, to_us(t->block_time_), t->block_seq_, t->action_count_, t->context_free_action_count_);
+}
+
+TransactionPtr unpack_transaction(const vector<char>& data) {
+    auto t = std::make_shared<Transaction>();
+    int64_t block_time;
+    unpack_all(data, t->id_, t->block_id_, t->block_num_, block_time, t->block_seq_, t->action_count_, t->context_free_action_count_);
+    t->block_time_ = from_us(block_time);
+    return t;
+}
+
+vector<char> pack_transaction_trace(const TransactionTracePtr& t) {
+    return pack_all(t->id_, t->scheduled_, static_cast<uint8_t>(t->status_), t->net_usage_words_, t->cpu_usage_us_, to_optional(t->exception_));
+}
+
+TransactionTracePtr unpack_transaction_trace(const vector<char>& data) {
+    auto t = std::make_shared<TransactionTrace>();
+    uint8_t status;
+    fc::optional<string> exception;
+    unpack_all(data, t->id_, t->scheduled_, status, t->net_usage_words_, t->cpu_usage_us_, exception);
+    t->status_ = static_cast<TransactionStatus>(status);
+    t->exception_ = from_optional(exception);
+    return t;
+}
+
+vector<char> pack_action(const ActionPtr& a) {
+    return pack_all(a->global_seq_, a->account_seq_, a->parent_seq_, a->account_, a->name_, to_optional(a->auth_), a->data_, a->receiver_,
+                    to_optional(a->auth_seq_), a->code_seq_, a->abi_seq_, a->tx_id_, to_optional(a->console_));
+}
+
+ActionPtr unpack_action(const vector<char>& data) {
+    auto a = std::make_shared<Action>();
+    fc::optional<bytes> auth, auth_seq;
+    fc::optional<string> console;
+    unpack_all(data, a->global_seq_, a->account_seq_, a->parent_seq_, a->account_, a->name_, auth, a->data_, a->receiver_,
+               auth_seq, a->code_seq_, a->abi_seq_, a->tx_id_, console);
+    a->auth_ = from_optional(auth);
+    a->auth_seq_ = from_optional(auth_seq);
+    a->console_ = from_optional(console);
+    return a;
+}
+
 TransactionStatus transactionStatus(fc::enum_type<uint8_t, chain::transaction_receipt::status_enum> status) {
     if (status == chain::transaction_receipt::executed) return TransactionStatus::executed;
     else if (status == chain::transaction_receipt::soft_fail) return TransactionStatus::soft_fail;
@@ -187,7 +306,7 @@ void mysql_db_plugin_impl::push_block(const chain::block_state_ptr& block_state)
         b->context_free_action_count_ += count.second;
     }
 
-    block_queue_.push(b);
+    block_queue_.push(0, b);
 }
 
 std::pair<uint32_t, uint32_t> mysql_db_plugin_impl::push_transaction(const chain::transaction_receipt& tx_receipt, const BlockPtr& block, const uint16_t block_seq) {
@@ -208,7 +327,7 @@ std::pair<uint32_t, uint32_t> mysql_db_plugin_impl::push_transaction(const chain
     t->block_num_ = block->num_;
     t->block_time_ = block->timestamp_;
     t->block_seq_ = block_seq;
-    transaction_queue_.push(t);
+    transaction_queue_.push(shard_key(t->id_), t);
     return {t->action_count_, t->context_free_action_count_};
 }
 
@@ -226,7 +345,7 @@ void mysql_db_plugin_impl::push_transaction_trace(const chain::transaction_trace
     if (tx_trace->except) {
         t->exception_ = tx_trace->except->to_string();
     }
-    transaction_trace_queue_.push(t);
+    transaction_trace_queue_.push(shard_key(t->id_), t);
 
     for (auto& action_trace: tx_trace->action_traces) {
         push_action(action_trace, 0, t); // 0 means no parent
@@ -254,7 +373,7 @@ void mysql_db_plugin_impl::push_action(const chain::action_trace& action_trace,
     if (not action_trace.console.empty()) a->console_ = action_trace.console;
     // a->total_cpu_usage_ = action_trace.total_cpu_usage;
 
-    action_queue_.push(a);
+    action_queue_.push(a->global_seq_, a);
 
     for (auto& action_handler: action_handlers_) {
         action_handler->handle(action_trace.act, a->receiver_, a->global_seq_, tx);
@@ -268,7 +387,7 @@ void mysql_db_plugin_impl::push_action(const chain::action_trace& action_trace,
 void mysql_db_plugin_impl::consume_blocks() {
     using query = odb::query<Block>;
 
-    auto blocks = block_queue_.pop();
+    auto blocks = block_queue_.shard(0).pop(batch_size_);
     if (blocks.empty()) return;
 
     unordered_map<bytes, BlockPtr> distinct_blocks_by_id;
@@ -289,24 +408,30 @@ void mysql_db_plugin_impl::consume_blocks() {
 
     odb::transaction t(db_->begin());
 
-    auto q = query::num.in_range(nums.begin(), nums.end());
-    auto result = db_->query<Block>(q);
-    for (auto it = result.begin(); it != result.end(); ++it) {
-        if (not distinct_blocks_by_id.count(it.id())) { // reversed
-            stats_->tx_count_ -= it->tx_count_;
-            stats_->action_count_ -= it->action_count_;
-            stats_->context_free_action_count_ -= it->context_free_action_count_;
-            db_->erase(*it);
-        }
-    }
-
-    q = query::id.in_range(ids.begin(), ids.end());
-    result = db_->query<Block>(q);
     unordered_set<bytes> existing_blocks_by_id;
-    for (auto it = result.begin(); it != result.end(); ++it) {
-        existing_blocks_by_id.insert(it.id());
+    auto min_max_num = std::minmax_element(nums.begin(), nums.end());
+    if (*min_max_num.first <= block_hwm_) {
+        auto by_num = make_prepared_lookup<Block, unsigned>("mysql_db_plugin.block.num", batch_size_, [](const unsigned& num) -> query {
+            return query::num == query::_ref(num);
+        });
+        by_num.each(nums, [&](odb::result<Block>::iterator& it) {
+            if (not distinct_blocks_by_id.count(it.id())) { // reversed
+                stats_->tx_count_ -= it->tx_count_;
+                stats_->action_count_ -= it->action_count_;
+                stats_->context_free_action_count_ -= it->context_free_action_count_;
+                db_->erase(*it);
+            }
+        });
+
+        auto by_id = make_prepared_lookup<Block, bytes>("mysql_db_plugin.block.id", batch_size_, [](const bytes& id) -> query {
+            return query::id == query::_ref(id);
+        });
+        by_id.each(ids, [&](odb::result<Block>::iterator& it) {
+            existing_blocks_by_id.insert(it.id());
+        });
     }
 
+    bulk_insert insert(*db_, "Block", {"id", "num", "timestamp", "block", "tx_count", "action_count", "context_free_action_count", "created_at"}, batch_size_);
     for (auto& p: distinct_blocks_by_id) {
         auto& b = p.second;
         if (existing_blocks_by_id.count(b->id_)) {
@@ -316,39 +441,51 @@ void mysql_db_plugin_impl::consume_blocks() {
             stats_->tx_count_ += b->tx_count_;
             stats_->action_count_ += b->action_count_;
             stats_->context_free_action_count_ += b->context_free_action_count_;
-            db_->persist(*b);
+            insert.row(b->id_, b->num_, b->timestamp_, b->block_, b->tx_count_, b->action_count_, b->context_free_action_count_, b->created_at_);
         }
     }
+    insert.flush();
 
     db_->update(*stats_);
 
     t.commit();
+    block_hwm_ = std::max(block_hwm_, *min_max_num.second);
 }
 
-void mysql_db_plugin_impl::consume_transactions() {
+void mysql_db_plugin_impl::consume_transactions(std::size_t shard) {
     using tx_query = odb::query<Transaction>;
 
-    auto txs = transaction_queue_.pop();
+    auto txs = transaction_queue_.shard(shard).pop(batch_size_);
     if (txs.empty()) return;
 
     unordered_map<bytes, TransactionPtr> distinct_txs;
     vector<bytes> ids;
     ids.reserve(txs.size());
+    unsigned min_block_num = std::numeric_limits<unsigned>::max(), max_block_num = 0;
     for (auto it = txs.rbegin(); it != txs.rend(); ++it) {
         auto& tx = *it;
         if (distinct_txs.count(tx->id_)) continue;
         distinct_txs[tx->id_] = tx;
         ids.push_back(tx->id_);
+        min_block_num = std::min(min_block_num, tx->block_num_);
+        max_block_num = std::max(max_block_num, tx->block_num_);
     }
 
     odb::transaction t(db_->begin());
 
-    tx_query q(tx_query::id.in_range(ids.begin(), ids.end()));
-    auto result = db_->query<Transaction>(q);
+    // above the mark, a transaction can still exist from a forked out block, so upsert rather than insert
+    auto& hwm = transaction_block_hwm_[shard];
+    bool fast = min_block_num > hwm;
     unordered_map<bytes, TransactionPtr> map;
-    for (auto it = result.begin(); it != result.end(); ++it) {
-        map[it.id()] = it.load();
+    if (not fast) {
+        auto by_id = make_prepared_lookup<Transaction, bytes>("mysql_db_plugin.transaction.id", batch_size_, [](const bytes& id) -> tx_query {
+            return tx_query::id == tx_query::_ref(id);
+        });
+        by_id.each(ids, [&](odb::result<Transaction>::iterator& it) {
+            map[it.id()] = it.load();
+        });
     }
+    bulk_insert insert(*db_, "Transaction", {"id", "block_id", "block_num", "block_time", "block_seq", "action_count", "context_free_action_count"}, batch_size_, fast);
     for (auto& p: distinct_txs) {
         auto& tx = p.second;
         if (map.count(tx->id_)) {
@@ -356,51 +493,44 @@ void mysql_db_plugin_impl::consume_transactions() {
             // transaction can be uniquely distinguish by its id, so only update it when its block has changed
             if (tx->block_id_ != old->block_id_) db_->update(*tx);
         }
-        else db_->persist(*tx);
+        else insert.row(tx->id_, tx->block_id_, tx->block_num_, tx->block_time_, tx->block_seq_, tx->action_count_, tx->context_free_action_count_);
     }
+    insert.flush();
 
     t.commit();
+    hwm = std::max(hwm, max_block_num);
 }
 
-void mysql_db_plugin_impl::consume_transaction_traces() {
+void mysql_db_plugin_impl::consume_transaction_traces(std::size_t shard) {
     using tx_query = odb::query<TransactionTrace>;
 
-    auto txs = transaction_trace_queue_.pop();
+    auto txs = transaction_trace_queue_.shard(shard).pop(batch_size_);
     if (txs.empty()) return;
 
     unordered_map<bytes, TransactionTracePtr> distinct_txs;
-    vector<bytes> ids;
-    ids.reserve(txs.size());
     for (auto it = txs.rbegin(); it != txs.rend(); ++it) {
         auto& tx = *it;
         if (distinct_txs.count(tx->id_)) continue;
         distinct_txs[tx->id_] = tx;
-        ids.push_back(tx->id_);
     }
 
     odb::transaction t(db_->begin());
 
-    tx_query q(tx_query::id.in_range(ids.begin(), ids.end()));
-    auto result = db_->query<TransactionTrace>(q);
-    unordered_set<bytes> set;
-    for (auto it = result.begin(); it != result.end(); ++it) {
-        set.insert(it.id());
-    }
+    // traces carry no block number for a mark, and new ones override old ones anyway, so upsert without lookups
+    bulk_insert insert(*db_, "TransactionTrace", {"id", "scheduled", "status", "net_usage_words", "cpu_usage_us", "exception"}, batch_size_, true);
     for (auto& p: distinct_txs) {
         auto& tx = p.second;
-        if (set.count(tx->id_)) db_->update(*tx);
-        else db_->persist(*tx);
+        insert.row(tx->id_, tx->scheduled_, tx->status_, tx->net_usage_words_, tx->cpu_usage_us_, tx->exception_);
     }
+    insert.flush();
 
     t.commit();
 }
 
-void mysql_db_plugin_impl::consume_actions() {
+void mysql_db_plugin_impl::consume_actions(std::size_t shard) {
     using action_query = odb::query<Action>;
-    using action_prepared_query = odb::prepared_query<Action>;
-    using action_result = odb::result<Action>;
 
-    auto actions = action_queue_.pop();
+    auto actions = action_queue_.shard(shard).pop(batch_size_);
     if (actions.empty()) return;
 
     unordered_map<uint64_t, ActionPtr> distinct_actions;
@@ -415,19 +545,30 @@ void mysql_db_plugin_impl::consume_actions() {
 
     odb::transaction t(db_->begin());
 
-    action_query q(action_query::global_seq.in_range(seqs.begin(), seqs.end()));
-    auto result = db_->query<Action>(q);
+    // global sequences only grow, except on forks, which restart them below the mark
+    auto& hwm = action_hwm_[shard];
+    auto min_max_seq = std::minmax_element(seqs.begin(), seqs.end());
     unordered_set<uint64_t> set;
-    for (auto it = result.begin(); it != result.end(); ++it) {
-        set.insert(it.id());
+    if (*min_max_seq.first <= hwm) {
+        auto by_seq = make_prepared_lookup<Action, uint64_t>("mysql_db_plugin.action.global_seq", batch_size_, [](const uint64_t& seq) -> action_query {
+            return action_query::global_seq == action_query::_ref(seq);
+        });
+        by_seq.each(seqs, [&](odb::result<Action>::iterator& it) {
+            set.insert(it.id());
+        });
     }
+    bulk_insert insert(*db_, "Action", {"global_seq", "account_seq", "parent_seq", "account", "name", "auth", "data", "receiver",
+                                        "auth_seq", "code_seq", "abi_seq", "tx_id", "console"}, batch_size_);
     for (auto& p: distinct_actions) {
-        auto& action = p.second;
-        if (set.count(action->global_seq_)) db_->update(*action);
-        else db_->persist(*action);
+        auto& a = p.second;
+        if (set.count(a->global_seq_)) db_->update(*a);
+        else insert.row(a->global_seq_, a->account_seq_, a->parent_seq_, a->account_, a->name_, a->auth_, a->data_, a->receiver_,
+                        a->auth_seq_, a->code_seq_, a->abi_seq_, a->tx_id_, a->console_);
     }
+    insert.flush();
 
     t.commit();
+    hwm = std::max(hwm, *min_max_seq.second);
 }
 
 void mysql_db_plugin_impl::init() {
@@ -443,6 +584,18 @@ void mysql_db_plugin_impl::init() {
         db_->persist(*stats_);
     }
 
+    using block_query = odb::query<Block>;
+    using tx_query = odb::query<Transaction>;
+    using action_query = odb::query<Action>;
+    if (auto b = db_->query_one<Block>(block_query("ORDER BY") + block_query::num + "DESC LIMIT 1")) block_hwm_ = b->num_;
+    unsigned tx_hwm{};
+    if (auto tx = db_->query_one<Transaction>(tx_query("ORDER BY") + tx_query::block_num + "DESC LIMIT 1")) tx_hwm = tx->block_num_;
+    uint64_t action_hwm{};
+    if (auto a = db_->query_one<Action>(action_query("ORDER BY") + action_query::global_seq + "DESC LIMIT 1")) action_hwm = a->global_seq_;
+    transaction_block_hwm_.assign(transaction_queue_.size(), tx_hwm);
+    action_hwm_.assign(action_queue_.size(), action_hwm);
+    ilog("mysql db high-water marks: block ${b}, transaction block ${t}, action ${a}", ("b", block_hwm_)("t", tx_hwm)("a", action_hwm));
+
     t.commit();
 }
 
@@ -469,6 +622,11 @@ void mysql_db_plugin::set_program_options(options_description&, options_descript
             ("mysql-db", bpo::value<string>()->default_value("eos"), "MySQL db name")
             ("mysql-only-irreversible", bpo::value<bool>()->default_value(false), "MySQL whether only stores irreversible blocks")
             ("mysql-start-block-num", bpo::value<unsigned>()->default_value(1), "MySQL starts syncing block number")
+            ("mysql-consumer-threads", bpo::value<unsigned>()->default_value(1), "MySQL number of consumer threads, each with its own connection, for each of transactions, transaction traces and actions")
+            ("mysql-connection-pool-size", bpo::value<unsigned>()->default_value(0), "MySQL number of connections kept open, along with the statements prepared on them; 0 for one per consumer thread and action handler, and a spare")
+            ("mysql-queue-size", bpo::value<unsigned>()->default_value(FIFO_MAX_SIZE), "MySQL capacity of each queue ahead of the consumer threads, rounded up to a power of 2")
+            ("mysql-queue-full-policy", bpo::value<string>()->default_value("block"), "MySQL what to do when a queue is full: block, which stalls the chain thread; drop, which loses the row and counts it; or spill, which appends the row to a file in the data dir, drained in order by the consumer threads")
+            ("mysql-batch-size", bpo::value<unsigned>()->default_value(FIFO_POP_SIZE), "MySQL maximum number of rows written in one transaction and one multi-row INSERT statement")
             ("mysql-filter-token-contract", boost::program_options::value<vector<string>>()->composing()->multitoken(),
              "MySQL token contract account added to token filtering list (may specify multiple times)");
 }
@@ -499,9 +657,49 @@ void mysql_db_plugin::plugin_initialize(const variables_map& options) {
     if (options.count("mysql-password")) password = options.at("mysql-password").as<std::string>();
     string db = options.at("mysql-db").as<std::string>();
     unsigned start_block_num = options.at("mysql-start-block-num").as<unsigned>();
+    my->batch_size_ = std::max(options.at("mysql-batch-size").as<unsigned>(), 1u);
     ilog("my_db_plugin connecting to ${host}:${port}", ("host", host)("port", port));
 
-    std::unique_ptr<odb::mysql::connection_factory> conn_pool = make_unique<odb::mysql::connection_pool_factory>(5, 1, true);
+    auto consumer_threads = std::max(options.at("mysql-consumer-threads").as<unsigned>(), 1u);
+    auto queue_size = options.at("mysql-queue-size").as<unsigned>();
+    my->block_queue_.resize(1, queue_size);
+    my->transaction_queue_.resize(consumer_threads, queue_size);
+    my->transaction_trace_queue_.resize(consumer_threads, queue_size);
+    my->action_queue_.resize(consumer_threads, queue_size);
+    auto depth_metric = [](const string& queue) {
+        return &chain::metrics_registry::instance().gauge("eosio_mysql_db_queue_depth",
+                                                          "rows waiting in memory for the consumer threads of mysql_db_plugin",
+                                                          {{"queue", queue}});
+    };
+    my->block_queue_.set_depth_metric(depth_metric("blocks"));
+    my->transaction_queue_.set_depth_metric(depth_metric("transactions"));
+    my->transaction_trace_queue_.set_depth_metric(depth_metric("transaction_traces"));
+    my->action_queue_.set_depth_metric(depth_metric("actions"));
+
+    auto policy = options.at("mysql-queue-full-policy").as<string>();
+    EOS_ASSERT(policy == "block" or policy == "drop" or policy == "spill", chain::plugin_config_exception, "Invalid mysql-queue-full-policy ${p}", ("p", policy));
+    if (policy == "drop") {
+        my->block_queue_.set_full_policy(fifo<BlockPtr>::full_policy::drop);
+        my->transaction_queue_.set_full_policy(fifo<TransactionPtr>::full_policy::drop);
+        my->transaction_trace_queue_.set_full_policy(fifo<TransactionTracePtr>::full_policy::drop);
+        my->action_queue_.set_full_policy(fifo<ActionPtr>::full_policy::drop);
+    } else if (policy == "spill") {
+        auto dir = app().data_dir() / "mysql-spill";
+        fc::create_directories(dir);
+        my->block_queue_.set_spill((dir / "blocks").generic_string(), pack_block, unpack_block);
+        my->transaction_queue_.set_spill((dir / "transactions").generic_string(), pack_transaction, unpack_transaction);
+        my->transaction_trace_queue_.set_spill((dir / "transaction-traces").generic_string(), pack_transaction_trace, unpack_transaction_trace);
+        my->action_queue_.set_spill((dir / "actions").generic_string(), pack_action, unpack_action);
+    }
+
+    // a connection for each consumer thread and action handler, and one spare; none of them is closed when released,
+    // which would drop the lookups prepared on it
+    unsigned min_pool_size = 3 * consumer_threads + 2;
+    auto pool_size = options.at("mysql-connection-pool-size").as<unsigned>();
+    if (pool_size == 0) pool_size = min_pool_size + 1;
+    EOS_ASSERT(pool_size >= min_pool_size, chain::plugin_config_exception,
+               "mysql-connection-pool-size ${s} is below the ${m} connections the consumer threads and action handlers hold", ("s", pool_size)("m", min_pool_size));
+    std::unique_ptr<odb::mysql::connection_factory> conn_pool = make_unique<odb::mysql::connection_pool_factory>(pool_size, pool_size, true);
     my->db_ = make_shared<odb::mysql::database>(user, password, db, host, port, nullptr, "utf8", 0, std::move(conn_pool));
 
     if (my->wipe_database_on_startup_) {
@@ -523,8 +721,10 @@ void mysql_db_plugin::plugin_initialize(const variables_map& options) {
     // add callback to chain_controller config
     my->chain_plugin_ = app().find_plugin<chain_plugin>();
     auto& chain = my->chain_plugin_->chain();
+    // the handlers only feed the queues, so they may run on the signal dispatch threads
+    my->signals_ = chain.get_signal_dispatcher().make_subscriber("mysql_db_plugin");
     if (not options.at("mysql-only-irreversible").as<bool>()) {
-        my->block_conn_ = chain.accepted_block.connect([=](const chain::block_state_ptr& b) {
+        my->block_conn_ = my->signals_->connect(chain.accepted_block, [=](const chain::block_state_ptr& b) {
             if (not my->start_sync_) {
                 if (b->block_num >= start_block_num) my->start_sync_ = true;
                 else return;
@@ -532,14 +732,14 @@ void mysql_db_plugin::plugin_initialize(const variables_map& options) {
             handle([=] { my->push_block(b); }, "push block");
         });
     }
-    my->irreversible_block_conn_ = chain.irreversible_block.connect([=](const chain::block_state_ptr& b) {
+    my->irreversible_block_conn_ = my->signals_->connect(chain.irreversible_block, [=](const chain::block_state_ptr& b) {
         if (not my->start_sync_) {
             if (b->block_num >= start_block_num) my->start_sync_ = true;
             else return;
         }
         handle([=] { my->push_block(b); }, "push irreversible block");
     });
-    my->transaction_conn_ = chain.applied_transaction.connect([=](const chain::transaction_trace_ptr& t) {
+    my->transaction_conn_ = my->signals_->connect(chain.applied_transaction, [=](const chain::transaction_trace_ptr& t) {
         if (not my->start_sync_) return;
         // if (t->failed_dtrx_trace || t->except) return; // failed transaction
         handle([=] { my->push_transaction_trace(t); }, "push transaction");
@@ -551,20 +751,30 @@ void mysql_db_plugin::plugin_startup() {
         ilog("starting mysql_db_plugin");
 
         my->consume_block_thread_ = std::thread([=] {
+            chain::thread_registry::instance().register_current_thread("mysql-db-blocks");
             loop_handle(my->done_, "consume blocks", [=] { my->consume_blocks(); });
         });
 
-        my->consume_transaction_thread_ = std::thread([=] {
-            loop_handle(my->done_, "consume transactions", [=] { my->consume_transactions(); });
-        });
+        for (std::size_t i = 0; i < my->transaction_queue_.size(); ++i) {
+            my->consume_transaction_threads_.emplace_back([=] {
+                chain::thread_registry::instance().register_current_thread("mysql-db-transactions-" + std::to_string(i));
+                loop_handle(my->done_, "consume transactions", [=] { my->consume_transactions(i); });
+            });
+        }
 
-        my->consume_transaction_trace_thread_ = std::thread([=] {
-            loop_handle(my->done_, "consume transaction traces", [=] { my->consume_transaction_traces(); });
-        });
+        for (std::size_t i = 0; i < my->transaction_trace_queue_.size(); ++i) {
+            my->consume_transaction_trace_threads_.emplace_back([=] {
+                chain::thread_registry::instance().register_current_thread("mysql-db-traces-" + std::to_string(i));
+                loop_handle(my->done_, "consume transaction traces", [=] { my->consume_transaction_traces(i); });
+            });
+        }
 
-        my->consume_action_thread_ = std::thread([=] {
-            loop_handle(my->done_, "consume actions", [=] { my->consume_actions(); });
-        });
+        for (std::size_t i = 0; i < my->action_queue_.size(); ++i) {
+            my->consume_action_threads_.emplace_back([=] {
+                chain::thread_registry::instance().register_current_thread("mysql-db-actions-" + std::to_string(i));
+                loop_handle(my->done_, "consume actions", [=] { my->consume_actions(i); });
+            });
+        }
     }
 }
 
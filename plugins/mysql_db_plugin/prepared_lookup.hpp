@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <odb/connection.hxx>
+#include <odb/database.hxx>
+#include <odb/prepared-query.hxx>
+#include <odb/transaction.hxx>
+
+namespace eosio {
+
+/**
+ * Lookup of the rows whose key is one of a batch of keys, as a query prepared once for each connection and cached
+ * on it by ODB, so MySQL doesn't parse and plan an `IN (...)` list for every batch.
+ * The statement binds a fixed number of keys, `size`: a shorter batch repeats its last key in the places left, a
+ * longer one is looked up in several rounds. `where` builds the condition on one key, by reference, such as
+ * `query::id == query::_ref(key)`. Must be used within a transaction.
+ */
+template <typename T, typename Key, typename Where>
+class prepared_lookup {
+public:
+    prepared_lookup(std::string name, std::size_t size, Where where)
+            : name_(std::move(name)), size_(std::max<std::size_t>(size, 1)), where_(where) {}
+
+    /// calls `f` with an iterator to each row found
+    template <typename F>
+    void each(const std::vector<Key>& keys, F&& f) {
+        if (keys.empty()) return;
+
+        auto& conn = odb::transaction::current().connection();
+        std::vector<Key>* params = nullptr;
+        odb::prepared_query<T> pq(conn.template lookup_query<T>(name_.c_str(), params));
+        if (not pq) {
+            std::unique_ptr<std::vector<Key>> p(new std::vector<Key>(size_)); // bound by reference, so it never grows
+            odb::query<T> q(where_(p->front()));
+            for (auto it = p->begin() + 1; it != p->end(); ++it) q = q || where_(*it);
+            pq = conn.template prepare_query<T>(name_.c_str(), q);
+            params = p.get();
+            conn.cache_query(pq, std::move(p));
+        }
+
+        for (std::size_t i = 0; i < keys.size(); i += size_) {
+            auto n = std::min(size_, keys.size() - i);
+            std::copy(keys.begin() + i, keys.begin() + i + n, params->begin());
+            std::fill(params->begin() + n, params->end(), keys[i + n - 1]);
+            auto result = pq.execute();
+            for (auto it = result.begin(); it != result.end(); ++it) f(it);
+        }
+    }
+
+private:
+    std::string name_;
+    std::size_t size_;
+    Where where_;
+};
+
+template <typename T, typename Key, typename Where>
+prepared_lookup<T, Key, Where> make_prepared_lookup(std::string name, std::size_t size, Where where) {
+    return prepared_lookup<T, Key, Where>(std::move(name), size, where);
+}
+
+}
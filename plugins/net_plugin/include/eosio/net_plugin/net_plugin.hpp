@@ -15,6 +15,10 @@ namespace eosio {
       bool              connecting = false;
       bool              syncing    = false;
       handshake_message last_handshake;
+      int64_t           round_trip_us = 0;
+      double            recv_bytes_per_sec = 0;
+      uint32_t          timeouts = 0;
+      double            score = 0; ///< what peers are chosen by for sync ranges and fetches, higher is better
    };
 
    class net_plugin : public appbase::plugin<net_plugin>
@@ -44,4 +48,4 @@ namespace eosio {
 
 }
 
-FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake)(round_trip_us)(recv_bytes_per_sec)(timeouts)(score) )
@@ -132,6 +132,57 @@ namespace eosio {
       uint32_t end_block;
    };
 
+   /**
+    * A block relayed to a peer that already knows some of its transactions: the packed_transaction of every
+    * receipt listed in elided is replaced by its id, which the peer resolves from its own local transactions.
+    */
+   struct compact_block_message {
+      signed_block     block;
+      vector<uint32_t> elided;
+   };
+
+   /// asks for the packed transactions of the receipts a peer could not resolve in a compact block
+   struct compact_block_request {
+      block_id_type    block_id;
+      vector<uint32_t> receipts;
+   };
+
+   /// the answer to a compact_block_request, in the order of its receipts; empty if the block is not known
+   struct compact_block_transactions {
+      block_id_type              block_id;
+      vector<packed_transaction> transactions;
+   };
+
+   /// a packed net_message, zlib compressed; used for sync blocks when both peers support it
+   struct compressed_message {
+      vector<char> data;
+   };
+
+   /// asks a peer for the manifest of its snapshot of the state at block_id, before fetching the snapshot in chunks
+   struct snapshot_manifest_request {
+      block_id_type block_id;
+   };
+
+   /// the size of a snapshot and the digest of each of its chunks; size is 0 if the peer serves no such snapshot
+   struct snapshot_manifest {
+      block_id_type        block_id;
+      uint64_t             size = 0;
+      uint32_t             chunk_size = 0;
+      vector<fc::sha256>   chunk_hashes;
+   };
+
+   struct snapshot_chunk_request {
+      block_id_type block_id;
+      uint32_t      index = 0;
+   };
+
+   /// the bytes of a snapshot from index * chunk_size on; empty if the peer no longer serves it
+   struct snapshot_chunk {
+      block_id_type block_id;
+      uint32_t      index = 0;
+      vector<char>  data;
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -140,7 +191,15 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,
-                                      packed_transaction>;
+                                      packed_transaction,
+                                      compact_block_message,
+                                      compact_block_request,
+                                      compact_block_transactions,
+                                      compressed_message,
+                                      snapshot_manifest_request,
+                                      snapshot_manifest,
+                                      snapshot_chunk_request,
+                                      snapshot_chunk>;
 
 } // namespace eosio
 
@@ -159,6 +218,14 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::compact_block_message, (block)(elided) )
+FC_REFLECT( eosio::compact_block_request, (block_id)(receipts) )
+FC_REFLECT( eosio::compact_block_transactions, (block_id)(transactions) )
+FC_REFLECT( eosio::compressed_message, (data) )
+FC_REFLECT( eosio::snapshot_manifest_request, (block_id) )
+FC_REFLECT( eosio::snapshot_manifest, (block_id)(size)(chunk_size)(chunk_hashes) )
+FC_REFLECT( eosio::snapshot_chunk_request, (block_id)(index) )
+FC_REFLECT( eosio::snapshot_chunk, (block_id)(index)(data) )
 
 /**
  *
@@ -0,0 +1,60 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <eosio/net_plugin/protocol.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace eosio {
+
+   /// the size of the chunks snapshots are served in, well below the largest message a peer accepts
+   constexpr uint32_t snapshot_chunk_size = 1024*1024;
+
+   /// the snapshot of the state at block_id in dir, as it is named by producer_plugin
+   fc::path snapshot_file_of( const fc::path& dir, const block_id_type& block_id );
+
+   /**
+    *  Serves the snapshots of a directory to peers, reading and hashing them on a thread of its own. The manifest of a
+    *  snapshot is computed once and kept as long as the file does not change.
+    */
+   class snapshot_server {
+      public:
+         explicit snapshot_server( const fc::path& dir );
+         ~snapshot_server();
+
+         /// next is called on the thread of the server
+         void get_manifest( const block_id_type& block_id, std::function<void(snapshot_manifest)> next );
+         void get_chunk( const block_id_type& block_id, uint32_t index, std::function<void(snapshot_chunk)> next );
+
+      private:
+         std::unique_ptr<class snapshot_server_impl> my;
+   };
+
+   struct snapshot_fetch_options {
+      block_id_type                          block_id;            ///< trusted; the snapshot must be of the state at it
+      chain_id_type                          chain_id;
+      vector<string>                         peers;               ///< host:port
+      uint32_t                               min_peers = 1;       ///< peers whose manifests must agree
+      uint16_t                               min_network_version = 0; ///< of the peers, which serve snapshots from it on
+      fc::path                               dir;                 ///< the snapshot is written to
+      fc::microseconds                       timeout;             ///< for a peer to answer a request
+      std::function<handshake_message()>     handshake;           ///< sent to every peer as it is connected
+   };
+
+   /**
+    *  Fetches the snapshot of the state at options.block_id from the peers, blocking until it is verified, and returns
+    *  the file it is in. Once min_peers peers sent the same manifest, its chunks are requested from every peer that
+    *  agrees on it and each is checked against its digest as it arrives; a peer that sends a bad chunk, disagrees or
+    *  stops answering is dropped and its chunks are requested from the others. The head of the snapshot is then
+    *  checked to be options.block_id. Throws if no min_peers peers agree or every peer that did was dropped.
+    *
+    *  A snapshot of the block already in options.dir is used as it is.
+    */
+   fc::path fetch_snapshot( const snapshot_fetch_options& options );
+
+}
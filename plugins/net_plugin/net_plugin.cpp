@@ -6,13 +6,17 @@
 
 #include <eosio/net_plugin/net_plugin.hpp>
 #include <eosio/net_plugin/protocol.hpp>
+#include <eosio/net_plugin/snapshot_sync.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
 #include <eosio/chain/plugin_interface.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <eosio/utilities/key_conversion.hpp>
 #include <eosio/chain/contract_types.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/thread_registry.hpp>
 
 #include <fc/network/message_buffer.hpp>
 #include <fc/network/ip.hpp>
@@ -27,7 +31,18 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 #include <boost/intrusive/set.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
 
 using namespace eosio::chain::plugin_interface::compat;
 
@@ -49,7 +64,9 @@ namespace eosio {
    using fc::time_point;
    using fc::time_point_sec;
    using eosio::chain::transaction_id_type;
+   using eosio::chain::plugin_interface::priority;
    namespace bip = boost::interprocess;
+   namespace bio = boost::iostreams;
 
    class connection;
 
@@ -69,7 +86,7 @@ namespace eosio {
                                 /// Expires increased while the txn is
                                 /// "in flight" to anoher peer
       packed_transaction packed_txn;
-      vector<char>    serialized_txn; /// the received raw bundle
+      std::shared_ptr<vector<char>> serialized_txn; /// the received raw bundle, shared by the write queues it is sent from
       uint32_t        block_num = 0; /// block transaction was included in
       uint32_t        true_block = 0; /// used to reset block_uum when request is 0
       uint16_t        requests = 0; /// the number of "in flight" requests for this txn
@@ -95,14 +112,17 @@ namespace eosio {
    struct by_expiry;
    struct by_block_num;
 
+   // ids are only ever looked up, never ranged over, so they are hashed: with many transactions in flight
+   // every lookup would otherwise be log n comparisons of 32 byte keys
    typedef multi_index_container<
       node_transaction_state,
       indexed_by<
-         ordered_unique<
+         hashed_unique<
             tag< by_id >,
             member < node_transaction_state,
                      transaction_id_type,
-                     &node_transaction_state::id > >,
+                     &node_transaction_state::id >,
+            std::hash<transaction_id_type> >,
          ordered_non_unique<
             tag< by_expiry >,
             member< node_transaction_state,
@@ -164,6 +184,7 @@ namespace eosio {
 
       string                        user_agent_name;
       chain_plugin*                 chain_plug = nullptr;
+      producer_plugin*              producer_plug = nullptr;
       int                           started_sessions = 0;
 
       node_transaction_index        local_txns;
@@ -171,6 +192,30 @@ namespace eosio {
       shared_ptr<tcp::resolver>     resolver;
 
       bool                          use_socket_read_watermark = false;
+      bool                          use_compact_blocks = true;
+      bool                          compress_sync_blocks = false;
+
+      /// set when snapshots are served to peers bootstrapping from one
+      unique_ptr<snapshot_server>   snapshots;
+
+      /// with net-threads > 0 connection sockets run on net_ioc, otherwise on the application io_service
+      uint16_t                      net_threads = 0;
+      unique_ptr<boost::asio::io_context> net_ioc;
+      unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> net_work;
+      vector<std::thread>           net_thread_pool;
+
+      boost::asio::io_context& net_io_service() {
+         return net_ioc ? *net_ioc : app().get_io_service();
+      }
+
+      /// runs f on the application thread, which owns the chain and every piece of peer state
+      template<typename F>
+      void on_main_thread( priority p, F&& f ) {
+         if( net_ioc )
+            chain::plugin_interface::app_post( p, std::forward<F>(f) );
+         else
+            f();
+      }
 
       channels::transaction_ack::channel_type::handle  incoming_transaction_ack_subscription;
 
@@ -185,6 +230,9 @@ namespace eosio {
 
       template<typename VerifierFunc>
       void send_all( const net_message &msg, VerifierFunc verify );
+      /// as send_all( msg, verify ) with msg already packed by create_send_buffer
+      template<typename VerifierFunc>
+      void send_all( const std::shared_ptr<vector<char>>& send_buffer, VerifierFunc verify );
 
       void accepted_block_header(const block_state_ptr&);
       void accepted_block(const block_state_ptr&);
@@ -219,7 +267,18 @@ namespace eosio {
       void handle_message( connection_ptr c, const request_message &msg);
       void handle_message( connection_ptr c, const sync_request_message &msg);
       void handle_message( connection_ptr c, const signed_block &msg);
+      void handle_message( connection_ptr c, const signed_block_ptr &msg);
       void handle_message( connection_ptr c, const packed_transaction &msg);
+      void handle_message( connection_ptr c, const compact_block_message &msg);
+      void handle_message( connection_ptr c, const compact_block_request &msg);
+      void handle_message( connection_ptr c, const compact_block_transactions &msg);
+      void handle_message( connection_ptr c, const compressed_message &msg);
+      void handle_message( connection_ptr c, const snapshot_manifest_request &msg);
+      void handle_message( connection_ptr c, const snapshot_manifest &msg);
+      void handle_message( connection_ptr c, const snapshot_chunk_request &msg);
+      void handle_message( connection_ptr c, const snapshot_chunk &msg);
+
+      void process_signed_block( connection_ptr c, const signed_block_ptr &sbp );
 
       void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
       void start_txn_timer( );
@@ -311,6 +370,8 @@ namespace eosio {
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr auto     def_snapshot_fetch_timeout = 30;
+   constexpr uint32_t def_max_snapshot_requests = 8; // of a peer being read or hashed at once
    constexpr uint32_t  def_max_just_send = 1500; // roughly 1 "mtu"
    constexpr bool     large_msg_notify = false;
 
@@ -336,8 +397,11 @@ namespace eosio {
     */
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
+   constexpr uint16_t proto_compact_blocks = 2;    // compact_block_message, compact_block_request and compact_block_transactions
+   constexpr uint16_t proto_compressed_sync = 3;   // compressed_message
+   constexpr uint16_t proto_snapshot_sync = 4;     // snapshot_manifest_request, snapshot_manifest, snapshot_chunk_request and snapshot_chunk
 
-   constexpr uint16_t net_version = proto_explicit_sync;
+   constexpr uint16_t net_version = proto_snapshot_sync;
 
    /**
     *  Index by id
@@ -366,7 +430,7 @@ namespace eosio {
    typedef multi_index_container<
       transaction_state,
       indexed_by<
-         ordered_unique< tag<by_id>, member<transaction_state, transaction_id_type, &transaction_state::id > >,
+         hashed_unique< tag<by_id>, member<transaction_state, transaction_id_type, &transaction_state::id >, std::hash<transaction_id_type> >,
          ordered_non_unique< tag< by_expiry >, member< transaction_state,fc::time_point_sec,&transaction_state::expires >>,
          ordered_non_unique<
             tag<by_block_num>,
@@ -451,6 +515,15 @@ namespace eosio {
 
    struct handshake_initializer {
       static void populate(handshake_message &hello);
+      /// all but the blocks, which are only known once the chain has started
+      static void populate_identity(handshake_message &hello);
+   };
+
+   /// a message unpacked from the network; a signed_block is kept in block rather than copied into msg
+   struct received_message {
+      net_message      msg;
+      signed_block_ptr block;
+      uint32_t         size = 0; ///< bytes the message took on the wire
    };
 
    class connection : public std::enable_shared_from_this<connection> {
@@ -465,10 +538,15 @@ namespace eosio {
       transaction_state_index trx_state;
       optional<sync_state>    peer_requested;  // this peer is requesting info from us
       socket_ptr              socket;
+      /// serializes socket operations and the read buffers, which net threads touch
+      boost::asio::io_context::strand strand;
+      /// what the main thread knows of socket->is_open(); the socket itself belongs to the strand
+      bool                    socket_open = false;
+      tcp::endpoint           remote_endpoint;
+      tcp::endpoint           local_endpoint;
 
       fc::message_buffer<1024*1024>    pending_message_buffer;
       fc::optional<std::size_t>        outstanding_read_bytes;
-      vector<char>            blk_buffer;
 
       struct queued_write {
          std::shared_ptr<vector<char>> buff;
@@ -489,7 +567,37 @@ namespace eosio {
       go_away_reason         no_retry = no_reason;
       block_id_type          fork_head;
       uint32_t               fork_head_num = 0;
+      double                 sync_rate = 0; ///< blocks per second delivered on its last completed sync range
+      signed_block_ptr       pending_compact_block; ///< compact block waiting for the transactions requested from the peer
+      vector<uint32_t>       pending_compact_receipts;
       optional<request_message> last_req;
+      uint32_t               snapshot_requests = 0; ///< of the peer, waiting for the snapshot server
+
+      /** \name Peer Quality
+       *  Measured on the main thread, used to choose the peers sync ranges and fetches are requested from
+       *  @{
+       */
+      double                 rtt{0};              //!< rolling round trip time of time_message exchanges, in ns
+      double                 recv_rate{0};        //!< rolling bytes per second received
+      uint64_t               recv_window_bytes{0};
+      fc::time_point         recv_window_start;
+      uint32_t               timeouts{0};         //!< sync and fetch requests that timed out
+      double                 recent_timeouts{0};  //!< timeouts, decaying while the peer keeps delivering
+
+      // byte counters of the metrics registry, looked up again when peer_name() changes with the handshake
+      string                 metrics_peer;
+      chain::metric_counter* received_bytes_metric = nullptr;
+      chain::metric_counter* sent_bytes_metric = nullptr;
+      void update_metrics_peer();
+
+      void record_received( uint64_t bytes );
+      void record_sent( uint64_t bytes );
+      void record_rtt( double sample );
+      void record_timeout();
+      /** \brief Higher is better, throughput raises it while latency and recent timeouts lower it.
+       */
+      double score()const;
+      /** @} */
 
       connection_status get_status()const {
          connection_status stat;
@@ -497,6 +605,10 @@ namespace eosio {
          stat.connecting = connecting;
          stat.syncing = syncing;
          stat.last_handshake = last_handshake_recv;
+         stat.round_trip_us = static_cast<int64_t>( rtt / 1000 );
+         stat.recv_bytes_per_sec = recv_rate;
+         stat.timeouts = timeouts;
+         stat.score = score();
          return stat;
       }
 
@@ -559,6 +671,8 @@ namespace eosio {
       void stop_send();
 
       void enqueue( const net_message &msg, bool trigger_send = true );
+      /// queues a message packed by create_send_buffer, which may be shared with the write queues of other connections
+      void enqueue_buffer( const std::shared_ptr<vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send = no_reason );
       void cancel_sync(go_away_reason);
       void flush_queues();
       bool enqueue_sync_block();
@@ -575,30 +689,46 @@ namespace eosio {
                        std::function<void(boost::system::error_code, std::size_t)> callback);
       void do_queue_write();
 
-      /** \brief Process the next message from the pending message buffer
+      /** \brief Unpack the next message from the pending message buffer
        *
-       * Process the next message from the pending_message_buffer.
-       * message_length is the already determined length of the data
-       * part of the message and impl in the net plugin implementation
-       * that will handle the message.
+       * Unpack the next message from the pending_message_buffer and append
+       * it to received. message_length is the already determined length of
+       * the data part of the message. A signed_block is unpacked straight
+       * into the signed_block_ptr that is handed to the chain.
        * Returns true is successful. Returns false if an error was
-       * encountered unpacking or processing the message.
+       * encountered unpacking the message.
+       */
+      bool unpack_next_message(uint32_t message_length, vector<received_message>& received);
+
+      /**
+       * Hand the messages unpacked from one read to impl on the main thread.
+       * Their blocks all go to the controller for pre-validation before the
+       * first is applied, so that the blocks behind it are prepared on other
+       * cores.
        */
-      bool process_next_message(net_plugin_impl& impl, uint32_t message_length);
+      void dispatch_messages(net_plugin_impl& impl, vector<received_message>&& received);
 
       bool add_peer_block(const peer_block_state &pbs);
 
+      /// runs f on the strand of the socket, inline when the socket runs on the application thread
+      template<typename F>
+      void on_strand( F&& f ) {
+         if( my_impl->net_ioc )
+            strand.post( std::forward<F>(f) );
+         else
+            f();
+      }
+
       fc::optional<fc::variant_object> _logger_variant;
       const fc::variant_object& get_logger_variant()  {
          if (!_logger_variant) {
-            boost::system::error_code ec;
-            auto rep = socket->remote_endpoint(ec);
-            string ip = ec ? "<unknown>" : rep.address().to_string();
-            string port = ec ? "<unknown>" : std::to_string(rep.port());
+            bool known = remote_endpoint != tcp::endpoint();
+            string ip = known ? remote_endpoint.address().to_string() : "<unknown>";
+            string port = known ? std::to_string(remote_endpoint.port()) : "<unknown>";
 
-            auto lep = socket->local_endpoint(ec);
-            string lip = ec ? "<unknown>" : lep.address().to_string();
-            string lport = ec ? "<unknown>" : std::to_string(lep.port());
+            known = local_endpoint != tcp::endpoint();
+            string lip = known ? local_endpoint.address().to_string() : "<unknown>";
+            string lport = known ? std::to_string(local_endpoint.port()) : "<unknown>";
 
             _logger_variant.emplace(fc::mutable_variant_object()
                ("_name", peer_name())
@@ -641,12 +771,31 @@ namespace eosio {
       connection_ptr source;
       stages         state;
 
+      struct sync_range {
+         uint32_t        end = 0;
+         connection_ptr  peer;          ///< empty while the range waits for a peer
+         connection_wptr slow_peer;     ///< the peer it was taken from, only tried again when no other is idle
+         uint32_t        last_received = 0;
+         fc::time_point  requested;
+      };
+
+      /// with more than one, lib catchup requests ranges from up to that many peers at once
+      uint32_t                         sync_fetch_peers;
+      std::map<uint32_t, sync_range>   sync_ranges;       ///< by first block still to be received
+      std::map<uint32_t, std::pair<connection_ptr, signed_block_ptr>> sync_early_blocks; ///< received ahead of sync_next_expected_num
+
       chain_plugin* chain_plug = nullptr;
 
       constexpr auto stage_str(stages s );
 
+      bool parallel()const { return sync_fetch_peers > 1; }
+      void request_parallel_chunks();
+      void assign_range(uint32_t start, sync_range& r, connection_ptr c);
+      void release_range(std::map<uint32_t, sync_range>::iterator itr);
+      bool release_ranges(connection_ptr c);
+
    public:
-      explicit sync_manager(uint32_t span);
+      explicit sync_manager(uint32_t span, uint32_t fetch_peers = 1);
       void set_state(stages s);
       bool sync_required();
       void send_handshakes();
@@ -660,6 +809,14 @@ namespace eosio {
       void recv_block(connection_ptr c, const block_id_type &blk_id, uint32_t blk_num);
       void recv_handshake(connection_ptr c, const handshake_message& msg);
       void recv_notice(connection_ptr c, const notice_message& msg);
+
+      /**
+       * In parallel lib catchup, keeps track of the range blk belongs to and holds it back when it arrived ahead
+       * of the next block to apply. Returns false when blk should be applied now.
+       */
+      bool stash_block(connection_ptr c, const signed_block_ptr& blk);
+      /// the block held back by stash_block that is now the next one to apply, if any
+      optional<std::pair<connection_ptr, signed_block_ptr>> next_stashed_block();
    };
 
    class dispatch_manager {
@@ -673,7 +830,7 @@ namespace eosio {
 
       void bcast_transaction (const packed_transaction& msg);
       void rejected_transaction (const transaction_id_type& msg);
-      void bcast_block (const signed_block& msg);
+      void bcast_block (const block_state_ptr& bs);
       void rejected_block (const block_id_type &id);
 
       void recv_block (connection_ptr conn, const block_id_type& msg, uint32_t bnum);
@@ -689,7 +846,8 @@ namespace eosio {
       : blk_state(),
         trx_state(),
         peer_requested(),
-        socket( std::make_shared<tcp::socket>( std::ref( app().get_io_service() ))),
+        socket( std::make_shared<tcp::socket>( std::ref( my_impl->net_io_service() ))),
+        strand( my_impl->net_io_service() ),
         node_id(),
         last_handshake_recv(),
         last_handshake_sent(),
@@ -714,6 +872,8 @@ namespace eosio {
         trx_state(),
         peer_requested(),
         socket( s ),
+        strand( my_impl->net_io_service() ),
+        socket_open( true ),
         node_id(),
         last_handshake_recv(),
         last_handshake_sent(),
@@ -742,7 +902,7 @@ namespace eosio {
    }
 
    bool connection::connected() {
-      return (socket && socket->is_open() && !connecting);
+      return (socket && socket_open && !connecting);
    }
 
    bool connection::current() {
@@ -761,7 +921,14 @@ namespace eosio {
 
    void connection::close() {
       if(socket) {
-         socket->close();
+         socket_open = false;
+         connection_ptr self = shared_from_this();
+         on_strand( [self]() {
+            boost::system::error_code ec;
+            self->socket->close( ec );
+            self->pending_message_buffer.reset();
+            self->outstanding_read_bytes.reset();
+         });
       }
       else {
          wlog("no socket to close!");
@@ -769,6 +936,8 @@ namespace eosio {
       flush_queues();
       connecting = false;
       syncing = false;
+      pending_compact_block.reset();
+      pending_compact_receipts.clear();
       if( last_req ) {
          my_impl->dispatcher->retry_fetch (shared_from_this());
       }
@@ -779,22 +948,15 @@ namespace eosio {
       my_impl->sync_master->reset_lib_num(shared_from_this());
       fc_dlog(logger, "canceling wait on ${p}", ("p",peer_name()));
       cancel_wait();
-      pending_message_buffer.reset();
    }
 
    void connection::txn_send_pending(const vector<transaction_id_type> &ids) {
+      const std::unordered_set<transaction_id_type, std::hash<transaction_id_type>> known_ids( ids.begin(), ids.end() );
       for(auto tx = my_impl->local_txns.begin(); tx != my_impl->local_txns.end(); ++tx ){
-         if(tx->serialized_txn.size() && tx->block_num == 0) {
-            bool found = false;
-            for(auto known : ids) {
-               if( known == tx->id) {
-                  found = true;
-                  break;
-               }
-            }
-            if(!found) {
+         if(tx->serialized_txn && tx->block_num == 0) {
+            if(known_ids.find(tx->id) == known_ids.end()) {
                my_impl->local_txns.modify(tx,incr_in_flight);
-               queue_write(std::make_shared<vector<char>>(tx->serialized_txn),
+               queue_write(tx->serialized_txn,
                            true,
                            [tx_id=tx->id](boost::system::error_code ec, std::size_t ) {
                               auto& local_txns = my_impl->local_txns;
@@ -813,9 +975,9 @@ namespace eosio {
    void connection::txn_send(const vector<transaction_id_type> &ids) {
       for(auto t : ids) {
          auto tx = my_impl->local_txns.get<by_id>().find(t);
-         if( tx != my_impl->local_txns.end() && tx->serialized_txn.size()) {
+         if( tx != my_impl->local_txns.end() && tx->serialized_txn) {
             my_impl->local_txns.modify( tx,incr_in_flight);
-            queue_write(std::make_shared<vector<char>>(tx->serialized_txn),
+            queue_write(tx->serialized_txn,
                         true,
                         [t](boost::system::error_code ec, std::size_t ) {
                            auto& local_txns = my_impl->local_txns;
@@ -992,7 +1154,7 @@ namespace eosio {
       if(write_queue.empty() || !out_queue.empty())
          return;
       connection_wptr c(shared_from_this());
-      if(!socket->is_open()) {
+      if(!socket_open) {
          fc_elog(logger,"socket not open to ${p}",("p",peer_name()));
          my_impl->close(c.lock());
          return;
@@ -1004,7 +1166,7 @@ namespace eosio {
          out_queue.push_back(m);
          write_queue.pop_front();
       }
-      boost::asio::async_write(*socket, bufs, [c](boost::system::error_code ec, std::size_t w) {
+      auto on_written = [c](boost::system::error_code ec, std::size_t w) {
             try {
                auto conn = c.lock();
                if(!conn)
@@ -1025,6 +1187,7 @@ namespace eosio {
                   my_impl->close(conn);
                   return;
                }
+               conn->record_sent( w );
                while (conn->out_queue.size() > 0) {
                   conn->out_queue.pop_front();
                }
@@ -1046,7 +1209,14 @@ namespace eosio {
                string pname = conn ? conn->peer_name() : "no connection name";
                elog("Exception in do_queue_write to ${p}", ("p",pname) );
             }
-         });
+         };
+      // the buffers stay alive in out_queue until on_written has run on the main thread
+      on_strand( [self = shared_from_this(), bufs = std::move( bufs ), on_written]() {
+         boost::asio::async_write( *self->socket, bufs, boost::asio::bind_executor( self->strand,
+            [on_written]( boost::system::error_code ec, std::size_t w ) {
+               my_impl->on_main_thread( priority::high, [on_written, ec, w]() { on_written( ec, w ); } );
+            } ) );
+      } );
    }
 
    void connection::cancel_sync(go_away_reason reason) {
@@ -1067,6 +1237,50 @@ namespace eosio {
       }
    }
 
+   static compressed_message compress_message( const net_message& m ) {
+      auto raw = fc::raw::pack( m );
+      compressed_message cm;
+      bio::filtering_ostream comp;
+      comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+      comp.push( bio::back_inserter( cm.data ) );
+      bio::write( comp, raw.data(), raw.size() );
+      bio::close( comp );
+      return cm;
+   }
+
+   /// stops a compressed_message from inflating beyond what an uncompressed message may be
+   struct decompression_limiter {
+      using char_type = char;
+      using category = bio::multichar_output_filter_tag;
+
+      template<typename Sink>
+      size_t write( Sink& sink, const char* s, size_t count ) {
+         EOS_ASSERT( total + count <= def_send_buffer_size*2, plugin_exception, "compressed message inflates beyond the maximum message size" );
+         total += count;
+         return bio::write( sink, s, count );
+      }
+
+      size_t total = 0;
+   };
+
+   static vector<char> decompress_message( const compressed_message& cm ) {
+      try {
+         vector<char> out;
+         bio::filtering_ostream decomp;
+         decomp.push( bio::zlib_decompressor() );
+         decomp.push( decompression_limiter() );
+         decomp.push( bio::back_inserter( out ) );
+         bio::write( decomp, cm.data.data(), cm.data.size() );
+         bio::close( decomp );
+         return out;
+      } catch( fc::exception& er ) {
+         throw;
+      } catch( ... ) {
+         fc::unhandled_exception er( FC_LOG_MESSAGE( warn, "internal decompression error"), std::current_exception() );
+         throw er;
+      }
+   }
+
    bool connection::enqueue_sync_block() {
       controller& cc = app().find_plugin<chain_plugin>()->chain();
       if (!peer_requested)
@@ -1079,7 +1293,10 @@ namespace eosio {
       try {
          signed_block_ptr sb = cc.fetch_block_by_number(num);
          if(sb) {
-            enqueue( *sb, trigger_send);
+            if( my_impl->compress_sync_blocks && protocol_version >= proto_compressed_sync )
+               enqueue( compress_message( net_message( *sb ) ), trigger_send );
+            else
+               enqueue( *sb, trigger_send);
             return true;
          }
       } catch ( ... ) {
@@ -1088,12 +1305,8 @@ namespace eosio {
       return false;
    }
 
-   void connection::enqueue( const net_message &m, bool trigger_send ) {
-      go_away_reason close_after_send = no_reason;
-      if (m.contains<go_away_message>()) {
-         close_after_send = m.get<go_away_message>().reason;
-      }
-
+   /// the wire form of m: its packed size followed by the packed message
+   static std::shared_ptr<vector<char>> create_send_buffer( const net_message& m ) {
       uint32_t payload_size = fc::raw::pack_size( m );
       char * header = reinterpret_cast<char*>(&payload_size);
       size_t header_size = sizeof(payload_size);
@@ -1104,6 +1317,81 @@ namespace eosio {
       fc::datastream<char*> ds( send_buffer->data(), buffer_size);
       ds.write( header, header_size );
       fc::raw::pack( ds, m );
+      return send_buffer;
+   }
+
+   /// the wire form of a signed_block message, around the block as its block_state packed it
+   static std::shared_ptr<vector<char>> create_block_send_buffer( const vector<char>& packed_block ) {
+      const fc::unsigned_int which( net_message::tag<signed_block>::value );
+      uint32_t payload_size = fc::raw::pack_size( which ) + packed_block.size();
+      char * header = reinterpret_cast<char*>(&payload_size);
+      size_t header_size = sizeof(payload_size);
+
+      size_t buffer_size = header_size + payload_size;
+
+      auto send_buffer = std::make_shared<vector<char>>(buffer_size);
+      fc::datastream<char*> ds( send_buffer->data(), buffer_size);
+      ds.write( header, header_size );
+      fc::raw::pack( ds, which );
+      ds.write( packed_block.data(), packed_block.size() );
+      return send_buffer;
+   }
+
+   /**
+    * Packs b as a compact_block_message for a peer that knows some of its transactions, or returns an empty
+    * pointer when the peer does not understand compact blocks or knows none of them. trx_ids holds the ids of
+    * the receipts of b, computed by the first call for the peers b is sent to.
+    */
+   static std::shared_ptr<vector<char>> create_compact_block_buffer( const connection_ptr& c, const signed_block& b,
+                                                                     vector<transaction_id_type>& trx_ids ) {
+      if( c->protocol_version < proto_compact_blocks || b.transactions.empty() )
+         return std::shared_ptr<vector<char>>();
+      if( trx_ids.empty() ) {
+         trx_ids.reserve( b.transactions.size() );
+         for( const auto& recpt : b.transactions ) {
+            trx_ids.emplace_back( recpt.trx.contains<packed_transaction>() ? recpt.trx.get<packed_transaction>().id()
+                                                                           : recpt.trx.get<transaction_id_type>() );
+         }
+      }
+
+      compact_block_message cb;
+      const auto& known = c->trx_state.get<by_id>();
+      for( uint32_t i = 0; i < b.transactions.size(); ++i ) {
+         if( !b.transactions[i].trx.contains<packed_transaction>() )
+            continue;
+         auto itr = known.find( trx_ids[i] );
+         if( itr != known.end() && itr->is_known_by_peer )
+            cb.elided.push_back( i );
+      }
+      if( cb.elided.empty() )
+         return std::shared_ptr<vector<char>>();
+
+      cb.block = signed_block( static_cast<const signed_block_header&>( b ) );
+      cb.block.block_extensions = b.block_extensions;
+      cb.block.transactions.reserve( b.transactions.size() );
+      auto next_elided = cb.elided.begin();
+      for( uint32_t i = 0; i < b.transactions.size(); ++i ) {
+         if( next_elided != cb.elided.end() && *next_elided == i ) {
+            transaction_receipt recpt( trx_ids[i] );
+            static_cast<transaction_receipt_header&>( recpt ) = b.transactions[i];
+            cb.block.transactions.emplace_back( std::move( recpt ) );
+            ++next_elided;
+         } else {
+            cb.block.transactions.emplace_back( b.transactions[i] );
+         }
+      }
+      return create_send_buffer( net_message( cb ) );
+   }
+
+   void connection::enqueue( const net_message &m, bool trigger_send ) {
+      go_away_reason close_after_send = no_reason;
+      if (m.contains<go_away_message>()) {
+         close_after_send = m.get<go_away_message>().reason;
+      }
+      enqueue_buffer( create_send_buffer( m ), trigger_send, close_after_send );
+   }
+
+   void connection::enqueue_buffer( const std::shared_ptr<vector<char>>& send_buffer, bool trigger_send, go_away_reason close_after_send ) {
       connection_wptr weak_this = shared_from_this();
       queue_write(send_buffer,trigger_send,
                   [weak_this, close_after_send](boost::system::error_code ec, std::size_t ) {
@@ -1155,6 +1443,7 @@ namespace eosio {
 
    void connection::sync_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         record_timeout();
          my_impl->sync_master->reassign_fetch (shared_from_this(),benign_other);
       }
       else if( ec == boost::asio::error::operation_aborted) {
@@ -1176,6 +1465,7 @@ namespace eosio {
 
    void connection::fetch_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         record_timeout();
          if( pending_fetch.valid() && !( pending_fetch->req_trx.empty( ) || pending_fetch->req_blocks.empty( ) ) ) {
             my_impl->dispatcher->retry_fetch (shared_from_this() );
          }
@@ -1196,10 +1486,22 @@ namespace eosio {
       sync_wait();
    }
 
-   bool connection::process_next_message(net_plugin_impl& impl, uint32_t message_length) {
+   /// unpacks the net_message at ds, whose tag is which, a signed_block straight into m.block
+   template<typename Stream>
+   static void unpack_received( Stream& ds, uint64_t which, received_message& m ) {
+      if (which == uint64_t(net_message::tag<signed_block>::value)) {
+         fc::unsigned_int block_tag;
+         fc::raw::unpack(ds, block_tag);
+         m.block = std::make_shared<signed_block>();
+         fc::raw::unpack(ds, *m.block);
+      } else {
+         fc::raw::unpack(ds, m.msg);
+      }
+   }
+
+   bool connection::unpack_next_message(uint32_t message_length, vector<received_message>& received) {
       try {
-         // If it is a signed_block, then save the raw message for the cache
-         // This must be done before we unpack the message.
+         // Peek the tag of the net_message, a signed_block or compressed_message is unpacked on its own.
          // This code is copied from fc::io::unpack(..., unsigned_int)
          auto index = pending_message_buffer.read_index();
          uint64_t which = 0; char b = 0; uint8_t by = 0;
@@ -1209,24 +1511,124 @@ namespace eosio {
             by += 7;
          } while( uint8_t(b) & 0x80 && by < 32);
 
-         if (which == uint64_t(net_message::tag<signed_block>::value)) {
-            blk_buffer.resize(message_length);
-            auto index = pending_message_buffer.read_index();
-            pending_message_buffer.peek(blk_buffer.data(), message_length, index);
-         }
          auto ds = pending_message_buffer.create_datastream();
-         net_message msg;
-         fc::raw::unpack(ds, msg);
-         msgHandler m(impl, shared_from_this() );
-         msg.visit(m);
+         received_message m;
+         if (which == uint64_t(net_message::tag<compressed_message>::value)) {
+            fc::unsigned_int compressed_tag;
+            fc::raw::unpack(ds, compressed_tag);
+            compressed_message cm;
+            fc::raw::unpack(ds, cm);
+            auto raw = decompress_message(cm);
+            fc::datastream<const char*> rds(raw.data(), raw.size());
+            fc::unsigned_int inner;
+            auto peek = rds;
+            fc::raw::unpack(peek, inner);
+            EOS_ASSERT(inner.value != net_message::tag<compressed_message>::value, plugin_exception, "nested compressed message");
+            unpack_received(rds, inner.value, m);
+         } else {
+            unpack_received(ds, which, m);
+         }
+         m.size = message_length + message_header_size;
+         received.emplace_back( std::move(m) );
       } catch(  const fc::exception& e ) {
          edump((e.to_detail_string() ));
-         impl.close( shared_from_this() );
          return false;
       }
       return true;
    }
 
+   void connection::dispatch_messages(net_plugin_impl& impl, vector<received_message>&& received) {
+      if( received.empty() )
+         return;
+      // unpacked on the strand, handled on the main thread. Only runs of transactions alone wait behind blocks, the
+      // other messages of a peer keep their order with its blocks.
+      bool only_trxs = std::all_of( received.begin(), received.end(), []( const received_message& m ) {
+         return !m.block && m.msg.contains<packed_transaction>();
+      } );
+      auto p = only_trxs ? priority::medium : priority::high;
+      impl.on_main_thread( p, [&impl, c = shared_from_this(), received = std::move( received )]() mutable {
+         try {
+            controller& cc = impl.chain_plug->chain();
+            for( const auto& m : received ) {
+               if( m.block )
+                  cc.prevalidate_block( m.block );
+            }
+         } catch( ... ) {
+         }
+
+         uint64_t bytes = 0;
+         for( const auto& m : received )
+            bytes += m.size;
+         c->record_received( bytes );
+
+         msgHandler handler( impl, c );
+         for( auto& m : received ) {
+            if( !c->socket_open )
+               return;
+            try {
+               if( m.block )
+                  impl.handle_message( c, m.block );
+               else
+                  m.msg.visit( handler );
+            } catch( const fc::exception& e ) {
+               edump((e.to_detail_string() ));
+               impl.close( c );
+               return;
+            }
+         }
+      });
+   }
+
+   void connection::update_metrics_peer() {
+      auto name = peer_name();
+      if( received_bytes_metric && name == metrics_peer )
+         return;
+      metrics_peer = name;
+      auto& registry = chain::metrics_registry::instance();
+      received_bytes_metric = &registry.counter( "eosio_net_received_bytes_total", "bytes of p2p messages received from a peer",
+                                                 {{"peer", name}} );
+      sent_bytes_metric = &registry.counter( "eosio_net_sent_bytes_total", "bytes of p2p messages written to a peer",
+                                             {{"peer", name}} );
+   }
+
+   void connection::record_sent( uint64_t bytes ) {
+      update_metrics_peer();
+      sent_bytes_metric->add( bytes );
+   }
+
+   void connection::record_received( uint64_t bytes ) {
+      update_metrics_peer();
+      received_bytes_metric->add( bytes );
+      auto now = fc::time_point::now();
+      if( recv_window_start == fc::time_point() )
+         recv_window_start = now;
+      recv_window_bytes += bytes;
+      auto elapsed = (now - recv_window_start).count();
+      if( elapsed >= 1000000 ) {
+         double rate = double( recv_window_bytes ) * 1000000 / elapsed;
+         recv_rate = recv_rate == 0 ? rate : recv_rate * 0.75 + rate * 0.25;
+         recent_timeouts *= 0.95;
+         recv_window_bytes = 0;
+         recv_window_start = now;
+      }
+   }
+
+   void connection::record_rtt( double sample ) {
+      if( sample <= 0 )
+         return;
+      rtt = rtt == 0 ? sample : rtt * 0.875 + sample * 0.125;
+   }
+
+   void connection::record_timeout() {
+      ++timeouts;
+      recent_timeouts += 1;
+   }
+
+   double connection::score()const {
+      // a peer moving 1MB/s doubles its score, 100ms of round trip or one recent timeout halve it
+      return ( 1 + recv_rate / 1000000 ) / ( ( 1 + rtt / 100000000 ) * ( 1 + recent_timeouts ) );
+   }
+
    bool connection::add_peer_block(const peer_block_state &entry) {
       auto bptr = blk_state.get<by_id>().find(entry.id);
       bool added = (bptr == blk_state.end());
@@ -1247,13 +1649,14 @@ namespace eosio {
 
    //-----------------------------------------------------------
 
-    sync_manager::sync_manager( uint32_t req_span )
+    sync_manager::sync_manager( uint32_t req_span, uint32_t fetch_peers )
       :sync_known_lib_num( 0 )
       ,sync_last_requested_num( 0 )
       ,sync_next_expected_num( 1 )
       ,sync_req_span( req_span )
       ,source()
       ,state(in_sync)
+      ,sync_fetch_peers( std::max<uint32_t>( fetch_peers, 1 ) )
    {
       chain_plug = app( ).find_plugin<chain_plugin>( );
       EOS_ASSERT( chain_plug, chain::missing_chain_plugin_exception, ""  );
@@ -1274,6 +1677,10 @@ namespace eosio {
       }
       fc_dlog(logger, "old state ${os} becoming ${ns}",("os",stage_str (state))("ns",stage_str (newstate)));
       state = newstate;
+      if (state == in_sync) {
+         sync_ranges.clear();
+         sync_early_blocks.clear();
+      }
    }
 
    bool sync_manager::is_active(connection_ptr c) {
@@ -1294,6 +1701,9 @@ namespace eosio {
          if( c->last_handshake_recv.last_irreversible_block_num > sync_known_lib_num) {
             sync_known_lib_num =c->last_handshake_recv.last_irreversible_block_num;
          }
+      } else if( parallel() ) {
+         if( release_ranges( c ) )
+            request_next_chunk();
       } else if( c == source ) {
          sync_last_requested_num = 0;
          request_next_chunk();
@@ -1309,6 +1719,11 @@ namespace eosio {
    }
 
    void sync_manager::request_next_chunk( connection_ptr conn ) {
+      if( parallel() && state == lib_catchup ) {
+         request_parallel_chunks();
+         return;
+      }
+
       uint32_t head_block = chain_plug->chain().fork_db_head_block_num();
 
       if (head_block < sync_last_requested_num && source && source->current()) {
@@ -1320,52 +1735,25 @@ namespace eosio {
       /* ----------
        * next chunk provider selection criteria
        * a provider is supplied and able to be used, use it.
-       * otherwise select the next available from the list, round-robin style.
+       * otherwise move on to the best scoring other peer that is current.
        */
 
       if (conn && conn->current() ) {
          source = conn;
       }
       else {
-         if (my_impl->connections.size() == 1) {
-            if (!source) {
-               source = *my_impl->connections.begin();
-            }
-         }
-         else {
-            // init to a linear array search
-            auto cptr = my_impl->connections.begin();
-            auto cend = my_impl->connections.end();
-            // do we remember the previous source?
-            if (source) {
-               //try to find it in the list
-               cptr = my_impl->connections.find(source);
-               cend = cptr;
-               if (cptr == my_impl->connections.end()) {
-                  //not there - must have been closed! cend is now connections.end, so just flatten the ring.
-                  source.reset();
-                  cptr = my_impl->connections.begin();
-               } else {
-                  //was found - advance the start to the next. cend is the old source.
-                  if (++cptr == my_impl->connections.end() && cend != my_impl->connections.end() ) {
-                     cptr = my_impl->connections.begin();
-                  }
-               }
-            }
-
-            //scan the list of peers looking for another able to provide sync blocks.
-            auto cstart_it = cptr;
-            do {
-               //select the first one which is current and break out.
-               if((*cptr)->current()) {
-                  source = *cptr;
-                  break;
-               }
-               if(++cptr == my_impl->connections.end())
-                     cptr = my_impl->connections.begin();
-            } while(cptr != cstart_it);
-            // no need to check the result, either source advanced or the whole list was checked and the old source is reused.
+         // move on to the best scoring current peer, the previous source is only kept when no other can serve
+         connection_ptr best;
+         for( const auto& c : my_impl->connections ) {
+            if( c == source || !c->current() )
+               continue;
+            if( !best || c->score() > best->score() )
+               best = c;
          }
+         if( best )
+            source = best;
+         else if( !source && my_impl->connections.size() == 1 )
+            source = *my_impl->connections.begin();
       }
 
       // verify there is an available source
@@ -1391,6 +1779,173 @@ namespace eosio {
       }
    }
 
+   void sync_manager::assign_range( uint32_t start, sync_range& r, connection_ptr c ) {
+      fc_ilog(logger, "requesting range ${s} to ${e}, from ${n}",
+              ("n",c->peer_name())("s",start)("e",r.end));
+      r.peer = c;
+      r.last_received = start - 1;
+      r.requested = fc::time_point::now();
+      c->request_sync_blocks(start, r.end);
+   }
+
+   void sync_manager::release_range( std::map<uint32_t, sync_range>::iterator itr ) {
+      sync_range r = itr->second;
+      uint32_t start = r.last_received + 1;
+      sync_ranges.erase( itr );
+      r.slow_peer = r.peer;
+      r.peer.reset();
+      sync_ranges[start] = r;
+   }
+
+   bool sync_manager::release_ranges( connection_ptr c ) {
+      vector<std::map<uint32_t, sync_range>::iterator> held;
+      for( auto itr = sync_ranges.begin(); itr != sync_ranges.end(); ++itr ) {
+         if( itr->second.peer == c )
+            held.push_back( itr );
+      }
+      for( auto itr : held ) {
+         fc_ilog(logger, "releasing range ${s} to ${e} from ${p}",
+                 ("s",itr->second.last_received + 1)("e",itr->second.end)("p",c->peer_name()));
+         release_range( itr );
+      }
+      return !held.empty();
+   }
+
+   /* ----------
+    * Parallel lib catchup. Up to sync_fetch_peers peers each work on one range of at most sync_req_span blocks,
+    * all of them inside a window of sync_fetch_peers * sync_req_span blocks starting at sync_next_expected_num,
+    * which bounds the blocks held by stash_block. Blocks are still applied strictly in order.
+    *
+    * Ranges of peers that were lost or timed out, or that were taken from a slow peer, are handed out before new
+    * ones, to any idle peer but the one they came from. When the window is full while a peer is idle, the range
+    * holding back the window is taken from its peer if that peer delivers at less than half the rate the idle
+    * one achieved on its last range.
+    */
+   void sync_manager::request_parallel_chunks() {
+      std::set<connection_ptr> busy;
+      for( const auto& r : sync_ranges ) {
+         if( r.second.peer )
+            busy.insert( r.second.peer );
+      }
+      auto idle_peer = [&]( uint32_t start, connection_ptr avoid ) {
+         connection_ptr best, fallback;
+         for( const auto& c : my_impl->connections ) {
+            if( !c->current() || busy.count( c ) || c->last_handshake_recv.head_num < start )
+               continue;
+            if( c == avoid )
+               fallback = c;
+            else if( !best || c->score() > best->score() )
+               best = c;
+         }
+         return best ? best : fallback;
+      };
+
+      uint32_t window_end = sync_next_expected_num + sync_req_span * sync_fetch_peers - 1;
+      bool window_full = sync_last_requested_num + sync_req_span > window_end &&
+                         sync_last_requested_num + sync_req_span < sync_known_lib_num;
+      if( window_full && busy.size() < sync_fetch_peers && !sync_ranges.empty() && sync_ranges.begin()->second.peer ) {
+         auto blocking = sync_ranges.begin();
+         auto& r = blocking->second;
+         auto fast = idle_peer( r.last_received + 1, r.peer );
+         if( fast && fast != r.peer && fast->sync_rate > 0 ) {
+            auto elapsed = (fc::time_point::now() - r.requested).count();
+            double rate = double( r.last_received + 1 - blocking->first ) * 1000000 / std::max<int64_t>( elapsed, 1 );
+            if( rate * 2 < fast->sync_rate ) {
+               fc_ilog(logger, "${p} delivers ${r} blocks/s, taking range ${s} to ${e} from it",
+                       ("p",r.peer->peer_name())("r",rate)("s",r.last_received + 1)("e",r.end));
+               r.peer->cancel_sync( benign_other );
+               busy.erase( r.peer );
+               release_range( blocking );
+            }
+         }
+      }
+
+      for( auto& r : sync_ranges ) {
+         if( r.second.peer )
+            continue;
+         auto c = idle_peer( r.first, r.second.slow_peer.lock() );
+         if( c ) {
+            assign_range( r.first, r.second, c );
+            busy.insert( c );
+         }
+      }
+
+      while( busy.size() < sync_fetch_peers && sync_last_requested_num < sync_known_lib_num ) {
+         uint32_t start = sync_last_requested_num + 1;
+         uint32_t end = start + sync_req_span - 1;
+         if( end > window_end && end < sync_known_lib_num )
+            break;
+         auto c = idle_peer( start, connection_ptr() );
+         if( !c )
+            break;
+         end = std::min( { end, sync_known_lib_num, c->last_handshake_recv.head_num } );
+         auto& r = sync_ranges[start];
+         r.end = end;
+         assign_range( start, r, c );
+         busy.insert( c );
+         sync_last_requested_num = end;
+      }
+
+      if( busy.empty() && sync_next_expected_num <= sync_known_lib_num ) {
+         elog("Unable to continue syncing at this time");
+         sync_known_lib_num = chain_plug->chain().last_irreversible_block_num();
+         sync_last_requested_num = 0;
+         set_state(in_sync); // probably not, but we can't do anything else
+      }
+   }
+
+   bool sync_manager::stash_block( connection_ptr c, const signed_block_ptr& blk ) {
+      if( !parallel() || state != lib_catchup )
+         return false;
+
+      uint32_t blk_num = blk->block_num();
+      auto itr = sync_ranges.upper_bound( blk_num );
+      bool requested = itr != sync_ranges.begin() && std::prev( itr )->second.end >= blk_num;
+      bool completed = false;
+      if( requested ) {
+         --itr;
+         auto& r = itr->second;
+         // a peer a range was taken from may still be sending it, only the current peer makes progress
+         if( r.peer == c && blk_num > r.last_received ) {
+            r.last_received = blk_num;
+            if( blk_num == r.end ) {
+               auto elapsed = (fc::time_point::now() - r.requested).count();
+               c->sync_rate = double( r.end - itr->first + 1 ) * 1000000 / std::max<int64_t>( elapsed, 1 );
+               sync_ranges.erase( itr );
+               completed = true;
+            } else {
+               c->sync_wait();
+            }
+         }
+      }
+
+      bool stashed = true;
+      if( blk_num == sync_next_expected_num ) {
+         stashed = false;
+      } else if( requested && blk_num > sync_next_expected_num ) {
+         if( sync_early_blocks.find( blk_num ) == sync_early_blocks.end() )
+            sync_early_blocks.emplace( blk_num, std::make_pair( c, blk ) );
+      } else {
+         fc_dlog(logger, "dropping block ${n} from ${p} during parallel sync, next expected is ${e}",
+                 ("n",blk_num)("p",c->peer_name())("e",sync_next_expected_num));
+      }
+
+      if( completed )
+         request_next_chunk();
+      return stashed;
+   }
+
+   optional<std::pair<connection_ptr, signed_block_ptr>> sync_manager::next_stashed_block() {
+      while( !sync_early_blocks.empty() && sync_early_blocks.begin()->first < sync_next_expected_num ) {
+         sync_early_blocks.erase( sync_early_blocks.begin() );
+      }
+      if( state != lib_catchup || sync_early_blocks.empty() || sync_early_blocks.begin()->first != sync_next_expected_num )
+         return optional<std::pair<connection_ptr, signed_block_ptr>>();
+      auto next = std::move( sync_early_blocks.begin()->second );
+      sync_early_blocks.erase( sync_early_blocks.begin() );
+      return next;
+   }
+
    void sync_manager::send_handshakes ()
    {
       for( auto &ci : my_impl->connections) {
@@ -1416,6 +1971,8 @@ namespace eosio {
       if (state == in_sync) {
          set_state(lib_catchup);
          sync_next_expected_num = chain_plug->chain().last_irreversible_block_num() + 1;
+         if( parallel() )
+            sync_last_requested_num = sync_next_expected_num - 1;
       }
 
       fc_ilog(logger, "Catching up with chain, our last req is ${cc}, theirs is ${t} peer ${p}",
@@ -1428,6 +1985,13 @@ namespace eosio {
       fc_ilog(logger, "reassign_fetch, our last req is ${cc}, next expected is ${ne} peer ${p}",
               ( "cc",sync_last_requested_num)("ne",sync_next_expected_num)("p",c->peer_name()));
 
+      if( parallel() ) {
+         if( release_ranges( c ) ) {
+            c->cancel_sync( reason );
+            request_next_chunk();
+         }
+         return;
+      }
       if (c == source) {
          c->cancel_sync (reason);
          sync_last_requested_num = 0;
@@ -1596,6 +2160,10 @@ namespace eosio {
             set_state(in_sync);
             send_handshakes();
          }
+         else if( parallel() ) {
+            // the window moved on by one block
+            request_next_chunk();
+         }
          else if (blk_num == sync_last_requested_num) {
             request_next_chunk();
          }
@@ -1608,7 +2176,8 @@ namespace eosio {
 
    //------------------------------------------------------------------------
 
-   void dispatch_manager::bcast_block (const signed_block &bsum) {
+   void dispatch_manager::bcast_block (const block_state_ptr& bs) {
+      const signed_block& bsum = *bs->block;
       std::set<connection_ptr> skips;
       auto range = received_blocks.equal_range(bsum.id());
       for (auto org = range.first; org != range.second; ++org) {
@@ -1616,9 +2185,9 @@ namespace eosio {
       }
       received_blocks.erase(range.first, range.second);
 
-      net_message msg(bsum);
-      uint32_t packsiz = fc::raw::pack_size(msg);
-      uint32_t msgsiz = packsiz + sizeof(packsiz);
+      // packed once, the same buffer is queued to every peer
+      auto send_buffer = create_block_send_buffer( *bs->packed_block() );
+      uint32_t msgsiz = send_buffer->size();
       notice_message pending_notify;
       block_id_type bid = bsum.id();
       uint32_t bnum = bsum.block_num();
@@ -1643,12 +2212,15 @@ namespace eosio {
       }
       else {
          pbstate.is_known = true;
+         vector<transaction_id_type> trx_ids;
          for (auto cp : my_impl->connections) {
             if (skips.find(cp) != skips.end() || !cp->current()) {
                continue;
             }
             cp->add_peer_block(pbstate);
-            cp->enqueue( bsum );
+            // peers that already have some of the transactions get them by id, packed for each of them
+            auto compact = my_impl->use_compact_blocks ? create_compact_block_buffer( cp, bsum, trx_ids ) : nullptr;
+            cp->enqueue_buffer( compact ? compact : send_buffer, true );
          }
       }
    }
@@ -1695,27 +2267,19 @@ namespace eosio {
          fc_dlog(logger, "found trxid in local_trxs" );
          return;
       }
-      uint32_t packsiz = 0;
-      uint32_t bufsiz = 0;
-
       time_point_sec trx_expiration = trx.expiration();
 
-      net_message msg(trx);
-      packsiz = fc::raw::pack_size(msg);
-      bufsiz = packsiz + sizeof(packsiz);
-      vector<char> buff(bufsiz);
-      fc::datastream<char*> ds( buff.data(), bufsiz);
-      ds.write( reinterpret_cast<char*>(&packsiz), sizeof(packsiz) );
-      fc::raw::pack( ds, msg );
+      auto send_buffer = create_send_buffer( net_message(trx) );
+      uint32_t bufsiz = send_buffer->size();
       node_transaction_state nts = {id,
                                     trx_expiration,
                                     trx,
-                                    std::move(buff),
+                                    send_buffer,
                                     0, 0, 0};
       my_impl->local_txns.insert(std::move(nts));
 
       if( !large_msg_notify || bufsiz <= just_send_it_max) {
-         my_impl->send_all( trx, [id, &skips, trx_expiration](connection_ptr c) -> bool {
+         my_impl->send_all( send_buffer, [id, &skips, trx_expiration](connection_ptr c) -> bool {
                if( skips.find(c) != skips.end() || c->syncing ) {
                   return false;
                }
@@ -1865,6 +2429,7 @@ namespace eosio {
                   ("b",modes_str(c->last_req->req_blocks.mode))("t",modes_str(c->last_req->req_trx.mode)));
          return;
       }
+      connection_ptr best;
       for (auto conn : my_impl->connections) {
          if (conn == c || conn->last_req) {
             continue;
@@ -1878,13 +2443,16 @@ namespace eosio {
             auto blk = conn->blk_state.get<by_id>().find(bid);
             sendit = blk != conn->blk_state.end() && blk->is_known;
          }
-         if (sendit) {
-            conn->enqueue(*c->last_req);
-            conn->fetch_wait();
-            conn->last_req = c->last_req;
-            return;
+         if (sendit && (!best || conn->score() > best->score())) {
+            best = conn;
          }
       }
+      if (best) {
+         best->enqueue(*c->last_req);
+         best->fetch_wait();
+         best->last_req = c->last_req;
+         return;
+      }
 
       // at this point no other peer has it, re-request or do nothing?
       if( c->connected() ) {
@@ -1945,11 +2513,12 @@ namespace eosio {
       auto current_endpoint = *endpoint_itr;
       ++endpoint_itr;
       c->connecting = true;
+      c->socket_open = true;
       connection_wptr weak_conn = c;
-      c->socket->async_connect( current_endpoint, [weak_conn, endpoint_itr, this] ( const boost::system::error_code& err ) {
+      auto on_connected = [weak_conn, endpoint_itr, this] ( const boost::system::error_code& err, bool is_open ) {
             auto c = weak_conn.lock();
             if (!c) return;
-            if( !err && c->socket->is_open() ) {
+            if( !err && is_open ) {
                if (start_session( c )) {
                   c->send_handshake ();
                }
@@ -1965,7 +2534,16 @@ namespace eosio {
                   my_impl->close(c);
                }
             }
-         } );
+         };
+      c->on_strand( [c, current_endpoint, on_connected, this]() {
+         c->socket->async_connect( current_endpoint, boost::asio::bind_executor( c->strand,
+            [weak_conn = connection_wptr( c ), on_connected, this]( const boost::system::error_code& err ) {
+               auto c = weak_conn.lock();
+               if (!c) return;
+               bool is_open = c->socket->is_open();
+               on_main_thread( priority::high, [on_connected, err, is_open]() { on_connected( err, is_open ); } );
+            } ) );
+      } );
    }
 
    bool net_plugin_impl::start_session( connection_ptr con ) {
@@ -1980,6 +2558,9 @@ namespace eosio {
          return false;
       }
       else {
+         con->remote_endpoint = con->socket->remote_endpoint( ec );
+         con->local_endpoint = con->socket->local_endpoint( ec );
+         con->socket_open = true;
          start_read_message( con );
          ++started_sessions;
          return true;
@@ -1991,7 +2572,7 @@ namespace eosio {
 
 
    void net_plugin_impl::start_listen_loop( ) {
-      auto socket = std::make_shared<tcp::socket>( std::ref( app().get_io_service() ) );
+      auto socket = std::make_shared<tcp::socket>( std::ref( net_io_service() ) );
       acceptor->async_accept( *socket, [socket,this]( boost::system::error_code ec ) {
             if( !ec ) {
                uint32_t visitors = 0;
@@ -2002,11 +2583,10 @@ namespace eosio {
                }
                else {
                   for (auto &conn : connections) {
-                     if(conn->socket->is_open()) {
+                     if(conn->socket_open) {
                         if (conn->peer_addr.empty()) {
                            visitors++;
-                           boost::system::error_code ec;
-                           if (paddr == conn->socket->remote_endpoint(ec).address()) {
+                           if (paddr == conn->remote_endpoint.address()) {
                               from_addr++;
                            }
                         }
@@ -2055,123 +2635,132 @@ namespace eosio {
    }
 
    void net_plugin_impl::start_read_message( connection_ptr conn ) {
-
-      try {
-         if(!conn->socket) {
+      if(!conn->socket) {
+         return;
+      }
+      conn->on_strand( [this, conn]() {
+         // runs on the connection's strand: only the socket and the read buffers may be touched here, anything
+         // else goes through on_main_thread
+         auto close_conn = [this]( connection_ptr c ) { on_main_thread( priority::high, [this, c]() { close( c ); } ); };
+         if( !conn->socket->is_open() ) {
+            // closed while the last read was handled
             return;
          }
-         connection_wptr weak_conn = conn;
-
-         std::size_t minimum_read = conn->outstanding_read_bytes ? *conn->outstanding_read_bytes : message_header_size;
+         try {
+            connection_wptr weak_conn = conn;
 
-         if (use_socket_read_watermark) {
-            const size_t max_socket_read_watermark = 4096;
-            std::size_t socket_read_watermark = std::min<std::size_t>(minimum_read, max_socket_read_watermark);
-            boost::asio::socket_base::receive_low_watermark read_watermark_opt(socket_read_watermark);
-            conn->socket->set_option(read_watermark_opt);
-         }
+            std::size_t minimum_read = conn->outstanding_read_bytes ? *conn->outstanding_read_bytes : message_header_size;
 
-         auto completion_handler = [minimum_read](boost::system::error_code ec, std::size_t bytes_transferred) -> std::size_t {
-            if (ec || bytes_transferred >= minimum_read ) {
-               return 0;
-            } else {
-               return minimum_read - bytes_transferred;
+            if (use_socket_read_watermark) {
+               const size_t max_socket_read_watermark = 4096;
+               std::size_t socket_read_watermark = std::min<std::size_t>(minimum_read, max_socket_read_watermark);
+               boost::asio::socket_base::receive_low_watermark read_watermark_opt(socket_read_watermark);
+               conn->socket->set_option(read_watermark_opt);
             }
-         };
 
-         boost::asio::async_read(*conn->socket,
-            conn->pending_message_buffer.get_buffer_sequence_for_boost_async_read(), completion_handler,
-            [this,weak_conn]( boost::system::error_code ec, std::size_t bytes_transferred ) {
-               auto conn = weak_conn.lock();
-               if (!conn) {
-                  return;
+            auto completion_handler = [minimum_read](boost::system::error_code ec, std::size_t bytes_transferred) -> std::size_t {
+               if (ec || bytes_transferred >= minimum_read ) {
+                  return 0;
+               } else {
+                  return minimum_read - bytes_transferred;
                }
+            };
 
-               conn->outstanding_read_bytes.reset();
-
-               try {
-                  if( !ec ) {
-                     if (bytes_transferred > conn->pending_message_buffer.bytes_to_write()) {
-                        elog("async_read_some callback: bytes_transfered = ${bt}, buffer.bytes_to_write = ${btw}",
-                             ("bt",bytes_transferred)("btw",conn->pending_message_buffer.bytes_to_write()));
-                     }
-                     EOS_ASSERT(bytes_transferred <= conn->pending_message_buffer.bytes_to_write(), plugin_exception, "");
-                     conn->pending_message_buffer.advance_write_ptr(bytes_transferred);
-                     while (conn->pending_message_buffer.bytes_to_read() > 0) {
-                        uint32_t bytes_in_buffer = conn->pending_message_buffer.bytes_to_read();
-
-                        if (bytes_in_buffer < message_header_size) {
-                           conn->outstanding_read_bytes.emplace(message_header_size - bytes_in_buffer);
-                           break;
-                        } else {
-                           uint32_t message_length;
-                           auto index = conn->pending_message_buffer.read_index();
-                           conn->pending_message_buffer.peek(&message_length, sizeof(message_length), index);
-                           if(message_length > def_send_buffer_size*2 || message_length == 0) {
-                              boost::system::error_code ec;
-                              elog("incoming message length unexpected (${i}), from ${p}", ("i", message_length)("p",boost::lexical_cast<std::string>(conn->socket->remote_endpoint(ec))));
-                              close(conn);
-                              return;
-                           }
+            boost::asio::async_read(*conn->socket,
+               conn->pending_message_buffer.get_buffer_sequence_for_boost_async_read(), completion_handler,
+               boost::asio::bind_executor( conn->strand,
+               [this,weak_conn,close_conn]( boost::system::error_code ec, std::size_t bytes_transferred ) {
+                  auto conn = weak_conn.lock();
+                  if (!conn) {
+                     return;
+                  }
 
-                           auto total_message_bytes = message_length + message_header_size;
+                  conn->outstanding_read_bytes.reset();
 
-                           if (bytes_in_buffer >= total_message_bytes) {
-                              conn->pending_message_buffer.advance_read_ptr(message_header_size);
-                              if (!conn->process_next_message(*this, message_length)) {
-                                 return;
-                              }
+                  try {
+                     if( !ec ) {
+                        if (bytes_transferred > conn->pending_message_buffer.bytes_to_write()) {
+                           elog("async_read_some callback: bytes_transfered = ${bt}, buffer.bytes_to_write = ${btw}",
+                                ("bt",bytes_transferred)("btw",conn->pending_message_buffer.bytes_to_write()));
+                        }
+                        EOS_ASSERT(bytes_transferred <= conn->pending_message_buffer.bytes_to_write(), plugin_exception, "");
+                        conn->pending_message_buffer.advance_write_ptr(bytes_transferred);
+                        vector<received_message> received;
+                        while (conn->pending_message_buffer.bytes_to_read() > 0) {
+                           uint32_t bytes_in_buffer = conn->pending_message_buffer.bytes_to_read();
+
+                           if (bytes_in_buffer < message_header_size) {
+                              conn->outstanding_read_bytes.emplace(message_header_size - bytes_in_buffer);
+                              break;
                            } else {
-                              auto outstanding_message_bytes = total_message_bytes - bytes_in_buffer;
-                              auto available_buffer_bytes = conn->pending_message_buffer.bytes_to_write();
-                              if (outstanding_message_bytes > available_buffer_bytes) {
-                                 conn->pending_message_buffer.add_space( outstanding_message_bytes - available_buffer_bytes );
+                              uint32_t message_length;
+                              auto index = conn->pending_message_buffer.read_index();
+                              conn->pending_message_buffer.peek(&message_length, sizeof(message_length), index);
+                              if(message_length > def_send_buffer_size*2 || message_length == 0) {
+                                 elog("incoming message length unexpected (${i}), from ${p}", ("i", message_length)("p",boost::lexical_cast<std::string>(conn->remote_endpoint)));
+                                 conn->dispatch_messages(*this, std::move(received));
+                                 close_conn(conn);
+                                 return;
                               }
 
-                              conn->outstanding_read_bytes.emplace(outstanding_message_bytes);
-                              break;
+                              auto total_message_bytes = message_length + message_header_size;
+
+                              if (bytes_in_buffer >= total_message_bytes) {
+                                 conn->pending_message_buffer.advance_read_ptr(message_header_size);
+                                 if (!conn->unpack_next_message(message_length, received)) {
+                                    conn->dispatch_messages(*this, std::move(received));
+                                    close_conn(conn);
+                                    return;
+                                 }
+                              } else {
+                                 auto outstanding_message_bytes = total_message_bytes - bytes_in_buffer;
+                                 auto available_buffer_bytes = conn->pending_message_buffer.bytes_to_write();
+                                 if (outstanding_message_bytes > available_buffer_bytes) {
+                                    conn->pending_message_buffer.add_space( outstanding_message_bytes - available_buffer_bytes );
+                                 }
+
+                                 conn->outstanding_read_bytes.emplace(outstanding_message_bytes);
+                                 break;
+                              }
                            }
                         }
-                     }
-                     start_read_message(conn);
-                  } else {
-                     auto pname = conn->peer_name();
-                     if (ec.value() != boost::asio::error::eof) {
-                        elog( "Error reading message from ${p}: ${m}",("p",pname)( "m", ec.message() ) );
+                        conn->dispatch_messages(*this, std::move(received));
+                        start_read_message(conn);
                      } else {
-                        ilog( "Peer ${p} closed connection",("p",pname) );
+                        auto remote = boost::lexical_cast<std::string>(conn->remote_endpoint);
+                        if (ec.value() != boost::asio::error::eof) {
+                           elog( "Error reading message from ${p}: ${m}",("p",remote)( "m", ec.message() ) );
+                        } else {
+                           ilog( "Peer ${p} closed connection",("p",remote) );
+                        }
+                        close_conn( conn );
                      }
-                     close( conn );
                   }
-               }
-               catch(const std::exception &ex) {
-                  string pname = conn ? conn->peer_name() : "no connection name";
-                  elog("Exception in handling read data from ${p} ${s}",("p",pname)("s",ex.what()));
-                  close( conn );
-               }
-               catch(const fc::exception &ex) {
-                  string pname = conn ? conn->peer_name() : "no connection name";
-                  elog("Exception in handling read data ${s}", ("p",pname)("s",ex.to_string()));
-                  close( conn );
-               }
-               catch (...) {
-                  string pname = conn ? conn->peer_name() : "no connection name";
-                  elog( "Undefined exception hanlding the read data from connection ${p}",( "p",pname));
-                  close( conn );
-               }
-            } );
-      } catch (...) {
-         string pname = conn ? conn->peer_name() : "no connection name";
-         elog( "Undefined exception handling reading ${p}",("p",pname) );
-         close( conn );
-      }
+                  catch(const std::exception &ex) {
+                     elog("Exception in handling read data from ${p} ${s}",("p",boost::lexical_cast<std::string>(conn->remote_endpoint))("s",ex.what()));
+                     close_conn( conn );
+                  }
+                  catch(const fc::exception &ex) {
+                     elog("Exception in handling read data from ${p} ${s}", ("p",boost::lexical_cast<std::string>(conn->remote_endpoint))("s",ex.to_string()));
+                     close_conn( conn );
+                  }
+                  catch (...) {
+                     elog( "Undefined exception hanlding the read data from connection ${p}",( "p",boost::lexical_cast<std::string>(conn->remote_endpoint)));
+                     close_conn( conn );
+                  }
+               } ) );
+         } catch (...) {
+            elog( "Undefined exception handling reading ${p}",("p",boost::lexical_cast<std::string>(conn->remote_endpoint)) );
+            close_conn( conn );
+         }
+      } );
    }
 
    size_t net_plugin_impl::count_open_sockets() const
    {
       size_t count = 0;
       for( auto &c : connections) {
-         if(c->socket->is_open())
+         if(c->socket_open)
             ++count;
       }
       return count;
@@ -2187,6 +2776,15 @@ namespace eosio {
       }
    }
 
+   template<typename VerifierFunc>
+   void net_plugin_impl::send_all( const std::shared_ptr<vector<char>>& send_buffer, VerifierFunc verify) {
+      for( auto &c : connections) {
+         if( c->current() && verify( c)) {
+            c->enqueue_buffer( send_buffer, true );
+         }
+      }
+   }
+
    bool net_plugin_impl::is_valid( const handshake_message &msg) {
       // Do some basic validation of an incoming handshake_message, so things
       // that really aren't handshake messages can be quickly discarded without
@@ -2362,6 +2960,7 @@ namespace eosio {
          }
 
       c->offset = (double(c->rec - c->org) + double(msg.xmt - c->dst)) / 2;
+      c->record_rtt( double(msg.dst - msg.org) - double(msg.xmt - msg.rec) );
       double NsecPerUsec{1000};
 
       if(logger.is_enabled(fc::log_level::all))
@@ -2477,6 +3076,144 @@ namespace eosio {
       }
    }
 
+   void net_plugin_impl::handle_message( connection_ptr c, const compact_block_message &msg) {
+      auto blk = std::make_shared<signed_block>( msg.block );
+      vector<uint32_t> missing;
+      const auto& known = local_txns.get<by_id>();
+      for( auto i : msg.elided ) {
+         if( i >= blk->transactions.size() || !blk->transactions[i].trx.contains<transaction_id_type>() ) {
+            peer_elog(c, "bad compact block: receipt ${i} is not elided", ("i", i));
+            close( c );
+            return;
+         }
+         auto& trx = blk->transactions[i].trx;
+         auto itr = known.find( trx.get<transaction_id_type>() );
+         if( itr != known.end() )
+            trx = itr->packed_txn;
+         else
+            missing.push_back( i );
+      }
+
+      if( missing.empty() ) {
+         handle_message( c, blk );
+         return;
+      }
+      peer_dlog(c, "compact block #${n} is missing ${m} of ${e} transactions",
+                ("n", blk->block_num())("m", missing.size())("e", msg.elided.size()));
+      c->pending_compact_block = blk;
+      c->pending_compact_receipts = missing;
+      c->enqueue( compact_block_request{ blk->id(), std::move( missing ) } );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const compact_block_request &msg) {
+      compact_block_transactions reply;
+      reply.block_id = msg.block_id;
+      signed_block_ptr blk;
+      try {
+         blk = chain_plug->chain().fetch_block_by_id( msg.block_id );
+      } catch( ... ) {
+      }
+      if( blk ) {
+         for( auto i : msg.receipts ) {
+            if( i >= blk->transactions.size() || !blk->transactions[i].trx.contains<packed_transaction>() ) {
+               reply.transactions.clear();
+               break;
+            }
+            reply.transactions.push_back( blk->transactions[i].trx.get<packed_transaction>() );
+         }
+      }
+      c->enqueue( reply );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const compact_block_transactions &msg) {
+      auto blk = c->pending_compact_block;
+      if( !blk || blk->id() != msg.block_id ) {
+         peer_dlog(c, "dropping transactions of compact block ${id} that is not pending", ("id", msg.block_id));
+         return;
+      }
+      auto receipts = std::move( c->pending_compact_receipts );
+      c->pending_compact_block.reset();
+      c->pending_compact_receipts.clear();
+
+      if( msg.transactions.size() != receipts.size() ) {
+         // the peer no longer has the block, ask for it in full
+         peer_dlog(c, "compact block ${id} could not be completed, requesting it", ("id", msg.block_id));
+         request_message req;
+         req.req_blocks.mode = normal;
+         req.req_blocks.ids.push_back( msg.block_id );
+         req.req_trx.mode = none;
+         c->enqueue( req );
+         return;
+      }
+      for( size_t i = 0; i < receipts.size(); ++i ) {
+         blk->transactions[receipts[i]].trx = msg.transactions[i];
+      }
+      // a transaction that does not match its id fails the transaction_mroot check of the block
+      handle_message( c, blk );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const compressed_message &msg) {
+      // unpacked as it is read, see connection::unpack_next_message
+      peer_wlog(c, "dropping a compressed message that was not unpacked");
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const snapshot_manifest_request &msg) {
+      peer_ilog(c, "received snapshot_manifest_request");
+      if( !snapshots ) {
+         snapshot_manifest none;
+         none.block_id = msg.block_id;
+         c->enqueue( none );
+         return;
+      }
+      if( c->snapshot_requests >= def_max_snapshot_requests ) {
+         peer_wlog(c, "dropping a snapshot request, ${n} are pending", ("n", c->snapshot_requests));
+         return;
+      }
+      ++c->snapshot_requests;
+      snapshots->get_manifest( msg.block_id, [weak = connection_wptr( c )]( snapshot_manifest m ) {
+         chain::plugin_interface::app_post( priority::low, [weak, m = std::move( m )]() {
+            if( auto c = weak.lock() ) {
+               --c->snapshot_requests;
+               if( c->socket_open )
+                  c->enqueue( m );
+            }
+         } );
+      } );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const snapshot_chunk_request &msg) {
+      if( !snapshots ) {
+         snapshot_chunk none;
+         none.block_id = msg.block_id;
+         none.index = msg.index;
+         c->enqueue( none );
+         return;
+      }
+      if( c->snapshot_requests >= def_max_snapshot_requests ) {
+         peer_wlog(c, "dropping a snapshot request, ${n} are pending", ("n", c->snapshot_requests));
+         return;
+      }
+      ++c->snapshot_requests;
+      snapshots->get_chunk( msg.block_id, msg.index, [weak = connection_wptr( c )]( snapshot_chunk chunk ) {
+         chain::plugin_interface::app_post( priority::low, [weak, chunk = std::move( chunk )]() {
+            if( auto c = weak.lock() ) {
+               --c->snapshot_requests;
+               if( c->socket_open )
+                  c->enqueue( chunk );
+            }
+         } );
+      } );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const snapshot_manifest &msg) {
+      // only asked for by a node fetching a snapshot before its chain starts, see fetch_snapshot
+      peer_dlog(c, "dropping a snapshot manifest that was not asked for");
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const snapshot_chunk &msg) {
+      peer_dlog(c, "dropping a snapshot chunk that was not asked for");
+   }
+
    void net_plugin_impl::handle_message( connection_ptr c, const packed_transaction &msg) {
       fc_dlog(logger, "got a packed transaction, cancel wait");
       peer_ilog(c, "received packed_transaction");
@@ -2489,12 +3226,25 @@ namespace eosio {
          fc_dlog(logger, "got a txn during sync - dropping");
          return;
       }
+      if( producer_plug ) {
+         // checked before msg.id(), which decompresses the transaction, and keyed by the socket rather than by
+         // peer_name(), which is whatever address the peer chose to advertise
+         bool known = c->remote_endpoint != tcp::endpoint();
+         if( !producer_plug->admit_peer_transaction( known ? boost::lexical_cast<std::string>( c->remote_endpoint ) : c->peer_name() ) ) {
+            peer_dlog(c, "over its transaction rate - dropping");
+            return;
+         }
+      }
       transaction_id_type tid = msg.id();
       c->cancel_wait();
       if(local_txns.get<by_id>().find(tid) != local_txns.end()) {
          fc_dlog(logger, "got a duplicate transaction - dropping");
          return;
       }
+      if( cc.is_known_unexpired_transaction( tid ) ) {
+         fc_dlog(logger, "got a transaction already in the chain - dropping");
+         return;
+      }
       dispatcher->recv_transaction(c, tid);
       chain_plug->accept_transaction(msg, [=](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
          if (result.contains<fc::exception_ptr>()) {
@@ -2515,11 +3265,27 @@ namespace eosio {
    }
 
    void net_plugin_impl::handle_message( connection_ptr c, const signed_block &msg) {
+      handle_message( c, std::make_shared<signed_block>( msg ) );
+   }
+
+   void net_plugin_impl::handle_message( connection_ptr c, const signed_block_ptr &sbp) {
+      fc_dlog(logger, "canceling wait on ${p}", ("p",c->peer_name()));
+      c->cancel_wait();
+      if( sync_master->stash_block( c, sbp ) ) {
+         return;
+      }
+      process_signed_block( c, sbp );
+      // blocks other sync peers delivered ahead of this one
+      while( auto next = sync_master->next_stashed_block() ) {
+         process_signed_block( next->first, next->second );
+      }
+   }
+
+   void net_plugin_impl::process_signed_block( connection_ptr c, const signed_block_ptr &sbp) {
+      const signed_block& msg = *sbp;
       controller &cc = chain_plug->chain();
       block_id_type blk_id = msg.id();
       uint32_t blk_num = msg.block_num();
-      fc_dlog(logger, "canceling wait on ${p}", ("p",c->peer_name()));
-      c->cancel_wait();
 
       try {
          if( cc.fetch_block_by_id(blk_id)) {
@@ -2538,7 +3304,6 @@ namespace eosio {
 
       go_away_reason reason = fatal_other;
       try {
-         signed_block_ptr sbp = std::make_shared<signed_block>(msg);
          chain_plug->accept_block(sbp); //, sync_master->is_active(c));
          reason = no_reason;
       } catch( const unlinkable_block_exception &ex) {
@@ -2614,7 +3379,7 @@ namespace eosio {
                wlog ("Peer keepalive ticked sooner than expected: ${m}", ("m", ec.message()));
             }
             for (auto &c : connections ) {
-               if (c->socket->is_open()) {
+               if (c->socket_open) {
                   c->send_time();
                }
             }
@@ -2660,7 +3425,7 @@ namespace eosio {
             start_conn_timer(std::chrono::milliseconds(1), *it); // avoid exhausting
             return;
          }
-         if( !(*it)->socket->is_open() && !(*it)->connecting) {
+         if( !(*it)->socket_open && !(*it)->connecting) {
             if( (*it)->peer_addr.length() > 0) {
                connect(*it);
             }
@@ -2675,7 +3440,7 @@ namespace eosio {
    }
 
    void net_plugin_impl::close( connection_ptr c ) {
-      if( c->peer_addr.empty( ) && c->socket->is_open() ) {
+      if( c->peer_addr.empty( ) && c->socket_open ) {
          if (num_clients == 0) {
             fc_wlog( logger, "num_clients already at 0");
          }
@@ -2692,7 +3457,7 @@ namespace eosio {
 
    void net_plugin_impl::accepted_block(const block_state_ptr& block) {
       fc_dlog(logger,"signaled, id = ${id}",("id", block->id));
-      dispatcher->bcast_block(*block->block);
+      dispatcher->bcast_block(block);
    }
 
    void net_plugin_impl::irreversible_block(const block_state_ptr&block) {
@@ -2804,28 +3569,7 @@ namespace eosio {
 
    void
    handshake_initializer::populate( handshake_message &hello) {
-      hello.network_version = net_version_base + net_version;
-      hello.chain_id = my_impl->chain_id;
-      hello.node_id = my_impl->node_id;
-      hello.key = my_impl->get_authentication_key();
-      hello.time = std::chrono::system_clock::now().time_since_epoch().count();
-      hello.token = fc::sha256::hash(hello.time);
-      hello.sig = my_impl->sign_compact(hello.key, hello.token);
-      // If we couldn't sign, don't send a token.
-      if(hello.sig == chain::signature_type())
-         hello.token = sha256();
-      hello.p2p_address = my_impl->p2p_address + " - " + hello.node_id.str().substr(0,7);
-#if defined( __APPLE__ )
-      hello.os = "osx";
-#elif defined( __linux__ )
-      hello.os = "linux";
-#elif defined( _MSC_VER )
-      hello.os = "win32";
-#else
-      hello.os = "other";
-#endif
-      hello.agent = my_impl->user_agent_name;
-
+      populate_identity( hello );
 
       controller& cc = my_impl->chain_plug->chain();
       hello.head_id = fc::sha256();
@@ -2851,6 +3595,31 @@ namespace eosio {
       }
    }
 
+   void
+   handshake_initializer::populate_identity( handshake_message &hello) {
+      hello.network_version = net_version_base + net_version;
+      hello.chain_id = my_impl->chain_id;
+      hello.node_id = my_impl->node_id;
+      hello.key = my_impl->get_authentication_key();
+      hello.time = std::chrono::system_clock::now().time_since_epoch().count();
+      hello.token = fc::sha256::hash(hello.time);
+      hello.sig = my_impl->sign_compact(hello.key, hello.token);
+      // If we couldn't sign, don't send a token.
+      if(hello.sig == chain::signature_type())
+         hello.token = sha256();
+      hello.p2p_address = my_impl->p2p_address + " - " + hello.node_id.str().substr(0,7);
+#if defined( __APPLE__ )
+      hello.os = "osx";
+#elif defined( __linux__ )
+      hello.os = "linux";
+#elif defined( _MSC_VER )
+      hello.os = "win32";
+#else
+      hello.os = "other";
+#endif
+      hello.agent = my_impl->user_agent_name;
+   }
+
    net_plugin::net_plugin()
       :my( new net_plugin_impl ) {
       my_impl = my.get();
@@ -2877,8 +3646,21 @@ namespace eosio {
          ( "network-version-match", bpo::value<bool>()->default_value(false),
            "True to require exact match of peer network version.")
          ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+         ( "sync-fetch-peers", bpo::value<uint32_t>()->default_value(1), "number of peers to retrieve chunks from at the same time while catching up to the last irreversible block. Blocks are still applied in order")
          ( "max-implicit-request", bpo::value<uint32_t>()->default_value(def_max_just_send), "maximum sizes of transaction or block messages that are sent without first sending a notice")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable expirimental socket read watermark optimization")
+         ( "use-compact-blocks", bpo::value<bool>()->default_value(true), "Relay blocks to peers that support it with the transactions they already have replaced by their ids")
+         ( "sync-compression", bpo::value<string>()->default_value("none"), "Compression of the blocks sent to syncing peers that support it. Can be 'none' or 'zlib'")
+         ( "p2p-serve-snapshots", bpo::value<bool>()->default_value(false), "Serve the snapshots in p2p-snapshots-dir to peers that bootstrap from one")
+         ( "p2p-snapshots-dir", bpo::value<boost::filesystem::path>()->default_value("snapshots"),
+           "the location of the snapshots served to peers and of a snapshot fetched from them (absolute path or relative to application data dir)")
+         ( "p2p-snapshot-sync-block-id", bpo::value<string>(),
+           "Id of an irreversible block, trusted to be on the chain, whose snapshot a node with no chain state yet fetches from its p2p-peer-address peers "
+           "and starts from, syncing only the blocks after it. The chain state itself is trusted from the peers that agree on it")
+         ( "p2p-snapshot-sync-peers", bpo::value<uint32_t>()->default_value(1),
+           "number of peers whose manifests of the snapshot fetched with p2p-snapshot-sync-block-id must agree")
+         ( "net-threads", bpo::value<uint16_t>()->default_value(0),
+           "Number of threads running the peer connections: reading, unpacking and writing messages. Messages are still handled on the main thread. 0 runs the connections on the main thread")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
            "Available Variables:\n"
@@ -2904,7 +3686,7 @@ namespace eosio {
 
          my->network_version_match = options.at( "network-version-match" ).as<bool>();
 
-         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>()));
+         my->sync_master.reset( new sync_manager( options.at( "sync-fetch-span" ).as<uint32_t>(), options.at( "sync-fetch-peers" ).as<uint32_t>()));
          my->dispatcher.reset( new dispatch_manager );
 
          my->connector_period = std::chrono::seconds( options.at( "connection-cleanup-period" ).as<int>());
@@ -2918,6 +3700,17 @@ namespace eosio {
          my->started_sessions = 0;
 
          my->use_socket_read_watermark = options.at( "use-socket-read-watermark" ).as<bool>();
+         my->use_compact_blocks = options.at( "use-compact-blocks" ).as<bool>();
+         const auto& sync_compression = options.at( "sync-compression" ).as<string>();
+         EOS_ASSERT( sync_compression == "none" || sync_compression == "zlib", plugin_config_exception,
+                     "sync-compression must be 'none' or 'zlib', not '${c}'", ("c", sync_compression) );
+         my->compress_sync_blocks = sync_compression == "zlib";
+
+         my->net_threads = options.at( "net-threads" ).as<uint16_t>();
+         if( my->net_threads > 0 ) {
+            my->net_ioc.reset( new boost::asio::io_context( my->net_threads ) );
+            my->net_work.reset( new boost::asio::executor_work_guard<boost::asio::io_context::executor_type>( my->net_ioc->get_executor() ) );
+         }
 
          my->resolver = std::make_shared<tcp::resolver>( std::ref( app().get_io_service()));
          if( options.count( "p2p-listen-endpoint" )) {
@@ -2993,16 +3786,55 @@ namespace eosio {
 
          my->chain_plug = app().find_plugin<chain_plugin>();
          EOS_ASSERT( my->chain_plug, chain::missing_chain_plugin_exception, ""  );
+         my->producer_plug = app().find_plugin<producer_plugin>();
          my->chain_id = app().get_plugin<chain_plugin>().get_chain_id();
          fc::rand_pseudo_bytes( my->node_id.data(), my->node_id.data_size());
          ilog( "my node_id is ${id}", ("id", my->node_id));
 
+         auto snapshots_dir = options.at( "p2p-snapshots-dir" ).as<boost::filesystem::path>();
+         if( snapshots_dir.is_relative() )
+            snapshots_dir = app().data_dir() / snapshots_dir;
+         if( options.at( "p2p-serve-snapshots" ).as<bool>() )
+            my->snapshots.reset( new snapshot_server( snapshots_dir ) );
+
+         if( options.count( "p2p-snapshot-sync-block-id" ) ) {
+            block_id_type block_id( options.at( "p2p-snapshot-sync-block-id" ).as<string>() );
+            if( my->chain_plug->starts_fresh() ) {
+               EOS_ASSERT( !my->supplied_peers.empty(), plugin_config_exception,
+                           "p2p-snapshot-sync-block-id requires p2p-peer-address" );
+               // the chain starts from the snapshot in plugin_startup of chain_plugin, which comes before ours
+               snapshot_fetch_options fetch;
+               fetch.block_id = block_id;
+               fetch.chain_id = my->chain_id;
+               fetch.peers = my->supplied_peers;
+               fetch.min_peers = options.at( "p2p-snapshot-sync-peers" ).as<uint32_t>();
+               fetch.min_network_version = net_version_base + proto_snapshot_sync;
+               fetch.dir = snapshots_dir;
+               fetch.timeout = fc::seconds( def_snapshot_fetch_timeout );
+               fetch.handshake = []() {
+                  handshake_message hello;
+                  handshake_initializer::populate_identity( hello );
+                  hello.generation = 1;
+                  return hello;
+               };
+               my->chain_plug->set_startup_snapshot( fetch_snapshot( fetch ) );
+            } else {
+               ilog( "chain state exists, not fetching the snapshot of block ${id}", ("id", block_id) );
+            }
+         }
+
          my->keepalive_timer.reset( new boost::asio::steady_timer( app().get_io_service()));
          my->ticker();
       } FC_LOG_AND_RETHROW()
    }
 
    void net_plugin::plugin_startup() {
+      for( uint16_t i = 0; i < my->net_threads; ++i ) {
+         my->net_thread_pool.emplace_back( [ioc = my->net_ioc.get(), i]() {
+            chain::thread_registry::instance().register_current_thread( "net-" + std::to_string( i ) );
+            ioc->run();
+         } );
+      }
       if( my->acceptor ) {
          my->acceptor->open(my->listen_endpoint.protocol());
          my->acceptor->set_option(tcp::acceptor::reuse_address(true));
@@ -3048,6 +3880,7 @@ namespace eosio {
       try {
          ilog( "shutdown.." );
          my->done = true;
+         my->snapshots.reset();
          if( my->acceptor ) {
             ilog( "close acceptor" );
             my->acceptor->close();
@@ -3060,6 +3893,15 @@ namespace eosio {
 
             my->acceptor.reset(nullptr);
          }
+         if( my->net_ioc ) {
+            ilog( "stop ${n} net threads", ("n", my->net_thread_pool.size()) );
+            my->net_work.reset();
+            my->net_ioc->stop();
+            for( auto& t : my->net_thread_pool ) {
+               t.join();
+            }
+            my->net_thread_pool.clear();
+         }
          ilog( "exit shutdown" );
       }
       FC_CAPTURE_AND_RETHROW()
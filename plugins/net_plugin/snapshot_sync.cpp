@@ -0,0 +1,545 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/net_plugin/snapshot_sync.hpp>
+#include <eosio/chain/block_state.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/snapshot.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+
+namespace eosio {
+
+   using boost::asio::ip::tcp;
+   namespace bfs = boost::filesystem;
+   using chain::plugin_exception;
+
+   /// the largest message accepted from a peer, as net_plugin does
+   constexpr uint32_t max_snapshot_message_size = 8*1024*1024;
+   /// chunks requested from a peer at once
+   constexpr uint32_t snapshot_chunk_window = 4;
+
+   fc::path snapshot_file_of( const fc::path& dir, const block_id_type& block_id ) {
+      return dir / ( "snapshot-" + block_id.str() + ".bin" );
+   }
+
+   class snapshot_server_impl {
+      public:
+         struct cached_manifest {
+            std::time_t          last_write = 0;
+            snapshot_manifest    manifest;
+         };
+
+         fc::path                                     dir;
+         boost::asio::io_context                      ioc{1};
+         boost::asio::executor_work_guard<boost::asio::io_context::executor_type>  work{ ioc.get_executor() };
+         std::thread                                  thread;
+         std::map<block_id_type, cached_manifest>     manifests; ///< only used on thread
+
+         /// nullptr if there is no snapshot of the block
+         const snapshot_manifest* manifest_of( const block_id_type& block_id ) {
+            auto file = snapshot_file_of( dir, block_id ).generic_string();
+            boost::system::error_code ec;
+            if( !bfs::is_regular_file( file, ec ) || ec ) {
+               manifests.erase( block_id );
+               return nullptr;
+            }
+            auto last_write = bfs::last_write_time( file );
+            auto size = bfs::file_size( file );
+            auto itr = manifests.find( block_id );
+            if( itr != manifests.end() && itr->second.last_write == last_write && itr->second.manifest.size == size )
+               return &itr->second.manifest;
+            manifests.erase( block_id );
+            if( size == 0 )
+               return nullptr;
+
+            snapshot_manifest m;
+            m.block_id = block_id;
+            m.size = size;
+            m.chunk_size = snapshot_chunk_size;
+            std::ifstream in( file.c_str(), std::ios::in | std::ios::binary );
+            vector<char> chunk( snapshot_chunk_size );
+            for( uint64_t pos = 0; pos < size; pos += snapshot_chunk_size ) {
+               auto n = std::min<uint64_t>( snapshot_chunk_size, size - pos );
+               in.read( chunk.data(), n );
+               EOS_ASSERT( in, plugin_exception, "unable to read ${f}", ("f", file) );
+               m.chunk_hashes.push_back( fc::sha256::hash( chunk.data(), n ) );
+            }
+            ilog( "serving snapshot ${f} of ${s} bytes to peers", ("f", file)("s", size) );
+
+            auto& cached = manifests[block_id];
+            cached.last_write = last_write;
+            cached.manifest = std::move( m );
+            return &cached.manifest;
+         }
+   };
+
+   snapshot_server::snapshot_server( const fc::path& dir )
+   :my( new snapshot_server_impl() ) {
+      my->dir = dir;
+      my->thread = std::thread( [ioc = &my->ioc]() { ioc->run(); } );
+   }
+
+   snapshot_server::~snapshot_server() {
+      my->work.reset();
+      my->ioc.stop();
+      if( my->thread.joinable() )
+         my->thread.join();
+   }
+
+   void snapshot_server::get_manifest( const block_id_type& block_id, std::function<void(snapshot_manifest)> next ) {
+      boost::asio::post( my->ioc, [impl = my.get(), block_id, next = std::move( next )]() {
+         snapshot_manifest m;
+         m.block_id = block_id;
+         try {
+            if( auto cached = impl->manifest_of( block_id ) )
+               m = *cached;
+         } FC_LOG_AND_DROP()
+         next( std::move( m ) );
+      } );
+   }
+
+   void snapshot_server::get_chunk( const block_id_type& block_id, uint32_t index, std::function<void(snapshot_chunk)> next ) {
+      boost::asio::post( my->ioc, [impl = my.get(), block_id, index, next = std::move( next )]() {
+         snapshot_chunk c;
+         c.block_id = block_id;
+         c.index = index;
+         try {
+            auto m = impl->manifest_of( block_id );
+            if( m && index < m->chunk_hashes.size() ) {
+               uint64_t pos = uint64_t( index ) * m->chunk_size;
+               c.data.resize( std::min<uint64_t>( m->chunk_size, m->size - pos ) );
+               std::ifstream in( snapshot_file_of( impl->dir, block_id ).generic_string().c_str(), std::ios::in | std::ios::binary );
+               in.seekg( pos );
+               in.read( c.data.data(), c.data.size() );
+               if( !in )
+                  c.data.clear();
+            }
+         } FC_LOG_AND_DROP()
+         next( std::move( c ) );
+      } );
+   }
+
+   /// the wire form used by net_plugin: the packed size of the message followed by the packed message
+   static std::shared_ptr<vector<char>> pack_snapshot_message( const net_message& m ) {
+      uint32_t size = fc::raw::pack_size( m );
+      auto buffer = std::make_shared<vector<char>>( sizeof(size) + size );
+      fc::datastream<char*> ds( buffer->data(), buffer->size() );
+      ds.write( reinterpret_cast<const char*>( &size ), sizeof(size) );
+      fc::raw::pack( ds, m );
+      return buffer;
+   }
+
+   /// the id of the head block of the snapshot in file, which is validated on the way
+   static block_id_type snapshot_head_id( const fc::path& file ) {
+      std::ifstream in( file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      EOS_ASSERT( in, plugin_exception, "unable to open ${f}", ("f", file.generic_string()) );
+      chain::snapshot_reader_ptr reader;
+      if( in.peek() == ( chain::compressed_ostream_snapshot_writer::magic_number & 0xff ) )
+         reader = std::make_shared<chain::compressed_istream_snapshot_reader>( in );
+      else
+         reader = std::make_shared<chain::istream_snapshot_reader>( in );
+      reader->validate();
+
+      block_id_type id;
+      reader->read_section<chain::block_state>( [&id]( auto& section ) {
+         chain::block_header_state head;
+         section.read_row( head );
+         id = head.id;
+      } );
+      return id;
+   }
+
+   class snapshot_fetch;
+
+   /// a connection to one peer, only used on the thread running the fetch
+   class snapshot_fetch_peer : public std::enable_shared_from_this<snapshot_fetch_peer> {
+      public:
+         snapshot_fetch_peer( snapshot_fetch& f, boost::asio::io_context& ioc, const string& a )
+         :fetch( f ), address( a ), resolver( ioc ), socket( ioc ), timer( ioc ) {}
+
+         void start();
+         void send( const net_message& m );
+         /// tops up the chunks requested from the peer
+         void request_chunks();
+         void close( const string& why );
+
+         /// waits for an answer to what was requested last, or stops waiting if nothing is
+         void expect_answer( bool expect );
+
+         snapshot_fetch&                         fetch;
+         string                                  address;
+         tcp::resolver                           resolver;
+         tcp::socket                             socket;
+         boost::asio::steady_timer               timer;
+         std::deque<std::shared_ptr<vector<char>>>  write_queue;
+         bool                                    writing = false;
+         bool                                    closed = false;
+         bool                                    handshake_received = false;
+         fc::optional<fc::sha256>                manifest_digest;
+         std::set<uint32_t>                      requested;
+
+      private:
+         void write_next();
+         void read_next();
+         void on_message( const vector<char>& message );
+
+         std::array<char, sizeof(uint32_t)>      header;
+         vector<char>                            body;
+   };
+
+   class snapshot_fetch {
+      public:
+         explicit snapshot_fetch( const snapshot_fetch_options& o ) : options( o ) {}
+
+         const snapshot_fetch_options&                 options;
+         boost::asio::io_context                       ioc{1};
+         vector<std::shared_ptr<snapshot_fetch_peer>>  peers;
+
+         std::map<fc::sha256, std::pair<snapshot_manifest, uint32_t>>  manifests; ///< by digest, with the peers that sent it
+         fc::optional<fc::sha256>                      agreed;
+         snapshot_manifest                             manifest; ///< agreed on
+         std::deque<uint32_t>                          pending;  ///< chunks not requested from any peer
+         uint32_t                                      received = 0;
+         fc::path                                      part_file;
+         std::fstream                                  out;
+         fc::optional<string>                          failure;
+         bool                                          stopping = false;
+
+         fc::path run();
+
+         void on_handshake( const std::shared_ptr<snapshot_fetch_peer>& p, const handshake_message& msg );
+         void on_manifest( const std::shared_ptr<snapshot_fetch_peer>& p, const snapshot_manifest& m );
+         void on_chunk( const std::shared_ptr<snapshot_fetch_peer>& p, const snapshot_chunk& c );
+         void on_closed( const std::shared_ptr<snapshot_fetch_peer>& p );
+
+      private:
+         void start_download( const fc::sha256& digest );
+         void request_chunks();
+         void check_peers();
+         void finish( fc::optional<string> why ) {
+            failure = std::move( why );
+            stopping = true;
+            ioc.stop();
+         }
+   };
+
+   void snapshot_fetch_peer::start() {
+      auto colon = address.find( ':' );
+      if( colon == string::npos || colon == 0 )
+         return close( "is not a host:port" );
+      tcp::resolver::query query( tcp::v4(), address.substr( 0, colon ), address.substr( colon + 1 ) );
+      expect_answer( true );
+      resolver.async_resolve( query, [self = shared_from_this()]( const boost::system::error_code& ec, tcp::resolver::iterator endpoints ) {
+         if( ec )
+            return self->close( "could not be resolved: " + ec.message() );
+         boost::asio::async_connect( self->socket, endpoints,
+                                     [self]( const boost::system::error_code& ec, tcp::resolver::iterator ) {
+            if( ec )
+               return self->close( "could not be connected: " + ec.message() );
+            self->send( self->fetch.options.handshake() );
+            self->read_next();
+         } );
+      } );
+   }
+
+   void snapshot_fetch_peer::send( const net_message& m ) {
+      if( closed )
+         return;
+      write_queue.push_back( pack_snapshot_message( m ) );
+      if( !writing )
+         write_next();
+   }
+
+   void snapshot_fetch_peer::write_next() {
+      writing = true;
+      boost::asio::async_write( socket, boost::asio::buffer( *write_queue.front() ),
+                                [self = shared_from_this()]( const boost::system::error_code& ec, size_t ) {
+         self->writing = false;
+         if( ec )
+            return self->close( "could not be written to: " + ec.message() );
+         self->write_queue.pop_front();
+         if( !self->write_queue.empty() && !self->closed )
+            self->write_next();
+      } );
+   }
+
+   void snapshot_fetch_peer::read_next() {
+      boost::asio::async_read( socket, boost::asio::buffer( header ),
+                               [self = shared_from_this()]( const boost::system::error_code& ec, size_t ) {
+         if( ec )
+            return self->close( "could not be read from: " + ec.message() );
+         uint32_t size = 0;
+         memcpy( &size, self->header.data(), sizeof(size) );
+         if( size == 0 || size > max_snapshot_message_size )
+            return self->close( "sent a message of " + std::to_string( size ) + " bytes" );
+         self->body.resize( size );
+         boost::asio::async_read( self->socket, boost::asio::buffer( self->body ),
+                                  [self]( const boost::system::error_code& ec, size_t ) {
+            if( ec )
+               return self->close( "could not be read from: " + ec.message() );
+            self->on_message( self->body );
+            if( !self->closed )
+               self->read_next();
+         } );
+      } );
+   }
+
+   void snapshot_fetch_peer::on_message( const vector<char>& message ) {
+      if( closed )
+         return;
+      try {
+         fc::datastream<const char*> ds( message.data(), message.size() );
+         auto peek = ds;
+         fc::unsigned_int which;
+         fc::raw::unpack( peek, which );
+         // the other messages, such as its time and notice messages, are of no use before the chain starts
+         if( which.value == net_message::tag<handshake_message>::value ) {
+            fetch.on_handshake( shared_from_this(), fc::raw::unpack<net_message>( ds ).get<handshake_message>() );
+         } else if( which.value == net_message::tag<snapshot_manifest>::value ) {
+            fetch.on_manifest( shared_from_this(), fc::raw::unpack<net_message>( ds ).get<snapshot_manifest>() );
+         } else if( which.value == net_message::tag<snapshot_chunk>::value ) {
+            fetch.on_chunk( shared_from_this(), fc::raw::unpack<net_message>( ds ).get<snapshot_chunk>() );
+         } else if( which.value == net_message::tag<go_away_message>::value ) {
+            close( string( "went away: " ) + reason_str( fc::raw::unpack<net_message>( ds ).get<go_away_message>().reason ) );
+         }
+      } catch( const fc::exception& e ) {
+         close( "sent a bad message: " + e.to_string() );
+      }
+   }
+
+   void snapshot_fetch_peer::expect_answer( bool expect ) {
+      timer.cancel();
+      if( !expect || closed )
+         return;
+      timer.expires_from_now( std::chrono::microseconds( fetch.options.timeout.count() ) );
+      timer.async_wait( [self = shared_from_this()]( const boost::system::error_code& ec ) {
+         if( !ec )
+            self->close( "did not answer in time" );
+      } );
+   }
+
+   void snapshot_fetch_peer::request_chunks() {
+      if( closed )
+         return;
+      while( requested.size() < snapshot_chunk_window && !fetch.pending.empty() ) {
+         snapshot_chunk_request req;
+         req.block_id = fetch.options.block_id;
+         req.index = fetch.pending.front();
+         fetch.pending.pop_front();
+         requested.insert( req.index );
+         send( req );
+      }
+      expect_answer( !requested.empty() );
+   }
+
+   void snapshot_fetch_peer::close( const string& why ) {
+      if( closed )
+         return;
+      closed = true;
+      boost::system::error_code ignored;
+      timer.cancel();
+      resolver.cancel();
+      socket.close( ignored );
+      if( !fetch.stopping ) {
+         wlog( "snapshot sync peer ${p} dropped, it ${w}", ("p", address)("w", why) );
+         fetch.on_closed( shared_from_this() );
+      }
+   }
+
+   fc::path snapshot_fetch::run() {
+      auto file = snapshot_file_of( options.dir, options.block_id );
+      if( !fc::exists( file ) ) {
+         EOS_ASSERT( options.min_peers > 0 && options.min_peers <= options.peers.size(), plugin_exception,
+                     "${n} peers cannot agree on a snapshot, ${p} are configured", ("n", options.min_peers)("p", options.peers.size()) );
+         if( !fc::is_directory( options.dir ) )
+            fc::create_directories( options.dir );
+         part_file = file.generic_string() + ".part";
+
+         ilog( "fetching the snapshot of block ${id} from ${n} peers", ("id", options.block_id)("n", options.peers.size()) );
+         for( const auto& a : options.peers )
+            peers.push_back( std::make_shared<snapshot_fetch_peer>( *this, ioc, a ) );
+         for( const auto& p : peers )
+            p->start();
+         ioc.run();
+
+         // lets the handlers still queued release their peers
+         stopping = true;
+         for( const auto& p : peers )
+            p->close( "" );
+         ioc.restart();
+         ioc.run();
+         out.close();
+
+         if( failure ) {
+            fc::remove( part_file );
+            EOS_THROW( plugin_exception, "unable to fetch the snapshot of block ${id}: ${w}",
+                       ("id", options.block_id)("w", *failure) );
+         }
+         fc::rename( part_file, file );
+      } else {
+         ilog( "using snapshot ${f} fetched or written before", ("f", file.generic_string()) );
+      }
+
+      auto head_id = snapshot_head_id( file );
+      if( head_id != options.block_id ) {
+         fc::remove( file );
+         EOS_THROW( plugin_exception, "the peers agreed on a snapshot of block ${h}, not ${id}",
+                    ("h", head_id)("id", options.block_id) );
+      }
+      return file;
+   }
+
+   void snapshot_fetch::on_handshake( const std::shared_ptr<snapshot_fetch_peer>& p, const handshake_message& msg ) {
+      if( p->handshake_received )
+         return;
+      p->handshake_received = true;
+      if( msg.chain_id != options.chain_id )
+         return p->close( "is on chain " + msg.chain_id.str() );
+      if( msg.network_version < options.min_network_version )
+         return p->close( "does not serve snapshots" );
+
+      snapshot_manifest_request req;
+      req.block_id = options.block_id;
+      p->send( req );
+      p->expect_answer( true );
+   }
+
+   void snapshot_fetch::on_manifest( const std::shared_ptr<snapshot_fetch_peer>& p, const snapshot_manifest& m ) {
+      if( p->manifest_digest )
+         return;
+      if( m.block_id != options.block_id )
+         return p->close( "sent the manifest of another snapshot" );
+      if( m.size == 0 )
+         return p->close( "has no snapshot of the block" );
+      if( m.chunk_size == 0 || m.chunk_size > snapshot_chunk_size * 4 ||
+          m.chunk_hashes.size() != ( m.size + m.chunk_size - 1 ) / m.chunk_size )
+         return p->close( "sent an inconsistent manifest" );
+
+      auto digest = fc::sha256::hash( m );
+      p->manifest_digest = digest;
+      p->expect_answer( false );
+      if( agreed ) {
+         if( digest != *agreed )
+            return p->close( "sent a manifest the other peers do not agree on" );
+         p->request_chunks();
+         return;
+      }
+
+      auto& votes = manifests[digest];
+      votes.first = m;
+      if( ++votes.second >= options.min_peers )
+         start_download( digest );
+      else
+         check_peers();
+   }
+
+   void snapshot_fetch::start_download( const fc::sha256& digest ) {
+      agreed = digest;
+      manifest = manifests[digest].first;
+      manifests.clear();
+      ilog( "${n} peers agree on the snapshot of block ${id}, ${s} bytes in ${c} chunks",
+            ("n", options.min_peers)("id", options.block_id)("s", manifest.size)("c", manifest.chunk_hashes.size()) );
+
+      std::ofstream( part_file.generic_string().c_str(), std::ios::out | std::ios::trunc | std::ios::binary );
+      bfs::resize_file( part_file.generic_string(), manifest.size );
+      out.open( part_file.generic_string().c_str(), std::ios::in | std::ios::out | std::ios::binary );
+      if( !out )
+         return finish( string( "unable to open " ) + part_file.generic_string() );
+
+      for( uint32_t i = 0; i < manifest.chunk_hashes.size(); ++i )
+         pending.push_back( i );
+      for( const auto& p : peers ) {
+         if( p->closed || !p->manifest_digest )
+            continue;
+         if( *p->manifest_digest != digest )
+            p->close( "sent a manifest the other peers do not agree on" );
+      }
+      request_chunks();
+   }
+
+   void snapshot_fetch::on_chunk( const std::shared_ptr<snapshot_fetch_peer>& p, const snapshot_chunk& c ) {
+      if( !agreed || c.block_id != options.block_id || !p->requested.erase( c.index ) )
+         return p->close( "sent a chunk it was not asked for" );
+
+      uint64_t pos = uint64_t( c.index ) * manifest.chunk_size;
+      auto expected_size = std::min<uint64_t>( manifest.chunk_size, manifest.size - pos );
+      if( c.data.size() != expected_size || fc::sha256::hash( c.data.data(), c.data.size() ) != manifest.chunk_hashes[c.index] ) {
+         pending.push_front( c.index );
+         return p->close( "sent a chunk that does not match the manifest" );
+      }
+
+      out.seekp( pos );
+      out.write( c.data.data(), c.data.size() );
+      if( !out )
+         return finish( string( "unable to write " ) + part_file.generic_string() );
+      if( ++received == manifest.chunk_hashes.size() ) {
+         out.flush();
+         ilog( "fetched the snapshot of block ${id}", ("id", options.block_id) );
+         return finish( fc::optional<string>() );
+      }
+      if( received % 100 == 0 )
+         ilog( "fetched ${r} of ${c} chunks of the snapshot", ("r", received)("c", manifest.chunk_hashes.size()) );
+      p->request_chunks();
+   }
+
+   void snapshot_fetch::on_closed( const std::shared_ptr<snapshot_fetch_peer>& p ) {
+      for( auto i : p->requested )
+         pending.push_front( i );
+      p->requested.clear();
+      if( agreed )
+         request_chunks();
+      check_peers();
+   }
+
+   void snapshot_fetch::request_chunks() {
+      for( const auto& p : peers ) {
+         if( !p->closed && p->manifest_digest && *p->manifest_digest == *agreed )
+            p->request_chunks();
+      }
+   }
+
+   void snapshot_fetch::check_peers() {
+      if( stopping )
+         return;
+      uint32_t waiting = 0, serving = 0;
+      for( const auto& p : peers ) {
+         if( p->closed )
+            continue;
+         if( !p->manifest_digest )
+            ++waiting;
+         else if( agreed && *p->manifest_digest == *agreed )
+            ++serving;
+      }
+      if( agreed && serving == 0 && waiting == 0 ) {
+         finish( "every peer serving it was dropped with " + std::to_string( received ) + " of " +
+                 std::to_string( manifest.chunk_hashes.size() ) + " chunks fetched" );
+      } else if( !agreed && waiting == 0 ) {
+         finish( "not " + std::to_string( options.min_peers ) + " peers agree on it" );
+      }
+   }
+
+   fc::path fetch_snapshot( const snapshot_fetch_options& options ) {
+      snapshot_fetch f( options );
+      return f.run();
+   }
+
+}
@@ -90,6 +90,16 @@ void producer_api_plugin::plugin_startup() {
             INVOKE_R_V(producer, get_integrity_hash), 201),
        CALL(producer, producer, create_snapshot,
             INVOKE_R_V(producer, create_snapshot), 201),
+       CALL(producer, producer, get_execution_profile,
+            INVOKE_R_R(producer, get_execution_profile, producer_plugin::execution_profile_params), 201),
+       CALL(producer, producer, get_pending_queue_stats,
+            INVOKE_R_V(producer, get_pending_queue_stats), 201),
+       CALL(producer, producer, get_block_timeline,
+            INVOKE_R_R(producer, get_block_timeline, producer_plugin::block_timeline_params), 201),
+       CALL(producer, producer, get_signing_latency,
+            INVOKE_R_V(producer, get_signing_latency), 201),
+       CALL(producer, producer, get_admission_stats,
+            INVOKE_R_V(producer, get_admission_stats), 201),
    });
 }
 
@@ -0,0 +1,148 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/transaction_metadata.hpp>
+#include <eosio/chain/plugin_interface.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace eosio {
+
+/**
+ *  Incoming transactions waiting for a pending block to be applied in.
+ *
+ *  With the fifo policy they are handed out in arrival order. With the priority policy they are handed out by
+ *  tier first and, within a tier, round robin between the accounts that sent them, so that one account flooding
+ *  the node only delays its own transactions. Both insert and pop are O(log n).
+ */
+class pending_transaction_queue {
+   public:
+      enum class policy {
+         fifo,
+         priority
+      };
+
+      enum class tier : uint8_t {
+         priority   = 0, ///< accounts configured as priority by the producer
+         normal     = 1,
+         greylisted = 2
+      };
+
+      struct entry {
+         chain::packed_transaction_ptr                                        trx;
+         chain::transaction_metadata_ptr                                      mtrx;
+         bool                                                                 persist_until_expired = false;
+         chain::plugin_interface::next_function<chain::transaction_trace_ptr> next;
+      };
+
+      struct stats {
+         uint64_t size = 0;
+         uint64_t priority = 0;
+         uint64_t normal = 0;
+         uint64_t greylisted = 0;
+         uint64_t accounts = 0;  ///< accounts with at least one transaction queued
+         uint64_t rejected = 0;  ///< transactions refused because their account was over max_per_account
+      };
+
+      explicit pending_transaction_queue( policy p = policy::fifo, uint32_t max_per_account = 0 )
+      :_policy(p), _max_per_account(max_per_account) {}
+
+      policy get_policy()const { return _policy; }
+
+      bool empty()const { return _queue.empty(); }
+      size_t size()const { return _queue.size(); }
+
+      /// false, leaving e untouched, if account already has max_per_account transactions queued
+      bool push( entry&& e, chain::account_name account, tier t ) {
+         auto& acct = _accounts[account];
+         if( _max_per_account && acct.queued >= _max_per_account ) {
+            ++_rejected;
+            return false;
+         }
+
+         uint64_t round = 0;
+         if( _policy == policy::priority ) {
+            // an account that had nothing queued joins the current round instead of catching up on the rounds it missed
+            round = std::max( acct.last_round + 1, _round[static_cast<uint8_t>(t)] );
+            acct.last_round = round;
+         } else {
+            t = tier::normal;
+         }
+         ++acct.queued;
+         ++_tier_size[static_cast<uint8_t>(t)];
+         _queue.insert( queued{ t, round, ++_sequence, account, std::move(e) } );
+         return true;
+      }
+
+      entry pop() {
+         auto itr = _queue.begin();
+         auto t = static_cast<uint8_t>(itr->t);
+         _round[t] = itr->round;
+         --_tier_size[t];
+         auto acct = _accounts.find( itr->account );
+         if( --acct->second.queued == 0 )
+            _accounts.erase( acct );
+         entry e = std::move( const_cast<entry&>( itr->e ) );
+         _queue.erase( itr );
+         return e;
+      }
+
+      stats get_stats()const {
+         stats s;
+         s.size       = _queue.size();
+         s.priority   = _tier_size[static_cast<uint8_t>(tier::priority)];
+         s.normal     = _tier_size[static_cast<uint8_t>(tier::normal)];
+         s.greylisted = _tier_size[static_cast<uint8_t>(tier::greylisted)];
+         s.accounts   = _accounts.size();
+         s.rejected   = _rejected;
+         return s;
+      }
+
+   private:
+      struct queued {
+         tier                t;
+         uint64_t            round;
+         uint64_t            sequence;
+         chain::account_name account;
+         entry               e;
+      };
+
+      struct account_state {
+         uint32_t queued = 0;
+         uint64_t last_round = 0;
+      };
+
+      typedef boost::multi_index_container<queued,
+         boost::multi_index::indexed_by<
+            boost::multi_index::ordered_unique<
+               boost::multi_index::composite_key< queued,
+                  boost::multi_index::member<queued, tier,     &queued::t>,
+                  boost::multi_index::member<queued, uint64_t, &queued::round>,
+                  boost::multi_index::member<queued, uint64_t, &queued::sequence>
+               >
+            >
+         >
+      > queue_type;
+
+      policy                                       _policy;
+      uint32_t                                     _max_per_account;
+      queue_type                                   _queue;
+      std::map<chain::account_name, account_state> _accounts;
+      uint64_t                                     _round[3] = {0, 0, 0};
+      uint64_t                                     _tier_size[3] = {0, 0, 0};
+      uint64_t                                     _sequence = 0;
+      uint64_t                                     _rejected = 0;
+};
+
+} // eosio
+
+FC_REFLECT(eosio::pending_transaction_queue::stats, (size)(priority)(normal)(greylisted)(accounts)(rejected))
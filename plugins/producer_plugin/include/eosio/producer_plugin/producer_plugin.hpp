@@ -6,6 +6,9 @@
 #pragma once
 
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/producer_plugin/pending_transaction_queue.hpp>
+#include <eosio/producer_plugin/token_bucket_limiter.hpp>
+#include <eosio/chain/execution_profiler.hpp>
 #include <eosio/http_client_plugin/http_client_plugin.hpp>
 
 #include <appbase/application.hpp>
@@ -50,6 +53,64 @@ public:
       std::string          snapshot_name;
    };
 
+   struct execution_profile_params {
+      bool reset = false; ///< clear the counters after reading them
+   };
+
+   struct execution_profile {
+      bool                                                  enabled = false;
+      std::vector<chain::execution_profiler::action_entry>  actions;
+      std::string                                           folded_stacks; ///< input for flamegraph.pl
+   };
+
+   /// where the time of one block produced by this node went, from start_block to commit_block
+   struct block_timeline {
+      struct phase {
+         int64_t  time_us = 0;
+         uint32_t applied = 0;
+         uint32_t failed = 0;
+      };
+
+      uint32_t                 block_num = 0;
+      chain::account_name      producer;
+      fc::time_point           block_time;
+      fc::time_point           start_block;   ///< when start_block began
+      fc::time_point           deadline;      ///< block time plus the configured produce or last block time offset
+      phase                    persisted;
+      phase                    unapplied;
+      phase                    scheduled;
+      phase                    incoming;      ///< pending and newly arrived incoming transactions
+      int64_t                  finalize_us = 0;
+      int64_t                  sign_us = 0;
+      int64_t                  commit_us = 0;
+      fc::time_point           produced;      ///< when commit_block returned
+      int64_t                  slack_us = 0;  ///< deadline - produced, negative when the block went out late
+      /// summed over the transactions pushed in this block, with profile-transaction-phases enabled
+      fc::optional<chain::transaction_phase_times> transaction_phases;
+   };
+
+   /// how long the signature provider of one key took to answer
+   struct signing_latency {
+      chain::public_key_type key;
+      uint64_t               calls = 0;
+      uint64_t               failures = 0;
+      uint64_t               total_us = 0;
+      uint64_t               max_us = 0;
+      /// calls that took less than 250us, 500us, 1ms, 2ms, 5ms, 10ms, 50ms, and the rest
+      std::vector<uint64_t>  histogram = std::vector<uint64_t>(8);
+   };
+
+   /// transactions let in or turned away by the per source rate limits, see the incoming-trx-rate-* options
+   struct admission_stats {
+      token_bucket_stats peers;
+      token_bucket_stats http_clients;
+      token_bucket_stats authorizers;
+   };
+
+   struct block_timeline_params {
+      uint32_t limit = 0; ///< most recent blocks to return, 0 for all that are kept
+   };
+
    producer_plugin();
    virtual ~producer_plugin();
 
@@ -82,6 +143,18 @@ public:
    integrity_hash_information get_integrity_hash() const;
    snapshot_information create_snapshot() const;
 
+   execution_profile get_execution_profile(const execution_profile_params& params) const;
+
+   pending_transaction_queue::stats get_pending_queue_stats() const;
+
+   std::vector<block_timeline> get_block_timeline(const block_timeline_params& params) const;
+
+   std::vector<signing_latency> get_signing_latency() const;
+
+   /// takes a token from the bucket of the p2p peer, false if the transaction it sent has to be dropped
+   bool admit_peer_transaction(const std::string& peer);
+   admission_stats get_admission_stats() const;
+
    signal<void(const chain::producer_confirmation&)> confirmed_block;
 private:
    std::shared_ptr<class producer_plugin_impl> my;
@@ -94,4 +167,12 @@ FC_REFLECT(eosio::producer_plugin::greylist_params, (accounts));
 FC_REFLECT(eosio::producer_plugin::whitelist_blacklist, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)(action_blacklist)(key_blacklist) )
 FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash))
 FC_REFLECT(eosio::producer_plugin::snapshot_information, (head_block_id)(snapshot_name))
+FC_REFLECT(eosio::producer_plugin::execution_profile_params, (reset))
+FC_REFLECT(eosio::producer_plugin::execution_profile, (enabled)(actions)(folded_stacks))
+FC_REFLECT(eosio::producer_plugin::block_timeline::phase, (time_us)(applied)(failed))
+FC_REFLECT(eosio::producer_plugin::block_timeline, (block_num)(producer)(block_time)(start_block)(deadline)
+           (persisted)(unapplied)(scheduled)(incoming)(finalize_us)(sign_us)(commit_us)(produced)(slack_us)(transaction_phases))
+FC_REFLECT(eosio::producer_plugin::block_timeline_params, (limit))
+FC_REFLECT(eosio::producer_plugin::signing_latency, (key)(calls)(failures)(total_us)(max_us)(histogram))
+FC_REFLECT(eosio::producer_plugin::admission_stats, (peers)(http_clients)(authorizers))
 
@@ -0,0 +1,78 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <fc/time.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace eosio {
+
+/**
+ *  Recent transaction failures per account, used to hold back retries of an account's unapplied transactions.
+ *
+ *  Once an account has failed threshold times, its retries wait for a delay that doubles with each further
+ *  failure, from one block interval up to the decay period. The failure count halves for every decay period
+ *  without a failure, so an account that stops failing is retried normally again. Successes do not reset the
+ *  count, otherwise cheap successful transactions could be interleaved with expensive failing ones.
+ */
+class subjective_failure_history {
+   public:
+      /// a threshold of 0 disables the history
+      subjective_failure_history( uint32_t threshold = 0, fc::microseconds decay = fc::minutes(1) )
+      :_threshold(threshold), _decay( std::max( decay, fc::milliseconds(chain::config::block_interval_ms) ) ) {}
+
+      void record_failure( chain::account_name account, fc::time_point now ) {
+         if( !_threshold ) return;
+         auto& e = _accounts[account];
+         e.failures = decayed( e, now ) + 1;
+         e.last_failure = now;
+         if( e.failures >= _threshold ) {
+            auto shift = std::min<uint32_t>( e.failures - _threshold, 20 );
+            auto delay = std::min( fc::microseconds( fc::milliseconds(chain::config::block_interval_ms).count() << shift ), _decay );
+            e.retry_after = now + delay;
+         }
+      }
+
+      bool should_delay( chain::account_name account, fc::time_point now )const {
+         auto itr = _accounts.find( account );
+         return itr != _accounts.end() && itr->second.retry_after > now;
+      }
+
+      /// forgets accounts that have neither a pending delay nor any failure left after decay
+      void prune( fc::time_point now ) {
+         for( auto itr = _accounts.begin(); itr != _accounts.end(); ) {
+            if( itr->second.retry_after <= now && decayed( itr->second, now ) == 0 )
+               itr = _accounts.erase( itr );
+            else
+               ++itr;
+         }
+      }
+
+      size_t size()const { return _accounts.size(); }
+
+   private:
+      struct account_failures {
+         uint32_t       failures = 0;
+         fc::time_point last_failure;
+         fc::time_point retry_after;
+      };
+
+      uint32_t decayed( const account_failures& e, fc::time_point now )const {
+         auto periods = (now - e.last_failure).count() / _decay.count();
+         if( periods <= 0 ) return e.failures;
+         return periods >= 32 ? 0 : e.failures >> periods;
+      }
+
+      uint32_t                                        _threshold;
+      fc::microseconds                                _decay;
+      std::map<chain::account_name, account_failures> _accounts;
+};
+
+} // eosio
@@ -0,0 +1,102 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace eosio {
+
+struct token_bucket_stats {
+   uint64_t admitted = 0;
+   uint64_t rejected = 0;
+   uint64_t sources  = 0; ///< keys with a bucket that is not full
+};
+
+/**
+ *  One token bucket per key, used to bound how fast a single source may hand transactions to the node.
+ *
+ *  A bucket starts full with burst tokens and refills at rate tokens per second; an acquire takes one token or is
+ *  refused. Buckets that refilled completely are forgotten, so a flood from ever changing keys only costs memory for
+ *  as long as those keys are actually sending. Acquires may come from any thread.
+ */
+template<typename Key>
+class token_bucket_limiter {
+   public:
+      /// a rate of 0 disables the limiter, a burst below 1 is raised to 1
+      void configure( double rate, double burst ) {
+         std::lock_guard<std::mutex> g( _mtx );
+         _rate  = std::max( rate, 0.0 );
+         _burst = std::max( burst, 1.0 );
+         _buckets.clear();
+      }
+
+      bool enabled()const { return _rate > 0; }
+
+      bool try_acquire( const Key& key, fc::time_point now ) {
+         if( !enabled() ) return true;
+         std::lock_guard<std::mutex> g( _mtx );
+         if( (now - _last_prune).count() > prune_interval_us ) {
+            prune( now );
+            _last_prune = now;
+         }
+
+         auto itr = _buckets.find( key );
+         if( itr == _buckets.end() )
+            itr = _buckets.emplace( key, bucket{ _burst, now } ).first;
+         auto& b = itr->second;
+         b.tokens = refilled( b, now );
+         b.last_refill = now;
+         if( b.tokens < 1.0 ) {
+            ++_rejected;
+            return false;
+         }
+         b.tokens -= 1.0;
+         ++_admitted;
+         return true;
+      }
+
+      token_bucket_stats get_stats()const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return token_bucket_stats{ _admitted, _rejected, _buckets.size() };
+      }
+
+   private:
+      static const int64_t prune_interval_us = 10000000;
+
+      struct bucket {
+         double         tokens;
+         fc::time_point last_refill;
+      };
+
+      double refilled( const bucket& b, fc::time_point now )const {
+         return std::min( _burst, b.tokens + _rate * (now - b.last_refill).count() / 1000000.0 );
+      }
+
+      void prune( fc::time_point now ) {
+         for( auto itr = _buckets.begin(); itr != _buckets.end(); ) {
+            if( refilled( itr->second, now ) >= _burst )
+               itr = _buckets.erase( itr );
+            else
+               ++itr;
+         }
+      }
+
+      mutable std::mutex     _mtx;
+      double                 _rate = 0;
+      double                 _burst = 1;
+      std::map<Key, bucket>  _buckets;
+      fc::time_point         _last_prune;
+      uint64_t               _admitted = 0;
+      uint64_t               _rejected = 0;
+};
+
+} // eosio
+
+FC_REFLECT(eosio::token_bucket_stats, (admitted)(rejected)(sources))
@@ -3,8 +3,12 @@
  *  @copyright defined in eos/LICENSE.txt
  */
 #include <eosio/producer_plugin/producer_plugin.hpp>
+#include <eosio/producer_plugin/pending_transaction_queue.hpp>
+#include <eosio/producer_plugin/subjective_failure_history.hpp>
+#include <eosio/http_plugin/http_plugin.hpp>
 #include <eosio/chain/producer_object.hpp>
 #include <eosio/chain/plugin_interface.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/snapshot.hpp>
@@ -17,7 +21,9 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/function_output_iterator.hpp>
@@ -126,6 +132,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       using signature_provider_type = std::function<chain::signature_type(chain::digest_type)>;
       std::map<chain::public_key_type, signature_provider_type> _signature_providers;
+      std::map<chain::public_key_type, producer_plugin::signing_latency> _signing_latency;
       std::set<chain::account_name>                             _producers;
       boost::asio::deadline_timer                               _timer;
       std::map<chain::account_name, uint32_t>                   _producer_watermarks;
@@ -152,6 +159,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       incoming::methods::block_sync::method_type::handle        _incoming_block_sync_provider;
       incoming::methods::transaction_async::method_type::handle _incoming_transaction_async_provider;
+      incoming::methods::transaction_batch_async::method_type::handle _incoming_transaction_batch_async_provider;
 
       transaction_id_with_expiry_index                         _blacklisted_transactions;
 
@@ -174,8 +182,15 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       double _incoming_trx_weight = 0.0;
       double _incoming_defer_ratio = 1.0; // 1:1
 
+      // unpacks, hashes and recovers the keys of incoming transactions before they are handed to the application thread
+      fc::optional<boost::asio::thread_pool>                   _txn_preprocess_pool;
+
       // path to write the snapshots to
       bfs::path _snapshots_dir;
+      bool      _compress_snapshots = false;
+      bool      _delta_snapshots = false;
+      // chunks of the last snapshot written, which the next delta snapshot refers to
+      optional<snapshot_chunk_index> _last_snapshot_index;
 
 
       void on_block( const block_state_ptr& bsp ) {
@@ -338,18 +353,227 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          }
       }
 
-      std::deque<std::tuple<packed_transaction_ptr, bool, next_function<transaction_trace_ptr>>> _pending_incoming_transactions;
+      pending_transaction_queue                                _pending_incoming_transactions;
+      flat_set<account_name>                                   _priority_accounts;
+      subjective_failure_history                               _subjective_failures;
+
+      // token buckets of the incoming-trx-rate-* options, checked before a transaction gets anywhere near the chain
+      token_bucket_limiter<std::string>                        _peer_admission;
+      token_bucket_limiter<std::string>                        _http_client_admission;
+      token_bucket_limiter<account_name>                       _authorizer_admission;
+
+      // timelines of the blocks this node produced, the one being produced is only kept while production is on
+      optional<producer_plugin::block_timeline>                _pending_timeline;
+      std::deque<producer_plugin::block_timeline>              _block_timelines;
+      uint32_t                                                 _block_timeline_size = 0;
+      std::unique_ptr<std::ofstream>                           _block_timeline_file;
+
+      void add_to_timeline(producer_plugin::block_timeline::phase producer_plugin::block_timeline::* p, fc::time_point start,
+                           const transaction_trace_ptr& trace) {
+         if (!_pending_timeline) return;
+         auto& ph = (*_pending_timeline).*p;
+         ph.time_us += (fc::time_point::now() - start).count();
+         ++(trace->except ? ph.failed : ph.applied);
+         if (trace->phase_times) {
+            auto& phases = _pending_timeline->transaction_phases;
+            if (!phases) phases.emplace();
+            *phases += *trace->phase_times;
+         }
+      }
+
+      void record_timeline(producer_plugin::block_timeline&& t) {
+         if (_block_timeline_file) {
+            *_block_timeline_file << fc::json::to_string(t) << std::endl;
+         }
+         if (_block_timeline_size) {
+            _block_timelines.emplace_back(std::move(t));
+            while (_block_timelines.size() > _block_timeline_size)
+               _block_timelines.pop_front();
+         }
+      }
+
+      pending_transaction_queue::tier transaction_tier(const transaction_metadata_ptr& mtrx)const {
+         auto account = mtrx->trx.first_authorizor();
+         if (_priority_accounts.count(account))
+            return pending_transaction_queue::tier::priority;
+         if (app().get_plugin<chain_plugin>().chain().is_resource_greylisted(account) ||
+             _subjective_failures.should_delay(account, fc::time_point::now()))
+            return pending_transaction_queue::tier::greylisted;
+         return pending_transaction_queue::tier::normal;
+      }
+
+      void queue_incoming_transaction(const packed_transaction_ptr& trx, const transaction_metadata_ptr& mtrx, bool persist_until_expired, const next_function<transaction_trace_ptr>& next) {
+         auto account = mtrx->trx.first_authorizor();
+         if (!_pending_incoming_transactions.push({trx, mtrx, persist_until_expired, next}, account, transaction_tier(mtrx))) {
+            next(std::static_pointer_cast<fc::exception>(std::make_shared<pending_trx_queue_full>(
+                  FC_LOG_MESSAGE(error, "too many transactions of ${account} are waiting to be applied, rejecting ${id}", ("account", account)("id", mtrx->id)) )));
+         }
+      }
+
+      void process_pending_incoming_transaction() {
+         auto e = _pending_incoming_transactions.pop();
+         on_incoming_transaction_async(e.trx, e.mtrx, e.persist_until_expired, e.next);
+      }
+
+      static fc::exception_ptr rate_limited(const string& source) {
+         return std::static_pointer_cast<fc::exception>(std::make_shared<incoming_trx_rate_limited>(
+               FC_LOG_MESSAGE(error, "too many transactions from ${source}, rejecting", ("source", source)) ));
+      }
+
+      // transactions pushed through the http api are charged to the client of the request being dispatched, which
+      // is on the call stack since the api handlers push synchronously
+      bool admit_http_client_transaction(const next_function<transaction_trace_ptr>& next) {
+         if (!_http_client_admission.enabled()) return true;
+         auto* http = app().find_plugin<http_plugin>();
+         if (!http || http->get_state() != appbase::abstract_plugin::started) return true;
+         const auto& client = http->client_address();
+         if (client.empty() || _http_client_admission.try_acquire(client, fc::time_point::now())) return true;
+         next(rate_limited(client));
+         return false;
+      }
+
+      void preprocess_incoming_transaction(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+         if (!_txn_preprocess_pool) {
+            transaction_metadata_ptr mtrx;
+            try {
+               mtrx = std::make_shared<transaction_metadata>(*trx);
+            } CATCH_AND_CALL(next);
+            if (!mtrx) return;
+            auto account = mtrx->trx.first_authorizor();
+            if (!_authorizer_admission.try_acquire(account, fc::time_point::now())) {
+               next(rate_limited(account.to_string()));
+               return;
+            }
+            on_incoming_transaction_async(trx, mtrx, persist_until_expired, next);
+            return;
+         }
+
+         auto chain_id = app().get_plugin<chain_plugin>().get_chain_id();
+         boost::asio::post(*_txn_preprocess_pool, [this, trx, chain_id, persist_until_expired, next]() {
+            transaction_metadata_ptr mtrx;
+            optional<account_name> limited;
+            prepare_incoming_transaction(trx, chain_id, mtrx, limited);
+            app_post(priority::medium, [this, trx, mtrx, limited, persist_until_expired, next]() {
+               // nothing is left on the stack to report to, so whatever throws is answered through next
+               try {
+                  if (limited) {
+                     next(rate_limited(limited->to_string()));
+                     return;
+                  }
+                  on_incoming_transaction_async(trx, mtrx, persist_until_expired, next);
+               } CATCH_AND_CALL(next);
+            });
+         });
+      }
+
+      // the part of accepting a transaction that does not need the chain, safe to run on any thread
+      void prepare_incoming_transaction(const packed_transaction_ptr& trx, const chain_id_type& chain_id, transaction_metadata_ptr& mtrx, optional<account_name>& limited) {
+         try {
+            mtrx = std::make_shared<transaction_metadata>(*trx);
+            // charged after unpacking, which the authorizer needs, but before the far costlier key recovery
+            auto account = mtrx->trx.first_authorizor();
+            if (_authorizer_admission.try_acquire(account, fc::time_point::now()))
+               mtrx->recover_keys(chain_id);
+            else
+               limited = account;
+         } catch (...) {
+            // whatever failed here is redone, and reported, on the application thread
+         }
+      }
+
+      // every transaction of the batch is prepared in parallel on the preprocess pool, and once the last one is
+      // they are all pushed from a single application thread task, in order
+      void preprocess_incoming_transactions(const vector<packed_transaction_ptr>& trxs, bool persist_until_expired, std::function<void(const transaction_batch_results&)> next) {
+         struct batch_state {
+            vector<packed_transaction_ptr>          trxs;
+            vector<transaction_metadata_ptr>        mtrxs;
+            vector<optional<account_name>>          limited;
+            vector<bool>                            admitted;
+            transaction_batch_results               results;
+            size_t                                  unanswered = 0;
+            std::atomic<size_t>                     unprepared{0};
+            std::function<void(const transaction_batch_results&)> next;
+         };
+         auto batch = std::make_shared<batch_state>();
+         batch->trxs = trxs;
+         batch->mtrxs.resize(trxs.size());
+         batch->limited.resize(trxs.size());
+         batch->admitted.resize(trxs.size());
+         batch->results.resize(trxs.size());
+         batch->unanswered = trxs.size();
+         batch->next = std::move(next);
+
+         auto answer = [batch](size_t i, const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
+            batch->results[i] = result;
+            if (--batch->unanswered == 0)
+               batch->next(batch->results);
+         };
+
+         // the http client is charged while its request is being dispatched, as for single transactions
+         size_t admitted = 0;
+         for (size_t i = 0; i < trxs.size(); ++i) {
+            batch->admitted[i] = admit_http_client_transaction([&answer, i](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
+               answer(i, result);
+            });
+            if (batch->admitted[i])
+               ++admitted;
+         }
+         if (admitted == 0)
+            return;
 
-      void on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+         auto push_all = [this, batch, answer, persist_until_expired]() {
+            for (size_t i = 0; i < batch->trxs.size(); ++i) {
+               if (!batch->admitted[i])
+                  continue;
+               if (batch->limited[i]) {
+                  answer(i, rate_limited(batch->limited[i]->to_string()));
+                  continue;
+               }
+               on_incoming_transaction_async(batch->trxs[i], batch->mtrxs[i], persist_until_expired,
+                                             [answer, i](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) {
+                  answer(i, result);
+               });
+            }
+         };
+
+         auto chain_id = app().get_plugin<chain_plugin>().get_chain_id();
+         if (!_txn_preprocess_pool) {
+            for (size_t i = 0; i < trxs.size(); ++i) {
+               if (batch->admitted[i])
+                  prepare_incoming_transaction(batch->trxs[i], chain_id, batch->mtrxs[i], batch->limited[i]);
+            }
+            push_all();
+            return;
+         }
+
+         batch->unprepared = admitted;
+         for (size_t i = 0; i < trxs.size(); ++i) {
+            if (!batch->admitted[i])
+               continue;
+            boost::asio::post(*_txn_preprocess_pool, [this, batch, i, chain_id, push_all]() {
+               prepare_incoming_transaction(batch->trxs[i], chain_id, batch->mtrxs[i], batch->limited[i]);
+               if (--batch->unprepared == 0)
+                  app_post(priority::medium, push_all);
+            });
+         }
+      }
+
+      void on_incoming_transaction_async(const packed_transaction_ptr& trx, transaction_metadata_ptr mtrx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          chain::controller& chain = app().get_plugin<chain_plugin>().chain();
+         if (!mtrx) {
+            try {
+               mtrx = std::make_shared<transaction_metadata>(*trx);
+            } CATCH_AND_CALL(next);
+            if (!mtrx) return;
+         }
          if (!chain.pending_block_state()) {
-            _pending_incoming_transactions.emplace_back(trx, persist_until_expired, next);
+            queue_incoming_transaction(trx, mtrx, persist_until_expired, next);
             return;
          }
 
          auto block_time = chain.pending_block_state()->header.timestamp.to_time_point();
 
-         auto send_response = [this, &trx, &chain, &next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& response) {
+         auto send_response = [this, &trx, &mtrx, &chain, &next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& response) {
             next(response);
             if (response.contains<fc::exception_ptr>()) {
                _transaction_ack_channel.publish(std::pair<fc::exception_ptr, packed_transaction_ptr>(response.get<fc::exception_ptr>(), trx));
@@ -357,11 +581,11 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} is REJECTING tx: ${txid} : ${why} ",
                         ("block_num", chain.head_block_num() + 1)
                         ("prod", chain.pending_block_state()->header.producer)
-                        ("txid", trx->id())
+                        ("txid", mtrx->id)
                         ("why",response.get<fc::exception_ptr>()->what()));
                } else {
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Speculative execution is REJECTING tx: ${txid} : ${why} ",
-                          ("txid", trx->id())
+                          ("txid", mtrx->id)
                           ("why",response.get<fc::exception_ptr>()->what()));
                }
             } else {
@@ -370,16 +594,16 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} is ACCEPTING tx: ${txid}",
                           ("block_num", chain.head_block_num() + 1)
                           ("prod", chain.pending_block_state()->header.producer)
-                          ("txid", trx->id()));
+                          ("txid", mtrx->id));
                } else {
                   fc_dlog(_trx_trace_log, "[TRX_TRACE] Speculative execution is ACCEPTING tx: ${txid}",
-                          ("txid", trx->id()));
+                          ("txid", mtrx->id));
                }
             }
          };
 
-         auto id = trx->id();
-         if( fc::time_point(trx->expiration()) < block_time ) {
+         const auto& id = mtrx->id;
+         if( fc::time_point(mtrx->trx.expiration) < block_time ) {
             send_response(std::static_pointer_cast<fc::exception>(std::make_shared<expired_tx_exception>(FC_LOG_MESSAGE(error, "expired transaction ${id}", ("id", id)) )));
             return;
          }
@@ -397,18 +621,21 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          }
 
          try {
-            auto trace = chain.push_transaction(std::make_shared<transaction_metadata>(*trx), deadline);
+            auto push_start = fc::time_point::now();
+            auto trace = chain.push_transaction(mtrx, deadline);
+            add_to_timeline(&producer_plugin::block_timeline::incoming, push_start, trace);
             if (trace->except) {
+               _subjective_failures.record_failure(mtrx->trx.first_authorizor(), fc::time_point::now());
                if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
-                  _pending_incoming_transactions.emplace_back(trx, persist_until_expired, next);
+                  queue_incoming_transaction(trx, mtrx, persist_until_expired, next);
                   if (_pending_block_mode == pending_block_mode::producing) {
                      fc_dlog(_trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} COULD NOT FIT, tx: ${txid} RETRYING ",
                              ("block_num", chain.head_block_num() + 1)
                              ("prod", chain.pending_block_state()->header.producer)
-                             ("txid", trx->id()));
+                             ("txid", mtrx->id));
                   } else {
                      fc_dlog(_trx_trace_log, "[TRX_TRACE] Speculative execution COULD NOT FIT tx: ${txid} RETRYING",
-                             ("txid", trx->id()));
+                             ("txid", mtrx->id));
                   }
                } else {
                   auto e_ptr = trace->except->dynamic_copy_exception();
@@ -418,7 +645,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                if (persist_until_expired) {
                   // if this trx didnt fail/soft-fail and the persist flag is set, store its ID so that we can
                   // ensure its applied to all future speculative blocks as well.
-                  _persistent_transactions.insert(transaction_id_with_expiry{trx->id(), trx->expiration()});
+                  _persistent_transactions.insert(transaction_id_with_expiry{mtrx->id, mtrx->trx.expiration});
                }
                send_response(trace);
             }
@@ -524,8 +751,36 @@ void producer_plugin::set_program_options(
           "offset of last block producing time in microseconds. Negative number results in blocks to go out sooner, and positive number results in blocks to go out later")
          ("incoming-defer-ratio", bpo::value<double>()->default_value(1.0),
           "ratio between incoming transations and deferred transactions when both are exhausted")
+         ("pending-trx-queue-policy", bpo::value<string>()->default_value("fifo"),
+          "Order in which incoming transactions waiting for a block are applied: \"fifo\", or \"priority\" for priority accounts first, greylisted accounts last and round robin between the accounts of a tier")
+         ("pending-trx-priority-account", bpo::value<vector<string>>()->composing()->multitoken(),
+          "Account whose transactions are applied first with the priority pending-trx-queue-policy (may specify multiple times)")
+         ("pending-trx-max-per-account", bpo::value<uint32_t>()->default_value(0),
+          "Maximum number of incoming transactions of one account waiting for a block, keyed by their first authorizer (0 for no limit)")
+         ("subjective-failure-threshold", bpo::value<uint32_t>()->default_value(3),
+          "Number of recent failed transactions of an account after which retries of its unapplied transactions are delayed (0 to disable)")
+         ("subjective-failure-decay-ms", bpo::value<uint32_t>()->default_value(60000),
+          "Time (in milliseconds) without a failure after which an account's failure count is halved; also the longest retry delay")
+         ("block-timeline-size", bpo::value<uint32_t>()->default_value(120),
+          "Number of blocks produced by this node whose production timeline is kept for /v1/producer/get_block_timeline (0 to keep none)")
+         ("block-timeline-file", bpo::value<bfs::path>(),
+          "File the production timeline of every block produced by this node is appended to, one JSON object per line")
+         ("txn-preprocess-threads", bpo::value<uint16_t>()->default_value(2),
+          "Number of worker threads that unpack incoming transactions and recover their signing keys before they are applied (0 to do it on the main thread)")
+         ("incoming-trx-rate-per-peer", bpo::value<double>()->default_value(0),
+          "Transactions per second accepted from one p2p connection, further ones are dropped before they are unpacked (0 for no limit)")
+         ("incoming-trx-rate-per-http-client", bpo::value<double>()->default_value(0),
+          "Transactions per second accepted from one HTTP client address, further ones are rejected before they are unpacked (0 for no limit)")
+         ("incoming-trx-rate-per-authorizer", bpo::value<double>()->default_value(0),
+          "Transactions per second accepted for one first authorizer, further ones are rejected before their signing keys are recovered (0 for no limit)")
+         ("incoming-trx-rate-burst-ms", bpo::value<uint32_t>()->default_value(1000),
+          "Time (in milliseconds) worth of the incoming-trx-rate-* limits a source may send at once after being idle")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("compress-snapshots", bpo::bool_switch()->default_value(false),
+          "write snapshots with compressed sections that can be streamed to another node without staging them on disk")
+         ("delta-snapshots", bpo::bool_switch()->default_value(false),
+          "after the first snapshot, write snapshots as the difference to the previous one (apply them with eosio-snapshot)")
          ;
    config_file_options.add(producer_options);
 }
@@ -594,13 +849,41 @@ make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl,
          fc::variant params;
          fc::to_variant(std::make_pair(digest, pubkey), params);
          auto deadline = impl->_keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + impl->_keosd_provider_timeout_us : fc::time_point::maximum();
-         return app().get_plugin<http_client_plugin>().get_client().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
+         return app().get_plugin<http_client_plugin>().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
       } else {
          return signature_type();
       }
    };
 }
 
+/// wraps a signature provider so that the latency of every call is recorded for get_signing_latency
+static producer_plugin_impl::signature_provider_type
+make_timed_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl, const public_key_type pubkey, producer_plugin_impl::signature_provider_type provider) {
+   static const int64_t bucket_upper_us[] = { 250, 500, 1000, 2000, 5000, 10000, 50000 };
+   std::weak_ptr<producer_plugin_impl> weak_impl = impl;
+
+   return [weak_impl, pubkey, provider = std::move(provider)]( const chain::digest_type& digest ) {
+      auto start = fc::time_point::now();
+      bool failed = true;
+      auto record = fc::make_scoped_exit([&](){
+         auto impl = weak_impl.lock();
+         if (!impl) return;
+         auto& l = impl->_signing_latency[pubkey];
+         auto us = (fc::time_point::now() - start).count();
+         l.key = pubkey;
+         ++l.calls;
+         if (failed) ++l.failures;
+         l.total_us += us;
+         l.max_us = std::max<uint64_t>(l.max_us, us);
+         auto bucket = std::upper_bound(std::begin(bucket_upper_us), std::end(bucket_upper_us), us) - std::begin(bucket_upper_us);
+         ++l.histogram[bucket];
+      });
+      auto sig = provider(digest);
+      failed = false;
+      return sig;
+   };
+}
+
 void producer_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 { try {
    my->_options = &options;
@@ -613,7 +896,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
       {
          try {
             auto key_id_to_wif_pair = dejsonify<std::pair<public_key_type, private_key_type>>(key_id_to_wif_pair_string);
-            my->_signature_providers[key_id_to_wif_pair.first] = make_key_signature_provider(key_id_to_wif_pair.second);
+            my->_signature_providers[key_id_to_wif_pair.first] = make_timed_signature_provider(my, key_id_to_wif_pair.first, make_key_signature_provider(key_id_to_wif_pair.second));
             auto blanked_privkey = std::string(std::string(key_id_to_wif_pair.second).size(), '*' );
             wlog("\"private-key\" is DEPRECATED, use \"signature-provider=${pub}=KEY:${priv}\"", ("pub",key_id_to_wif_pair.first)("priv", blanked_privkey));
          } catch ( fc::exception& e ) {
@@ -639,9 +922,9 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
             auto pubkey = public_key_type(pub_key_str);
 
             if (spec_type_str == "KEY") {
-               my->_signature_providers[pubkey] = make_key_signature_provider(private_key_type(spec_data));
+               my->_signature_providers[pubkey] = make_timed_signature_provider(my, pubkey, make_key_signature_provider(private_key_type(spec_data)));
             } else if (spec_type_str == "KEOSD") {
-               my->_signature_providers[pubkey] = make_keosd_signature_provider(my, spec_data, pubkey);
+               my->_signature_providers[pubkey] = make_timed_signature_provider(my, pubkey, make_keosd_signature_provider(my, spec_data, pubkey));
             }
 
          } catch (...) {
@@ -662,6 +945,47 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_incoming_defer_ratio = options.at("incoming-defer-ratio").as<double>();
 
+   auto queue_policy = options.at("pending-trx-queue-policy").as<string>();
+   EOS_ASSERT( queue_policy == "fifo" || queue_policy == "priority", plugin_config_exception,
+               "unknown pending-trx-queue-policy ${p}", ("p", queue_policy) );
+   my->_pending_incoming_transactions = pending_transaction_queue(
+         queue_policy == "priority" ? pending_transaction_queue::policy::priority : pending_transaction_queue::policy::fifo,
+         options.at("pending-trx-max-per-account").as<uint32_t>() );
+   if( options.count("pending-trx-priority-account") ) {
+      for( const auto& a : options["pending-trx-priority-account"].as<vector<string>>() )
+         my->_priority_accounts.insert( account_name(a) );
+   }
+
+   my->_subjective_failures = subjective_failure_history( options.at("subjective-failure-threshold").as<uint32_t>(),
+                                                          fc::milliseconds(options.at("subjective-failure-decay-ms").as<uint32_t>()) );
+
+   my->_block_timeline_size = options.at("block-timeline-size").as<uint32_t>();
+   if( options.count("block-timeline-file") ) {
+      auto tf = options.at("block-timeline-file").as<bfs::path>();
+      if( tf.is_relative() )
+         tf = app().data_dir() / tf;
+      my->_block_timeline_file = std::make_unique<std::ofstream>( tf.generic_string(), std::ios::out | std::ios::app );
+      EOS_ASSERT( my->_block_timeline_file->good(), plugin_config_exception,
+                  "unable to open block timeline file ${f}", ("f", tf.generic_string()) );
+   }
+
+   auto burst_seconds = options.at("incoming-trx-rate-burst-ms").as<uint32_t>() / 1000.0;
+   auto peer_rate = options.at("incoming-trx-rate-per-peer").as<double>();
+   my->_peer_admission.configure( peer_rate, peer_rate * burst_seconds );
+   auto http_client_rate = options.at("incoming-trx-rate-per-http-client").as<double>();
+   my->_http_client_admission.configure( http_client_rate, http_client_rate * burst_seconds );
+   auto authorizer_rate = options.at("incoming-trx-rate-per-authorizer").as<double>();
+   my->_authorizer_admission.configure( authorizer_rate, authorizer_rate * burst_seconds );
+
+   auto txn_preprocess_threads = options.at("txn-preprocess-threads").as<uint16_t>();
+   if( txn_preprocess_threads > 0 )
+      my->_txn_preprocess_pool.emplace( txn_preprocess_threads );
+
+   my->_compress_snapshots = options.at("compress-snapshots").as<bool>();
+   my->_delta_snapshots = options.at("delta-snapshots").as<bool>();
+   EOS_ASSERT( !my->_compress_snapshots || !my->_delta_snapshots, plugin_config_exception,
+               "delta-snapshots needs binary snapshots to take deltas against and cannot be used with compress-snapshots" );
+
    if( options.count( "snapshots-dir" )) {
       auto sd = options.at( "snapshots-dir" ).as<bfs::path>();
       if( sd.is_relative()) {
@@ -685,7 +1009,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_incoming_transaction_subscription = app().get_channel<incoming::channels::transaction>().subscribe([this](const packed_transaction_ptr& trx){
       try {
-         my->on_incoming_transaction_async(trx, false, [](const auto&){});
+         my->preprocess_incoming_transaction(trx, false, [](const auto&){});
       } FC_LOG_AND_DROP();
    });
 
@@ -694,7 +1018,13 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
    });
 
    my->_incoming_transaction_async_provider = app().get_method<incoming::methods::transaction_async>().register_provider([this](const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) -> void {
-      return my->on_incoming_transaction_async(trx, persist_until_expired, next );
+      if (!my->admit_http_client_transaction(next))
+         return;
+      return my->preprocess_incoming_transaction(trx, persist_until_expired, next );
+   });
+
+   my->_incoming_transaction_batch_async_provider = app().get_method<incoming::methods::transaction_batch_async>().register_provider([this](const vector<packed_transaction_ptr>& trxs, bool persist_until_expired, std::function<void(const transaction_batch_results&)> next) -> void {
+      return my->preprocess_incoming_transactions(trxs, persist_until_expired, next);
    });
 
    if (options.count("greylist-account")) {
@@ -763,6 +1093,11 @@ void producer_plugin::plugin_shutdown() {
       edump((e.to_detail_string()));
    }
 
+   if( my->_txn_preprocess_pool ) {
+      my->_txn_preprocess_pool->stop();
+      my->_txn_preprocess_pool->join();
+   }
+
    my->_accepted_block_connection.reset();
    my->_irreversible_block_connection.reset();
 }
@@ -896,6 +1231,49 @@ producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(
    return {chain.head_block_id(), chain.calculate_integrity_hash()};
 }
 
+std::vector<producer_plugin::signing_latency> producer_plugin::get_signing_latency() const {
+   std::vector<signing_latency> result;
+   result.reserve( my->_signing_latency.size() );
+   for( const auto& l : my->_signing_latency )
+      result.push_back( l.second );
+   return result;
+}
+
+bool producer_plugin::admit_peer_transaction(const std::string& peer) {
+   return my->_peer_admission.try_acquire( peer, fc::time_point::now() );
+}
+
+producer_plugin::admission_stats producer_plugin::get_admission_stats() const {
+   return admission_stats{ my->_peer_admission.get_stats(), my->_http_client_admission.get_stats(),
+                           my->_authorizer_admission.get_stats() };
+}
+
+std::vector<producer_plugin::block_timeline> producer_plugin::get_block_timeline(const block_timeline_params& params) const {
+   auto first = my->_block_timelines.begin();
+   if( params.limit && params.limit < my->_block_timelines.size() )
+      first = my->_block_timelines.end() - params.limit;
+   return std::vector<block_timeline>( first, my->_block_timelines.end() );
+}
+
+pending_transaction_queue::stats producer_plugin::get_pending_queue_stats() const {
+   return my->_pending_incoming_transactions.get_stats();
+}
+
+producer_plugin::execution_profile producer_plugin::get_execution_profile(const execution_profile_params& params) const {
+   chain::controller& chain = app().get_plugin<chain_plugin>().chain();
+   auto* profiler = chain.get_execution_profiler();
+
+   execution_profile result;
+   if( profiler ) {
+      result.enabled = true;
+      result.actions = profiler->report();
+      result.folded_stacks = profiler->folded_stacks();
+      if( params.reset )
+         profiler->reset();
+   }
+   return result;
+}
+
 producer_plugin::snapshot_information producer_plugin::create_snapshot() const {
    chain::controller& chain = app().get_plugin<chain_plugin>().chain();
 
@@ -911,19 +1289,36 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const {
    }
 
    auto head_id = chain.head_block_id();
-   std::string snapshot_path = (my->_snapshots_dir / fc::format_string("snapshot-${id}.bin", fc::mutable_variant_object()("id", head_id))).generic_string();
+   const bool delta = my->_delta_snapshots && my->_last_snapshot_index;
+   std::string snapshot_path = (my->_snapshots_dir / fc::format_string(delta ? "snapshot-${id}.delta" : "snapshot-${id}.bin", fc::mutable_variant_object()("id", head_id))).generic_string();
 
    EOS_ASSERT( !fc::is_regular_file(snapshot_path), snapshot_exists_exception,
                "snapshot named ${name} already exists", ("name", snapshot_path));
 
 
    auto snap_out = std::ofstream(snapshot_path, (std::ios::out | std::ios::binary));
-   auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-   chain.write_snapshot(writer);
-   writer->finalize();
+   if( delta ) {
+      auto writer = std::make_shared<delta_snapshot_writer>(snap_out, *my->_last_snapshot_index);
+      chain.write_snapshot(writer);
+      writer->finalize();
+      my->_last_snapshot_index = writer->index();
+   } else if( my->_compress_snapshots ) {
+      auto writer = std::make_shared<compressed_ostream_snapshot_writer>(snap_out);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   } else {
+      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
+      chain.write_snapshot(writer);
+      writer->finalize();
+   }
    snap_out.flush();
    snap_out.close();
 
+   if( my->_delta_snapshots && !delta ) {
+      auto snap_in = std::ifstream(snapshot_path, (std::ios::in | std::ios::binary));
+      my->_last_snapshot_index = delta_snapshot_writer::index_snapshot(snap_in);
+   }
+
    return {head_id, snapshot_path};
 }
 
@@ -1061,6 +1456,8 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
          return start_block_result::waiting;
    }
 
+   _pending_timeline.reset();
+
    try {
       uint16_t blocks_to_confirm = 0;
 
@@ -1091,6 +1488,15 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
          _pending_block_mode = pending_block_mode::speculating;
       }
 
+      if (_pending_block_mode == pending_block_mode::producing && (_block_timeline_size || _block_timeline_file)) {
+         _pending_timeline.emplace();
+         _pending_timeline->block_num = pbs->block_num;
+         _pending_timeline->producer = pbs->header.producer;
+         _pending_timeline->block_time = pbs->header.timestamp.to_time_point();
+         _pending_timeline->start_block = now;
+         _pending_timeline->deadline = block_time + fc::microseconds(last_block ? _last_block_time_offset_us : _produce_time_offset_us);
+      }
+
       // attempt to play persisted transactions first
       bool exhausted = false;
 
@@ -1161,10 +1567,19 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
                }
             }
 
+            if (_pending_incoming_transactions.get_policy() == pending_transaction_queue::policy::priority) {
+               std::stable_sort(apply_trxs.begin(), apply_trxs.end(), [this](const auto& l, const auto& r) {
+                  return transaction_tier(l) < transaction_tier(r);
+               });
+            }
+
             if (!apply_trxs.empty()) {
                int num_applied = 0;
                int num_failed = 0;
                int num_processed = 0;
+               int num_delayed = 0;
+
+               _subjective_failures.prune(fc::time_point::now());
 
                for (const auto& trx: apply_trxs) {
                   if (block_time <= fc::time_point::now()) exhausted = true;
@@ -1172,6 +1587,12 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
                      break;
                   }
 
+                  // accounts that keep failing wait before their transactions are executed again, they stay unapplied meanwhile
+                  if (_subjective_failures.should_delay(trx->trx.first_authorizor(), fc::time_point::now())) {
+                     num_delayed++;
+                     continue;
+                  }
+
                   num_processed++;
 
                   try {
@@ -1182,8 +1603,12 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
                         deadline = block_time;
                      }
 
+                     auto push_start = fc::time_point::now();
                      auto trace = chain.push_transaction(trx, deadline);
+                     add_to_timeline(persisted_by_id.count(trx->id) ? &producer_plugin::block_timeline::persisted : &producer_plugin::block_timeline::unapplied,
+                                     push_start, trace);
                      if (trace->except) {
+                        _subjective_failures.record_failure(trx->trx.first_authorizor(), fc::time_point::now());
                         if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
                            exhausted = true;
                         } else {
@@ -1200,11 +1625,12 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
                   } FC_LOG_AND_DROP();
                }
 
-               fc_dlog(_log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}",
+               fc_dlog(_log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}, Delayed ${delayed}",
                       ("m", num_processed)
                       ("n", apply_trxs.size())
                       ("applied", num_applied)
-                      ("failed", num_failed));
+                      ("failed", num_failed)
+                      ("delayed", num_delayed));
             }
          }
 
@@ -1226,71 +1652,82 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
                       ("expired", num_expired));
             }
 
-            auto scheduled_trxs = chain.get_scheduled_transactions();
+            // due transactions are fetched in batches, each resuming where the last one stopped, so that a large
+            // backlog is neither collected at once nor walked again; anything pushed and left in place is behind the cursor
+            static const size_t scheduled_batch_size = 64;
+            chain::controller::scheduled_transactions_cursor scheduled_cursor;
+            auto skip_scheduled = [&](const transaction_id_type& id) {
+               return blacklist_by_id.find(id) != blacklist_by_id.end();
+            };
+            auto scheduled_trxs = chain.get_scheduled_transactions(scheduled_batch_size, scheduled_cursor, skip_scheduled);
             if (!scheduled_trxs.empty()) {
                int num_applied = 0;
                int num_failed = 0;
                int num_processed = 0;
 
-               for (const auto& trx : scheduled_trxs) {
-                  if (block_time <= fc::time_point::now()) exhausted = true;
-                  if (exhausted) {
-                     break;
-                  }
-
-                  num_processed++;
+               while (!scheduled_trxs.empty() && !exhausted) {
+                  for (const auto& trx : scheduled_trxs) {
+                     if (block_time <= fc::time_point::now()) exhausted = true;
+                     if (exhausted) {
+                        break;
+                     }
 
-                  // configurable ratio of incoming txns vs deferred txns
-                  while (_incoming_trx_weight >= 1.0 && orig_pending_txn_size && _pending_incoming_transactions.size()) {
-                     auto e = _pending_incoming_transactions.front();
-                     _pending_incoming_transactions.pop_front();
-                     --orig_pending_txn_size;
-                     _incoming_trx_weight -= 1.0;
-                     on_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
-                  }
+                     num_processed++;
 
-                  if (block_time <= fc::time_point::now()) {
-                     exhausted = true;
-                     break;
-                  }
+                     // configurable ratio of incoming txns vs deferred txns
+                     while (_incoming_trx_weight >= 1.0 && orig_pending_txn_size && _pending_incoming_transactions.size()) {
+                        --orig_pending_txn_size;
+                        _incoming_trx_weight -= 1.0;
+                        process_pending_incoming_transaction();
+                     }
 
-                  if (blacklist_by_id.find(trx) != blacklist_by_id.end()) {
-                     continue;
-                  }
+                     if (block_time <= fc::time_point::now()) {
+                        exhausted = true;
+                        break;
+                     }
 
-                  try {
-                     auto deadline = fc::time_point::now() + fc::milliseconds(_max_transaction_time_ms);
-                     bool deadline_is_subjective = false;
-                     if (_max_transaction_time_ms < 0 || (_pending_block_mode == pending_block_mode::producing && block_time < deadline)) {
-                        deadline_is_subjective = true;
-                        deadline = block_time;
+                     if (blacklist_by_id.find(trx) != blacklist_by_id.end()) {
+                        continue;
                      }
 
-                     auto trace = chain.push_scheduled_transaction(trx, deadline);
-                     if (trace->except) {
-                        if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
-                           exhausted = true;
+                     try {
+                        auto deadline = fc::time_point::now() + fc::milliseconds(_max_transaction_time_ms);
+                        bool deadline_is_subjective = false;
+                        if (_max_transaction_time_ms < 0 || (_pending_block_mode == pending_block_mode::producing && block_time < deadline)) {
+                           deadline_is_subjective = true;
+                           deadline = block_time;
+                        }
+
+                        auto push_start = fc::time_point::now();
+                        auto trace = chain.push_scheduled_transaction(trx, deadline);
+                        add_to_timeline(&producer_plugin::block_timeline::scheduled, push_start, trace);
+                        if (trace->except) {
+                           if (failure_is_subjective(*trace->except, deadline_is_subjective)) {
+                              exhausted = true;
+                           } else {
+                              auto expiration = fc::time_point::now() + fc::seconds(chain.get_global_properties().configuration.deferred_trx_expiration_window);
+                              // this failed our configured maximum transaction time, we don't want to replay it add it to a blacklist
+                              _blacklisted_transactions.insert(transaction_id_with_expiry{trx, expiration});
+                              num_failed++;
+                           }
                         } else {
-                           auto expiration = fc::time_point::now() + fc::seconds(chain.get_global_properties().configuration.deferred_trx_expiration_window);
-                           // this failed our configured maximum transaction time, we don't want to replay it add it to a blacklist
-                           _blacklisted_transactions.insert(transaction_id_with_expiry{trx, expiration});
-                           num_failed++;
+                           num_applied++;
                         }
-                     } else {
-                        num_applied++;
-                     }
-                  } catch ( const guard_exception& e ) {
-                     app().get_plugin<chain_plugin>().handle_guard_exception(e);
-                     return start_block_result::failed;
-                  } FC_LOG_AND_DROP();
+                     } catch ( const guard_exception& e ) {
+                        app().get_plugin<chain_plugin>().handle_guard_exception(e);
+                        return start_block_result::failed;
+                     } FC_LOG_AND_DROP();
+
+                     _incoming_trx_weight += _incoming_defer_ratio;
+                     if (!orig_pending_txn_size) _incoming_trx_weight = 0.0;
+                  }
 
-                  _incoming_trx_weight += _incoming_defer_ratio;
-                  if (!orig_pending_txn_size) _incoming_trx_weight = 0.0;
+                  if (!exhausted)
+                     scheduled_trxs = chain.get_scheduled_transactions(scheduled_batch_size, scheduled_cursor, skip_scheduled);
                }
 
-               fc_dlog(_log, "Processed ${m} of ${n} scheduled transactions, Applied ${applied}, Failed/Dropped ${failed}",
+               fc_dlog(_log, "Processed ${m} scheduled transactions, Applied ${applied}, Failed/Dropped ${failed}",
                       ("m", num_processed)
-                      ("n", scheduled_trxs.size())
                       ("applied", num_applied)
                       ("failed", num_failed));
 
@@ -1304,12 +1741,10 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block(bool
             _incoming_trx_weight = 0.0;
 
             if (!_pending_incoming_transactions.empty()) {
-               fc_dlog(_log, "Processing ${n} pending transactions");
+               fc_dlog(_log, "Processing ${n} pending transactions", ("n", _pending_incoming_transactions.size()));
                while (orig_pending_txn_size && _pending_incoming_transactions.size()) {
-                  auto e = _pending_incoming_transactions.front();
-                  _pending_incoming_transactions.pop_front();
                   --orig_pending_txn_size;
-                  on_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+                  process_pending_incoming_transaction();
                   if (block_time <= fc::time_point::now()) return start_block_result::exhausted;
                }
             }
@@ -1479,13 +1914,32 @@ void producer_plugin_impl::produce_block() {
    EOS_ASSERT(signature_provider_itr != _signature_providers.end(), producer_priv_key_not_found, "Attempting to produce a block for which we don't have the private key");
 
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
+   auto timeline = std::move(_pending_timeline);
+   _pending_timeline.reset();
+   auto phase_start = fc::time_point::now();
    chain.finalize_block();
+   if (timeline) {
+      auto now = fc::time_point::now();
+      timeline->finalize_us = (now - phase_start).count();
+      phase_start = now;
+   }
    chain.sign_block( [&]( const digest_type& d ) {
       auto debug_logger = maybe_make_debug_time_logger();
       return signature_provider_itr->second(d);
    } );
+   if (timeline) {
+      auto now = fc::time_point::now();
+      timeline->sign_us = (now - phase_start).count();
+      phase_start = now;
+   }
 
    chain.commit_block();
+   if (timeline) {
+      timeline->produced = fc::time_point::now();
+      timeline->commit_us = (timeline->produced - phase_start).count();
+      timeline->slack_us = (timeline->deadline - timeline->produced).count();
+      record_timeline(std::move(*timeline));
+   }
    auto hbt = chain.head_block_time();
    //idump((fc::time_point::now() - hbt));
 
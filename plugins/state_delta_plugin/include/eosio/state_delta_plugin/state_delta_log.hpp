@@ -0,0 +1,46 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <eosio/chain/state_deltas.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+
+namespace eosio {
+
+   namespace detail { class state_delta_log_impl; }
+
+   /**
+    *  Append-only file of the packed block_state_deltas of consecutive blocks.
+    *
+    *  Every entry is stored as its packed size followed by the packed deltas, whose first field is the block number.
+    *  Only the offsets of the entries are kept in memory, rebuilt by scanning the file on open, which also drops an
+    *  entry cut short by a crash. Methods may be called from any thread.
+    */
+   class state_delta_log {
+      public:
+         explicit state_delta_log( const fc::path& dir );
+         ~state_delta_log();
+
+         /**
+          *  Appends the deltas of the block after the last one. A block at or below the last one is a fork switch:
+          *  the entries from its number on are dropped first. A block past the one after the last starts the log
+          *  over, since the deltas in between are missing.
+          */
+         void append( const chain::block_state_deltas& deltas );
+
+         /// 0 if the log is empty
+         uint32_t first_block_num()const;
+         uint32_t last_block_num()const;
+
+         /// the packed block_state_deltas of the block, none if it is not in the log
+         fc::optional<vector<char>> read( uint32_t block_num );
+
+      private:
+         std::unique_ptr<detail::state_delta_log_impl> my;
+   };
+
+} /// namespace eosio
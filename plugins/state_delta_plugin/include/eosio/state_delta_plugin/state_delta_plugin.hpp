@@ -0,0 +1,43 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+#include <appbase/application.hpp>
+#include <eosio/chain_plugin/chain_plugin.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+/// the first and only message a client sends; the deltas of every block from start_block_num on are sent back
+struct get_state_deltas_request {
+   uint32_t start_block_num = 0;
+};
+
+/**
+ *  Writes the final state of the contract tables and rows written by every block applied, as packed
+ *  chain::block_state_deltas, to an append-only log in state-delta-dir, and streams them to websocket clients as
+ *  binary messages, one per block. A client sends a packed get_state_deltas_request, then receives the logged blocks
+ *  from there on and every block applied after them. On a fork switch the blocks of the new branch are sent again
+ *  from the fork point, so a client keeps the deltas of the last block it received with a given number.
+ */
+class state_delta_plugin : public appbase::plugin<state_delta_plugin> {
+public:
+   state_delta_plugin();
+   virtual ~state_delta_plugin();
+
+   APPBASE_PLUGIN_REQUIRES((chain_plugin))
+   virtual void set_program_options(options_description&, options_description& cfg) override;
+
+   void plugin_initialize(const variables_map& options);
+   void plugin_startup();
+   void plugin_shutdown();
+
+private:
+   std::shared_ptr<class state_delta_plugin_impl> my;
+};
+
+}
+
+FC_REFLECT( eosio::get_state_deltas_request, (start_block_num) )
@@ -0,0 +1,150 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/state_delta_plugin/state_delta_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <fstream>
+#include <mutex>
+
+namespace eosio {
+
+   namespace detail {
+      class state_delta_log_impl {
+         public:
+            std::mutex                 mtx;
+            fc::path                   log_file;
+            std::ofstream              writer;
+            std::ifstream              reader;
+            uint64_t                   end_pos = 0;
+            uint32_t                   first_block = 0;
+            vector<uint64_t>           offsets; ///< of the entry of block first_block + i
+
+            uint32_t last_block()const { return offsets.empty() ? 0 : first_block + offsets.size() - 1; }
+
+            void open_writer() {
+               writer.open( log_file.generic_string().c_str(), std::ios::out | std::ios::app | std::ios::binary );
+               EOS_ASSERT( writer, chain::plugin_exception, "unable to open ${f}", ("f", log_file.generic_string()) );
+            }
+
+            /// drops the entries from the one at offsets[i] on
+            void truncate( size_t i ) {
+               end_pos = i < offsets.size() ? offsets[i] : end_pos;
+               offsets.resize( std::min( i, offsets.size() ) );
+               writer.close();
+               boost::filesystem::resize_file( log_file.generic_string(), end_pos );
+               open_writer();
+            }
+
+            vector<char> read( uint64_t pos ) {
+               reader.clear();
+               reader.seekg( pos );
+               uint32_t size = 0;
+               reader.read( (char*)&size, sizeof(size) );
+               vector<char> packed( size );
+               reader.read( packed.data(), size );
+               EOS_ASSERT( reader, chain::plugin_exception, "unable to read state deltas at ${p} of ${f}",
+                           ("p", pos)("f", log_file.generic_string()) );
+               return packed;
+            }
+
+            /// indexes every complete entry of consecutive blocks and returns the end of the last one
+            uint64_t scan() {
+               auto file_size = boost::filesystem::file_size( log_file.generic_string() );
+               uint64_t pos = 0;
+               while( pos + sizeof(uint32_t) * 2 <= file_size ) {
+                  reader.clear();
+                  reader.seekg( pos );
+                  uint32_t size = 0, block_num = 0;
+                  reader.read( (char*)&size, sizeof(size) );
+                  reader.read( (char*)&block_num, sizeof(block_num) );
+                  if( !reader || size < sizeof(block_num) || pos + sizeof(size) + size > file_size )
+                     break;
+                  if( offsets.empty() ) {
+                     first_block = block_num;
+                  } else if( block_num != last_block() + 1 ) {
+                     wlog( "dropping state deltas from ${p} on, block ${b} does not follow ${l}",
+                           ("p", pos)("b", block_num)("l", last_block()) );
+                     break;
+                  }
+                  offsets.push_back( pos );
+                  pos += sizeof(size) + size;
+               }
+               return pos;
+            }
+      };
+   }
+
+   state_delta_log::state_delta_log( const fc::path& dir )
+   :my( new detail::state_delta_log_impl() ) {
+      if( !fc::is_directory( dir ) )
+         fc::create_directories( dir );
+      my->log_file = dir / "deltas.log";
+      if( !fc::exists( my->log_file ) )
+         std::ofstream( my->log_file.generic_string().c_str(), std::ios::binary );
+
+      my->reader.open( my->log_file.generic_string().c_str(), std::ios::in | std::ios::binary );
+      EOS_ASSERT( my->reader, chain::plugin_exception, "unable to open ${f}", ("f", my->log_file.generic_string()) );
+      my->end_pos = my->scan();
+      if( my->end_pos != boost::filesystem::file_size( my->log_file.generic_string() ) ) {
+         wlog( "truncating ${f} to its last complete block", ("f", my->log_file.generic_string()) );
+         boost::filesystem::resize_file( my->log_file.generic_string(), my->end_pos );
+      }
+      my->open_writer();
+      ilog( "state delta log ${f} holds blocks ${first} to ${last}",
+            ("f", my->log_file.generic_string())("first", my->first_block)("last", my->last_block()) );
+   }
+
+   state_delta_log::~state_delta_log() {
+      if( my && my->writer.is_open() )
+         my->writer.flush();
+   }
+
+   void state_delta_log::append( const chain::block_state_deltas& deltas ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      if( !my->offsets.empty() ) {
+         if( deltas.block_num < my->first_block || deltas.block_num > my->last_block() + 1 ) {
+            if( deltas.block_num > my->last_block() + 1 )
+               wlog( "state deltas of blocks ${f} to ${l} are missing, starting ${file} over",
+                     ("f", my->last_block() + 1)("l", deltas.block_num - 1)("file", my->log_file.generic_string()) );
+            my->truncate( 0 );
+         } else if( deltas.block_num <= my->last_block() ) {
+            my->truncate( deltas.block_num - my->first_block );
+         }
+      }
+      if( my->offsets.empty() )
+         my->first_block = deltas.block_num;
+
+      auto packed = fc::raw::pack( deltas );
+      uint32_t size = packed.size();
+      my->writer.write( (const char*)&size, sizeof(size) );
+      my->writer.write( packed.data(), packed.size() );
+      my->writer.flush();
+      EOS_ASSERT( my->writer, chain::plugin_exception, "unable to append to ${f}", ("f", my->log_file.generic_string()) );
+      my->offsets.push_back( my->end_pos );
+      my->end_pos += sizeof(size) + size;
+   }
+
+   uint32_t state_delta_log::first_block_num()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return my->offsets.empty() ? 0 : my->first_block;
+   }
+
+   uint32_t state_delta_log::last_block_num()const {
+      std::lock_guard<std::mutex> g( my->mtx );
+      return my->last_block();
+   }
+
+   fc::optional<vector<char>> state_delta_log::read( uint32_t block_num ) {
+      std::lock_guard<std::mutex> g( my->mtx );
+      if( my->offsets.empty() || block_num < my->first_block || block_num > my->last_block() )
+         return {};
+      return my->read( my->offsets[block_num - my->first_block] );
+   }
+
+} /// namespace eosio
@@ -0,0 +1,253 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/state_delta_plugin/state_delta_plugin.hpp>
+#include <eosio/state_delta_plugin/state_delta_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/filesystem.hpp>
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+using tcp = boost::asio::ip::tcp;
+namespace ws  = boost::beast::websocket;
+
+namespace eosio {
+   static appbase::abstract_plugin& _state_delta_plugin = app().register_plugin<state_delta_plugin>();
+
+   namespace bfs = boost::filesystem;
+   using chain::block_state_deltas_ptr;
+
+class state_delta_session;
+
+class state_delta_plugin_impl : public std::enable_shared_from_this<state_delta_plugin_impl> {
+   public:
+      fc::path                                      dir;
+      string                                        endpoint_address = "127.0.0.1";
+      uint16_t                                      endpoint_port = 8087;
+      std::unique_ptr<state_delta_log>              log;
+
+      std::unique_ptr<boost::asio::io_context>      ioc; // lifetime guarded by shared_ptr of state_delta_plugin_impl
+      std::unique_ptr<tcp::acceptor>                acceptor;
+      std::unique_ptr<tcp::socket>                  socket; ///< of the next client accepted
+      std::thread                                   thread;
+
+      std::mutex                                                        sessions_mtx;
+      std::map<const state_delta_session*, std::weak_ptr<state_delta_session>>  sessions; // guarded by `sessions_mtx`
+
+      fc::optional<boost::signals2::scoped_connection>  deltas_connection;
+
+      void on_deltas( const block_state_deltas_ptr& deltas );
+      void do_accept();
+      void remove_session( const state_delta_session* s ) {
+         std::lock_guard<std::mutex> g( sessions_mtx );
+         sessions.erase( s );
+      }
+};
+
+/**
+ *  Sends the logged deltas of consecutive blocks to one client, reading each from the log as the previous one is
+ *  written, so a client catching up and a live one are served the same way. Only runs on its strand.
+ */
+class state_delta_session : public std::enable_shared_from_this<state_delta_session> {
+   public:
+      state_delta_session( std::shared_ptr<state_delta_plugin_impl> p, tcp::socket s )
+      :plugin( std::move(p) ), stream( std::move(s) ), strand( stream.get_executor() ) {}
+
+      void run() {
+         stream.binary( true );
+         stream.async_accept( boost::asio::bind_executor( strand,
+                                 [self = shared_from_this()]( boost::system::error_code ec ) { self->on_accept( ec ); } ) );
+      }
+
+      /// the log changed from block_num on
+      void notify( uint32_t block_num ) {
+         boost::asio::post( strand, [self = shared_from_this(), block_num]() {
+            if( block_num < self->next_block ) {
+               self->next_block = block_num;
+               self->rewound = self->writing;
+            } else if( self->writing && block_num <= self->sending_block ) {
+               self->next_block = block_num;
+               self->rewound = true;
+            }
+            self->send_next();
+         } );
+      }
+
+   private:
+      void on_accept( boost::system::error_code ec ) {
+         if( ec )
+            return close( ec, "accept" );
+         stream.async_read( in_buffer, boost::asio::bind_executor( strand,
+                               [self = shared_from_this()]( boost::system::error_code ec, size_t ) { self->on_request( ec ); } ) );
+      }
+
+      void on_request( boost::system::error_code ec ) {
+         if( ec )
+            return close( ec, "read" );
+         try {
+            auto d = boost::asio::buffer_cast<char const*>( boost::beast::buffers_front( in_buffer.data() ) );
+            auto s = boost::asio::buffer_size( in_buffer.data() );
+            auto request = fc::raw::unpack<get_state_deltas_request>( vector<char>( d, d + s ) );
+            in_buffer.consume( s );
+            next_block = std::max( request.start_block_num, plugin->log->first_block_num() );
+            started = true;
+         } catch( ... ) {
+            wlog( "state delta client sent a bad request" );
+            boost::system::error_code ignored;
+            stream.close( ws::close_code::bad_payload, ignored );
+            return close( ec, "request" );
+         }
+         send_next();
+         // the client sends nothing more, but reading notices when it closes
+         stream.async_read( in_buffer, boost::asio::bind_executor( strand,
+                               [self = shared_from_this()]( boost::system::error_code ec, size_t ) { self->close( ec, "read" ); } ) );
+      }
+
+      void send_next() {
+         if( !started || writing || closed )
+            return;
+         auto packed = plugin->log->read( next_block );
+         if( !packed )
+            return;
+         out_buffer = std::move( *packed );
+         sending_block = next_block;
+         writing = true;
+         stream.async_write( boost::asio::buffer( out_buffer ), boost::asio::bind_executor( strand,
+                                [self = shared_from_this()]( boost::system::error_code ec, size_t ) { self->on_write( ec ); } ) );
+      }
+
+      void on_write( boost::system::error_code ec ) {
+         writing = false;
+         if( ec )
+            return close( ec, "write" );
+         if( rewound )
+            rewound = false;
+         else
+            next_block = sending_block + 1;
+         send_next();
+      }
+
+      void close( boost::system::error_code ec, const char* what ) {
+         if( closed )
+            return;
+         closed = true;
+         if( ec && ec != ws::error::closed && ec != boost::asio::error::operation_aborted )
+            dlog( "state delta client closed on ${w}: ${m}", ("w", what)("m", ec.message()) );
+         plugin->remove_session( this );
+      }
+
+      std::shared_ptr<state_delta_plugin_impl>                       plugin;
+      ws::stream<tcp::socket>                                        stream;
+      boost::asio::strand< boost::asio::io_context::executor_type>   strand;
+      boost::beast::flat_buffer                                      in_buffer;
+      vector<char>                                                   out_buffer;
+      bool                                                           started = false;
+      bool                                                           writing = false;
+      bool                                                           rewound = false; ///< next_block moved back while writing
+      bool                                                           closed = false;
+      uint32_t                                                       next_block = 0;
+      uint32_t                                                       sending_block = 0;
+};
+
+void state_delta_plugin_impl::on_deltas( const block_state_deltas_ptr& deltas ) {
+   try {
+      log->append( *deltas );
+   } FC_LOG_AND_DROP()
+
+   std::lock_guard<std::mutex> g( sessions_mtx );
+   for( const auto& s : sessions ) {
+      if( auto session = s.second.lock() )
+         session->notify( deltas->block_num );
+   }
+}
+
+void state_delta_plugin_impl::do_accept() {
+   socket.reset( new tcp::socket( *ioc ) );
+   acceptor->async_accept( *socket, [self = shared_from_this()]( boost::system::error_code ec ) {
+      if( ec ) {
+         if( ec == boost::system::errc::too_many_files_open )
+            self->do_accept();
+         return;
+      }
+      auto session = std::make_shared<state_delta_session>( self, std::move( *self->socket ) );
+      {
+         std::lock_guard<std::mutex> g( self->sessions_mtx );
+         self->sessions[session.get()] = session;
+      }
+      session->run();
+      self->do_accept();
+   } );
+}
+
+state_delta_plugin::state_delta_plugin():my(std::make_shared<state_delta_plugin_impl>()){}
+state_delta_plugin::~state_delta_plugin(){}
+
+void state_delta_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("state-delta-dir", bpo::value<bfs::path>()->default_value("state-deltas"),
+          "the location of the state delta log (absolute path or relative to application data dir)")
+         ("state-delta-endpoint", bpo::value<string>()->default_value("127.0.0.1:8087"),
+          "the endpoint upon which to serve the state deltas over websocket; keep it private, clients are not authenticated")
+         ;
+}
+
+void state_delta_plugin::plugin_initialize(const variables_map& options) {
+   try {
+      auto dir = options.at( "state-delta-dir" ).as<bfs::path>();
+      my->dir = dir.is_relative() ? app().data_dir() / dir : dir;
+      my->log.reset( new state_delta_log( my->dir ) );
+
+      auto endpoint = options.at( "state-delta-endpoint" ).as<string>();
+      auto c = endpoint.find( ':' );
+      EOS_ASSERT( c != string::npos, chain::plugin_config_exception, "state-delta-endpoint ${e} has no port", ("e", endpoint) );
+      my->endpoint_address = endpoint.substr( 0, c );
+      my->endpoint_port = std::stoul( endpoint.substr( c + 1 ) );
+
+      auto& chain = app().get_plugin<chain_plugin>().chain();
+      my->deltas_connection.emplace( chain.accepted_block_state_deltas.connect(
+            [&]( const block_state_deltas_ptr& deltas ) { my->on_deltas( deltas ); } ) );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+void state_delta_plugin::plugin_startup() {
+   my->ioc.reset( new boost::asio::io_context{1} );
+   tcp::endpoint endpoint{ boost::asio::ip::make_address( my->endpoint_address ), my->endpoint_port };
+   my->acceptor.reset( new tcp::acceptor( *my->ioc ) );
+   my->acceptor->open( endpoint.protocol() );
+   my->acceptor->set_option( boost::asio::socket_base::reuse_address( true ) );
+   my->acceptor->bind( endpoint );
+   my->acceptor->listen( boost::asio::socket_base::max_listen_connections );
+   my->do_accept();
+
+   auto& ioc = *my->ioc;
+   my->thread = std::thread( [&ioc]{ ioc.run(); } );
+   ilog( "serving state deltas on ${a}:${p}", ("a", my->endpoint_address)("p", my->endpoint_port) );
+}
+
+void state_delta_plugin::plugin_shutdown() {
+   my->deltas_connection.reset();
+   if( my->ioc ) {
+      my->ioc->stop();
+      if( my->thread.joinable() )
+         my->thread.join();
+   }
+   {
+      std::lock_guard<std::mutex> g( my->sessions_mtx );
+      my->sessions.clear();
+   }
+   my->acceptor.reset();
+}
+
+}
@@ -0,0 +1,94 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#pragma once
+
+#include <fc/time.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace eosio {
+
+struct latency_bucket {
+   int64_t  upper_us = 0; ///< -1 for the last bucket, which has no upper bound
+   uint64_t count = 0;
+};
+
+struct latency_summary {
+   uint64_t               count = 0;
+   int64_t                mean_us = 0;
+   int64_t                p50_us = 0;
+   int64_t                p90_us = 0;
+   int64_t                p99_us = 0;
+   int64_t                max_us = 0;
+   std::vector<latency_bucket> buckets; ///< only those with a count
+};
+
+/**
+ *  Counts of latencies in fixed buckets from 1ms to 1 minute, roughly three per decade.
+ *
+ *  Percentiles are reported as the upper bound of the bucket they fall in, capped at the largest latency recorded,
+ *  so they are never below the real value and at most about 2.5 times above it.
+ */
+class latency_histogram {
+   public:
+      latency_histogram() : _counts( bounds().size() + 1, 0 ) {}
+
+      void record( fc::microseconds latency ) {
+         auto us = std::max<int64_t>( latency.count(), 0 );
+         auto itr = std::lower_bound( bounds().begin(), bounds().end(), us );
+         ++_counts[itr - bounds().begin()];
+         ++_count;
+         _sum_us += us;
+         _max_us = std::max( _max_us, us );
+      }
+
+      latency_summary summary()const {
+         latency_summary s;
+         s.count = _count;
+         if( !_count ) return s;
+         s.mean_us = _sum_us / _count;
+         s.p50_us = percentile( 0.5 );
+         s.p90_us = percentile( 0.9 );
+         s.p99_us = percentile( 0.99 );
+         s.max_us = _max_us;
+         for( size_t i = 0; i < _counts.size(); ++i ) {
+            if( _counts[i] )
+               s.buckets.push_back( latency_bucket{ i < bounds().size() ? bounds()[i] : -1, _counts[i] } );
+         }
+         return s;
+      }
+
+   private:
+      static const std::vector<int64_t>& bounds() {
+         static const std::vector<int64_t> b = {
+            1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000,
+            1000000, 2000000, 5000000, 10000000, 20000000, 60000000
+         };
+         return b;
+      }
+
+      int64_t percentile( double p )const {
+         uint64_t rank = std::max<uint64_t>( 1, p * _count + 0.5 );
+         uint64_t seen = 0;
+         for( size_t i = 0; i < _counts.size(); ++i ) {
+            seen += _counts[i];
+            if( seen >= rank )
+               return i < bounds().size() ? std::min( bounds()[i], _max_us ) : _max_us;
+         }
+         return _max_us;
+      }
+
+      std::vector<uint64_t> _counts;
+      uint64_t              _count = 0;
+      int64_t               _sum_us = 0;
+      int64_t               _max_us = 0;
+};
+
+} // eosio
+
+FC_REFLECT(eosio::latency_bucket, (upper_us)(count))
+FC_REFLECT(eosio::latency_summary, (count)(mean_us)(p50_us)(p90_us)(p99_us)(max_us)(buckets))
@@ -3,8 +3,10 @@
  *  @copyright defined in eos/LICENSE.txt
  */
 #include <eosio/txn_test_gen_plugin/txn_test_gen_plugin.hpp>
+#include <eosio/txn_test_gen_plugin/latency_histogram.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
+#include <eosio/chain/execution_priority_queue.hpp>
 #include <eosio/utilities/key_conversion.hpp>
 
 #include <fc/variant.hpp>
@@ -15,6 +17,12 @@
 
 #include <boost/asio/high_resolution_timer.hpp>
 #include <boost/algorithm/clamp.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
 
 #include <Inline/BasicTypes.h>
 #include <IR/Module.h>
@@ -25,12 +33,34 @@
 
 #include <eosio.token/eosio.token.wast.hpp>
 #include <eosio.token/eosio.token.abi.hpp>
+#include <test_ram_limit/test_ram_limit.wast.hpp>
+#include <test_ram_limit/test_ram_limit.abi.hpp>
+#include <test.inline/test.inline.wast.hpp>
+#include <test.inline/test.inline.abi.hpp>
 
 namespace eosio { namespace detail {
   struct txn_test_gen_empty {};
+
+  struct txn_test_gen_latency_stats {
+     bool            running = false;
+     bool            open_loop = false;
+     double          target_tps = 0;
+     double          offered_tps = 0;      ///< transactions submitted per second since generation started
+     uint64_t        submitted = 0;
+     uint64_t        failed = 0;           ///< refused when submitted
+     uint64_t        dropped_arrivals = 0; ///< arrivals of the open loop the generator could not keep up with
+     uint64_t        pending = 0;          ///< submitted, not in a block yet
+     uint64_t        awaiting_irreversible = 0;
+     uint64_t        expired = 0;          ///< never seen in a block
+     uint64_t        forked_out = 0;       ///< seen in a block that did not become irreversible
+     latency_summary inclusion;            ///< from submit to the block including it being accepted
+     latency_summary irreversible;         ///< from submit to that block becoming irreversible
+  };
 }}
 
 FC_REFLECT(eosio::detail::txn_test_gen_empty, );
+FC_REFLECT(eosio::detail::txn_test_gen_latency_stats, (running)(open_loop)(target_tps)(offered_tps)(submitted)(failed)(dropped_arrivals)
+           (pending)(awaiting_irreversible)(expired)(forked_out)(inclusion)(irreversible));
 
 namespace eosio {
 
@@ -64,6 +94,9 @@ using namespace eosio::chain;
      api_handle->call_name(); \
      eosio::detail::txn_test_gen_empty result;
 
+#define INVOKE_R_V(api_handle, call_name) \
+     auto result = api_handle->call_name();
+
 #define CALL_ASYNC(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [this](string, string body, url_response_callback cb) mutable { \
@@ -88,10 +121,47 @@ using namespace eosio::chain;
    api_handle->call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>(), result_handler);
 
 struct txn_test_gen_plugin_impl {
-   static void push_next_transaction(const std::shared_ptr<std::vector<signed_transaction>>& trxs, size_t index, const std::function<void(const fc::exception_ptr&)>& next ) {
+   static const uint32_t max_account_pairs = 31 * 31;
+
+   // pair 0 is txn.test.a/txn.test.b, the others append two letters, e.g. txn.test.aab/txn.test.bab
+   static std::pair<name, name> account_pair(uint32_t i) {
+      if (i == 0)
+         return { name("txn.test.a"), name("txn.test.b") };
+      static const char letters[] = "abcdefghijklmnopqrstuvwxyz12345";
+      std::string suffix{ letters[i / 31], letters[i % 31] };
+      return { name("txn.test.a" + suffix), name("txn.test.b" + suffix) };
+   }
+
+   /// kinds of generated transactions, picked for every transaction by the weights of txn-test-gen-mix
+   enum load_kind : uint32_t {
+      transfer_load = 0,  ///< eosio.token transfer on txn.test.t
+      table_load,         ///< test_ram_limit setentry on txn.test.r, rewriting a few rows of the sender
+      inline_load,        ///< test.inline forward on txn.test.i, which sends an inline action
+      deferred_load,      ///< a transfer delayed by a second, so it is scheduled and run as a deferred transaction
+      load_kinds
+   };
+
+   static const char* load_kind_name(uint32_t k) {
+      static const char* names[] = { "transfer", "table", "inline", "deferred" };
+      return names[k];
+   }
+
+   /// the key of an account of pair i, every pair has keys of its own with txn-test-gen-distinct-keys
+   fc::crypto::private_key account_key(uint32_t i, bool first) const {
+      if (i == 0 || !distinct_keys)
+         return fc::crypto::private_key::regenerate(fc::sha256(std::string(64, first ? 'a' : 'b')));
+      auto accounts = account_pair(i);
+      return fc::crypto::private_key::regenerate(fc::sha256::hash((first ? accounts.first : accounts.second).to_string()));
+   }
+
+   void push_next_transaction(const std::shared_ptr<std::vector<signed_transaction>>& trxs, size_t index, const std::function<void(const fc::exception_ptr&)>& next ) {
       chain_plugin& cp = app().get_plugin<chain_plugin>();
+      auto id = trxs->at(index).id();
+      if (running)
+         track_submitted(id);
       cp.accept_transaction( packed_transaction(trxs->at(index)), [=](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result){
          if (result.contains<fc::exception_ptr>()) {
+            track_failed(id);
             next(result.get<fc::exception_ptr>());
          } else {
             if (index + 1 < trxs->size()) {
@@ -152,12 +222,12 @@ struct txn_test_gen_plugin_impl {
 
             trx.actions.emplace_back(vector<chain::permission_level>{{creator,"active"}}, newaccount{creator, newaccountB, owner_auth, active_auth});
             }
-            //create "txn.test.t" account
-            {
+            //create "txn.test.t" account, and "txn.test.r" and "txn.test.i" for the table and inline loads
+            for (auto contract : {newaccountC, name("txn.test.r"), name("txn.test.i")}) {
             auto owner_auth   = eosio::chain::authority{1, {{txn_text_receiver_C_pub_key, 1}}, {}};
             auto active_auth  = eosio::chain::authority{1, {{txn_text_receiver_C_pub_key, 1}}, {}};
 
-            trx.actions.emplace_back(vector<chain::permission_level>{{creator,"active"}}, newaccount{creator, newaccountC, owner_auth, active_auth});
+            trx.actions.emplace_back(vector<chain::permission_level>{{creator,"active"}}, newaccount{creator, contract, owner_auth, active_auth});
             }
 
             trx.expiration = cc.head_block_time() + fc::seconds(30);
@@ -166,6 +236,22 @@ struct txn_test_gen_plugin_impl {
             trxs.emplace_back(std::move(trx));
          }
 
+         //create the accounts of the other pairs, which share the keys of "A" and "B" unless txn-test-gen-distinct-keys is set
+         for (uint32_t first = 1; first < account_pairs; first += pairs_per_setup_trx) {
+            signed_transaction trx;
+            for (uint32_t i = first; i < std::min(first + pairs_per_setup_trx, account_pairs); ++i) {
+               auto accounts = account_pair(i);
+               auto a_auth = eosio::chain::authority{1, {{account_key(i, true).get_public_key(), 1}}, {}};
+               auto b_auth = eosio::chain::authority{1, {{account_key(i, false).get_public_key(), 1}}, {}};
+               trx.actions.emplace_back(vector<chain::permission_level>{{creator,"active"}}, newaccount{creator, accounts.first, a_auth, a_auth});
+               trx.actions.emplace_back(vector<chain::permission_level>{{creator,"active"}}, newaccount{creator, accounts.second, b_auth, b_auth});
+            }
+            trx.expiration = cc.head_block_time() + fc::seconds(30);
+            trx.set_reference_block(cc.head_block_id());
+            trx.sign(creator_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
+
          //set txn.test.t contract to eosio.token & initialize it
          {
             signed_transaction trx;
@@ -198,7 +284,8 @@ struct txn_test_gen_plugin_impl {
                act.account = N(txn.test.t);
                act.name = N(issue);
                act.authorization = vector<permission_level>{{newaccountC,config::active_name}};
-               act.data = eosio_token_serializer.variant_to_binary("issue", fc::json::from_string("{\"to\":\"txn.test.t\",\"quantity\":\"600.0000 CUR\",\"memo\":\"\"}"), abi_serializer_max_time);
+               act.data = eosio_token_serializer.variant_to_binary("issue", fc::json::from_string(fc::format_string("{\"to\":\"txn.test.t\",\"quantity\":\"${q}.0000 CUR\",\"memo\":\"\"}",
+                                                                  fc::mutable_variant_object()("q", 200 + 400 * account_pairs))), abi_serializer_max_time);
                trx.actions.push_back(act);
             }
             {
@@ -224,6 +311,50 @@ struct txn_test_gen_plugin_impl {
             trx.sign(txn_test_receiver_C_priv_key, chainid);
             trxs.emplace_back(std::move(trx));
          }
+
+         //set txn.test.r contract to test_ram_limit and txn.test.i to test.inline
+         {
+            signed_transaction trx;
+            for (auto code : { std::make_pair(name("txn.test.r"), std::make_pair(test_ram_limit_wast, test_ram_limit_abi)),
+                               std::make_pair(name("txn.test.i"), std::make_pair(test_inline_wast, test_inline_abi)) }) {
+               vector<uint8_t> wasm = wast_to_wasm(std::string(code.second.first));
+
+               setcode handler;
+               handler.account = code.first;
+               handler.code.assign(wasm.begin(), wasm.end());
+               trx.actions.emplace_back( vector<chain::permission_level>{{code.first,"active"}}, handler);
+
+               setabi abi_handler;
+               abi_handler.account = code.first;
+               abi_handler.abi = fc::raw::pack(json::from_string(code.second.second).as<abi_def>());
+               trx.actions.emplace_back( vector<chain::permission_level>{{code.first,"active"}}, abi_handler);
+            }
+            trx.expiration = cc.head_block_time() + fc::seconds(30);
+            trx.set_reference_block(cc.head_block_id());
+            trx.sign(txn_test_receiver_C_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
+
+         //fund the other pairs like "A" and "B"
+         for (uint32_t first = 1; first < account_pairs; first += pairs_per_setup_trx) {
+            signed_transaction trx;
+            for (uint32_t i = first; i < std::min(first + pairs_per_setup_trx, account_pairs); ++i) {
+               auto accounts = account_pair(i);
+               for (const auto& to : {accounts.first, accounts.second}) {
+                  action act;
+                  act.account = N(txn.test.t);
+                  act.name = N(transfer);
+                  act.authorization = vector<permission_level>{{newaccountC,config::active_name}};
+                  act.data = eosio_token_serializer.variant_to_binary("transfer", fc::json::from_string(fc::format_string("{\"from\":\"txn.test.t\",\"to\":\"${to}\",\"quantity\":\"200.0000 CUR\",\"memo\":\"\"}",
+                                                                     fc::mutable_variant_object()("to", to.to_string()))), abi_serializer_max_time);
+                  trx.actions.push_back(act);
+               }
+            }
+            trx.expiration = cc.head_block_time() + fc::seconds(30);
+            trx.set_reference_block(cc.head_block_id());
+            trx.sign(txn_test_receiver_C_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
       } catch (const fc::exception& e) {
          next(e.dynamic_copy_exception());
          return;
@@ -242,36 +373,118 @@ struct txn_test_gen_plugin_impl {
       if(batch_size & 1)
          throw fc::exception(fc::invalid_operation_exception_code);
 
-      running = true;
-
-      controller& cc = app().get_plugin<chain_plugin>().chain();
-      auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
-      abi_serializer eosio_token_serializer{fc::json::from_string(eosio_token_abi).as<abi_def>(), abi_serializer_max_time};
-      //create the actions here
-      act_a_to_b.account = N(txn.test.t);
-      act_a_to_b.name = N(transfer);
-      act_a_to_b.authorization = vector<permission_level>{{name("txn.test.a"),config::active_name}};
-      act_a_to_b.data = eosio_token_serializer.variant_to_binary("transfer", 
-                                                                  fc::json::from_string(fc::format_string("{\"from\":\"txn.test.a\",\"to\":\"txn.test.b\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}", 
-                                                                  fc::mutable_variant_object()("l", salt))),
-                                                                  abi_serializer_max_time);
-
-      act_b_to_a.account = N(txn.test.t);
-      act_b_to_a.name = N(transfer);
-      act_b_to_a.authorization = vector<permission_level>{{name("txn.test.b"),config::active_name}};
-      act_b_to_a.data = eosio_token_serializer.variant_to_binary("transfer", 
-                                                                  fc::json::from_string(fc::format_string("{\"from\":\"txn.test.b\",\"to\":\"txn.test.a\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}", 
-                                                                  fc::mutable_variant_object()("l", salt))),
-                                                                  abi_serializer_max_time);
-
+      prepare_generation(salt);
+      open_loop = false;
       timer_timeout = period;
       batch = batch_size/2;
 
-      ilog("Started transaction test plugin; performing ${p} transactions every ${m}ms", ("p", batch_size)("m", period));
+      ilog("Started transaction test plugin; performing ${p} transactions every ${m}ms between ${n} account pairs, mix ${x}",
+           ("p", batch_size)("m", period)("n", account_pairs)("x", mix_description()));
 
       arm_timer(boost::asio::high_resolution_timer::clock_type::now());
    }
 
+   /**
+    *  Submits transactions at Poisson distributed arrival times averaging tps per second, whether or not the earlier
+    *  ones were accepted yet; failures are counted rather than stopping the generation.
+    */
+   void start_open_loop(const std::string& salt, const uint64_t& tps) {
+      if(running)
+         throw fc::exception(fc::invalid_operation_exception_code);
+      if(tps < 1 || tps > max_open_loop_tps)
+         throw fc::exception(fc::invalid_operation_exception_code);
+
+      prepare_generation(salt);
+      open_loop = true;
+      target_tps = tps;
+      arrivals = std::exponential_distribution<double>(tps);
+      next_arrival = boost::asio::high_resolution_timer::clock_type::now();
+
+      ilog("Started transaction test plugin; offering ${t} transactions per second between ${n} account pairs, mix ${x}",
+           ("t", tps)("n", account_pairs)("x", mix_description()));
+
+      arm_open_loop_timer();
+   }
+
+   void prepare_generation(const std::string& salt) {
+      running = true;
+      stats = txn_test_gen_latency_stats_state();
+      started = fc::time_point::now();
+
+      controller& cc = app().get_plugin<chain_plugin>().chain();
+      auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
+      abi_serializer eosio_token_serializer{fc::json::from_string(eosio_token_abi).as<abi_def>(), abi_serializer_max_time};
+      abi_serializer ram_serializer{fc::json::from_string(test_ram_limit_abi).as<abi_def>(), abi_serializer_max_time};
+      abi_serializer inline_serializer{fc::json::from_string(test_inline_abi).as<abi_def>(), abi_serializer_max_time};
+      //create the actions here, one of every kind and direction per account pair
+      auto make_transfer = [&](name from, name to) {
+         action act;
+         act.account = N(txn.test.t);
+         act.name = N(transfer);
+         act.authorization = vector<permission_level>{{from,config::active_name}};
+         act.data = eosio_token_serializer.variant_to_binary("transfer",
+                                                             fc::json::from_string(fc::format_string("{\"from\":\"${f}\",\"to\":\"${t}\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}",
+                                                             fc::mutable_variant_object()("f", from.to_string())("t", to.to_string())("l", salt))),
+                                                             abi_serializer_max_time);
+         return act;
+      };
+      // rewrites the same few rows of the sender, so that the table load does not grow RAM without bound
+      auto make_setentry = [&](name from, uint32_t pair) {
+         action act;
+         act.account = N(txn.test.r);
+         act.name = N(setentry);
+         act.authorization = vector<permission_level>{{from,config::active_name}};
+         act.data = ram_serializer.variant_to_binary("setentry",
+                                                     fc::mutable_variant_object()("payer", from)("from", pair * 8)("to", pair * 8 + 3)("size", 64),
+                                                     abi_serializer_max_time);
+         return act;
+      };
+      auto make_forward = [&](name from) {
+         action act;
+         act.account = N(txn.test.i);
+         act.name = N(forward);
+         act.authorization = vector<permission_level>{{from,config::active_name}};
+         act.data = inline_serializer.variant_to_binary("forward",
+                                                        fc::mutable_variant_object()("reqauth", from)("forward_code", "txn.test.i")("forward_auth", "txn.test.i"),
+                                                        abi_serializer_max_time);
+         return act;
+      };
+      for (auto& acts : actions) {
+         acts[0].clear();
+         acts[1].clear();
+      }
+      for (uint32_t i = 0; i < account_pairs; ++i) {
+         auto accounts = account_pair(i);
+         auto a_to_b = make_transfer(accounts.first, accounts.second);
+         auto b_to_a = make_transfer(accounts.second, accounts.first);
+         actions[transfer_load][0].push_back(a_to_b);
+         actions[transfer_load][1].push_back(b_to_a);
+         actions[deferred_load][0].push_back(a_to_b);
+         actions[deferred_load][1].push_back(b_to_a);
+         actions[table_load][0].push_back(make_setentry(accounts.first, 2 * i));
+         actions[table_load][1].push_back(make_setentry(accounts.second, 2 * i + 1));
+         actions[inline_load][0].push_back(make_forward(accounts.first));
+         actions[inline_load][1].push_back(make_forward(accounts.second));
+      }
+      next_pair = 0;
+
+      // cumulative weights of the pairs for a zipf distributed choice, pair 0 being the most popular
+      pair_cdf.clear();
+      if (zipf_exponent > 0) {
+         double sum = 0;
+         for (uint32_t i = 0; i < account_pairs; ++i) {
+            sum += 1.0 / std::pow(i + 1, zipf_exponent);
+            pair_cdf.push_back(sum);
+         }
+      }
+      keys[0].clear();
+      keys[1].clear();
+      for (uint32_t i = 0; i < account_pairs; ++i) {
+         keys[0].push_back(account_key(i, true));
+         keys[1].push_back(account_key(i, false));
+      }
+   }
+
    void arm_timer(boost::asio::high_resolution_timer::time_point s) {
       timer.expires_at(s + std::chrono::milliseconds(timer_timeout));
       timer.async_wait([this](const boost::system::error_code& ec) {
@@ -289,61 +502,229 @@ struct txn_test_gen_plugin_impl {
       });
    }
 
-   void send_transaction(std::function<void(const fc::exception_ptr&)> next) {
-      std::vector<signed_transaction> trxs;
-      trxs.reserve(2*batch);
+   void arm_open_loop_timer() {
+      timer.expires_at(next_arrival);
+      timer.async_wait([this](const boost::system::error_code& ec) {
+         if(!running || ec)
+            return;
 
-      try {
-         controller& cc = app().get_plugin<chain_plugin>().chain();
-         auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
-         auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
+         // every arrival that is due is sent now; a backlog beyond what one wakeup may send is dropped and counted,
+         // so that a generator which cannot keep up does not turn into a closed loop
+         auto now = boost::asio::high_resolution_timer::clock_type::now();
+         uint32_t due = 0;
+         while (next_arrival <= now) {
+            if (due < max_open_loop_burst)
+               ++due;
+            else
+               ++stats.dropped_arrivals;
+            next_arrival += std::chrono::duration_cast<boost::asio::high_resolution_timer::duration>(
+                               std::chrono::duration<double>(arrivals(rng)));
+         }
 
-         fc::crypto::private_key a_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
-         fc::crypto::private_key b_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
+         auto trxs = std::make_shared<std::vector<signed_transaction>>();
+         auto signers = std::make_shared<std::vector<fc::crypto::private_key>>();
+         try {
+            make_transactions(due, *trxs, *signers);
+         } catch ( const fc::exception& e ) {
+            elog("creating transactions failed: ${e}", ("e", e.to_detail_string()));
+            stop_generation();
+            return;
+         }
+         sign_transactions(trxs, signers, [this](const std::shared_ptr<std::vector<signed_transaction>>& trxs) {
+            chain_plugin& cp = app().get_plugin<chain_plugin>();
+            for (const auto& trx : *trxs) {
+               auto id = trx.id();
+               track_submitted(id);
+               cp.accept_transaction( packed_transaction(trx), [this, id](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result){
+                  if (result.contains<fc::exception_ptr>()) {
+                     track_failed(id);
+                     dlog("pushing transaction failed: ${e}", ("e", result.get<fc::exception_ptr>()->to_string()));
+                  }
+               });
+            }
+         });
+         arm_open_loop_timer();
+      });
+   }
 
-         static uint64_t nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
-         abi_serializer eosio_serializer(cc.db().find<account_object, by_name>(config::system_account_name)->get_abi(), abi_serializer_max_time);
+   uint32_t pick_pair() {
+      if (pair_cdf.empty())
+         return next_pair++ % account_pairs;
+      std::uniform_real_distribution<double> d(0, pair_cdf.back());
+      return std::lower_bound(pair_cdf.begin(), pair_cdf.end(), d(rng)) - pair_cdf.begin();
+   }
 
-         uint32_t reference_block_num = cc.last_irreversible_block_num();
-         if (txn_reference_block_lag >= 0) {
-            reference_block_num = cc.head_block_num();
-            if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
-               reference_block_num = 0;
-            } else {
-               reference_block_num -= (uint32_t)txn_reference_block_lag;
-            }
-         }
+   uint32_t pick_kind() {
+      std::uniform_real_distribution<double> d(0, mix_weights.back());
+      return std::lower_bound(mix_weights.begin(), mix_weights.end(), d(rng)) - mix_weights.begin();
+   }
 
-         block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
+   std::string mix_description() const {
+      std::string desc;
+      double previous = 0;
+      for (uint32_t k = 0; k < load_kinds; ++k) {
+         if (mix_weights[k] > previous)
+            desc += (desc.empty() ? "" : ",") + std::string(load_kind_name(k)) + ":" + fc::to_string(mix_weights[k] - previous);
+         previous = mix_weights[k];
+      }
+      return desc;
+   }
 
-         for(unsigned int i = 0; i < batch; ++i) {
-         {
-         signed_transaction trx;
-         trx.actions.push_back(act_a_to_b);
-         trx.context_free_actions.emplace_back(action({}, config::null_account_name, "nonce", fc::raw::pack(nonce++)));
-         trx.set_reference_block(reference_block_id);
-         trx.expiration = cc.head_block_time() + fc::seconds(30);
-         trx.max_net_usage_words = 100;
-         trx.sign(a_priv_key, chainid);
-         trxs.emplace_back(std::move(trx));
+   void make_transactions(uint32_t count, std::vector<signed_transaction>& trxs, std::vector<fc::crypto::private_key>& signers) {
+      controller& cc = app().get_plugin<chain_plugin>().chain();
+
+      static uint64_t nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
+
+      uint32_t reference_block_num = cc.last_irreversible_block_num();
+      if (txn_reference_block_lag >= 0) {
+         reference_block_num = cc.head_block_num();
+         if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
+            reference_block_num = 0;
+         } else {
+            reference_block_num -= (uint32_t)txn_reference_block_lag;
          }
+      }
+
+      block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
+
+      trxs.reserve(count);
+      signers.reserve(count);
+      for(unsigned int i = 0; i < count; ++i) {
+         uint32_t pair = pick_pair();
+         uint32_t direction = next_direction++ & 1;
+         uint32_t kind = pick_kind();
 
-         {
          signed_transaction trx;
-         trx.actions.push_back(act_b_to_a);
+         trx.actions.push_back(actions[kind][direction][pair]);
          trx.context_free_actions.emplace_back(action({}, config::null_account_name, "nonce", fc::raw::pack(nonce++)));
          trx.set_reference_block(reference_block_id);
          trx.expiration = cc.head_block_time() + fc::seconds(30);
          trx.max_net_usage_words = 100;
-         trx.sign(b_priv_key, chainid);
+         if (kind == deferred_load)
+            trx.delay_sec = 1;
          trxs.emplace_back(std::move(trx));
-         }
-         }
+         signers.push_back(keys[direction][pair]);
+      }
+   }
+
+   /// signs on the signing threads if there are any, done is called on the main thread unless generation was stopped meanwhile
+   void sign_transactions(const std::shared_ptr<std::vector<signed_transaction>>& trxs,
+                          const std::shared_ptr<std::vector<fc::crypto::private_key>>& signers,
+                          const std::function<void(const std::shared_ptr<std::vector<signed_transaction>>&)>& done) {
+      auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
+      if (sign_threads.empty() || trxs->empty()) {
+         for (size_t i = 0; i < trxs->size(); ++i)
+            trxs->at(i).sign(signers->at(i), chainid);
+         done(trxs);
+         return;
+      }
+
+      // every signing thread takes a slice, and the last one to finish hands the batch back to the main thread
+      auto pending = std::make_shared<std::atomic<uint32_t>>(sign_threads.size());
+      size_t slice = (trxs->size() + sign_threads.size() - 1) / sign_threads.size();
+      for (size_t t = 0; t < sign_threads.size(); ++t) {
+         sign_ios.post([this, trxs, signers, pending, chainid, done, first = t * slice, slice]() {
+            for (size_t i = first; i < std::min(first + slice, trxs->size()); ++i)
+               trxs->at(i).sign(signers->at(i), chainid);
+            if (--(*pending) == 0) {
+               plugin_interface::app_post(plugin_interface::priority::low, [this, trxs, done]() {
+                  if (running)
+                     done(trxs);
+               });
+            }
+         });
+      }
+   }
+
+   void send_transaction(std::function<void(const fc::exception_ptr&)> next) {
+      auto trxs = std::make_shared<std::vector<signed_transaction>>();
+      auto signers = std::make_shared<std::vector<fc::crypto::private_key>>();
+
+      try {
+         make_transactions(2*batch, *trxs, *signers);
       } catch ( const fc::exception& e ) {
          next(e.dynamic_copy_exception());
+         return;
       }
 
-      push_transactions(std::move(trxs), next);
+      sign_transactions(trxs, signers, [this, next](const std::shared_ptr<std::vector<signed_transaction>>& trxs) {
+         push_transactions(std::move(*trxs), next);
+      });
+   }
+
+   void track_submitted(const transaction_id_type& id) {
+      ++stats.submitted;
+      pending_trxs.emplace(id, fc::time_point::now());
+   }
+
+   void track_failed(const transaction_id_type& id) {
+      if (pending_trxs.erase(id))
+         ++stats.failed;
+   }
+
+   /// moves the generated transactions of the block from pending to awaiting irreversibility
+   void on_accepted_block(const block_state_ptr& bsp) {
+      if (pending_trxs.empty())
+         return;
+      auto now = fc::time_point::now();
+      for (const auto& receipt : bsp->block->transactions) {
+         const auto& id = receipt.trx.contains<transaction_id_type>() ? receipt.trx.get<transaction_id_type>()
+                                                                      : receipt.trx.get<packed_transaction>().id();
+         auto itr = pending_trxs.find(id);
+         if (itr == pending_trxs.end())
+            continue;
+         stats.inclusion.record(now - itr->second);
+         included_trxs[bsp->block_num].push_back(included_trx{bsp->id, itr->second});
+         pending_trxs.erase(itr);
+      }
+
+      // what is still pending after it expired will never make it into a block
+      for (auto itr = pending_trxs.begin(); itr != pending_trxs.end(); ) {
+         if (now - itr->second > pending_timeout) {
+            ++stats.expired;
+            itr = pending_trxs.erase(itr);
+         } else {
+            ++itr;
+         }
+      }
+   }
+
+   void on_irreversible_block(const block_state_ptr& bsp) {
+      auto now = fc::time_point::now();
+      auto end = included_trxs.upper_bound(bsp->block_num);
+      for (auto itr = included_trxs.begin(); itr != end; ++itr) {
+         // entries of an older block number whose block was not the one that became irreversible were forked out,
+         // as were those of this block number included by another block
+         bool irreversible = itr->first == bsp->block_num;
+         for (const auto& t : itr->second) {
+            if (irreversible && t.block_id == bsp->id)
+               stats.irreversible.record(now - t.submitted);
+            else
+               ++stats.forked_out;
+         }
+      }
+      included_trxs.erase(included_trxs.begin(), end);
+   }
+
+   detail::txn_test_gen_latency_stats get_latency_stats() {
+      detail::txn_test_gen_latency_stats result;
+      result.running = running;
+      result.open_loop = open_loop;
+      result.target_tps = open_loop ? target_tps : 0;
+      auto elapsed = fc::time_point::now() - started;
+      if (elapsed.count() > 0)
+         result.offered_tps = stats.submitted * 1000000.0 / elapsed.count();
+      result.submitted = stats.submitted;
+      result.failed = stats.failed;
+      result.dropped_arrivals = stats.dropped_arrivals;
+      result.pending = pending_trxs.size();
+      for (const auto& b : included_trxs)
+         result.awaiting_irreversible += b.second.size();
+      result.expired = stats.expired;
+      result.forked_out = stats.forked_out;
+      result.inclusion = stats.inclusion.summary();
+      result.irreversible = stats.irreversible.summary();
+      return result;
    }
 
    void stop_generation() {
@@ -359,11 +740,57 @@ struct txn_test_gen_plugin_impl {
 
    unsigned timer_timeout;
    unsigned batch;
-
-   action act_a_to_b;
-   action act_b_to_a;
+   uint32_t next_direction = 0;
+
+   static const uint64_t max_open_loop_tps = 100000;
+   static const uint32_t max_open_loop_burst = 1000;
+   bool open_loop = false;
+   double target_tps = 0;
+   std::exponential_distribution<double> arrivals;
+   boost::asio::high_resolution_timer::time_point next_arrival;
+
+   // latency tracking of the generated transactions, kept after generation stops until the next one starts, so
+   // that the transactions still in flight are accounted for
+   struct txn_test_gen_latency_stats_state {
+      uint64_t          submitted = 0;
+      uint64_t          failed = 0;
+      uint64_t          dropped_arrivals = 0;
+      uint64_t          expired = 0;
+      uint64_t          forked_out = 0;
+      latency_histogram inclusion;
+      latency_histogram irreversible;
+   };
+   struct included_trx {
+      block_id_type  block_id;
+      fc::time_point submitted;
+   };
+   const fc::microseconds pending_timeout = fc::seconds(60);
+   txn_test_gen_latency_stats_state stats;
+   fc::time_point started;
+   std::map<transaction_id_type, fc::time_point> pending_trxs;      ///< submit time by id
+   std::map<uint32_t, std::vector<included_trx>> included_trxs;     ///< by block number
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+   fc::optional<boost::signals2::scoped_connection> irreversible_block_connection;
+
+   // actions of every kind, direction (a to b, b to a) and account pair; without txn-test-gen-zipf-exponent the pairs
+   // are handed out round robin so that consecutive transactions touch disjoint accounts
+   std::vector<action> actions[load_kinds][2];
+   std::vector<fc::crypto::private_key> keys[2];
+   uint32_t next_pair = 0;
+
+   std::vector<double> mix_weights; ///< cumulative, by load_kind
+   double zipf_exponent = 0;
+   std::vector<double> pair_cdf;
+   std::mt19937_64 rng{std::random_device{}()};
+   bool distinct_keys = false;
+
+   boost::asio::io_service sign_ios;
+   fc::optional<boost::asio::io_service::work> sign_work;
+   std::vector<std::thread> sign_threads;
 
    int32_t txn_reference_block_lag;
+   uint32_t account_pairs = 1;
+   static const uint32_t pairs_per_setup_trx = 10;
 };
 
 txn_test_gen_plugin::txn_test_gen_plugin() {}
@@ -372,6 +799,16 @@ txn_test_gen_plugin::~txn_test_gen_plugin() {}
 void txn_test_gen_plugin::set_program_options(options_description&, options_description& cfg) {
    cfg.add_options()
       ("txn-reference-block-lag", bpo::value<int32_t>()->default_value(0), "Lag in number of blocks from the head block when selecting the reference block for transactions (-1 means Last Irreversible Block)")
+      ("txn-test-gen-account-pairs", bpo::value<uint32_t>()->default_value(1), "Number of disjoint account pairs the generated transfers are spread over (at most 961)")
+      ("txn-test-gen-mix", bpo::value<string>()->default_value("transfer:100"),
+       "Relative weights of the generated transaction kinds, as a comma separated list of kind:weight. Kinds are "
+       "transfer (eosio.token), table (multi_index writes), inline (an action sending an inline action) and deferred (a delayed transfer)")
+      ("txn-test-gen-zipf-exponent", bpo::value<double>()->default_value(0),
+       "Pick the account pair of every transaction from a Zipf distribution with this exponent instead of round robin; 0 disables")
+      ("txn-test-gen-sign-threads", bpo::value<uint32_t>()->default_value(0),
+       "Number of threads signing the generated transactions; 0 signs them on the main thread")
+      ("txn-test-gen-distinct-keys", bpo::bool_switch()->default_value(false),
+       "Give every account but txn.test.a and txn.test.b a key of its own, derived from its name, when the test accounts are created")
    ;
 }
 
@@ -379,6 +816,41 @@ void txn_test_gen_plugin::plugin_initialize(const variables_map& options) {
    try {
       my.reset( new txn_test_gen_plugin_impl );
       my->txn_reference_block_lag = options.at( "txn-reference-block-lag" ).as<int32_t>();
+      my->account_pairs = options.at( "txn-test-gen-account-pairs" ).as<uint32_t>();
+      EOS_ASSERT( my->account_pairs >= 1 && my->account_pairs <= txn_test_gen_plugin_impl::max_account_pairs, chain::plugin_config_exception,
+                  "txn-test-gen-account-pairs must be between 1 and ${max}", ("max", uint32_t(txn_test_gen_plugin_impl::max_account_pairs)) );
+
+      std::vector<double> weights(txn_test_gen_plugin_impl::load_kinds, 0);
+      std::vector<std::string> entries;
+      auto mix = options.at( "txn-test-gen-mix" ).as<string>();
+      boost::split( entries, mix, boost::is_any_of( "," ));
+      for( const auto& entry : entries ) {
+         std::vector<std::string> v;
+         boost::split( v, entry, boost::is_any_of( ":" ));
+         EOS_ASSERT( v.size() == 2, chain::plugin_config_exception, "Invalid entry ${e} of txn-test-gen-mix", ("e", entry) );
+         uint32_t k = 0;
+         while( k < txn_test_gen_plugin_impl::load_kinds && v[0] != txn_test_gen_plugin_impl::load_kind_name(k) ) ++k;
+         EOS_ASSERT( k < txn_test_gen_plugin_impl::load_kinds, chain::plugin_config_exception, "Unknown transaction kind ${k} in txn-test-gen-mix", ("k", v[0]) );
+         weights[k] = std::stod( v[1] );
+         EOS_ASSERT( weights[k] >= 0, chain::plugin_config_exception, "Negative weight in txn-test-gen-mix" );
+      }
+      double sum = 0;
+      for( auto w : weights ) {
+         sum += w;
+         my->mix_weights.push_back( sum );
+      }
+      EOS_ASSERT( sum > 0, chain::plugin_config_exception, "txn-test-gen-mix needs a positive weight" );
+
+      my->zipf_exponent = options.at( "txn-test-gen-zipf-exponent" ).as<double>();
+      EOS_ASSERT( my->zipf_exponent >= 0, chain::plugin_config_exception, "txn-test-gen-zipf-exponent must not be negative" );
+      my->distinct_keys = options.at( "txn-test-gen-distinct-keys" ).as<bool>();
+
+      auto threads = options.at( "txn-test-gen-sign-threads" ).as<uint32_t>();
+      if( threads > 0 ) {
+         my->sign_work.emplace( my->sign_ios );
+         for( uint32_t i = 0; i < threads; ++i )
+            my->sign_threads.emplace_back( [ios = &my->sign_ios]() { ios->run(); } );
+      }
    } FC_LOG_AND_RETHROW()
 }
 
@@ -386,8 +858,18 @@ void txn_test_gen_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
       CALL_ASYNC(txn_test_gen, my, create_test_accounts, INVOKE_ASYNC_R_R(my, create_test_accounts, std::string, std::string), 200),
       CALL(txn_test_gen, my, stop_generation, INVOKE_V_V(my, stop_generation), 200),
-      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200)
+      CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200),
+      CALL(txn_test_gen, my, start_open_loop, INVOKE_V_R_R(my, start_open_loop, std::string, uint64_t), 200),
+      CALL(txn_test_gen, my, get_latency_stats, INVOKE_R_V(my, get_latency_stats), 200)
    });
+
+   controller& cc = app().get_plugin<chain_plugin>().chain();
+   my->accepted_block_connection.emplace(cc.accepted_block.connect( [this]( const block_state_ptr& bsp ) {
+      my->on_accepted_block( bsp );
+   }));
+   my->irreversible_block_connection.emplace(cc.irreversible_block.connect( [this]( const block_state_ptr& bsp ) {
+      my->on_irreversible_block( bsp );
+   }));
 }
 
 void txn_test_gen_plugin::plugin_shutdown() {
@@ -396,6 +878,13 @@ void txn_test_gen_plugin::plugin_shutdown() {
    }
    catch(fc::exception e) {
    }
+   my->accepted_block_connection.reset();
+   my->irreversible_block_connection.reset();
+   my->sign_work.reset();
+   my->sign_ios.stop();
+   for( auto& t : my->sign_threads )
+      t.join();
+   my->sign_threads.clear();
 }
 
 }
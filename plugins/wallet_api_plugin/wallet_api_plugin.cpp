@@ -79,6 +79,8 @@ void wallet_api_plugin::plugin_startup() {
             INVOKE_V_R(wallet_mgr, set_timeout, int64_t), 200),
        CALL(wallet, wallet_mgr, sign_transaction,
             INVOKE_R_R_R_R(wallet_mgr, sign_transaction, chain::signed_transaction, flat_set<public_key_type>, chain::chain_id_type), 201),
+       CALL(wallet, wallet_mgr, sign_transactions,
+            INVOKE_R_R_R_R(wallet_mgr, sign_transactions, std::vector<chain::signed_transaction>, flat_set<public_key_type>, chain::chain_id_type), 201),
        CALL(wallet, wallet_mgr, sign_digest,
             INVOKE_R_R_R(wallet_mgr, sign_digest, chain::digest_type, public_key_type), 201),
        CALL(wallet, wallet_mgr, create,
@@ -183,6 +183,10 @@ class soft_wallet final : public wallet_api
       */
       optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) override;
 
+      /* Signing only reads the decrypted keys
+      */
+      bool supports_concurrent_signing() const override { return true; }
+
       std::shared_ptr<detail::soft_wallet_impl> my;
       void encrypt_keys();
 };
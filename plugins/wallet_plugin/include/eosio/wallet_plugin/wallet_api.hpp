@@ -102,6 +102,10 @@ class wallet_api
       /** Returns a signature given the digest and public_key, if this wallet can sign via that public key
        */
       virtual optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) = 0;
+
+      /** Whether try_sign_digest may be called from several threads at once while the wallet is unlocked
+       */
+      virtual bool supports_concurrent_signing() const { return false; }
 };
 
 }}
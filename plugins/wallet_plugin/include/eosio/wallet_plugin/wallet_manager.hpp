@@ -42,6 +42,10 @@ public:
    /// @see wallet_manager::set_timeout(const std::chrono::seconds& t)
    /// @param secs The timeout in seconds.
    void set_timeout(int64_t secs) { set_timeout(std::chrono::seconds(secs)); }
+
+   /// Set the number of threads sign_transactions spreads a batch over.
+   /// @param n number of threads, 0 for one per hardware thread.
+   void set_sign_threads(uint32_t n) { sign_threads = n; }
       
    /// Sign transaction with the private keys specified via their public keys.
    /// Use chain_controller::get_required_keys to determine which keys are needed for txn.
@@ -53,6 +57,17 @@ public:
    chain::signed_transaction sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys,
                                              const chain::chain_id_type& id);
 
+   /// Sign a batch of transactions, each with all of the given keys, as sign_transaction would.
+   /// The wallet of each key is looked up once for the whole batch, and the transactions are signed on
+   /// several threads when every wallet involved supports concurrent signing.
+   /// @param txns the transactions to sign.
+   /// @param keys the public keys of the corresponding private keys to sign every transaction with
+   /// @param id the chain_id to sign the transactions with.
+   /// @return txns signed, in the same order
+   /// @throws fc::exception if corresponding private keys not found in unlocked wallets
+   std::vector<chain::signed_transaction> sign_transactions(const std::vector<chain::signed_transaction>& txns,
+                                                            const flat_set<public_key_type>& keys,
+                                                            const chain::chain_id_type& id);
 
    /// Sign digest with the private keys specified via their public keys.
    /// @param digest the digest to sign.
@@ -138,6 +153,7 @@ private:
    std::map<std::string, std::unique_ptr<wallet_api>> wallets;
    std::chrono::seconds timeout = std::chrono::seconds::max(); ///< how long to wait before calling lock_all()
    mutable timepoint_t timeout_time = timepoint_t::max(); ///< when to call lock_all()
+   uint32_t sign_threads = 0; ///< threads of sign_transactions, 0 for one per hardware thread
    boost::filesystem::path dir = ".";
    boost::filesystem::path lock_path = dir / "wallet.lock";
    std::unique_ptr<boost::interprocess::file_lock> wallet_dir_lock;
@@ -7,6 +7,8 @@
 #include <eosio/wallet_plugin/se_wallet.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <boost/algorithm/string.hpp>
+#include <future>
+#include <thread>
 namespace eosio {
 namespace wallet {
 
@@ -231,12 +233,13 @@ chain::signed_transaction
 wallet_manager::sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
    check_timeout();
    chain::signed_transaction stxn(txn);
+   const auto digest = stxn.sig_digest(id, stxn.context_free_data);
 
    for (const auto& pk : keys) {
       bool found = false;
       for (const auto& i : wallets) {
          if (!i.second->is_locked()) {
-            optional<signature_type> sig = i.second->try_sign_digest(stxn.sig_digest(id, stxn.context_free_data), pk);
+            optional<signature_type> sig = i.second->try_sign_digest(digest, pk);
             if (sig) {
                stxn.signatures.push_back(*sig);
                found = true;
@@ -252,6 +255,66 @@ wallet_manager::sign_transaction(const chain::signed_transaction& txn, const fla
    return stxn;
 }
 
+std::vector<chain::signed_transaction>
+wallet_manager::sign_transactions(const std::vector<chain::signed_transaction>& txns, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
+   check_timeout();
+
+   // the unlocked wallet signing for each key, the first one holding it like sign_transaction
+   std::vector<std::pair<public_key_type, wallet_api*>> signers;
+   signers.reserve(keys.size());
+   bool concurrent = true;
+   {
+      std::map<public_key_type, wallet_api*> holders;
+      for (const auto& i : wallets) {
+         if (!i.second->is_locked()) {
+            for (const auto& pk : i.second->list_public_keys())
+               holders.emplace(pk, i.second.get());
+         }
+      }
+      for (const auto& pk : keys) {
+         auto it = holders.find(pk);
+         if (it == holders.end()) {
+            EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+         }
+         signers.emplace_back(pk, it->second);
+         concurrent = concurrent && it->second->supports_concurrent_signing();
+      }
+   }
+
+   std::vector<chain::signed_transaction> signed_txns(txns);
+   auto sign = [&](size_t begin, size_t end) {
+      for (size_t t = begin; t < end; ++t) {
+         auto& stxn = signed_txns[t];
+         const auto digest = stxn.sig_digest(id, stxn.context_free_data);
+         for (const auto& s : signers) {
+            optional<signature_type> sig = s.second->try_sign_digest(digest, s.first);
+            EOS_ASSERT(sig, chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", s.first));
+            stxn.signatures.push_back(*sig);
+         }
+      }
+   };
+
+   size_t thread_count = sign_threads ? sign_threads : std::max(1u, std::thread::hardware_concurrency());
+   if (!concurrent)
+      thread_count = 1;
+   if (thread_count == 1 || signed_txns.size() < 2) {
+      sign(0, signed_txns.size());
+      return signed_txns;
+   }
+
+   // the wallets are not touched by anything else until every thread is done, since this call blocks the caller
+   const size_t per_thread = (signed_txns.size() + thread_count - 1) / thread_count;
+   std::vector<std::future<void>> done;
+   for (size_t begin = 0; begin < signed_txns.size(); begin += per_thread)
+      done.emplace_back(std::async(std::launch::async, sign, begin, std::min(signed_txns.size(), begin + per_thread)));
+   for (auto& f : done)
+      f.wait();
+   for (auto& f : done)
+      f.get();
+
+   return signed_txns;
+}
+
 chain::signature_type
 wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_type& key) {
    check_timeout();
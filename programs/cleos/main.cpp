@@ -77,6 +77,8 @@ Options:
 #include <vector>
 #include <regex>
 #include <iostream>
+#include <deque>
+#include <future>
 #include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
 #include <fc/io/datastream.hpp>
@@ -182,6 +184,8 @@ bool   tx_print_json = false;
 bool   print_request = false;
 bool   print_response = false;
 bool   no_auto_keosd = false;
+string abi_cache_dir; //to be set to the default in main
+bool   no_abi_cache = false;
 
 uint8_t  tx_max_cpu_usage = 0;
 uint32_t tx_max_net_usage = 0;
@@ -371,17 +375,51 @@ void print_action( const fc::variant& at ) {
    }
 }
 
+/// the packed ABI of account, from the copy cached on disk when the node reports the same hash for it
+optional<abi_def> fetch_abi( const name& account ) {
+   if( no_abi_cache ) {
+      auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
+      return result.as<eosio::chain_apis::read_only::get_abi_results>().abi;
+   }
+
+   const auto cached_path = bfs::path(abi_cache_dir) / (account.to_string() + ".abi");
+   bytes cached;
+   fc::mutable_variant_object params("account_name", account);
+   if( bfs::exists( cached_path ) ) {
+      string contents;
+      fc::read_file_contents( cached_path, contents );
+      cached.assign( contents.begin(), contents.end() );
+      params( "abi_hash", fc::sha256::hash( cached.data(), cached.size() ) );
+   }
+
+   // the node only sends the ABI back when it differs from the cached one
+   auto result = call(get_raw_abi_func, params).as<eosio::chain_apis::read_only::get_raw_abi_results>();
+   if( result.abi ) {
+      cached = result.abi->data;
+      try {
+         bfs::create_directories( cached_path.parent_path() );
+         std::ofstream out( cached_path.string(), std::ios::binary | std::ios::trunc );
+         out.write( cached.data(), cached.size() );
+      } catch( ... ) {
+         std::cerr << "Failed to cache ABI of " << account.to_string() << " in " << abi_cache_dir << std::endl;
+      }
+   }
+
+   if( cached.empty() )
+      return optional<abi_def>();
+   return fc::raw::unpack<abi_def>( cached );
+}
+
 //resolver for ABI serializer to decode actions in proposed transaction in multisig contract
 auto abi_serializer_resolver = [](const name& account) -> optional<abi_serializer> {
    static unordered_map<account_name, optional<abi_serializer> > abi_cache;
    auto it = abi_cache.find( account );
    if ( it == abi_cache.end() ) {
-      auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
-      auto abi_results = result.as<eosio::chain_apis::read_only::get_abi_results>();
+      auto abi = fetch_abi( account );
 
       optional<abi_serializer> abis;
-      if( abi_results.abi.valid() ) {
-         abis.emplace( *abi_results.abi, abi_serializer_max_time );
+      if( abi.valid() ) {
+         abis.emplace( *abi, abi_serializer_max_time );
       } else {
          std::cerr << "ABI for contract " << account.to_string() << " not found. Action data will be shown in hex only." << std::endl;
       }
@@ -507,6 +545,139 @@ void send_transaction( signed_transaction& trx, int32_t extra_kcpu, packed_trans
    }
 }
 
+struct batch_options {
+   uint32_t actions_per_trx = 1;
+   uint32_t trxs_per_push   = 100;   ///< transactions in each push_transactions call
+   uint32_t concurrency     = 4;     ///< push_transactions calls in flight at once
+};
+
+/// pushes actions as many transactions, a chunk at a time: each chunk is built with one get_info, signed through
+/// keosd with one call per set of required keys, and submitted with push_transactions while the next one is prepared
+void push_batch( const fc::variants& action_vars, const batch_options& opts ) {
+   EOS_ASSERT( opts.actions_per_trx > 0 && opts.concurrency > 0, transaction_type_exception, "batch sizes have to be positive" );
+   EOS_ASSERT( opts.trxs_per_push > 0 && opts.trxs_per_push <= 1000, transaction_type_exception,
+               "transactions per push has to be between 1 and 1000" );
+
+   // actions are serialized here with the ABIs cached by abi_serializer_resolver, not through abi_json_to_bin
+   const auto default_permissions = get_account_permissions(tx_permission);
+   vector<chain::action> actions;
+   actions.reserve(action_vars.size());
+   for( const auto& v : action_vars ) {
+      const auto& obj = v.get_object();
+      account_name account = obj["account"].as<account_name>();
+      action_name act = obj["name"].as<action_name>();
+      auto auth = obj.contains("authorization") ? obj["authorization"].as<vector<chain::permission_level>>() : default_permissions;
+      EOS_ASSERT( !auth.empty(), transaction_type_exception, "no authorization for ${a}::${n}, specify it in the action or with -p",
+                  ("a", account)("n", act) );
+      bytes data = obj["data"].is_string() ? obj["data"].as<bytes>() : variant_to_bin( account, act, obj["data"] );
+      actions.emplace_back( auth, account, act, move(data) );
+   }
+
+   fc::variant public_keys;
+   if( !tx_skip_sign )
+      public_keys = call(wallet_url, wallet_public_keys);
+   // required keys only depend on the authorizations of a transaction
+   map<flat_set<chain::permission_level>, flat_set<public_key_type>> required_keys_cache;
+   auto required_keys = [&]( const signed_transaction& trx ) -> const flat_set<public_key_type>& {
+      flat_set<chain::permission_level> auths;
+      for( const auto& a : trx.actions )
+         auths.insert( a.authorization.begin(), a.authorization.end() );
+      auto it = required_keys_cache.find( auths );
+      if( it == required_keys_cache.end() ) {
+         auto arg = fc::mutable_variant_object("transaction", (transaction)trx)("available_keys", public_keys);
+         it = required_keys_cache.emplace( auths, call(get_required_keys, arg)["required_keys"].as<flat_set<public_key_type>>() ).first;
+      }
+      return it->second;
+   };
+
+   std::deque<std::future<fc::variant>> in_flight;
+   size_t failed = 0;
+   auto print_results = [&]( const fc::variant& results, const vector<transaction_id_type>& ids ) {
+      const auto& arr = results.get_array();
+      for( size_t i = 0; i < arr.size(); ++i ) {
+         const bool error = arr[i]["processed"].is_object() && arr[i]["processed"].get_object().contains("error");
+         if( error ) ++failed;
+         if( tx_print_json )
+            cout << fc::json::to_string( arr[i] ) << endl;
+         else if( error )
+            cout << ids[i] << " failed: " << arr[i]["processed"]["error"].as_string() << endl;
+         else
+            cout << ids[i] << " executed" << endl;
+      }
+   };
+   std::deque<vector<transaction_id_type>> in_flight_ids;
+   auto wait_oldest = [&]() {
+      print_results( in_flight.front().get(), in_flight_ids.front() );
+      in_flight.pop_front();
+      in_flight_ids.pop_front();
+   };
+
+   const size_t actions_per_chunk = size_t(opts.actions_per_trx) * opts.trxs_per_push;
+   for( size_t begin = 0; begin < actions.size(); begin += actions_per_chunk ) {
+      const size_t end = std::min( actions.size(), begin + actions_per_chunk );
+      auto info = get_info();
+      block_id_type ref_block_id = info.last_irreversible_block_id;
+      if( !tx_ref_block_num_or_id.empty() ) {
+         try {
+            ref_block_id = call(get_block_func, fc::mutable_variant_object("block_num_or_id", tx_ref_block_num_or_id))["id"].as<block_id_type>();
+         } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
+      }
+
+      vector<signed_transaction> trxs;
+      for( size_t a = begin; a < end; a += opts.actions_per_trx ) {
+         signed_transaction trx;
+         trx.actions.assign( actions.begin() + a, actions.begin() + std::min( end, a + opts.actions_per_trx ) );
+         trx.expiration = info.head_block_time + tx_expiration;
+         trx.set_reference_block( ref_block_id );
+         if( tx_force_unique )
+            trx.context_free_actions.emplace_back( generate_nonce_action() );
+         trx.max_cpu_usage_ms = tx_max_cpu_usage;
+         trx.max_net_usage_words = (tx_max_net_usage + 7)/8;
+         trx.delay_sec = delaysec;
+         trxs.emplace_back( move(trx) );
+      }
+
+      if( !tx_skip_sign ) {
+         map<flat_set<public_key_type>, vector<size_t>> by_keys;
+         for( size_t i = 0; i < trxs.size(); ++i )
+            by_keys[required_keys( trxs[i] )].push_back( i );
+         for( const auto& group : by_keys ) {
+            vector<signed_transaction> to_sign;
+            for( auto i : group.second )
+               to_sign.emplace_back( trxs[i] );
+            fc::variants sign_args = {fc::variant(to_sign), fc::variant(group.first), fc::variant(info.chain_id)};
+            auto signed_trxs = call(wallet_url, wallet_sign_trxs, sign_args).as<vector<signed_transaction>>();
+            EOS_ASSERT( signed_trxs.size() == to_sign.size(), transaction_type_exception, "keosd returned ${n} transactions for ${m}",
+                        ("n", signed_trxs.size())("m", to_sign.size()) );
+            for( size_t j = 0; j < group.second.size(); ++j )
+               trxs[group.second[j]] = move(signed_trxs[j]);
+         }
+      }
+
+      if( tx_dont_broadcast ) {
+         for( const auto& trx : trxs )
+            cout << fc::json::to_string( tx_return_packed ? fc::variant(packed_transaction(trx)) : fc::variant(trx) ) << endl;
+         continue;
+      }
+
+      vector<transaction_id_type> ids;
+      fc::variants packed;
+      for( const auto& trx : trxs ) {
+         ids.push_back( trx.id() );
+         packed.emplace_back( packed_transaction(trx) );
+      }
+      if( in_flight.size() >= opts.concurrency )
+         wait_oldest();
+      in_flight.emplace_back( std::async( std::launch::async, [packed = move(packed)]() { return call(push_txns_func, packed); } ) );
+      in_flight_ids.emplace_back( move(ids) );
+   }
+   while( !in_flight.empty() )
+      wait_oldest();
+
+   if( failed )
+      std::cerr << localized("${n} of ${m} transactions failed", ("n", failed)("m", (actions.size() + opts.actions_per_trx - 1) / opts.actions_per_trx)) << std::endl;
+}
+
 chain::action create_newaccount(const name& creator, const name& newaccount, public_key_type owner, public_key_type active) {
    return action {
       tx_permission.empty() ? vector<chain::permission_level>{{creator,config::active_name}} : get_account_permissions(tx_permission),
@@ -1749,6 +1920,7 @@ int main( int argc, char** argv ) {
    textdomain(locale_domain);
    context = eosio::client::http::create_http_context();
    wallet_url = default_wallet_url;
+   abi_cache_dir = (determine_home_directory() / ".cleos" / "abi-cache").string();
 
    CLI::App app{"Command Line Interface to EOSIO Client"};
    app.require_subcommand();
@@ -1763,6 +1935,8 @@ int main( int argc, char** argv ) {
    app.add_option( "-r,--header", header_opt_callback, localized("pass specific HTTP header; repeat this option to pass multiple headers"));
    app.add_flag( "-n,--no-verify", no_verify, localized("don't verify peer certificate when using HTTPS"));
    app.add_flag( "--no-auto-keosd", no_auto_keosd, localized("don't automatically launch a keosd if one is not currently running"));
+   app.add_option( "--abi-cache-dir", abi_cache_dir, localized("the directory contract ABIs are cached in, checked against the node by hash before they are used"), true );
+   app.add_flag( "--no-abi-cache", no_abi_cache, localized("always fetch contract ABIs from the node"));
    app.set_callback([&app]{ ensure_keosd_running(&app);});
 
    bool verbose_errors = false;
@@ -2805,6 +2979,25 @@ int main( int argc, char** argv ) {
    });
 
 
+   // push batch
+   string batch_actions;
+   batch_options batch_opts;
+   auto batchSubcommand = push->add_subcommand("batch", localized("Push an array of actions as many transactions, signed and submitted in batches"));
+   batchSubcommand->add_option("actions", batch_actions,
+                               localized("The JSON string or filename defining the array of actions, each with account, name, an optional authorization and data as JSON arguments or packed hex"))->required();
+   batchSubcommand->add_option("--actions-per-trx", batch_opts.actions_per_trx, localized("Number of actions in each transaction"), true);
+   batchSubcommand->add_option("--trxs-per-push", batch_opts.trxs_per_push, localized("Number of transactions in each push_transactions request, at most 1000"), true);
+   batchSubcommand->add_option("--concurrency", batch_opts.concurrency, localized("Number of push_transactions requests in flight at once"), true);
+   add_standard_transaction_options(batchSubcommand);
+   batchSubcommand->set_callback([&] {
+      fc::variant actions_var;
+      try {
+         actions_var = json_from_file_or_string(batch_actions, fc::json::relaxed_parser);
+      } EOS_RETHROW_EXCEPTIONS(transaction_type_exception, "Fail to parse actions JSON '${data}'", ("data",batch_actions))
+      push_batch( actions_var.get_array(), batch_opts );
+   });
+
+
    // multisig subcommand
    auto msig = app.add_subcommand("multisig", localized("Multisig contract commands"), false);
    msig->require_subcommand();
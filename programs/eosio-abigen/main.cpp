@@ -2,6 +2,8 @@
 #include <fc/io/json.hpp>
 #include <eosio/abi_generator/abi_generator.hpp>
 #include <fc/variant_object.hpp>
+#include <boost/filesystem.hpp>
+#include <ctime>
 
 using namespace eosio;
 using namespace eosio::chain;
@@ -34,28 +36,51 @@ std::unique_ptr<FrontendActionFactory> create_factory(bool verbose, bool opt_sfs
   );
 }
 
-std::unique_ptr<FrontendActionFactory> create_find_macro_factory(string& contract, vector<string>& actions, string abi_context) {
+std::unique_ptr<FrontendActionFactory> create_find_macro_factory(string& contract, vector<string>& actions, string abi_context,
+                                                                 fc::sha256::encoder* source_hash = nullptr) {
 
   struct abi_frontend_macro_action_factory : public FrontendActionFactory {
 
-    string&          contract;
-    vector<string>&  actions;
-    string           abi_context;
+    string&               contract;
+    vector<string>&       actions;
+    string                abi_context;
+    fc::sha256::encoder*  source_hash;
 
     abi_frontend_macro_action_factory (string& contract, vector<string>& actions,
-      string abi_context ) : contract(contract), actions(actions), abi_context(abi_context) {}
+      string abi_context, fc::sha256::encoder* source_hash ) : contract(contract), actions(actions), abi_context(abi_context),
+      source_hash(source_hash) {}
 
     clang::FrontendAction *create() override {
-      return new find_eosio_abi_macro_action(contract, actions, abi_context);
+      return new find_eosio_abi_macro_action(contract, actions, abi_context, source_hash);
     }
 
   };
 
   return std::unique_ptr<FrontendActionFactory>(
-    new abi_frontend_macro_action_factory(contract, actions, abi_context)
+    new abi_frontend_macro_action_factory(contract, actions, abi_context, source_hash)
   );
 }
 
+// everything besides the preprocessed sources the generated ABI depends on
+void hash_generation_inputs(fc::sha256::encoder& enc, const string& abi_context, bool opt_sfs, const string& contract, const vector<string>& actions) {
+  auto add = [&](const string& s) {
+    enc.write(s.data(), s.size());
+    enc.put('\0');
+  };
+  add(abi_context);
+  add(opt_sfs ? "optimize-sfs" : "");
+  add(contract);
+  vector<string> rc_files = { abi_context+"/"+contract+"_rc.md" };
+  for( const auto& act : actions ) {
+    add(act);
+    rc_files.push_back(abi_context+"/"+contract+"."+act+"_rc.md");
+  }
+  for( const auto& f : rc_files ) {
+    ifstream in(f);
+    add(in.good() ? string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) : string());
+  }
+}
+
 static cl::OptionCategory abi_generator_category("ABI generator options");
 
 static cl::opt<std::string> abi_context(
@@ -78,13 +103,38 @@ static cl::opt<bool> abi_opt_sfs(
     cl::desc("Optimize single field struct"),
     cl::cat(abi_generator_category));
 
+static cl::opt<std::string> abi_cache_file(
+    "cache-file",
+    cl::desc("file keeping the hash of the preprocessed sources the destination file was generated from, "
+             "so that the ABI is only generated again when they change"),
+    cl::cat(abi_generator_category));
+
 int main(int argc, const char **argv) { abi_def output; try {
    CommonOptionsParser op(argc, argv, abi_generator_category);
    ClangTool Tool(op.getCompilations(), op.getSourcePathList());
 
    string contract;
    vector<string> actions;
-   int result = Tool.run(create_find_macro_factory(contract, actions, abi_context).get());
+   fc::sha256::encoder source_hash;
+   const bool use_cache = !abi_cache_file.empty();
+   int result = Tool.run(create_find_macro_factory(contract, actions, abi_context, use_cache ? &source_hash : nullptr).get());
+
+   string inputs_hash;
+   if(!result && use_cache) {
+      hash_generation_inputs(source_hash, abi_context, abi_opt_sfs, contract, actions);
+      inputs_hash = source_hash.result().str();
+
+      string cached_hash;
+      ifstream cache_in(abi_cache_file);
+      if(cache_in.good())
+         cache_in >> cached_hash;
+      if(cached_hash == inputs_hash && boost::filesystem::exists(abi_destination.getValue())) {
+         // up to date, only marked as such for the build
+         boost::filesystem::last_write_time(abi_destination.getValue(), std::time(nullptr));
+         return 0;
+      }
+   }
+
    if(!result) {
       output.version = "eosio::abi/1.0";
       result = Tool.run(create_factory(abi_verbose, abi_opt_sfs, abi_context, output, contract, actions).get());
@@ -100,6 +150,10 @@ int main(int argc, const char **argv) { abi_def output; try {
          auto abi_with_comment = mvo("____comment", comment)(mvo(vabi));
 
          fc::json::save_to_file(abi_with_comment, abi_destination, true);
+         if(use_cache) {
+            ofstream cache_out(abi_cache_file);
+            cache_out << inputs_hash << endl;
+         }
       }
    }
    return result;
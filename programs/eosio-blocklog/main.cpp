@@ -4,6 +4,7 @@
  */
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/block_log_archive.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 
@@ -15,6 +16,14 @@
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 
 using namespace eosio::chain;
 namespace bfs = boost::filesystem;
@@ -22,20 +31,80 @@ namespace bpo = boost::program_options;
 using bpo::options_description;
 using bpo::variables_map;
 
+/// per block figures written by --stats
+struct block_stats {
+   uint32_t       block_num = 0;
+   fc::time_point timestamp;
+   account_name   producer;
+   uint32_t       transactions = 0;
+   uint32_t       failed_transactions = 0;   ///< soft or hard failed
+   uint32_t       deferred_transactions = 0; ///< receipts carrying only the id, which have no actions to look at
+   uint32_t       actions = 0;
+   uint32_t       matched_actions = 0;       ///< actions passing --filter-contract and --filter-action
+   uint64_t       cpu_usage_us = 0;
+   uint64_t       net_usage_bytes = 0;
+   uint32_t       packed_size = 0;
+};
+
+/// rows written by --extract-actions
+struct extracted_action {
+   uint32_t            block_num = 0;
+   fc::time_point      timestamp;
+   transaction_id_type trx_id;
+   uint32_t            action_index = 0;
+   account_name        account;
+   action_name         name;
+   bytes               data;
+};
+
 struct blocklog {
    blocklog()
    {}
 
    void read_log();
+   void convert_log();
+   void analyze_log();
+   void edit_log();
    void set_program_options(options_description& cli);
    void initialize(const variables_map& options);
 
    bfs::path                        blocks_dir;
    bfs::path                        output_file;
+   bfs::path                        make_archive;
+   bfs::path                        extract_archive;
+   block_log_archive::options       archive_options;
    uint32_t                         first_block;
    uint32_t                         last_block;
    bool                             no_pretty_print;
    bool                             as_json_array;
+   bool                             print_checksum;
+   bool                             stats;
+   bool                             extract_actions;
+   uint32_t                         threads;
+   uint32_t                         blocks_per_task;
+   std::string                      output_format;
+   std::set<account_name>           filter_contracts;
+   std::set<action_name>            filter_actions;
+   optional<uint32_t>               trim_front;
+   optional<uint32_t>               trim_end;
+   uint32_t                         split_blocks = 0;
+   vector<bfs::path>                merge_dirs;
+   bfs::path                        output_dir;
+
+   bool edits_log()const { return trim_front || trim_end || split_blocks || !merge_dirs.empty(); }
+
+   private:
+      struct range_result {
+         vector<block_stats>      blocks;
+         vector<extracted_action> actions;
+      };
+
+      bool matches( const action& a )const {
+         return (filter_contracts.empty() || filter_contracts.count( a.account )) &&
+                (filter_actions.empty() || filter_actions.count( a.name ));
+      }
+
+      range_result analyze_range( const block_log& log, uint32_t first, uint32_t last )const;
 };
 
 void blocklog::read_log() {
@@ -130,6 +199,250 @@ void blocklog::read_log() {
       *out << "]";
 }
 
+/**
+ * Reads the blocks first through last with read_block, which may be called from several threads, starting from
+ * the position the index has for first. Only the actions of transactions carried in full are looked at, without
+ * converting anything to JSON.
+ */
+blocklog::range_result blocklog::analyze_range( const block_log& log, uint32_t first, uint32_t last )const {
+   range_result r;
+   bool filtered = !filter_contracts.empty() || !filter_actions.empty();
+   uint64_t pos = log.get_block_pos( first );
+   EOS_ASSERT( pos != block_log::npos, block_log_exception, "Block ${n} is missing from the block log index", ("n", first) );
+   for( uint32_t n = first; n <= last; ++n ) {
+      auto next = log.read_block( pos );
+      const auto& b = *next.first;
+      EOS_ASSERT( b.block_num() == n, block_log_exception, "Wrong block was read from block log, expected ${e}, got ${n}",
+                  ("e", n)("n", b.block_num()) );
+
+      block_stats s;
+      s.block_num = n;
+      s.timestamp = b.timestamp.to_time_point();
+      s.producer = b.producer;
+      s.packed_size = next.second - pos - sizeof(uint64_t);
+      pos = next.second;
+
+      for( const auto& receipt : b.transactions ) {
+         ++s.transactions;
+         if( receipt.status == transaction_receipt_header::soft_fail || receipt.status == transaction_receipt_header::hard_fail )
+            ++s.failed_transactions;
+         s.cpu_usage_us += receipt.cpu_usage_us;
+         s.net_usage_bytes += uint64_t(receipt.net_usage_words.value) * 8;
+         if( receipt.trx.contains<transaction_id_type>() ) {
+            ++s.deferred_transactions;
+            continue;
+         }
+         const auto& ptrx = receipt.trx.get<packed_transaction>();
+         auto trx = ptrx.get_transaction();
+         for( uint32_t i = 0; i < trx.actions.size(); ++i ) {
+            ++s.actions;
+            const auto& a = trx.actions[i];
+            if( !matches( a ) )
+               continue;
+            ++s.matched_actions;
+            if( extract_actions )
+               r.actions.push_back( extracted_action{ n, s.timestamp, ptrx.id(), i, a.account, a.name, a.data } );
+         }
+      }
+      if( stats && (!filtered || s.matched_actions) )
+         r.blocks.push_back( s );
+   }
+   return r;
+}
+
+/**
+ * Splits the requested range into tasks of blocks_per_task blocks, which the threads take in turn, and writes the
+ * results in block order. A thread does not run more than two tasks per thread ahead of the output, so memory
+ * stays bounded however long the range is.
+ */
+void blocklog::analyze_log() {
+   block_log log(blocks_dir);
+   const auto head = log.read_head();
+   EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+   uint32_t first = std::max( first_block, log.first_block_num() );
+   uint32_t last = std::min( last_block, head->block_num() );
+   EOS_ASSERT( first <= last, block_log_exception, "No blocks of the block log, ${f} through ${l}, in the requested range",
+               ("f", log.first_block_num())("l", head->block_num()) );
+   ilog( "analyzing block num ${first} through block num ${last} on ${t} threads", ("first",first)("last",last)("t",threads) );
+
+   bool columns = output_format == "columns";
+   std::ofstream csv;
+   std::map<string, std::ofstream> column_files;
+   uint64_t rows = 0;
+   auto column = [&]( const char* name ) -> std::ofstream& {
+      auto& f = column_files[name];
+      if( !f.is_open() ) {
+         f.open( (output_file / (string(name) + ".bin")).generic_string().c_str(), std::ios::binary );
+         EOS_ASSERT( !f.fail(), block_log_exception, "Unable to open a column file in ${d}", ("d", output_file.generic_string()) );
+      }
+      return f;
+   };
+   auto put = [&]( const char* name, auto value ) {
+      column( name ).write( (const char*)&value, sizeof(value) );
+   };
+   std::ostream* out = &std::cout;
+   if( columns ) {
+      bfs::create_directories( output_file );
+   } else if( !output_file.empty() ) {
+      csv.open( output_file.generic_string().c_str() );
+      EOS_ASSERT( !csv.fail(), block_log_exception, "Unable to open file '${f}'", ("f", output_file.generic_string()) );
+      out = &csv;
+   }
+
+   if( !columns ) {
+      if( stats )
+         *out << "block_num,timestamp,producer,transactions,failed_transactions,deferred_transactions,actions,"
+                 "matched_actions,cpu_usage_us,net_usage_bytes,packed_size\n";
+      else
+         *out << "block_num,timestamp,trx_id,action_index,account,action,data\n";
+   }
+   auto write = [&]( range_result& r ) {
+      for( const auto& s : r.blocks ) {
+         ++rows;
+         if( columns ) {
+            put( "block_num", s.block_num );
+            put( "timestamp_ms", int64_t(s.timestamp.time_since_epoch().count() / 1000) );
+            put( "producer", s.producer.value );
+            put( "transactions", s.transactions );
+            put( "failed_transactions", s.failed_transactions );
+            put( "deferred_transactions", s.deferred_transactions );
+            put( "actions", s.actions );
+            put( "matched_actions", s.matched_actions );
+            put( "cpu_usage_us", s.cpu_usage_us );
+            put( "net_usage_bytes", s.net_usage_bytes );
+            put( "packed_size", s.packed_size );
+         } else {
+            *out << s.block_num << ',' << string(s.timestamp) << ',' << s.producer.to_string() << ',' << s.transactions << ','
+                 << s.failed_transactions << ',' << s.deferred_transactions << ',' << s.actions << ',' << s.matched_actions << ','
+                 << s.cpu_usage_us << ',' << s.net_usage_bytes << ',' << s.packed_size << '\n';
+         }
+      }
+      for( const auto& a : r.actions ) {
+         ++rows;
+         *out << a.block_num << ',' << string(a.timestamp) << ',' << a.trx_id.str() << ',' << a.action_index << ','
+              << a.account.to_string() << ',' << a.name.to_string() << ','
+              << (a.data.empty() ? string() : fc::to_hex( a.data.data(), a.data.size() )) << '\n';
+      }
+   };
+
+   const uint32_t task_count = (last - first) / blocks_per_task + 1;
+   const uint32_t max_tasks_ahead = 2 * threads;
+   std::atomic<uint32_t> next_task{0};
+   std::mutex mtx;
+   std::condition_variable cv;
+   std::map<uint32_t, range_result> done;
+   uint32_t next_to_write = 0;
+   std::exception_ptr error;
+
+   auto worker = [&]() {
+      try {
+         for( uint32_t t = next_task++; t < task_count; t = next_task++ ) {
+            {
+               std::unique_lock<std::mutex> g(mtx);
+               cv.wait( g, [&]() { return t < next_to_write + max_tasks_ahead || error; } );
+               if( error ) return;
+            }
+            uint32_t from = first + t * blocks_per_task;
+            auto r = analyze_range( log, from, std::min( last, from + (blocks_per_task - 1) ) );
+            {
+               std::lock_guard<std::mutex> g(mtx);
+               done.emplace( t, std::move(r) );
+            }
+            cv.notify_all();
+         }
+      } catch( ... ) {
+         std::lock_guard<std::mutex> g(mtx);
+         if( !error )
+            error = std::current_exception();
+         cv.notify_all();
+      }
+   };
+   vector<std::thread> workers;
+   for( uint32_t i = 0; i < threads; ++i )
+      workers.emplace_back( worker );
+
+   while( next_to_write < task_count ) {
+      range_result r;
+      {
+         std::unique_lock<std::mutex> g(mtx);
+         cv.wait( g, [&]() { return done.count( next_to_write ) || error; } );
+         if( error ) break;
+         r = std::move( done[next_to_write] );
+         done.erase( next_to_write );
+         ++next_to_write;
+      }
+      cv.notify_all();
+      write( r );
+   }
+   for( auto& w : workers )
+      w.join();
+   if( error )
+      std::rethrow_exception( error );
+
+   if( columns ) {
+      // every column is a file of little endian values, one per row, described by schema.json
+      static const std::vector<std::pair<const char*, const char*>> schema = {
+         {"block_num", "uint32"}, {"timestamp_ms", "int64"}, {"producer", "name"}, {"transactions", "uint32"},
+         {"failed_transactions", "uint32"}, {"deferred_transactions", "uint32"}, {"actions", "uint32"},
+         {"matched_actions", "uint32"}, {"cpu_usage_us", "uint64"}, {"net_usage_bytes", "uint64"}, {"packed_size", "uint32"}
+      };
+      fc::variants cols;
+      for( const auto& c : schema ) {
+         column( c.first );
+         cols.emplace_back( fc::mutable_variant_object()("name", c.first)("file", string(c.first) + ".bin")("type", c.second) );
+      }
+      column_files.clear();
+      fc::json::save_to_file( fc::mutable_variant_object()("rows", rows)("columns", cols), output_file / "schema.json" );
+   }
+   ilog( "wrote ${r} rows", ("r", rows) );
+}
+
+void blocklog::edit_log() {
+   if (!merge_dirs.empty()) {
+      ilog( "merging ${n} block logs into ${o}", ("n",merge_dirs.size())("o",output_dir.generic_string()) );
+      block_log::merge_logs( vector<fc::path>( merge_dirs.begin(), merge_dirs.end() ), output_dir );
+      return;
+   }
+   if (split_blocks) {
+      uint32_t first, last;
+      {
+         block_log log(blocks_dir);
+         const auto head = log.read_head();
+         EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+         first = std::max( first_block, log.first_block_num() );
+         last = std::min( last_block, head->block_num() );
+      }
+      EOS_ASSERT( first <= last, block_log_exception, "No blocks of the block log in the requested range" );
+      for (uint32_t from = first; ; from += split_blocks) {
+         const uint32_t to = from + std::min( split_blocks - 1, last - from );
+         auto dir = output_dir / ("blocks-" + std::to_string(from) + "-" + std::to_string(to));
+         ilog( "writing block num ${f} through block num ${t} to ${d}", ("f",from)("t",to)("d",dir.generic_string()) );
+         block_log::extract_blocks( blocks_dir, dir, from, to );
+         if (to == last)
+            break;
+      }
+      return;
+   }
+   if (trim_end) {
+      ilog( "removing the blocks after block num ${n} from ${b}", ("n",*trim_end)("b",blocks_dir.generic_string()) );
+      block_log::trim_end( blocks_dir, *trim_end );
+   }
+   if (trim_front) {
+      ilog( "removing the blocks before block num ${n} from ${b}", ("n",*trim_front)("b",blocks_dir.generic_string()) );
+      block_log::trim_front( blocks_dir, *trim_front );
+   }
+}
+
+void blocklog::convert_log() {
+   if (!make_archive.empty()) {
+      ilog( "archiving block log in ${b} into ${a}", ("b",blocks_dir.generic_string())("a",make_archive.generic_string()) );
+      block_log_archive::create( blocks_dir, make_archive, archive_options, first_block > 1 ? first_block : 0 );
+   } else {
+      ilog( "extracting block log archive in ${a} into ${b}", ("a",extract_archive.generic_string())("b",blocks_dir.generic_string()) );
+      block_log_archive::extract( extract_archive, blocks_dir );
+   }
+}
+
 void blocklog::set_program_options(options_description& cli)
 {
    cli.add_options()
@@ -145,6 +458,45 @@ void blocklog::set_program_options(options_description& cli)
           "Do not pretty print the output.  Useful if piping to jq to improve performance.")
          ("as-json-array", bpo::bool_switch(&as_json_array)->default_value(false),
           "Print out json blocks wrapped in json array (otherwise the output is free-standing json objects).")
+         ("make-archive", bpo::value<bfs::path>(),
+          "Instead of printing blocks, write the block log as compressed segment files into this directory, "
+          "starting at --first or after the last complete segment already there.")
+         ("extract-archive", bpo::value<bfs::path>(),
+          "Instead of printing blocks, rebuild a block log in --blocks-dir from the compressed segment files in this directory.")
+         ("blocks-per-chunk", bpo::value<uint32_t>(&archive_options.blocks_per_chunk)->default_value(archive_options.blocks_per_chunk),
+          "Number of blocks compressed together in an archive segment")
+         ("blocks-per-segment", bpo::value<uint32_t>(&archive_options.blocks_per_segment)->default_value(archive_options.blocks_per_segment),
+          "Number of blocks in each archive segment file")
+         ("checksum", bpo::bool_switch(&print_checksum)->default_value(false),
+          "Instead of printing blocks, print the sha256 of blocks.log to pass to nodeos --trusted-replay-checksum")
+         ("stats", bpo::bool_switch(&stats)->default_value(false),
+          "Instead of printing blocks, write one row of transaction, action, CPU, NET and size figures per block of the block log")
+         ("extract-actions", bpo::bool_switch(&extract_actions)->default_value(false),
+          "Instead of printing blocks, write one row per action of the transactions in the block log, with its data in hex")
+         ("filter-contract", bpo::value<vector<string>>()->composing(),
+          "Only count and extract actions of this contract with --stats and --extract-actions; may be specified multiple times. "
+          "With a filter, --stats only writes blocks with matching actions")
+         ("filter-action", bpo::value<vector<string>>()->composing(),
+          "Only count and extract actions of this name with --stats and --extract-actions; may be specified multiple times")
+         ("output-format", bpo::value<std::string>(&output_format)->default_value("csv"),
+          "Format of --stats: csv, or columns to write a directory at --output-file with one binary file per column")
+         ("threads", bpo::value<uint32_t>(&threads)->default_value(std::max(1u, std::thread::hardware_concurrency())),
+          "Number of threads reading the block log with --stats and --extract-actions")
+         ("blocks-per-task", bpo::value<uint32_t>(&blocks_per_task)->default_value(10000),
+          "Number of consecutive blocks a thread reads at a time with --stats and --extract-actions")
+         ("trim-front", bpo::value<uint32_t>(),
+          "Instead of printing blocks, remove the blocks before this block number from the block log in --blocks-dir, in place. "
+          "The result is a partial block log which needs a snapshot to replay from")
+         ("trim-end", bpo::value<uint32_t>(),
+          "Instead of printing blocks, remove the blocks after this block number from the block log in --blocks-dir, in place")
+         ("split-blocks", bpo::value<uint32_t>(&split_blocks)->default_value(0),
+          "Instead of printing blocks, write the blocks from --first to --last as block logs of this many blocks each, "
+          "into directories named blocks-<first>-<last> in --output-dir")
+         ("merge", bpo::value<vector<bfs::path>>()->composing(),
+          "Instead of printing blocks, concatenate the block logs in these directories, in the order given, into a new block log "
+          "in --output-dir; may be specified multiple times")
+         ("output-dir", bpo::value<bfs::path>(),
+          "the directory --split-blocks and --merge write to")
          ("help", "Print this help message and exit.")
          ;
 
@@ -158,6 +510,14 @@ void blocklog::initialize(const variables_map& options) {
       else
          blocks_dir = bld;
 
+      auto absolute = [](bfs::path p) { return p.is_relative() ? bfs::current_path() / p : p; };
+      if (options.count( "make-archive" ))
+         make_archive = absolute( options.at( "make-archive" ).as<bfs::path>() );
+      if (options.count( "extract-archive" ))
+         extract_archive = absolute( options.at( "extract-archive" ).as<bfs::path>() );
+      EOS_ASSERT( make_archive.empty() || extract_archive.empty(), block_log_exception,
+                  "--make-archive and --extract-archive cannot be used together" );
+
       if (options.count( "output-file" )) {
          bld = options.at( "output-file" ).as<bfs::path>();
          if( bld.is_relative())
@@ -165,6 +525,40 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+
+      auto add_names = []( const variables_map& options, const char* option, std::set<name>& names ) {
+         if( !options.count( option ) ) return;
+         for( const auto& s : options.at( option ).as<vector<string>>() ) {
+            vector<string> v;
+            boost::split( v, s, boost::is_any_of( "," ));
+            for( const auto& n : v )
+               if( !n.empty() ) names.insert( name(n) );
+         }
+      };
+      add_names( options, "filter-contract", filter_contracts );
+      add_names( options, "filter-action", filter_actions );
+      EOS_ASSERT( !(stats && extract_actions), block_log_exception, "--stats and --extract-actions cannot be used together" );
+      EOS_ASSERT( output_format == "csv" || output_format == "columns", block_log_exception,
+                  "--output-format must be csv or columns" );
+      EOS_ASSERT( output_format == "csv" || (stats && !output_file.empty()), block_log_exception,
+                  "--output-format columns needs --stats and an --output-file directory" );
+      EOS_ASSERT( threads > 0 && blocks_per_task > 0, block_log_exception, "--threads and --blocks-per-task must be positive" );
+
+      if (options.count( "trim-front" ))
+         trim_front = options.at( "trim-front" ).as<uint32_t>();
+      if (options.count( "trim-end" ))
+         trim_end = options.at( "trim-end" ).as<uint32_t>();
+      if (options.count( "merge" ))
+         for (const auto& d : options.at( "merge" ).as<vector<bfs::path>>())
+            merge_dirs.push_back( absolute( d ) );
+      if (options.count( "output-dir" ))
+         output_dir = absolute( options.at( "output-dir" ).as<bfs::path>() );
+      EOS_ASSERT( (trim_front || trim_end) + bool(split_blocks) + !merge_dirs.empty() <= 1, block_log_exception,
+                  "Only one of --trim-front/--trim-end, --split-blocks and --merge can be used at a time" );
+      EOS_ASSERT( !(trim_front && trim_end) || *trim_front <= *trim_end, block_log_exception,
+                  "--trim-front must not be past --trim-end" );
+      EOS_ASSERT( !(split_blocks || !merge_dirs.empty()) || !output_dir.empty(), block_log_exception,
+                  "--split-blocks and --merge need an --output-dir" );
    } FC_LOG_AND_RETHROW()
 
 }
@@ -185,7 +579,16 @@ int main(int argc, char** argv)
         return 0;
       }
       blog.initialize(vmap);
-      blog.read_log();
+      if (blog.print_checksum)
+         std::cout << block_log::checksum( blog.blocks_dir ).str() << std::endl;
+      else if (!blog.make_archive.empty() || !blog.extract_archive.empty())
+         blog.convert_log();
+      else if (blog.stats || blog.extract_actions)
+         blog.analyze_log();
+      else if (blog.edits_log())
+         blog.edit_log();
+      else
+         blog.read_log();
    } catch( const fc::exception& e ) {
       elog( "${e}", ("e", e.to_detail_string()));
       return -1;
@@ -0,0 +1,119 @@
+/**
+ *  @file
+ *  @copyright defined in eosio/LICENSE.txt
+ */
+#include <eosio/chain/snapshot.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <fstream>
+
+using namespace eosio::chain;
+namespace bfs = boost::filesystem;
+namespace bpo = boost::program_options;
+using bpo::options_description;
+using bpo::variables_map;
+
+struct snapshot_tool {
+   void apply_deltas();
+   void make_delta();
+   void set_program_options(options_description& cli);
+   void initialize(const variables_map& options);
+
+   bfs::path                        base;
+   bfs::path                        target;
+   vector<bfs::path>                deltas;
+   bfs::path                        output_file;
+};
+
+void snapshot_tool::apply_deltas() {
+   ilog( "applying ${n} delta snapshots to ${b}", ("n",deltas.size())("b",base.generic_string()) );
+   vector<fc::path> delta_paths( deltas.begin(), deltas.end() );
+   delta_snapshot_writer::apply( base, delta_paths, output_file );
+   ilog( "wrote ${o}", ("o",output_file.generic_string()) );
+}
+
+void snapshot_tool::make_delta() {
+   ilog( "writing the difference from ${b} to ${t}", ("b",base.generic_string())("t",target.generic_string()) );
+   std::ifstream base_in( base.generic_string(), std::ios::in | std::ios::binary );
+   std::ifstream target_in( target.generic_string(), std::ios::in | std::ios::binary );
+   std::ofstream delta_out( output_file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   EOS_ASSERT( base_in.good() && target_in.good() && delta_out.good(), snapshot_exception, "Unable to open the snapshots" );
+   delta_snapshot_writer::create( base_in, target_in, delta_out );
+   ilog( "wrote ${o}", ("o",output_file.generic_string()) );
+}
+
+void snapshot_tool::set_program_options(options_description& cli)
+{
+   cli.add_options()
+         ("base", bpo::value<bfs::path>(),
+          "the binary snapshot the deltas were taken against")
+         ("delta", bpo::value<vector<bfs::path>>()->composing(),
+          "delta snapshot to apply, each one to the result of the previous (may specify multiple times, in order)")
+         ("target", bpo::value<bfs::path>(),
+          "instead of applying deltas, write the delta from --base to this binary snapshot")
+         ("output-file,o", bpo::value<bfs::path>(),
+          "the binary snapshot, or with --target the delta snapshot, to write")
+         ("help", "Print this help message and exit.")
+         ;
+
+}
+
+void snapshot_tool::initialize(const variables_map& options) {
+   try {
+      auto absolute = [](bfs::path p) { return p.is_relative() ? bfs::current_path() / p : p; };
+      EOS_ASSERT( options.count( "base" ), snapshot_exception, "--base is required" );
+      EOS_ASSERT( options.count( "output-file" ), snapshot_exception, "--output-file is required" );
+      base = absolute( options.at( "base" ).as<bfs::path>() );
+      output_file = absolute( options.at( "output-file" ).as<bfs::path>() );
+
+      if (options.count( "target" ))
+         target = absolute( options.at( "target" ).as<bfs::path>() );
+      if (options.count( "delta" ))
+         for( const auto& d : options.at( "delta" ).as<vector<bfs::path>>() )
+            deltas.push_back( absolute( d ) );
+      EOS_ASSERT( target.empty() != deltas.empty(), snapshot_exception, "Exactly one of --target and --delta must be given" );
+   } FC_LOG_AND_RETHROW()
+
+}
+
+
+int main(int argc, char** argv)
+{
+   options_description cli ("eosio-snapshot command line options");
+   try {
+      snapshot_tool tool;
+      tool.set_program_options(cli);
+      variables_map vmap;
+      bpo::store(bpo::parse_command_line(argc, argv, cli), vmap);
+      bpo::notify(vmap);
+      if (vmap.count("help") > 0) {
+        cli.print(std::cerr);
+        return 0;
+      }
+      tool.initialize(vmap);
+      if (!tool.target.empty())
+         tool.make_delta();
+      else
+         tool.apply_deltas();
+   } catch( const fc::exception& e ) {
+      elog( "${e}", ("e", e.to_detail_string()));
+      return -1;
+   } catch( const boost::exception& e ) {
+      elog("${e}", ("e",boost::diagnostic_information(e)));
+      return -1;
+   } catch( const std::exception& e ) {
+      elog("${e}", ("e",e.what()));
+      return -1;
+   } catch( ... ) {
+      elog("unknown exception");
+      return -1;
+   }
+
+   return 0;
+}
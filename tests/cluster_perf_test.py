@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+
+from testUtils import Utils
+from Cluster import Cluster
+from WalletMgr import WalletMgr
+from TestHelper import AppArgs
+from TestHelper import TestHelper
+
+import json
+import os
+import subprocess
+import time
+import urllib.request
+
+###############################################################
+# cluster_perf_test
+#
+# Stands up a local cluster of producer nodes in the given topology, optionally with emulated network latency,
+# drives it with the open loop of txn_test_gen_plugin and scrapes block timing, net latency and cpu usage from
+# every node. Everything measured is written as one JSON report:
+#
+#   tests/cluster_perf_test.py -p 4 -n 6 --topology ring --latency-ms 50 --tps 1000 --duration 120 --report perf.json
+#
+# --latency-ms adds a netem delay to the loopback interface for the run, which needs root and also delays the
+# http requests of this script. The report is meant to be compared between runs on the same machine.
+###############################################################
+
+Print=Utils.Print
+errorExit=Utils.errorExit
+
+appArgs=AppArgs()
+appArgs.add(flag="--topology", type=str, help="network topology of the launcher", default="mesh",
+            choices=["mesh", "star", "ring"])
+appArgs.add(flag="--latency-ms", type=int, help="one way delay added to the loopback interface, 0 for none", default=0)
+appArgs.add(flag="--tps", type=int, help="transactions per second offered by all generator nodes together", default=500)
+appArgs.add(flag="--duration", type=int, help="seconds the load is applied", default=60)
+appArgs.add(flag="--generator-nodes", type=int, help="nodes running txn_test_gen_plugin, 0 for all", default=1)
+appArgs.add(flag="--sample-interval", type=int, help="seconds between cpu and connection samples", default=5)
+appArgs.add(flag="--txn-test-gen-mix", type=str, help="txn-test-gen-mix of the generator nodes", default="transfer:100")
+appArgs.add(flag="--report", type=str, help="file the JSON report is written to", default="cluster_perf_report.json")
+args = TestHelper.parse_args({"-p","-n","-d","--p2p-plugin","--dump-error-details","--keep-logs","-v",
+                              "--leave-running","--clean-run","--wallet-port"}, applicationSpecificArgs=appArgs)
+
+Utils.Debug=args.v
+pnodes=args.p
+totalNodes=max(args.n, pnodes)
+generatorNodes=totalNodes if args.generator_nodes <= 0 else min(args.generator_nodes, totalNodes)
+cluster=Cluster(walletd=True)
+dumpErrorDetails=args.dump_error_details
+keepLogs=args.keep_logs
+dontKill=args.leave_running
+killAll=args.clean_run
+walletMgr=WalletMgr(True, port=args.wallet_port)
+testSuccessful=False
+killEosInstances=not dontKill
+killWallet=not dontKill
+
+def apiCall(node, api, call, body=None, timeout=30):
+    url="%s/v1/%s/%s" % (node.endpointHttp, api, call)
+    data=json.dumps(body).encode("utf-8") if body is not None else None
+    if Utils.Debug: Utils.Print("POST %s %s" % (url, data))
+    with urllib.request.urlopen(urllib.request.Request(url, data=data), timeout=timeout) as response:
+        return json.loads(response.read().decode("utf-8"))
+
+def cpuTicks(pid):
+    """user plus system clock ticks the process used so far, None once it is gone"""
+    try:
+        with open("/proc/%d/stat" % (pid)) as f:
+            # the command name may contain spaces, the fields after it are fixed
+            fields=f.read().rsplit(")", 1)[1].split()
+        return int(fields[11]) + int(fields[12])
+    except (IOError, OSError, IndexError, ValueError):
+        return None
+
+def setLoopbackLatency(ms):
+    # replace rather than add, so that a qdisc left over by an aborted run does not make this fail
+    cmd="tc qdisc replace dev lo root netem delay %dms" % (ms) if ms > 0 else "tc qdisc del dev lo root netem"
+    Print("Network latency: %s" % (cmd))
+    if subprocess.call(cmd.split()) != 0 and ms > 0:
+        errorExit("Failed to set loopback latency, tc needs root")
+
+def summarize(values):
+    if not values:
+        return {"count": 0}
+    values=sorted(values)
+    return {"count": len(values), "mean": sum(values) / len(values), "p50": values[len(values) // 2],
+            "p99": values[min(len(values) - 1, len(values) * 99 // 100)], "max": values[-1]}
+
+def blockTiming(timeline):
+    """production phases of the blocks a node produced while the load was applied"""
+    return {
+        "blocks": len(timeline),
+        "late_blocks": sum(1 for b in timeline if b["slack_us"] < 0),
+        "slack_us": summarize([b["slack_us"] for b in timeline]),
+        "incoming_us": summarize([b["incoming"]["time_us"] for b in timeline]),
+        "finalize_us": summarize([b["finalize_us"] for b in timeline]),
+        "sign_us": summarize([b["sign_us"] for b in timeline]),
+        "commit_us": summarize([b["commit_us"] for b in timeline]),
+        "transactions": sum(b["incoming"]["applied"] + b["unapplied"]["applied"] for b in timeline),
+        "failed_transactions": sum(b["incoming"]["failed"] + b["unapplied"]["failed"] for b in timeline),
+    }
+
+def netLatency(samples):
+    """round trip times and receive rates of the connections of a node over all samples"""
+    peers={}
+    for sample in samples:
+        for conn in sample:
+            peer=peers.setdefault(conn["peer"], {"round_trip_us": [], "recv_bytes_per_sec": [], "timeouts": 0})
+            if conn["round_trip_us"] > 0:
+                peer["round_trip_us"].append(conn["round_trip_us"])
+            peer["recv_bytes_per_sec"].append(conn["recv_bytes_per_sec"])
+            peer["timeouts"]=max(peer["timeouts"], conn["timeouts"])
+    return {peer: {"round_trip_us": summarize(s["round_trip_us"]), "recv_bytes_per_sec": summarize(s["recv_bytes_per_sec"]),
+                   "timeouts": s["timeouts"]} for peer, s in peers.items()}
+
+try:
+    TestHelper.printSystemInfo("BEGIN")
+    cluster.setWalletMgr(walletMgr)
+
+    cluster.killall(allInstances=killAll)
+    cluster.cleanup()
+
+    if args.latency_ms > 0:
+        setLoopbackLatency(args.latency_ms)
+
+    extraNodeosArgs=" --plugin eosio::producer_api_plugin --plugin eosio::net_api_plugin"
+    specificExtraNodeosArgs={}
+    for i in range(0, generatorNodes):
+        specificExtraNodeosArgs[str(i)]="--plugin eosio::txn_test_gen_plugin --txn-test-gen-mix %s" % (args.txn_test_gen_mix)
+
+    Print("Stand up cluster of %d nodes, %d producing, topology %s" % (totalNodes, pnodes, args.topology))
+    # no system contract, txn_test_gen_plugin creates its accounts without buying ram
+    if cluster.launch(pnodes=pnodes, totalNodes=totalNodes, topo=args.topology, p2pPlugin=args.p2p_plugin, delay=args.d,
+                      totalProducers=pnodes, extraNodeosArgs=extraNodeosArgs, specificExtraNodeosArgs=specificExtraNodeosArgs,
+                      useBiosBootFile=False, loadSystemContract=False) is False:
+        Utils.cmdError("launcher")
+        errorExit("Failed to stand up eos cluster.")
+
+    nodes=[cluster.getNode(i) for i in range(0, totalNodes)]
+    generators=nodes[:generatorNodes]
+
+    Print("Create test accounts via node 0")
+    apiCall(generators[0], "txn_test_gen", "create_test_accounts", [cluster.eosioAccount.name, cluster.eosioAccount.activePrivateKey])
+    if not cluster.waitOnClusterSync(blockAdvancing=3):
+        errorExit("Cluster did not sync after creating the test accounts")
+
+    startInfo=[apiCall(node, "chain", "get_info") for node in nodes]
+    startTicks=[cpuTicks(node.pid) for node in nodes]
+    startTime=time.time()
+
+    tpsPerNode=max(args.tps // generatorNodes, 1)
+    for i, node in enumerate(generators):
+        Print("Start open loop of %d transactions per second on node %d" % (tpsPerNode, i))
+        apiCall(node, "txn_test_gen", "start_open_loop", ["perf%d" % (i), tpsPerNode])
+
+    # cpu use is sampled rather than only measured over the whole run, so that spikes show
+    ticksPerSec=os.sysconf("SC_CLK_TCK")
+    cpuSamples=[[] for _ in nodes]
+    connectionSamples=[[] for _ in nodes]
+    lastTicks=list(startTicks)
+    lastSample=startTime
+    while time.time() - startTime < args.duration:
+        time.sleep(min(args.sample_interval, max(args.duration - (time.time() - startTime), 0.1)))
+        now=time.time()
+        for i, node in enumerate(nodes):
+            ticks=cpuTicks(node.pid)
+            if ticks is not None and lastTicks[i] is not None:
+                cpuSamples[i].append(100.0 * (ticks - lastTicks[i]) / ticksPerSec / (now - lastSample))
+            lastTicks[i]=ticks
+            try:
+                connectionSamples[i].append(apiCall(node, "net", "connections"))
+            except Exception as e:
+                Print("WARNING: failed to get the connections of node %d: %s" % (i, e))
+        lastSample=now
+
+    for node in generators:
+        apiCall(node, "txn_test_gen", "stop_generation")
+    elapsed=time.time() - startTime
+
+    # let the transactions in flight reach irreversibility before their latencies are read
+    Print("Wait for the last transactions to become irreversible")
+    time.sleep(0.5 * 12 * (pnodes + 1) + 5)
+
+    report={"parameters": {"producer_nodes": pnodes, "total_nodes": totalNodes, "topology": args.topology,
+                           "latency_ms": args.latency_ms, "tps": args.tps, "duration_sec": args.duration,
+                           "generator_nodes": generatorNodes, "txn_test_gen_mix": args.txn_test_gen_mix,
+                           "p2p_plugin": args.p2p_plugin},
+            "nodes": []}
+    for i, node in enumerate(nodes):
+        endInfo=apiCall(node, "chain", "get_info")
+        blocks=endInfo["head_block_num"] - startInfo[i]["head_block_num"]
+        timeline=[b for b in apiCall(node, "producer", "get_block_timeline", {"limit": blocks})
+                  if b["block_num"] > startInfo[i]["head_block_num"]]
+        ticks=cpuTicks(node.pid)
+        entry={"node": i, "pid": node.pid,
+               "head_block_num": endInfo["head_block_num"],
+               "lib_lag": endInfo["head_block_num"] - endInfo["last_irreversible_block_num"],
+               "cpu_percent": {"run": 100.0 * (ticks - startTicks[i]) / ticksPerSec / elapsed
+                                      if ticks is not None and startTicks[i] is not None else None,
+                               "samples": summarize(cpuSamples[i])},
+               "block_timing": blockTiming(timeline),
+               "net": netLatency(connectionSamples[i])}
+        if node in generators:
+            entry["txn_test_gen"]=apiCall(node, "txn_test_gen", "get_latency_stats")
+        report["nodes"].append(entry)
+
+    with open(args.report, "w") as f:
+        json.dump(report, f, indent=2)
+    Print("Report written to %s" % (args.report))
+
+    Print("%5s %9s %8s %8s %11s %11s %12s %12s" % ("node", "cpu%", "blocks", "late", "slack p50", "rtt p50", "incl p99", "irr p99"))
+    for entry in report["nodes"]:
+        rtts=[p["round_trip_us"]["p50"] for p in entry["net"].values() if p["round_trip_us"]["count"]]
+        gen=entry.get("txn_test_gen")
+        Print("%5d %9.1f %8d %8d %11s %11s %12s %12s" % (entry["node"], entry["cpu_percent"]["run"] or 0,
+              entry["block_timing"]["blocks"], entry["block_timing"]["late_blocks"],
+              entry["block_timing"]["slack_us"].get("p50", "-"), max(rtts) if rtts else "-",
+              gen["inclusion"]["p99_us"] if gen else "-", gen["irreversible"]["p99_us"] if gen else "-"))
+
+    testSuccessful=True
+finally:
+    if args.latency_ms > 0:
+        setLoopbackLatency(0)
+    TestHelper.shutdown(cluster, walletMgr, testSuccessful, killEosInstances, killWallet, keepLogs, killAll, dumpErrorDetails)
+
+exit(0)
@@ -181,6 +181,20 @@ BOOST_AUTO_TEST_CASE(wallet_manager_test)
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey1.get_public_key()) != pks.cend());
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey2.get_public_key()) != pks.cend());
 
+   // a batch is signed the same as its transactions one at a time
+   vector<chain::signed_transaction> batch(5);
+   for (size_t i = 0; i < batch.size(); ++i)
+      batch[i].ref_block_num = i;
+   wm.set_sign_threads(2);
+   auto signed_batch = wm.sign_transactions(batch, pubkeys, chain_id);
+   BOOST_REQUIRE_EQUAL(batch.size(), signed_batch.size());
+   for (size_t i = 0; i < batch.size(); ++i) {
+      BOOST_CHECK_EQUAL(i, signed_batch[i].ref_block_num);
+      BOOST_CHECK(signed_batch[i].signatures == wm.sign_transaction(batch[i], pubkeys, chain_id).signatures);
+   }
+   flat_set<public_key_type> missing{private_key_type::generate().get_public_key()};
+   BOOST_CHECK_THROW(wm.sign_transactions(batch, missing, chain_id), chain::wallet_missing_pub_key_exception);
+
    BOOST_CHECK_EQUAL(3, wm.get_public_keys().size());
    wm.set_timeout(chrono::seconds(0));
    BOOST_CHECK_THROW(wm.get_public_keys(), wallet_locked_exception);
@@ -17,6 +17,7 @@
 
 #include <eosio/chain/contract_types.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/abi_generator/abi_generator.hpp>
 #include <eosio/testing/tester.hpp>
@@ -3653,6 +3654,110 @@ BOOST_AUTO_TEST_CASE(extend)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(copied_serializer)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [
+         {"new_type_name": "point_t", "type": "point"},
+      ],
+      "structs": [
+         {"name": "point", "base": "", "fields": [
+            {"name": "x", "type": "int32"},
+            {"name": "y", "type": "int32"},
+         ]},
+         {"name": "path", "base": "", "fields": [
+            {"name": "points", "type": "point_t[]"},
+            {"name": "name", "type": "string?"},
+            {"name": "tag", "type": "v1"},
+         ]}
+      ],
+      "variants": [
+         {"name": "v1", "types": ["int8", "point_t"]},
+      ],
+   })";
+
+   try {
+      // the type plans of a serializer refer to its own definitions, a copy must not use the ones of the original
+      optional<abi_serializer> original( abi_serializer(fc::json::from_string(abi).as<abi_def>(), max_serialization_time) );
+      abi_serializer copied( *original );
+      abi_serializer assigned;
+      assigned = *original;
+      original.reset();
+
+      for( const auto* abis : { &copied, &assigned } ) {
+         verify_round_trip_conversion(*abis, "path", R"({"points":[{"x":1,"y":2}],"name":"ab","tag":["int8",3]})",
+                                      "010100000002000000010261620003");
+         verify_round_trip_conversion(*abis, "path", R"({"points":[],"name":null,"tag":["point_t",{"x":-1,"y":0}]})",
+                                      "000001ffffffff00000000");
+         verify_round_trip_conversion(*abis, "point_t[]", R"([{"x":1,"y":2}])", "010100000002000000");
+      }
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(binary_to_json)
+{
+   using eosio::testing::fc_exception_message_is;
+
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [
+         {"new_type_name": "point_t", "type": "point"},
+      ],
+      "structs": [
+         {"name": "point", "base": "", "fields": [
+            {"name": "x", "type": "int32"},
+            {"name": "y", "type": "int32"},
+         ]},
+         {"name": "point3", "base": "point", "fields": [
+            {"name": "z", "type": "int32"},
+            {"name": "label", "type": "string$"},
+         ]},
+         {"name": "shadow", "base": "point", "fields": [
+            {"name": "x", "type": "string"},
+         ]},
+         {"name": "shape", "base": "", "fields": [
+            {"name": "points", "type": "point_t[]"},
+            {"name": "owner", "type": "name?"},
+            {"name": "big", "type": "uint64"},
+            {"name": "tags", "type": "v1[]"},
+            {"name": "corner", "type": "point3?"},
+         ]}
+      ],
+      "variants": [
+         {"name": "v1", "types": ["int8", "point_t", "string"]},
+      ],
+   })";
+
+   try {
+      abi_serializer abis(fc::json::from_string(abi).as<abi_def>(), max_serialization_time);
+
+      auto check = [&]( const type_name& type, const std::string& json ) {
+         auto bin = abis.variant_to_binary(type, fc::json::from_string(json), max_serialization_time);
+         BOOST_REQUIRE_EQUAL( abis.binary_to_json(type, bin, max_serialization_time),
+                              fc::json::to_string(abis.binary_to_variant(type, bin, max_serialization_time)) );
+      };
+
+      check("shape", R"({"points":[{"x":1,"y":2},{"x":-3,"y":4}],"owner":"alice","big":"18446744073709551615","tags":[["int8",1],["point_t",{"x":5,"y":6}],["string","a\"b"]],"corner":{"x":7,"y":8,"z":9,"label":"c"}})");
+      check("shape", R"({"points":[],"owner":null,"big":7,"tags":[],"corner":null})");
+      check("point3", R"({"x":1,"y":2,"z":3})");
+
+      // a field repeating a name of its base cannot come from JSON, but can be unpacked
+      auto shadow = fc::variant("0100000002000000026162").as<bytes>();
+      BOOST_REQUIRE_EQUAL( abis.binary_to_json("shadow", shadow, max_serialization_time),
+                           fc::json::to_string(abis.binary_to_variant("shadow", shadow, max_serialization_time)) );
+
+      check("point_t[]", R"([{"x":1,"y":2}])");
+      check("point[]", R"([{"x":1,"y":2}])");
+      check("uint64", R"("5")");
+
+      BOOST_CHECK_EXCEPTION( abis.binary_to_json("point3", fc::variant("0100000002000000").as<bytes>(), max_serialization_time),
+                             unpack_exception, fc_exception_message_is("Stream unexpectedly ended; unable to unpack field 'z' of struct 'point3'") );
+      BOOST_CHECK_EXCEPTION( abis.binary_to_json("v1", fc::variant("05").as<bytes>(), max_serialization_time),
+                             unpack_exception, fc_exception_message_is("Unpacked invalid tag (5) for variant 'v1'") );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE(version)
 {
    try {
@@ -3991,4 +4096,54 @@ BOOST_AUTO_TEST_CASE(abi_deserialize_detailed_error_messages)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(serializer_cache)
+{ try {
+   const char* first_abi = R"=====(
+   {
+      "version": "eosio::abi/1.0",
+      "structs": [{"name": "hi", "base": "", "fields": [{"name": "user", "type": "name"}]}],
+      "actions": [{"name": "hi", "type": "hi", "ricardian_contract": ""}]
+   }
+   )=====";
+   const char* second_abi = R"=====(
+   {
+      "version": "eosio::abi/1.0",
+      "structs": [{"name": "bye", "base": "", "fields": [{"name": "user", "type": "name"}]}],
+      "actions": [{"name": "bye", "type": "bye", "ricardian_contract": ""}]
+   }
+   )=====";
+
+   eosio::testing::tester chain;
+   chain.create_accounts( {N(abicache), N(noabi)} );
+   chain.set_abi( N(abicache), first_abi );
+   chain.produce_block();
+
+   abi_serializer_cache cache( 1 );
+   const auto& db = chain.control->db();
+
+   BOOST_CHECK( !cache.get( db, N(noabi), max_serialization_time ) );
+   BOOST_CHECK( !cache.get( db, N(unknown), max_serialization_time ) );
+   BOOST_CHECK_EQUAL( cache.size(), 0u );
+
+   auto first = cache.get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( first );
+   BOOST_CHECK_EQUAL( first->get_action_type( N(hi) ), "hi" );
+   BOOST_CHECK( first == cache.get( db, N(abicache), max_serialization_time ) );
+
+   // a later setabi is picked up without anyone telling the cache
+   chain.set_abi( N(abicache), second_abi );
+   auto second = cache.get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( second );
+   BOOST_CHECK( second != first );
+   BOOST_CHECK_EQUAL( second->get_action_type( N(bye) ), "bye" );
+   BOOST_CHECK_EQUAL( first->get_action_type( N(hi) ), "hi" );
+
+   // and so is the undo of the setabi when the pending block is dropped
+   chain.control->abort_block();
+   auto reverted = cache.get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( reverted );
+   BOOST_CHECK_EQUAL( reverted->get_action_type( N(hi) ), "hi" );
+   BOOST_CHECK_EQUAL( cache.size(), 1u );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
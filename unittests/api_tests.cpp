@@ -586,6 +586,16 @@ BOOST_FIXTURE_TEST_CASE(cf_action_tests, TESTER) { try {
       BOOST_CHECK_EQUAL(ttrace->action_traces[0].inline_traces[0].act.name, account_name("event1"));
       BOOST_CHECK_EQUAL(ttrace->action_traces[0].inline_traces[0].act.authorization.size(), 0);
 
+      // trimmed traces keep the receipts, without the copies of the actions or the inline traces
+      produce_block();
+      control->set_trim_action_traces(true);
+      ttrace = CALL_TEST_FUNCTION( *this, "test_transaction", "send_cf_action", {} );
+      control->set_trim_action_traces(false);
+      BOOST_CHECK_EQUAL(ttrace->action_traces.size(), 1);
+      BOOST_CHECK_EQUAL(ttrace->action_traces[0].receipt.receiver, account_name("testapi"));
+      BOOST_CHECK_EQUAL(ttrace->action_traces[0].act.name, action_name());
+      BOOST_CHECK(ttrace->action_traces[0].inline_traces.empty());
+
       BOOST_CHECK_EXCEPTION( CALL_TEST_FUNCTION( *this, "test_transaction", "send_cf_action_fail", {} ),
                              eosio_assert_message_exception,
                              eosio_assert_message_is("context free actions cannot have authorizations") );
@@ -1296,6 +1306,7 @@ BOOST_FIXTURE_TEST_CASE(db_tests, TESTER) { try {
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_general", {});
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_lowerbound", {});
    CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_upperbound", {});
+   CALL_TEST_FUNCTION( *this, "test_db", "primary_i64_next_many", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_general", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_lowerbound", {});
    CALL_TEST_FUNCTION( *this, "test_db", "idx64_upperbound", {});
@@ -1429,6 +1440,8 @@ BOOST_FIXTURE_TEST_CASE(multi_index_tests, TESTER) { try {
                                            eosio_assert_message_exception, "unable to find sec key");
    CALL_TEST_FUNCTION( *this, "test_multi_index", "idx64_sk_cache_pk_lookup", {});
    CALL_TEST_FUNCTION( *this, "test_multi_index", "idx64_pk_cache_sk_lookup", {});
+   CALL_TEST_FUNCTION( *this, "test_multi_index", "idx64_cache_many_rows", {});
+   CALL_TEST_FUNCTION( *this, "test_multi_index", "idx64_read_packed", {});
 
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
@@ -1515,6 +1528,11 @@ BOOST_FIXTURE_TEST_CASE(crypto_tests, TESTER) { try {
 
    CALL_TEST_FUNCTION( *this, "test_crypto", "assert_ripemd160_true", {} );
 
+   CALL_TEST_FUNCTION( *this, "test_crypto", "test_merkle_root", {} );
+   CALL_TEST_FUNCTION( *this, "test_crypto", "assert_merkle_branch_true", {} );
+   CALL_TEST_FUNCTION_AND_CHECK_EXCEPTION( *this, "test_crypto", "assert_merkle_branch_false", {},
+                                           crypto_api_exception, "merkle branch mismatch" );
+
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
 
@@ -1936,6 +1954,8 @@ BOOST_FIXTURE_TEST_CASE(datastream_tests, TESTER) { try {
    produce_blocks(1000);
 
    CALL_TEST_FUNCTION( *this, "test_datastream", "test_basic", {} );
+   CALL_TEST_FUNCTION( *this, "test_datastream", "test_views", {} );
+   CALL_TEST_FUNCTION( *this, "test_datastream", "test_packed", {} );
 
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
@@ -519,4 +519,56 @@ BOOST_AUTO_TEST_CASE( linkauth_special ) { try {
 } FC_LOG_AND_RETHROW() }
 
 
+BOOST_AUTO_TEST_CASE( authority_cache ) { try {
+   TESTER chain;
+
+   chain.create_account("alice");
+   chain.produce_block();
+
+   const auto old_priv_key = chain.get_private_key("alice", "active");
+   const auto new_priv_key = chain.get_private_key("alice", "new");
+   uint32_t nonce = 0;
+
+   // transactions in the same block, each with a distinct id so the satisfied authorization is looked up again
+   auto reqauth = [&]( const private_key_type& key ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( chain.get_action( config::system_account_name, N(reqauth),
+                                                  vector<permission_level>{{N(alice), config::active_name}},
+                                                  fc::mutable_variant_object()("from", "alice") ) );
+      chain.set_transaction_headers( trx, base_tester::DEFAULT_EXPIRATION_DELTA + ++nonce );
+      trx.sign( key, chain.control->get_chain_id() );
+      return chain.push_transaction( trx );
+   };
+
+   reqauth( old_priv_key );
+   reqauth( old_priv_key );
+
+   // a failed update is undone along with the authority revision it took
+   {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}},
+                                updateauth{ .account = N(alice), .permission = config::active_name, .parent = config::owner_name,
+                                            .auth = authority( new_priv_key.get_public_key() ) } );
+      trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}},
+                                updateauth{ .account = N(alice), .permission = config::active_name, .parent = config::owner_name,
+                                            .auth = authority( 0, {}, {} ) } );
+      chain.set_transaction_headers( trx );
+      trx.sign( old_priv_key, chain.control->get_chain_id() );
+      BOOST_REQUIRE_THROW( chain.push_transaction( trx ), action_validate_exception );
+   }
+   reqauth( old_priv_key );
+   BOOST_REQUIRE_THROW( reqauth( new_priv_key ), unsatisfied_authorization );
+
+   // a successful update within the same block makes the earlier results stale
+   chain.set_authority( N(alice), config::active_name, authority( new_priv_key.get_public_key() ) );
+   BOOST_REQUIRE_THROW( reqauth( old_priv_key ), unsatisfied_authorization );
+   reqauth( new_priv_key );
+   reqauth( new_priv_key );
+
+   chain.produce_block();
+   BOOST_REQUIRE_THROW( reqauth( old_priv_key ), unsatisfied_authorization );
+   reqauth( new_priv_key );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
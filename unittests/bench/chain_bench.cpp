@@ -0,0 +1,443 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  In-process chain throughput benchmarks, built on the tester like the unit tests and run the same way:
+ *
+ *     chain_bench [-t scenario] -- [--wavm|--wabt] [--verbose] [--bench-blocks=N] [--bench-txns-per-block=N]
+ *                                  [--bench-rows=N] [--bench-row-size=N] [--bench-fanout=N] [--bench-cached-rows=N]
+ *                                  [--bench-payouts=N] [--bench-rounds=N] [--bench-output=FILE]
+ *
+ *  Every test case is one scenario. The results of all scenarios run are written as one JSON array to FILE,
+ *  or to stdout, so that the numbers of different commits can be compared.
+ */
+#include <boost/test/included/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <eosio.token/eosio.token.wast.hpp>
+#include <eosio.token/eosio.token.abi.hpp>
+#include <eosio.token/eosio.token.arena.wast.hpp>
+#include <eosio.system/eosio.system.wast.hpp>
+#include <eosio.system/eosio.system.abi.hpp>
+#include <eosio.system/eosio.system.arena.wast.hpp>
+#include <test_ram_limit/test_ram_limit.wast.hpp>
+#include <test_ram_limit/test_ram_limit.abi.hpp>
+#include <deferred_test/deferred_test.wast.hpp>
+#include <deferred_test/deferred_test.abi.hpp>
+#include <test.inline/test.inline.wast.hpp>
+#include <test.inline/test.inline.abi.hpp>
+#include <multi_index_bench/multi_index_bench.wast.hpp>
+#include <multi_index_bench/multi_index_bench.abi.hpp>
+#include <int128_bench/int128_bench.wast.hpp>
+#include <int128_bench/int128_bench.abi.hpp>
+#include <test_api_db/test_api_db.wast.hpp>
+#include <test_api_multi_index/test_api_multi_index.wast.hpp>
+
+#define DISABLE_EOSLIB_SERIALIZE
+#include <test_api/test_api_common.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+   // every operator new of the process is counted, allocations per transaction are the delta while it is pushed
+   std::atomic<uint64_t> allocations{0};
+}
+
+void* operator new( size_t size ) {
+   allocations.fetch_add( 1, std::memory_order_relaxed );
+   if( void* p = std::malloc( size ? size : 1 ) )
+      return p;
+   throw std::bad_alloc();
+}
+void* operator new[]( size_t size ) { return ::operator new( size ); }
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete[]( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, size_t ) noexcept { std::free( p ); }
+void operator delete[]( void* p, size_t ) noexcept { std::free( p ); }
+
+namespace {
+
+   struct bench_result {
+      string      scenario;
+      fc::variant parameters;
+      uint32_t    blocks = 0;
+      uint32_t    transactions = 0;
+      double      txns_per_sec = 0;       ///< over pushing the transactions and producing their blocks
+      int64_t     p50_apply_us = 0;
+      int64_t     p99_apply_us = 0;
+      double      allocations_per_txn = 0;
+   };
+
+   struct bench_options {
+      uint32_t blocks = 20;
+      uint32_t txns_per_block = 100;
+      // the rows stay, keep blocks * txns_per_block * rows * row_size well below the 8 MB state of the tester
+      uint32_t rows = 4;        ///< table rows written per transaction by the ram scenario
+      uint32_t row_size = 128;  ///< bytes per row of the ram scenario
+      uint32_t fanout = 10;     ///< actions, each sending an inline action, per transaction of the inline scenario
+      uint32_t cached_rows = 200; ///< rows every transaction of the multi_index scenario loads into its object cache
+      uint32_t payouts = 50;    ///< eosio.token payouts per transaction of the payout scenarios
+      uint32_t rounds = 400;    ///< loop iterations per transaction of the int128 scenario
+      string   output;
+   };
+
+   bench_options options;
+   vector<bench_result> results;
+
+   void uint_arg( const string& arg, const char* prefix, uint32_t& value ) {
+      if( arg.compare( 0, strlen( prefix ), prefix ) == 0 )
+         value = std::stoul( arg.substr( strlen( prefix ) ) );
+   }
+
+   void write_results() {
+      auto json = fc::json::to_pretty_string( results );
+      if( options.output.empty() ) {
+         std::cout << json << std::endl;
+      } else {
+         std::ofstream out( options.output.c_str() );
+         out << json << std::endl;
+      }
+   }
+
+   class bench_tester : public tester {
+      public:
+         // billed explicitly, so that the cpu limits of a block do not depend on the machine the benchmark runs on
+         static const uint32_t billed_cpu_time_us = 100;
+
+         bench_tester() {
+            produce_blocks( 2 );
+         }
+
+         void deploy( account_name account, const char* wast, const char* abi ) {
+            create_accounts( { account } );
+            set_code( account, wast );
+            set_abi( account, abi );
+            produce_blocks();
+         }
+
+         signed_transaction make_transaction( vector<action>&& actions ) {
+            signed_transaction trx;
+            trx.actions = std::move( actions );
+            set_transaction_headers( trx );
+            // a distinct net usage cap keeps transactions with the same actions from being duplicates
+            trx.max_net_usage_words = 1000000 + nonce++;
+            std::set<account_name> signers;
+            for( const auto& a : trx.actions )
+               for( const auto& p : a.authorization )
+                  signers.insert( p.actor );
+            for( auto s : signers )
+               trx.sign( get_private_key( s, "active" ), control->get_chain_id() );
+            return trx;
+         }
+
+         /// pushes options.blocks blocks of options.txns_per_block transactions made by make( index )
+         bench_result run( const string& scenario, fc::variant parameters,
+                           const std::function<vector<action>(uint32_t)>& make ) {
+            bench_result r;
+            r.scenario = scenario;
+            r.parameters = std::move( parameters );
+            r.blocks = options.blocks;
+
+            vector<int64_t> latencies;
+            uint64_t allocated = 0;
+            fc::microseconds total;
+            uint32_t index = 0;
+            for( uint32_t b = 0; b < options.blocks; ++b ) {
+               // signing is not what is measured, so the transactions of a block are made up front
+               vector<signed_transaction> trxs;
+               for( uint32_t i = 0; i < options.txns_per_block; ++i )
+                  trxs.emplace_back( make_transaction( make( index++ ) ) );
+
+               auto block_start = fc::time_point::now();
+               for( auto& trx : trxs ) {
+                  auto allocations_before = allocations.load( std::memory_order_relaxed );
+                  auto start = fc::time_point::now();
+                  auto trace = push_transaction( trx, fc::time_point::maximum(), billed_cpu_time_us );
+                  latencies.push_back( (fc::time_point::now() - start).count() );
+                  allocated += allocations.load( std::memory_order_relaxed ) - allocations_before;
+                  EOS_ASSERT( !trace->except, transaction_exception, "${s} transaction failed: ${e}",
+                              ("s", scenario)("e", trace->except->to_detail_string()) );
+               }
+               produce_block();
+               total += fc::time_point::now() - block_start;
+            }
+
+            r.transactions = latencies.size();
+            if( !latencies.empty() ) {
+               std::sort( latencies.begin(), latencies.end() );
+               r.p50_apply_us = latencies[latencies.size() / 2];
+               r.p99_apply_us = latencies[std::min( latencies.size() - 1, latencies.size() * 99 / 100 )];
+               r.txns_per_sec = r.transactions * 1000000.0 / std::max<int64_t>( total.count(), 1 );
+               r.allocations_per_txn = double( allocated ) / r.transactions;
+            }
+            results.emplace_back( r );
+            return r;
+         }
+
+      private:
+         uint32_t nonce = 0;
+   };
+
+} // anonymous namespace
+
+FC_REFLECT( bench_result, (scenario)(parameters)(blocks)(transactions)(txns_per_sec)(p50_apply_us)(p99_apply_us)(allocations_per_txn) )
+
+namespace {
+   /// a test_api contract method, run by the testapi account
+   action test_api_call( const char* cls, const char* method ) {
+      return action( { {N(testapi), config::active_name} }, N(testapi), action_name( WASM_TEST_ACTION( cls, method ) ), bytes() );
+   }
+
+   /// deploys a test_api contract to testapi and runs the methods that store the rows the lookups read
+   void deploy_test_api( bench_tester& t, const char* wast, const char* cls, const vector<const char*>& setup ) {
+      t.create_accounts( { N(testapi) } );
+      t.set_code( N(testapi), wast );
+      t.produce_blocks();
+      for( auto method : setup ) {
+         auto trx = t.make_transaction( { test_api_call( cls, method ) } );
+         t.push_transaction( trx );
+      }
+      t.produce_blocks();
+   }
+}
+
+void translate_fc_exception(const fc::exception &e) {
+   std::cerr << "\033[33m" <<  e.to_detail_string() << "\033[0m" << std::endl;
+   BOOST_TEST_FAIL("Caught Unexpected Exception");
+}
+
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
+   bool is_verbose = false;
+   for( int i = 0; i < argc; i++ ) {
+      string arg = argv[i];
+      if( arg == "--verbose" )
+         is_verbose = true;
+      uint_arg( arg, "--bench-blocks=", options.blocks );
+      uint_arg( arg, "--bench-txns-per-block=", options.txns_per_block );
+      uint_arg( arg, "--bench-rows=", options.rows );
+      uint_arg( arg, "--bench-row-size=", options.row_size );
+      uint_arg( arg, "--bench-fanout=", options.fanout );
+      uint_arg( arg, "--bench-cached-rows=", options.cached_rows );
+      uint_arg( arg, "--bench-payouts=", options.payouts );
+      uint_arg( arg, "--bench-rounds=", options.rounds );
+      if( arg.compare( 0, 15, "--bench-output=" ) == 0 )
+         options.output = arg.substr( 15 );
+   }
+   if(!is_verbose) fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+   boost::unit_test::unit_test_monitor.register_exception_translator<fc::exception>(&translate_fc_exception);
+   return nullptr;
+}
+
+struct results_writer {
+   ~results_writer() { write_results(); }
+};
+BOOST_GLOBAL_FIXTURE( results_writer );
+
+BOOST_AUTO_TEST_SUITE(chain_bench)
+
+/// eosio.token, built with the given wast, transfers between two accounts
+static void bench_transfer( const char* scenario, const char* token_wast ) {
+   bench_tester t;
+   t.create_accounts( { N(alice), N(bob) } );
+   t.deploy( N(eosio.token), token_wast, eosio_token_abi );
+   t.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                  ("issuer", "eosio.token")("maximum_supply", "1000000000.0000 TOK") );
+   t.push_action( N(eosio.token), N(issue), N(eosio.token), mvo()
+                  ("to", "alice")("quantity", "1000000000.0000 TOK")("memo", "") );
+   t.produce_blocks();
+
+   t.run( scenario, mvo(), [&]( uint32_t ) {
+      return vector<action>{ t.get_action( N(eosio.token), N(transfer), { {N(alice), config::active_name} }, mvo()
+                                           ("from", "alice")("to", "bob")("quantity", "0.0001 TOK")("memo", "") ) };
+   } );
+}
+
+/// eosio.system, built with the given wast, updating the producer registration of one account
+static void bench_regproducer( const char* scenario, const char* system_wast ) {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(eosio.token), eosio_token_wast, eosio_token_abi );
+   // the system contract reads the supply of the core symbol every time it is constructed
+   t.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                  ("issuer", "eosio")("maximum_supply", core_from_string("10000000000.0000")) );
+   t.push_action( N(eosio.token), N(issue), config::system_account_name, mvo()
+                  ("to", "eosio")("quantity", core_from_string("1000000000.0000"))("memo", "") );
+   t.set_code( config::system_account_name, system_wast );
+   t.set_abi( config::system_account_name, eosio_system_abi );
+   t.produce_blocks();
+
+   t.run( scenario, mvo(), [&]( uint32_t ) {
+      return vector<action>{ t.get_action( config::system_account_name, N(regproducer), { {N(alice), config::active_name} }, mvo()
+                                           ("producer", "alice")("producer_key", t.get_public_key( N(alice), "active" ))
+                                           ("url", "https://alice.example")("location", 0) ) };
+   } );
+}
+
+BOOST_AUTO_TEST_CASE( transfer ) { try {
+   bench_transfer( "transfer", eosio_token_wast );
+} FC_LOG_AND_RETHROW() }
+
+/// the same transfers with eosio.token linked against the arena allocator of eosiolib
+BOOST_AUTO_TEST_CASE( transfer_arena ) { try {
+   bench_transfer( "transfer_arena", eosio_token_arena_wast );
+} FC_LOG_AND_RETHROW() }
+
+/// eosio.token paying options.payouts accounts out of one balance, with one transfer or one transfers payout each
+static void bench_payouts( const char* scenario, bool batched ) {
+   bench_tester t;
+   vector<account_name> payees;
+   for( char c = 'a'; c <= 'z'; ++c )
+      payees.emplace_back( string("payee") + c );
+   t.create_accounts( payees );
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(eosio.token), eosio_token_wast, eosio_token_abi );
+   t.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                  ("issuer", "eosio.token")("maximum_supply", "1000000000.0000 TOK") );
+   t.push_action( N(eosio.token), N(issue), N(eosio.token), mvo()
+                  ("to", "alice")("quantity", "1000000000.0000 TOK")("memo", "") );
+   t.produce_blocks();
+
+   t.run( scenario, mvo()("payouts", options.payouts), [&]( uint32_t ) {
+      vector<action> actions;
+      if( batched ) {
+         vector<fc::variant> payouts;
+         for( uint32_t i = 0; i < options.payouts; ++i )
+            payouts.emplace_back( mvo()("to", payees[i % payees.size()])("quantity", "0.0001 TOK")("memo", "") );
+         actions.emplace_back( t.get_action( N(eosio.token), N(transfers), { {N(alice), config::active_name} }, mvo()
+                                             ("from", "alice")("payouts", payouts) ) );
+      } else {
+         for( uint32_t i = 0; i < options.payouts; ++i )
+            actions.emplace_back( t.get_action( N(eosio.token), N(transfer), { {N(alice), config::active_name} }, mvo()
+                                                ("from", "alice")("to", payees[i % payees.size()])
+                                                ("quantity", "0.0001 TOK")("memo", "") ) );
+      }
+      return actions;
+   } );
+}
+
+BOOST_AUTO_TEST_CASE( payouts_transfer ) { try {
+   bench_payouts( "payouts_transfer", false );
+} FC_LOG_AND_RETHROW() }
+
+/// the same payouts as one transfers action per transaction
+BOOST_AUTO_TEST_CASE( payouts_transfers ) { try {
+   bench_payouts( "payouts_transfers", true );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( system_regproducer ) { try {
+   bench_regproducer( "system_regproducer", eosio_system_wast );
+} FC_LOG_AND_RETHROW() }
+
+/// the same registrations with eosio.system linked against the arena allocator of eosiolib
+BOOST_AUTO_TEST_CASE( system_regproducer_arena ) { try {
+   bench_regproducer( "system_regproducer_arena", eosio_system_arena_wast );
+} FC_LOG_AND_RETHROW() }
+
+/// test_ram_limit writing options.rows new rows of options.row_size bytes per transaction
+BOOST_AUTO_TEST_CASE( ram ) { try {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(rambench), test_ram_limit_wast, test_ram_limit_abi );
+
+   t.run( "ram", mvo()("rows", options.rows)("row_size", options.row_size), [&]( uint32_t i ) {
+      uint64_t from = uint64_t(i) * options.rows;
+      return vector<action>{ t.get_action( N(rambench), N(setentry), { {N(alice), config::active_name} }, mvo()
+                                           ("payer", "alice")("from", from)("to", from + options.rows - 1)
+                                           ("size", options.row_size) ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// deferred_test scheduling a deferred transaction per transaction, which run when the next block is produced
+BOOST_AUTO_TEST_CASE( deferred ) { try {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(deferbench), deferred_test_wast, deferred_test_abi );
+
+   t.run( "deferred", mvo(), [&]( uint32_t i ) {
+      return vector<action>{ t.get_action( N(deferbench), N(defercall), { {N(alice), config::active_name} }, mvo()
+                                           ("payer", "alice")("sender_id", i)("contract", "deferbench")("payload", i) ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// options.fanout test.inline forward actions per transaction, each sending an inline action
+BOOST_AUTO_TEST_CASE( inline_fanout ) { try {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(inlinebench), test_inline_wast, test_inline_abi );
+
+   t.run( "inline_fanout", mvo()("fanout", options.fanout), [&]( uint32_t ) {
+      vector<action> actions;
+      for( uint32_t i = 0; i < options.fanout; ++i ) {
+         actions.emplace_back( t.get_action( N(inlinebench), N(forward), { {N(alice), config::active_name} }, mvo()
+                                             ("reqauth", "alice")("forward_code", "inlinebench")("forward_auth", "inlinebench") ) );
+      }
+      return actions;
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// multi_index_bench matching options.cached_rows orders, each looked up by primary key while iterating by price
+BOOST_AUTO_TEST_CASE( multi_index_cache ) { try {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(mibench), multi_index_bench_wast, multi_index_bench_abi );
+   t.push_action( N(mibench), N(fill), N(mibench), mvo()("payer", "mibench")("count", options.cached_rows) );
+   t.produce_blocks();
+
+   t.run( "multi_index_cache", mvo()("cached_rows", options.cached_rows), [&]( uint32_t ) {
+      return vector<action>{ t.get_action( N(mibench), N(match), { {N(alice), config::active_name} }, mvo()
+                                           ("rounds", 2) ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// int128_bench running options.rounds rounds of 128 bit fixed point arithmetic per transaction
+BOOST_AUTO_TEST_CASE( int128_math ) { try {
+   bench_tester t;
+   t.create_accounts( { N(alice) } );
+   t.deploy( N(int128bench), int128_bench_wast, int128_bench_abi );
+
+   t.run( "int128_math", mvo()("rounds", options.rounds), [&]( uint32_t ) {
+      return vector<action>{ t.get_action( N(int128bench), N(mix), { {N(alice), config::active_name} }, mvo()
+                                           ("rounds", options.rounds) ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// the primary and secondary index lookups of test_api_db, taking turns, over rows stored up front
+BOOST_AUTO_TEST_CASE( db_lookup ) { try {
+   bench_tester t;
+   // the lookups only read the rows stored here, so they can be repeated
+   deploy_test_api( t, test_api_db_wast, "test_db", { "primary_i64_lowerbound", "idx64_general" } );
+
+   static const char* const lookups[] = { "primary_i64_upperbound", "idx64_lowerbound", "idx64_upperbound" };
+   t.run( "db_lookup", mvo(), [&]( uint32_t i ) {
+      return vector<action>{ test_api_call( "test_db", lookups[i % 3] ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+/// test_api_multi_index finding rows stored up front by their primary and secondary keys
+BOOST_AUTO_TEST_CASE( multi_index_lookup ) { try {
+   bench_tester t;
+   deploy_test_api( t, test_api_multi_index_wast, "test_multi_index", { "idx64_store_only" } );
+
+   t.run( "multi_index_lookup", mvo(), [&]( uint32_t ) {
+      return vector<action>{ test_api_call( "test_multi_index", "idx64_check_without_storing" ) };
+   } );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
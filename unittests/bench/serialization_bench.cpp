@@ -0,0 +1,222 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  fc::raw pack, unpack and pack_size timings of the core chain types, on payloads produced by a tester chain
+ *  of 21 producers running eosio.token transfers:
+ *
+ *     serialization_bench [-t type] -- [--verbose] [--bench-iterations=N] [--bench-txns-per-block=N]
+ *                                      [--bench-output=FILE]
+ *
+ *  Every test case is one type. The results of all types run are written as one JSON array to FILE, or to stdout,
+ *  in nanoseconds per object, so that the numbers of different commits can be compared.
+ */
+#include <boost/test/included/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <eosio.token/eosio.token.wast.hpp>
+#include <eosio.token/eosio.token.abi.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   struct bench_result {
+      string   type;
+      uint32_t objects = 0;        ///< distinct objects, each handled once per iteration
+      uint32_t iterations = 0;
+      double   bytes_per_object = 0;
+      double   pack_ns = 0;
+      double   pack_size_ns = 0;
+      double   unpack_ns = 0;
+   };
+
+   struct bench_options {
+      uint32_t iterations = 1000;
+      uint32_t txns_per_block = 100;
+      string   output;
+   };
+
+   bench_options options;
+   vector<bench_result> results;
+
+   void uint_arg( const string& arg, const char* prefix, uint32_t& value ) {
+      if( arg.compare( 0, strlen( prefix ), prefix ) == 0 )
+         value = std::stoul( arg.substr( strlen( prefix ) ) );
+   }
+
+   void write_results() {
+      auto json = fc::json::to_pretty_string( results );
+      if( options.output.empty() ) {
+         std::cout << json << std::endl;
+      } else {
+         std::ofstream out( options.output.c_str() );
+         out << json << std::endl;
+      }
+   }
+
+   /// what a busy chain hands to the serializers, made once for all test cases
+   struct payloads {
+      vector<signed_block>        blocks;
+      vector<packed_transaction>  transactions;
+      vector<action_trace>        action_traces; ///< with the inline traces of the transfer notifications
+      vector<block_header_state>  header_states;
+
+      static const payloads& get() {
+         static payloads p;
+         return p;
+      }
+
+      private:
+         payloads() {
+            tester t;
+            vector<account_name> producers;
+            for( char c = 'a'; c <= 'u'; ++c )
+               producers.emplace_back( string( "defproducer" ) + c );
+            t.create_accounts( producers );
+            t.set_producers( producers );
+            for( uint32_t i = 0; i < 1000 && t.control->head_block_state()->active_schedule.producers.size() != producers.size(); ++i )
+               t.produce_block();
+            EOS_ASSERT( t.control->head_block_state()->active_schedule.producers.size() == producers.size(),
+                        producer_schedule_exception, "producer schedule did not become active" );
+
+            t.create_accounts( { N(eosio.token), N(alice), N(bob) } );
+            t.set_code( N(eosio.token), eosio_token_wast );
+            t.set_abi( N(eosio.token), eosio_token_abi );
+            t.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                           ("issuer", "eosio.token")("maximum_supply", "1000000000.0000 TOK") );
+            t.push_action( N(eosio.token), N(issue), N(eosio.token), mvo()
+                           ("to", "alice")("quantity", "1000000000.0000 TOK")("memo", "") );
+            // a full round, so that every producer has produced and confirmed blocks in the header state
+            t.produce_blocks( producers.size() * config::producer_repetitions );
+
+            for( uint32_t b = 0; b < 5; ++b ) {
+               for( uint32_t i = 0; i < options.txns_per_block; ++i ) {
+                  auto trace = t.push_action( N(eosio.token), N(transfer), N(alice), mvo()
+                                              ("from", "alice")("to", "bob")("quantity", "0.0001 TOK")
+                                              ("memo", "serialization benchmark " + std::to_string( b * options.txns_per_block + i )) );
+                  for( const auto& at : trace->action_traces )
+                     action_traces.emplace_back( at );
+               }
+               auto block = t.produce_block();
+               blocks.emplace_back( *block );
+               header_states.emplace_back( *t.control->head_block_state() );
+               for( const auto& r : block->transactions )
+                  if( r.trx.contains<packed_transaction>() )
+                     transactions.emplace_back( r.trx.get<packed_transaction>() );
+            }
+         }
+   };
+
+   template<typename T>
+   bench_result run( const string& type, const vector<T>& objects ) {
+      bench_result r;
+      r.type = type;
+      r.objects = objects.size();
+      r.iterations = options.iterations;
+      EOS_ASSERT( !objects.empty(), fc::assert_exception, "no ${t} payloads", ("t", type) );
+
+      vector<bytes> packed;
+      size_t total_bytes = 0;
+      for( const auto& o : objects ) {
+         packed.emplace_back( fc::raw::pack( o ) );
+         total_bytes += packed.back().size();
+      }
+      r.bytes_per_object = double( total_bytes ) / objects.size();
+
+      // summed up and checked, so the compiler cannot drop the work being timed
+      size_t sink = 0;
+      auto per_object_ns = [&]( fc::time_point start ) {
+         return (fc::time_point::now() - start).count() * 1000.0 / (double( objects.size() ) * options.iterations);
+      };
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < options.iterations; ++i )
+         for( const auto& o : objects )
+            sink += fc::raw::pack( o ).size();
+      r.pack_ns = per_object_ns( start );
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < options.iterations; ++i )
+         for( const auto& o : objects )
+            sink += fc::raw::pack_size( o );
+      r.pack_size_ns = per_object_ns( start );
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < options.iterations; ++i ) {
+         for( const auto& p : packed ) {
+            T o;
+            fc::datastream<const char*> ds( p.data(), p.size() );
+            fc::raw::unpack( ds, o );
+            sink += ds.tellp();
+         }
+      }
+      r.unpack_ns = per_object_ns( start );
+
+      EOS_ASSERT( sink == 3 * total_bytes * options.iterations, fc::assert_exception,
+                  "${t} did not round trip through fc::raw", ("t", type) );
+      results.emplace_back( r );
+      return r;
+   }
+
+} // anonymous namespace
+
+FC_REFLECT( bench_result, (type)(objects)(iterations)(bytes_per_object)(pack_ns)(pack_size_ns)(unpack_ns) )
+
+void translate_fc_exception(const fc::exception &e) {
+   std::cerr << "\033[33m" <<  e.to_detail_string() << "\033[0m" << std::endl;
+   BOOST_TEST_FAIL("Caught Unexpected Exception");
+}
+
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
+   bool is_verbose = false;
+   for( int i = 0; i < argc; i++ ) {
+      string arg = argv[i];
+      if( arg == "--verbose" )
+         is_verbose = true;
+      uint_arg( arg, "--bench-iterations=", options.iterations );
+      uint_arg( arg, "--bench-txns-per-block=", options.txns_per_block );
+      if( arg.compare( 0, 15, "--bench-output=" ) == 0 )
+         options.output = arg.substr( 15 );
+   }
+   if(!is_verbose) fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+   boost::unit_test::unit_test_monitor.register_exception_translator<fc::exception>(&translate_fc_exception);
+   return nullptr;
+}
+
+struct results_writer {
+   ~results_writer() { write_results(); }
+};
+BOOST_GLOBAL_FIXTURE( results_writer );
+
+BOOST_AUTO_TEST_SUITE(serialization_bench)
+
+BOOST_AUTO_TEST_CASE( signed_block ) { try {
+   run( "signed_block", payloads::get().blocks );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( packed_transaction ) { try {
+   run( "packed_transaction", payloads::get().transactions );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( action_trace ) { try {
+   run( "action_trace", payloads::get().action_traces );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( block_header_state ) { try {
+   run( "block_header_state", payloads::get().header_states );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
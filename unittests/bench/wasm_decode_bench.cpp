@@ -0,0 +1,174 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ *
+ *  Timings of decoding and validating wasm into WAVM's IR, the parse every instantiation of a contract starts with,
+ *  over the wasm files of unittests/contracts and a few of the contracts built with the tree:
+ *
+ *     wasm_decode_bench [-t corpus] -- [--verbose] [--bench-iterations=N] [--bench-corpus=DIR] [--bench-output=FILE]
+ *
+ *  Most of the unittests corpus is malformed on purpose; rejecting it is timed the same way. The results of all
+ *  modules are written as one JSON array to FILE, or to stdout, so that the numbers of different commits can be
+ *  compared.
+ */
+#include <boost/test/included/unit_test.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/wast_to_wasm.hpp>
+
+#include <eosio.token/eosio.token.wast.hpp>
+#include <eosio.system/eosio.system.wast.hpp>
+#include <eosio.msig/eosio.msig.wast.hpp>
+#include <test_api/test_api.wast.hpp>
+
+#include <config.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "IR/Module.h"
+#include "IR/Validate.h"
+#include "Inline/Serialization.h"
+#include "WASM/WASM.h"
+
+using namespace eosio;
+using namespace eosio::chain;
+
+namespace {
+
+   struct bench_result {
+      string   module;
+      uint32_t bytes = 0;
+      uint32_t functions = 0;     ///< function bodies, zero when the module is rejected
+      bool     valid = false;
+      uint32_t iterations = 0;
+      double   decode_us = 0;     ///< per decode of the module, validation included
+      double   mb_per_sec = 0;
+   };
+
+   struct bench_options {
+      uint32_t iterations = 20;
+      string   corpus = eosio::unittests::config::wasm_corpus_path;
+      string   output;
+   };
+
+   bench_options options;
+   vector<bench_result> results;
+
+   void uint_arg( const string& arg, const char* prefix, uint32_t& value ) {
+      if( arg.compare( 0, strlen( prefix ), prefix ) == 0 )
+         value = std::stoul( arg.substr( strlen( prefix ) ) );
+   }
+
+   void write_results() {
+      auto json = fc::json::to_pretty_string( results );
+      if( options.output.empty() ) {
+         std::cout << json << std::endl;
+      } else {
+         std::ofstream out( options.output.c_str() );
+         out << json << std::endl;
+      }
+   }
+
+   /// decodes wasm into a fresh module, returning its number of function bodies or -1 when it is rejected
+   int64_t decode( const vector<uint8_t>& wasm ) {
+      IR::Module module;
+      try {
+         Serialization::MemoryInputStream stream( wasm.data(), wasm.size() );
+         WASM::serialize( stream, module );
+      } catch( const Serialization::FatalSerializationException& ) {
+         return -1;
+      } catch( const IR::ValidationException& ) {
+         return -1;
+      } catch( const fc::exception& ) {
+         // the eosio constraints checked while decoding
+         return -1;
+      }
+      return module.functions.defs.size();
+   }
+
+   bench_result run( const string& name, const vector<uint8_t>& wasm ) {
+      bench_result r;
+      r.module = name;
+      r.bytes = wasm.size();
+      r.iterations = options.iterations;
+
+      auto functions = decode( wasm );
+      r.valid = functions >= 0;
+      r.functions = r.valid ? functions : 0;
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < options.iterations; ++i )
+         EOS_ASSERT( decode( wasm ) == functions, fc::assert_exception, "${m} did not decode the same way twice", ("m", name) );
+      auto elapsed = std::max<int64_t>( (fc::time_point::now() - start).count(), 1 );
+
+      r.decode_us = double( elapsed ) / options.iterations;
+      r.mb_per_sec = double( wasm.size() ) * options.iterations / elapsed;
+      results.emplace_back( r );
+      return r;
+   }
+
+} // anonymous namespace
+
+FC_REFLECT( bench_result, (module)(bytes)(functions)(valid)(iterations)(decode_us)(mb_per_sec) )
+
+void translate_fc_exception(const fc::exception &e) {
+   std::cerr << "\033[33m" <<  e.to_detail_string() << "\033[0m" << std::endl;
+   BOOST_TEST_FAIL("Caught Unexpected Exception");
+}
+
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
+   bool is_verbose = false;
+   for( int i = 0; i < argc; i++ ) {
+      string arg = argv[i];
+      if( arg == "--verbose" )
+         is_verbose = true;
+      uint_arg( arg, "--bench-iterations=", options.iterations );
+      if( arg.compare( 0, 15, "--bench-corpus=" ) == 0 )
+         options.corpus = arg.substr( 15 );
+      if( arg.compare( 0, 15, "--bench-output=" ) == 0 )
+         options.output = arg.substr( 15 );
+   }
+   if(!is_verbose) fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::off);
+
+   boost::unit_test::unit_test_monitor.register_exception_translator<fc::exception>(&translate_fc_exception);
+   return nullptr;
+}
+
+struct results_writer {
+   ~results_writer() { write_results(); }
+};
+BOOST_GLOBAL_FIXTURE( results_writer );
+
+BOOST_AUTO_TEST_SUITE(wasm_decode_bench)
+
+/// every .wasm file of the corpus directory, in name order
+BOOST_AUTO_TEST_CASE( corpus ) { try {
+   vector<fc::path> files;
+   for( fc::directory_iterator it( fc::path( options.corpus ) ), end; it != end; ++it )
+      if( fc::is_regular_file( *it ) && it->extension() == ".wasm" )
+         files.emplace_back( *it );
+   std::sort( files.begin(), files.end() );
+   BOOST_REQUIRE( !files.empty() );
+
+   for( const auto& f : files ) {
+      string contents;
+      fc::read_file_contents( f, contents );
+      run( f.filename().generic_string(), vector<uint8_t>( contents.begin(), contents.end() ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+/// real contracts, which the corpus has few of
+BOOST_AUTO_TEST_CASE( contracts ) { try {
+   BOOST_REQUIRE( run( "eosio.token", wast_to_wasm( eosio_token_wast ) ).valid );
+   BOOST_REQUIRE( run( "eosio.system", wast_to_wasm( eosio_system_wast ) ).valid );
+   BOOST_REQUIRE( run( "eosio.msig", wast_to_wasm( eosio_msig_wast ) ).valid );
+   BOOST_REQUIRE( run( "test_api", wast_to_wasm( test_api_wast ) ).valid );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,8 @@
 
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/block_log_archive.hpp>
 
 using namespace eosio;
 using namespace testing;
@@ -50,6 +52,281 @@ BOOST_AUTO_TEST_CASE(block_with_invalid_tx_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(block_with_invalid_tx_undo_test)
+{
+   tester main;
+
+   // a block whose first transaction is valid and whose last one is not
+   main.create_account(N(first));
+   main.create_account(N(second));
+   auto b = main.produce_block();
+   BOOST_REQUIRE_EQUAL( b->transactions.size(), 2 );
+
+   auto copy_b = std::make_shared<signed_block>(*b);
+   auto signed_tx = copy_b->transactions.back().trx.get<packed_transaction>().get_signed_transaction();
+   auto& act = signed_tx.actions.back();
+   auto act_data = act.data_as<newaccount>();
+   act_data.name = act_data.creator;
+   act.data = fc::raw::pack(act_data);
+   signed_tx.signatures.clear();
+   signed_tx.sign(main.get_private_key(config::system_account_name, "active"), main.control->get_chain_id());
+   copy_b->transactions.back().trx = packed_transaction(signed_tx);
+
+   auto header_bmroot = digest_type::hash( std::make_pair( copy_b->digest(), main.control->head_block_state()->blockroot_merkle.get_root() ) );
+   auto sig_digest = digest_type::hash( std::make_pair(header_bmroot, main.control->head_block_state()->pending_schedule_hash) );
+   copy_b->producer_signature = main.get_private_key(config::system_account_name, "active").sign(sig_digest);
+
+   tester validator;
+   validator.control->abort_block();
+   BOOST_REQUIRE_EXCEPTION( validator.control->push_block( copy_b ), fc::exception,
+   [] (const fc::exception &e)->bool {
+      return e.code() == account_name_exists_exception::code_value;
+   });
+
+   // the valid transaction ran without an undo session of its own, the block's session must have removed its account
+   BOOST_REQUIRE( validator.control->db().find<account_object, by_name>( N(first) ) == nullptr );
+
+   validator.control->push_block( b );
+   BOOST_REQUIRE_EQUAL( validator.control->head_block_id(), main.control->head_block_id() );
+   validator.control->get_account( N(first) );
+   validator.control->get_account( N(second) );
+}
+
+BOOST_FIXTURE_TEST_CASE(dry_run_transaction_test, tester) { try {
+   produce_block();
+
+   signed_transaction trx;
+   account_name a = N(newco);
+   account_name creator = config::system_account_name;
+   trx.actions.emplace_back( vector<permission_level>{{creator,config::active_name}},
+                             newaccount{
+                                .creator  = creator,
+                                .name     = a,
+                                .owner    = authority( get_public_key( a, "owner" ) ),
+                                .active   = authority( get_public_key( a, "active" ) )
+                             });
+   set_transaction_headers(trx);
+   trx.sign( get_private_key( creator, "active" ), control->get_chain_id() );
+
+   auto pending_trxs = control->pending_block_state()->trxs.size();
+   auto trace = control->dry_run_transaction( std::make_shared<transaction_metadata>(packed_transaction(trx)), fc::time_point::maximum() );
+   BOOST_REQUIRE( !trace->except );
+   BOOST_REQUIRE( trace->receipt );
+   BOOST_TEST( trace->receipt->cpu_usage_us > 0u );
+   BOOST_TEST( trace->net_usage > 0u );
+
+   // nothing of it is kept, so the very same transaction can still be pushed
+   BOOST_TEST( control->db().find<account_object,by_name>( a ) == nullptr );
+   BOOST_TEST( control->pending_block_state()->trxs.size() == pending_trxs );
+   push_transaction( trx );
+   BOOST_TEST( control->db().find<account_object,by_name>( a ) != nullptr );
+
+   // a failing transaction is reported in the trace rather than thrown
+   trace = control->dry_run_transaction( std::make_shared<transaction_metadata>(packed_transaction(trx)), fc::time_point::maximum() );
+   BOOST_TEST( bool(trace->except) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(prevalidated_blocks_test)
+{
+   tester main;
+
+   vector<signed_block_ptr> blocks;
+   main.create_account(N(alice));
+   blocks.push_back( main.produce_block() );
+   main.create_account(N(bob));
+   main.create_account(N(carol));
+   blocks.push_back( main.produce_block() );
+   blocks.push_back( main.produce_block() );
+
+   // all blocks are handed over for preparation before the first one is pushed, as when they arrive in a burst
+   tester validator;
+   validator.control->abort_block();
+   for( const auto& b : blocks )
+      validator.control->prevalidate_block( b );
+   for( const auto& b : blocks )
+      validator.control->push_block( b );
+
+   BOOST_REQUIRE_EQUAL( validator.control->head_block_id(), main.control->head_block_id() );
+   validator.control->get_account( N(carol) );
+
+   // a block already applied is ignored
+   validator.control->prevalidate_block( blocks.front() );
+}
+
+BOOST_AUTO_TEST_CASE(speculative_transactions_reused_test) try {
+   tester main;
+   tester validator;
+
+   // the validator executes the transaction speculatively before it receives the block with it
+   auto speculate = [&]( bool prevalidate ) {
+      auto pt = main.control->pending_block_state()->trxs.back()->packed_trx;
+      validator.push_transaction( pt );
+      auto speculative = validator.control->pending_block_state()->trxs.back();
+      auto b = main.produce_block();
+      if( prevalidate )
+         validator.control->prevalidate_block( b );
+      validator.push_block( b );
+
+      BOOST_REQUIRE_EQUAL( validator.control->head_block_id(), main.control->head_block_id() );
+      const auto& applied = validator.control->head_block_state()->trxs;
+      BOOST_TEST( ( std::find( applied.begin(), applied.end(), speculative ) != applied.end() ) );
+      BOOST_TEST( validator.control->get_unapplied_transactions().empty() );
+   };
+
+   main.create_account( N(alice) );
+   speculate( false );
+   main.create_account( N(bob) );
+   speculate( true );
+   validator.control->get_account( N(bob) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(block_log_read_test)
+{
+   tester main;
+   main.produce_blocks(20);
+
+   auto lib = main.control->last_irreversible_block_num();
+   BOOST_REQUIRE( lib > 2 );
+
+   // blocks below the last irreversible one are only in the block log
+   for( uint32_t n = 2; n < lib; ++n ) {
+      auto b = main.control->fetch_block_by_number( n );
+      BOOST_REQUIRE( b );
+      BOOST_REQUIRE_EQUAL( b->block_num(), n );
+      BOOST_CHECK_EQUAL( b->id(), main.control->get_block_id_for_num( n ) );
+   }
+
+   // blocks appended after the log was mapped are still found
+   main.produce_blocks(10);
+   auto new_lib = main.control->last_irreversible_block_num();
+   BOOST_REQUIRE( new_lib > lib );
+   auto b = main.control->fetch_block_by_number( new_lib - 1 );
+   BOOST_REQUIRE( b );
+   BOOST_CHECK_EQUAL( b->id(), main.control->get_block_id_for_num( new_lib - 1 ) );
+
+   // and repeated reads are served from the cache
+   BOOST_CHECK( main.control->fetch_block_by_number( lib - 1 ) == main.control->fetch_block_by_number( lib - 1 ) );
+}
+
+BOOST_AUTO_TEST_CASE(block_log_index_reconstruction_test)
+{
+   tester main;
+   main.create_account(N(alice));
+   main.produce_blocks(30);
+   main.close();
+
+   const auto blocks_dir = main.get_config().blocks_dir;
+   vector<uint64_t> positions;
+   {
+      block_log log( blocks_dir );
+      for( uint32_t n = 1; n <= log.head()->block_num(); ++n )
+         positions.push_back( log.get_block_pos( n ) );
+   }
+
+   fc::remove( blocks_dir / "blocks.index" );
+   block_log log( blocks_dir );
+   BOOST_REQUIRE_EQUAL( log.head()->block_num(), positions.size() );
+   for( uint32_t n = 1; n <= positions.size(); ++n ) {
+      BOOST_CHECK_EQUAL( log.get_block_pos( n ), positions[n - 1] );
+      BOOST_CHECK_EQUAL( log.read_block_by_num( n )->block_num(), n );
+   }
+}
+
+BOOST_AUTO_TEST_CASE(block_log_read_id_test)
+{
+   tester main;
+   main.create_account(N(alice));
+   main.produce_blocks(30);
+   main.close();
+
+   block_log log( main.get_config().blocks_dir );
+   auto head_num = log.head()->block_num();
+   for( uint32_t n = 1; n <= head_num; ++n ) {
+      // read from the header before the whole block gets cached
+      auto id = log.read_block_id_by_num( n );
+      BOOST_CHECK_EQUAL( id, log.read_block_by_num( n )->id() );
+      BOOST_CHECK_EQUAL( id, log.read_block_id_by_num( n ) );
+   }
+   BOOST_CHECK( log.read_block_id_by_num( head_num + 1 ) == block_id_type() );
+}
+
+BOOST_AUTO_TEST_CASE(block_log_archive_test)
+{
+   tester main;
+   main.create_account(N(alice));
+   main.produce_blocks(30);
+   main.close();
+
+   fc::temp_directory archive_dir;
+   block_log_archive::options opts;
+   opts.blocks_per_chunk = 4;
+   opts.blocks_per_segment = 10;
+   block_log_archive::create( main.get_config().blocks_dir, archive_dir.path(), opts );
+
+   block_log log( main.get_config().blocks_dir );
+   const uint32_t head_num = log.head()->block_num();
+   {
+      block_log_archive archive( archive_dir.path() );
+      BOOST_REQUIRE_EQUAL( archive.first_block_num(), 1 );
+      BOOST_REQUIRE_EQUAL( archive.last_block_num(), head_num );
+      BOOST_REQUIRE( archive.is_contiguous() );
+      for( uint32_t n = head_num; n >= 1; --n )
+         BOOST_CHECK_EQUAL( archive.read_block_by_num( n )->id(), log.read_block_by_num( n )->id() );
+      BOOST_CHECK( !archive.read_block_by_num( head_num + 1 ) );
+   }
+
+   // turning the archive back into a block log gives the same blocks
+   fc::temp_directory blocks_dir;
+   block_log_archive::extract( archive_dir.path(), blocks_dir.path() );
+   block_log extracted( blocks_dir.path() );
+   BOOST_REQUIRE_EQUAL( extracted.head()->block_num(), head_num );
+   for( uint32_t n = 1; n <= head_num; ++n )
+      BOOST_CHECK_EQUAL( extracted.read_block_by_num( n )->id(), log.read_block_by_num( n )->id() );
+}
+
+BOOST_AUTO_TEST_CASE(block_log_split_merge_trim_test)
+{
+   tester main;
+   main.create_account(N(alice));
+   main.produce_blocks(30);
+   main.close();
+
+   const auto blocks_dir = main.get_config().blocks_dir;
+   vector<block_id_type> ids;
+   {
+      block_log log( blocks_dir );
+      for( uint32_t n = 1; n <= log.head()->block_num(); ++n )
+         ids.push_back( log.read_block_by_num( n )->id() );
+   }
+   const uint32_t head_num = ids.size();
+   BOOST_REQUIRE( head_num > 20 );
+
+   auto check = [&]( const fc::path& dir, uint32_t first, uint32_t last ) {
+      block_log log( dir );
+      BOOST_REQUIRE_EQUAL( log.first_block_num(), first );
+      BOOST_REQUIRE_EQUAL( log.head()->block_num(), last );
+      for( uint32_t n = first; n <= last; ++n )
+         BOOST_CHECK_EQUAL( log.read_block_by_num( n )->id(), ids[n - 1] );
+   };
+
+   fc::temp_directory parts;
+   block_log::extract_blocks( blocks_dir, parts.path() / "a", 1, 10 );
+   block_log::extract_blocks( blocks_dir, parts.path() / "b", 11, head_num );
+   check( parts.path() / "a", 1, 10 );
+   check( parts.path() / "b", 11, head_num );
+
+   // the parts only merge in order
+   BOOST_CHECK_THROW( block_log::merge_logs( { parts.path() / "b", parts.path() / "a" }, parts.path() / "bad" ), block_log_exception );
+   block_log::merge_logs( { parts.path() / "a", parts.path() / "b" }, parts.path() / "merged" );
+   check( parts.path() / "merged", 1, head_num );
+   BOOST_CHECK_EQUAL( block_log::checksum( parts.path() / "merged" ), block_log::checksum( blocks_dir ) );
+
+   block_log::trim_front( parts.path() / "merged", 5 );
+   check( parts.path() / "merged", 5, head_num );
+   block_log::trim_end( parts.path() / "merged", 20 );
+   check( parts.path() / "merged", 5, 20 );
+}
+
 std::pair<signed_block_ptr, signed_block_ptr> corrupt_trx_in_block(validating_tester& main, account_name act_name) {
    // First we create a valid block with valid transaction
    main.create_account(act_name);
@@ -83,6 +83,51 @@ BOOST_FIXTURE_TEST_CASE( delay_error_create_account, validating_tester) { try {
 } FC_LOG_AND_RETHROW() }
 
 
+BOOST_FIXTURE_TEST_CASE( scheduled_transactions_batches, validating_tester) { try {
+
+   produce_blocks(2);
+
+   account_name creator = config::system_account_name;
+   for( auto a : {N(newcoa), N(newcob), N(newcoc)} ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{creator,config::active_name}},
+                                newaccount{
+                                   .creator  = creator,
+                                   .name     = a,
+                                   .owner    = authority( get_public_key( a, "owner" ) ),
+                                   .active   = authority( get_public_key( a, "active" ) )
+                                });
+      set_transaction_headers(trx);
+      trx.delay_sec = 3;
+      trx.sign( get_private_key( creator, "active" ), control->get_chain_id()  );
+      push_transaction( trx );
+   }
+
+   produce_blocks(6);
+
+   auto all = control->get_scheduled_transactions();
+   BOOST_REQUIRE_EQUAL(all.size(), 3);
+
+   controller::scheduled_transactions_cursor cursor;
+   auto first_two = control->get_scheduled_transactions(2, cursor, nullptr);
+   BOOST_REQUIRE_EQUAL(first_two.size(), 2);
+   BOOST_CHECK(first_two[0] == all[0]);
+   BOOST_CHECK(first_two[1] == all[1]);
+
+   auto last = control->get_scheduled_transactions(2, cursor, nullptr);
+   BOOST_REQUIRE_EQUAL(last.size(), 1);
+   BOOST_CHECK(last[0] == all[2]);
+   BOOST_CHECK(control->get_scheduled_transactions(2, cursor, nullptr).empty());
+
+   controller::scheduled_transactions_cursor from_start;
+   auto rest = control->get_scheduled_transactions(10, from_start, [&](const transaction_id_type& id) { return id == all[0]; });
+   BOOST_REQUIRE_EQUAL(rest.size(), 2);
+   BOOST_CHECK(rest[0] == all[1]);
+   BOOST_CHECK(rest[1] == all[2]);
+
+} FC_LOG_AND_RETHROW() }
+
+
 asset get_currency_balance(const TESTER& chain, account_name account) {
    return chain.get_currency_balance(N(eosio.token), symbol(SY(4,CUR)), account);
 }
@@ -192,6 +237,17 @@ BOOST_AUTO_TEST_CASE( link_delay_direct_test ) { try {
    BOOST_REQUIRE_EQUAL(1, gen_size);
    BOOST_REQUIRE_EQUAL(0, trace->action_traces.size());
 
+   // the packed transaction lives in a payload object of its own
+   {
+      const auto& db = chain.control->db();
+      BOOST_REQUIRE_EQUAL(1, db.get_index<generated_transaction_payload_index>().size());
+      const auto& gto = *db.get_index<generated_transaction_multi_index,by_trx_id>().begin();
+      const auto& packed_trx = gto.packed_trx(db);
+      BOOST_REQUIRE_EQUAL(gto.packed_trx_size, packed_trx.size());
+      auto trx = fc::raw::unpack<transaction>(packed_trx.data(), packed_trx.size());
+      BOOST_REQUIRE_EQUAL(gto.trx_id, trx.id());
+   }
+
    liquid_balance = get_currency_balance(chain, N(tester));
    BOOST_REQUIRE_EQUAL(asset::from_string("99.0000 CUR"), liquid_balance);
    liquid_balance = get_currency_balance(chain, N(tester2));
@@ -224,6 +280,7 @@ BOOST_AUTO_TEST_CASE( link_delay_direct_test ) { try {
    BOOST_REQUIRE_EQUAL(asset::from_string("96.0000 CUR"), liquid_balance);
    liquid_balance = get_currency_balance(chain, N(tester2));
    BOOST_REQUIRE_EQUAL(asset::from_string("4.0000 CUR"), liquid_balance);
+   BOOST_REQUIRE_EQUAL(0, chain.control->db().get_index<generated_transaction_payload_index>().size());
 
 } FC_LOG_AND_RETHROW() }/// schedule_test
 
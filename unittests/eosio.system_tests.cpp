@@ -113,6 +113,43 @@ BOOST_FIXTURE_TEST_CASE( buysell, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( buysell_integer_bancor, eosio_system_tester ) try {
+
+   BOOST_REQUIRE_EQUAL( error("missing authority of eosio"),
+                        push_action( N(alice1111111), N(setrammath), mvo()("integer_bancor", true) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, N(setrammath), mvo()("integer_bancor", true) ) );
+
+   transfer( "eosio", "alice1111111", core_from_string("1000.0000"), "eosio" );
+   auto init_bytes = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64();
+
+   auto market = get_rammarket();
+   const int64_t ram    = market["base"]["balance"].as<asset>().get_amount();
+   const int64_t core   = market["quote"]["balance"].as<asset>().get_amount();
+   const asset   supply = market["supply"].as<asset>();
+
+   // 200.0000 less the 0.5% fee buy 199.0000 worth of the constant product, rounded down
+   BOOST_REQUIRE_EQUAL( success(), buyram( "alice1111111", "alice1111111", core_from_string("200.0000") ) );
+   const int64_t paid = core_from_string("199.0000").get_amount();
+   const int64_t expected_bytes = int64_t( (unsigned __int128)paid * uint64_t(ram) / (uint64_t(core) + paid) );
+   auto bought_bytes = get_total_stake( "alice1111111" )["ram_bytes"].as_uint64() - init_bytes;
+   BOOST_REQUIRE_EQUAL( expected_bytes, int64_t(bought_bytes) );
+
+   market = get_rammarket();
+   BOOST_REQUIRE_EQUAL( ram - expected_bytes, market["base"]["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( core + paid, market["quote"]["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( supply, market["supply"].as<asset>() );
+
+   // selling them back returns at most what they were bought for
+   BOOST_REQUIRE_EQUAL( success(), sellram( "alice1111111", bought_bytes ) );
+   BOOST_REQUIRE_EQUAL( init_bytes, get_total_stake( "alice1111111" )["ram_bytes"].as_uint64() );
+   const int64_t returned = int64_t( (unsigned __int128)bought_bytes * uint64_t(core + paid) / (uint64_t(ram - expected_bytes) + bought_bytes) );
+   BOOST_TEST( returned <= paid );
+   market = get_rammarket();
+   BOOST_REQUIRE_EQUAL( ram, market["base"]["balance"].as<asset>().get_amount() );
+   BOOST_REQUIRE_EQUAL( core + paid - returned, market["quote"]["balance"].as<asset>().get_amount() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( stake_unstake, eosio_system_tester ) try {
    cross_15_percent_threshold();
 
@@ -972,6 +1009,82 @@ BOOST_FIXTURE_TEST_CASE( producer_keep_votes, eosio_system_tester, * boost::unit
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_FIXTURE_TEST_CASE( inactive_producer_keeps_vote_changes, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
+   for( auto p : { N(alice1111111), N(bob111111111) } ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( p, N(regproducer), mvo()
+                                                  ("producer",  name(p).to_string())
+                                                  ("producer_key", get_public_key( p, "active") )
+                                                  ("url", "")
+                                                  ("location", 0)
+                           )
+      );
+   }
+
+   issue( "carol1111111", core_from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", core_from_string("10.0000"), core_from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(carol1111111), { N(alice1111111), N(bob111111111) } ) );
+
+   //alice1111111 unregisters, so she drops out of the ranking
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice1111111), N(unregprod), mvo()("producer",  "alice1111111") ) );
+
+   //staking more still moves the votes of the inactive producer
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", core_from_string("5.0000"), core_from_string("0.0000") ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("25.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("25.0000")) == get_producer_info( "bob111111111" )["total_votes"].as_double() );
+
+   //dropping the inactive producer leaves the votes of the one kept unchanged
+   BOOST_REQUIRE_EQUAL( success(), vote( N(carol1111111), { N(bob111111111) } ) );
+   BOOST_TEST_REQUIRE( 0 == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("25.0000")) == get_producer_info( "bob111111111" )["total_votes"].as_double() );
+
+   //registering again ranks her by her votes, which can be cast for her again
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice1111111), N(regproducer), mvo()
+                                               ("producer",  "alice1111111")
+                                               ("producer_key", get_public_key( N(alice1111111), "active") )
+                                               ("url", "")
+                                               ("location", 0)
+                        )
+   );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(carol1111111), { N(alice1111111), N(bob111111111) } ) );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("25.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("25.0000")) == get_producer_info( "bob111111111" )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
+
+BOOST_FIXTURE_TEST_CASE( vote_weight_cached_per_week, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
+   BOOST_REQUIRE_EQUAL( success(), push_action( N(alice1111111), N(regproducer), mvo()
+                                               ("producer",  "alice1111111")
+                                               ("producer_key", get_public_key( N(alice1111111), "active") )
+                                               ("url", "")
+                                               ("location", 0)
+                        )
+   );
+   issue( "carol1111111", core_from_string("1000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), stake( "carol1111111", core_from_string("10.0000"), core_from_string("10.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(carol1111111), { N(alice1111111) } ) );
+
+   auto week_of = [&]() {
+      auto now = control->pending_block_time().time_since_epoch().count() / 1000000;
+      return int64_t((now - (config::block_timestamp_epoch / 1000)) / (86400 * 7));
+   };
+   auto cached = get_vote_weight_state();
+   const int64_t first_week = week_of();
+   BOOST_REQUIRE_EQUAL( first_week, cached["week"].as_int64() );
+   BOOST_TEST_REQUIRE( pow(2, first_week / double(52)) == cached["multiplier"].as_double() );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("20.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+
+   //a week later the first vote computes the multiplier of the new week
+   produce_block( fc::days(7) );
+   BOOST_REQUIRE_EQUAL( success(), vote( N(carol1111111), { N(alice1111111) } ) );
+   cached = get_vote_weight_state();
+   BOOST_REQUIRE_EQUAL( week_of(), cached["week"].as_int64() );
+   BOOST_REQUIRE( first_week < cached["week"].as_int64() );
+   BOOST_TEST_REQUIRE( stake2votes(core_from_string("20.0000")) == get_producer_info( "alice1111111" )["total_votes"].as_double() );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_FIXTURE_TEST_CASE( vote_for_two_producers, eosio_system_tester, * boost::unit_test::tolerance(1e+5) ) try {
    //alice1111111 becomes a producer
    fc::variant params = producer_parameters_example(1);
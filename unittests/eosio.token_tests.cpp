@@ -94,6 +94,17 @@ public:
       );
    }
 
+   action_result transfers( account_name from, const vector<variant>& payouts ) {
+      return push_action( from, N(transfers), mvo()
+           ( "from", from)
+           ( "payouts", payouts)
+      );
+   }
+
+   static variant payout( account_name to, const string& quantity, const string& memo = "" ) {
+      return mvo()( "to", to)( "quantity", asset::from_string(quantity))( "memo", memo);
+   }
+
    abi_serializer abi_ser;
 };
 
@@ -265,4 +276,87 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( transfers_tests, eosio_token_tester ) try {
+
+   create( N(alice), asset::from_string("1000 CERO"));
+   create( N(alice), asset::from_string("1000.00 DOS"));
+   produce_blocks(1);
+
+   issue( N(alice), N(alice), asset::from_string("1000 CERO"), "hola" );
+   issue( N(alice), N(alice), asset::from_string("100.00 DOS"), "hola" );
+
+   BOOST_REQUIRE_EQUAL( success(),
+      transfers( N(alice), { payout( N(bob), "300 CERO", "first" ), payout( N(carol), "200 CERO" ),
+                             payout( N(bob), "50 CERO" ), payout( N(carol), "10.50 DOS" ) } )
+   );
+
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "0,CERO"), mvo()("balance", "450 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()("balance", "350 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "0,CERO"), mvo()("balance", "200 CERO") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(alice), "2,DOS"), mvo()("balance", "89.50 DOS") );
+   REQUIRE_MATCHING_OBJECT( get_account(N(carol), "2,DOS"), mvo()("balance", "10.50 DOS") );
+
+   // the payouts are checked against the balance together, and none of them is made if it is overdrawn
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      transfers( N(alice), { payout( N(bob), "300 CERO" ), payout( N(carol), "151 CERO" ) } )
+   );
+   REQUIRE_MATCHING_OBJECT( get_account(N(bob), "0,CERO"), mvo()("balance", "350 CERO") );
+
+   // paying out the whole balance removes it, as a transfer does
+   BOOST_REQUIRE_EQUAL( success(),
+      transfers( N(alice), { payout( N(bob), "80.00 DOS" ), payout( N(carol), "9.50 DOS" ) } )
+   );
+   BOOST_REQUIRE( get_account(N(alice), "2,DOS").is_null() );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no payouts" ), transfers( N(alice), {} ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+      transfers( N(alice), { payout( N(bob), "1 CERO" ), payout( N(alice), "1 CERO" ) } )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must transfer positive quantity" ),
+      transfers( N(alice), { payout( N(bob), "-1 CERO" ) } )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+      transfers( N(alice), { payout( N(bob), "1 CERO" ), payout( N(bob), "1.0 CERO" ) } )
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( state_deltas, eosio_token_tester ) try {
+
+   create( N(alice), asset::from_string("1000.000 TKN") );
+   issue( N(alice), N(alice), asset::from_string("100.000 TKN"), "" );
+   produce_blocks(1);
+
+   vector<block_state_deltas_ptr> deltas;
+   auto c = control->accepted_block_state_deltas.connect( [&]( const block_state_deltas_ptr& d ) { deltas.push_back( d ); } );
+   produce_blocks(1); // the rows of the block pending when connecting are not tracked
+   BOOST_REQUIRE( deltas.empty() );
+
+   transfer( N(alice), N(bob), asset::from_string("10.000 TKN"), "" );
+   produce_blocks(1);
+   c.disconnect();
+
+   BOOST_REQUIRE_EQUAL( deltas.size(), 1u );
+   BOOST_REQUIRE_EQUAL( deltas[0]->block_num, control->head_block_num() );
+   BOOST_REQUIRE_EQUAL( deltas[0]->block_id, control->head_block_id() );
+
+   vector<table_row_delta> rows;
+   for( const auto& r : deltas[0]->rows )
+      if( r.code == N(eosio.token) )
+         rows.push_back( r );
+   BOOST_REQUIRE_EQUAL( rows.size(), 2u );
+   for( const auto& r : rows ) {
+      BOOST_REQUIRE_EQUAL( r.table, N(accounts) );
+      BOOST_REQUIRE( r.present );
+      BOOST_REQUIRE( r.value == get_row_by_account( N(eosio.token), r.scope, N(accounts), account_name(r.primary_key) ) );
+   }
+   BOOST_REQUIRE_EQUAL( rows[0].scope, N(alice) );
+   BOOST_REQUIRE_EQUAL( rows[1].scope, N(bob) );
+
+   for( const auto& t : deltas[0]->tables )
+      if( t.code == N(eosio.token) )
+         BOOST_REQUIRE( t.present && t.count == 1 );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -37,8 +37,14 @@ namespace eosio_system {
 class eosio_system_tester : public TESTER {
 public:
 
+   /// restores the chain the setup below makes, which runs once per test process
    eosio_system_tester()
-   : eosio_system_tester([](TESTER& ) {}){}
+   : TESTER( get_fixture_snapshot( "eosio_system_tester", []() {
+        return std::unique_ptr<base_tester>( new eosio_system_tester( [](TESTER& ) {} ) );
+     } ) ) {
+      token_abi_ser.set_abi( get_abi( N(eosio.token) ), abi_serializer_max_time );
+      abi_ser.set_abi( get_abi( config::system_account_name ), abi_serializer_max_time );
+   }
 
    template<typename Lambda>
    eosio_system_tester(Lambda setup) {
@@ -86,6 +92,13 @@ public:
    }
 
 
+   abi_def get_abi( account_name account ) {
+      const auto& accnt = control->db().get<account_object,by_name>( account );
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      return abi;
+   }
+
    void create_accounts_with_resources( vector<account_name> accounts, account_name creator = config::system_account_name ) {
       for( auto a : accounts ) {
          create_account_with_resources( a, creator );
@@ -392,6 +405,17 @@ public:
       return get_stats("4," CORE_SYMBOL_NAME)["supply"].as<asset>();
    }
 
+   fc::variant get_vote_weight_state() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(voteweight), N(voteweight) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "vote_weight_state", data, abi_serializer_max_time );
+   }
+
+   fc::variant get_rammarket() {
+      const uint64_t ramcore = symbol(4, "RAMCORE").value();
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(rammarket), ramcore );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "exchange_state", data, abi_serializer_max_time );
+   }
+
    fc::variant get_global_state() {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, N(global), N(global) );
       if (data.empty()) std::cout << "\nData is empty\n" << std::endl;
@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/block_log.hpp>
 #include <eosio/chain/fork_database.hpp>
 
 #include <eosio.token/eosio.token.wast.hpp>
@@ -438,6 +439,67 @@ BOOST_AUTO_TEST_CASE(confirmation) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( fork_db_journal_restart ) try {
+   tester c;
+   c.produce_blocks(10);
+   c.create_accounts( {N(dan),N(sam),N(pam),N(scott)} );
+   c.set_producers( {N(dan),N(sam),N(pam),N(scott)} );
+   c.produce_blocks(50);
+
+   auto head_id = c.control->head_block_id();
+   auto lib = c.control->last_irreversible_block_num();
+   BOOST_REQUIRE( c.control->head_block_num() > lib + 1 );
+   vector<block_id_type> reversible;
+   for( uint32_t n = lib + 1; n <= c.control->head_block_num(); ++n )
+      reversible.push_back( c.control->get_block_id_for_num( n ) );
+
+   c.close();
+   // the fork database is journaled as it changes, nothing is written out on shutdown
+   BOOST_CHECK( !fc::exists( c.get_config().state_dir / config::forkdb_filename ) );
+   c.open( nullptr );
+
+   BOOST_CHECK_EQUAL( c.control->head_block_id(), head_id );
+   for( const auto& id : reversible ) {
+      auto b = c.control->fork_db().get_block( id );
+      BOOST_REQUIRE( b );
+      BOOST_CHECK( b->validated );
+      BOOST_CHECK( b->in_current_chain );
+   }
+   auto head_num = c.control->head_block_num();
+   c.produce_blocks(2);
+   BOOST_CHECK_EQUAL( c.control->head_block_num(), head_num + 2 );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( trusted_replay ) try {
+   tester c;
+   c.produce_blocks(10);
+   c.create_accounts( {N(dan),N(sam),N(pam),N(scott)} );
+   c.set_producers( {N(dan),N(sam),N(pam),N(scott)} );
+   c.produce_blocks(100);
+
+   auto head_id = c.control->head_block_id();
+   auto cfg = c.get_config();
+   c.close();
+
+   // a block log that does not match the checksum is refused before anything is replayed
+   cfg.trusted_replay_checksum = fc::sha256::hash( string("not the block log") );
+   fc::remove_all( cfg.state_dir );
+   BOOST_REQUIRE_THROW( tester{cfg}, block_log_exception );
+
+   cfg.trusted_replay_checksum = block_log::checksum( cfg.blocks_dir );
+   fc::remove_all( cfg.state_dir );
+   tester replayed( cfg );
+   BOOST_CHECK_EQUAL( replayed.control->head_block_id(), head_id );
+
+   // the journal paused during the replay is written again, so a restart finds the same head
+   replayed.close();
+   replayed.open( nullptr );
+   BOOST_CHECK_EQUAL( replayed.control->head_block_id(), head_id );
+   replayed.produce_blocks(2);
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_CASE( read_modes ) try {
    tester c;
    c.produce_block();
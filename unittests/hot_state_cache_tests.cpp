@@ -0,0 +1,118 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/hot_state_cache.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+namespace {
+   /// rows of two tables, made in a session that is undone with it
+   struct rows_fixture {
+      tester                     test;
+      database&                  db = const_cast<database&>( test.control->db() );
+      database::session          session = db.start_undo_session( true );
+      table_id                   tables[2];
+      vector<const key_value_object*> rows;
+
+      explicit rows_fixture( uint32_t rows_per_table ) {
+         for( uint32_t t = 0; t < 2; ++t ) {
+            tables[t] = db.create<table_id_object>( [&]( auto& o ) {
+               o.code  = N(hot);
+               o.scope = N(hot);
+               o.table = name( t );
+            } ).id;
+            for( uint32_t k = 0; k < rows_per_table; ++k ) {
+               rows.push_back( &db.create<key_value_object>( [&]( auto& o ) {
+                  o.t_id        = tables[t];
+                  o.primary_key = k;
+               } ) );
+            }
+         }
+      }
+   };
+}
+
+BOOST_AUTO_TEST_SUITE(hot_state_cache_tests)
+
+BOOST_AUTO_TEST_CASE(finds_what_was_added) try {
+   rows_fixture f( 100 );
+   hot_state_cache c( 1000 );
+   for( const auto* r : f.rows )
+      c.add( *r );
+   BOOST_REQUIRE_EQUAL( c.size(), f.rows.size() );
+   for( const auto* r : f.rows )
+      BOOST_REQUIRE( c.find( r->t_id, r->primary_key ) == r );
+   BOOST_TEST( c.find( f.tables[0], 100 ) == nullptr );
+
+   // adding a row again keeps one entry
+   c.add( *f.rows.front() );
+   BOOST_TEST( c.size() == f.rows.size() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(remove_keeps_the_others_reachable) try {
+   rows_fixture f( 300 );
+   // small enough that many rows probe past their home slot
+   hot_state_cache c( 600 );
+   for( const auto* r : f.rows )
+      c.add( *r );
+   for( size_t i = 0; i < f.rows.size(); i += 3 )
+      c.remove( *f.rows[i] );
+   for( size_t i = 0; i < f.rows.size(); ++i ) {
+      const auto* r = f.rows[i];
+      BOOST_REQUIRE( c.find( r->t_id, r->primary_key ) == ( i % 3 ? r : nullptr ) );
+   }
+   BOOST_TEST( c.size() == f.rows.size() - f.rows.size() / 3 );
+
+   // a row that is not cached is ignored
+   c.remove( *f.rows[0] );
+   BOOST_TEST( c.size() == f.rows.size() - f.rows.size() / 3 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(starts_over_when_full) try {
+   rows_fixture f( 10 );
+   hot_state_cache c( 15 );
+   for( size_t i = 0; i < 15; ++i )
+      c.add( *f.rows[i] );
+   BOOST_REQUIRE_EQUAL( c.size(), 15u );
+   c.add( *f.rows[15] );
+   BOOST_TEST( c.size() == 1u );
+   BOOST_TEST( c.find( f.rows[0]->t_id, f.rows[0]->primary_key ) == nullptr );
+   BOOST_TEST( c.find( f.rows[15]->t_id, f.rows[15]->primary_key ) == f.rows[15] );
+
+   c.clear();
+   BOOST_TEST( c.size() == 0u );
+   BOOST_TEST( c.find( f.rows[15]->t_id, f.rows[15]->primary_key ) == nullptr );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(disabled) try {
+   rows_fixture f( 1 );
+   hot_state_cache c;
+   BOOST_TEST( !c.enabled() );
+   c.add( *f.rows[0] );
+   BOOST_TEST( c.size() == 0u );
+   BOOST_TEST( c.find( f.rows[0]->t_id, f.rows[0]->primary_key ) == nullptr );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(cleared_when_a_block_is_aborted) try {
+   tester test;
+   auto& c = test.control->get_mutable_hot_state_cache();
+   BOOST_REQUIRE( c.enabled() );
+   test.create_accounts( { N(alice) } );
+   test.produce_block();
+
+   // the tester keeps a pending block open, whose session undoes what was cached in it
+   auto& db = const_cast<database&>( test.control->db() );
+   const auto& tab = db.create<table_id_object>( [&]( auto& o ) { o.code = N(alice); o.scope = N(alice); } );
+   c.add( db.create<key_value_object>( [&]( auto& o ) { o.t_id = tab.id; } ) );
+   BOOST_REQUIRE_EQUAL( c.size(), 1u );
+   test.control->abort_block();
+   BOOST_TEST( c.size() == 0u );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
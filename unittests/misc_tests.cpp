@@ -7,6 +7,8 @@
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/asset.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/metrics.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <eosio/utilities/key_conversion.hpp>
@@ -14,6 +16,8 @@
 
 #include <fc/io/json.hpp>
 
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 #ifdef NON_VALIDATING_TEST
@@ -535,6 +539,57 @@ BOOST_AUTO_TEST_CASE(authority_checker)
    }
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(authority_weight_order)
+{ try {
+   testing::TESTER test;
+   vector<key_weight> keys;
+   for( const char* k : { "a", "b", "c", "d" } )
+      keys.push_back( key_weight{ test.get_public_key( k, "active" ), 1 } );
+   std::sort( keys.begin(), keys.end(), []( const auto& l, const auto& r ) { return l.key < r.key; } );
+   keys[1].weight = 2;
+   auto auth = authority( 3, keys,
+                          { permission_level_weight{{"alice", "active"}, 2}, permission_level_weight{{"bob", "active"}, 1} },
+                          { wait_weight{10, 1}, wait_weight{20, 2} } );
+   BOOST_REQUIRE( validate( auth ) );
+
+   auto& db = const_cast<chainbase::database&>( test.control->db() );
+   auto session = db.start_undo_session( true );
+   const auto& perm = db.create<permission_object>( [&]( auto& p ) { p.auth = auth; } );
+
+   // the same order as the set the checker sorts a plain authority into
+   detail::meta_permission_set sorted;
+   sorted.insert( auth.waits.begin(), auth.waits.end() );
+   sorted.insert( auth.keys.begin(), auth.keys.end() );
+   sorted.insert( auth.accounts.begin(), auth.accounts.end() );
+   BOOST_REQUIRE( perm.auth.has_weight_order() );
+   BOOST_REQUIRE_EQUAL( perm.auth.weight_order.size(), sorted.size() );
+   auto itr = sorted.begin();
+   for( uint32_t entry : perm.auth.weight_order ) {
+      const uint32_t i = entry & ((1u << shared_authority::factor_kind_shift) - 1);
+      BOOST_TEST( uint32_t(itr->which()) == (entry >> shared_authority::factor_kind_shift) );
+      switch( entry >> shared_authority::factor_kind_shift ) {
+         case shared_authority::wait_factor: BOOST_TEST( ( itr->get<wait_weight>() == perm.auth.waits[i] ) ); break;
+         case shared_authority::key_factor:  BOOST_TEST( ( itr->get<key_weight>() == perm.auth.keys[i] ) ); break;
+         default:                            BOOST_TEST( ( itr->get<permission_level_weight>() == perm.auth.accounts[i] ) ); break;
+      }
+      ++itr;
+   }
+
+   // and the same results, the keys used included
+   auto GetNullAuthority = [](auto){ return authority(); };
+   for( uint32_t subset = 0; subset < (1u << keys.size()); ++subset ) {
+      flat_set<public_key_type> provided;
+      for( uint32_t k = 0; k < keys.size(); ++k )
+         if( subset & (1u << k) ) provided.insert( keys[k].key );
+      for( auto delay : { fc::seconds(0), fc::seconds(15), fc::seconds(30) } ) {
+         auto plain = make_auth_checker( GetNullAuthority, 2, provided, {}, delay );
+         auto stored = make_auth_checker( GetNullAuthority, 2, provided, {}, delay );
+         BOOST_TEST( plain.satisfied( auth ) == stored.satisfied( perm.auth ) );
+         BOOST_TEST( plain.used_keys() == stored.used_keys() );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(alphabetic_sort)
 { try {
 
@@ -639,10 +694,79 @@ BOOST_AUTO_TEST_CASE(transaction_test) { try {
    BOOST_CHECK_EQUAL(trx.id(), pkt.id());
    BOOST_CHECK_EQUAL(trx.id(), pkt2.id());
 
+   // the ids and digests computed once have to match the ones computed from the transaction
+   auto pkt3 = fc::raw::unpack<packed_transaction>( fc::raw::pack( pkt2 ) );
+   BOOST_CHECK_EQUAL(trx.id(), pkt3.id());
+   const auto& chain_id = test.control->get_chain_id();
+   BOOST_CHECK_EQUAL(trx.sig_digest(chain_id, trx.context_free_data), pkt.sig_digest(chain_id));
+   BOOST_CHECK_EQUAL(trx.sig_digest(chain_id, trx.context_free_data), pkt3.sig_digest(chain_id));
+   BOOST_CHECK(trx.get_signature_keys(chain_id) == pkt3.get_signature_keys(chain_id));
+
    bytes raw = pkt.get_raw_transaction();
    bytes raw2 = pkt2.get_raw_transaction();
    BOOST_CHECK_EQUAL(raw.size(), raw2.size());
+   BOOST_CHECK(raw == raw2);
+
+   // the inflate state of the thread is reused, a broken stream must not leave anything behind for the next one
+   packed_transaction truncated = pkt2;
+   truncated.packed_trx.resize( truncated.packed_trx.size() / 2 );
+   BOOST_CHECK_THROW(truncated.get_raw_transaction(), tx_decompression_error);
+   BOOST_CHECK(pkt2.get_raw_transaction() == raw);
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(merkle_root_test) { try {
+   // straightforward evaluation of the tree, one packed canonical pair at a time
+   auto reference = []( vector<digest_type> ids ) {
+      if( ids.empty() ) return digest_type();
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 )
+            ids.push_back(ids.back());
+         vector<digest_type> parents;
+         for( size_t i = 0; i < ids.size(); i += 2 )
+            parents.push_back( digest_type::hash(make_canonical_pair(ids[i], ids[i+1])) );
+         ids = std::move(parents);
+      }
+      return ids.front();
+   };
+
+   vector<digest_type> ids;
+   for( uint32_t n = 0; n <= 33; ++n ) {
+      BOOST_CHECK_EQUAL( merkle(ids), reference(ids) );
+      ids.push_back( digest_type::hash(n) );
+   }
+
+   ids.resize(1000);
+   BOOST_CHECK_EQUAL( merkle(ids), reference(ids) );
+} FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(metrics_registry_test) { try {
+   auto& registry = metrics_registry::instance();
+   auto& c = registry.counter( "test_metrics_events_total", "events", {{"peer", "a\"b"}} );
+   BOOST_CHECK_EQUAL( &c, &registry.counter( "test_metrics_events_total", "events", {{"peer", "a\"b"}} ) );
+   BOOST_CHECK_THROW( registry.gauge( "test_metrics_events_total", "events" ), misc_exception );
+
+   // counted from several threads, in several shards
+   vector<std::thread> threads;
+   for( int i = 0; i < 4; ++i )
+      threads.emplace_back( [&c]() { for( int j = 0; j < 1000; ++j ) c.add(); } );
+   for( auto& t : threads ) t.join();
+   BOOST_CHECK_EQUAL( c.value(), 4000u );
+
+   auto& h = registry.histogram( "test_metrics_latency_seconds", "latency", metric_labels(), { 100, 1000 } );
+   h.observe( fc::microseconds(50) );
+   h.observe( fc::microseconds(100) );
+   h.observe( fc::microseconds(5000) );
+   BOOST_CHECK( h.counts() == vector<uint64_t>({ 2, 0, 1 }) );
+   BOOST_CHECK_EQUAL( h.sum_us(), 5150u );
+
+   auto text = registry.to_prometheus();
+   BOOST_CHECK( text.find( "# TYPE test_metrics_events_total counter\n" ) != string::npos );
+   BOOST_CHECK( text.find( "test_metrics_events_total{peer=\"a\\\"b\"} 4000\n" ) != string::npos );
+   BOOST_CHECK( text.find( "test_metrics_latency_seconds_bucket{le=\"0.001\"} 2\n" ) != string::npos );
+   BOOST_CHECK( text.find( "test_metrics_latency_seconds_bucket{le=\"+Inf\"} 3\n" ) != string::npos );
+   BOOST_CHECK( text.find( "test_metrics_latency_seconds_sum 0.00515\n" ) != string::npos );
+   BOOST_CHECK( text.find( "test_metrics_latency_seconds_count 3\n" ) != string::npos );
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_SUITE_END()
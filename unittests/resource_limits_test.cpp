@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/testing/chainbase_fixture.hpp>
 
@@ -332,4 +333,87 @@ BOOST_AUTO_TEST_SUITE(resource_limits_test)
 
    } FC_LOG_AND_RETHROW() 
 
+   /**
+    * Usage is only written back to the accounts at the end of the block, make sure what is seen in between matches
+    * billing every transaction directly, including when the session of a transaction is undone
+    */
+   BOOST_FIXTURE_TEST_CASE(pending_account_usage, resource_limits_fixture) try {
+      const account_name account(1);
+      initialize_account(account);
+      set_account_limits(account, -1, -1, 1);
+      process_account_limit_updates();
+
+      const uint32_t window = config::account_cpu_usage_average_window_ms / config::block_interval_ms;
+      auto used = [&]( const usage_accumulator& a ) {
+         return impl::downgrade_cast<int64_t>( impl::integer_divide_ceil( (uint128_t)a.value_ex * window, (uint128_t)config::rate_limiting_precision ) );
+      };
+      usage_accumulator expected;
+
+      {
+         auto block = start_session();
+         for( uint64_t i = 0; i < 10; ++i ) {
+            auto trx = start_session();
+            update_account_usage( {account}, 1 );
+            add_transaction_usage( {account}, 100 + i, 0, 1 );
+            expected.add( 100 + i, 1, window );
+            trx.squash();
+         }
+         {
+            auto trx = start_session();
+            add_transaction_usage( {account}, 1000, 0, 1 );
+            trx.undo();
+         }
+         BOOST_CHECK_EQUAL( get_account_cpu_limit_ex( account ).used, used( expected ) );
+
+         process_block_usage( 1 );
+         BOOST_CHECK_EQUAL( get_account_cpu_limit_ex( account ).used, used( expected ) );
+         block.push();
+      }
+
+      {
+         // an aborted block drops everything billed in it
+         auto block = start_session();
+         add_transaction_usage( {account}, 1000, 0, 3 );
+         block.undo();
+      }
+      BOOST_CHECK_EQUAL( get_account_cpu_limit_ex( account ).used, used( expected ) );
+
+      update_account_usage( {account}, 5 );
+      expected.add( 0, 5, window );
+      BOOST_CHECK_EQUAL( get_account_cpu_limit_ex( account ).used, used( expected ) );
+      add_transaction_usage( {account}, 50, 0, 5 );
+      expected.add( 50, 5, window );
+      process_block_usage( 5 );
+      BOOST_CHECK_EQUAL( get_account_cpu_limit_ex( account ).used, used( expected ) );
+   } FC_LOG_AND_RETHROW();
+
+   BOOST_FIXTURE_TEST_CASE(account_usage_benchmark, resource_limits_fixture) try {
+      const uint32_t blocks = 20;
+      const uint32_t transactions_per_block = 2000;
+      const vector<account_name> accounts = { N(exchange), N(alice), N(bob) };
+      for( const auto& a : accounts ) {
+         initialize_account( a );
+         set_account_limits( a, -1, -1, -1 );
+      }
+      process_account_limit_updates();
+
+      auto start = fc::time_point::now();
+      for( uint32_t b = 1; b <= blocks; ++b ) {
+         auto block = start_session();
+         for( uint32_t t = 0; t < transactions_per_block; ++t ) {
+            // most transactions come from the same hot account
+            flat_set<account_name> billed = { t % 4 ? accounts[0] : accounts[1 + t % 2] };
+            auto trx = start_session();
+            update_account_usage( billed, b );
+            add_transaction_usage( billed, 10, 100, b );
+            trx.squash();
+         }
+         process_block_usage( b );
+         block.push();
+      }
+      auto elapsed = fc::time_point::now() - start;
+      BOOST_TEST_MESSAGE( "billed " << blocks * transactions_per_block << " transactions in " << elapsed.count() / 1000 << " ms, "
+                          << elapsed.count() * 1000 / (blocks * transactions_per_block) << " ns per transaction" );
+   } FC_LOG_AND_RETHROW();
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,83 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/signal_dispatcher.hpp>
+
+#include <boost/signals2/signal.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <atomic>
+#include <thread>
+
+using namespace eosio::chain;
+
+BOOST_AUTO_TEST_SUITE(signal_dispatcher_tests)
+
+BOOST_AUTO_TEST_CASE(inline_without_threads) try {
+   signal_dispatcher d( 0, 16 );
+   BOOST_TEST( !d.running() );
+   auto s = d.make_subscriber( "test" );
+
+   boost::signals2::signal<void(const int&)> sig;
+   auto caller = std::this_thread::get_id();
+   std::vector<int> seen;
+   s->connect( sig, [&]( int v ) {
+      BOOST_TEST( ( std::this_thread::get_id() == caller ) );
+      seen.push_back( v );
+   } );
+   sig( 1 );
+   sig( 2 );
+   BOOST_TEST( ( seen == std::vector<int>({ 1, 2 }) ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(ordered_per_subscriber) try {
+   signal_dispatcher d( 4, 8 );
+   BOOST_REQUIRE( d.running() );
+
+   boost::signals2::signal<void(const int&)> first;
+   boost::signals2::signal<void(const int&)> second;
+
+   std::vector<signal_dispatcher::subscriber_ptr> subscribers;
+   std::vector<std::vector<int>> seen( 3 );
+   for( size_t i = 0; i < seen.size(); ++i ) {
+      subscribers.push_back( d.make_subscriber( "test" ) );
+      // both signals of a subscriber run in the order they are emitted
+      subscribers[i]->connect( first,  [&seen, i]( int v ) { seen[i].push_back( v ); } );
+      subscribers[i]->connect( second, [&seen, i]( int v ) { seen[i].push_back( -v ); } );
+   }
+
+   std::vector<int> expected;
+   for( int v = 1; v <= 1000; ++v ) {
+      first( v );
+      second( v );
+      expected.push_back( v );
+      expected.push_back( -v );
+   }
+   for( auto& s : subscribers )
+      s->flush();
+   for( const auto& s : seen )
+      BOOST_TEST( ( s == expected ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(throwing_handler_does_not_stop_the_others) try {
+   signal_dispatcher d( 1, 8 );
+   auto s = d.make_subscriber( "test" );
+   std::atomic<int> ran{0};
+   s->post( []() { FC_THROW( "handler failed" ); } );
+   s->post( [&]() { ++ran; } );
+   s->flush();
+   BOOST_TEST( ran == 1 );
+
+   // stopping runs what is pending, and later posts run inline
+   s->post( [&]() { ++ran; } );
+   d.stop();
+   BOOST_TEST( ran == 2 );
+   BOOST_TEST( !d.running() );
+   s->post( [&]() { ++ran; } );
+   BOOST_TEST( ran == 3 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
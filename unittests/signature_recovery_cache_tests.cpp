@@ -0,0 +1,61 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+
+#include <fc/crypto/private_key.hpp>
+
+using namespace eosio::chain;
+
+namespace {
+   private_key_type key( const std::string& seed ) {
+      return private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( seed ) );
+   }
+
+   /// restores the default capacity of the process wide cache
+   struct cache_fixture {
+      signature_recovery_cache& cache = signature_recovery_cache::instance();
+      cache_fixture()  { cache.clear(); }
+      ~cache_fixture() { cache.set_capacity( config::default_signature_recovery_cache_size ); cache.clear(); }
+   };
+}
+
+BOOST_FIXTURE_TEST_SUITE(signature_recovery_cache_tests, cache_fixture)
+
+BOOST_AUTO_TEST_CASE(recovers_once) {
+   auto k = key( "a" );
+   auto d = fc::sha256::hash( std::string( "digest" ) );
+   auto sig = k.sign( d );
+   BOOST_TEST( cache.recover( sig, d ) == k.get_public_key() );
+   BOOST_TEST( cache.size() == 1u );
+   BOOST_TEST( cache.recover( sig, d ) == k.get_public_key() );
+   BOOST_TEST( cache.size() == 1u );
+
+   // the same signature over another digest recovers another key, and is cached apart
+   auto other = fc::sha256::hash( std::string( "other" ) );
+   BOOST_TEST( cache.recover( sig, other ) != k.get_public_key() );
+   BOOST_TEST( cache.size() == 2u );
+}
+
+BOOST_AUTO_TEST_CASE(bounded) {
+   cache.set_capacity( 32 );
+   auto k = key( "b" );
+   for( uint32_t i = 0; i < 200; ++i ) {
+      auto d = fc::sha256::hash( std::to_string( i ) );
+      BOOST_REQUIRE( cache.recover( k.sign( d ), d ) == k.get_public_key() );
+   }
+   BOOST_TEST( cache.size() <= 32u );
+}
+
+BOOST_AUTO_TEST_CASE(disabled) {
+   cache.set_capacity( 0 );
+   auto k = key( "c" );
+   auto d = fc::sha256::hash( std::string( "digest" ) );
+   BOOST_TEST( cache.recover( k.sign( d ), d ) == k.get_public_key() );
+   BOOST_TEST( cache.size() == 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,9 @@
 #include <snapshot_test/snapshot_test.wast.hpp>
 #include <snapshot_test/snapshot_test.abi.hpp>
 
+#include <fc/io/fstream.hpp>
+
+#include <fstream>
 #include <sstream>
 
 using namespace eosio;
@@ -145,9 +148,52 @@ struct buffered_snapshot_suite {
 
 };
 
+struct compressed_snapshot_suite {
+   using writer_t = compressed_ostream_snapshot_writer;
+   using reader_t = compressed_istream_snapshot_reader;
+   using write_storage_t = std::ostringstream;
+   using snapshot_t = std::string;
+   using read_storage_t = std::istringstream;
+
+   struct writer : public writer_t {
+      writer( const std::shared_ptr<write_storage_t>& storage )
+      :writer_t(*storage)
+      ,storage(storage)
+      {
+
+      }
+
+      std::shared_ptr<write_storage_t> storage;
+   };
+
+   struct reader : public reader_t {
+      explicit reader(const std::shared_ptr<read_storage_t>& storage)
+      :reader_t(*storage)
+      ,storage(storage)
+      {}
+
+      std::shared_ptr<read_storage_t> storage;
+   };
+
+
+   static auto get_writer() {
+      return std::make_shared<writer>(std::make_shared<write_storage_t>());
+   }
+
+   static auto finalize(const std::shared_ptr<writer>& w) {
+      w->finalize();
+      return w->storage->str();
+   }
+
+   static auto get_reader( const snapshot_t& buffer) {
+      return std::make_shared<reader>(std::make_shared<read_storage_t>(buffer));
+   }
+
+};
+
 BOOST_AUTO_TEST_SUITE(snapshot_tests)
 
-using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite>;
+using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite, compressed_snapshot_suite>;
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_exhaustive_snapshot, SNAPSHOT_SUITE, snapshot_suites)
 {
@@ -250,4 +296,171 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_replay_over_snapshot, SNAPSHOT_SUITE, snapsho
    BOOST_REQUIRE_EQUAL(expected_post_integrity_hash.str(), snap_chain.control->calculate_integrity_hash().str());
 }
 
+BOOST_AUTO_TEST_CASE(test_parallel_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), snapshot_test_wast);
+   chain.set_abi(N(snapshot), snapshot_test_abi);
+   chain.produce_blocks(1);
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_block();
+   chain.control->abort_block();
+
+   // written and loaded with a section per thread
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = buffered_snapshot_suite::finalize(writer);
+
+   auto sequential_config = chain.get_config();
+   sequential_config.snapshot_threads = 1;
+   snapshotted_tester sequential(sequential_config, buffered_snapshot_suite::get_reader(snapshot), 1);
+   BOOST_REQUIRE_EQUAL(chain.control->calculate_integrity_hash().str(), sequential.control->calculate_integrity_hash().str());
+
+   // and the sections come out exactly as when they are written one after the other
+   sequential.control->abort_block();
+   auto sequential_writer = buffered_snapshot_suite::get_writer();
+   sequential.control->write_snapshot(sequential_writer);
+   BOOST_REQUIRE(buffered_snapshot_suite::finalize(sequential_writer) == snapshot);
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_snapshot_corruption)
+{
+   tester chain;
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto writer = compressed_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = compressed_snapshot_suite::finalize(writer);
+
+   // sections passed over are kept, so genesis can be read before the rest as chain_plugin does
+   auto reader = compressed_snapshot_suite::get_reader(snapshot);
+   reader->validate();
+   genesis_state genesis;
+   reader->read_section<genesis_state>([&]( auto& section ) {
+      section.read_row(genesis);
+   });
+   BOOST_REQUIRE_EQUAL(genesis.compute_chain_id(), chain.control->get_chain_id());
+   BOOST_REQUIRE(reader->has_section<chain_snapshot_header>());
+
+   // flipping a byte of the digest of the first section fails it
+   auto pos = snapshot.find('\0', sizeof(uint32_t) * 2) + 1;
+   uint32_t frame_size = 0;
+   do {
+      memcpy(&frame_size, snapshot.data() + pos, sizeof(frame_size));
+      pos += sizeof(frame_size) + frame_size;
+   } while (frame_size != 0);
+   snapshot[pos + sizeof(uint64_t)] ^= 0x01;
+   auto corrupted = compressed_snapshot_suite::get_reader(snapshot);
+   BOOST_REQUIRE_THROW(corrupted->read_section<chain_snapshot_header>([]( auto& section ) {
+      chain_snapshot_header header;
+      section.read_row(header);
+   }), snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_delta_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), snapshot_test_wast);
+   chain.set_abi(N(snapshot), snapshot_test_abi);
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto write_binary = [&]() {
+      auto writer = buffered_snapshot_suite::get_writer();
+      chain.control->write_snapshot(writer);
+      return buffered_snapshot_suite::finalize(writer);
+   };
+   auto advance = [&]() {
+      chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+         ( "value", 1 )
+      );
+      chain.produce_blocks(3);
+      chain.control->abort_block();
+   };
+
+   fc::temp_directory tempdir;
+   auto save = [&]( const std::string& name, const std::string& content ) {
+      auto p = tempdir.path() / name;
+      std::ofstream out(p.generic_string(), std::ios::out | std::ios::binary);
+      out << content;
+      return p;
+   };
+
+   auto base = write_binary();
+   std::istringstream base_in(base);
+   auto base_index = delta_snapshot_writer::index_snapshot(base_in);
+   BOOST_REQUIRE_EQUAL(base_index.integrity_hash.str(), chain.control->calculate_integrity_hash().str());
+
+   // two deltas, each taken against the state of the one before
+   advance();
+   std::ostringstream first_delta;
+   auto first_writer = std::make_shared<delta_snapshot_writer>(first_delta, base_index);
+   chain.control->write_snapshot(first_writer);
+   first_writer->finalize();
+
+   advance();
+   std::ostringstream second_delta;
+   auto second_writer = std::make_shared<delta_snapshot_writer>(second_delta, first_writer->index());
+   chain.control->write_snapshot(second_writer);
+   second_writer->finalize();
+   BOOST_REQUIRE_EQUAL(second_writer->index().integrity_hash.str(), chain.control->calculate_integrity_hash().str());
+
+   auto expected = write_binary();
+   BOOST_CHECK_LT(second_delta.str().size(), expected.size() / 2);
+
+   auto output = tempdir.path() / "applied.bin";
+   delta_snapshot_writer::apply(save("base.bin", base), {save("1.delta", first_delta.str()), save("2.delta", second_delta.str())}, output);
+   std::string applied;
+   fc::read_file_contents(output, applied);
+   BOOST_REQUIRE(applied == expected);
+
+   // a delta between two binary snapshots gives the same result, and cannot be applied to another base
+   std::istringstream offline_base(base), offline_target(expected);
+   std::ostringstream offline_delta;
+   delta_snapshot_writer::create(offline_base, offline_target, offline_delta);
+   delta_snapshot_writer::apply(save("base.bin", base), {save("offline.delta", offline_delta.str())}, output);
+   fc::read_file_contents(output, applied);
+   BOOST_REQUIRE(applied == expected);
+   BOOST_REQUIRE_THROW(delta_snapshot_writer::apply(save("other.bin", expected), {save("2.delta", second_delta.str())}, output),
+                       snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_fixture_snapshot)
+{
+   uint32_t setups = 0;
+   auto make = [&]() {
+      ++setups;
+      auto t = std::make_unique<tester>();
+      t->create_account(N(fixture));
+      t->set_code(N(fixture), snapshot_test_wast);
+      t->set_abi(N(fixture), snapshot_test_abi);
+      return std::unique_ptr<base_tester>(std::move(t));
+   };
+
+   tester first(get_fixture_snapshot("test_fixture_snapshot", make));
+   tester second(get_fixture_snapshot("test_fixture_snapshot", make));
+   BOOST_REQUIRE_EQUAL(setups, 1);
+
+   // both start from the state the setup left, including the transactions it had pending
+   BOOST_REQUIRE_EQUAL(first.control->head_block_id(), second.control->head_block_id());
+   BOOST_REQUIRE_EQUAL(first.control->calculate_integrity_hash().str(), second.control->calculate_integrity_hash().str());
+   BOOST_REQUIRE(first.find<account_object, by_name>(N(fixture)) != nullptr);
+
+   // and continue independently
+   first.push_action(N(fixture), N(increment), N(fixture), mutable_variant_object()("value", 1));
+   first.produce_block();
+   second.produce_blocks(2);
+   BOOST_REQUIRE_EQUAL(first.control->head_block_num() + 1, second.control->head_block_num());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,136 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/softfloat_fast_path.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace eosio::chain;
+
+namespace {
+
+   /// edge values of every class, and their neighbours, next to random bit patterns
+   std::vector<uint64_t> f64_samples() {
+      std::vector<uint64_t> v = {
+         0x0000000000000000ull, 0x8000000000000000ull,   // zeros
+         0x0000000000000001ull, 0x800fffffffffffffull,   // subnormals
+         0x0010000000000000ull, 0x8010000000000001ull,   // smallest normals
+         0x3ff0000000000000ull, 0xbff0000000000001ull,   // ones
+         0x7fefffffffffffffull, 0xffefffffffffffffull,   // largest finite
+         0x7ff0000000000000ull, 0xfff0000000000000ull,   // infinities
+         0x7ff8000000000000ull, 0xfff8000000000000ull,   // quiet NaNs
+         0x7ff0000000000001ull, 0x7ff4000000000123ull,   // signaling NaNs
+         0x4330000000000000ull, 0x3ca0000000000000ull,   // 2^52 and half an ulp of 1
+      };
+      std::mt19937_64 rng( 0x5f3759df );
+      for( int i = 0; i < 2000; ++i ) {
+         uint64_t r = rng();
+         v.push_back( r );
+         // exponents near the subnormal and overflow boundaries
+         v.push_back( (r & 0x800fffffffffffffull) | (uint64_t(rng() % 64) << 52) );
+         v.push_back( (r & 0x800fffffffffffffull) | (uint64_t(0x7ff - 1 - rng() % 64) << 52) );
+      }
+      return v;
+   }
+
+   std::vector<uint32_t> f32_samples() {
+      std::vector<uint32_t> v = {
+         0x00000000u, 0x80000000u, 0x00000001u, 0x807fffffu, 0x00800000u, 0x80800001u,
+         0x3f800000u, 0xbf800001u, 0x7f7fffffu, 0xff7fffffu, 0x7f800000u, 0xff800000u,
+         0x7fc00000u, 0xffc00000u, 0x7f800001u, 0x7fa00123u, 0x4b000000u, 0x33800000u,
+      };
+      std::mt19937 rng( 0x5f3759df );
+      for( int i = 0; i < 2000; ++i ) {
+         uint32_t r = rng();
+         v.push_back( r );
+         v.push_back( (r & 0x807fffffu) | ((rng() % 32) << 23) );
+         v.push_back( (r & 0x807fffffu) | ((0xff - 1 - rng() % 32) << 23) );
+      }
+      return v;
+   }
+
+   /// the samples are paired with a shifted copy of themselves so that every class meets every other one
+   template<typename T, typename Fast, typename Soft>
+   void require_same_binop( const std::vector<T>& samples, Fast fast, Soft soft, const char* op ) {
+      for( size_t shift : { size_t(0), size_t(1), size_t(7), size_t(18), size_t(1001) } ) {
+         for( size_t i = 0; i < samples.size(); ++i ) {
+            auto a = samples[i];
+            auto b = samples[(i + shift) % samples.size()];
+            auto f = fast( a, b ).v;
+            auto s = soft( a, b ).v;
+            BOOST_TEST_INFO( op << " " << std::hex << a << " " << b );
+            BOOST_REQUIRE_EQUAL( f, s );
+         }
+      }
+   }
+
+   template<typename T, typename Fast, typename Soft>
+   void require_same_unop( const std::vector<T>& samples, Fast fast, Soft soft, const char* op ) {
+      for( auto a : samples ) {
+         auto f = fast( a ).v;
+         auto s = soft( a ).v;
+         BOOST_TEST_INFO( op << " " << std::hex << a );
+         BOOST_REQUIRE_EQUAL( f, s );
+      }
+   }
+
+   float32_t f32( uint32_t v ) { return float32_t{ v }; }
+   float64_t f64( uint64_t v ) { return float64_t{ v }; }
+}
+
+BOOST_AUTO_TEST_SUITE(softfloat_fast_path_tests)
+
+BOOST_AUTO_TEST_CASE(f32_matches_softfloat) {
+   auto samples = f32_samples();
+   require_same_binop( samples, []( uint32_t a, uint32_t b ) { return softfloat_fast_path::add( f32(a), f32(b) ); },
+                                []( uint32_t a, uint32_t b ) { return f32_add( f32(a), f32(b) ); }, "f32_add" );
+   require_same_binop( samples, []( uint32_t a, uint32_t b ) { return softfloat_fast_path::sub( f32(a), f32(b) ); },
+                                []( uint32_t a, uint32_t b ) { return f32_sub( f32(a), f32(b) ); }, "f32_sub" );
+   require_same_binop( samples, []( uint32_t a, uint32_t b ) { return softfloat_fast_path::mul( f32(a), f32(b) ); },
+                                []( uint32_t a, uint32_t b ) { return f32_mul( f32(a), f32(b) ); }, "f32_mul" );
+   require_same_binop( samples, []( uint32_t a, uint32_t b ) { return softfloat_fast_path::div( f32(a), f32(b) ); },
+                                []( uint32_t a, uint32_t b ) { return f32_div( f32(a), f32(b) ); }, "f32_div" );
+   require_same_unop( samples, []( uint32_t a ) { return softfloat_fast_path::sqrt( f32(a) ); },
+                               []( uint32_t a ) { return f32_sqrt( f32(a) ); }, "f32_sqrt" );
+   require_same_unop( samples, []( uint32_t a ) { return softfloat_fast_path::promote( f32(a) ); },
+                               []( uint32_t a ) { return f32_to_f64( f32(a) ); }, "f32_promote" );
+}
+
+BOOST_AUTO_TEST_CASE(f64_matches_softfloat) {
+   auto samples = f64_samples();
+   require_same_binop( samples, []( uint64_t a, uint64_t b ) { return softfloat_fast_path::add( f64(a), f64(b) ); },
+                                []( uint64_t a, uint64_t b ) { return f64_add( f64(a), f64(b) ); }, "f64_add" );
+   require_same_binop( samples, []( uint64_t a, uint64_t b ) { return softfloat_fast_path::sub( f64(a), f64(b) ); },
+                                []( uint64_t a, uint64_t b ) { return f64_sub( f64(a), f64(b) ); }, "f64_sub" );
+   require_same_binop( samples, []( uint64_t a, uint64_t b ) { return softfloat_fast_path::mul( f64(a), f64(b) ); },
+                                []( uint64_t a, uint64_t b ) { return f64_mul( f64(a), f64(b) ); }, "f64_mul" );
+   require_same_binop( samples, []( uint64_t a, uint64_t b ) { return softfloat_fast_path::div( f64(a), f64(b) ); },
+                                []( uint64_t a, uint64_t b ) { return f64_div( f64(a), f64(b) ); }, "f64_div" );
+   require_same_unop( samples, []( uint64_t a ) { return softfloat_fast_path::sqrt( f64(a) ); },
+                               []( uint64_t a ) { return f64_sqrt( f64(a) ); }, "f64_sqrt" );
+   require_same_unop( samples, []( uint64_t a ) { return softfloat_fast_path::demote( f64(a) ); },
+                               []( uint64_t a ) { return f64_to_f32( f64(a) ); }, "f64_demote" );
+}
+
+#ifdef EOSIO_SOFTFLOAT_FAST_PATH
+// a thread flushing subnormals and rounding toward zero still gets the bits of softfloat
+BOOST_AUTO_TEST_CASE(non_default_mxcsr_falls_back) {
+   struct restore_mxcsr {
+      unsigned saved = _mm_getcsr();
+      ~restore_mxcsr() { _mm_setcsr( saved ); }
+   } restore;
+   auto samples = f64_samples();
+   _mm_setcsr( restore.saved | 0x8040 | _MM_ROUND_TOWARD_ZERO ); // FTZ and DAZ
+   BOOST_TEST( !softfloat_fast_path::native_rounding() );
+   require_same_binop( samples, []( uint64_t a, uint64_t b ) { return softfloat_fast_path::mul( f64(a), f64(b) ); },
+                                []( uint64_t a, uint64_t b ) { return f64_mul( f64(a), f64(b) ); }, "f64_mul" );
+   require_same_unop( samples, []( uint64_t a ) { return softfloat_fast_path::demote( f64(a) ); },
+                               []( uint64_t a ) { return f64_to_f32( f64(a) ); }, "f64_demote" );
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
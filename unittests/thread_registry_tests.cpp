@@ -0,0 +1,46 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+#include <eosio/chain/thread_registry.hpp>
+#include <eosio/chain/metrics.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+
+using namespace eosio::chain;
+
+BOOST_AUTO_TEST_SUITE(thread_registry_tests)
+
+BOOST_AUTO_TEST_CASE(cpu_lists) try {
+   BOOST_TEST( ( thread_registry::parse_cpu_list( "0" ) == vector<uint32_t>({ 0 }) ) );
+   BOOST_TEST( ( thread_registry::parse_cpu_list( "4-6, 1,5" ) == vector<uint32_t>({ 1, 4, 5, 6 }) ) );
+   BOOST_CHECK_THROW( thread_registry::parse_cpu_list( "" ), misc_exception );
+   BOOST_CHECK_THROW( thread_registry::parse_cpu_list( "3-1" ), misc_exception );
+   BOOST_CHECK_THROW( thread_registry::parse_cpu_list( "1-2-3" ), misc_exception );
+   BOOST_CHECK_THROW( thread_registry::parse_cpu_list( "a" ), misc_exception );
+} FC_LOG_AND_RETHROW()
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(cpu_time_of_registered_threads) try {
+   auto& cpu_time = metrics_registry::instance().counter( "eosio_thread_cpu_microseconds_total",
+                                                          "CPU time used by a thread of the node",
+                                                          { { "thread", "test-busy" } } );
+   std::thread t( []() {
+      thread_registry::instance().register_current_thread( "test-busy" );
+      auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds( 20 );
+      while( std::chrono::steady_clock::now() < end ) {}
+   } );
+   t.join();
+
+   // what it used is reported as it exits
+   BOOST_TEST( cpu_time.value() > 0u );
+   thread_registry::instance().update_metrics();
+   BOOST_TEST( metrics_registry::instance().to_prometheus().find( "thread=\"test-busy\"" ) != string::npos );
+} FC_LOG_AND_RETHROW()
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
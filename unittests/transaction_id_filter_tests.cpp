@@ -0,0 +1,53 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/transaction_id_filter.hpp>
+
+#include <fc/crypto/sha256.hpp>
+
+using namespace eosio::chain;
+
+namespace {
+   transaction_id_type id( uint32_t i ) { return fc::sha256::hash( std::to_string( i ) ); }
+}
+
+BOOST_AUTO_TEST_SUITE(transaction_id_filter_tests)
+
+BOOST_AUTO_TEST_CASE(no_false_negatives) {
+   transaction_id_filter f;
+   fc::time_point_sec start( 1000000 );
+   for( uint32_t i = 0; i < 20000; ++i )
+      f.add( id( i ), start + i / 10 );
+   for( uint32_t i = 0; i < 20000; ++i )
+      BOOST_REQUIRE( f.may_contain( id( i ) ) );
+
+   uint32_t false_positives = 0;
+   for( uint32_t i = 20000; i < 40000; ++i )
+      false_positives += f.may_contain( id( i ) );
+   BOOST_TEST( false_positives < 20 );
+}
+
+BOOST_AUTO_TEST_CASE(drops_expired_spans) {
+   transaction_id_filter f;
+   const auto span = transaction_id_filter::span_seconds;
+   fc::time_point_sec start( span * 100 );
+   f.add( id( 1 ), start );
+   f.add( id( 2 ), start + span );
+   f.add( id( 3 ), start + 2 * span );
+   BOOST_REQUIRE_EQUAL( f.spans(), 3u );
+
+   // the span of a time is kept until all of it expired
+   f.drop_expired( start + span + span / 2 );
+   BOOST_REQUIRE_EQUAL( f.spans(), 2u );
+   BOOST_TEST( !f.may_contain( id( 1 ) ) );
+   BOOST_TEST( f.may_contain( id( 2 ) ) );
+   BOOST_TEST( f.may_contain( id( 3 ) ) );
+
+   f.clear();
+   BOOST_TEST( !f.may_contain( id( 3 ) ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
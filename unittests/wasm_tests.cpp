@@ -31,6 +31,7 @@
 
 #include <array>
 #include <utility>
+#include <thread>
 
 #include "incbin.h"
 
@@ -702,6 +703,285 @@ BOOST_FIXTURE_TEST_CASE( check_entry_behavior_2, TESTER ) try {
 } FC_LOG_AND_RETHROW()
 
 
+struct wasm_cache_tester : public tester {
+   wasm_cache_tester( uint32_t compile_threads = 0 ) : tester(false) {
+      close();
+      cfg.wasm_cache_max_entries = 2; // the pinned eosio.bios plus one more contract
+      cfg.wasm_compile_threads = compile_threads;
+      open(nullptr);
+      push_genesis_block();
+   }
+
+   transaction_trace_ptr push_entry_action( account_name account ) {
+      signed_transaction trx;
+      action act;
+      act.account = account;
+      act.name = N();
+      act.authorization = vector<permission_level>{{account,config::active_name}};
+      trx.actions.push_back(act);
+
+      // vary the expiration so repeated pushes within one block are not duplicates
+      set_transaction_headers(trx, DEFAULT_EXPIRATION_DELTA + pushed++);
+      trx.sign(get_private_key( account, "active" ), control->get_chain_id());
+      return push_transaction(trx);
+   }
+
+   uint32_t pushed = 0;
+};
+
+BOOST_FIXTURE_TEST_CASE( instantiation_cache_eviction, wasm_cache_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck1), N(entrycheck2)} );
+   produce_block();
+
+   set_code(N(entrycheck1), entry_wast);
+   set_code(N(entrycheck2), entry_wast_2);
+   produce_blocks(1);
+
+   auto& wasmif = control->get_wasm_interface();
+   auto before = wasmif.cache_stats();
+   BOOST_REQUIRE_EQUAL( before.pinned_entries, 1 );
+
+   push_entry_action(N(entrycheck1));
+   auto stats = wasmif.cache_stats();
+   BOOST_CHECK_EQUAL( stats.misses, before.misses + 1 );
+   BOOST_CHECK_EQUAL( stats.entries, 2 );
+
+   // second run of the same code is served from the cache
+   push_entry_action(N(entrycheck1));
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().misses, before.misses + 1 );
+
+   // a different contract evicts the least recently used unpinned one
+   push_entry_action(N(entrycheck2));
+   stats = wasmif.cache_stats();
+   BOOST_CHECK_EQUAL( stats.misses, before.misses + 2 );
+   BOOST_CHECK_EQUAL( stats.evictions, before.evictions + 1 );
+   BOOST_CHECK_EQUAL( stats.entries, 2 );
+   BOOST_CHECK_EQUAL( stats.pinned_entries, 1 );
+
+   // and the evicted contract has to be instantiated again, though not injected again
+   auto reuses = stats.injection_reuses;
+   push_entry_action(N(entrycheck1));
+   stats = wasmif.cache_stats();
+   BOOST_CHECK_EQUAL( stats.misses, before.misses + 3 );
+   BOOST_CHECK_EQUAL( stats.evictions, before.evictions + 2 );
+   BOOST_CHECK_EQUAL( stats.injection_reuses, reuses + 1 );
+
+   // the pinned system contract survived every eviction
+   produce_blocks(1);
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().misses, before.misses + 3 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( instantiation_shared_across_chains, wasm_cache_tester ) try {
+   wasm_cache_tester other;
+   for( auto* t : { (wasm_cache_tester*)this, &other } ) {
+      t->produce_blocks(2);
+      t->create_accounts( {N(entrycheck)} );
+      t->produce_block();
+      t->set_code(N(entrycheck), entry_wast);
+      t->produce_blocks(1);
+   }
+
+   push_entry_action(N(entrycheck));
+
+   // the second chain runs the module the first one instantiated
+   auto& wasmif = other.control->get_wasm_interface();
+   auto before = wasmif.cache_stats();
+   other.push_entry_action(N(entrycheck));
+   auto stats = wasmif.cache_stats();
+   BOOST_CHECK_EQUAL( stats.misses, before.misses + 1 );
+   BOOST_CHECK_EQUAL( stats.shared_instantiations, before.shared_instantiations + 1 );
+
+   // and both keep running it
+   push_entry_action(N(entrycheck));
+   other.push_entry_action(N(entrycheck));
+   produce_blocks(1);
+   other.produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+struct wasm_background_compile_tester : public wasm_cache_tester {
+   wasm_background_compile_tester() : wasm_cache_tester(1) {}
+};
+
+BOOST_FIXTURE_TEST_CASE( background_compile_on_setcode, wasm_background_compile_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   auto& wasmif = control->get_wasm_interface();
+   auto before = wasmif.cache_stats();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+
+   // whether or not the compile finished before the action arrived, it was not done inline
+   push_entry_action(N(entrycheck));
+   auto stats = wasmif.cache_stats();
+   BOOST_CHECK_EQUAL( stats.background_compiles, before.background_compiles + 1 );
+
+   push_entry_action(N(entrycheck));
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().background_compiles, before.background_compiles + 1 );
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().misses, stats.misses );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( warm_cache_after_restart, wasm_background_compile_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+   push_entry_action(N(entrycheck));
+   produce_blocks(1);
+
+   close();
+   open(nullptr);
+
+   // eosio is pinned and entrycheck was in the cache at shutdown; both are compiled ahead of use, entrycheck
+   // finished as the action needs it and eosio as the next block starts
+   push_entry_action(N(entrycheck));
+   produce_blocks(1);
+   BOOST_CHECK_EQUAL( control->get_wasm_interface().cache_stats().background_compiles, 2 );
+} FC_LOG_AND_RETHROW()
+
+struct wasm_tiered_tester : public wasm_cache_tester {
+   wasm_tiered_tester() : wasm_cache_tester(1) {
+      close();
+      cfg.wasm_runtime = wasm_interface::vm_type::tiered;
+      cfg.wasm_tier_up_threshold = 2;
+      open(nullptr);
+   }
+};
+
+BOOST_FIXTURE_TEST_CASE( tier_up_hot_contract, wasm_tiered_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+
+   auto& wasmif = control->get_wasm_interface();
+   auto before = wasmif.cache_stats();
+
+   // the JIT compile runs in the background and is picked up as a later block starts
+   for( uint32_t i = 0; i < 100 && wasmif.cache_stats().tier_ups == before.tier_ups; ++i ) {
+      push_entry_action(N(entrycheck));
+      std::this_thread::sleep_for( std::chrono::milliseconds(50) );
+      produce_blocks(1);
+   }
+   BOOST_REQUIRE_EQUAL( wasmif.cache_stats().tier_ups, before.tier_ups + 1 );
+
+   // and the contract keeps working once it runs on wavm
+   push_entry_action(N(entrycheck));
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+struct wasm_fast_jit_tester : public wasm_cache_tester {
+   wasm_fast_jit_tester() {
+      close();
+      cfg.wasm_runtime = wasm_interface::vm_type::wavm;
+      cfg.wasm_jit_fast_compile_size = 1; // every contract counts as huge
+      open(nullptr);
+   }
+};
+
+BOOST_FIXTURE_TEST_CASE( fast_jit_compile_of_large_code, wasm_fast_jit_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+
+   auto& wasmif = control->get_wasm_interface();
+   auto before = wasmif.cache_stats();
+
+   // code compiled with fewer optimizations behaves the same
+   push_entry_action(N(entrycheck));
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().fast_jit_compiles, before.fast_jit_compiles + 1 );
+   push_entry_action(N(entrycheck));
+   BOOST_CHECK_EQUAL( wasmif.cache_stats().fast_jit_compiles, before.fast_jit_compiles + 1 );
+   produce_blocks(1);
+} FC_LOG_AND_RETHROW()
+
+struct wasm_profiling_tester : public wasm_cache_tester {
+   wasm_profiling_tester() {
+      close();
+      cfg.profile_execution = true;
+      open(nullptr);
+   }
+};
+
+BOOST_FIXTURE_TEST_CASE( execution_profile, wasm_profiling_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+
+   auto* profiler = control->get_execution_profiler();
+   BOOST_REQUIRE( profiler != nullptr );
+   profiler->reset();
+
+   push_entry_action(N(entrycheck));
+
+   auto report = profiler->report();
+   auto entry = std::find_if( report.begin(), report.end(), []( const auto& e ) {
+      return e.receiver == N(entrycheck) && e.action == action_name();
+   });
+   BOOST_REQUIRE( entry != report.end() );
+   BOOST_CHECK_EQUAL( entry->calls, 1 );
+
+   std::map<string, uint64_t> calls;
+   for( const auto& i : entry->intrinsics )
+      calls[i.name] = i.calls;
+   BOOST_CHECK_EQUAL( calls["current_time"], 2 ); // once from the start function and once from apply
+   BOOST_CHECK_EQUAL( calls["require_auth"], 1 );
+   BOOST_CHECK_EQUAL( calls["eosio_assert"], 1 );
+   BOOST_CHECK_EQUAL( calls.count("checktime"), 0 );
+
+   BOOST_CHECK( profiler->folded_stacks().find("entrycheck;;current_time ") != string::npos );
+} FC_LOG_AND_RETHROW()
+
+struct wasm_phase_tester : public wasm_cache_tester {
+   wasm_phase_tester() {
+      close();
+      cfg.profile_transaction_phases = true;
+      open(nullptr);
+   }
+};
+
+BOOST_FIXTURE_TEST_CASE( transaction_phase_times, wasm_phase_tester ) try {
+   produce_blocks(2);
+   create_accounts( {N(entrycheck)} );
+   produce_block();
+
+   set_code(N(entrycheck), entry_wast);
+   produce_blocks(1);
+
+   auto trace = push_entry_action(N(entrycheck));
+   BOOST_REQUIRE( trace->phase_times.valid() );
+   const auto& t = *trace->phase_times;
+   BOOST_CHECK( t.authorization_ns > 0 );
+   BOOST_CHECK( t.wasm_ns > 0 );
+   BOOST_CHECK( t.finalize_ns > 0 );
+   BOOST_CHECK_EQUAL( t.native_ns, 0 );
+   BOOST_CHECK_EQUAL( t.db_ns, 0 );      // entry_wast calls no db host function
+   BOOST_CHECK_EQUAL( t.deferred_ns, 0 );
+
+   // the phases are exclusive, so they add up to the total but for the rounding of each to nanoseconds
+   auto sum = t.init_ns + t.authorization_ns + t.dispatch_ns + t.native_ns + t.wasm_ns + t.db_ns + t.deferred_ns + t.finalize_ns;
+   BOOST_CHECK( sum <= t.total_ns );
+   BOOST_CHECK( t.total_ns - sum < 8 );
+
+   // newaccount runs the native handler of the system account
+   trace = create_account(N(phasecheck));
+   BOOST_REQUIRE( trace->phase_times.valid() );
+   BOOST_CHECK( trace->phase_times->native_ns > 0 );
+} FC_LOG_AND_RETHROW()
+
 /**
  * Ensure we can load a wasm w/o memory
  */
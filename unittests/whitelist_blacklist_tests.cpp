@@ -186,6 +186,42 @@ BOOST_AUTO_TEST_CASE( actor_blacklist ) { try {
    test.chain->produce_blocks();
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( lists_set_at_runtime ) { try {
+   whitelist_blacklist_tester<> test;
+   test.init();
+
+   test.transfer( N(eosio.token), N(alice), "1000.00 TOK" );
+   test.transfer( N(alice), N(bob),  "100.00 TOK" );
+   test.transfer( N(bob), N(alice) );
+
+   test.chain->control->set_actor_blacklist( {N(bob)} );
+   BOOST_CHECK_EXCEPTION( test.transfer( N(bob), N(alice) ),
+                          actor_blacklist_exception,
+                          fc_exception_message_starts_with("authorizing actor(s) in transaction are on the actor blacklist: [\"bob\"]")
+                        );
+   test.chain->control->set_actor_blacklist( {} );
+   test.transfer( N(bob), N(alice) );
+
+   test.chain->control->set_action_blacklist( {{N(eosio.token), N(transfer)}} );
+   BOOST_CHECK_EXCEPTION( test.transfer( N(alice), N(bob) ),
+                          action_blacklist_exception,
+                          fc_exception_message_is("action 'eosio.token::transfer' is on the action blacklist")
+                        );
+   test.chain->control->set_action_blacklist( {} );
+
+   // the notified receivers are checked too, once they run code
+   test.chain->set_code(N(charlie), eosio_token_wast);
+   test.chain->set_abi(N(charlie), eosio_token_abi);
+   test.chain->produce_blocks();
+   test.chain->control->set_contract_blacklist( {N(charlie)} );
+   test.transfer( N(alice), N(bob) );
+   BOOST_CHECK_EXCEPTION( test.transfer( N(alice), N(charlie) ),
+                          contract_blacklist_exception,
+                          fc_exception_message_is("account 'charlie' is on the contract blacklist")
+                        );
+   test.chain->produce_blocks();
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( contract_whitelist ) { try {
    whitelist_blacklist_tester<> test;
    test.contract_whitelist = {config::system_account_name, N(eosio.token), N(bob)};